@@ -32,6 +32,18 @@
 } while(0);
 #endif
 
+/*
+ * Backing store that the decoder may carve the variable sized parts of a
+ * request out of, instead of malloc().  The arena is owned by whoever owns
+ * the decoded message; see PINT_decode_with_arena().
+ */
+struct PINT_decode_arena
+{
+    char *base;
+    int size;
+    int used;
+};
+
 /*
  * Files that want full definitions for the encoding and decoding functions
  * will define this.  They need access to the full source tree.  Most users
@@ -54,6 +66,7 @@
 #define endecode_fields_5_struct(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5) struct endecode_fake_struct
 #define endecode_fields_6(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6) struct endecode_fake_struct
 #define endecode_fields_6_struct(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6) struct endecode_fake_struct
+#define endecode_fields_7(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7) struct endecode_fake_struct
 #define endecode_fields_7_struct(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7) struct endecode_fake_struct
 #define endecode_fields_8_struct(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7,t8,x8) struct endecode_fake_struct
 #define endecode_fields_9_struct(n,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7,t8,x8,t9,x9) struct endecode_fake_struct
@@ -89,6 +89,31 @@ enum PINT_server_perf_keys
     PINT_PERF_IO = 20,                  /* io requests called */
     PINT_PERF_SMALL_IO = 21,            /* small_io requests called */
     PINT_PERF_READDIR = 22,             /* readdir requests called */
+    PINT_PERF_ALTAIO_QUEUE_DEPTH = 23,  /* alt-aio calls waiting for a worker */
+    PINT_PERF_ALTAIO_REQUESTS = 24,     /* alt-aio aiocbs submitted */
+    PINT_PERF_ALTAIO_SYSCALLS = 25,     /* alt-aio read/write syscalls issued */
+    PINT_PERF_FLOWBUF_HITS = 26,        /* flow buffers reused from the pool */
+    PINT_PERF_FLOWBUF_MISSES = 27,      /* flow buffers allocated from BMI */
+    PINT_PERF_FLOWBUF_IN_USE = 28,      /* flow buffers lent out */
+    PINT_PERF_FLOWBUF_CACHED = 29,      /* idle flow buffers in the pool */
+    PINT_PERF_BMI_MSGS_SENT = 30,       /* messages sent by bmi_tcp */
+    PINT_PERF_BMI_SEND_CALLS = 31,      /* bmi_tcp send syscalls */
+    PINT_PERF_BMI_MSGS_RECV = 32,       /* messages received by bmi_tcp */
+    PINT_PERF_BMI_RECV_CALLS = 33,      /* bmi_tcp recv syscalls */
+    PINT_PERF_ATTRCACHE_HITS = 34,      /* trove attr cache hits */
+    PINT_PERF_ATTRCACHE_MISSES = 35,    /* trove attr cache misses */
+    PINT_PERF_ATTRCACHE_EVICTIONS = 36, /* trove attr cache evictions */
+    PINT_PERF_ATTRCACHE_BYTES = 37,     /* memory held by trove attr cache */
+    PINT_PERF_QOS_META_1MS = 38,        /* metadata requests done < 1ms */
+    PINT_PERF_QOS_META_10MS = 39,       /* metadata requests done < 10ms */
+    PINT_PERF_QOS_META_100MS = 40,      /* metadata requests done < 100ms */
+    PINT_PERF_QOS_META_SLOW = 41,       /* metadata requests done later */
+    PINT_PERF_QOS_IO_1MS = 42,          /* I/O requests done < 1ms */
+    PINT_PERF_QOS_IO_10MS = 43,         /* I/O requests done < 10ms */
+    PINT_PERF_QOS_IO_100MS = 44,        /* I/O requests done < 100ms */
+    PINT_PERF_QOS_IO_SLOW = 45,         /* I/O requests done later */
+    PINT_PERF_REQPLAN_HITS = 46,        /* request states given a cached plan */
+    PINT_PERF_REQPLAN_MISSES = 47,      /* request states that missed */
 };
 
 /*
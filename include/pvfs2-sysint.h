@@ -83,6 +83,8 @@ struct PVFS_sys_mntent
     int32_t default_num_dfiles; /**< Default number of dfiles mount option */
     char *bmi_opts; /**< Comma-separated list of BMI options */
     int32_t integrity_check; /**< Check to determine whether the mount process must perform the integrity checks on the config files */
+    PVFS_size wbcache_size; /**< Bytes of small sequential writes that may be held back and written together; 0 writes through */
+    PVFS_size readahead_size; /**< Bytes that may be read ahead of sequential or strided readers; 0 turns read-ahead off */
     /* the following fields are included for convenience;
      * useful if the file system is "mounted" */
     char *mnt_dir;		/**< local mount path */
@@ -191,6 +193,30 @@ struct PVFS_sysresp_readdirplus_s
 };
 typedef struct PVFS_sysresp_readdirplus_s PVFS_sysresp_readdirplus;
 
+/** Holds results of a getattr_list operation (array of error codes and
+ *  array of attribute information, one of each per object asked for).
+ *  The caller frees both arrays, and any link_target in attr_array.
+ */
+struct PVFS_sysresp_getattr_list_s
+{
+    uint32_t       count;
+    PVFS_error    *err_array;
+    PVFS_sys_attr *attr_array;
+};
+typedef struct PVFS_sysresp_getattr_list_s PVFS_sysresp_getattr_list;
+
+/** Holds results of a lookup_list operation (array of error codes and
+ *  array of object references, one of each per name asked for).  The
+ *  caller frees both arrays.
+ */
+struct PVFS_sysresp_lookup_list_s
+{
+    uint32_t         count;
+    PVFS_error      *err_array;
+    PVFS_object_ref *ref_array;
+};
+typedef struct PVFS_sysresp_lookup_list_s PVFS_sysresp_lookup_list;
+
 
 /* truncate */
 /* no data returned in truncate response */
@@ -298,6 +324,24 @@ PVFS_error PVFS_sys_lookup(
     int32_t follow_link,
     PVFS_hint hints);
 
+PVFS_error PVFS_isys_lookup_list(
+    PVFS_object_ref parent_ref,
+    int32_t count,
+    char **names,
+    const PVFS_credential *credential,
+    PVFS_sysresp_lookup_list *resp,
+    PVFS_sys_op_id *op_id,
+    PVFS_hint hints,
+    void *user_ptr);
+
+PVFS_error PVFS_sys_lookup_list(
+    PVFS_object_ref parent_ref,
+    int32_t count,
+    char **names,
+    const PVFS_credential *credential,
+    PVFS_sysresp_lookup_list *resp,
+    PVFS_hint hints);
+
 PVFS_error PVFS_isys_getattr(
     PVFS_object_ref ref,
     uint32_t attrmask,
@@ -314,6 +358,26 @@ PVFS_error PVFS_sys_getattr(
     PVFS_sysresp_getattr *resp,
     PVFS_hint hints);
 
+PVFS_error PVFS_isys_getattr_list(
+    PVFS_fs_id fs_id,
+    int32_t count,
+    PVFS_handle *handles,
+    uint32_t attrmask,
+    const PVFS_credential *credential,
+    PVFS_sysresp_getattr_list *resp,
+    PVFS_sys_op_id *op_id,
+    PVFS_hint hints,
+    void *user_ptr);
+
+PVFS_error PVFS_sys_getattr_list(
+    PVFS_fs_id fs_id,
+    int32_t count,
+    PVFS_handle *handles,
+    uint32_t attrmask,
+    const PVFS_credential *credential,
+    PVFS_sysresp_getattr_list *resp,
+    PVFS_hint hints);
+
 PVFS_error PVFS_isys_setattr(
     PVFS_object_ref ref,
     PVFS_sys_attr attr,
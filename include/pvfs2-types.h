@@ -586,6 +586,15 @@ endecode_fields_2(
     here_string, d_name,
     PVFS_handle, handle);
 
+/* hash functions that map a directory entry name to a dirdata bucket;
+ * chosen when a directory is created and kept in its PVFS_dist_dir_attr
+ */
+enum PVFS_dist_dir_hash_func
+{
+    PVFS_DIST_DIR_HASH_MD5 = 0,
+    PVFS_DIST_DIR_HASH_MURMUR3 = 1
+};
+
 /* Distributed directory attributes struct
  * will be stored in keyval space under DIST_DIR_ATTR
  */
@@ -599,15 +608,21 @@ typedef struct {
         /* local info */
         int32_t server_no; /* 0 to num_servers-1, indicates which server is running this code */
         int32_t branch_level; /* level of branching on this server */
+
+        /* added last: records stored before it existed are shorter,
+         * and PINT_dist_dir_attr_check_read() reads them back as
+         * PVFS_DIST_DIR_HASH_MD5 */
+        int32_t hash_type; /* enum PVFS_dist_dir_hash_func */
 } PVFS_dist_dir_attr;
-endecode_fields_6(
+endecode_fields_7(
     PVFS_dist_dir_attr,
     int32_t, tree_height,
     int32_t, num_servers,
     int32_t, bitmap_size,
     int32_t, split_size,
     int32_t, server_no,
-    int32_t, branch_level);
+    int32_t, branch_level,
+    int32_t, hash_type);
 
 typedef uint32_t PVFS_dist_dir_bitmap_basetype;
 typedef uint32_t *PVFS_dist_dir_bitmap;
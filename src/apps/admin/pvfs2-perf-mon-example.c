@@ -27,7 +27,7 @@
 #define PVFS2_VERSION "Unknown"
 #endif
 
-#define MAX_KEY_CNT 23
+#define MAX_KEY_CNT 48
 /* macros for accessing data returned from server */
 #define VALID_FLAG(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt] != 0.0)
 #define ID(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt])
@@ -56,6 +56,28 @@
 #define IO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 20])
 #define SMALLIO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 21])
 #define READDIR(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 22])
+#define FLOWBUF_HITS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 26])
+#define FLOWBUF_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 27])
+#define FLOWBUF_IN_USE(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 28])
+#define FLOWBUF_CACHED(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 29])
+#define BMI_MSGS_SENT(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 30])
+#define BMI_SEND_CALLS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 31])
+#define BMI_MSGS_RECV(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 32])
+#define BMI_RECV_CALLS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 33])
+#define ATTRCACHE_HITS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 34])
+#define ATTRCACHE_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 35])
+#define ATTRCACHE_EVICTIONS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 36])
+#define ATTRCACHE_BYTES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 37])
+#define QOS_META_1MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 38])
+#define QOS_META_10MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 39])
+#define QOS_META_100MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 40])
+#define QOS_META_SLOW(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 41])
+#define QOS_IO_1MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 42])
+#define QOS_IO_10MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 43])
+#define QOS_IO_100MS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 44])
+#define QOS_IO_SLOW(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 45])
+#define REQPLAN_HITS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 46])
+#define REQPLAN_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 47])
 
 int key_cnt; /* holds the Number of keys */
 
@@ -75,6 +97,27 @@ do { \
     } \
 } while(0);
 
+/* prints n/d, e.g. system calls per message */
+#define PRINT_RATIO(s, n, d) \
+do { \
+    int j; \
+    printf(s); \
+    for(j = 0; j < user_opts->history; j++) \
+    { \
+        if (!VALID_FLAG(i, j)) \
+        { \
+            printf("\tXXXX"); \
+            continue; \
+        } \
+        if ((d) == 0) \
+        { \
+            printf("\t0.0"); \
+            continue; \
+        } \
+        printf("\t%.2f", (double)(n) / (double)(d)); \
+    } \
+} while(0);
+
 
 struct options
 {
@@ -322,6 +365,30 @@ int main(int argc, char **argv)
             PRINT_COUNTER("\nrmdir:   ", RMDIRS(i, j));
             PRINT_COUNTER("\ngetattrs: ", GETATTRS(i, j));
             PRINT_COUNTER("\nsetattrs: ", SETATTRS(i, j));
+            PRINT_COUNTER("\nbuf hits: ", FLOWBUF_HITS(i, j));
+            PRINT_COUNTER("\nbuf misses: ", FLOWBUF_MISSES(i, j));
+            PRINT_COUNTER("\nbuf in use: ", FLOWBUF_IN_USE(i, j));
+            PRINT_COUNTER("\nbuf cached: ", FLOWBUF_CACHED(i, j));
+            PRINT_COUNTER("\nmsgs sent: ", BMI_MSGS_SENT(i, j));
+            PRINT_RATIO("\nsends/msg: ", BMI_SEND_CALLS(i, j),
+                        BMI_MSGS_SENT(i, j));
+            PRINT_COUNTER("\nmsgs recvd: ", BMI_MSGS_RECV(i, j));
+            PRINT_RATIO("\nrecvs/msg: ", BMI_RECV_CALLS(i, j),
+                        BMI_MSGS_RECV(i, j));
+            PRINT_COUNTER("\nattr hits: ", ATTRCACHE_HITS(i, j));
+            PRINT_COUNTER("\nattr misses: ", ATTRCACHE_MISSES(i, j));
+            PRINT_COUNTER("\nattr evicts: ", ATTRCACHE_EVICTIONS(i, j));
+            PRINT_COUNTER("\nattr bytes: ", ATTRCACHE_BYTES(i, j));
+            PRINT_COUNTER("\nmeta <1ms: ", QOS_META_1MS(i, j));
+            PRINT_COUNTER("\nmeta <10ms: ", QOS_META_10MS(i, j));
+            PRINT_COUNTER("\nmeta <100ms: ", QOS_META_100MS(i, j));
+            PRINT_COUNTER("\nmeta slow: ", QOS_META_SLOW(i, j));
+            PRINT_COUNTER("\nio <1ms: ", QOS_IO_1MS(i, j));
+            PRINT_COUNTER("\nio <10ms: ", QOS_IO_10MS(i, j));
+            PRINT_COUNTER("\nio <100ms: ", QOS_IO_100MS(i, j));
+            PRINT_COUNTER("\nio slow: ", QOS_IO_SLOW(i, j));
+            PRINT_COUNTER("\nplan hits: ", REQPLAN_HITS(i, j));
+            PRINT_COUNTER("\nplan misses: ", REQPLAN_MISSES(i, j));
 	    PRINT_COUNTER("\ntimestep: ", (unsigned)ID(i, j));
 	    printf("\n");
 	}
@@ -50,6 +50,31 @@
 #define OID_REQ_IO ".1.3.6.1.4.1.7778.20"
 #define OID_REQ_SMALL_IO ".1.3.6.1.4.1.7778.21"
 #define OID_REQ_READDIR ".1.3.6.1.4.1.7778.22"
+#define OID_ALTAIO_QDEPTH ".1.3.6.1.4.1.7778.30"
+#define OID_ALTAIO_REQUESTS ".1.3.6.1.4.1.7778.31"
+#define OID_ALTAIO_SYSCALLS ".1.3.6.1.4.1.7778.32"
+#define OID_FLOWBUF_HITS ".1.3.6.1.4.1.7778.33"
+#define OID_FLOWBUF_MISSES ".1.3.6.1.4.1.7778.34"
+#define OID_FLOWBUF_IN_USE ".1.3.6.1.4.1.7778.35"
+#define OID_FLOWBUF_CACHED ".1.3.6.1.4.1.7778.36"
+#define OID_BMI_MSGS_SENT ".1.3.6.1.4.1.7778.50"
+#define OID_BMI_SEND_CALLS ".1.3.6.1.4.1.7778.51"
+#define OID_BMI_MSGS_RECV ".1.3.6.1.4.1.7778.52"
+#define OID_BMI_RECV_CALLS ".1.3.6.1.4.1.7778.53"
+#define OID_ATTRCACHE_HITS ".1.3.6.1.4.1.7778.54"
+#define OID_ATTRCACHE_MISSES ".1.3.6.1.4.1.7778.55"
+#define OID_ATTRCACHE_EVICTIONS ".1.3.6.1.4.1.7778.56"
+#define OID_ATTRCACHE_BYTES ".1.3.6.1.4.1.7778.57"
+#define OID_QOS_META_1MS ".1.3.6.1.4.1.7778.58"
+#define OID_QOS_META_10MS ".1.3.6.1.4.1.7778.59"
+#define OID_QOS_META_100MS ".1.3.6.1.4.1.7778.60"
+#define OID_QOS_META_SLOW ".1.3.6.1.4.1.7778.61"
+#define OID_QOS_IO_1MS ".1.3.6.1.4.1.7778.62"
+#define OID_QOS_IO_10MS ".1.3.6.1.4.1.7778.63"
+#define OID_QOS_IO_100MS ".1.3.6.1.4.1.7778.64"
+#define OID_QOS_IO_SLOW ".1.3.6.1.4.1.7778.65"
+#define OID_REQPLAN_HITS ".1.3.6.1.4.1.7778.66"
+#define OID_REQPLAN_MISSES ".1.3.6.1.4.1.7778.67"
 
 #define OID_TIMER_LOOKUP ".1.3.6.1.4.1.7778.40"
 #define OID_TIMER_CREAT ".1.3.6.1.4.1.7778.41"
@@ -103,6 +128,31 @@ static struct MGMT_perf_iod key_table[] =
    {OID_REQ_IO, CNT_TYPE, PINT_PERF_IO, "io requests called"},
    {OID_REQ_SMALL_IO, CNT_TYPE, PINT_PERF_SMALL_IO, "small io requests called"},
    {OID_REQ_READDIR, CNT_TYPE, PINT_PERF_READDIR, "readdir requests called"},
+   {OID_ALTAIO_QDEPTH, INT_TYPE, PINT_PERF_ALTAIO_QUEUE_DEPTH, "alt-aio queue depth"},
+   {OID_ALTAIO_REQUESTS, CNT_TYPE, PINT_PERF_ALTAIO_REQUESTS, "alt-aio requests"},
+   {OID_ALTAIO_SYSCALLS, CNT_TYPE, PINT_PERF_ALTAIO_SYSCALLS, "alt-aio syscalls"},
+   {OID_FLOWBUF_HITS, CNT_TYPE, PINT_PERF_FLOWBUF_HITS, "flow buffer pool hits"},
+   {OID_FLOWBUF_MISSES, CNT_TYPE, PINT_PERF_FLOWBUF_MISSES, "flow buffer pool misses"},
+   {OID_FLOWBUF_IN_USE, INT_TYPE, PINT_PERF_FLOWBUF_IN_USE, "flow buffers in use"},
+   {OID_FLOWBUF_CACHED, INT_TYPE, PINT_PERF_FLOWBUF_CACHED, "flow buffers cached"},
+   {OID_BMI_MSGS_SENT, CNT_TYPE, PINT_PERF_BMI_MSGS_SENT, "bmi messages sent"},
+   {OID_BMI_SEND_CALLS, CNT_TYPE, PINT_PERF_BMI_SEND_CALLS, "bmi send syscalls"},
+   {OID_BMI_MSGS_RECV, CNT_TYPE, PINT_PERF_BMI_MSGS_RECV, "bmi messages received"},
+   {OID_BMI_RECV_CALLS, CNT_TYPE, PINT_PERF_BMI_RECV_CALLS, "bmi recv syscalls"},
+   {OID_ATTRCACHE_HITS, CNT_TYPE, PINT_PERF_ATTRCACHE_HITS, "attr cache hits"},
+   {OID_ATTRCACHE_MISSES, CNT_TYPE, PINT_PERF_ATTRCACHE_MISSES, "attr cache misses"},
+   {OID_ATTRCACHE_EVICTIONS, CNT_TYPE, PINT_PERF_ATTRCACHE_EVICTIONS, "attr cache evictions"},
+   {OID_ATTRCACHE_BYTES, INT_TYPE, PINT_PERF_ATTRCACHE_BYTES, "attr cache bytes"},
+   {OID_QOS_META_1MS, CNT_TYPE, PINT_PERF_QOS_META_1MS, "metadata requests < 1ms"},
+   {OID_QOS_META_10MS, CNT_TYPE, PINT_PERF_QOS_META_10MS, "metadata requests < 10ms"},
+   {OID_QOS_META_100MS, CNT_TYPE, PINT_PERF_QOS_META_100MS, "metadata requests < 100ms"},
+   {OID_QOS_META_SLOW, CNT_TYPE, PINT_PERF_QOS_META_SLOW, "metadata requests >= 100ms"},
+   {OID_QOS_IO_1MS, CNT_TYPE, PINT_PERF_QOS_IO_1MS, "io requests < 1ms"},
+   {OID_QOS_IO_10MS, CNT_TYPE, PINT_PERF_QOS_IO_10MS, "io requests < 10ms"},
+   {OID_QOS_IO_100MS, CNT_TYPE, PINT_PERF_QOS_IO_100MS, "io requests < 100ms"},
+   {OID_QOS_IO_SLOW, CNT_TYPE, PINT_PERF_QOS_IO_SLOW, "io requests >= 100ms"},
+   {OID_REQPLAN_HITS, CNT_TYPE, PINT_PERF_REQPLAN_HITS, "request plan hits"},
+   {OID_REQPLAN_MISSES, CNT_TYPE, PINT_PERF_REQPLAN_MISSES, "request plan misses"},
    {NULL, NULL, -1, NULL}   /* this halts the key count */
 };
 
@@ -28,7 +28,7 @@ static unsigned char ucache_avail = 0;
 pid_t pid = -1;
 
 /* Hung Lock Detection */
-time_t locked_time[BLOCKS_IN_CACHE+1];
+time_t locked_time[UCACHE_LOCK_COUNT];
 
 /* Forward Function Declarations */
 static int run_as_child(char c); /* Run as child of ucached */
@@ -95,9 +95,9 @@ static int ucached_lockchk(void)
 {
     int rc = 0;
     int i;
-    for(i = 0; i < (BLOCKS_IN_CACHE + 1); i++)
+    for(i = 0; i < UCACHE_LOCK_COUNT; i++)
     {
-        ucache_lock_t * currlock = get_lock((uint16_t)i);
+        ucache_lock_t * currlock = get_lock(i);
         if(lock_trylock(currlock) == 0)
         {
             /* Lock wasn't held, so set the timer to zero for this lock */
@@ -121,7 +121,7 @@ static int ucached_lockchk(void)
                 {
                     /*
                     gossip_debug(GOSSIP_UCACHED_DEBUG,
-                        "WARNING: HUNG LOCK DETECTED @ block index = %d\n", i);
+                        "WARNING: HUNG LOCK DETECTED @ lock index = %d\n", i);
                     TODO: what to do with hung locks?
                     rc = pick_lock(ucache_lock_t * currlock);
                     if(rc == 1)
@@ -281,8 +281,8 @@ static int create_ucache_shmem(void)
             ucache_locks = ucache_aux->ucache_locks;
 
             int i;
-            /* Initialize Shared Block Level Locks */
-            for(i = 0; i < (BLOCKS_IN_CACHE + 1); i++)
+            /* Initialize the Shared Stripe, File and Global Locks */
+            for(i = 0; i < UCACHE_LOCK_COUNT; i++)
             {
                 rc = lock_init(get_lock(i));
                 if (rc == -1)
@@ -317,7 +317,7 @@ static int create_ucache_shmem(void)
     /* Set the global lock point to the address of the last lock in the locks
      * shmem segment. Then lock it.
      */
-    ucache_lock = get_lock(BLOCKS_IN_CACHE);
+    ucache_lock = get_lock(UCACHE_GLOBAL_LOCK);
     lock_lock(ucache_lock);
 
     gossip_debug(GOSSIP_UCACHED_DEBUG,
@@ -325,7 +325,7 @@ static int create_ucache_shmem(void)
 
     /* Set and zero out global ucache stats struct */
     ucache_stats = &(ucache_aux->ucache_stats);
-    *ucache_stats = (struct ucache_stats_s){ 0, 0, 0, 0, 0 };
+    memset(ucache_stats, 0, sizeof(struct ucache_stats_s));
 
     /* Try to get/create the shmem required for the ucache */
     id = SHM_ID2;
@@ -575,7 +575,7 @@ int main(int argc, char **argv)
     /* restore previous gossip_debug_mask */
     //gossip_set_debug_mask(debug_on, curr_mask);
 
-    memset(locked_time, 0, (sizeof(time_t) * (BLOCKS_IN_CACHE + 1)));
+    memset(locked_time, 0, (sizeof(time_t) * UCACHE_LOCK_COUNT));
 
     /* Direct output of ucache library, TODO: change this later */
     if (!out)
@@ -53,6 +53,10 @@ struct acache_payload
     /**< Time when the dynamic attrs were last updated. */
     struct timeval dynamic_attrs_last_updated;
     PVFS_size size;          /**< cached size */
+    /**< Time the server's lease was received and its length; a
+     *   lease_msecs of 0 means there is no lease. */
+    struct timeval lease_start;
+    uint32_t lease_msecs;
 };
 
 static struct PINT_tcache* acache = NULL;
@@ -73,6 +77,7 @@ static struct PINT_perf_key acache_keys[] =
     {"ACACHE_ENABLED", PERF_ACACHE_ENABLED, PINT_PERF_PRESERVE},
     {"ACACHE_ATTR_INVAL", PERF_ACACHE_ATTR_INVAL, 0},
     {"ACACHE_SIZE_INVAL", PERF_ACACHE_SIZE_INVAL, 0},
+    {"ACACHE_LEASE_HITS", PERF_ACACHE_LEASE_HITS, 0},
     {NULL, 0, 0},
 };
 
@@ -90,6 +95,9 @@ static void load_payload(struct PINT_tcache* instance,
                          PVFS_object_ref refn,
                          void* payload);
 
+static int lease_msecs_used(struct acache_payload* payload,
+                            struct timeval* now);
+
 /**
  * Initializes the acache 
  * \return pointer to tcache on success, NULL on failure
@@ -255,6 +263,8 @@ int PINT_acache_get_cached_entry(
     struct acache_payload* tmp_payload;
     int ret = -1;
     struct timeval current_time = { 0, 0};
+    int lease_used = -1;
+    int lease_hit = 0;
 
     if(!attr || !attr_status ||
        !size || !size_status)
@@ -302,12 +312,19 @@ int PINT_acache_get_cached_entry(
                    __func__);
         tmp_payload = tmp_entry->payload;
 
+        /* Get the time of day and store as milliseconds */
+        PINT_util_get_current_timeval(&current_time);
+        lease_used = lease_msecs_used(tmp_payload, &current_time);
+        if(lease_used > (int)acache->timeout_msecs)
+        {
+            /* the entry is only still here because of the lease */
+            lease_hit = 1;
+        }
+
         if(tmp_payload->attr.mask & PVFS_ATTR_DATA_SIZE)
         {
             int usecs_since_dynamic_attrs_update;
 
-            /* Get the time of day and store as milliseconds */
-            PINT_util_get_current_timeval(&current_time);
             /* Get the difference in the current time and the time the dynamic
              * attrs were last refreshed.
              */
@@ -319,7 +336,8 @@ int PINT_acache_get_cached_entry(
                          usecs_since_dynamic_attrs_update);
             /* TODO use client specified timeout instead of default */
             if(usecs_since_dynamic_attrs_update >
-               (ACACHE_DEFAULT_DYNAMIC_TIMEOUT_MSECS * 1000))
+               (ACACHE_DEFAULT_DYNAMIC_TIMEOUT_MSECS * 1000) &&
+               lease_used < 0)
             {
                 gossip_debug(GOSSIP_ACACHE_DEBUG,
                              "%s: dynamic attrs have timed out!\n",
@@ -335,12 +353,25 @@ int PINT_acache_get_cached_entry(
                  */
                 assert(tmp_payload->attr.mask & PVFS_ATTR_DATA_SIZE);
 
-                gossip_debug(GOSSIP_ACACHE_DEBUG,
-                             "%s: dynamic attrs are still valid for %d "
-                             "usecs!\n",
-                             __func__,
-                             ACACHE_DEFAULT_DYNAMIC_TIMEOUT_MSECS * 1000
-                                - usecs_since_dynamic_attrs_update);
+                if(usecs_since_dynamic_attrs_update >
+                   (ACACHE_DEFAULT_DYNAMIC_TIMEOUT_MSECS * 1000))
+                {
+                    lease_hit = 1;
+                    gossip_debug(GOSSIP_ACACHE_DEBUG,
+                                 "%s: dynamic attrs are still valid for %d "
+                                 "msecs under lease!\n",
+                                 __func__,
+                                 (int)tmp_payload->lease_msecs - lease_used);
+                }
+                else
+                {
+                    gossip_debug(GOSSIP_ACACHE_DEBUG,
+                                 "%s: dynamic attrs are still valid for %d "
+                                 "usecs!\n",
+                                 __func__,
+                                 ACACHE_DEFAULT_DYNAMIC_TIMEOUT_MSECS * 1000
+                                    - usecs_since_dynamic_attrs_update);
+                }
                 /* No need to modify the mask here since the bits are included
                  * when they need to be inserted. They will remain in
                  * the mask until the dynamic attrs time out.
@@ -358,6 +389,11 @@ int PINT_acache_get_cached_entry(
         }
     }
 
+    if(lease_hit)
+    {
+        PINT_perf_count(acache_pc, PERF_ACACHE_LEASE_HITS, 1, PINT_PERF_ADD);
+    }
+
     /* At this point should have all pertinent static attributes and
      * potentially some dynamic attributes. */
     ret = PINT_copy_object_attr(attr, &(tmp_payload->attr));
@@ -479,6 +515,22 @@ int PINT_acache_update(
     PVFS_object_ref refn,   /**< object to update */
     PVFS_object_attr *attr, /**< attributes to copy into cache */
     PVFS_size* size)        /**< logical file size (NULL if not available) */
+{
+    return PINT_acache_update_ex(refn, attr, size, 0);
+}
+
+/**
+ * Like PINT_acache_update(), for attributes that came with a lease from
+ * the server.  The entry, including the size if given, stays valid for at
+ * least lease_msecs.
+ *
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_acache_update_ex(
+    PVFS_object_ref refn,   /**< object to update */
+    PVFS_object_attr *attr, /**< attributes to copy into cache */
+    PVFS_size* size,        /**< logical file size (NULL if not available) */
+    uint32_t lease_msecs)   /**< lease granted by the server, 0 if none */
 {
     struct acache_payload* tmp_payload = NULL;
     uint32_t save_mask;
@@ -564,6 +616,16 @@ int PINT_acache_update(
                      __func__);
     }
 
+    if(lease_msecs)
+    {
+        PINT_util_get_current_timeval(&tmp_payload->lease_start);
+        tmp_payload->lease_msecs = lease_msecs;
+        gossip_debug(GOSSIP_ACACHE_DEBUG,
+                     "%s: lease of %u msecs\n",
+                     __func__,
+                     lease_msecs);
+    }
+
     gossip_debug(GOSSIP_ACACHE_DEBUG,
                 "%s: copied input payload, mask of copied payload is: %x\n",
                 __func__,
@@ -765,6 +827,24 @@ static void load_payload(struct PINT_tcache* instance,
     int purged;
     struct PINT_tcache_entry* tmp_entry;
     int ret;
+    struct acache_payload* tmp_payload = payload;
+    struct timeval lease_end;
+    struct timeval* expiration = NULL;
+
+    /* an entry lives at least as long as its lease */
+    if(tmp_payload->lease_msecs > instance->timeout_msecs &&
+       instance->expiration_enabled)
+    {
+        lease_end = tmp_payload->lease_start;
+        lease_end.tv_sec += tmp_payload->lease_msecs / 1000;
+        lease_end.tv_usec += (tmp_payload->lease_msecs % 1000) * 1000;
+        if(lease_end.tv_usec >= 1000000)
+        {
+            lease_end.tv_usec -= 1000000;
+            lease_end.tv_sec += 1;
+        }
+        expiration = &lease_end;
+    }
 
     /* find out if the entry is already in the cache */
     ret = PINT_tcache_lookup(instance, 
@@ -780,16 +860,21 @@ static void load_payload(struct PINT_tcache* instance,
         /* Point to the new one */
         tmp_entry->payload = payload;
         ret = PINT_tcache_refresh_entry(instance, tmp_entry);
+        if(expiration)
+        {
+            tmp_entry->expiration_date = *expiration;
+        }
         /* this counts as an update of an existing entry */
         PINT_perf_count(acache_pc, PERF_ACACHE_UPDATES, 1, PINT_PERF_ADD);
     }
     else
     {
         /* not found in cache; insert new payload*/
-        ret = PINT_tcache_insert_entry(instance, 
-                                       &refn,
-                                       payload,
-                                       &purged);
+        ret = PINT_tcache_insert_entry_ex(instance,
+                                          &refn,
+                                          payload,
+                                          expiration,
+                                          &purged);
         /* I think this should count as an update of the cache, regardless of
          * if the payload had previously been inserted. */
         PINT_perf_count(acache_pc, PERF_ACACHE_UPDATES, 1, PINT_PERF_ADD);
@@ -825,6 +910,30 @@ static void load_payload(struct PINT_tcache* instance,
     return;
 }
 
+/* lease_msecs_used()
+ *
+ * returns how many msecs of the payload's lease have passed, or -1 if it
+ * has no lease or the lease is over
+ */
+static int lease_msecs_used(struct acache_payload* payload,
+                            struct timeval* now)
+{
+    long msecs;
+
+    if(payload->lease_msecs == 0)
+    {
+        return(-1);
+    }
+
+    msecs = (now->tv_sec - payload->lease_start.tv_sec) * 1000 +
+            (now->tv_usec - payload->lease_start.tv_usec) / 1000;
+    if(msecs < 0 || msecs >= payload->lease_msecs)
+    {
+        return(-1);
+    }
+    return((int)msecs);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
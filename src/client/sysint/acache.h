@@ -59,6 +59,14 @@
  * - symlink
  * .
  *
+ * Attributes fetched by getattr may come with a lease from the servers
+ * that returned them.  The lease says how long the attributes, and the size
+ * if one was fetched, may be trusted; an entry holding a lease does not
+ * expire before the lease does, even if that is later than the acache
+ * timeout.  Servers grant longer leases to objects that have not
+ * changed for a while and none to objects that are changing, so leases
+ * only ever extend the fixed timeouts.
+ *
  * Operations that may invalidate items in the cache:
  * - remove
  * - rename
@@ -97,7 +105,8 @@ enum
     PERF_ACACHE_REPLACEMENTS = 7,
     PERF_ACACHE_ENABLED = 8,
     PERF_ACACHE_ATTR_INVAL = 9,
-    PERF_ACACHE_SIZE_INVAL = 10
+    PERF_ACACHE_SIZE_INVAL = 10,
+    PERF_ACACHE_LEASE_HITS = 11
 };
 
 int PINT_acache_initialize(void);
@@ -124,6 +133,12 @@ int PINT_acache_update(
     PVFS_object_attr *attr,
     PVFS_size* size);
 
+int PINT_acache_update_ex(
+    PVFS_object_ref refn,
+    PVFS_object_attr *attr,
+    PVFS_size* size,
+    uint32_t lease_msecs);
+
 #if 0
 int PINT_acache_amend(
     PVFS_object_ref refn,
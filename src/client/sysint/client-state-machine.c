@@ -364,7 +364,9 @@ struct PINT_client_op_entry_s PINT_client_sm_sys_table[] =
     {&pvfs2_client_statfs_sm},
     {&pvfs2_fs_add_sm},
     {&pvfs2_client_readdirplus_sm},
-    {&pvfs2_client_atomic_eattr_sm}
+    {&pvfs2_client_atomic_eattr_sm},
+    {&pvfs2_client_sysint_getattr_list_sm},
+    {&pvfs2_client_lookup_list_sm}
 };
 
 struct PINT_client_op_entry_s PINT_client_sm_mgmt_table[] =
@@ -467,10 +469,16 @@ int client_state_machine_terminate(
 
         PVFS_hint_free(&sm_p->hints);
 
-        gossip_debug(GOSSIP_CLIENT_DEBUG, 
-                "add smcb %p to completion list\n", smcb);
-        ret = add_sm_to_completion_list(smcb);
-        assert(ret == 0);
+        /* read-ahead is waited for by whoever reads the data, so it
+         * must not be handed to a caller of testsome()
+         */
+        if (!((PINT_smcb_op(smcb) == PVFS_SYS_IO) && sm_p->u.io.prefetch))
+        {
+            gossip_debug(GOSSIP_CLIENT_DEBUG, 
+                    "add smcb %p to completion list\n", smcb);
+            ret = add_sm_to_completion_list(smcb);
+            assert(ret == 0);
+        }
     }
     else
     {
@@ -1214,6 +1222,8 @@ const char *PINT_client_get_name_str(int op_type)
         { PVFS_SYS_IO, "PVFS_SYS_IO" },
         { PVFS_SYS_FLUSH, "PVFS_SYS_FLUSH" },
         { PVFS_SYS_READDIRPLUS, "PVFS_SYS_READDIR_PLUS" },
+        { PVFS_SYS_GETATTR_LIST, "PVFS_SYS_GETATTR_LIST" },
+        { PVFS_SYS_LOOKUP_LIST, "PVFS_SYS_LOOKUP_LIST" },
         { PVFS_MGMT_SETPARAM_LIST, "PVFS_MGMT_SETPARAM_LIST" },
         { PVFS_MGMT_NOOP, "PVFS_MGMT_NOOP" },
         { PVFS_SYS_TRUNCATE, "PVFS_SYS_TRUNCATE" },
@@ -123,6 +123,9 @@ typedef struct PINT_sm_getattr_state
     PVFS_size * size_array;
     PVFS_size size;
 
+    /* shortest attribute lease the servers granted, in msecs */
+    uint32_t lease_msecs;
+
     int flags;
     
 } PINT_sm_getattr_state;
@@ -352,6 +355,7 @@ struct PINT_client_io_sm
 
     PVFS_size * dfile_size_array;
     int small_io;
+    int prefetch;   /* read-ahead; collected by the reader, not testsome() */
 };
 
 struct PINT_client_flush_sm
@@ -373,16 +377,27 @@ struct PINT_client_readdir_sm
 
 struct handle_to_index {
     PVFS_handle handle;
-    int         handle_index;/* This is the index into the dirent array itself */
+    int         handle_index;/* This is the index into the object array itself */
     int         aux_index; /* this is used to store the ordinality of the dfile handles */
 };
 
-struct PINT_client_readdirplus_sm
+/* state of the nested listattr machine, which fetches the attributes
+ * of a list of objects with one listattr request per server; used by
+ * readdirplus and getattr_list
+ */
+struct PINT_client_listattr_sm
 {
-    PVFS_ds_position pos_token;         /* input parameter */
-    int dirent_limit;                   /* input parameter */
-    uint32_t attrmask;                    /* input parameter */
+    PVFS_fs_id fs_id;                   /* input parameter */
+    uint32_t attrmask;                  /* input parameter */
+    int obj_count;                      /* input parameter */
+    PVFS_handle *obj_handles;           /* input parameter */
+    PVFS_error *stat_err_array;         /* output parameter */
+    PVFS_sys_attr *attr_array;          /* output parameter */
+    int cache_results;                  /* put the results in the acache */
     PVFS_sysresp_readdirplus *readdirplus_resp; /* in/out parameter*/
+    PVFS_sysresp_getattr_list *getattr_list_resp; /* in/out parameter*/
+    PVFS_handle *list_handles; /* getattr_list: the caller's handles */
+    int *obj_index;  /* getattr_list: object fetched for each handle */
     /* scratch variables */
     int nhandles;  
     int svr_count;
@@ -392,6 +407,7 @@ struct PINT_client_readdirplus_sm
     PVFS_BMI_addr_t *server_addresses;
     int  *handle_count;
     PVFS_handle     **handles;
+    int             **handle_map; /* input_handle_array index of each handle */
 };
 
 /* 
@@ -440,6 +456,18 @@ struct PINT_client_lookup_sm
     PINT_client_lookup_sm_ctx * contexts;
 };
 
+struct PINT_client_lookup_list_sm
+{
+    PVFS_object_ref parent_ref;       /* input parameter */
+    int count;                        /* input parameter */
+    char **names;                     /* input parameter */
+    PVFS_sysresp_lookup_list *lookup_list_resp; /* in/out parameter */
+    int *pending;          /* indices of the names still to be looked up */
+    int pending_count;
+    int next_pending;      /* first pending name not yet sent */
+    int *batch;            /* name index of each msgpair in flight */
+};
+
 struct PINT_client_rename_sm
 {
     char *entries[2];                /* old/new input entry names */
@@ -649,6 +677,7 @@ typedef struct
     PVFS_ds_position *token;
     uint64_t         *directory_version;
     PVFS_ds_position pos_token;     /* input/output parameter */
+    PVFS_ds_position start_token;   /* pos_token as passed in */
     int32_t      dirent_limit;      /* input parameter */
     int32_t      dirdata_index;      /* input parameter */
 } PINT_sm_readdir_state;
@@ -702,8 +731,9 @@ typedef struct PINT_client_sm
         struct PINT_client_setattr_sm setattr;
         struct PINT_client_io_sm io;
         struct PINT_client_flush_sm flush;
-        struct PINT_client_readdirplus_sm readdirplus;
+        struct PINT_client_listattr_sm listattr;
         struct PINT_client_lookup_sm lookup;
+        struct PINT_client_lookup_list_sm lookup_list;
         struct PINT_client_rename_sm rename;
         struct PINT_client_mgmt_setparam_list_sm setparam_list;
         struct PINT_client_truncate_sm  truncate;
@@ -814,6 +844,8 @@ enum
     PVFS_SYS_FS_ADD                = 19,
     PVFS_SYS_READDIRPLUS           = 20,
     PVFS_SYS_ATOMICEATTR           = 21,
+    PVFS_SYS_GETATTR_LIST          = 22,
+    PVFS_SYS_LOOKUP_LIST           = 23,
     PVFS_MGMT_SETPARAM_LIST        = 70,
     PVFS_MGMT_NOOP                 = 71,
     PVFS_MGMT_STATFS_LIST          = 72,
@@ -834,7 +866,7 @@ enum
     PVFS_DEV_UNEXPECTED            = 400
 };
 
-#define PVFS_OP_SYS_MAXVALID  22
+#define PVFS_OP_SYS_MAXVALID  24
 #define PVFS_OP_SYS_MAXVAL 69
 #define PVFS_OP_MGMT_MAXVALID 84
 #define PVFS_OP_MGMT_MAXVAL 199
@@ -850,6 +882,31 @@ int PINT_client_wait_internal(
 
 void PINT_sys_release(PVFS_sys_op_id op_id);
 
+/* blocking I/O that bypasses the write-back buffer and read-ahead; used
+ * by the buffer itself to send held data
+ */
+PVFS_error PINT_sys_io_uncached(
+    PVFS_object_ref ref,
+    PVFS_Request file_req,
+    PVFS_offset file_req_offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    const PVFS_credential *credential,
+    PVFS_sysresp_io *resp_p,
+    enum PVFS_io_type io_type);
+
+/* posts a read-ahead of one byte range; the caller must PVFS_sys_wait()
+ * and PINT_sys_release() the op_id if it is not -1
+ */
+PVFS_error PINT_sys_io_prefetch(
+    PVFS_object_ref ref,
+    PVFS_offset offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    const PVFS_credential *credential,
+    PVFS_sysresp_io *resp_p,
+    PVFS_sys_op_id *op_id);
+
 void PINT_mgmt_release(PVFS_mgmt_op_id op_id);
 
 /* internal helper macros */
@@ -914,6 +971,8 @@ extern struct PINT_state_machine_s pvfs2_client_flush_sm;
 extern struct PINT_state_machine_s pvfs2_client_sysint_readdir_sm;
 extern struct PINT_state_machine_s pvfs2_client_readdir_sm;
 extern struct PINT_state_machine_s pvfs2_client_readdirplus_sm;
+extern struct PINT_state_machine_s pvfs2_client_sysint_getattr_list_sm;
+extern struct PINT_state_machine_s pvfs2_client_lookup_list_sm;
 extern struct PINT_state_machine_s pvfs2_client_lookup_sm;
 extern struct PINT_state_machine_s pvfs2_client_rename_sm;
 extern struct PINT_state_machine_s pvfs2_client_truncate_sm;
@@ -947,6 +1006,7 @@ extern struct PINT_state_machine_s pvfs2_client_mgmt_get_user_cert_sm;
 #endif
 /* nested state machines (helpers) */
 extern struct PINT_state_machine_s pvfs2_client_lookup_ncache_sm;
+extern struct PINT_state_machine_s pvfs2_client_listattr_sm;
 extern struct PINT_state_machine_s pvfs2_client_remove_helper_sm;
 extern struct PINT_state_machine_s pvfs2_client_mgmt_statfs_list_nested_sm;
 extern struct PINT_state_machine_s pvfs2_server_get_config_nested_sm;
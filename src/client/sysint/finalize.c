@@ -13,6 +13,8 @@
 #include "pint-sysint-utils.h"
 #include "acache.h"
 #include "ncache.h"
+#include "wbcache.h"
+#include "racache.h"
 #include "client-capcache.h"
 #include "gen-locks.h"
 #include "pint-cached-config.h"
@@ -64,6 +66,10 @@ int PVFS_sys_finalize()
         return 0;
     }
 
+    /* send any writes still held back while operations can still run */
+    PINT_wbcache_flush_fs(PVFS_FS_ID_NULL);
+    PINT_racache_drain(PVFS_FS_ID_NULL);
+
     id_gen_safe_finalize();
 
     /* If desired, display cache perf counters before they are finalized. */
@@ -92,9 +98,25 @@ int PVFS_sys_finalize()
                 __func__,
                 PINT_perf_generate_text(PINT_client_capcache_get_pc(), 4096));
         }
+        if(PINT_wbcache_get_pc() &&
+           strstr(perf_counters_to_display, "wbcache"))
+        {
+            gossip_err("%s: DISPLAYING PERF COUNTERS FOR WBCACHE\n%s",
+                __func__,
+                PINT_perf_generate_text(PINT_wbcache_get_pc(), 4096));
+        }
+        if(PINT_racache_get_pc() &&
+           strstr(perf_counters_to_display, "racache"))
+        {
+            gossip_err("%s: DISPLAYING PERF COUNTERS FOR RACACHE\n%s",
+                __func__,
+                PINT_perf_generate_text(PINT_racache_get_pc(), 4096));
+        }
     }
 
     PINT_client_capcache_finalize();
+    PINT_wbcache_finalize();
+    PINT_racache_finalize();
     PINT_ncache_finalize();
     PINT_acache_finalize();
     PINT_cached_config_finalize();
@@ -122,6 +144,8 @@ int PVFS_sys_finalize()
 
     PINT_dist_finalize();
 
+    PINT_request_plan_cache_finalize();
+
     PINT_event_finalize();
 
     PINT_release_pvfstab();
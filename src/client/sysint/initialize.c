@@ -18,6 +18,8 @@
 #include "pvfs2-internal.h"
 #include "acache.h"
 #include "ncache.h"
+#include "wbcache.h"
+#include "racache.h"
 #include "client-capcache.h"
 #include "pint-cached-config.h"
 #include "pvfs2-sysint.h"
@@ -68,7 +70,9 @@ typedef enum
     CLIENT_JOB_TIME_MGR_INIT = (1 << 9),
     CLIENT_DIST_INIT         = (1 << 10),
     CLIENT_SECURITY_INIT     = (1 << 11),
-    CLIENT_CAPCACHE_INIT     = (1 << 12)
+    CLIENT_CAPCACHE_INIT     = (1 << 12),
+    CLIENT_WBCACHE_INIT      = (1 << 13),
+    CLIENT_RACACHE_INIT      = (1 << 14)
 } PINT_client_status_flag;
 
 /* PVFS_sys_initialize()
@@ -303,6 +307,24 @@ int PVFS_sys_initialize(uint64_t default_debug_mask)
     }        
     client_status_flag |= CLIENT_NCACHE_INIT;
 
+    /* initialize the write-back buffer; mounts turn it on individually */
+    ret = PINT_wbcache_initialize();
+    if (ret < 0)
+    {
+        gossip_lerr("Error initializing write-back buffer\n");
+        goto error_exit;
+    }
+    client_status_flag |= CLIENT_WBCACHE_INIT;
+
+    /* likewise the read-ahead cache */
+    ret = PINT_racache_initialize();
+    if (ret < 0)
+    {
+        gossip_lerr("Error initializing read-ahead cache\n");
+        goto error_exit;
+    }
+    client_status_flag |= CLIENT_RACACHE_INIT;
+
     /* initialize the server configuration manager */
     ret = PINT_server_config_mgr_initialize();
     if (ret < 0)
@@ -359,6 +381,16 @@ error_exit:
         PINT_server_config_mgr_finalize();
     }
 
+    if (client_status_flag & CLIENT_WBCACHE_INIT)
+    {
+        PINT_wbcache_finalize();
+    }
+
+    if (client_status_flag & CLIENT_RACACHE_INIT)
+    {
+        PINT_racache_finalize();
+    }
+
     if (client_status_flag & CLIENT_NCACHE_INIT)
     {
         PINT_ncache_finalize();
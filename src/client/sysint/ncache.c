@@ -15,6 +15,7 @@
 #include "gossip.h"
 #include "pvfs2-internal.h"
 #include <string.h>
+#include <time.h>
   
 /** \file
  *  \ingroup ncache
@@ -28,6 +29,10 @@ NCACHE_DEFAULT_SOFT_LIMIT     =  5120,
 NCACHE_DEFAULT_HARD_LIMIT     = 10240,
 NCACHE_DEFAULT_RECLAIM_PERCENTAGE = 25,
 NCACHE_DEFAULT_REPLACE_ALGORITHM = LEAST_RECENTLY_USED,
+NCACHE_DEFAULT_DIR_MAX_ENTRIES = 4096,
+NCACHE_DIR_SOFT_LIMIT         =    64,
+NCACHE_DIR_HARD_LIMIT         =   128,
+NCACHE_DIR_TABLE_SIZE         =   127,
 };
 
 struct PINT_perf_key ncache_keys[] = 
@@ -42,6 +47,9 @@ struct PINT_perf_key ncache_keys[] =
    {"NCACHE_REPLACEMENTS", PERF_NCACHE_REPLACEMENTS, 0},
    {"NCACHE_DELETIONS", PERF_NCACHE_DELETIONS, 0},
    {"NCACHE_ENABLED", PERF_NCACHE_ENABLED, PINT_PERF_PRESERVE},
+   {"NCACHE_NEGATIVE_HITS", PERF_NCACHE_NEGATIVE_HITS, 0},
+   {"NCACHE_DIR_HITS", PERF_NCACHE_DIR_HITS, 0},
+   {"NCACHE_DIRS", PERF_NCACHE_DIRS, PINT_PERF_PRESERVE},
    {NULL, 0, 0},
 };
 
@@ -52,6 +60,7 @@ struct ncache_payload
     PVFS_object_ref parent_ref;     /* PVFS2 object reference to parent */
     int entry_status;               /* is the entry valid? */
     char* entry_name;
+    PVFS_time parent_mtime;         /* parent mtime, for absent entries */
 };
 
 struct ncache_key
@@ -59,8 +68,29 @@ struct ncache_key
     PVFS_object_ref parent_ref;
     const char* entry_name;
 };
+
+/* the names in a directory, collected from one or more readdirs that
+ * started at PVFS_READDIR_START
+ */
+struct ncache_dir_payload
+{
+    PVFS_object_ref dir_ref;
+    PVFS_time dir_mtime;
+    PVFS_ds_position next_token;    /* where the next readdir must start */
+    int complete;                   /* reached PVFS_READDIR_END */
+    int name_count;
+    struct qhash_table* names;
+};
+
+struct ncache_dir_name
+{
+    struct qhash_head link;
+    char* name;
+};
   
 static struct PINT_tcache* ncache = NULL;
+static struct PINT_tcache* ncache_dirs = NULL;
+static unsigned int ncache_dir_max_entries = NCACHE_DEFAULT_DIR_MAX_ENTRIES;
 static gen_mutex_t ncache_mutex = GEN_MUTEX_INITIALIZER;
 static struct PINT_perf_counter* ncache_pc = NULL;
 
@@ -69,6 +99,23 @@ static int ncache_compare_key_entry(const void* key, struct qhash_head* link);
 static int ncache_hash_key(const void* key, int table_size);
 static int ncache_free_payload(void* payload);
 static int set_tcache_defaults(struct PINT_tcache* instance);
+static int ncache_store(const char* entry,
+                        const PVFS_object_ref* parent_ref,
+                        struct ncache_payload* payload);
+static struct ncache_dir_payload* ncache_dir_lookup(
+    const PVFS_object_ref* dir_ref,
+    struct PINT_tcache_entry** entry);
+static void ncache_dir_delete(struct PINT_tcache_entry* entry);
+static int ncache_dir_add_name(struct ncache_dir_payload* dir,
+                               const char* name);
+static void ncache_dir_remove_name(struct ncache_dir_payload* dir,
+                                   const char* name);
+static void ncache_dir_name_free(struct ncache_dir_name* dir_name);
+static int ncache_dir_compare_key_entry(const void* key,
+                                        struct qhash_head* link);
+static int ncache_dir_hash_key(const void* key, int table_size);
+static int ncache_dir_free_payload(void* payload);
+static int ncache_dir_name_compare(const void* key, struct qhash_head* link);
 
 /**
  * Initializes the ncache 
@@ -79,6 +126,7 @@ int PINT_ncache_initialize(void)
     int ret = -1;
     unsigned int ncache_timeout_msecs;
     char * ncache_timeout_str = NULL;
+    char * ncache_dir_max_str = NULL;
   
     gen_mutex_lock(&ncache_mutex);
   
@@ -122,6 +170,46 @@ int PINT_ncache_initialize(void)
         return(ret);
     }
 
+    /* directories whose names are all known; uses the same timeout */
+    ncache_dir_max_str = getenv("PVFS2_NCACHE_DIR_MAX");
+    if (ncache_dir_max_str != NULL)
+    {
+        ncache_dir_max_entries = (unsigned int) strtoul(
+                ncache_dir_max_str,NULL,0);
+    }
+
+    ncache_dirs = PINT_tcache_initialize(ncache_dir_compare_key_entry,
+                                         ncache_dir_hash_key,
+                                         ncache_dir_free_payload,
+                                         -1 /* default tcache table size */);
+    if(!ncache_dirs)
+    {
+        PINT_tcache_finalize(ncache);
+        gen_mutex_unlock(&ncache_mutex);
+        return(-PVFS_ENOMEM);
+    }
+
+    ret = PINT_tcache_set_info(ncache_dirs,
+                               TCACHE_TIMEOUT_MSECS,
+                               ncache_timeout_msecs);
+    if(ret == 0)
+    {
+        ret = PINT_tcache_set_info(ncache_dirs, TCACHE_HARD_LIMIT,
+                                   NCACHE_DIR_HARD_LIMIT);
+    }
+    if(ret == 0)
+    {
+        ret = PINT_tcache_set_info(ncache_dirs, TCACHE_SOFT_LIMIT,
+                                   NCACHE_DIR_SOFT_LIMIT);
+    }
+    if(ret < 0)
+    {
+        PINT_tcache_finalize(ncache_dirs);
+        PINT_tcache_finalize(ncache);
+        gen_mutex_unlock(&ncache_mutex);
+        return(ret);
+    }
+
     /* initialize the perf counter for ncache */
     ret = PINT_ncache_initialize_perf_counter();
     if (ret < 0)
@@ -148,6 +236,12 @@ void PINT_ncache_finalize(void)
         ncache = NULL;
     }
 
+    if(ncache_dirs != NULL)
+    {
+        PINT_tcache_finalize(ncache_dirs);
+        ncache_dirs = NULL;
+    }
+
     if(ncache_pc != NULL)
     {
         PINT_perf_finalize(ncache_pc);
@@ -190,6 +284,15 @@ int PINT_ncache_set_info(
     gen_mutex_lock(&ncache_mutex);
     ret = PINT_tcache_set_info(ncache, option, arg);
 
+    /* the directory cache follows the name cache's timeout and enable
+     * switch; its size limits are its own
+     */
+    if(ret == 0 &&
+       (option == TCACHE_TIMEOUT_MSECS || option == TCACHE_ENABLE))
+    {
+        ret = PINT_tcache_set_info(ncache_dirs, option, arg);
+    }
+
     /* record any resulting parameter changes */
     PINT_perf_count(ncache_pc,
                     PERF_NCACHE_SOFT_LIMIT,
@@ -293,6 +396,7 @@ void PINT_ncache_invalidate(
     int ret = -1;
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_key entry_key;
+    struct ncache_dir_payload* dir;
     int tmp_status;
   
     gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: invalidate(): entry=%s\n",
@@ -318,6 +422,16 @@ void PINT_ncache_invalidate(
                         PINT_PERF_ADD);
     }
 
+    /* callers invalidate before or regardless of the outcome of a
+     * remove or rename, so the name may still exist; stop treating the
+     * directory as known in full rather than record the name as absent
+     */
+    dir = ncache_dir_lookup(parent_ref, &tmp_entry);
+    if(dir)
+    {
+        ncache_dir_delete(tmp_entry);
+    }
+
     PINT_perf_count(ncache_pc,
                     PERF_NCACHE_NUM_ENTRIES,
                     ncache->num_entries,
@@ -342,11 +456,7 @@ int PINT_ncache_update(
     const PVFS_object_ref* parent_ref)     /**< parent ref to update */
 {
     int ret = -1;
-    struct PINT_tcache_entry* tmp_entry;
     struct ncache_payload* tmp_payload;
-    struct ncache_key entry_key;
-    int status;
-    int purged;
     unsigned int enabled;
 
     /* skip out immediately if the cache is disabled */
@@ -377,83 +487,249 @@ int PINT_ncache_update(
     tmp_payload->entry_ref.fs_id = entry_ref->fs_id;
 
     tmp_payload->entry_status = 0;
-    tmp_payload->entry_name = (char*) calloc(1, strlen(entry) + 1);
-    if(tmp_payload->entry_name == NULL)
+
+    ret = ncache_store(entry, parent_ref, tmp_payload);
+  
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): return=%d\n", ret);
+    return(ret);
+}
+
+/**
+ * Records that a name does not exist in a directory whose mtime is
+ * parent_mtime, replacing anything cached for that name.
+ *
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_ncache_update_negative(
+    const char* entry,                     /**< name that does not exist */
+    const PVFS_object_ref* parent_ref,     /**< parent directory */
+    PVFS_time parent_mtime)                /**< mtime of the parent */
+{
+    int ret = -1;
+    struct ncache_payload* tmp_payload;
+    unsigned int enabled;
+
+    PINT_tcache_get_info(ncache, TCACHE_ENABLE, &enabled);
+    if(!enabled || parent_mtime + 1 >= time(NULL))
+    {
+        /* a change within the same second would not show in the mtime */
+        return(0);
+    }
+
+    gossip_debug(GOSSIP_NCACHE_DEBUG,
+                 "ncache: update_negative(): name [%s]\n", entry);
+
+    tmp_payload = (struct ncache_payload*)
+                        calloc(1,sizeof(struct ncache_payload));
+    if(tmp_payload == NULL)
     {
-        free(tmp_payload);
         return(-PVFS_ENOMEM);
     }
-    memcpy(tmp_payload->entry_name, entry, strlen(entry) + 1);
 
-    gen_mutex_lock(&ncache_mutex);
+    tmp_payload->parent_ref.handle = parent_ref->handle;
+    tmp_payload->parent_ref.fs_id = parent_ref->fs_id;
+    tmp_payload->entry_status = -PVFS_ENOENT;
+    tmp_payload->parent_mtime = parent_mtime;
+
+    ret = ncache_store(entry, parent_ref, tmp_payload);
+
+    gossip_debug(GOSSIP_NCACHE_DEBUG,
+                 "ncache: update_negative(): return=%d\n", ret);
+    return(ret);
+}
+
+/**
+ * Reports whether a name is known not to exist in a directory whose
+ * current mtime is parent_mtime, either from a negative entry or
+ * because the directory has been read in full.  Anything cached for
+ * an older mtime is discarded.
+ *
+ * \return 1 if the name is known to be absent, 0 otherwise
+ */
+int PINT_ncache_is_absent(
+    const char* entry,                     /**< name to look for */
+    const PVFS_object_ref* parent_ref,     /**< parent directory */
+    PVFS_time parent_mtime)                /**< current mtime of the parent */
+{
+    int ret;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_payload* tmp_payload;
+    struct ncache_dir_payload* dir;
+    struct ncache_key entry_key;
+    int status;
 
     entry_key.entry_name = entry;
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
-    /* find out if the entry is already in the cache */
-    ret = PINT_tcache_lookup(ncache, 
-                             &entry_key,
-                             &tmp_entry,
-                             &status);
-    if(ret == 0)
+    gen_mutex_lock(&ncache_mutex);
+
+    ret = PINT_tcache_lookup(ncache, (void *) &entry_key, &tmp_entry, &status);
+    if(ret == 0 && status == 0)
     {
-        /* found match in cache; destroy old payload, replace, and
-         * refresh time stamp
-         */
-        ncache_free_payload(tmp_entry->payload);
-        tmp_entry->payload = tmp_payload;
-        ret = PINT_tcache_refresh_entry(ncache, tmp_entry);
-        PINT_perf_count(ncache_pc, PERF_NCACHE_UPDATES, 1, PINT_PERF_ADD);
+        tmp_payload = tmp_entry->payload;
+        if(tmp_payload->entry_status == 0)
+        {
+            gen_mutex_unlock(&ncache_mutex);
+            return(0);
+        }
+        if(tmp_payload->parent_mtime == parent_mtime)
+        {
+            gossip_debug(GOSSIP_NCACHE_DEBUG,
+                         "ncache: negative hit: name=[%s]\n", entry);
+            PINT_perf_count(ncache_pc, PERF_NCACHE_NEGATIVE_HITS, 1,
+                            PINT_PERF_ADD);
+            gen_mutex_unlock(&ncache_mutex);
+            return(1);
+        }
+        /* the directory has changed since */
+        PINT_tcache_delete(ncache, tmp_entry);
+        PINT_perf_count(ncache_pc, PERF_NCACHE_DELETIONS, 1, PINT_PERF_ADD);
+        PINT_perf_count(ncache_pc, PERF_NCACHE_NUM_ENTRIES,
+                        ncache->num_entries, PINT_PERF_SET);
     }
-    else
+
+    dir = ncache_dir_lookup(parent_ref, &tmp_entry);
+    if(dir && dir->complete)
     {
-        /* not found in cache; insert new payload*/
-        ret = PINT_tcache_insert_entry(ncache, 
-                                       &entry_key,
-                                       tmp_payload, 
-                                       &purged);
-        /* the purged variable indicates how many entries had to be purged
-         * from the tcache to make room for this new one
-         */
-        if(purged == 1)
+        if(dir->dir_mtime != parent_mtime)
         {
-            /* since only one item was purged, we count this as one item being
-             * replaced rather than as a purge and an insert
-             */
-            PINT_perf_count(ncache_pc,
-                            PERF_NCACHE_REPLACEMENTS,
-                            purged,
-                            PINT_PERF_ADD);
+            ncache_dir_delete(tmp_entry);
         }
-        else
+        else if(!qhash_search(dir->names, (void *) entry))
         {
-            /* otherwise we just purged as part of reclaimation */
-            /* if we didn't purge anything, then the "purged" variable will
-             * be zero and this counter call won't do anything.
-             */
-            PINT_perf_count(ncache_pc,
-                            PERF_NCACHE_PURGES,
-                            purged,
+            gossip_debug(GOSSIP_NCACHE_DEBUG,
+                         "ncache: directory hit: name=[%s] absent\n", entry);
+            PINT_perf_count(ncache_pc, PERF_NCACHE_DIR_HITS, 1,
                             PINT_PERF_ADD);
+            gen_mutex_unlock(&ncache_mutex);
+            return(1);
         }
     }
-    
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_NUM_ENTRIES,
-                    ncache->num_entries,
-                    PINT_PERF_SET);
 
     gen_mutex_unlock(&ncache_mutex);
-  
-    /* cleanup if we did not succeed for some reason */
-    if(ret < 0)
+    return(0);
+}
+
+/**
+ * Adds the names returned by one readdir of a directory whose mtime is
+ * parent_mtime.  A readdir from PVFS_READDIR_START starts a new list;
+ * one that carries on from where the last one stopped, with the mtime
+ * unchanged, adds to it.  Once PVFS_READDIR_END is reached the list is
+ * complete and names missing from it can be reported absent by
+ * PINT_ncache_is_absent().  Anything else drops the list.
+ *
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_ncache_update_dir(
+    const PVFS_object_ref* parent_ref,     /**< directory read */
+    PVFS_time parent_mtime,                /**< its mtime */
+    PVFS_ds_position start_token,          /**< token the readdir started at */
+    PVFS_ds_position end_token,            /**< token it returned */
+    const PVFS_dirent* dirent_array,       /**< entries it returned */
+    int dirent_count)                      /**< number of entries */
+{
+    int ret = 0;
+    int i;
+    int purged;
+    unsigned int enabled;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_dir_payload* dir;
+
+    PINT_tcache_get_info(ncache_dirs, TCACHE_ENABLE, &enabled);
+    if(!enabled || ncache_dir_max_entries == 0)
     {
-        ncache_free_payload(tmp_payload);
+        return(0);
     }
-  
-    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): return=%d\n", ret);
-    return(ret);
+
+    gen_mutex_lock(&ncache_mutex);
+
+    dir = ncache_dir_lookup(parent_ref, &tmp_entry);
+    if(start_token == PVFS_READDIR_START)
+    {
+        if(dir)
+        {
+            ncache_dir_delete(tmp_entry);
+        }
+        if(parent_mtime + 1 >= time(NULL))
+        {
+            /* a change within the same second would not show in the
+             * mtime
+             */
+            gen_mutex_unlock(&ncache_mutex);
+            return(0);
+        }
+
+        dir = (struct ncache_dir_payload*)
+            calloc(1, sizeof(struct ncache_dir_payload));
+        if(!dir)
+        {
+            gen_mutex_unlock(&ncache_mutex);
+            return(-PVFS_ENOMEM);
+        }
+        dir->names = qhash_init(ncache_dir_name_compare,
+                                quickhash_string_hash,
+                                NCACHE_DIR_TABLE_SIZE);
+        if(!dir->names)
+        {
+            free(dir);
+            gen_mutex_unlock(&ncache_mutex);
+            return(-PVFS_ENOMEM);
+        }
+        dir->dir_ref = *parent_ref;
+        dir->dir_mtime = parent_mtime;
+
+        ret = PINT_tcache_insert_entry(ncache_dirs, &dir->dir_ref, dir,
+                                       &purged);
+        if(ret < 0)
+        {
+            ncache_dir_free_payload(dir);
+            gen_mutex_unlock(&ncache_mutex);
+            return(ret);
+        }
+        ncache_dir_lookup(parent_ref, &tmp_entry);
+    }
+    else if(!dir)
+    {
+        gen_mutex_unlock(&ncache_mutex);
+        return(0);
+    }
+    else if(dir->complete || dir->next_token != start_token ||
+            dir->dir_mtime != parent_mtime)
+    {
+        /* not the continuation of the list being built */
+        if(!dir->complete || dir->dir_mtime != parent_mtime)
+        {
+            ncache_dir_delete(tmp_entry);
+        }
+        gen_mutex_unlock(&ncache_mutex);
+        return(0);
+    }
+
+    for(i = 0; i < dirent_count; i++)
+    {
+        ret = ncache_dir_add_name(dir, dirent_array[i].d_name);
+        if(ret < 0 || dir->name_count > ncache_dir_max_entries)
+        {
+            ncache_dir_delete(tmp_entry);
+            gen_mutex_unlock(&ncache_mutex);
+            return(ret < 0 ? ret : 0);
+        }
+    }
+    dir->next_token = end_token;
+    if(end_token == PVFS_READDIR_END)
+    {
+        gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: directory %llu complete "
+                     "with %d names\n", llu(parent_ref->handle),
+                     dir->name_count);
+        dir->complete = 1;
+        PINT_tcache_refresh_entry(ncache_dirs, tmp_entry);
+    }
+
+    PINT_perf_count(ncache_pc, PERF_NCACHE_DIRS, ncache_dirs->num_entries,
+                    PINT_PERF_SET);
+    gen_mutex_unlock(&ncache_mutex);
+    return(0);
 }
 
 /**
@@ -606,7 +882,257 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
 
     return(0);
 }
+
+/* ncache_store()
+ *
+ * copies the entry name into payload and adds it to the cache,
+ * replacing whatever was cached for the name; keeps the list of names
+ * of the parent directory, if there is one, in step.  payload is
+ * freed on failure
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int ncache_store(const char* entry,
+                        const PVFS_object_ref* parent_ref,
+                        struct ncache_payload* payload)
+{
+    int ret = -1;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_dir_payload* dir;
+    struct ncache_key entry_key;
+    int status;
+    int purged;
+
+    payload->entry_name = (char*) calloc(1, strlen(entry) + 1);
+    if(payload->entry_name == NULL)
+    {
+        free(payload);
+        return(-PVFS_ENOMEM);
+    }
+    memcpy(payload->entry_name, entry, strlen(entry) + 1);
+
+    gen_mutex_lock(&ncache_mutex);
+
+    entry_key.entry_name = entry;
+    entry_key.parent_ref.handle = parent_ref->handle;
+    entry_key.parent_ref.fs_id = parent_ref->fs_id;
+
+    /* find out if the entry is already in the cache */
+    ret = PINT_tcache_lookup(ncache, 
+                             &entry_key,
+                             &tmp_entry,
+                             &status);
+    if(ret == 0)
+    {
+        /* found match in cache; destroy old payload, replace, and
+         * refresh time stamp
+         */
+        ncache_free_payload(tmp_entry->payload);
+        tmp_entry->payload = payload;
+        ret = PINT_tcache_refresh_entry(ncache, tmp_entry);
+        PINT_perf_count(ncache_pc, PERF_NCACHE_UPDATES, 1, PINT_PERF_ADD);
+    }
+    else
+    {
+        /* not found in cache; insert new payload*/
+        ret = PINT_tcache_insert_entry(ncache, 
+                                       &entry_key,
+                                       payload, 
+                                       &purged);
+        /* the purged variable indicates how many entries had to be purged
+         * from the tcache to make room for this new one
+         */
+        if(purged == 1)
+        {
+            /* since only one item was purged, we count this as one item being
+             * replaced rather than as a purge and an insert
+             */
+            PINT_perf_count(ncache_pc,
+                            PERF_NCACHE_REPLACEMENTS,
+                            purged,
+                            PINT_PERF_ADD);
+        }
+        else
+        {
+            /* otherwise we just purged as part of reclaimation */
+            /* if we didn't purge anything, then the "purged" variable will
+             * be zero and this counter call won't do anything.
+             */
+            PINT_perf_count(ncache_pc,
+                            PERF_NCACHE_PURGES,
+                            purged,
+                            PINT_PERF_ADD);
+        }
+    }
+
+    dir = ncache_dir_lookup(parent_ref, &tmp_entry);
+    if(dir && payload->entry_status == 0)
+    {
+        if(ncache_dir_add_name(dir, entry) < 0 ||
+           dir->name_count > ncache_dir_max_entries)
+        {
+            ncache_dir_delete(tmp_entry);
+        }
+    }
+    else if(dir)
+    {
+        ncache_dir_remove_name(dir, entry);
+    }
+    
+    PINT_perf_count(ncache_pc,
+                    PERF_NCACHE_NUM_ENTRIES,
+                    ncache->num_entries,
+                    PINT_PERF_SET);
+
+    gen_mutex_unlock(&ncache_mutex);
   
+    /* cleanup if we did not succeed for some reason */
+    if(ret < 0)
+    {
+        ncache_free_payload(payload);
+    }
+    return(ret);
+}
+
+/* ncache_dir_lookup()
+ *
+ * finds the list of names of a directory; expired lists are dropped.
+ * Must be called with the ncache mutex held
+ *
+ * returns the list, or NULL if there is none
+ */
+static struct ncache_dir_payload* ncache_dir_lookup(
+    const PVFS_object_ref* dir_ref,
+    struct PINT_tcache_entry** entry)
+{
+    int ret;
+    int status;
+
+    ret = PINT_tcache_lookup(ncache_dirs, (void *) dir_ref, entry, &status);
+    if(ret < 0)
+    {
+        return(NULL);
+    }
+    if(status != 0)
+    {
+        ncache_dir_delete(*entry);
+        return(NULL);
+    }
+    return((struct ncache_dir_payload*) (*entry)->payload);
+}
+
+/* ncache_dir_delete()
+ *
+ * drops the list of names of a directory.  Must be called with the
+ * ncache mutex held
+ */
+static void ncache_dir_delete(struct PINT_tcache_entry* entry)
+{
+    PINT_tcache_delete(ncache_dirs, entry);
+    PINT_perf_count(ncache_pc, PERF_NCACHE_DIRS, ncache_dirs->num_entries,
+                    PINT_PERF_SET);
+}
+
+/* ncache_dir_add_name()
+ *
+ * adds a name to the list of names of a directory, if it is not
+ * already there
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int ncache_dir_add_name(struct ncache_dir_payload* dir,
+                               const char* name)
+{
+    struct ncache_dir_name* dir_name;
+
+    if(qhash_search(dir->names, (void *) name))
+    {
+        return(0);
+    }
+
+    dir_name = (struct ncache_dir_name*) malloc(sizeof(*dir_name));
+    if(!dir_name)
+    {
+        return(-PVFS_ENOMEM);
+    }
+    dir_name->name = strdup(name);
+    if(!dir_name->name)
+    {
+        free(dir_name);
+        return(-PVFS_ENOMEM);
+    }
+    qhash_add(dir->names, dir_name->name, &dir_name->link);
+    dir->name_count++;
+    return(0);
+}
+
+/* ncache_dir_remove_name()
+ *
+ * removes a name from the list of names of a directory
+ */
+static void ncache_dir_remove_name(struct ncache_dir_payload* dir,
+                                   const char* name)
+{
+    struct qhash_head* link;
+    struct ncache_dir_name* dir_name;
+
+    link = qhash_search_and_remove(dir->names, (void *) name);
+    if(link)
+    {
+        dir_name = qhash_entry(link, struct ncache_dir_name, link);
+        ncache_dir_name_free(dir_name);
+        dir->name_count--;
+    }
+}
+
+static void ncache_dir_name_free(struct ncache_dir_name* dir_name)
+{
+    free(dir_name->name);
+    free(dir_name);
+}
+
+static int ncache_dir_compare_key_entry(const void* key,
+                                        struct qhash_head* link)
+{
+    const PVFS_object_ref* dir_ref = (const PVFS_object_ref*) key;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_dir_payload* dir;
+
+    tmp_entry = qhash_entry(link, struct PINT_tcache_entry, hash_link);
+    dir = (struct ncache_dir_payload*) tmp_entry->payload;
+
+    return(dir->dir_ref.handle == dir_ref->handle &&
+           dir->dir_ref.fs_id == dir_ref->fs_id);
+}
+
+static int ncache_dir_hash_key(const void* key, int table_size)
+{
+    const PVFS_object_ref* dir_ref = (const PVFS_object_ref*) key;
+    unsigned int sum;
+
+    sum = (unsigned int) (dir_ref->handle ^ (dir_ref->handle >> 32)) +
+          dir_ref->fs_id;
+    return(sum % table_size);
+}
+
+static int ncache_dir_free_payload(void* payload)
+{
+    struct ncache_dir_payload* dir = (struct ncache_dir_payload*) payload;
+
+    qhash_destroy_and_finalize(dir->names, struct ncache_dir_name, link,
+                               ncache_dir_name_free);
+    free(dir);
+    return(0);
+}
+
+static int ncache_dir_name_compare(const void* key, struct qhash_head* link)
+{
+    struct ncache_dir_name* dir_name =
+        qhash_entry(link, struct ncache_dir_name, link);
+
+    return(strcmp(dir_name->name, (const char*) key) == 0);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
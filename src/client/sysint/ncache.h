@@ -56,6 +56,19 @@
  *   items from NCACHE
  * .
  *
+ * The ncache also remembers names that are known NOT to exist:
+ * - a negative entry is added when a lookup of a name fails with
+ *   -PVFS_ENOENT
+ * - a directory that has been read in full by readdir or readdirplus,
+ *   with at most PVFS2_NCACHE_DIR_MAX entries (default 4096, 0 turns
+ *   this off), has its list of names kept so that any other name can
+ *   be reported absent
+ * .
+ * Both are tagged with the mtime of the parent directory and are only
+ * trusted while the parent's cached mtime still matches.  Directories
+ * modified within the last second are not cached this way, since mtime
+ * only has a resolution of one second.
+ *
  * @{
  */
 
@@ -86,6 +99,9 @@ enum
    PERF_NCACHE_REPLACEMENTS = 7,
    PERF_NCACHE_DELETIONS = 8, 
    PERF_NCACHE_ENABLED = 9,
+   PERF_NCACHE_NEGATIVE_HITS = 10,
+   PERF_NCACHE_DIR_HITS = 11,
+   PERF_NCACHE_DIRS = 12,
 };
 
 int PINT_ncache_initialize(void);
@@ -114,6 +130,24 @@ void PINT_ncache_invalidate(
     const char* entry, 
     const PVFS_object_ref* parent_ref);
 
+int PINT_ncache_update_negative(
+    const char* entry,
+    const PVFS_object_ref* parent_ref,
+    PVFS_time parent_mtime);
+
+int PINT_ncache_is_absent(
+    const char* entry,
+    const PVFS_object_ref* parent_ref,
+    PVFS_time parent_mtime);
+
+int PINT_ncache_update_dir(
+    const PVFS_object_ref* parent_ref,
+    PVFS_time parent_mtime,
+    PVFS_ds_position start_token,
+    PVFS_ds_position end_token,
+    const PVFS_dirent* dirent_array,
+    int dirent_count);
+
 struct PINT_perf_counter* PINT_ncache_get_pc(void);
 
 #endif /* __NCACHE_H */
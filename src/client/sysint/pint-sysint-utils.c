@@ -21,6 +21,8 @@
 #include "pvfs2-util.h"
 #include "client-state-machine.h"
 #include "gen-locks.h"
+#include "pint-request.h"
+#include "pint-distribution.h"
 
 
 #ifdef HAVE_OPENSSL
@@ -135,6 +137,50 @@ int PINT_lookup_parent(
     return 0;
 }
 
+/* PINT_cached_stripe_width()
+ *
+ * returns the full stripe width of a file if its distribution is in the
+ * acache, or 0.  A stuffed file has one datafile for now, so its eventual
+ * width is not known either.
+ */
+PVFS_size PINT_cached_stripe_width(PVFS_object_ref ref)
+{
+    PVFS_object_attr attr;
+    PVFS_size size = 0, width = 0;
+    int attr_status = -1, size_status = -1;
+
+    memset(&attr, 0, sizeof(attr));
+    if (PINT_acache_get_cached_entry(ref, &attr, &attr_status,
+                                     &size, &size_status) < 0)
+    {
+        return 0;
+    }
+    if (attr_status == 0 &&
+        (attr.mask & PVFS_ATTR_META_UNSTUFFED) &&
+        (attr.mask & PVFS_ATTR_META_DIST) &&
+        (attr.mask & PVFS_ATTR_META_DFILES) &&
+        attr.u.meta.dist)
+    {
+        width = attr.u.meta.dist->methods->get_blksize(
+            attr.u.meta.dist->params, attr.u.meta.dfile_count);
+    }
+    PINT_free_object_attr(&attr);
+    return width;
+}
+
+/* PINT_io_is_byte_range()
+ *
+ * returns 1 if an I/O request is one contiguous byte range of the file
+ * to or from one contiguous piece of memory at the buffer address
+ */
+int PINT_io_is_byte_range(PVFS_Request file_req, PVFS_Request mem_req)
+{
+    return (file_req == PVFS_BYTE &&
+            PINT_REQUEST_NUM_CONTIG(mem_req) == 1 &&
+            mem_req->offset == 0 &&
+            mem_req->lb == 0);
+}
+
 /* Certain functions outside of the security code use OpenSSL
  * (e.g. src/common/misc/digest.c)
  */
@@ -48,6 +48,10 @@ int PINT_lookup_parent(char *filename,
                        PVFS_credential *credential,
                        PVFS_handle * handle);
 
+PVFS_size PINT_cached_stripe_width(PVFS_object_ref ref);
+
+int PINT_io_is_byte_range(PVFS_Request file_req, PVFS_Request mem_req);
+
 int PINT_client_security_initialize(void);
 int PINT_client_security_finalize(void);
 
@@ -0,0 +1,949 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvfs2-sysint.h"
+#include "pvfs2-debug.h"
+#include "pvfs2-internal.h"
+#include "pint-request.h"
+#include "pint-sysint-utils.h"
+#include "pint-util.h"
+#include "client-state-machine.h"
+#include "acache.h"
+#include "racache.h"
+#include "gen-locks.h"
+#include "quickhash.h"
+#include "quicklist.h"
+#include "gossip.h"
+
+/** \file
+ *  \ingroup racache
+ * Implementation of the Read-ahead Cache (racache) component.
+ *
+ * Each file that has been read on a read-ahead mount keeps the offset
+ * and length of its last read, the stride between its last two reads
+ * and how many reads in a row have followed that pattern.  Data read
+ * ahead is kept in blocks, each of which is one read posted with
+ * PINT_sys_io_prefetch().  Blocks are left in flight until a read needs
+ * them, and are then collected with PVFS_sys_wait(), which also drives
+ * any other outstanding I/O.
+ *
+ * ra_mutex protects the tables, reference counts, byte totals and file
+ * generation numbers, and is never held while talking to a server, so
+ * PINT_racache_invalidate() is safe to call from a state machine.  Each
+ * file's own mutex protects its stream state and its blocks, and is held
+ * while posting or waiting for them.
+ */
+
+enum
+{
+    RACACHE_TABLE_SIZE = 127,
+    RACACHE_MAX_FILES = 1024,
+    RACACHE_DEFAULT_UNIT = 1048576,
+    RACACHE_MAX_STRIPES = 8,
+    RACACHE_MAX_STRIDED = 8,
+    RACACHE_SEQ_RUN = 2,            /* reads in a row before reading ahead */
+    RACACHE_STRIDED_RUN = 3,
+    RACACHE_EVICT_TRIES = 4,
+};
+
+struct PINT_perf_key racache_keys[] =
+{
+    {"RACACHE_HITS", PERF_RACACHE_HITS, 0},
+    {"RACACHE_MISSES", PERF_RACACHE_MISSES, 0},
+    {"RACACHE_PREFETCHES", PERF_RACACHE_PREFETCHES, 0},
+    {"RACACHE_PREFETCH_BYTES", PERF_RACACHE_PREFETCH_BYTES, 0},
+    {"RACACHE_WASTED_BYTES", PERF_RACACHE_WASTED_BYTES, 0},
+    {"RACACHE_BYTES", PERF_RACACHE_BYTES, PINT_PERF_PRESERVE},
+    {"RACACHE_WAITS", PERF_RACACHE_WAITS, 0},
+    {NULL, 0, 0},
+};
+
+/* a file system mounted with the readahead option */
+struct ra_fs
+{
+    PVFS_fs_id fs_id;
+    PVFS_size limit;                /* 0 once the option is withdrawn */
+    PVFS_size used;                 /* bytes in blocks on this fs */
+    struct qlist_head blocks;       /* oldest first */
+    struct qlist_head link;
+};
+
+struct ra_file;
+
+struct ra_block
+{
+    struct ra_file *file;
+    PVFS_offset off;
+    PVFS_size len;
+    char *buf;
+    PVFS_Request mem_req;
+    PVFS_sysresp_io resp;
+    PVFS_sys_op_id op_id;           /* -1 once collected */
+    int error;
+    int used;                       /* some of it was copied to a reader */
+    int stale;                      /* never to be used; drop when done */
+    PVFS_time posted_ms;
+    struct qlist_head file_link;    /* on file->blocks, by offset */
+    struct qlist_head fs_link;      /* on fs->blocks */
+};
+
+struct ra_file
+{
+    PVFS_object_ref ref;
+    struct ra_fs *fs;
+    struct qhash_head hash_link;
+    struct qlist_head lru_link;
+    int refcount;
+    int gen;                        /* bumped by PINT_racache_invalidate */
+    gen_mutex_t mutex;
+    int seen_gen;                   /* gen when blocks were last checked */
+    struct qlist_head blocks;
+    PVFS_offset last_off;           /* the last read */
+    PVFS_size last_len;
+    PVFS_size stride;               /* 0 for a sequential stream */
+    int run;                        /* reads that followed the pattern */
+    PVFS_size unit;                 /* stripe width, 0 until known */
+    PVFS_size window;               /* how far to read ahead */
+    PVFS_offset next;               /* end of what has been read ahead */
+    PVFS_offset eof;                /* -1 until a block comes back short */
+    PVFS_time eof_ms;
+};
+
+static struct qhash_table *ra_table = NULL;
+static QLIST_HEAD(ra_fs_list);
+static QLIST_HEAD(ra_lru_list);     /* files, least recently read first */
+static int ra_file_count = 0;
+static gen_mutex_t ra_mutex = GEN_MUTEX_INITIALIZER;
+static struct PINT_perf_counter *racache_pc = NULL;
+
+static int ra_compare(const void *key, struct qhash_head *link)
+{
+    const PVFS_object_ref *ref = key;
+    struct ra_file *f = qhash_entry(link, struct ra_file, hash_link);
+
+    return (f->ref.handle == ref->handle && f->ref.fs_id == ref->fs_id);
+}
+
+static int ra_hash(const void *key, int table_size)
+{
+    const PVFS_object_ref *ref = key;
+
+    return (int)((ref->handle ^ (PVFS_handle)ref->fs_id) % table_size);
+}
+
+/* ra_mutex must be held */
+static struct ra_fs *ra_fs_find(PVFS_fs_id fs_id)
+{
+    struct ra_fs *fs;
+
+    qlist_for_each_entry(fs, &ra_fs_list, link)
+    {
+        if (fs->fs_id == fs_id)
+        {
+            return fs;
+        }
+    }
+    return NULL;
+}
+
+/* ra_mutex must be held, and f unreferenced with no blocks */
+static void ra_free_file(struct ra_file *f)
+{
+    qhash_del(&f->hash_link);
+    qlist_del(&f->lru_link);
+    ra_file_count--;
+    gen_mutex_destroy(&f->mutex);
+    free(f);
+}
+
+/* finds the file and takes a reference to it, creating it on fs if fs is
+ * given; ra_mutex must be held
+ */
+static struct ra_file *ra_get(PVFS_object_ref ref, struct ra_fs *fs)
+{
+    struct qhash_head *link;
+    struct ra_file *f, *o;
+
+    if (!ra_table)
+    {
+        return NULL;
+    }
+    link = qhash_search(ra_table, &ref);
+    if (link)
+    {
+        f = qhash_entry(link, struct ra_file, hash_link);
+        qlist_del(&f->lru_link);
+    }
+    else
+    {
+        if (!fs)
+        {
+            return NULL;
+        }
+        if (ra_file_count >= RACACHE_MAX_FILES)
+        {
+            /* forget the least recently read file that has nothing
+             * outstanding; ones that do are forgotten once evicted
+             */
+            qlist_for_each_entry(o, &ra_lru_list, lru_link)
+            {
+                if (o->refcount == 0 && qlist_empty(&o->blocks))
+                {
+                    ra_free_file(o);
+                    break;
+                }
+            }
+        }
+        f = calloc(1, sizeof(*f));
+        if (!f)
+        {
+            return NULL;
+        }
+        f->ref = ref;
+        f->fs = fs;
+        f->eof = -1;
+        gen_mutex_init(&f->mutex);
+        INIT_QLIST_HEAD(&f->blocks);
+        qhash_add(ra_table, &f->ref, &f->hash_link);
+        ra_file_count++;
+    }
+    qlist_add_tail(&f->lru_link, &ra_lru_list);
+    f->refcount++;
+    return f;
+}
+
+static void ra_put(struct ra_file *f)
+{
+    gen_mutex_lock(&ra_mutex);
+    f->refcount--;
+    gen_mutex_unlock(&ra_mutex);
+}
+
+/* true if b's read has finished and can be collected without waiting;
+ * only a hint, since the state machine may still be terminating
+ */
+static int ra_done(struct ra_block *b)
+{
+    PINT_smcb *smcb;
+
+    if (b->op_id == -1)
+    {
+        return 1;
+    }
+    smcb = PINT_id_gen_safe_lookup(b->op_id);
+    return (!smcb || PINT_smcb_complete(smcb));
+}
+
+/* waits for b's read if it is still outstanding; f->mutex must be held */
+static int ra_collect(struct ra_block *b)
+{
+    struct ra_file *f = b->file;
+    int ret, error = 0;
+
+    if (b->op_id != -1)
+    {
+        ret = PVFS_sys_wait(b->op_id, "io", &error);
+        if (ret < 0)
+        {
+            error = ret;
+        }
+        PINT_sys_release(b->op_id);
+        b->op_id = -1;
+        b->error = error;
+
+        if (!b->error && b->resp.total_completed < b->len &&
+            !b->stale)
+        {
+            /* nothing is read ahead past here until the eof is stale */
+            f->eof = b->off + b->resp.total_completed;
+            f->eof_ms = b->posted_ms;
+        }
+    }
+    return b->error;
+}
+
+/* frees b, waiting for its read first; f->mutex must be held */
+static void ra_drop(struct ra_block *b)
+{
+    ra_collect(b);
+
+    gen_mutex_lock(&ra_mutex);
+    b->file->fs->used -= b->len;
+    qlist_del(&b->fs_link);
+    gen_mutex_unlock(&ra_mutex);
+    qlist_del(&b->file_link);
+
+    PINT_perf_count(racache_pc, PERF_RACACHE_BYTES, b->len, PINT_PERF_SUB);
+    if (!b->used)
+    {
+        PINT_perf_count(racache_pc, PERF_RACACHE_WASTED_BYTES, b->len,
+                        PINT_PERF_ADD);
+    }
+    PVFS_Request_free(&b->mem_req);
+    free(b->buf);
+    free(b);
+}
+
+/* frees every block of f and forgets how far ahead it had read;
+ * f->mutex must be held
+ */
+static void ra_drop_all(struct ra_file *f)
+{
+    struct ra_block *b, *tmp;
+
+    qlist_for_each_entry_safe(b, tmp, &f->blocks, file_link)
+    {
+        ra_drop(b);
+    }
+    f->next = 0;
+    f->window = 0;
+}
+
+/* marks blocks ending at or before end as stale, or all of them if end
+ * is -1, and frees the stale blocks that have finished; f->mutex must be
+ * held
+ */
+static void ra_trim(struct ra_file *f, PVFS_offset end)
+{
+    struct ra_block *b, *tmp;
+
+    qlist_for_each_entry_safe(b, tmp, &f->blocks, file_link)
+    {
+        if (end == -1 || b->off + b->len <= end)
+        {
+            b->stale = 1;
+        }
+        if (b->stale && ra_done(b))
+        {
+            ra_drop(b);
+        }
+    }
+    if (end == -1)
+    {
+        f->next = 0;
+        f->window = 0;
+    }
+}
+
+/* drops the blocks of other files on f's file system, oldest first,
+ * until len more bytes fit under its limit; f->mutex must be held.
+ * Returns 1 if they fit.
+ */
+static int ra_make_room(struct ra_file *f, PVFS_size len)
+{
+    struct ra_block *b;
+    struct ra_file *victim;
+    int tries;
+
+    for (tries = 0; ; tries++)
+    {
+        gen_mutex_lock(&ra_mutex);
+        if (f->fs->used + len <= f->fs->limit)
+        {
+            gen_mutex_unlock(&ra_mutex);
+            return 1;
+        }
+        victim = NULL;
+        if (tries < RACACHE_EVICT_TRIES)
+        {
+            qlist_for_each_entry(b, &f->fs->blocks, fs_link)
+            {
+                if (b->file != f)
+                {
+                    victim = b->file;
+                    break;
+                }
+            }
+        }
+        if (!victim)
+        {
+            gen_mutex_unlock(&ra_mutex);
+            return 0;
+        }
+        victim->refcount++;
+        gen_mutex_unlock(&ra_mutex);
+
+        /* whoever holds it is reading from it; try someone else */
+        if (gen_mutex_trylock(&victim->mutex) == 0)
+        {
+            ra_drop_all(victim);
+            gen_mutex_unlock(&victim->mutex);
+        }
+        ra_put(victim);
+    }
+}
+
+/* posts a read ahead of len bytes at off; f->mutex must be held */
+static int ra_post(struct ra_file *f, PVFS_offset off, PVFS_size len,
+                   const PVFS_credential *credential)
+{
+    struct ra_block *b, *o;
+    struct qlist_head *pos;
+    int ret;
+
+    if (!ra_make_room(f, len))
+    {
+        return -PVFS_ENOSPC;
+    }
+
+    b = calloc(1, sizeof(*b));
+    if (!b)
+    {
+        return -PVFS_ENOMEM;
+    }
+    b->buf = malloc(len);
+    if (!b->buf)
+    {
+        free(b);
+        return -PVFS_ENOMEM;
+    }
+    ret = PVFS_Request_contiguous((int32_t)len, PVFS_BYTE, &b->mem_req);
+    if (ret < 0)
+    {
+        free(b->buf);
+        free(b);
+        return ret;
+    }
+    b->file = f;
+    b->off = off;
+    b->len = len;
+    b->op_id = -1;
+    b->posted_ms = PINT_util_get_time_ms();
+
+    /* keep the file's blocks in offset order */
+    pos = &f->blocks;
+    qlist_for_each_entry(o, &f->blocks, file_link)
+    {
+        if (o->off > off)
+        {
+            pos = &o->file_link;
+            break;
+        }
+    }
+    qlist_add_tail(&b->file_link, pos);
+
+    gen_mutex_lock(&ra_mutex);
+    f->fs->used += len;
+    qlist_add_tail(&b->fs_link, &f->fs->blocks);
+    gen_mutex_unlock(&ra_mutex);
+    PINT_perf_count(racache_pc, PERF_RACACHE_BYTES, len, PINT_PERF_ADD);
+
+    gossip_debug(GOSSIP_CLIENT_DEBUG, "racache: reading %lld bytes at %lld "
+                 "of %llu ahead\n", lld(len), lld(off), llu(f->ref.handle));
+
+    ret = PINT_sys_io_prefetch(f->ref, off, b->buf, b->mem_req, credential,
+                               &b->resp, &b->op_id);
+    if (ret < 0)
+    {
+        b->op_id = -1;
+        b->error = ret;
+        b->stale = 1;
+        ra_drop(b);
+        return ret;
+    }
+    PINT_perf_count(racache_pc, PERF_RACACHE_PREFETCHES, 1, PINT_PERF_ADD);
+    PINT_perf_count(racache_pc, PERF_RACACHE_PREFETCH_BYTES, len,
+                    PINT_PERF_ADD);
+    return 0;
+}
+
+/* copies [off, off + count) into buffer if blocks that have not gone
+ * stale cover all of it; f->mutex must be held.  A block that came back
+ * short ends the copy there, as a read from the servers would.
+ * Returns 1 if anything was copied.
+ */
+static int ra_copy(struct ra_file *f, PVFS_offset off, PVFS_size count,
+                   char *buffer, PVFS_size *completed)
+{
+    struct ra_block *b;
+    PVFS_offset pos = off, end = off + count, avail;
+    PVFS_size n;
+
+    qlist_for_each_entry(b, &f->blocks, file_link)
+    {
+        if (b->stale || b->off + b->len <= pos)
+        {
+            continue;
+        }
+        if (b->off > pos)
+        {
+            break;
+        }
+        pos = b->off + b->len;
+        if (pos >= end)
+        {
+            break;
+        }
+    }
+    if (pos < end)
+    {
+        return 0;
+    }
+
+    pos = off;
+    qlist_for_each_entry(b, &f->blocks, file_link)
+    {
+        if (b->stale || b->off + b->len <= pos)
+        {
+            continue;
+        }
+        if (b->off > pos)
+        {
+            break;
+        }
+        if (b->op_id != -1)
+        {
+            PINT_perf_count(racache_pc, PERF_RACACHE_WAITS, 1,
+                            PINT_PERF_ADD);
+        }
+        if (ra_collect(b) < 0)
+        {
+            b->stale = 1;
+            return 0;
+        }
+        avail = b->off + b->resp.total_completed;
+        if (avail <= pos)
+        {
+            break;
+        }
+        n = ((avail < end) ? avail : end) - pos;
+        memcpy(buffer + (pos - off), b->buf + (pos - b->off), n);
+        b->used = 1;
+        pos += n;
+        if (pos >= end || avail < b->off + b->len)
+        {
+            break;
+        }
+    }
+    if (pos == off)
+    {
+        return 0;
+    }
+    *completed = pos - off;
+    return 1;
+}
+
+/* follows f's stream with a read of count bytes at off; f->mutex must be
+ * held
+ */
+static void ra_note(struct ra_file *f, PVFS_offset off, PVFS_size count)
+{
+    PVFS_offset last_end = f->last_off + f->last_len;
+
+    if (f->last_len > 0 && off == last_end)
+    {
+        if (f->stride)
+        {
+            ra_trim(f, -1);
+            f->stride = 0;
+            f->run = 1;
+        }
+        f->run++;
+    }
+    else if (f->stride && count == f->last_len &&
+             off == f->last_off + f->stride)
+    {
+        f->run++;
+    }
+    else
+    {
+        ra_trim(f, -1);
+        if (f->last_len > 0 && count == f->last_len && off > last_end)
+        {
+            /* a candidate stride, followed if the next read agrees */
+            f->stride = off - f->last_off;
+            f->run = 2;
+        }
+        else
+        {
+            f->stride = 0;
+            f->run = 1;
+        }
+    }
+    f->last_off = off;
+    f->last_len = count;
+}
+
+/**
+ * Initializes the racache.
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_racache_initialize(void)
+{
+    gen_mutex_lock(&ra_mutex);
+    ra_table = qhash_init(ra_compare, ra_hash, RACACHE_TABLE_SIZE);
+    if (!ra_table)
+    {
+        gen_mutex_unlock(&ra_mutex);
+        return -PVFS_ENOMEM;
+    }
+    racache_pc = PINT_perf_initialize(PINT_PERF_COUNTER, racache_keys,
+                                      client_perf_start_rollover);
+    if (!racache_pc)
+    {
+        gossip_err("Error: PINT_perf_initialize failure.\n");
+        qhash_finalize(ra_table);
+        ra_table = NULL;
+        gen_mutex_unlock(&ra_mutex);
+        return -PVFS_ENOMEM;
+    }
+    gen_mutex_unlock(&ra_mutex);
+    return 0;
+}
+
+/**
+ * Releases the racache.  Reads still outstanding must have been
+ * collected first with PINT_racache_drain().
+ */
+void PINT_racache_finalize(void)
+{
+    struct ra_fs *fs, *tmp;
+    struct ra_file *f, *ftmp;
+    struct ra_block *b, *btmp;
+
+    gen_mutex_lock(&ra_mutex);
+    qlist_for_each_entry_safe(f, ftmp, &ra_lru_list, lru_link)
+    {
+        qlist_for_each_entry_safe(b, btmp, &f->blocks, file_link)
+        {
+            PVFS_Request_free(&b->mem_req);
+            free(b->buf);
+            free(b);
+        }
+        ra_free_file(f);
+    }
+    if (ra_table)
+    {
+        qhash_finalize(ra_table);
+        ra_table = NULL;
+    }
+    qlist_for_each_entry_safe(fs, tmp, &ra_fs_list, link)
+    {
+        qlist_del(&fs->link);
+        free(fs);
+    }
+    if (racache_pc)
+    {
+        PINT_perf_finalize(racache_pc);
+        racache_pc = NULL;
+    }
+    gen_mutex_unlock(&ra_mutex);
+}
+
+/**
+ * Sets how many bytes may be read ahead for a file system; 0 turns
+ * read-ahead off for it.  Reads already outstanding are not affected.
+ */
+void PINT_racache_set_limit(PVFS_fs_id fs_id, PVFS_size limit)
+{
+    struct ra_fs *fs;
+
+    gen_mutex_lock(&ra_mutex);
+    fs = ra_fs_find(fs_id);
+    if (!fs && limit > 0)
+    {
+        fs = calloc(1, sizeof(*fs));
+        if (fs)
+        {
+            fs->fs_id = fs_id;
+            INIT_QLIST_HEAD(&fs->blocks);
+            qlist_add_tail(&fs->link, &ra_fs_list);
+        }
+    }
+    if (fs)
+    {
+        fs->limit = limit;
+        gossip_debug(GOSSIP_CLIENT_DEBUG, "racache: reading up to %lld "
+                     "bytes ahead for fs %d\n", lld(limit), (int)fs_id);
+    }
+    gen_mutex_unlock(&ra_mutex);
+}
+
+/**
+ * Offers a read to the racache, and notes it in the file's stream.
+ * Data read ahead that the stream has passed is released.
+ *
+ * \return 1 if the read was copied from data read ahead and completed
+ * is set, 0 if the caller must send it
+ */
+int PINT_racache_read(
+    PVFS_object_ref refn,
+    PVFS_Request file_req,
+    PVFS_offset file_req_offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    PVFS_size *completed)
+{
+    struct ra_fs *fs;
+    struct ra_file *f;
+    PVFS_size count;
+    PVFS_time now;
+    unsigned int timeout = 0;
+    struct ra_block *b;
+    int gen, hit = 0;
+
+    gen_mutex_lock(&ra_mutex);
+    fs = ra_fs_find(refn.fs_id);
+    f = (fs && fs->limit > 0) ? ra_get(refn, fs) : NULL;
+    gen = f ? f->gen : 0;
+    gen_mutex_unlock(&ra_mutex);
+    if (!f)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&f->mutex);
+    count = PINT_REQUEST_TOTAL_BYTES(mem_req);
+    now = PINT_util_get_time_ms();
+    PINT_acache_get_info(ACACHE_TIMEOUT_MSECS, &timeout);
+
+    if (gen != f->seen_gen)
+    {
+        ra_trim(f, -1);
+        f->eof = -1;
+        f->seen_gen = gen;
+    }
+    if (f->eof != -1 && f->eof_ms + timeout <= now)
+    {
+        f->eof = -1;
+    }
+    qlist_for_each_entry(b, &f->blocks, file_link)
+    {
+        if (b->posted_ms + timeout <= now)
+        {
+            b->stale = 1;
+        }
+    }
+
+    if (!PINT_io_is_byte_range(file_req, mem_req))
+    {
+        ra_trim(f, -1);
+        f->last_len = 0;
+        f->stride = 0;
+        f->run = 0;
+        goto out;
+    }
+
+    hit = ra_copy(f, file_req_offset, count, buffer, completed);
+    ra_note(f, file_req_offset, count);
+    if (hit)
+    {
+        ra_trim(f, file_req_offset + count);
+        f->window *= 2;
+    }
+    else
+    {
+        ra_trim(f, file_req_offset);
+    }
+
+  out:
+    PINT_perf_count(racache_pc, hit ? PERF_RACACHE_HITS :
+                    PERF_RACACHE_MISSES, 1, PINT_PERF_ADD);
+    gen_mutex_unlock(&f->mutex);
+    ra_put(f);
+    return hit;
+}
+
+/**
+ * Reads ahead of the file's stream, if it has one, as far as its window
+ * and the file system's limit allow.  Called after each read has been
+ * served or posted, so that the read itself goes to the servers first.
+ */
+void PINT_racache_readahead(
+    PVFS_object_ref refn,
+    const PVFS_credential *credential)
+{
+    struct ra_file *f;
+    PVFS_size unit, max_window, len;
+    PVFS_offset end, off;
+    int i, depth;
+
+    gen_mutex_lock(&ra_mutex);
+    f = ra_get(refn, NULL);
+    gen_mutex_unlock(&ra_mutex);
+    if (!f)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&f->mutex);
+    if (f->fs->limit <= 0 || f->last_len == 0 ||
+        f->run < (f->stride ? RACACHE_STRIDED_RUN : RACACHE_SEQ_RUN))
+    {
+        goto out;
+    }
+
+    if (!f->unit)
+    {
+        f->unit = PINT_cached_stripe_width(refn);
+    }
+    unit = f->unit ? f->unit : RACACHE_DEFAULT_UNIT;
+    if (unit > f->fs->limit / 2)
+    {
+        unit = f->fs->limit / 2;
+    }
+    if (unit <= 0)
+    {
+        goto out;
+    }
+    max_window = RACACHE_MAX_STRIPES * unit;
+    if (max_window > f->fs->limit / 2)
+    {
+        max_window = f->fs->limit / 2;
+    }
+    if (f->window < unit)
+    {
+        f->window = unit;
+    }
+    if (f->window > max_window)
+    {
+        f->window = max_window;
+    }
+
+    end = f->last_off + f->last_len;
+    if (!f->stride)
+    {
+        /* whole stripes, so that each read ahead keeps every server busy */
+        if (f->next < end)
+        {
+            f->next = end;
+        }
+        while (f->next < end + f->window &&
+               (f->eof == -1 || f->next < f->eof))
+        {
+            len = unit - f->next % unit;
+            if (ra_post(f, f->next, len, credential) < 0)
+            {
+                break;
+            }
+            f->next += len;
+        }
+    }
+    else
+    {
+        depth = (int)(f->window / f->stride);
+        if (depth < 1)
+        {
+            depth = 1;
+        }
+        if (depth > RACACHE_MAX_STRIDED)
+        {
+            depth = RACACHE_MAX_STRIDED;
+        }
+        for (i = 1; i <= depth; i++)
+        {
+            off = f->last_off + i * f->stride;
+            if (off < f->next)
+            {
+                continue;
+            }
+            if ((f->eof != -1 && off >= f->eof) ||
+                ra_post(f, off, f->last_len, credential) < 0)
+            {
+                break;
+            }
+            f->next = off + f->last_len;
+        }
+    }
+
+  out:
+    gen_mutex_unlock(&f->mutex);
+    ra_put(f);
+}
+
+/**
+ * Stops data read ahead for a file from being used, because this client
+ * has changed it.  Safe to call from a state machine; the data itself is
+ * released by the file's next read.
+ */
+void PINT_racache_invalidate(PVFS_object_ref refn)
+{
+    struct qhash_head *link;
+    struct ra_file *f;
+
+    gen_mutex_lock(&ra_mutex);
+    if (ra_table && ra_file_count > 0)
+    {
+        link = qhash_search(ra_table, &refn);
+        if (link)
+        {
+            f = qhash_entry(link, struct ra_file, hash_link);
+            f->gen++;
+        }
+    }
+    gen_mutex_unlock(&ra_mutex);
+}
+
+/**
+ * Turns read-ahead off for a file system, or for all of them if fs_id
+ * is PVFS_FS_ID_NULL, and waits for and releases everything read ahead
+ * there.
+ */
+void PINT_racache_drain(PVFS_fs_id fs_id)
+{
+    struct ra_fs *fs;
+    struct ra_file *f;
+
+    gen_mutex_lock(&ra_mutex);
+    qlist_for_each_entry(fs, &ra_fs_list, link)
+    {
+        if (fs_id == PVFS_FS_ID_NULL || fs->fs_id == fs_id)
+        {
+            fs->limit = 0;
+        }
+    }
+    gen_mutex_unlock(&ra_mutex);
+
+    while (1)
+    {
+        f = NULL;
+        gen_mutex_lock(&ra_mutex);
+        qlist_for_each_entry(fs, &ra_fs_list, link)
+        {
+            if ((fs_id == PVFS_FS_ID_NULL || fs->fs_id == fs_id) &&
+                !qlist_empty(&fs->blocks))
+            {
+                f = qlist_entry(fs->blocks.next, struct ra_block,
+                                fs_link)->file;
+                f->refcount++;
+                break;
+            }
+        }
+        gen_mutex_unlock(&ra_mutex);
+        if (!f)
+        {
+            break;
+        }
+
+        gen_mutex_lock(&f->mutex);
+        ra_drop_all(f);
+        gen_mutex_unlock(&f->mutex);
+        ra_put(f);
+    }
+}
+
+/**
+ * Returns the perf counter associated with the racache.  RACACHE_HITS
+ * against RACACHE_MISSES shows how much of a read stream was served from
+ * data read ahead, and RACACHE_WASTED_BYTES how much was read for
+ * nothing.
+ */
+struct PINT_perf_counter* PINT_racache_get_pc(void)
+{
+    return racache_pc;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
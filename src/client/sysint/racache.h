@@ -0,0 +1,93 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __RACACHE_H
+#define __RACACHE_H
+
+#include "pvfs2-types.h"
+#include "pvfs2-request.h"
+#include "pint-perf-counter.h"
+
+/** \defgroup racache Read-ahead Cache (racache)
+ *
+ * The racache watches the reads made through PVFS_isys_io() on each
+ * file, and once they form a sequential or strided stream it reads the
+ * next part of the stream ahead of the application, so that a single
+ * reader keeps several stripes' worth of requests outstanding on the
+ * servers instead of one.  It is off unless the mount has a
+ * readahead=<bytes> option in the tab file, in which case no more than
+ * that many bytes are read ahead for the file system at once.
+ *
+ * Sequential streams are read ahead a stripe at a time, starting with
+ * one stripe and doubling while the data read ahead is being used.
+ * Strided streams (reads of one length separated by one stride) have
+ * their next few reads made individually.  A read that is wholly
+ * covered by data read ahead is copied from it; anything else goes to
+ * the servers as before.
+ *
+ * Data read ahead is dropped when this client writes to, truncates or
+ * removes the file, and is not used once it is older than the acache
+ * timeout, so changes made by other clients are seen on the same terms
+ * as attribute changes.
+ *
+ * @{
+ */
+
+/** \file
+ * Declarations for the Read-ahead Cache (racache) component.
+ */
+
+enum
+{
+    PERF_RACACHE_HITS = 0,
+    PERF_RACACHE_MISSES = 1,
+    PERF_RACACHE_PREFETCHES = 2,
+    PERF_RACACHE_PREFETCH_BYTES = 3,
+    PERF_RACACHE_WASTED_BYTES = 4,
+    PERF_RACACHE_BYTES = 5,
+    PERF_RACACHE_WAITS = 6,
+};
+
+int PINT_racache_initialize(void);
+
+void PINT_racache_finalize(void);
+
+void PINT_racache_set_limit(
+    PVFS_fs_id fs_id,
+    PVFS_size limit);
+
+int PINT_racache_read(
+    PVFS_object_ref refn,
+    PVFS_Request file_req,
+    PVFS_offset file_req_offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    PVFS_size *completed);
+
+void PINT_racache_readahead(
+    PVFS_object_ref refn,
+    const PVFS_credential *credential);
+
+void PINT_racache_invalidate(
+    PVFS_object_ref refn);
+
+void PINT_racache_drain(
+    PVFS_fs_id fs_id);
+
+struct PINT_perf_counter* PINT_racache_get_pc(void);
+
+#endif /* __RACACHE_H */
+
+/* @} */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,747 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pvfs2-sysint.h"
+#include "pvfs2-attr.h"
+#include "pvfs2-debug.h"
+#include "pvfs2-internal.h"
+#include "pint-request.h"
+#include "pint-sysint-utils.h"
+#include "client-state-machine.h"
+#include "security-util.h"
+#include "acache.h"
+#include "wbcache.h"
+#include "gen-locks.h"
+#include "quickhash.h"
+#include "quicklist.h"
+#include "gossip.h"
+
+/** \file
+ *  \ingroup wbcache
+ * Implementation of the Write-back Buffer (wbcache) component.
+ *
+ * Each file with held data has one buffer covering a byte range that
+ * never crosses a stripe boundary; when the range reaches the boundary
+ * it is sent as a single write, which the I/O state machine turns into
+ * one flow per server.  The stripe size comes from the distribution in
+ * the acache once the file is unstuffed; until it is known ranges are
+ * WBCACHE_DEFAULT_FLOW long.
+ *
+ * wb_mutex protects the tables, reference counts, dirty totals and the
+ * position of each buffer, and is never held while talking to a server,
+ * so it is safe to take from inside a state machine.  Each file's own
+ * mutex is held by whoever is copying data into or sending data out of
+ * its buffer, which may include a blocking write.
+ */
+
+enum
+{
+    WBCACHE_TABLE_SIZE = 127,
+    WBCACHE_DEFAULT_FLOW = 1048576,
+    WBCACHE_MIN_ALLOC = 65536,
+    WBCACHE_EVICT_TRIES = 4,
+};
+
+struct PINT_perf_key wbcache_keys[] =
+{
+    {"WBCACHE_WRITES_HELD", PERF_WBCACHE_WRITES_HELD, 0},
+    {"WBCACHE_BYTES_HELD", PERF_WBCACHE_BYTES_HELD, 0},
+    {"WBCACHE_FLOWS", PERF_WBCACHE_FLOWS, 0},
+    {"WBCACHE_WRITES_THROUGH", PERF_WBCACHE_WRITES_THROUGH, 0},
+    {"WBCACHE_DIRTY_BYTES", PERF_WBCACHE_DIRTY_BYTES, PINT_PERF_PRESERVE},
+    {"WBCACHE_ERRORS", PERF_WBCACHE_ERRORS, 0},
+    {NULL, 0, 0},
+};
+
+/* a file system mounted with the wbcache option */
+struct wb_fs
+{
+    PVFS_fs_id fs_id;
+    PVFS_size limit;                /* 0 once the option is withdrawn */
+    PVFS_size dirty;                /* bytes held for files on this fs */
+    struct qlist_head link;
+};
+
+struct wb_file
+{
+    PVFS_object_ref ref;
+    struct wb_fs *fs;
+    struct qhash_head hash_link;
+    struct qlist_head dirty_link;   /* on dirty_list while buf is set */
+    int refcount;
+    gen_mutex_t mutex;
+    PVFS_size flow;                 /* stripe size, 0 until known */
+    char *buf;
+    PVFS_size alloc;
+    PVFS_offset off;                /* file offset of buf[0] */
+    PVFS_size len;
+    PVFS_credential cred;           /* of the latest write held */
+    int have_cred;
+    int discard;                    /* removed; drop buf instead of sending */
+    int error;                      /* from sending, until PINT_wbcache_sync */
+};
+
+static struct qhash_table *wb_table = NULL;
+static QLIST_HEAD(wb_fs_list);
+static QLIST_HEAD(dirty_list);      /* oldest first */
+static gen_mutex_t wb_mutex = GEN_MUTEX_INITIALIZER;
+static struct PINT_perf_counter *wbcache_pc = NULL;
+
+static int wb_compare(const void *key, struct qhash_head *link)
+{
+    const PVFS_object_ref *ref = key;
+    struct wb_file *f = qhash_entry(link, struct wb_file, hash_link);
+
+    return (f->ref.handle == ref->handle && f->ref.fs_id == ref->fs_id);
+}
+
+static int wb_hash(const void *key, int table_size)
+{
+    const PVFS_object_ref *ref = key;
+
+    return (int)((ref->handle ^ (PVFS_handle)ref->fs_id) % table_size);
+}
+
+/* wb_mutex must be held */
+static struct wb_fs *wb_fs_find(PVFS_fs_id fs_id)
+{
+    struct wb_fs *fs;
+
+    qlist_for_each_entry(fs, &wb_fs_list, link)
+    {
+        if (fs->fs_id == fs_id)
+        {
+            return fs;
+        }
+    }
+    return NULL;
+}
+
+/* finds the file and takes a reference to it, creating it on fs if fs is
+ * given; wb_mutex must be held
+ */
+static struct wb_file *wb_get(PVFS_object_ref ref, struct wb_fs *fs)
+{
+    struct qhash_head *link;
+    struct wb_file *f;
+
+    if (!wb_table)
+    {
+        return NULL;
+    }
+    link = qhash_search(wb_table, &ref);
+    if (link)
+    {
+        f = qhash_entry(link, struct wb_file, hash_link);
+    }
+    else
+    {
+        if (!fs)
+        {
+            return NULL;
+        }
+        f = calloc(1, sizeof(*f));
+        if (!f)
+        {
+            return NULL;
+        }
+        f->ref = ref;
+        f->fs = fs;
+        gen_mutex_init(&f->mutex);
+        INIT_QLIST_HEAD(&f->dirty_link);
+        qhash_add(wb_table, &f->ref, &f->hash_link);
+    }
+    f->refcount++;
+    return f;
+}
+
+static void wb_put(struct wb_file *f)
+{
+    gen_mutex_lock(&wb_mutex);
+    if (--f->refcount == 0 && !f->buf && !f->error)
+    {
+        qhash_del(&f->hash_link);
+        if (f->have_cred)
+        {
+            PINT_cleanup_credential(&f->cred);
+        }
+        gen_mutex_destroy(&f->mutex);
+        free(f);
+    }
+    gen_mutex_unlock(&wb_mutex);
+}
+
+/* sends whatever f holds and empties its buffer; f->mutex must be held */
+static int wb_send(struct wb_file *f)
+{
+    int ret = 0;
+    PVFS_Request mem_req = NULL;
+    PVFS_sysresp_io resp;
+
+    if (!f->buf)
+    {
+        return 0;
+    }
+
+    if (!f->discard && f->len > 0)
+    {
+        gossip_debug(GOSSIP_CLIENT_DEBUG, "wbcache: sending %lld bytes at "
+                     "%lld of %llu\n", lld(f->len), lld(f->off),
+                     llu(f->ref.handle));
+
+        ret = PVFS_Request_contiguous((int32_t)f->len, PVFS_BYTE, &mem_req);
+        if (ret == 0)
+        {
+            memset(&resp, 0, sizeof(resp));
+            ret = PINT_sys_io_uncached(f->ref, PVFS_BYTE, f->off, f->buf,
+                                       mem_req, &f->cred, &resp,
+                                       PVFS_IO_WRITE);
+            PVFS_Request_free(&mem_req);
+            if (ret == 0 && resp.total_completed != f->len)
+            {
+                ret = -PVFS_EIO;
+            }
+        }
+        PINT_perf_count(wbcache_pc, PERF_WBCACHE_FLOWS, 1, PINT_PERF_ADD);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("wbcache: sending held data failed", ret);
+            PINT_perf_count(wbcache_pc, PERF_WBCACHE_ERRORS, 1,
+                            PINT_PERF_ADD);
+        }
+    }
+
+    gen_mutex_lock(&wb_mutex);
+    if (ret < 0 && !f->error)
+    {
+        f->error = ret;
+    }
+    f->fs->dirty -= f->len;
+    PINT_perf_count(wbcache_pc, PERF_WBCACHE_DIRTY_BYTES, f->len,
+                    PINT_PERF_SUB);
+    qlist_del_init(&f->dirty_link);
+    free(f->buf);
+    f->buf = NULL;
+    f->alloc = 0;
+    f->len = 0;
+    f->discard = 0;
+    gen_mutex_unlock(&wb_mutex);
+    return ret;
+}
+
+/* sends the oldest held data on f's file system until need more bytes
+ * fit under its limit; f->mutex must be held.  Returns 1 if they fit.
+ */
+static int wb_make_room(struct wb_file *f, PVFS_size need)
+{
+    struct wb_file *victim, *o;
+    int tries;
+
+    for (tries = 0; ; tries++)
+    {
+        gen_mutex_lock(&wb_mutex);
+        if (f->fs->dirty + need <= f->fs->limit)
+        {
+            gen_mutex_unlock(&wb_mutex);
+            return 1;
+        }
+        victim = NULL;
+        if (tries < WBCACHE_EVICT_TRIES)
+        {
+            qlist_for_each_entry(o, &dirty_list, dirty_link)
+            {
+                if (o->fs == f->fs)
+                {
+                    victim = o;
+                    break;
+                }
+            }
+        }
+        if (!victim)
+        {
+            gen_mutex_unlock(&wb_mutex);
+            return 0;
+        }
+        victim->refcount++;
+        gen_mutex_unlock(&wb_mutex);
+
+        if (victim == f)
+        {
+            wb_send(f);
+        }
+        else if (gen_mutex_trylock(&victim->mutex) == 0)
+        {
+            /* whoever holds it is already sending or adding to it */
+            wb_send(victim);
+            gen_mutex_unlock(&victim->mutex);
+        }
+        wb_put(victim);
+    }
+}
+
+/* makes room in f's buffer for len more bytes; f->mutex must be held */
+static int wb_grow(struct wb_file *f, PVFS_size want, PVFS_size cap)
+{
+    PVFS_size alloc;
+    char *buf;
+
+    if (want <= f->alloc)
+    {
+        return 0;
+    }
+    alloc = f->alloc ? 2 * f->alloc : WBCACHE_MIN_ALLOC;
+    if (alloc < want)
+    {
+        alloc = want;
+    }
+    if (alloc > cap)
+    {
+        alloc = cap;
+    }
+    buf = realloc(f->buf, alloc);
+    if (!buf)
+    {
+        return -PVFS_ENOMEM;
+    }
+    gen_mutex_lock(&wb_mutex);
+    f->buf = buf;
+    f->alloc = alloc;
+    gen_mutex_unlock(&wb_mutex);
+    return 0;
+}
+
+/* appends data at the end of f's held range, starting a new range at pos
+ * if nothing is held; f->mutex must be held and room already made
+ */
+static void wb_append(struct wb_file *f, PVFS_offset pos,
+                      const char *data, PVFS_size count,
+                      const PVFS_credential *credential)
+{
+    memcpy(f->buf + f->len, data, count);
+
+    gen_mutex_lock(&wb_mutex);
+    if (f->len == 0)
+    {
+        f->off = pos;
+        qlist_del(&f->dirty_link);
+        qlist_add_tail(&f->dirty_link, &dirty_list);
+    }
+    f->len += count;
+    f->fs->dirty += count;
+    gen_mutex_unlock(&wb_mutex);
+
+    PINT_perf_count(wbcache_pc, PERF_WBCACHE_DIRTY_BYTES, count,
+                    PINT_PERF_ADD);
+
+    if (!f->have_cred || f->cred.userid != credential->userid ||
+        f->cred.timeout < credential->timeout)
+    {
+        PVFS_credential cred;
+
+        if (PINT_copy_credential(credential, &cred) == 0)
+        {
+            if (f->have_cred)
+            {
+                PINT_cleanup_credential(&f->cred);
+            }
+            f->cred = cred;
+            f->have_cred = 1;
+        }
+    }
+}
+
+/**
+ * Initializes the wbcache.
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_wbcache_initialize(void)
+{
+    gen_mutex_lock(&wb_mutex);
+    wb_table = qhash_init(wb_compare, wb_hash, WBCACHE_TABLE_SIZE);
+    if (!wb_table)
+    {
+        gen_mutex_unlock(&wb_mutex);
+        return -PVFS_ENOMEM;
+    }
+    wbcache_pc = PINT_perf_initialize(PINT_PERF_COUNTER, wbcache_keys,
+                                      client_perf_start_rollover);
+    if (!wbcache_pc)
+    {
+        gossip_err("Error: PINT_perf_initialize failure.\n");
+        qhash_finalize(wb_table);
+        wb_table = NULL;
+        gen_mutex_unlock(&wb_mutex);
+        return -PVFS_ENOMEM;
+    }
+    gen_mutex_unlock(&wb_mutex);
+    return 0;
+}
+
+/**
+ * Releases the wbcache.  Anything still held is dropped, so callers that
+ * care send it first with PINT_wbcache_flush_fs().
+ */
+void PINT_wbcache_finalize(void)
+{
+    struct wb_fs *fs, *tmp;
+    struct qhash_head *link;
+    struct wb_file *f;
+    int i;
+
+    gen_mutex_lock(&wb_mutex);
+    if (wb_table)
+    {
+        for (i = 0; i < wb_table->table_size; i++)
+        {
+            while ((link = qhash_search_and_remove_at_index(wb_table, i)))
+            {
+                f = qhash_entry(link, struct wb_file, hash_link);
+                if (f->len > 0)
+                {
+                    gossip_err("wbcache: dropping %lld unsent bytes of "
+                               "%llu\n", lld(f->len), llu(f->ref.handle));
+                }
+                if (f->have_cred)
+                {
+                    PINT_cleanup_credential(&f->cred);
+                }
+                gen_mutex_destroy(&f->mutex);
+                free(f->buf);
+                free(f);
+            }
+        }
+        qhash_finalize(wb_table);
+        wb_table = NULL;
+    }
+    INIT_QLIST_HEAD(&dirty_list);
+    qlist_for_each_entry_safe(fs, tmp, &wb_fs_list, link)
+    {
+        qlist_del(&fs->link);
+        free(fs);
+    }
+    if (wbcache_pc)
+    {
+        PINT_perf_finalize(wbcache_pc);
+        wbcache_pc = NULL;
+    }
+    gen_mutex_unlock(&wb_mutex);
+}
+
+/**
+ * Sets how many bytes may be held for a file system; 0 turns holding
+ * off for it.  Data already held is not sent by this call.
+ */
+void PINT_wbcache_set_limit(PVFS_fs_id fs_id, PVFS_size limit)
+{
+    struct wb_fs *fs;
+
+    gen_mutex_lock(&wb_mutex);
+    fs = wb_fs_find(fs_id);
+    if (!fs && limit > 0)
+    {
+        fs = calloc(1, sizeof(*fs));
+        if (fs)
+        {
+            fs->fs_id = fs_id;
+            qlist_add_tail(&fs->link, &wb_fs_list);
+        }
+    }
+    if (fs)
+    {
+        fs->limit = limit;
+        gossip_debug(GOSSIP_CLIENT_DEBUG, "wbcache: holding up to %lld "
+                     "bytes for fs %d\n", lld(limit), (int)fs_id);
+    }
+    gen_mutex_unlock(&wb_mutex);
+}
+
+/**
+ * Offers a write to the wbcache.  Any data held for the file that this
+ * write does not continue is sent first, so a write that is not held
+ * can always go straight to the servers afterwards.
+ *
+ * \return 1 if the write was held, 0 if the caller must send it
+ */
+int PINT_wbcache_write(
+    PVFS_object_ref refn,
+    PVFS_Request file_req,
+    PVFS_offset file_req_offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    const PVFS_credential *credential)
+{
+    struct wb_fs *fs;
+    struct wb_file *f;
+    PVFS_size count, flow, first, boundary, rest_alloc = 0;
+    char *rest = NULL;
+    int held = 0;
+
+    gen_mutex_lock(&wb_mutex);
+    fs = wb_fs_find(refn.fs_id);
+    f = wb_get(refn, (fs && fs->limit > 0) ? fs : NULL);
+    gen_mutex_unlock(&wb_mutex);
+    if (!f)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&f->mutex);
+    count = PINT_REQUEST_TOTAL_BYTES(mem_req);
+
+    if (!f->flow && !f->buf)
+    {
+        f->flow = PINT_cached_stripe_width(refn);
+    }
+    flow = f->flow ? f->flow : WBCACHE_DEFAULT_FLOW;
+    if (flow > f->fs->limit)
+    {
+        flow = f->fs->limit;
+    }
+
+    if (f->buf && (f->discard || file_req_offset != f->off + f->len))
+    {
+        wb_send(f);
+    }
+
+    if (!PINT_io_is_byte_range(file_req, mem_req) || count >= flow ||
+        !wb_make_room(f, count))
+    {
+        wb_send(f);
+        goto out;
+    }
+
+    /* the held range ends at the next stripe boundary; a write that
+     * crosses it fills this range, which is sent, and starts the next
+     */
+    boundary = ((f->buf ? f->off : file_req_offset) / flow + 1) * flow;
+    first = boundary - file_req_offset;
+    if (first > count)
+    {
+        first = count;
+    }
+    if (wb_grow(f, f->len + first, boundary - (f->buf ? f->off :
+                                               file_req_offset)) < 0)
+    {
+        wb_send(f);
+        goto out;
+    }
+    if (first < count)
+    {
+        rest_alloc = WBCACHE_MIN_ALLOC < flow ? WBCACHE_MIN_ALLOC : flow;
+        if (rest_alloc < count - first)
+        {
+            rest_alloc = count - first;
+        }
+        rest = malloc(rest_alloc);
+        if (!rest)
+        {
+            wb_send(f);
+            goto out;
+        }
+    }
+
+    wb_append(f, file_req_offset, buffer, first, credential);
+    if (f->off + f->len == boundary)
+    {
+        wb_send(f);
+    }
+    if (rest)
+    {
+        gen_mutex_lock(&wb_mutex);
+        f->buf = rest;
+        f->alloc = rest_alloc;
+        gen_mutex_unlock(&wb_mutex);
+        wb_append(f, file_req_offset + first, (char *)buffer + first,
+                  count - first, credential);
+    }
+    held = 1;
+
+    PINT_perf_count(wbcache_pc, PERF_WBCACHE_WRITES_HELD, 1, PINT_PERF_ADD);
+    PINT_perf_count(wbcache_pc, PERF_WBCACHE_BYTES_HELD, count,
+                    PINT_PERF_ADD);
+
+  out:
+    if (!held)
+    {
+        PINT_perf_count(wbcache_pc, PERF_WBCACHE_WRITES_THROUGH, 1,
+                        PINT_PERF_ADD);
+    }
+    gen_mutex_unlock(&f->mutex);
+    wb_put(f);
+    return held;
+}
+
+/**
+ * Sends any data held for a file.  Errors are kept for PINT_wbcache_sync.
+ */
+void PINT_wbcache_flush(PVFS_object_ref refn)
+{
+    struct wb_file *f;
+
+    gen_mutex_lock(&wb_mutex);
+    f = wb_get(refn, NULL);
+    gen_mutex_unlock(&wb_mutex);
+    if (!f)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&f->mutex);
+    wb_send(f);
+    gen_mutex_unlock(&f->mutex);
+    wb_put(f);
+}
+
+/**
+ * Sends any data held for a file and collects the first error from
+ * sending its data since the last call.
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_wbcache_sync(PVFS_object_ref refn)
+{
+    struct wb_file *f;
+    int ret;
+
+    gen_mutex_lock(&wb_mutex);
+    f = wb_get(refn, NULL);
+    gen_mutex_unlock(&wb_mutex);
+    if (!f)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&f->mutex);
+    wb_send(f);
+    gen_mutex_lock(&wb_mutex);
+    ret = f->error;
+    f->error = 0;
+    gen_mutex_unlock(&wb_mutex);
+    gen_mutex_unlock(&f->mutex);
+    wb_put(f);
+    return ret;
+}
+
+/**
+ * Sends everything held for a file system, or for all of them if fs_id
+ * is PVFS_FS_ID_NULL.
+ * \return 0 on success, or the first error seen
+ */
+int PINT_wbcache_flush_fs(PVFS_fs_id fs_id)
+{
+    struct wb_file *f, *o;
+    int ret, error = 0;
+
+    while (1)
+    {
+        f = NULL;
+        gen_mutex_lock(&wb_mutex);
+        qlist_for_each_entry(o, &dirty_list, dirty_link)
+        {
+            if (fs_id == PVFS_FS_ID_NULL || o->ref.fs_id == fs_id)
+            {
+                f = o;
+                f->refcount++;
+                break;
+            }
+        }
+        gen_mutex_unlock(&wb_mutex);
+        if (!f)
+        {
+            break;
+        }
+
+        gen_mutex_lock(&f->mutex);
+        ret = wb_send(f);
+        gen_mutex_unlock(&f->mutex);
+        wb_put(f);
+        if (ret < 0 && !error)
+        {
+            error = ret;
+        }
+    }
+    return error;
+}
+
+/**
+ * Drops whatever is held for a file that has been removed.  Safe to call
+ * from a state machine.
+ */
+void PINT_wbcache_discard(PVFS_object_ref refn)
+{
+    struct wb_file *f;
+
+    gen_mutex_lock(&wb_mutex);
+    f = wb_get(refn, NULL);
+    if (f)
+    {
+        f->discard = (f->buf != NULL);
+        f->error = 0;
+    }
+    gen_mutex_unlock(&wb_mutex);
+    if (!f)
+    {
+        return;
+    }
+
+    /* if someone else has it they will drop the data themselves */
+    if (gen_mutex_trylock(&f->mutex) == 0)
+    {
+        wb_send(f);
+        gen_mutex_unlock(&f->mutex);
+    }
+    wb_put(f);
+}
+
+/**
+ * Reports where the data held for a file ends, so that a getattr can
+ * include it in the file size.  Safe to call from a state machine.
+ * \return 1 if data is held and size was set, 0 otherwise
+ */
+int PINT_wbcache_get_size(PVFS_object_ref refn, PVFS_size *size)
+{
+    struct qhash_head *link;
+    struct wb_file *f;
+    int ret = 0;
+
+    gen_mutex_lock(&wb_mutex);
+    if (wb_table && !qlist_empty(&dirty_list))
+    {
+        link = qhash_search(wb_table, &refn);
+        if (link)
+        {
+            f = qhash_entry(link, struct wb_file, hash_link);
+            if (f->len > 0 && !f->discard)
+            {
+                *size = f->off + f->len;
+                ret = 1;
+            }
+        }
+    }
+    gen_mutex_unlock(&wb_mutex);
+    return ret;
+}
+
+/**
+ * Returns the perf counter associated with the wbcache.  The ratio of
+ * WBCACHE_WRITES_HELD to WBCACHE_FLOWS is the number of writes that were
+ * sent together on average.
+ */
+struct PINT_perf_counter* PINT_wbcache_get_pc(void)
+{
+    return wbcache_pc;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,98 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __WBCACHE_H
+#define __WBCACHE_H
+
+#include "pvfs2-types.h"
+#include "pvfs2-request.h"
+#include "pint-perf-counter.h"
+
+/** \defgroup wbcache Write-back Buffer (wbcache)
+ *
+ * The wbcache holds back small sequential writes to a file and sends
+ * them to the servers together, one stripe at a time, so that an
+ * application appending a few hundred bytes per write pays one round
+ * trip per stripe rather than one per write.  It is off unless the
+ * mount has a wbcache=<bytes> option in the tab file, in which case no
+ * more than that many bytes are held for the file system at once.
+ *
+ * Only writes that are smaller than a stripe, contiguous in memory and
+ * given as a plain byte range of the file are held.  A write that does
+ * not continue the data already held for its file first sends that data
+ * out.  Held data is also sent before a read, truncate or setattr of
+ * the file, by PVFS_sys_flush(), when the file system is removed and at
+ * PVFS_sys_finalize().  A getattr reports the size including held data,
+ * so the server's size is only brought up to date when the data is
+ * sent.
+ *
+ * Errors from writing held data are kept with the file and returned
+ * by the next PVFS_sys_flush() of it.  Held data is visible only to
+ * this client until it is sent.
+ *
+ * @{
+ */
+
+/** \file
+ * Declarations for the Write-back Buffer (wbcache) component.
+ */
+
+enum
+{
+    PERF_WBCACHE_WRITES_HELD = 0,
+    PERF_WBCACHE_BYTES_HELD = 1,
+    PERF_WBCACHE_FLOWS = 2,
+    PERF_WBCACHE_WRITES_THROUGH = 3,
+    PERF_WBCACHE_DIRTY_BYTES = 4,
+    PERF_WBCACHE_ERRORS = 5,
+};
+
+int PINT_wbcache_initialize(void);
+
+void PINT_wbcache_finalize(void);
+
+void PINT_wbcache_set_limit(
+    PVFS_fs_id fs_id,
+    PVFS_size limit);
+
+int PINT_wbcache_write(
+    PVFS_object_ref refn,
+    PVFS_Request file_req,
+    PVFS_offset file_req_offset,
+    void *buffer,
+    PVFS_Request mem_req,
+    const PVFS_credential *credential);
+
+void PINT_wbcache_flush(
+    PVFS_object_ref refn);
+
+int PINT_wbcache_sync(
+    PVFS_object_ref refn);
+
+int PINT_wbcache_flush_fs(
+    PVFS_fs_id fs_id);
+
+void PINT_wbcache_discard(
+    PVFS_object_ref refn);
+
+int PINT_wbcache_get_size(
+    PVFS_object_ref refn,
+    PVFS_size *size);
+
+struct PINT_perf_counter* PINT_wbcache_get_pc(void);
+
+#endif /* __WBCACHE_H */
+
+/* @} */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
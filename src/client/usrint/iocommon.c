@@ -1969,6 +1969,10 @@ size_t sum_iovec_lengths(size_t iovec_count, const struct iovec *vector)
 }
 
 /** Attempt to read a full CACHE_BLOCK_SIZE into the ucache block.
+ *
+ * The block is only read from the file system if no one has filled it yet;
+ * otherwise the data already in it is used.  Any part of the block past
+ * the end of the file is zeroed.
  *
  * Also adjust req_size and req_blk_cnt used in 
  * iocommon_readorwrite to account for the scenarios where less 
@@ -1977,10 +1981,8 @@ size_t sum_iovec_lengths(size_t iovec_count, const struct iovec *vector)
  * Also, fent_size is updated to inform the ucache of the largest file size
  * seen by the ucache related to this file.
  * 
- * Upon ucache block removal, we use the file entry size to determine if the
- * last block held in ucache isn't a full CACHE_BLOCK_SIZE.
- * This ensures that the correct number of bytes are written to the
- * file system on block removal.
+ * The block's fill count records how much of it holds file data, so that
+ * only that much is written back when the block is flushed.
  */
 unsigned char read_full_block_into_ucache(
     pvfs_descriptor *pd, /** Ultimately let's us id the file */
@@ -2000,12 +2002,27 @@ unsigned char read_full_block_into_ucache(
 
     /* Attempt Read of Full Block From file system into user cache */
     struct iovec cache_vec = {req->ublk_ptr, CACHE_BLOCK_SIZE};
-    lock_lock(get_lock(req->ublk_index));
-    vread_count = iocommon_vreadorwrite(PVFS_IO_READ,
-                                        &pd->s->pvfs_ref,
-                                        req->ublk_tag,
-                                        1,
-                                        &cache_vec);
+    ucache_lock_t *blk_lock = ucache_block_lock(req->ublk_index);
+    lock_lock(blk_lock);
+    vread_count = ucache_block_fill(req->ublk_index);
+    if(vread_count == 0)
+    {
+        vread_count = iocommon_vreadorwrite(PVFS_IO_READ,
+                                            &pd->s->pvfs_ref,
+                                            req->ublk_tag,
+                                            1,
+                                            &cache_vec);
+        if(vread_count < 0)
+        {
+            vread_count = 0;
+        }
+        if(vread_count < CACHE_BLOCK_SIZE)
+        {
+            memset((char *)req->ublk_ptr + vread_count, 0,
+                   CACHE_BLOCK_SIZE - vread_count);
+        }
+        ucache_block_set_fill(req->ublk_index, vread_count);
+    }
     
     /* After reading, attempt update of *fent_size */
     if((req->ublk_tag + vread_count) > *fent_size)
@@ -2028,7 +2045,10 @@ unsigned char read_full_block_into_ucache(
          */
         if(offset >= req->ublk_tag)
         {
-            new_req_size = vread_count - (offset - req->ublk_tag);
+            if(offset - req->ublk_tag < vread_count)
+            {
+                new_req_size = vread_count - (offset - req->ublk_tag);
+            }
         }
         else
         {
@@ -2039,14 +2059,25 @@ unsigned char read_full_block_into_ucache(
             /* printf("Request expected:%Zu\tbut only read:%Zu\n", *req_size, new_req_size); */
             *req_size = new_req_size;
         }
-        /* Unlock block */
-        lock_unlock(get_lock(req->ublk_index));
         rfb = 0;
     }
     /* Unlock block */
-    lock_unlock(get_lock(req->ublk_index));
+    lock_unlock(blk_lock);
     return rfb;
 }
+
+/* Drop the pins held on the blocks of a request */
+static void release_ucache_reqs(struct ucache_req_s *ureq, int req_blk_cnt)
+{
+    int i;
+    for(i = 0; i < req_blk_cnt; i++)
+    {
+        if(ureq[i].ublk_ptr != (void *) NILP)
+        {
+            ucache_release(ureq[i].ublk_index);
+        }
+    }
+}
 #endif /* PVFS_UCACHE_ENABLE */
 
 /** Do a blocking read or write, possibly utilizing the user cache.
@@ -2064,10 +2095,8 @@ int iocommon_readorwrite(enum PVFS_io_type which,
     {
         if(!pd->s->fent)
         {
-            lock_lock(ucache_lock);
-            ucache_stats->pseudo_misses++; /* could overflow */
+            __sync_fetch_and_add(&ucache_stats->pseudo_misses, 1);
             these_stats.pseudo_misses++;
-            lock_unlock(ucache_lock);
         }
     }
 
@@ -2114,18 +2143,18 @@ int iocommon_readorwrite(enum PVFS_io_type which,
     /* Now, we know this isn't zero sized request */
     struct file_ent_s *fent = pd->s->fent;
     uint64_t new_file_size = fent->size;
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
     /* how many blocks the R/W request may encompass */
     int req_blk_cnt = calc_req_blk_cnt(offset, req_size);
     int transfered = 0; /* count of the bytes transfered */
 
-    /* If the ucache per file blk request threshold is exceeded, flush and
-     * evict file, then peform nocache version of readorwrite. */
-    if((req_blk_cnt + mtbl->num_blocks) > UCACHE_MAX_BLK_REQ)
+    /* Requests too large to be worth caching are performed without the
+     * ucache, after flushing the file so that they see its cached writes.
+     */
+    if(req_blk_cnt > UCACHE_MAX_BLK_REQ)
     {
         /*
-         * printf("flushing file from ucache, since it's grown too large and "
-         *         "continuing to service request without involving the ucache\n");
+         * printf("flushing file from ucache, since the request is too "
+         *         "large and servicing it without involving the ucache\n");
          */
         /* Flush dirty blocks */
         rc = ucache_flush_file(pd->s->fent);
@@ -2149,6 +2178,8 @@ int iocommon_readorwrite(enum PVFS_io_type which,
     struct ucache_req_s ureq[req_blk_cnt];
     memset(ureq, 0, sizeof(struct ucache_req_s) * req_blk_cnt);
     ureq[0].ublk_tag = offset - (offset % CACHE_BLOCK_SIZE); /* first tag */
+    /* Every block looked up or inserted is pinned until this returns */
+    int ureq_cnt = req_blk_cnt;
 
     int i; /* index used for 'for loops' */
     /* Loop over positions storing tags (ment identifiers) */
@@ -2166,144 +2197,81 @@ int iocommon_readorwrite(enum PVFS_io_type which,
                                        &(this->ublk_index));
         if(this->ublk_ptr == (void *)NIL)
         {
-            lock_lock(ucache_lock);
-            ucache_stats->misses++; /* could overflow */
+            __sync_fetch_and_add(&ucache_stats->misses, 1);
             these_stats.misses++;
-            lock_unlock(ucache_lock);
         }
         else
         {
-            lock_lock(ucache_lock);
-            ucache_stats->hits++;  /* could overflow */
+            __sync_fetch_and_add(&ucache_stats->hits, 1);
             these_stats.hits++;
-            lock_unlock(ucache_lock);
         }
     }
-    if(which == PVFS_IO_READ)
+
+    /* Attempt insertion of blocks reported missed during lookup */
+    for(i = 0; i < req_blk_cnt; i++)
     {
-        /* Loop over ureq structure and perform reads on misses */
-        /* Keep track of how much has been read so we can know if the last
-         * block successfully read is incomplete.
-		 */
-        /* Re-read last block if partial */
-        for(i = 0; i < req_blk_cnt; i++)
+        struct ucache_req_s *this = &ureq[i];
+        if(this->ublk_ptr == (void *) NILP) /* ucache miss on block*/
         {
-            struct ucache_req_s *this = &ureq[i];
-            if(this->ublk_ptr == (void *) NILP) /* ucache miss on block*/
+            this->ublk_ptr = ucache_insert(pd->s->fent,
+                                           this->ublk_tag,
+                                           &(this->ublk_index));
+            /* ucache_insert fail */
+            if(this->ublk_ptr == (void *) NILP)
             {
-                this->ublk_ptr = ucache_insert(pd->s->fent,
-                                               this->ublk_tag,
-                                               &(this->ublk_index));
-                /* ucache_insert fail */
-                if(this->ublk_ptr == (void *) NILP)
-                {
-                    /* Cannot cache the rest of this file */
-                    /* either try some other sort of eviction or perform no cache */
-
-                    /** Alert the user that we are no longer caching this file,
-                     * since we couldn't obtain a free cache block.
-                     */
-                    /*TODO make this a gossip statement */
-                    /* printf("Flushing file from cache. Couldn't obtain block.\n"); */
-
-                    /* Flush dirty blocks */
-                    rc = ucache_flush_file(pd->s->fent);
-                    if(rc != 0)
-                    {
-                        /* TODO: alert user there was an error when flushing
-                         * the ucache
-                         */
-                        printf("warning: error detected when flushing file"
-                               " from ucache.\n");
-                    }
-                    /* Bypass the ucache */
-                    rc = iocommon_vreadorwrite(which,
-                                               &pd->s->pvfs_ref,
-                                               offset,
-                                               iovec_count,
-                                               vector);
-                    return rc;
-                }
-
-                /* Attempt read of full block from fs into ucache.
-                 * Remember this locks, reads into, then unlocks the specifed
-                 * block provided by this->ublk_ptr
+                /* Every block is pinned by some request, so perform this
+                 * one without the ucache.
                  */
-                if(!read_full_block_into_ucache(
-                    pd, offset, this, i, &new_file_size, &req_size, &req_blk_cnt)
-                )
+                release_ucache_reqs(ureq, ureq_cnt);
+
+                /* Flush dirty blocks */
+                rc = ucache_flush_file(pd->s->fent);
+                if(rc != 0)
                 {
-                    /* Stop trying to read if we couldn't read a full bock
-                     * this time
+                    /* TODO: alert user there was an error when flushing
+                     * the ucache
                      */
-                    break;
+                    printf("warning: error detected when flushing file"
+                           " from ucache.\n");
                 }
+                /* Bypass the ucache */
+                rc = iocommon_vreadorwrite(which,
+                                           &pd->s->pvfs_ref,
+                                           offset,
+                                           iovec_count,
+                                           vector);
+                return rc;
             }
         }
     }
 
-    /* Read beginning and end blks into cache before writing if
-     * either end of the request are unalligned.
-     */
-    if(which == PVFS_IO_WRITE) /* Write */
+    if(which == PVFS_IO_READ)
     {
-        unsigned char first_block_hit = 0;
-        unsigned char last_block_hit = 0;
-
-        /* Attempt insertion of blocks reported missed during lookup */
+        /* Make sure each block holds its data, reading in the ones no one
+         * has filled yet.  Stop at the first block the file doesn't fill,
+         * trimming the request to the end of the file.
+         */
         for(i = 0; i < req_blk_cnt; i++)
         {
-            struct ucache_req_s *this = &ureq[i];
-            if(this->ublk_ptr == (void *) NILP) /* ucache miss on block*/
-            {
-                /* Attempt to make room for missed blocks */
-                this->ublk_ptr = ucache_insert(pd->s->fent,
-                                               this->ublk_tag,
-                                               &(this->ublk_index));
-                /* ucache_insert fail */
-                if(this->ublk_ptr == (void *) NILP)
-                {
-                    /* Cannot cache the rest of this file */
-                    /* either try some other sort of eviction or perform no cache */
-
-                    /** Alert the user that we are no longer caching this file,
-                     * since we couldn't obtain a free cache block.
-                     */
-                    /*TODO make this a gossip statement */
-                    printf("Flushing file from cache. Couldn't obtain block.\n");
-
-                    /* Flush dirty blocks */
-                    rc = ucache_flush_file(pd->s->fent);
-                    if(rc != 0)
-                    {
-                        /* TODO: alert user there was an error when flushing
-                         * the ucache
-                         */
-                        printf("warning: error detected when flushing file"
-                               " from ucache.\n");
-                    }
-                    /* Bypass the ucache */
-                    rc = iocommon_vreadorwrite(which,
-                                               &pd->s->pvfs_ref,
-                                               offset,
-                                               iovec_count,
-                                               vector);
-                    return rc;
-                }
-            }
-            else /* Block was hit */
+            if(!read_full_block_into_ucache(
+                pd, offset, &ureq[i], i, &new_file_size, &req_size, &req_blk_cnt)
+            )
             {
-                if(i == 0)
-                {
-                    first_block_hit = 1;
-                }
-                if(i == (req_blk_cnt - 1))
-                {
-                    last_block_hit = 1;
-                }
+                break;
             }
         }
+        if(req_size == 0)
+        {
+            release_ucache_reqs(ureq, ureq_cnt);
+            return 0;
+        }
+    }
 
+    /* Read beginning and end blks into cache before writing if
+     * either end of the request are unalligned.
+     */
+    if(which == PVFS_IO_WRITE) /* Write */
+    {
         /* We aren't concerned about ucache block on the interior of this
          * request, so we are only concerned about first and the last ucache
          * blocks of this request. */
@@ -2313,47 +2281,38 @@ int iocommon_readorwrite(enum PVFS_io_type which,
          * block */
         if((ureq[0].ublk_tag != offset) || (req_size < CACHE_BLOCK_SIZE))
         {
-            /* If the first block was missed */
-            if(first_block_hit == 0)
-            {
-                /* We create copies of the following two variables so that
-                 * read_full_block_into_ucache won't adjust the originals
-                 * like we intend on PVFS_IO_READ.
-                 * Note that new_file_size may still be modified.
-                 */
-                size_t copy_of_req_size = req_size;
-                int copy_of_req_blk_cnt = req_blk_cnt;
-                read_full_block_into_ucache(pd,
-                                            offset,
-                                            &ureq[0],
-                                            0,
-                                            &new_file_size,
-                                            &copy_of_req_size,
-                                            &copy_of_req_blk_cnt);
-            }
+            /* We create copies of the following two variables so that
+             * read_full_block_into_ucache won't adjust the originals
+             * like we intend on PVFS_IO_READ.
+             * Note that new_file_size may still be modified.
+             */
+            size_t copy_of_req_size = req_size;
+            int copy_of_req_blk_cnt = req_blk_cnt;
+            read_full_block_into_ucache(pd,
+                                        offset,
+                                        &ureq[0],
+                                        0,
+                                        &new_file_size,
+                                        &copy_of_req_size,
+                                        &copy_of_req_blk_cnt);
         }
         /* Last block if there is one and the write won't complete the block */
         if((req_blk_cnt > 1) && ((offset + req_size) % CACHE_BLOCK_SIZE != 0))
         {
-            /* If the last block was missed or if it was hit and the ucache
-             * block is currently incomplete from a ucache perspective. */
-            if(last_block_hit == 0)
-            {
-                /* We create copies of the following two variables so that
-                 * read_full_block_into_ucache won't adjust the originals
-                 * like we intend on PVFS_IO_READ.
-                 * Note that new_file_size may still be modified.
-                 */
-                size_t copy_of_req_size = req_size;
-                int copy_of_req_blk_cnt = req_blk_cnt;
-                read_full_block_into_ucache(pd,
-                                            offset,
-                                            &ureq[req_blk_cnt -1],
-                                            req_blk_cnt - 1,
-                                            &new_file_size,
-                                            &copy_of_req_size,
-                                            &copy_of_req_blk_cnt);
-            }
+            /* We create copies of the following two variables so that
+             * read_full_block_into_ucache won't adjust the originals
+             * like we intend on PVFS_IO_READ.
+             * Note that new_file_size may still be modified.
+             */
+            size_t copy_of_req_size = req_size;
+            int copy_of_req_blk_cnt = req_blk_cnt;
+            read_full_block_into_ucache(pd,
+                                        offset,
+                                        &ureq[req_blk_cnt -1],
+                                        req_blk_cnt - 1,
+                                        &new_file_size,
+                                        &copy_of_req_size,
+                                        &copy_of_req_blk_cnt);
         }
 
         /* After reading, attempt update of new_file_size */
@@ -2363,13 +2322,9 @@ int iocommon_readorwrite(enum PVFS_io_type which,
         }
 
         /* Now that we're sure of what the new file size will be,
-         * lock the global ucache lock and adjust the file entry's size
-         * as perceived by the ucache, then unlock the ucache.
+         * adjust the file entry's size as perceived by the ucache.
          */
-        lock_lock(ucache_lock);
-        fent->size = new_file_size;
-        /* printf("fent->size = %lu KB\n", fent->size / 1024); */
-        lock_unlock(ucache_lock);
+        ucache_update_size(fent, new_file_size);
     }
 
     /* At this point we know how many blocks the request will cover, the tags
@@ -2405,11 +2360,19 @@ int iocommon_readorwrite(enum PVFS_io_type which,
     int ureq_index = 0;
     for(i = 0; i < copy_count; i++)
     {
+        struct ucache_req_s *this = &ureq[ureq_index];
+        ucache_lock_t *blk_lock = ucache_block_lock(this->ublk_index);
         /* perform copy operation */
-        lock_lock(get_lock(ureq[ureq_index].ublk_index));
+        lock_lock(blk_lock);
         transfered += cache_readorwrite(which, &ucop[i]);
+        if(which == PVFS_IO_WRITE)
+        {
+            ucache_block_dirty(this->ublk_index,
+                               (char *)ucop[i].cache_pos + ucop[i].size -
+                               (char *)this->ublk_ptr);
+        }
         /* Unlock the block */
-        lock_unlock(get_lock(ureq[ureq_index].ublk_index));
+        lock_unlock(blk_lock);
         /* Check if this ucop completed this block, so we can adjust the
          * ureq_index accordingly */
         if((offset + transfered) >=
@@ -2418,6 +2381,7 @@ int iocommon_readorwrite(enum PVFS_io_type which,
             ureq_index++;
         }
     }
+    release_ucache_reqs(ureq, ureq_cnt);
     return transfered;
 #endif /* PVFS_UCACHE_ENABLE */
 }
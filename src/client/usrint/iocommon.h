@@ -36,7 +36,7 @@ struct ucache_req_s
 {
     uint64_t ublk_tag; /* ucache block tag (byte index into file) */
     void *ublk_ptr; /* where in ucache memory to read block from or write to */
-    uint16_t ublk_index; /* index of ucache block in shared memory segment */
+    uint64_t ublk_index; /* index of ucache block in shared memory segment */
 };
 
 struct ucache_copy_s
@@ -44,7 +44,7 @@ struct ucache_copy_s
     void *cache_pos;
     void *buff_pos;
     size_t size;
-    uint16_t blk_index;
+    uint64_t blk_index;
 };
 
 
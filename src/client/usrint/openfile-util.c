@@ -2161,7 +2161,7 @@ static pvfs_descriptor *get_desc_table_entry(int newfd,
         {
             /* We have the file identifiers
              * so insert file info into ucache
-             * this fills in mtbl
+             * this fills in the file entry
              */
             ucache_open_file(&(file_ref->fs_id),
                              &(file_ref->handle), 
@@ -4,15 +4,33 @@
  * See COPYING in top-level directory.
  */
 
-/** 
- * \file  
+/**
+ * \file
  * \ingroup usrint
- * 
- * Experimental cache for user data. 
  *
+ * Experimental cache for user data.
+ *
+ * The cache is one shared memory segment used by every process on the node.
+ * It holds BLOCKS_IN_CACHE data blocks, a descriptor for each block, an
+ * index of the blocks keyed on file entry and offset, and a table of the
+ * files with blocks in the cache.
+ *
+ * The block index is a hash table whose buckets are split among
+ * UCACHE_LOCK_STRIPES locks, so processes working on different files, or
+ * on different blocks of the same file, seldom wait for each other.  A hit
+ * takes only the stripe lock of its bucket.  Each file entry also has a
+ * lock of its own that guards the list of the file's blocks, used to flush
+ * and drop them.  The global lock guards only the file table.
+ *
+ * A block is pinned while a request is using it and a pinned block is never
+ * reused.  Blocks are reused in CLOCK order: a shared hand sweeps the block
+ * descriptors, clearing the reference bit set by each hit and taking the
+ * first unpinned block whose bit is already clear.  Dirty blocks are
+ * written out before they are reused.
  */
 #include <pvfs2-config.h>
 #include <gen-locks.h>
+#include <sched.h>
 /* #include <malloc.h> */
 #include "usrint.h"
 #include "posix-ops.h"
@@ -24,21 +42,19 @@
 /* Global Variables */
 FILE *out;                   /* For Logging Purposes */
 
-/* static uint32_t ucache_blk_cnt = 0; */
-
 /* Global pointers to data in shared mem. Pointers set in ucache_initialize */
-union ucache_u *ucache = 0;
+struct ucache_s *ucache = 0;
 struct ucache_aux_s *ucache_aux = 0; /* All locks and stats stored here */
 
-/* ucache_aux is a pointer to the actual data summarized by the following 
- * pointers 
+/* ucache_aux is a pointer to the actual data summarized by the following
+ * pointers
 */
 ucache_lock_t *ucache_locks = 0; /* The shmem of all ucache locks */
-ucache_lock_t *ucache_lock = 0;  /* Global Lock maintaining concurrency */
+ucache_lock_t *ucache_lock = 0;  /* Global Lock guarding the file table */
 struct ucache_stats_s *ucache_stats = 0; /* Pointer to stats structure*/
 
 /* Per-process (thread) execution statistics */
-struct ucache_stats_s these_stats = { 0, 0, 0, 0, 0 }; 
+struct ucache_stats_s these_stats = { 0 };
 
 /* Flags indicating ucache status */
 int ucache_enabled = 0;
@@ -46,104 +62,43 @@ char ftblInitialized = 0;
 
 /* Internal Only Function Declarations */
 
-/* Initialization */
-static void add_mtbls(uint16_t blk);
-static void init_memory_table(struct mem_table_s *mtbl);
-static inline void init_memory_entry(struct mem_table_s *mtbl, int16_t index);
-
-/* Gets */
-static uint16_t get_next_free_mtbl(uint16_t *free_mtbl_blk, uint16_t *free_mtbl_ent);
-static uint16_t get_free_fent(void);
-static inline uint16_t get_free_ment(struct mem_table_s *mtbl);
-static inline uint16_t get_free_blk(void);
-
-/* Puts */
-static int put_free_mtbl(struct mem_table_s *mtbl, struct file_ent_s *file);
+/* File table */
+static uint32_t lookup_file(uint32_t fs_id, uint64_t handle);
+static uint32_t insert_file(uint32_t fs_id, uint64_t handle);
 static void put_free_fent(struct file_ent_s *fent);
-static void put_free_ment(struct mem_table_s *mtbl, uint16_t ent);
-static inline void put_free_blk(uint16_t blk);
-
-/* File Entry Chain Iterator */
-static unsigned char file_done(uint16_t index);
-static uint16_t file_next(struct file_table_s *ftbl, uint16_t index);
-
-/* Memory Entry Chain Iterator */
-static inline unsigned char ment_done(uint16_t index);
-static inline uint16_t ment_next(struct mem_table_s *mtbl, uint16_t index);
-
-/* Dirty List Iterator */
-static inline unsigned char dirty_done(uint16_t index);
-static inline uint16_t dirty_next(struct mem_table_s *mtbl, uint16_t index);
-
-/* File and Memory Insertion */
-uint16_t insert_file(uint32_t fs_id, uint64_t handle);
-
-static inline void *insert_mem(struct file_ent_s *fent, 
-                                       uint64_t offset, 
-                                    uint16_t *block_ndx
-);
-
-static inline void *set_item(struct file_ent_s *fent,
-                      uint64_t offset, 
-                      uint16_t index
-);
-
-/* File and Memory Lookup */
-static struct mem_table_s *lookup_file(
-    uint32_t fs_id, 
-    uint64_t handle,
-    uint16_t *file_mtbl_blk,    /* Can be NULL if not desired */
-    uint16_t *file_mtbl_ent,  
-    uint16_t *file_ent_index,
-    uint16_t *file_ent_prev_index
-);
-static inline void *lookup_mem(struct mem_table_s *mtbl, 
-                    uint64_t offset, 
-                    uint16_t *item_index,
-                    uint16_t *mem_ent_index,
-                    uint16_t *mem_ent_prev_index
-);
-
-/* File and Memory Entry Removal */
 static int remove_file(struct file_ent_s *fent);
-static int wipe_mtbl(struct mem_table_s *mtbl);
-static int remove_mem(struct file_ent_s *fent, uint64_t offset);
-
-/* Eviction Utilities */
-static uint16_t locate_max_fent(struct file_ent_s **fent);
-static void update_LRU(struct mem_table_s *mtbl, uint16_t index);
-static int evict_LRU(struct file_ent_s *fent);
 
-/* Logging */
-//static void log_ucache_stats(void);
+/* Block index */
+static inline ucache_ndx_t blk_bucket(uint32_t fent_ndx, uint64_t offset);
+static inline ucache_ndx_t lookup_mem(uint32_t fent_ndx,
+                                      uint64_t offset,
+                                      ucache_ndx_t bucket);
+static int unlink_mem(ucache_ndx_t ndx);
 
-/* List Printing Functions */ 
-void print_LRU(struct mem_table_s *mtbl);
-void print_dirty(struct mem_table_s *mtbl);
+/* Eviction Utilities */
+static ucache_ndx_t get_free_blk(uint32_t held_stripe);
+static int claim_blk(ucache_ndx_t ndx, uint32_t held_stripe);
+static inline void unpin_blk(ucache_ndx_t ndx);
 
 /* Flushing of individual files and blocks */
 int flush_file(struct file_ent_s *fent);
-int flush_block(struct file_ent_s *fent, struct mem_ent_s *ment);
+int flush_block(ucache_ndx_t ndx);
 
 /*  Externally Visible API
- *      The following functions are thread/processor safe regarding the cache 
- *      tables and data.      
+ *      The following functions are thread/processor safe regarding the cache
+ *      tables and data.
  */
 
-/**  
- * Initializes the cache. 
- * Mainly, it aquires a previously created shared memory segment used to 
+/**
+ * Initializes the cache.
+ * Mainly, it aquires a previously created shared memory segment used to
  * cache data. The shared mem. creation and ftbl initialization should already
- * have been done by the daemon at this point. 
- * 
- * The whole cache is protected globally by a locking mechanism.
- *
- * Locks (same type as global lock) can be used to protect block level data. 
+ * have been done by the daemon at this point.
  */
 int ucache_initialize(void)
 {
     int rc = 0;
-    //gossip_set_debug_mask(1, GOSSIP_UCACHE_DEBUG);  
+    //gossip_set_debug_mask(1, GOSSIP_UCACHE_DEBUG);
 
     /* Aquire pointers to shmem segments (ucache_aux and ucache) */
     /* shmget segment containing ucache_aux */
@@ -152,7 +107,7 @@ int ucache_initialize(void)
     int aux_shmid = shmget(key, 0, shmflg);
     if(aux_shmid == -1)
     {
-        //gossip_debug(GOSSIP_UCACHE_DEBUG, 
+        //gossip_debug(GOSSIP_UCACHE_DEBUG,
         //    "ucache_initialize - ucache_aux shmget: errno = %d\n", errno);
         return -1;
     }
@@ -160,14 +115,14 @@ int ucache_initialize(void)
     ucache_aux = shmat(aux_shmid, NULL, 0);
     if((long int)ucache_aux == -1)
     {
-        //gossip_debug(GOSSIP_UCACHE_DEBUG,        
+        //gossip_debug(GOSSIP_UCACHE_DEBUG,
         //    "ucache_initialize - ucache_aux shmat: errno = %d\n", errno);
         return -1;
     }
 
     /* Set our global pointers to data in the ucache_aux struct */
     ucache_locks = ucache_aux->ucache_locks;
-    ucache_lock = get_lock(BLOCKS_IN_CACHE);
+    ucache_lock = get_lock(UCACHE_GLOBAL_LOCK);
     ucache_stats = &(ucache_aux->ucache_stats);
 
     /* ucache */
@@ -175,106 +130,86 @@ int ucache_initialize(void)
     int ucache_shmid = shmget(key, 0, shmflg);
     if(ucache_shmid == -1)
     {
-        //gossip_debug(GOSSIP_UCACHE_DEBUG,        
+        //gossip_debug(GOSSIP_UCACHE_DEBUG,
         //    "ucache_initialize - ucache shmget: errno = %d\n", errno);
         return -1;
     }
-    ucache = (union ucache_u *)shmat(ucache_shmid, NULL, 0);
-    if((long int)ucache == -1) 
+    ucache = (struct ucache_s *)shmat(ucache_shmid, NULL, 0);
+    if((long int)ucache == -1)
     {
-        //gossip_debug(GOSSIP_UCACHE_DEBUG,        
+        //gossip_debug(GOSSIP_UCACHE_DEBUG,
         //    "ucache_initialize - ucache shmat: errno = %d\n", errno);
         return -1;
     }
 
-    /* When this process ends we may want to dump ucache stats to a log file */
-    //rc = atexit(log_ucache_stats);    
-
     /* Declare the ucache enabled! */
     ucache_enabled = 1;
     return rc;
 }
 
-/** 
- * Returns a pointer to the mtbl corresponding to the blk & ent. 
- * Input must be reliable otherwise invalid mtbl could be returned.
- */
-inline struct mem_table_s *ucache_get_mtbl(uint16_t mtbl_blk, uint16_t mtbl_ent)
-{
-    if( mtbl_blk < BLOCKS_IN_CACHE &&
-        mtbl_ent < MEM_TABLE_ENTRY_COUNT)
-    {
-        return &(ucache->b[mtbl_blk].mtbl[mtbl_ent]);
-    }
-    else
-    {
-        return (struct mem_table_s *)NILP;
-    }
-}
-
-/** 
+/**
  * Initializes the ucache file table if it hasn't previously been initialized.
- * Although this function is visible, DO NOT CALL THIS FUNCTION. 
+ * Although this function is visible, DO NOT CALL THIS FUNCTION.
  * It is meant to be called in the ucache daemon or during testing.
  * see: src/apps/ucache/ucached.c for more info.
  *
- * Sets the char booelan ftblInitialized when ftbl has been successfully 
+ * Sets the char booelan ftblInitialized when ftbl has been successfully
  * initialized.
- * 
+ *
  * Returns 0 on success, -1 on failure.
  */
 int ucache_init_file_table(char forceCreation)
 {
-    int i;
+    uint64_t i;
 
     /* check if already initialized? */
-    if(ftblInitialized == 1 && !forceCreation) 
+    if(ftblInitialized == 1 && !forceCreation)
     {
         return -1;
     }
-    if(ucache)
-    {
-        memset(ucache, 0, CACHE_SIZE);
-    }
-    else
+    if(!ucache)
     {
         return -1;
     }
-        
 
-    /* initialize mtbl free list table */
-    ucache->ftbl.free_mtbl_blk = NIL16;
-    ucache->ftbl.free_mtbl_ent = NIL16;
-    add_mtbls(0);
-
-    /* set up list of free blocks */
-    ucache->ftbl.free_blk = 1;
-    for (i = 1; i < (BLOCKS_IN_CACHE - 1); i++)
+    /* every block starts out free and unindexed */
+    for(i = 0; i < BLOCKS_IN_CACHE; i++)
+    {
+        struct mem_ent_s *ment = &(ucache->mem[i]);
+        memset(ment, 0, sizeof(*ment));
+        ment->tag = NIL64;
+        ment->next = NIL64;
+        ment->bucket = NIL64;
+        ment->file_prev = NIL64;
+        ment->file_next = NIL64;
+        ment->fent = NIL32;
+    }
+    for(i = 0; i < UCACHE_HASH_BUCKETS; i++)
     {
-        ucache->b[i].mtbl[0].free_list_blk = i + 1;
+        ucache->bucket[i] = NIL64;
     }
-    ucache->b[BLOCKS_IN_CACHE - 1].mtbl[0].free_list_blk = NIL16;
 
     /* set up file hash table */
-    for (i = 0; i < FILE_TABLE_HASH_MAX; i++)
+    struct file_table_s *ftbl = &(ucache->ftbl);
+    memset(ftbl, 0, sizeof(*ftbl));
+    for(i = 0; i < FILE_TABLE_HASH_MAX; i++)
     {
-        ucache->ftbl.file[i].tag_handle = NIL64;
-        ucache->ftbl.file[i].tag_id = NIL32;
-        ucache->ftbl.file[i].mtbl_blk = NIL16;
-        ucache->ftbl.file[i].mtbl_ent = NIL16;
-        ucache->ftbl.file[i].size = NIL64;
-        ucache->ftbl.file[i].next = NIL16;
+        ftbl->bucket[i] = NIL32;
     }
 
-    /* set up list of free hash table entries */
-    ucache->ftbl.free_list = FILE_TABLE_HASH_MAX;
-    for (i = FILE_TABLE_HASH_MAX; i < FILE_TABLE_ENTRY_COUNT - 1; i++)
+    /* set up list of free file entries */
+    ftbl->free_list = 0;
+    for(i = 0; i < FILE_TABLE_ENTRY_COUNT; i++)
     {
-        ucache->ftbl.file[i].mtbl_blk = NIL16;
-        ucache->ftbl.file[i].mtbl_ent = NIL16;
-        ucache->ftbl.file[i].next = i + 1;
+        struct file_ent_s *fent = &(ftbl->file[i]);
+        fent->tag_handle = NIL64;
+        fent->tag_id = NIL32;
+        fent->index = i;
+        fent->size = NIL64;
+        fent->blk_first = NIL64;
+        fent->next = (i + 1 < FILE_TABLE_ENTRY_COUNT) ? i + 1 : NIL32;
     }
-    ucache->ftbl.file[FILE_TABLE_ENTRY_COUNT - 1].next = NIL16;
+    ftbl->clock_hand = 0;
 
     /* Success */
     ftblInitialized = 1;
@@ -283,251 +218,303 @@ int ucache_init_file_table(char forceCreation)
 
 /**
  * Opens a file in ucache.
+ * Returns 0 if the file was added, 1 if it was already present and -1 if
+ * the file table is full.
  */
 int ucache_open_file(PVFS_fs_id *fs_id,
-                     PVFS_handle *handle, 
+                     PVFS_handle *handle,
                      struct file_ent_s **fent)
 {
     int rc = -1;
-    uint16_t file_mtbl_blk;
-    uint16_t file_mtbl_ent;
-    uint16_t file_ent_index;
-    uint16_t file_ent_prev_index;
+    uint32_t ndx;
 
     lock_lock(ucache_lock);
 
-    struct mem_table_s *mtbl = lookup_file((uint32_t)(*fs_id), 
-                                           (uint64_t)(*handle), 
-                                            &file_mtbl_blk, 
-                                            &file_mtbl_ent, 
-                                            &file_ent_index,
-                                            &file_ent_prev_index);
-
-    if(mtbl == (struct mem_table_s *)NIL)
+    ndx = lookup_file((uint32_t)(*fs_id), (uint64_t)(*handle));
+    if(ndx == NIL32)
     {
-        uint16_t fentIndex  = insert_file((uint32_t)*fs_id, (uint64_t)*handle);
-        if(fentIndex > FILE_TABLE_ENTRY_COUNT)
-        {
-            rc = -1;
-            goto done;
-        }
-        *fent = &(ucache->ftbl.file[fentIndex]);
-        if((*fent)->mtbl_blk == NIL16 || (*fent)->mtbl_ent == NIL16)
+        ndx = insert_file((uint32_t)(*fs_id), (uint64_t)(*handle));
+        if(ndx == NIL32)
         {
             rc = -1;
             goto done;
         }
-
-        mtbl = ucache_get_mtbl((*fent)->mtbl_blk, (*fent)->mtbl_ent);
-        if(mtbl == (struct mem_table_s *)NILP)
-        {   
-            /* Error - Could not insert */
-            rc = -1;
-            goto done;
-        }
-        else
-        {
-            /* File Inserted */
-            mtbl->ref_cnt = 1;
-            ucache_stats->file_count++;
-            rc = 0;
-            goto done;
-        }
+        ucache->ftbl.file[ndx].ref_cnt = 1;
+        __sync_fetch_and_add(&ucache_stats->file_count, 1);
+        rc = 0;
     }
     else
     {
         /* File was previously Inserted */
-        mtbl->ref_cnt++;
-        *fent = &(ucache->ftbl.file[file_ent_index]);
+        ucache->ftbl.file[ndx].ref_cnt++;
         rc = 1;
-        goto done;
     }
+    *fent = &(ucache->ftbl.file[ndx]);
 done:
     lock_unlock(ucache_lock);
     return rc;
 }
 
-/** 
- * Returns ptr to block in ucache based on file and offset 
+/**
+ * Returns ptr to block in ucache based on file and offset, or NIL if the
+ * block isn't cached.  The block is pinned and block_ndx set; release it
+ * with ucache_release when done with it.
  */
-inline void *ucache_lookup(struct file_ent_s *fent, uint64_t offset, 
-                                         uint16_t *block_ndx)
+void *ucache_lookup(struct file_ent_s *fent, uint64_t offset,
+                    ucache_ndx_t *block_ndx)
 {
-    if(DBG)
-    {
-        printf("offset = %lu\n", offset);
-    }
     void *retVal = (void *) NIL;
     if(fent)
     {
-        lock_lock(ucache_lock);
-        struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent); 
-        retVal = lookup_mem(mtbl, 
-                            offset, 
-                            block_ndx,
-                            NULL, 
-                            NULL);
-        lock_unlock(ucache_lock);
+        ucache_ndx_t bucket = blk_bucket(fent->index, offset);
+        ucache_lock_t *stripe = get_lock(UCACHE_STRIPE_LOCK(bucket));
+        ucache_ndx_t ndx;
+
+        lock_lock(stripe);
+        ndx = lookup_mem(fent->index, offset, bucket);
+        if(ndx != NIL64)
+        {
+            __sync_fetch_and_add(&ucache->mem[ndx].pin, 1);
+            ucache->mem[ndx].ref = 1;
+            *block_ndx = ndx;
+            retVal = (void *)&(ucache->b[ndx]);
+        }
+        lock_unlock(stripe);
     }
     return retVal;
 }
 
-/** 
- * Prepares the data structures for block storage. 
- * On success, returns a pointer to where the block of data should be written. 
+/**
+ * Prepares the data structures for block storage.
+ * On success, returns a pointer to where the block of data should be written
+ * and sets block_ndx; the block is pinned as by ucache_lookup.  A block just
+ * added has no data yet (see ucache_block_fill).
  * On failure, returns NIL.
  */
-inline void *ucache_insert(struct file_ent_s *fent, 
-                    uint64_t offset, 
-                    uint16_t *block_ndx
-)
+void *ucache_insert(struct file_ent_s *fent,
+                    uint64_t offset,
+                    ucache_ndx_t *block_ndx)
 {
-    lock_lock(ucache_lock);
-    void * retVal = insert_mem(fent, offset, block_ndx);
-    lock_unlock(ucache_lock);
-    return (retVal); 
+    ucache_ndx_t bucket = blk_bucket(fent->index, offset);
+    uint32_t stripe_ndx = UCACHE_STRIPE_LOCK(bucket);
+    ucache_lock_t *stripe = get_lock(stripe_ndx);
+    struct mem_ent_s *ment;
+    ucache_ndx_t ndx;
+
+    lock_lock(stripe);
+    ndx = lookup_mem(fent->index, offset, bucket);
+    if(ndx != NIL64)
+    {
+        /* Someone else inserted it first */
+        __sync_fetch_and_add(&ucache->mem[ndx].pin, 1);
+        goto done;
+    }
+
+    ndx = get_free_blk(stripe_ndx);
+    if(ndx == NIL64)
+    {
+        lock_unlock(stripe);
+        return (void *)NIL;
+    }
+
+    /* The block is claimed (pinned once by us) and on no list */
+    ment = &(ucache->mem[ndx]);
+    ment->tag = offset;
+    ment->fent = fent->index;
+    ment->bucket = bucket;
+    ment->fill = 0;
+    ment->dirty = 0;
+    ment->next = ucache->bucket[bucket];
+    ucache->bucket[bucket] = ndx;
+
+    lock_lock(get_lock(UCACHE_FILE_LOCK(fent->index)));
+    ment->file_prev = NIL64;
+    ment->file_next = fent->blk_first;
+    if(fent->blk_first != NIL64)
+    {
+        ucache->mem[fent->blk_first].file_prev = ndx;
+    }
+    fent->blk_first = ndx;
+    fent->num_blocks++;
+    lock_unlock(get_lock(UCACHE_FILE_LOCK(fent->index)));
+
+    __sync_fetch_and_add(&ucache_stats->block_count, 1);
+done:
+    ucache->mem[ndx].ref = 1;
+    lock_unlock(stripe);
+    *block_ndx = ndx;
+    return (void *)&(ucache->b[ndx]);
 }
 
-#if 0
-/** 
- * Removes a cached block of data from mtbl 
- * Returns 1 on success, 0 on failure.
- */ 
-int ucache_remove(struct file_ent_s *fent, uint64_t offset)
+/**
+ * Drops the pin taken by ucache_lookup or ucache_insert.
+ */
+void ucache_release(ucache_ndx_t block_ndx)
 {
-    int rc = 0;
-    lock_lock(ucache_lock);
-    rc = remove_mem(fent , offset);
-    lock_unlock(ucache_lock);
-    return rc;
+    unpin_blk(block_ndx);
+}
+
+/**
+ * Returns the lock that must be held to read or change the data in a
+ * pinned block.
+ */
+ucache_lock_t *ucache_block_lock(ucache_ndx_t block_ndx)
+{
+    return get_lock(UCACHE_STRIPE_LOCK(ucache->mem[block_ndx].bucket));
+}
+
+/**
+ * Returns the number of bytes at the start of the block that hold file
+ * data; 0 means the block hasn't been read in yet.
+ */
+uint32_t ucache_block_fill(ucache_ndx_t block_ndx)
+{
+    return ucache->mem[block_ndx].fill;
+}
+
+/**
+ * Records how much of the block was read in from the file system.
+ */
+void ucache_block_set_fill(ucache_ndx_t block_ndx, uint32_t fill)
+{
+    ucache->mem[block_ndx].fill = fill;
+}
+
+/**
+ * Marks the block dirty after a write that ended end bytes into it.
+ */
+void ucache_block_dirty(ucache_ndx_t block_ndx, uint32_t end)
+{
+    struct mem_ent_s *ment = &(ucache->mem[block_ndx]);
+    ment->dirty = 1;
+    if(end > ment->fill)
+    {
+        ment->fill = end;
+    }
+}
+
+/**
+ * Raises the file size seen by the ucache to size if it is larger.
+ */
+void ucache_update_size(struct file_ent_s *fent, uint64_t size)
+{
+    lock_lock(get_lock(UCACHE_FILE_LOCK(fent->index)));
+    if(fent->size == NIL64 || size > fent->size)
+    {
+        fent->size = size;
+    }
+    lock_unlock(get_lock(UCACHE_FILE_LOCK(fent->index)));
 }
-#endif
 
-/** 
+/**
  * Flushes the entire ucache's dirty blocks (every file's dirty blocks)
  * Returns 0 on success, -1 on failure
  */
 int ucache_flush_cache(void)
 {
     int rc = 0;
-    lock_lock(ucache_lock);
+    uint32_t i;
     struct file_table_s *ftbl = &ucache->ftbl;
-    int i;
-    for(i = 0; i < FILE_TABLE_HASH_MAX; i++)
+
+    lock_lock(ucache_lock);
+    for(i = 0; i < FILE_TABLE_ENTRY_COUNT; i++)
     {
-        if((ftbl->file[i].tag_handle != NIL64) &&
-               (ftbl->file[i].tag_handle != 0))
+        if(ftbl->file[i].tag_handle == NIL64)
         {
-            /* Iterate accross file table chain. */ 
-            uint16_t j;
-            for(j = i; !file_done(j); j = file_next(ftbl, j))
-            {
-                rc = flush_file(&ftbl->file[j]);
-                if(rc !=0)
-                {
-                    rc = -1;
-                    goto done;
-                }
-            }
+            continue;
+        }
+        rc = flush_file(&ftbl->file[i]);
+        if(rc != 0)
+        {
+            rc = -1;
+            break;
         }
     }
-
-done:
     lock_unlock(ucache_lock);
     return rc;
 }
 
-/** 
+/**
  * Externally visible wrapper of the internal flush file function.
- * This is intended to allow an external flush file call which locks the 
- * global lock, flushes the file, then releases the global lock.
- * To prevent deadlock, do not call this in any function that aquires the 
- * global lock.
  * Returns 0 on success, -1 on failure.
  */
 int ucache_flush_file(struct file_ent_s *fent)
 {
-    int rc = 0;
-    lock_lock(ucache_lock);
-    rc = flush_file(fent);
-    lock_unlock(ucache_lock);
-    return rc;
+    return flush_file(fent);
 }
 
-/** 
- * Internal only function - Flushes dirty blocks to the I/O Nodes 
+/**
+ * Internal only function - Flushes dirty blocks to the I/O Nodes
+ *
+ * The file's lock is not held while a block is written; instead each block
+ * is pinned under the file's lock, which keeps it on the file's list (see
+ * unlink_mem), and its stripe lock taken to write it.
+ *
  * Returns 0 on success and -1 on failure.
  */
 int flush_file(struct file_ent_s *fent)
 {
     int rc = 0;
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
-    PVFS_object_ref ref = {fent->tag_handle, fent->tag_id, 0};
+    ucache_lock_t *file_lock = get_lock(UCACHE_FILE_LOCK(fent->index));
+    ucache_ndx_t i, next;
 
-    uint16_t i;
-    uint16_t temp_next = NIL16;
-    for(i = mtbl->dirty_list; !dirty_done(i); i = temp_next)
+    lock_lock(file_lock);
+    for(i = fent->blk_first; i != NIL64; i = next)
     {
-        struct mem_ent_s *ment = &(mtbl->mem[i]);
-        if(ment->tag == NIL64 || ment->item == NIL16)
-        {
-            break;
-        }
-
-        /* Aquire block lock - TODO:check if this is redundant due to global lock */
-        ucache_lock_t *blk_lock = get_lock(ment->item);
-        lock_lock(blk_lock);
-
-        temp_next = mtbl->mem[i].dirty_next;
-        mtbl->mem[i].dirty_next = NIL16; 
+        struct mem_ent_s *ment = &(ucache->mem[i]);
+        __sync_fetch_and_add(&ment->pin, 1);
+        lock_unlock(file_lock);
 
-        struct iovec vector =
+        if(ment->dirty)
         {
-            &(ucache->b[ment->item].mblk[0]),
-            0
-        };
-
-        /** Check the file size , so that we know how much to write to disk.
-         */
-        /* Determine how much data is left to flush based on file size */
-        if((fent->size - ment->tag) < (CACHE_BLOCK_SIZE_K * 1024))
-        {
-            vector.iov_len = fent->size - ment->tag;
-        }
-        else
-        {
-            vector.iov_len = CACHE_BLOCK_SIZE_K * 1024;
+            ucache_lock_t *blk_lock = ucache_block_lock(i);
+            lock_lock(blk_lock);
+            if(ment->dirty)
+            {
+                rc = flush_block(i);
+            }
+            lock_unlock(blk_lock);
         }
 
-        rc = iocommon_vreadorwrite(2, &ref, ment->tag, 1, &vector); 
-
-        lock_unlock(blk_lock);
+        lock_lock(file_lock);
+        next = ment->file_next;
+        unpin_blk(i);
         if(rc == -1)
         {
-           goto done; 
+            break;
         }
     }
-    mtbl->dirty_list = NIL16;
-    rc = 0;
-done:
+    lock_unlock(file_lock);
     return rc;
 }
 
 /**
- * This function is meant to be called only inside remove_mem.
- * Returns 0 on success, -1 on failure 
+ * Writes the data in a dirty block to the file system and marks it clean.
+ * The block's stripe lock must be held and the block pinned.
+ * Returns 0 on success, -1 on failure
  */
-int flush_block(struct file_ent_s *fent, struct mem_ent_s *ment)
+int flush_block(ucache_ndx_t ndx)
 {
     int rc = 0;
+    struct mem_ent_s *ment = &(ucache->mem[ndx]);
+    struct file_ent_s *fent = &(ucache->ftbl.file[ment->fent]);
     PVFS_object_ref ref = {fent->tag_handle, fent->tag_id, 0};
-    struct iovec vector = {&(ucache->b[ment->item].mblk[0]), CACHE_BLOCK_SIZE_K * 1024};
-    rc = iocommon_vreadorwrite(2, &ref, ment->tag, 1, &vector);
-    return rc;
+    struct iovec vector = {&(ucache->b[ndx].mblk[0]), ment->fill};
+
+    if(vector.iov_len > 0)
+    {
+        rc = iocommon_vreadorwrite(PVFS_IO_WRITE, &ref, ment->tag, 1, &vector);
+    }
+    if(rc == -1)
+    {
+        return -1;
+    }
+    ment->dirty = 0;
+    return 0;
 }
 
 
-/** 
+/**
  * For testing purposes only!
  */
 int wipe_ucache(void)
@@ -545,100 +532,54 @@ int wipe_ucache(void)
         glibc_ops.perror("wipe_ucache - ucache shmget");
         return -1;
     }
-    ucache = (union ucache_u *)shmat(ucache_shmid, NULL, 0);
+    ucache = (struct ucache_s *)shmat(ucache_shmid, NULL, 0);
     if((long int)ucache == -1)
     {
         glibc_ops.perror("wipe ucache - ucache shmat");
         return -1;
     }
 
-    /* wipe the cache, locks, and reinitialize */
-    memset(ucache, 0, CACHE_SIZE);
-
     /* Force Re-creation of ftbl */
     rc = ucache_init_file_table(1);
     return rc;
 }
 
-/** 
- * Removes all memory entries in the mtbl corresponding to the file info 
- * provided as parameters. It also removes the mtbl and the file entry from 
- * the cache.
+/**
+ * Drops a reference to a file.  When the last reference goes, the file's
+ * dirty blocks are flushed and its blocks and file entry freed.
+ * Returns the remaining reference count, 0 once the file is removed or -1
+ * if the file couldn't be flushed.
  */
 int ucache_close_file(struct file_ent_s *fent)
 {
     int rc = 0;
-    rc = lock_lock(ucache_lock);
-    rc = remove_file(fent);
-    if(rc == 0)
-    {
-        ucache_stats->file_count--;
-    }
+    lock_lock(ucache_lock);
+    rc = (int)(--fent->ref_cnt);
     lock_unlock(ucache_lock);
-    return rc;
-}
-
-/** May dump stats to log file if the envar LOG_UCACHE_STATS is set to 1.
- *
- */
-#if 0
-void log_ucache_stats(void)
-{
-    /* Return if envar not set to 1 */
-    char *var = getenv("LOG_UCACHE_STATS");
-    if(!var)
+    if(rc > 0)
     {
-        return;
-    }
-    if(atoi(var) != 1)
-    {
-        return;
+        return rc;
     }
-
-    float attempts = these_stats.hits + these_stats.misses;
-    float percentage = 0.0;
-    /* Don't Divide By Zero! */
-    if(attempts)
-    {
-        percentage = ((float)these_stats.hits) / attempts;
-    }
-   /* 
-    gossip_debug(GOSSIP_UCACHE_DEBUG,
-        "user cache statistics for this execution:\n"
-        "\thits=\t%llu\n"
-        "\tmisses=\t%llu\n"
-        "\thit percentage=\t%f\n"
-        "\tpseudo_misses=\t%llu\n"
-        "\tblock_count=\t%hu\n"
-        "\tfile_count=\t%hu\n",
-        (long long unsigned int) these_stats.hits,
-        (long long unsigned int) these_stats.misses,
-        percentage,
-        (long long unsigned int) these_stats.pseudo_misses,
-        these_stats.block_count,
-        these_stats.file_count
-    );
-   */
+    return remove_file(fent);
 }
-#endif
 
-/** 
+/**
  * Dumps all cache related information to the specified file pointer.
- * Returns 0 on succes, -1 on failure meaning the ucache wasn't enabled 
- * for some reason. 
+ * Returns 0 on succes, -1 on failure meaning the ucache wasn't enabled
+ * for some reason.
  */
 int ucache_info(FILE *out, char *flags)
 {
     if(!ucache_enabled)
     {
         ucache_initialize();
-    } 
+    }
     if(!ucache_enabled)
     {
         //fprintf(out, "ucache is not enabled. See ucache.log and ucached.log.\n");
         return -1;
     }
-   
+
     /* Decide what to show */
     unsigned char show_all = 0;
     unsigned char show_summary = 0;
@@ -656,7 +597,7 @@ int ucache_info(FILE *out, char *flags)
                 show_all = 1;
                 break;
             case 's':
-                show_summary = 1;             
+                show_summary = 1;
                 break;
             case 'p':
                 show_parameters = 1;
@@ -681,20 +622,22 @@ int ucache_info(FILE *out, char *flags)
 
     if(show_all || show_summary)
     {
-        fprintf(out, 
+        fprintf(out,
             "user cache statistics:\n"
             "\thits=\t%llu\n"
             "\tmisses=\t%llu\n"
             "\thit percentage=\t%f\n"
             "\tpseudo_misses=\t%llu\n"
-            "\tblock_count=\t%hu\n"
-            "\tfile_count=\t%hu\n",
-            (long long unsigned int) ucache_stats->hits, 
-            (long long unsigned int) ucache_stats->misses, 
-            (percentage * 100), 
+            "\tevictions=\t%llu\n"
+            "\tblock_count=\t%llu\n"
+            "\tfile_count=\t%llu\n",
+            (long long unsigned int) ucache_stats->hits,
+            (long long unsigned int) ucache_stats->misses,
+            (percentage * 100),
             (long long unsigned int) ucache_stats->pseudo_misses,
-            ucache_stats->block_count,
-            ucache_stats->file_count
+            (long long unsigned int) ucache_stats->evictions,
+            (long long unsigned int) ucache_stats->block_count,
+            (long long unsigned int) ucache_stats->file_count
         );
     }
 
@@ -703,32 +646,34 @@ int ucache_info(FILE *out, char *flags)
 
         fprintf(out, "\n#defines:\n");
         /* First, print many of the #define values */
-        fprintf(out, "MEM_TABLE_ENTRY_COUNT = %d\n", MEM_TABLE_ENTRY_COUNT);
         fprintf(out, "FILE_TABLE_ENTRY_COUNT = %d\n", FILE_TABLE_ENTRY_COUNT);
         fprintf(out, "CACHE_BLOCK_SIZE_K = %d\n", CACHE_BLOCK_SIZE_K);
-        fprintf(out, "MEM_TABLE_HASH_MAX = %d\n", MEM_TABLE_HASH_MAX);
         fprintf(out, "FILE_TABLE_HASH_MAX = %d\n", FILE_TABLE_HASH_MAX);
-        fprintf(out, "MTBL_PER_BLOCK  = %d\n", MTBL_PER_BLOCK );
+        fprintf(out, "UCACHE_HASH_BUCKETS = %llu\n",
+                (long long unsigned int) UCACHE_HASH_BUCKETS);
+        fprintf(out, "UCACHE_LOCK_STRIPES = %d\n", UCACHE_LOCK_STRIPES);
+        fprintf(out, "UCACHE_MAX_BLK_REQ = %d\n", UCACHE_MAX_BLK_REQ);
         fprintf(out, "KEY_FILE = %s\n", KEY_FILE);
         fprintf(out, "SHM_ID1 = %d\n", SHM_ID1);
         fprintf(out, "SHM_ID2 = %d\n", SHM_ID2);
-        fprintf(out, "BLOCKS_IN_CACHE = %d\n", BLOCKS_IN_CACHE);
-        fprintf(out, "CACHE_SIZE = %d(B)\t%d(MB)\n", CACHE_SIZE, 
-                                        (CACHE_SIZE/(1024*1024)));
+        fprintf(out, "BLOCKS_IN_CACHE = %llu\n",
+                (long long unsigned int) BLOCKS_IN_CACHE);
+        fprintf(out, "CACHE_SIZE = %llu(B)\t%llu(MB)\n",
+                (long long unsigned int) CACHE_SIZE,
+                (long long unsigned int) (CACHE_SIZE/(1024*1024)));
         fprintf(out, "AT_FLAGS = %d\n", AT_FLAGS);
         fprintf(out, "SVSHM_MODE = %d\n", SVSHM_MODE);
         fprintf(out, "CACHE_FLAGS = %d\n", CACHE_FLAGS);
         fprintf(out, "NIL = 0X%X\n", NIL);
         fprintf(out, "NIL8 = 0X%X\n", NIL8);
-        fprintf(out, "NIL16 = 0X%X\n", NIL16);    
+        fprintf(out, "NIL16 = 0X%X\n", NIL16);
         fprintf(out, "NIL32 = 0X%X\n", NIL32);
         fprintf(out, "NIL64 = 0X%lX\n", NIL64);
-    
+
         /* Print sizes of ucache elements */
-        fprintf(out, "sizeof union cache_block_u = %lu\n", sizeof(union cache_block_u));
+        fprintf(out, "sizeof struct cache_block_s = %lu\n", sizeof(struct cache_block_s));
         fprintf(out, "sizeof struct file_table_s = %lu\n", sizeof(struct file_table_s));
         fprintf(out, "sizeof struct file_ent_s = %lu\n", sizeof(struct file_ent_s));
-        fprintf(out, "sizeof struct mem_table_s = %lu\n", sizeof(struct mem_table_s));
         fprintf(out, "sizeof struct mem_ent_s = %lu\n", sizeof(struct mem_ent_s));
     }
 
@@ -739,164 +684,109 @@ int ucache_info(FILE *out, char *flags)
 
         /* ucache Shared Memory Info */
         fprintf(out, "ucache ptr:\t\t0X%lX\n", (long int)ucache);
-    
+
         /* FTBL Info */
         struct file_table_s *ftbl = &(ucache->ftbl);
         fprintf(out, "ftbl ptr:\t\t0X%lX\n", (long int)&(ucache->ftbl));
-        fprintf(out, "free_blk = %hu\n", ftbl->free_blk);
-        fprintf(out, "free_mtbl_blk = %hu\n", ftbl->free_mtbl_blk);
-        fprintf(out, "free_mtbl_ent = %hu\n", ftbl->free_mtbl_ent);
-        fprintf(out, "free_list = %hu\n", ftbl->free_list);
-    
-        uint16_t i;
+        fprintf(out, "free_list = %u\n", ftbl->free_list);
+        fprintf(out, "clock_hand = %llu\n",
+                (long long unsigned int) ftbl->clock_hand);
+
+        uint32_t i;
 
         if(show_all || show_free)
         {
-            /* Other Free Blocks */
-            fprintf(out, "\nIterating Over Free Blocks:\n\n");
-            for(i = ftbl->free_blk; i < BLOCKS_IN_CACHE; i = ucache->b[i].mtbl[0].
-                                                                      free_list_blk)
+            /* Free Blocks */
+            uint64_t free_blks = 0;
+            ucache_ndx_t b;
+            for(b = 0; b < BLOCKS_IN_CACHE; b++)
             {
-                fprintf(out, "Free Block:\tCurrent: %hu\tNext: %hu\n", i, 
-                                       ucache->b[i].mtbl[0].free_list_blk); 
+                if(ucache->mem[b].fent == NIL32)
+                {
+                    free_blks++;
+                }
             }
-            fprintf(out, "End of Free Blocks List\n");
-
+            fprintf(out, "\nFree Blocks: %llu\n",
+                    (long long unsigned int) free_blks);
 
-            /* Iterate Over Free Mtbls */
-            fprintf(out, "\nIterating Over Free Mtbls:\n");
-            uint16_t current_blk = (uint16_t)ftbl->free_mtbl_blk;
-            uint16_t current_ent = ftbl->free_mtbl_ent;
-            while(current_blk != NIL16)
-            {
-                fprintf(out, "free mtbl: block = %hu\tentry = %hu\n", 
-                        current_blk, current_ent);
-                uint16_t temp_blk = ucache->b[current_blk].mtbl[current_ent].free_list_blk;
-                uint16_t temp_ent = ucache->b[current_blk].mtbl[current_ent].free_list;
-                current_blk = temp_blk;
-                current_ent = temp_ent;
-            }
-            fprintf(out, "End of Free Mtbl List\n\n");
-        
             /* Iterating Over Free File Entries */
             fprintf(out, "Iterating Over Free File Entries:\n");
-            uint16_t current_fent; 
-            for(current_fent = ftbl->free_list; current_fent != NIL16; 
+            uint32_t current_fent;
+            for(current_fent = ftbl->free_list; current_fent != NIL32;
                                 current_fent = ftbl->file[current_fent].next)
             {
-                fprintf(out, "free file entry: index = %d\n", (int16_t)current_fent);
+                fprintf(out, "free file entry: index = %u\n", current_fent);
             }
             fprintf(out, "End of Free File Entry List\n\n");
         }
-    
+
         fprintf(out, "Iterating Over File Entries in Hash Table:\n\n");
         /* iterate over file table entries */
         for(i = 0; i < FILE_TABLE_HASH_MAX; i++)
         {
-            if((ftbl->file[i].tag_handle != NIL64) && 
-                   (ftbl->file[i].tag_handle != 0))
+            if(ftbl->bucket[i] == NIL32)
             {
-                /* iterate accross file table chain */
-                uint16_t j;
-                for(j = i; !file_done(j); j = file_next(ftbl, j))
+                if(show_all || show_free)
                 {
-                    fprintf(out, "FILE ENTRY INDEX %hu ********************\n", j);
-                    struct file_ent_s * fent = &(ftbl->file[j]);
-                    fprintf(out, "tag_handle = 0X%llX\n", 
-                                (long long int)fent->tag_handle);
-                    fprintf(out, "tag_id = 0X%X\n", (uint32_t)fent->tag_id);
-                    fprintf(out, "mtbl_blk = %hu\n", fent->mtbl_blk);
-                    fprintf(out, "mtbl_ent = %hu\n", fent->mtbl_ent);
-                    fprintf(out, "next = %hu\n", fent->next);
-                    fprintf(out, "index = %hu\n", fent->index);
-                    fprintf(out, "size = %lu\n", fent->size);
-    
-                    struct mem_table_s * mtbl = ucache_get_mtbl(fent->mtbl_blk, 
-                                                        fent->mtbl_ent);
-    
-                    fprintf(out, "\tMTBL LRU List ****************\n");
-                    print_LRU(mtbl); 
-                    print_dirty(mtbl); 
-    
-                    fprintf(out, "\tMTBL INFO ********************\n");
-                    fprintf(out, "\tnum_blocks = %hu\n", mtbl->num_blocks);
-                    fprintf(out, "\tfree_list = %hu\n", mtbl->free_list); 
-                    fprintf(out, "\tfree_list_blk = %hu\n", mtbl->free_list_blk);
-                    fprintf(out, "\tlru_first = %hu\n", mtbl->lru_first);
-                    fprintf(out, "\tlru_last = %hu\n", mtbl->lru_last);
-                    fprintf(out, "\tdirty_list = %hu\n", mtbl->dirty_list);
-                    fprintf(out, "\tref_cnt = %hu\n\n", mtbl->ref_cnt);
-                    fflush(out);
-                    /* Iterate Over Memory Entries */
-                    uint16_t k;
-                    for(k = 0; k < MEM_TABLE_HASH_MAX; k++)
-                    {
-                        if(mtbl->bucket[k] == NIL16)
-                            continue;
-   
-                        if(mtbl->mem[mtbl->bucket[k]].tag != NIL64)
-                        {
-                            uint16_t l;
-                            for(l = mtbl->bucket[k]; !ment_done(l); l = ment_next(mtbl, l))
-                            {
-                                struct mem_ent_s * ment = &(mtbl->mem[l]);
-                                fprintf(out, "\t\tMEMORY ENTRY INDEX %hd **********"
-                                                                  "*********\n", l);
-                                fprintf(out, "\t\ttag = 0X%lX\n", 
-                                             (long unsigned int)ment->tag);
-
-                                fprintf(out, "\t\titem = %hu\n", 
-                                                    ment->item);
-                                fprintf(out, "\t\tnext = %hu\n", 
-                                                    ment->next);
-                                fprintf(out, "\t\tdirty_next = %hu\n", 
-                                                    ment->dirty_next);
-                                fprintf(out, "\t\tlru_next = %hu\n", 
-                                                    ment->lru_next);
-                                fprintf(out, "\t\tlru_prev = %hu\n\n", 
-                                                      ment->lru_prev);
-                            } 
-                        }
-                        else
-                        {
-                            if(mtbl->num_blocks != 0 
-                                && (show_all || show_free))
-                            {
-                                fprintf(out, "\tvacant memory entry @ index = %d\n",
-                                    mtbl->bucket[k]);
-                            }
-                        }
-                    }
+                    fprintf(out, "vacant file bucket @ index = %u\n\n", i);
                 }
-                fprintf(out, "End of chain @ Hash Table Index %hu\n\n", i);
+                continue;
             }
-            else
+            /* iterate accross file table chain */
+            uint32_t j;
+            for(j = ftbl->bucket[i]; j != NIL32; j = ftbl->file[j].next)
             {
-                if(show_all || show_free)
+                fprintf(out, "FILE ENTRY INDEX %u ********************\n", j);
+                struct file_ent_s * fent = &(ftbl->file[j]);
+                fprintf(out, "tag_handle = 0X%llX\n",
+                            (long long int)fent->tag_handle);
+                fprintf(out, "tag_id = 0X%X\n", (uint32_t)fent->tag_id);
+                fprintf(out, "next = %u\n", fent->next);
+                fprintf(out, "index = %u\n", fent->index);
+                fprintf(out, "ref_cnt = %u\n", fent->ref_cnt);
+                fprintf(out, "size = %lu\n", fent->size);
+                fprintf(out, "num_blocks = %lu\n\n", fent->num_blocks);
+                fflush(out);
+
+                /* Iterate Over the File's Blocks */
+                ucache_ndx_t k;
+                for(k = fent->blk_first; k != NIL64;
+                                         k = ucache->mem[k].file_next)
                 {
-                    fprintf(out, "vacant file entry @ index = %hu\n\n", i);
+                    struct mem_ent_s * ment = &(ucache->mem[k]);
+                    fprintf(out, "\t\tBLOCK INDEX %lu *******************\n",
+                                                                   k);
+                    fprintf(out, "\t\ttag = 0X%lX\n",
+                                 (long unsigned int)ment->tag);
+                    fprintf(out, "\t\tbucket = %lu\n", ment->bucket);
+                    fprintf(out, "\t\tfill = %u\n", ment->fill);
+                    fprintf(out, "\t\tpin = %u\n", ment->pin);
+                    fprintf(out, "\t\tref = %u\n", ment->ref);
+                    fprintf(out, "\t\tdirty = %u\n\n", ment->dirty);
                 }
             }
+            fprintf(out, "End of chain @ Hash Table Index %u\n\n", i);
         }
     }
     return 0;
 }
 
-/** 
- * Returns a pointer to the lock corresponding to the block_index.
+/**
+ * Returns a pointer to the lock at lock_index in the lock array (see
+ * UCACHE_STRIPE_LOCK and friends).
  * If the index is out of range, then 0 is returned.
  */
-inline ucache_lock_t *get_lock(uint16_t block_index)
+ucache_lock_t *get_lock(uint32_t lock_index)
 {
-    if(block_index >= (BLOCKS_IN_CACHE + 1))
+    if(lock_index >= UCACHE_LOCK_COUNT)
     {
         return (ucache_lock_t *)0;
     }
-    return &ucache_locks[block_index];
+    return &ucache_locks[lock_index];
 }
 
-/** 
- * Initializes the proper lock based on the LOCK_TYPE 
+/**
+ * Initializes the proper lock based on the LOCK_TYPE
  * Returns 0 on success, -1 on error
  */
 int lock_init(ucache_lock_t * lock)
@@ -907,7 +797,7 @@ int lock_init(ucache_lock_t * lock)
     rc = sem_init(lock, 1, 1);
     if(rc != -1)
     {
-        rc = 0; 
+        rc = 0;
     }
     #elif LOCK_TYPE == 1
     pthread_mutexattr_t attr;
@@ -938,31 +828,15 @@ int lock_init(ucache_lock_t * lock)
     return 0;
 }
 
-/** 
+/**
  * Returns 0 when lock is locked; otherwise, return -1 and sets errno.
  */
-inline int lock_lock(ucache_lock_t * lock)
+int lock_lock(ucache_lock_t * lock)
 {
     int rc = 0;
     #if LOCK_TYPE == 0
     return sem_wait(lock);
     #elif LOCK_TYPE == 1
-/*
-    while(1)
-    {
-        rc = pthread_mutex_trylock(lock);
-        if(rc != 0)
-        {
-            printf("couldn't lock lock 0X%lX\n", (long unsigned int) lock); 
-            fflush(stdout);
-            rc = -1;
-        }
-        else
-        {
-            break;
-        }
-    }
-*/
     rc = pthread_mutex_lock(lock);
     return rc;
     #elif LOCK_TYPE == 2
@@ -970,18 +844,18 @@ inline int lock_lock(ucache_lock_t * lock)
     #elif LOCK_TYPE == 3
     rc = gen_mutex_lock(lock);
     return rc;
-    #endif   
+    #endif
 }
 
-/** 
- * If successful, return zero; otherwise, return -1 and sets errno. 
+/**
+ * If successful, return zero; otherwise, return -1 and sets errno.
  */
-inline int lock_unlock(ucache_lock_t * lock)
+int lock_unlock(ucache_lock_t * lock)
 {
     #if LOCK_TYPE == 0
     return sem_post(lock);
     #elif LOCK_TYPE == 1
-    return pthread_mutex_unlock(lock); 
+    return pthread_mutex_unlock(lock);
     #elif LOCK_TYPE == 2
     return pthread_spin_unlock(lock);
     #elif LOCK_TYPE == 3
@@ -989,8 +863,8 @@ inline int lock_unlock(ucache_lock_t * lock)
     #endif
 }
 
-/** 
- * Upon successful completion, returns zero 
+/**
+ * Upon successful completion, returns zero
  * Otherwise, returns -1 and sets errno.
  */
 #if (LOCK_TYPE == 0)
@@ -1000,12 +874,12 @@ int ucache_lock_getvalue(ucache_lock_t * lock, int *sval)
 }
 #endif
 
-/** 
+/**
  * Tries the lock to see if it's available:
  * Returns 0 if lock has not been aquired ie: success
  * Otherwise, returns -1
  */
-inline int lock_trylock(ucache_lock_t * lock)
+int lock_trylock(ucache_lock_t * lock)
 {
     int rc = -1;
     #if (LOCK_TYPE == 0)
@@ -1018,1065 +892,382 @@ inline int lock_trylock(ucache_lock_t * lock)
     {
         rc = 0;
     }
-    #elif (LOCK_TYPE == 1)
-    rc = pthread_mutex_trylock(lock);
-    if( rc != 0)
+    #else
+    rc = lock_tryacquire(lock);
+    #endif
+    if(rc == 0)
     {
-        rc = -1;
+        /* Unlock before leaving if lock wasn't already set */
+        rc = lock_unlock(lock);
     }
+    return rc;
+}
+
+/**
+ * Takes the lock if it's available without waiting.
+ * Returns 0 if the lock was taken, otherwise -1
+ */
+int lock_tryacquire(ucache_lock_t * lock)
+{
+    int rc = -1;
+    #if (LOCK_TYPE == 0)
+    rc = sem_trywait(lock);
+    #elif (LOCK_TYPE == 1)
+    rc = pthread_mutex_trylock(lock);
     #elif (LOCK_TYPE == 2)
     rc = pthread_spin_trylock(lock);
-    if(rc != 0)
-    {
-        rc = -1;
-    }
     #elif LOCK_TYPE == 3
     rc = gen_mutex_trylock(lock);
+    #endif
     if(rc != 0)
     {
         rc = -1;
     }
-    #endif
-    if(rc == 0)
-    {
-        /* Unlock before leaving if lock wasn't already set */
-        rc = lock_unlock(lock);
-    }
     return rc;
 }
 /***************************************** End of Externally Visible API */
 
 /* Beginning of internal only (static) functions */
 
-/* Dirty List Iterator */
-/** 
- * Returns true if current index is NIL, otherwise, returns 0.
+/**
+ * Perform a file lookup on the ucache using the provided fs_id and handle.
+ * The global lock must be held.
+ *
+ * Returns the file entry index if the file is found, otherwise NIL32.
  */
-static inline unsigned char dirty_done(uint16_t index)
+static uint32_t lookup_file(uint32_t fs_id, uint64_t handle)
 {
-    return (index == NIL16);
-}
+    struct file_table_s *ftbl = &(ucache->ftbl);
+    uint32_t i;
 
-/** 
- * Returns the next index in the dirty list for the provided mtbl and index 
- */
-static inline uint16_t dirty_next(struct mem_table_s *mtbl, uint16_t index)
-{
-    return mtbl->mem[index].dirty_next;
+    for(i = ftbl->bucket[handle % FILE_TABLE_HASH_MAX]; i != NIL32;
+        i = ftbl->file[i].next)
+    {
+        if(ftbl->file[i].tag_id == fs_id && ftbl->file[i].tag_handle == handle)
+        {
+            return i;
+        }
+    }
+    return NIL32;
 }
 
-/*  Memory Entry Chain Iterator */
-/** 
- * Returns true if current index is NIL, otherwise, returns 0.
+/**
+ * Insert information about file into ucache (no file data inserted)
+ * The global lock must be held.
+ *
+ * Returns the index of the new file entry, or NIL32 if the file table is
+ * full.
  */
-static inline unsigned char ment_done(uint16_t index)
+static uint32_t insert_file(uint32_t fs_id, uint64_t handle)
 {
-    return (index == NIL16);
+    struct file_table_s *ftbl = &(ucache->ftbl);
+    uint32_t bucket = handle % FILE_TABLE_HASH_MAX;
+    uint32_t ndx = ftbl->free_list;
+    struct file_ent_s *fent;
+
+    if(ndx == NIL32)
+    {
+        return NIL32;
+    }
+    fent = &(ftbl->file[ndx]);
+    ftbl->free_list = fent->next;
+
+    fent->tag_id = fs_id;
+    fent->tag_handle = handle;
+    fent->ref_cnt = 0;
+    fent->size = 0;
+    fent->num_blocks = 0;
+    fent->blk_first = NIL64;
+    fent->next = ftbl->bucket[bucket];
+    ftbl->bucket[bucket] = ndx;
+    return ndx;
 }
 
-/** 
- * Returns the next index in the memory entry chain for the provided mtbl 
- * and index. 
+/**
+ * Takes the file entry off its hash chain and puts it on the free list.
+ * The global lock must be held.
  */
-static inline uint16_t ment_next(struct mem_table_s *mtbl, uint16_t index)
+static void put_free_fent(struct file_ent_s *fent)
 {
-    return mtbl->mem[index].next;
-}
-
-/*  File Entry Chain Iterator   */
-/** 
- * Returns true if current index is NIL, otherwise, returns 0 
- */
-static unsigned char file_done(uint16_t index)
-{
-    return (index == NIL16);
-}
-
-/** 
- * Returns the next index in the file entry chain for the provided mtbl 
- * and index. 
- */
-static uint16_t file_next(struct file_table_s *ftbl, uint16_t index)
-{
-    return ftbl->file[index].next;
-}
-
-/**
- * This function should only be called when the ftbl has no free mtbls. 
- * It initizializes MTBL_PER_BLOCK additional mtbls in the block provided,
- * meaning this block will no longer be used for storing file data but 
- * hash table related data instead.
- */
-static void add_mtbls(uint16_t blk)
-{
-    uint16_t i, start_mtbl;
     struct file_table_s *ftbl = &(ucache->ftbl);
-    union cache_block_u *b = &(ucache->b[blk]);
+    uint32_t *link = &(ftbl->bucket[fent->tag_handle % FILE_TABLE_HASH_MAX]);
 
-    /* add mtbls in blk to ftbl free list */
-    if (blk == 0)
-    {
-        start_mtbl = 1; /* skip blk 0 ent 0 which is ftbl */
-    }
-    else
+    while(*link != NIL32 && *link != fent->index)
     {
-        start_mtbl = 0;
+        link = &(ftbl->file[*link].next);
     }
-    for (i = start_mtbl; i < (MTBL_PER_BLOCK - 1); i++)
+    if(*link == fent->index)
     {
-        b->mtbl[i].free_list_blk = blk;
-        b->mtbl[i].free_list = i + 1;
+        *link = fent->next;
     }
-    b->mtbl[i].free_list_blk = NIL16;
-    b->mtbl[i].free_list = NIL16;
-    ftbl->free_mtbl_blk = blk;
-    ftbl->free_mtbl_ent = start_mtbl;   
+
+    fent->tag_handle = NIL64;
+    fent->tag_id = NIL32;
+    fent->size = NIL64;
+    fent->next = ftbl->free_list;
+    ftbl->free_list = fent->index;
 }
+
 /**
- * Initializes a memory entry.
+ * Flushes and drops every block of a file nobody has open, then frees its
+ * file entry.  Blocks pinned by a request in flight are waited for; if the
+ * file is opened again meanwhile it is left in place.  Several processes
+ * may be doing this for the same file at once, and the entry may even be
+ * reused for another file meanwhile, so the file's identity is checked
+ * before anything is dropped.
+ * Returns 0 following removal, the reference count if the file was
+ * reopened, and -1 if the file couldn't be flushed.
  */
-static inline void init_memory_entry(struct mem_table_s *mtbl, int16_t index)
+static int remove_file(struct file_ent_s *fent)
 {
-        assert(index < MEM_TABLE_ENTRY_COUNT);
-        mtbl->mem[index].tag = NIL64;
-        mtbl->mem[index].item = NIL16;
-        mtbl->mem[index].next = NIL16;
-        mtbl->mem[index].dirty_next = NIL16;
-        mtbl->mem[index].lru_prev = NIL16;
-        mtbl->mem[index].lru_next = NIL16;
-}
+    int rc = 0;
+    ucache_lock_t *file_lock = get_lock(UCACHE_FILE_LOCK(fent->index));
+    ucache_ndx_t ndx;
+    uint64_t handle;
+    uint32_t fs_id;
 
-/** 
- * Initializes a mtbl which is a hash table of memory entries.
- * The mtbl will be located at the provided entry index within 
- * the provided block.
- */
-static void init_memory_table(struct mem_table_s *mtbl)
-{
-    uint16_t i;
-    mtbl->num_blocks = 0;
-    mtbl->free_list_blk = NIL16;
-    mtbl->lru_first = NIL16;
-    mtbl->lru_last = NIL16;
-    mtbl->dirty_list = NIL16;
-    mtbl->ref_cnt = 0;
-
-    /* Initialize Buckets */
-    for(i = 0; i < MEM_TABLE_HASH_MAX; i++)
+    lock_lock(ucache_lock);
+    handle = fent->tag_handle;
+    fs_id = fent->tag_id;
+    rc = (int)fent->ref_cnt;
+    lock_unlock(ucache_lock);
+    if(rc != 0 || handle == NIL64)
     {
-        mtbl->bucket[i] = NIL16;
+        return rc;
     }
 
-    /* set up free ments */
-    mtbl->free_list = 0;
-    for(i = 0; i < (MEM_TABLE_ENTRY_COUNT - 1); i++)
+    /* Flush dirty blocks before file removal from cache */
+    rc = flush_file(fent);
+    if(rc == -1)
     {
-        init_memory_entry(mtbl, i);
-        mtbl->mem[i].next = i + 1;
-
+        return rc;
     }
-    /* NIL Terminate the last entries next index */
-    init_memory_entry(mtbl, MEM_TABLE_ENTRY_COUNT - 1);
-    mtbl->mem[MEM_TABLE_ENTRY_COUNT - 1].next = NIL16;
-}
-
-/** 
- * This function asks the file table if a free block is avaialable. 
- * If so, returns the block's index; otherwise, returns NIL.
- */
-static inline uint16_t get_free_blk(void)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    uint16_t desired_blk = ftbl->free_blk;
-    if(desired_blk != NIL16 && desired_blk < BLOCKS_IN_CACHE)
-    {  
-        /* Update the head of the free block list */ 
-        /* Use mtbl index zero since free_blks have no ititialized mem tables */
-        ftbl->free_blk = ucache->b[desired_blk].mtbl[0].free_list_blk; 
-        return desired_blk;
-    }
-    return NIL16;
-}
 
-/** 
- * Accepts an index corresponding to a block that is put back on the file 
- * table free list.
- */
-static inline void put_free_blk(uint16_t blk)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    /* set the block's next value to the current head of the block free list */
-    ucache->b[blk].mtbl[0].free_list_blk = ftbl->free_blk;
-    /* blk is now the head of the ftbl blk free list */
-    ftbl->free_blk = blk;
-}
-
-/** 
- * Consults the file table to retrieve an index corresponding to a file entry
- * If available, returns the file entry index, otherwise returns NIL.
- */
-static uint16_t get_free_fent(void)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    uint16_t entry = ftbl->free_list;
-    if(entry != NIL16)
-    {
-        ftbl->free_list = ftbl->file[entry].next;
-        ftbl->file[entry].next = NIL16;
-        return entry;
-    }
-    else
+    lock_lock(file_lock);
+    while((ndx = fent->blk_first) != NIL64 && fent->ref_cnt == 0 &&
+          fent->tag_handle == handle && fent->tag_id == fs_id)
     {
-        return NIL16;
+        lock_unlock(file_lock);
+        if(claim_blk(ndx, NIL32))
+        {
+            unpin_blk(ndx);
+        }
+        else
+        {
+            sched_yield();
+        }
+        lock_lock(file_lock);
     }
-}
+    lock_unlock(file_lock);
 
-/** 
- * Places the file entry located at the provided index back on the file table's
- * free file entry list. If the index is < FILE_TABLE_HASH_MAX, then set next 
- * to NIL since this index must remain the head of the linked list. Otherwise,
- * set next to the current head of fent free list and set the free list head to
- * the provided index.
- */
-static void put_free_fent(struct file_ent_s *fent)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    fent->tag_handle = NIL64;
-    fent->tag_id = NIL32;
-    fent->size = NIL64;
-    if(fent->index < FILE_TABLE_HASH_MAX)
+    lock_lock(ucache_lock);
+    if(fent->tag_handle != handle || fent->tag_id != fs_id)
     {
-        fent->next = NIL16;
+        /* Another closer already removed it */
+        rc = 0;
     }
-    else
+    else if(fent->ref_cnt == 0 && fent->blk_first == NIL64)
     {
-        /* Set next index to the current head of the free list */
-        fent->next = ftbl->free_list;
-        /* Set fent index as the head of the free_list */
-        ftbl->free_list = fent->index;
+        put_free_fent(fent);
+        __sync_fetch_and_sub(&ucache_stats->file_count, 1);
+        rc = 0;
     }
-}
-
-/** 
- * Consults the provided mtbl's memory entry free list to get the index of the
- * next free memory entry. Returns the index if one is available, otherwise 
- * returns NIL.
- */
-static inline uint16_t get_free_ment(struct mem_table_s *mtbl)
-{
-    uint16_t ment = mtbl->free_list;
-    if(ment != NIL16)
+    else
     {
-        mtbl->free_list = mtbl->mem[ment].next;
-        mtbl->mem[ment].next = NIL16;
+        rc = (int)fent->ref_cnt;
     }
-    return ment;
+    lock_unlock(ucache_lock);
+    return rc;
 }
 
-/** 
- * Puts the memory entry corresponding to the provided mtbl and entry index 
- * back on the mtbl's memory entry free list. 
+/**
+ * Hashes a file entry and block offset to a bucket of the block index.
  */
-static void put_free_ment(struct mem_table_s *mtbl, uint16_t ent)
+static inline ucache_ndx_t blk_bucket(uint32_t fent_ndx, uint64_t offset)
 {
-    /* Reset ment values */
-    mtbl->mem[ent].tag = NIL64;
-    mtbl->mem[ent].item = NIL16;
-    mtbl->mem[ent].dirty_next = NIL16;
-    mtbl->mem[ent].lru_prev = NIL16;
-    mtbl->mem[ent].lru_next = NIL16;
-    /* Set next index to the current head of the free list */
-    mtbl->mem[ent].next = mtbl->free_list;
-    /* Update free list to include this entry */
-    mtbl->free_list = ent;
+    uint64_t key = ((uint64_t)fent_ndx << 40) ^ (offset / CACHE_BLOCK_SIZE);
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (ucache_ndx_t)((key >> 20) % UCACHE_HASH_BUCKETS);
 }
 
-/** 
- * Perform a file lookup on the ucache using the provided fs_id and handle.
- *
- * Additional parameters (references) may used that will be set to values 
- * pertaining to mtbl and file entry location. If NULL is passed in place of 
- * these parameters, then they cannot be set.
+/**
+ * Looks up the block holding the data at offset in the file entry's file on
+ * the given bucket, whose stripe lock must be held.
  *
- * If the file is found, a pointer to the mtbl is returned and the parameter 
- * references set accordingly. Otherwise, NIL is returned. 
+ * Returns the block index if located, otherwise NIL64.
  */
-static struct mem_table_s *lookup_file(
-    uint32_t fs_id, 
-    uint64_t handle,
-    uint16_t *file_mtbl_blk,
-    uint16_t *file_mtbl_ent,
-    uint16_t *file_ent_index,
-    uint16_t *file_ent_prev_index
-)
+static inline ucache_ndx_t lookup_mem(uint32_t fent_ndx,
+                                      uint64_t offset,
+                                      ucache_ndx_t bucket)
 {
-    /* Index into file hash table */
-    uint16_t index = handle % FILE_TABLE_HASH_MAX; 
-
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    struct file_ent_s *current = &(ftbl->file[index]);
-
-    /* previous, current, next fent index */
-    uint16_t p = NIL16;
-    uint16_t c = index;
-    uint16_t n = current->next;
-
-    while(1)
-    {
-        if((current->tag_id == fs_id) && (current->tag_handle == handle))
-        {
-            /* If params !NULL, set their values */
-            if(file_mtbl_blk!=NULL && file_mtbl_ent!=NULL && 
-                file_ent_index!=NULL && file_ent_prev_index!=NULL)
-            {
-                    *file_mtbl_blk = current->mtbl_blk;
-                    *file_mtbl_ent = current->mtbl_ent;
-                    *file_ent_index = c;
-                    *file_ent_prev_index = p;
-            }
-            return (struct mem_table_s *)&(ucache->b[current->mtbl_blk].mtbl[
-                                                            current->mtbl_ent]);
-        }
-        /* No match yet */
-        else    
-        {
-            if(current->next == NIL16 || current->next == 0)
-            {
-                return (struct mem_table_s *)NIL;
-            }
-            else
-            {
-                current = &(ftbl->file[current->next]);
-                p=c; 
-                c=n; 
-                n=current->next;
-            }
-
-        }
-    }    
-}
-
-/** 
- * Function that locates the next free mtbl.
- * On success, Returns 1 and sets reference parameters to proper indexes.
- * On failure, returns NIL; 
- */
-static uint16_t get_next_free_mtbl(uint16_t *free_mtbl_blk, uint16_t *free_mtbl_ent)
-{
-        struct file_table_s *ftbl = &(ucache->ftbl);
-
-        /* Get next free mtbl_blk and ent from ftbl */
-        *free_mtbl_blk = ftbl->free_mtbl_blk;
-        *free_mtbl_ent = ftbl->free_mtbl_ent;
-
-        /* Is free mtbl_blk available? */
-        if((*free_mtbl_blk == NIL16) || 
-             (*free_mtbl_ent == NIL16))
-        { 
-            return NIL16;
-        }
-
-        /* Update ftbl to contain new next free mtbl */
-        ftbl->free_mtbl_blk = ucache->b[*free_mtbl_blk].mtbl[*free_mtbl_ent].
-                                                                free_list_blk;
-        ftbl->free_mtbl_ent = ucache->b[*free_mtbl_blk].mtbl[*free_mtbl_ent].
-                                                                    free_list;
-
-        /* Set free info to NIL */
-        ucache->b[*free_mtbl_blk].mtbl[*free_mtbl_ent].free_list = NIL16;
-        ucache->b[*free_mtbl_blk].mtbl[*free_mtbl_ent].free_list_blk = NIL16;
-
-        return 1;
-}
-
-/** 
- * Places memory entries' corresponding blocks 
- * back on the ftbl block free list. Reinitializes mtbl.
- * Assumes mtbl->ref_cnt is 0.  
- */
-static int wipe_mtbl(struct mem_table_s *mtbl)
-{
-    uint16_t i;
-    for(i = 0; i < MEM_TABLE_HASH_MAX; i++)
-    {
-        uint16_t j;
-        for(j = mtbl->bucket[i]; !ment_done(j); j = ment_next(mtbl, j))
-        {
-            /* Current Memory Entry */
-            struct mem_ent_s *ment = &(mtbl->mem[j]);
-            /*  Account for empty head of ment chain    */
-            if((ment->tag == NIL64) || (ment->item == NIL16))
-            {
-                break;
-            }
-            put_free_blk(ment->item);
-        }
-    }
-    memset(&mtbl->mem[0], 0, sizeof(struct mem_ent_s) * MEM_TABLE_ENTRY_COUNT);
-    init_memory_table(mtbl);
-    return 1;
-}
-
-/** 
- * Places the provided mtbl back on the ftbl's mtbl free list provided it 
- * isn't currently referenced.
- */
-static int put_free_mtbl(struct mem_table_s *mtbl, struct file_ent_s *file)
-{
-    /* Remove mtbl */
-    mtbl->num_blocks = 0;   /* number of used blocks in this mtbl */
-    mtbl->lru_first = NIL16;  /* index of first block on lru list */
-    mtbl->lru_last = NIL16;   /* index of last block on lru list */
-    mtbl->dirty_list = NIL16; /* index of first dirty block */
-    mtbl->ref_cnt = 0;      /* number of clients using this record */
-
-    /* Add mem_table back to free list */
-    /* Temporarily store copy of current head (the new next) */
-    uint16_t tmp_blk = ucache->ftbl.free_mtbl_blk;
-    uint16_t tmp_ent = ucache->ftbl.free_mtbl_ent;
-    /* newly free mtbl becomes new head of free mtbl list */
-    ucache->ftbl.free_mtbl_blk = file->mtbl_blk;
-    ucache->ftbl.free_mtbl_ent = file->mtbl_ent;
-    /* Point to the next free mtbl (the former head) */
-    mtbl->free_list_blk = tmp_blk;
-    mtbl->free_list = tmp_ent;
-
-    return 1;
-}
-
-/** 
- * Insert information about file into ucache (no file data inserted)
- * Returns pointer to mtbl on success.
- * 
- * Returns NIL if necessary data structures could not be aquired from the free
- * lists or through an eviction policy (meaning references are held).
- */
-uint16_t insert_file(
-    uint32_t fs_id,
-    uint64_t handle 
-)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    struct file_ent_s *current;     /* Current ptr for iteration */
-    uint16_t free_fent = NIL16;       /* Index of next free fent */
-
-    /* index into file hash table */
-    uint16_t index = handle % FILE_TABLE_HASH_MAX;
-    current = &(ftbl->file[index]);
-
-    unsigned char indexOccupied = (current->tag_handle != NIL64 && current->tag_id != NIL32);
-
-    /* Get free mtbl */
-    uint16_t free_mtbl_blk = NIL16;
-    uint16_t free_mtbl_ent = NIL16; 
-    /* Create free mtbls if none are available */
-    if(get_next_free_mtbl(&free_mtbl_blk, &free_mtbl_ent) != 1)
-    {   
-        if(ucache->ftbl.free_blk == NIL16) 
-        {
-            /* Evict a block from mtbl with most mem entries */
-            struct file_ent_s *max_fent = 0;
-            struct mem_table_s *max_mtbl;
-            uint16_t ment_count = 0;
-            ment_count = locate_max_fent(&max_fent);
-            max_mtbl = ucache_get_mtbl(max_fent->mtbl_blk, max_fent->mtbl_ent);
-            if(ment_count == 0 || max_mtbl->lru_last == NIL16)
-            {
-            }
-            else
-            {
-                evict_LRU(max_fent);
-            }
-        }
-        /* TODO: other policy? */
-        if(ucache->ftbl.free_blk == NIL16)
-        {
-
-        }
-        /* Intitialize memory tables */
-        if(ucache->ftbl.free_blk != NIL16)
-        {
-            int16_t free_blk = get_free_blk(); 
-            add_mtbls(free_blk);
-            get_next_free_mtbl(&free_mtbl_blk, &free_mtbl_ent);
-        }
-        else
-        {
-            /* Couldn't get free mtbl - unlikely */
-            return NIL16;
-        }
-    }
-
-    /* Now, we know which hashed chain we are trying to insert into and have a 
-     * mtbl ready to be filled.
-     */
-
-    /* Insert at the head or just after the head, since we can't change the 
-     * indexing (only can change "nexts"). 
-     */
-    if(indexOccupied)
+    ucache_ndx_t i;
+    for(i = ucache->bucket[bucket]; i != NIL64; i = ucache->mem[i].next)
     {
-        /* Certain a file entry is required */
-        /* get free file entry and update ftbl */
-        free_fent = get_free_fent();
-        if(free_fent != NIL16)
+        if(ucache->mem[i].tag == offset && ucache->mem[i].fent == fent_ndx)
         {
-            uint16_t temp_next = current->next;
-            current->next = free_fent;
-            current = &(ftbl->file[free_fent]);
-            current->next = temp_next; /* repair link */
-            current->index = free_fent;
-        }
-        else
-        {
-            /* Return an error indicating the ucache is full and file couldn't 
-             * be cached 
-             */
-            return NIL16;
+            return i;
         }
     }
-    else
-    {
-        current->index = index;
-    }
-
-    /* Insert file data @ index */
-    current->tag_id = fs_id;
-    current->tag_handle = handle;
-    /* Update fent with it's new mtbl: blk and ent */
-    current->mtbl_blk = free_mtbl_blk;
-    current->mtbl_ent = free_mtbl_ent;
-    current->size = 0;
-    /* Initialize Memory Table */
-    init_memory_table(ucache_get_mtbl(free_mtbl_blk, free_mtbl_ent));
-    return current->index;
+    return NIL64;
 }
 
-/** 
- * Remove file entry and memory table of file identified by parameters
- * Returns 1 following removal
- * Returns -1 if file is referenced or if the file could not be located.
+/**
+ * Takes a block off its index chain and its file's block list, leaving it
+ * free.  The block's stripe lock must be held and the caller must hold a
+ * pin on it.  Blocks are pinned either under their stripe lock or, by
+ * flush_file, under their file's lock, so with both held a pin count of 1
+ * means nobody else can be using the block.
+ *
+ * Returns 1 if the block was freed, 0 if someone else has it pinned.
  */
-static int remove_file(struct file_ent_s *fent)
+static int unlink_mem(ucache_ndx_t ndx)
 {
-    int rc = 0;
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk,
-                                       fent->mtbl_ent);
+    struct mem_ent_s *ment = &(ucache->mem[ndx]);
+    struct file_ent_s *fent = &(ucache->ftbl.file[ment->fent]);
+    ucache_lock_t *file_lock = get_lock(UCACHE_FILE_LOCK(ment->fent));
+    ucache_ndx_t *link = &(ucache->bucket[ment->bucket]);
 
-    if(mtbl == (struct mem_table_s *)NILP)
+    lock_lock(file_lock);
+    if(ment->pin != 1)
     {
-        return -1;
+        lock_unlock(file_lock);
+        return 0;
     }
 
-    /* Flush file blocks before file removal */
-    mtbl->ref_cnt--;
-
-    if(mtbl->ref_cnt > 0)
+    while(*link != NIL64 && *link != ndx)
     {
-        return (int) mtbl->ref_cnt;
+        link = &(ucache->mem[*link].next);
     }
-
-    /* Flush dirty blocks before file removal from cache */
-    rc = flush_file(fent);
-    if(rc == -1)
+    if(*link == ndx)
     {
-        return rc;
+        *link = ment->next;
     }
 
-    /* Instead of removing individually, since memory entries are already 
-     * flushed, just wipe the mtbl 
-     */
-    rc = wipe_mtbl(mtbl);
-    if(rc == -1)
+    if(ment->file_prev != NIL64)
     {
-        /* Couldn't remove entries */
-        return rc;
+        ucache->mem[ment->file_prev].file_next = ment->file_next;
     }
-
-    rc = put_free_mtbl(mtbl, fent);
-    if(rc == -1)
+    else
     {
-        return rc;
+        fent->blk_first = ment->file_next;
     }
-
-    put_free_fent(fent);
-    if(rc == -1)
+    if(ment->file_next != NIL64)
     {
-        return rc;
+        ucache->mem[ment->file_next].file_prev = ment->file_prev;
     }
+    fent->num_blocks--;
+    ment->file_prev = NIL64;
+    ment->file_next = NIL64;
+    ment->fent = NIL32;
+    lock_unlock(file_lock);
 
-    /* Success */
-    return 0;
+    ment->tag = NIL64;
+    ment->next = NIL64;
+    ment->fill = 0;
+    ment->dirty = 0;
+    ment->ref = 0;
+    __sync_fetch_and_sub(&ucache_stats->block_count, 1);
+    return 1;
 }
 
-/** 
- * Lookup the memory location of a block of data in cache that is identified 
- * by the mtbl and offset parameters.
- *
- * If located, returns a pointer to memory where the desired block of data is 
- * stored. Otherwise, NIL is returned.
+/**
+ * Finds a block to hold new data by sweeping the CLOCK hand over the block
+ * descriptors.  Referenced blocks get their bit cleared and are passed over
+ * once; pinned blocks are skipped.  held_stripe is the stripe lock the
+ * caller holds, or NIL32.
  *
- * pertaining to the memory entry's location. If NULLs are passed in place of 
- * these parameters, then they will not be set.
+ * Returns the index of a free block pinned once for the caller, or NIL64 if
+ * none could be had in three sweeps.
  */
-inline static void *lookup_mem(struct mem_table_s *mtbl, 
-                    uint64_t offset, 
-                    uint16_t *item_index,
-                    uint16_t *mem_ent_index,
-                    uint16_t *mem_ent_prev_index)
+static ucache_ndx_t get_free_blk(uint32_t held_stripe)
 {
-    /* index into mem hash table */
-    uint16_t index = (uint16_t) ((offset / CACHE_BLOCK_SIZE) % MEM_TABLE_HASH_MAX);
-
-    /* If the bucket is empty then go ahead and return */
-    if(mtbl->bucket[index] == NIL16)
-    {
-        return (struct mem_table_s *)NIL;
-    }
-
-    uint16_t bucket_index = mtbl->bucket[index];
-    struct mem_ent_s *current = &(mtbl->mem[bucket_index]);
-
-    /* previous, current, next memory entry index in mtbl */
-    int16_t p = NIL16;
-    int16_t c = bucket_index;
-    int16_t n = current->next;  
-
-    while(1)
+    uint64_t tries;
+    for(tries = 0; tries < 3 * (uint64_t)BLOCKS_IN_CACHE; tries++)
     {
-        if(offset == current->tag)
-        {
-            /* If parameters !NULL, set their values */
-            if(item_index != NULL)
-            {
-                *item_index = current->item;
-            }
-            if((mem_ent_index != NULL) && (mem_ent_prev_index != NULL))
-            {
-                    *mem_ent_index = c;
-                    *mem_ent_prev_index = p;
-            }
-            return (void *)(&ucache->b[current->item].mblk);
-        }
-        else
-        {
-            if(current->next == NIL16)
-            {
-                return (struct mem_table_s *)NIL;
-            }
-            else
-            {
-                /* Iterate */
-                current = &(mtbl->mem[current->next]);
-                p = c; 
-                c = n; 
-                n = current->next;
-            }
-        }
-    }
-}
+        ucache_ndx_t ndx = __sync_fetch_and_add(&ucache->ftbl.clock_hand, 1) %
+                           BLOCKS_IN_CACHE;
+        struct mem_ent_s *ment = &(ucache->mem[ndx]);
 
-/** 
- * Update the provided mtbl's LRU doubly-linked list by placing the memory 
- * entry, identified by the provided index, at the head of the list (lru_first).
- */
-static inline void update_LRU(struct mem_table_s *mtbl, uint16_t index)
-{
-    /* First memory entry used becomes the head and tail of the list */
-    if((mtbl->lru_first == NIL16) && 
-        (mtbl->lru_last == NIL16))
-    {
-        mtbl->lru_first = index;
-        mtbl->lru_last = index;
-        mtbl->mem[index].lru_prev = NIL16;
-        mtbl->mem[index].lru_next = NIL16;
-    }
-    /* 2nd Memory Entry */
-    else if(mtbl->lru_first == mtbl->lru_last)
-    {
-        /* Do nothing if this index is already the only entry */
-        if(mtbl->lru_first == index)
-        {
-            return;
-        }
-        else
-        {   
-            /* Must be 2nd unique memory entry */
-            /* point tail.prev to new */
-            mtbl->mem[mtbl->lru_first].lru_prev = index;
-            /* point new.prev to NIL */  
-            mtbl->mem[index].lru_prev = NIL16;
-            /* point the new.next to the tail */      
-            mtbl->mem[index].lru_next = mtbl->lru_first;
-            /* point the head to the new */  
-            mtbl->lru_first = index;                    
-        }
-    }
-    /* 3rd+ Memory Entry */
-    else
-    {
-        if(mtbl->mem[index].lru_prev == NIL16 && 
-            mtbl->mem[index].lru_next == NIL16)
-        {
-            /* First time on the LRU List, Add to the front */
-            mtbl->mem[index].lru_next = mtbl->lru_first;
-            mtbl->mem[mtbl->lru_first].lru_prev = index;    
-        }
-        else if(mtbl->mem[index].lru_prev == NIL16)
-        {
-            /* Already the head of MRU */
-            return;
-        }
-        else if(mtbl->mem[index].lru_next == NIL16)
+        if(ment->pin)
         {
-            /* Relocate the LRU to become the MRU */
-            mtbl->lru_last = mtbl->mem[index].lru_prev;
-            mtbl->mem[mtbl->lru_last].lru_next = NIL16;
-            mtbl->mem[mtbl->lru_first].lru_prev = index;
-            mtbl->mem[index].lru_next = mtbl->lru_first;
-            mtbl->mem[index].lru_prev = NIL16;
-        }
-        else
-        {
-            /* Relocate interior LRU list item to head */
-            uint16_t current_prev = mtbl->mem[index].lru_prev;
-            uint16_t current_next = mtbl->mem[index].lru_next;
-
-            mtbl->mem[current_prev].lru_next = current_next;
-            mtbl->mem[current_next].lru_prev = current_prev;
-
-            mtbl->mem[index].lru_prev = NIL16;
-            mtbl->mem[index].lru_next = mtbl->lru_first;
-        }
-        mtbl->lru_first = index;
-    }
-}    
-
-/** 
- * Searches the ftbl for the mtbl with the most entries.
- * Returns the number of memory entries the max mtbl has. The double ptr 
- * parameter is used to store a reference to the mtbl pointer with the most 
- * memory entries. 
- */
-static uint16_t locate_max_fent(struct file_ent_s **fent)
-{
-    struct file_table_s *ftbl = &(ucache->ftbl);
-    uint16_t value_of_max = 0;
-    /* Iterate over file hash table indices */
-    uint16_t i;
-    for(i = 0; i < FILE_TABLE_HASH_MAX; i++)
-    {
-
-        if((ftbl->file[i].tag_handle == NIL64) ||
-               (ftbl->file[i].tag_handle == 0))
             continue;
-
-        /* Iterate over hash table chain */
-        uint16_t j;
-        for(j = i; !file_done(j); j = file_next(ftbl, j))
-        {
-            struct file_ent_s *current_fent = &(ftbl->file[j]);
-            if((current_fent->mtbl_blk == NIL16) || 
-                    (current_fent->mtbl_ent == NIL16))
-            {
-                break;
-            }
-            /* Examine the mtbl's value of num_blocks to see if it's the 
-             * greatest. 
-             */
-            struct mem_table_s *current_mtbl = ucache_get_mtbl(
-                current_fent->mtbl_blk,
-                current_fent->mtbl_ent);
-
-            if(current_mtbl->num_blocks >= value_of_max)
-            {
-                *fent = current_fent; /* Set the parameter to this mtbl */
-                value_of_max = current_mtbl->num_blocks;
-            }
         }
-    }
-    return value_of_max;
-}
-
-/** 
- * Evicts the LRU memory entry from the tail (lru_last) of the provided
- * mtbl's LRU list.
- * 
- * Returns 1 on success; 0 on failure, meaning there was no LRU
- * or that the block's lock couldn't be aquired.
- */
-static int evict_LRU(struct file_ent_s *fent)
-{
-    int rc = 0;
-    
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
-
-    if(mtbl->num_blocks != 0 && mtbl->lru_last != NIL16)
-    {
-        //printf("evicting: %hu\n", mtbl->lru_last);
-        rc = remove_mem(fent, mtbl->mem[mtbl->lru_last].tag);
-        if(rc == 1)
+        if(ment->ref)
         {
-            return 1;
-        } 
-    }
-    return 0;
-}
-
-
-/** 
- * Used to obtain a block for storage of data identified by the offset 
- * parameter and maintained in the mtbl at the memory entry identified by the 
- * index parameter.
- *
- * If a free block could be aquired, returns the memory address of the block 
- * just inserted. Otherwise, returns NIL.
- */
-static inline void *set_item(struct file_ent_s *fent, 
-                    uint64_t offset, 
-                    uint16_t index)
-{
-        uint16_t free_blk = get_free_blk();
-
-        struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
-
-        /* No Free Blocks Available */
-        if(free_blk == NIL16)
-        {
-            evict_LRU(fent); 
-            free_blk = get_free_blk();
-        }
-        
-        /* After Eviction Routine - No Free Blocks Available, Evict from mtbl 
-         * with the most memory entries 
-         */
-        if(free_blk == NIL16)   
-        {
-            struct file_ent_s *max_fent = 0;
-            struct mem_table_s *max_mtbl;
-            uint16_t ment_count = 0;
-            ment_count = locate_max_fent(&max_fent);
-            max_mtbl = ucache_get_mtbl(max_fent->mtbl_blk, max_fent->mtbl_ent);
-            if(ment_count == 0 || max_mtbl->lru_last == NIL16)
-            {
-                goto errout;
-            }
-            evict_LRU(max_fent);
-            free_blk = get_free_blk();
-        }
-        /* TODO: other policy? */
-
-
-        /* A Free Block is Avaiable for Use */
-        if(free_blk != NIL16)
-        {
-            mtbl->num_blocks++;
-            update_LRU(mtbl, index);
-            /* set item to block number */
-            mtbl->mem[index].tag = offset;
-            mtbl->mem[index].item = free_blk;
-            /* add block index to head of dirty list */
-            mtbl->mem[index].dirty_next = mtbl->dirty_list;
-            mtbl->dirty_list = index;
-            /* Return the address of the block where data is stored */
-            return (void *)&(ucache->b[free_blk]); 
+            ment->ref = 0;
+            continue;
         }
-errout:
-    return (void *)(NIL);
-}
-
-/** 
- * Requests a location in memory to place the data identified by the mtbl and 
- * offset parameters. Also inserts the necessary info into the mtbl.
- *
- */
-static inline void *insert_mem(struct file_ent_s *fent, uint64_t offset,
-                                              uint16_t *block_ndx)
-{
-    void* rc = 0;
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
-
-    /* Lookup first */
-    void *returnValue = lookup_mem(mtbl, offset, block_ndx, NULL, NULL);
-    if(returnValue != (void *)NIL)
-    {
-        /* Already exists in mtbl so just return a ptr to the blk */
-        return returnValue;
-    }
-
-    /* Index into mem hash table */
-    /* Hash to a bucket */
-    uint16_t index = (uint16_t) ((offset / CACHE_BLOCK_SIZE) % MEM_TABLE_HASH_MAX);
-
-    int evict_rc = 0;
-    uint16_t mentIndex = get_free_ment(mtbl);
-    if(mentIndex == NIL16)
-    {   /* No free ment available, so attempt eviction, and try again */
-        evict_rc = evict_LRU(fent);
-        if(evict_rc == 1)
+        if(claim_blk(ndx, held_stripe))
         {
-            mentIndex = get_free_ment(mtbl);
+            return ndx;
         }
     }
-
-    /* Eviction Failed */
-    if(mentIndex == NIL16)
-    {
-        return (void *)NULL;
-    }
-
-    /* Procede with memory insertion if ment aquired */
-    uint16_t next_ment = NIL16;
-    /* Insert at head, keeping track of the previous head */
-    next_ment = mtbl->bucket[index];
-    mtbl->bucket[index] = mentIndex;
-
-    rc = set_item(fent, offset, mentIndex);
-    if(rc != (void *)NIL)
-    {
-        mtbl->mem[mentIndex].next = next_ment;
-        *block_ndx = mtbl->mem[mentIndex].item;
-        return rc;      
-    }
-    else
-    {
-        /* Restore the previous head back to head of the chain */
-        mtbl->bucket[index] = next_ment;
-        return (void *)NIL;   
-    } 
+    return NIL64;
 }
 
-/** 
- * Removes all table info regarding the block identified by the mtbl and
- * offset provided the block isn't locked. 
- *
- * Flushing the block to fs now occurs here upon removal from cache. 
- * 
- * On success returns 1, on failure returns 0.
+/**
+ * Tries to take a block for reuse.  A free block is simply pinned; a block
+ * in use must be unpinned and its stripe lock available (unless it is
+ * held_stripe, which the caller already holds), and is written out if dirty
+ * before it is unlinked.  Never waits for a stripe lock.
  *
+ * Returns 1 with the block free and pinned once for the caller, else 0.
  */
-static int remove_mem(struct file_ent_s *fent, uint64_t offset)
+static int claim_blk(ucache_ndx_t ndx, uint32_t held_stripe)
 {
-    struct mem_table_s *mtbl = ucache_get_mtbl(fent->mtbl_blk, fent->mtbl_ent);
-
-    /* Some Indices */
-    uint16_t item_index = NIL16; /* index of cached block */
-    uint16_t mem_ent_index = NIL16;
-    uint16_t mem_ent_prev_index = NIL16;
+    struct mem_ent_s *ment = &(ucache->mem[ndx]);
+    ucache_lock_t *stripe = NULL;
+    uint32_t stripe_ndx;
 
-    void *retValue = lookup_mem(mtbl, offset, &item_index, &mem_ent_index, 
-                                                     &mem_ent_prev_index);
-    /* Verify we've recieved the necessary info */
-    if(retValue == (void *)NIL)
+    if(!__sync_bool_compare_and_swap(&ment->pin, 0, 1))
     {
         return 0;
     }
-
-    /* Verify the block isn't being used by trying the corresponding lock */
-    ucache_lock_t *block_lock = get_lock(mtbl->mem[mem_ent_index].item);
-    int rc = lock_trylock(block_lock);
-    if(rc != 0)
+    if(ment->fent == NIL32)
     {
-        return -1;
+        return 1;
     }
 
-    /* Aquire Lock */
-    lock_lock(block_lock);
-
-    /* Optionally flush block - may need to be mandatory */
-    flush_block(fent, &(mtbl->mem[mem_ent_index]));
-
-    /* Update First and Last...First */
-    if(mem_ent_index == mtbl->lru_first)
+    /* Nobody else can claim it now, so bucket won't change under us */
+    stripe_ndx = UCACHE_STRIPE_LOCK(ment->bucket);
+    if(stripe_ndx != held_stripe)
     {
-        /* Node is the head */
-        mtbl->lru_first = mtbl->mem[mem_ent_index].lru_next;
-    }
-    if(mem_ent_index == mtbl->lru_last)
-    {
-        /* Node is the tail */
-        mtbl->lru_last = mtbl->mem[mem_ent_index].lru_prev;
-    }
-    
-    /* Remove from LRU */
-    /* Update each of the adjacent nodes' link */
-    uint16_t lru_prev = mtbl->mem[mem_ent_index].lru_prev;
-    if(lru_prev != NIL16)
-    {
-        mtbl->mem[lru_prev].lru_next = mtbl->mem[mem_ent_index].lru_next;
+        stripe = get_lock(stripe_ndx);
+        if(lock_tryacquire(stripe) != 0)
+        {
+            unpin_blk(ndx);
+            return 0;
+        }
     }
-    uint16_t lru_next = mtbl->mem[mem_ent_index].lru_next;
-    if(lru_next != NIL16)
+
+    /* A lookup may have pinned it before we got the stripe lock */
+    if(ment->pin != 1 || (ment->dirty && flush_block(ndx) != 0) ||
+       !unlink_mem(ndx))
     {
-        mtbl->mem[lru_next].lru_prev = mtbl->mem[mem_ent_index].lru_prev;
+        if(stripe)
+        {
+            lock_unlock(stripe);
+        }
+        unpin_blk(ndx);
+        return 0;
     }
 
-    /* Add memory block back to free list */
-    put_free_blk(item_index);
-
-    /* Repair link */
-    if(mem_ent_prev_index != NIL16)
+    if(stripe)
     {
-        mtbl->mem[mem_ent_prev_index].next = mtbl->mem[mem_ent_index].next;
+        lock_unlock(stripe);
     }
-
-    /* Newly free mem entry becomes new head of free mem entry list if index 
-     * is less than hash table max 
-     */
-    put_free_ment(mtbl, mem_ent_index);
-    mtbl->num_blocks--;
-
-    /* Release Lock */
-    lock_unlock(block_lock);
+    __sync_fetch_and_add(&ucache_stats->evictions, 1);
     return 1;
 }
 
-/* The following two functions are provided for error checking purposes. */
 /**
- * Prints the Least Recently Used (LRU) list.
+ * Drops one pin on a block.
  */
-void print_LRU(struct mem_table_s *mtbl)
+static inline void unpin_blk(ucache_ndx_t ndx)
 {
-    fprintf(out, "\tprinting lru list:\n");
-    fprintf(out, "\t\tmru: %hu\n", mtbl->lru_first);
-    fprintf(out, "\t\t\tmru->lru_prev = %hu\n\t\t\tmru->lru_next = %hu\n", 
-        mtbl->mem[mtbl->lru_first].lru_prev, mtbl->mem[mtbl->lru_first].lru_next);
-    uint16_t current = mtbl->mem[mtbl->lru_first].lru_next; 
-    while(current != mtbl->lru_last && current != NIL16)
-    {
-        fprintf(out, "\t\t\tcurr->lru_prev = %hu\n", 
-                       mtbl->mem[current].lru_prev);
-        fprintf(out, "\t\t%hu\n", current);
-        fprintf(out, "\t\t\tcurr->lru_next = %hu\n",
-                       mtbl->mem[current].lru_next);
-        current = mtbl->mem[current].lru_next;
-    }
-    fprintf(out, "\t\tlru: %hu\n", mtbl->lru_last);
-    fprintf(out, "\t\t\tlru->lru_prev = %hu\n\t\t\tlru->lru_next = %hu\n", 
-        mtbl->mem[mtbl->lru_last].lru_prev, mtbl->mem[mtbl->lru_last].lru_next);
+    __sync_fetch_and_sub(&ucache->mem[ndx].pin, 1);
 }
 
-/**
- * Prints the list of dirty (modified) blocks that should eventually be 
- * flushed to disk.
- */
-void print_dirty(struct mem_table_s *mtbl)
-{
-    fprintf(out, "\tprinting dirty list:\n");
-    int i;
-    for(i = 0; !dirty_done(i); i = dirty_next(mtbl, i))
-    {
-        fprintf(out, "\t\tment index = %hu\t\t\tdirty_next = %hu\n", 
-                                            i, dirty_next(mtbl, i));
-    }
-    if(i >= MEM_TABLE_ENTRY_COUNT && i != NIL16)
-    {
-        fprintf(out, "BAD MEM_TABLE_ENTRY INDEX: %hu\n", i);
-        exit(0);
-    } 
-    fprintf(out, "\t\tdone w/ dirty list\n");
-} 
-
 /*  End of Internal Only Functions    */
 #endif /* PVFS_UCACHE_ENABLE */
 
@@ -16,27 +16,35 @@
 #include <pthread.h>
 #include <sys/shm.h>
 
-#define MEM_TABLE_ENTRY_COUNT 679
 #define FILE_TABLE_ENTRY_COUNT 512 
 #define CACHE_BLOCK_SIZE_K 256
 #define CACHE_BLOCK_SIZE (CACHE_BLOCK_SIZE_K * 1024)
-#define MEM_TABLE_HASH_MAX 31
 #define FILE_TABLE_HASH_MAX 31
-#define MTBL_PER_BLOCK 16
 #define KEY_FILE "/etc/fstab"
 #define SHM_ID1 'l'
 #define SHM_ID2 'm'
 #ifndef BLOCKS_IN_CACHE 
 # define BLOCKS_IN_CACHE 1024
 #endif
-#define CACHE_SIZE (CACHE_BLOCK_SIZE * BLOCKS_IN_CACHE)
+/* Buckets in the block index, which is keyed on file entry and offset */
+#ifndef UCACHE_HASH_BUCKETS
+# define UCACHE_HASH_BUCKETS (BLOCKS_IN_CACHE * 2)
+#endif
+/* Locks guarding the block index; a block is covered by the lock of the
+ * bucket it hashes to, so the blocks of one file spread across all of them.
+ */
+#ifndef UCACHE_LOCK_STRIPES
+# define UCACHE_LOCK_STRIPES 256
+#endif
+#define CACHE_SIZE (sizeof(struct ucache_s))
 #define AT_FLAGS 0
 #define SVSHM_MODE (SHM_R | SHM_W | SHM_R>>3 | SHM_R>>6)
 #define CACHE_FLAGS (SVSHM_MODE)
 #define NIL (-1)
 
+/* Largest request, in blocks, that is passed through the cache */
 #ifndef UCACHE_MAX_BLK_REQ 
-# define UCACHE_MAX_BLK_REQ MEM_TABLE_ENTRY_COUNT
+# define UCACHE_MAX_BLK_REQ 1024
 #endif
 
 #ifndef UCACHE_MAX_REQ 
@@ -54,6 +62,9 @@
 # define NILP NIL64
 #endif
 
+/* Index of a cache block */
+typedef uint64_t ucache_ndx_t;
+
 
 #ifndef DBG
 #define DBG 0 
@@ -85,18 +96,25 @@
 # define LOCK_SIZE sizeof(gen_mutex_t)
 #endif
 
-#define LOCKS_SIZE ((LOCK_SIZE) * (BLOCKS_IN_CACHE + 1))
+/* Layout of the lock array: the index stripes, one lock per file entry,
+ * then the global lock, which guards only the file table.  Locks are
+ * taken in the order global, stripe, file; a second stripe is only ever
+ * taken with a trylock.
+ */
+#define UCACHE_STRIPE_LOCK(bucket) ((bucket) % UCACHE_LOCK_STRIPES)
+#define UCACHE_FILE_LOCK(fent_ndx) (UCACHE_LOCK_STRIPES + (fent_ndx))
+#define UCACHE_GLOBAL_LOCK (UCACHE_LOCK_STRIPES + FILE_TABLE_ENTRY_COUNT)
+#define UCACHE_LOCK_COUNT (UCACHE_GLOBAL_LOCK + 1)
+
+#define LOCKS_SIZE ((LOCK_SIZE) * UCACHE_LOCK_COUNT)
 
-#define UCACHE_STATS_64 3
-#define UCACHE_STATS_16 2
 /* This is the size of the ucache_aux auxilliary shared mem segment */
-#define UCACHE_AUX_SIZE ( LOCKS_SIZE + (UCACHE_STATS_64 * 8) + \
-    (UCACHE_STATS_16 * 2))
+#define UCACHE_AUX_SIZE (sizeof(struct ucache_aux_s))
 
 /* Globals */
 extern FILE * out;
 extern int ucache_enabled;
-extern union ucache_u *ucache;
+extern struct ucache_s *ucache;
 extern struct ucache_aux_s *ucache_aux;
 extern ucache_lock_t *ucache_locks;
 extern ucache_lock_t *ucache_lock;
@@ -105,14 +123,16 @@ extern struct ucache_stats_s these_stats;
 
 /** A structure containing the statistics summarizing the ucache. 
  *
+ *  The shared copy is only updated with atomic adds.
  */
 struct ucache_stats_s
 {
     uint64_t hits;
     uint64_t misses;
     uint64_t pseudo_misses;
-    uint16_t block_count;
-    uint16_t file_count;
+    uint64_t evictions;
+    uint64_t block_count;
+    uint64_t file_count;
 };
 
 /** A structure containing the auxilliary data required by ucache to properly
@@ -120,68 +140,57 @@ struct ucache_stats_s
  */
 struct ucache_aux_s
 {
-    ucache_lock_t ucache_locks[BLOCKS_IN_CACHE + 1]; /* +1 for global lock */
+    ucache_lock_t ucache_locks[UCACHE_LOCK_COUNT];
     struct ucache_stats_s ucache_stats; /* Summary Statistics of ucache */
 };
 
-/** A link for one block of memory in a files hash table
+/** Describes what one cache block holds
  *
+ *  tag, fent, bucket and next change only under the block's stripe lock
+ *  and while the changer holds the block's only pin; file_prev/file_next
+ *  also need the owning file's lock.  pin is changed atomically; ref is
+ *  the CLOCK reference bit and is set without a lock.
  */
-/* 24 bytes */
+/* 56 bytes */
 struct mem_ent_s
 {
     uint64_t tag;           /* offset of data block in file */
-    uint16_t item;          /* index of cache block with data */
-    uint16_t next;          /* use for hash table chain */
-    uint16_t dirty_next;    /* if dirty used in dirty list */
-    uint16_t lru_prev;      /* used in lru list */
-    uint16_t lru_next;      /* used in lru list */
-    char pad[6];
+    ucache_ndx_t next;      /* next block on the same index chain */
+    ucache_ndx_t bucket;    /* index chain this block is on */
+    ucache_ndx_t file_prev; /* neighbours on the owning file's block list */
+    ucache_ndx_t file_next;
+    uint32_t fent;          /* index of owning file entry, NIL32 if free */
+    uint32_t fill;          /* bytes at the start of the block holding data */
+    uint32_t pin;           /* number of requests using the block */
+    uint8_t ref;            /* set on use, cleared by the CLOCK sweep */
+    uint8_t dirty;          /* must be written out before reuse */
+    char pad[2];
 };
 
-/** A cache for a specific file
+/** One block of cached file data
  *
- *  Keyed on the address of the block of memory
  */
-struct mem_table_s
+struct cache_block_s
 {
-    uint16_t num_blocks;        /* number of used blocks in this mtbl */
-    uint16_t free_list;         /* index of next free mem entry */
-    uint16_t free_list_blk;     /* used when mtbl is on mtbl free list and to track free blks */
-    uint16_t lru_first;         /* index of first block on lru list */
-    uint16_t lru_last;          /* index of last block on lru list */
-    uint16_t dirty_list;        /* index of first dirty block */
-    uint16_t ref_cnt;           /* number of clients using this record */
-    uint16_t bucket[MEM_TABLE_HASH_MAX]; /* bucket may contain index of ment */
-    char pad[4];
-    struct mem_ent_s mem[MEM_TABLE_ENTRY_COUNT];
-    char pad2[8];
-};
-
-/** One allocation block in the cache
- *
- *  Either a block of memory or a block of mtbls
- */
-union cache_block_u
-{
-    struct mem_table_s mtbl[MTBL_PER_BLOCK];
-    char mblk[CACHE_BLOCK_SIZE_K * 1024];
+    char mblk[CACHE_BLOCK_SIZE];
 }; 
 
-/** A link for one file in the top level hash table
+/** A link for one file in the file table
  *
+ *  Everything but size, num_blocks and blk_first is guarded by the global
+ *  lock; those three by the file's own lock.
  */
-/* 32 bytes */
+/* 48 bytes */
 struct file_ent_s
 {
     uint64_t tag_handle;    /* PVFS_handle */
     uint32_t tag_id;        /* PVFS_fs_id */
-    uint16_t mtbl_blk;      /* block index of this mtbl */
-    uint16_t mtbl_ent;      /* entry index of this mtbl */
-    uint16_t next;          /* next fent in chain */
-    uint16_t index;         /* fent index in ftbl */
+    uint32_t index;         /* fent index in ftbl */
+    uint32_t next;          /* next fent in chain or on free list */
+    uint32_t ref_cnt;       /* number of clients using this record */
     uint64_t size;          /* cache maintenance of file size */
-    char pad[4];
+    uint64_t num_blocks;    /* number of blocks held for this file */
+    ucache_ndx_t blk_first; /* head of this file's block list */
 };
 
 /** A hash table to find caches for specific files
@@ -190,41 +199,52 @@ struct file_ent_s
  */
 struct file_table_s
 {
-    uint16_t free_blk;  /* index of the next free block */
-    uint16_t free_mtbl_blk; /* block index of next free mtbl */
-    uint16_t free_mtbl_ent; /* entry index of next free mtbl */
-    uint16_t free_list; /* index of next free file entry */
-    char pad[8];
+    uint32_t bucket[FILE_TABLE_HASH_MAX]; /* head of each fent chain */
+    uint32_t free_list; /* index of next free file entry */
+    uint64_t clock_hand; /* next block looked at by the CLOCK sweep */
     struct file_ent_s file[FILE_TABLE_ENTRY_COUNT];
 };
 
 /** The whole system wide cache
  *
+ *  The data blocks come first so that they stay page aligned.
  */
-union ucache_u
+struct ucache_s
 {
+    struct cache_block_s b[BLOCKS_IN_CACHE];
+    struct mem_ent_s mem[BLOCKS_IN_CACHE];
+    ucache_ndx_t bucket[UCACHE_HASH_BUCKETS]; /* head of each block chain */
     struct file_table_s ftbl;
-    union cache_block_u b[0]; /* actual size of this varies */
 };
 
 struct ucache_ref_s
 {
-    union ucache_u *ucache;     /* pointer to ucache shmem */
+    struct ucache_s *ucache;        /* pointer to ucache shmem */
     ucache_lock_t *ucache_locks;    /* pointer to ucache locks */
 };
 
 /* externally visible API */
-union ucache_u *get_ucache(void);
+struct ucache_s *get_ucache(void);
 int ucache_initialize(void);
 int ucache_open_file(PVFS_fs_id *fs_id,
                      PVFS_handle *handle, 
                      struct file_ent_s **fent);
 int ucache_close_file(struct file_ent_s *fent);
-inline struct mem_table_s *ucache_get_mtbl(uint16_t mtbl_blk, uint16_t mtbl_ent);
-inline void *ucache_lookup(struct file_ent_s *fent, uint64_t offset, uint16_t *block_ndx);
-inline void *ucache_insert(struct file_ent_s *fent, 
+void *ucache_lookup(struct file_ent_s *fent,
+                    uint64_t offset,
+                    ucache_ndx_t *block_ndx);
+void *ucache_insert(struct file_ent_s *fent, 
                     uint64_t offset, 
-                    uint16_t *block_ndx);
+                    ucache_ndx_t *block_ndx);
+void ucache_release(ucache_ndx_t block_ndx);
+
+/* Call these with the block's lock held */
+ucache_lock_t *ucache_block_lock(ucache_ndx_t block_ndx);
+uint32_t ucache_block_fill(ucache_ndx_t block_ndx);
+void ucache_block_set_fill(ucache_ndx_t block_ndx, uint32_t fill);
+void ucache_block_dirty(ucache_ndx_t block_ndx, uint32_t end);
+
+void ucache_update_size(struct file_ent_s *fent, uint64_t size);
 int ucache_info(FILE *out, char *flags);
 
 int ucache_flush_cache(void); 
@@ -237,11 +257,12 @@ int ucache_init_file_table(char forceCreation);
 int wipe_ucache(void);
 
 /* Lock Routines */
-inline ucache_lock_t *get_lock(uint16_t block_index);
+ucache_lock_t *get_lock(uint32_t lock_index);
 int lock_init(ucache_lock_t * lock);
-inline int lock_lock(ucache_lock_t * lock);
-inline int lock_unlock(ucache_lock_t * lock);
-inline int lock_trylock(ucache_lock_t * lock);
+int lock_lock(ucache_lock_t * lock);
+int lock_unlock(ucache_lock_t * lock);
+int lock_trylock(ucache_lock_t * lock);
+int lock_tryacquire(ucache_lock_t * lock);
 
 #endif /* UCACHE_H */
 
@@ -9,12 +9,26 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#include <stddef.h>
 
 #include "pvfs2-internal.h"
 #include "dist-dir-utils.h"
 #include "md5.h"
+#include "murmur3.h"
 #include "bmi-byteswap.h"
 
+#define DIST_DIR_MURMUR3_SEED 0x5046u
+
+static const struct
+{
+    int hash_type;
+    const char *name;
+} dist_dir_hash_names[] =
+{
+    { PVFS_DIST_DIR_HASH_MD5, "md5" },
+    { PVFS_DIST_DIR_HASH_MURMUR3, "murmur3" }
+};
+
 
 /****************************
  * helper functions
@@ -135,6 +149,9 @@ int PINT_init_dist_dir_state(
 
 	/* set split size */
 	dist_dir_attr->split_size = split_size;
+
+	/* callers pick a faster hash for new directories if configured */
+	dist_dir_attr->hash_type = PVFS_DIST_DIR_HASH_MD5;
 	return 0;
 }
 
@@ -297,6 +314,88 @@ PVFS_dist_dir_hash_type PINT_encrypt_dirdata(const char *const name)
         return bmitoh64(*hash_val);
 }
 
+/* hash a dirent name with the function its directory was created with;
+ * clients and servers must agree on the result, so the same name always
+ * lands in the same bucket.  Note that MurmurHash3_x64_128 reads the name
+ * in host order words, so a file system mixing big and little endian
+ * hosts should keep md5.
+ */
+PVFS_dist_dir_hash_type PINT_dist_dir_hash(
+		const PVFS_dist_dir_attr *const dist_dir_attr,
+		const char *const name)
+{
+	uint64_t out[2];
+
+	switch(dist_dir_attr->hash_type)
+	{
+	case PVFS_DIST_DIR_HASH_MURMUR3:
+		MurmurHash3_x64_128(name, strlen(name),
+			DIST_DIR_MURMUR3_SEED, out);
+		return out[0];
+	case PVFS_DIST_DIR_HASH_MD5:
+	default:
+		return PINT_encrypt_dirdata(name);
+	}
+}
+
+/* check a dist_dir_attr read back from trove; read_sz is the size of the
+ * stored record.  Records written before hash_type existed are shorter
+ * and are md5 directories.  Returns 0, or -PVFS_EINVAL if the record
+ * names a hash this server does not know.
+ */
+int PINT_dist_dir_attr_check_read(PVFS_dist_dir_attr *dist_dir_attr,
+		const int read_sz)
+{
+	if(read_sz < offsetof(PVFS_dist_dir_attr, hash_type) +
+		sizeof(dist_dir_attr->hash_type))
+	{
+		dist_dir_attr->hash_type = PVFS_DIST_DIR_HASH_MD5;
+		return 0;
+	}
+
+	switch(dist_dir_attr->hash_type)
+	{
+	case PVFS_DIST_DIR_HASH_MD5:
+	case PVFS_DIST_DIR_HASH_MURMUR3:
+		return 0;
+	default:
+		gossip_err("%s: unknown dist-dir hash type %d\n",
+			__func__, dist_dir_attr->hash_type);
+		return -PVFS_EINVAL;
+	}
+}
+
+/* returns the hash type named by str, or -PVFS_EINVAL */
+int PINT_dist_dir_hash_from_str(const char *str)
+{
+	int i;
+
+	for(i = 0; i < sizeof(dist_dir_hash_names) /
+		sizeof(dist_dir_hash_names[0]); i++)
+	{
+		if(strcasecmp(str, dist_dir_hash_names[i].name) == 0)
+		{
+			return dist_dir_hash_names[i].hash_type;
+		}
+	}
+	return -PVFS_EINVAL;
+}
+
+const char *PINT_dist_dir_hash_to_str(const int hash_type)
+{
+	int i;
+
+	for(i = 0; i < sizeof(dist_dir_hash_names) /
+		sizeof(dist_dir_hash_names[0]); i++)
+	{
+		if(dist_dir_hash_names[i].hash_type == hash_type)
+		{
+			return dist_dir_hash_names[i].name;
+		}
+	}
+	return "unknown";
+}
+
 
 
 /* set server_no field and update branch_level if necessary */
@@ -13,10 +13,11 @@
 #define PINT_debug_dist_dir_attr(debugmask,dist_dir_attr) \
     do {gossip_debug(debugmask, \
         "dist_dir_attr: tree_height=%d, num_servers=%d, bitmap_size=%d, "\
-        "split_size=%d, server_no=%d and branch_level=%d\n", \
+        "split_size=%d, server_no=%d, branch_level=%d and hash_type=%d\n", \
         dist_dir_attr.tree_height, dist_dir_attr.num_servers, \
         dist_dir_attr.bitmap_size, dist_dir_attr.split_size, \
-        dist_dir_attr.server_no, dist_dir_attr.branch_level); } while (0)
+        dist_dir_attr.server_no, dist_dir_attr.branch_level, \
+        dist_dir_attr.hash_type); } while (0)
 
 #define PINT_debug_dist_dir_bitmap(debugmask,dist_dir_attr,dist_dir_bitmap) \
     do { int i; \
@@ -96,6 +97,13 @@ int PINT_update_dist_dir_bitmap_from_bitmap(
 		const PVFS_dist_dir_attr *from_dir_attr, 
 		const PVFS_dist_dir_bitmap from_dir_bitmap);
 PVFS_dist_dir_hash_type PINT_encrypt_dirdata(const char *const name);
+PVFS_dist_dir_hash_type PINT_dist_dir_hash(
+		const PVFS_dist_dir_attr *const dist_dir_attr,
+		const char *const name);
+int PINT_dist_dir_attr_check_read(PVFS_dist_dir_attr *dist_dir_attr,
+		const int read_sz);
+int PINT_dist_dir_hash_from_str(const char *str);
+const char *PINT_dist_dir_hash_to_str(const int hash_type);
 int PINT_dist_dir_set_serverno(const int server_no, 
 	PVFS_dist_dir_attr *ddattr, 
 	PVFS_dist_dir_bitmap ddbitmap);
@@ -108,6 +116,7 @@ do { \
 	to_attr.split_size = from_attr.split_size; \
 	to_attr.server_no = from_attr.server_no; \
 	to_attr.branch_level = from_attr.branch_level; \
+	to_attr.hash_type = from_attr.hash_type; \
 } while(0)
 	
 
@@ -33,6 +33,7 @@
 #include "quickhash.h"
 #include "extent-utils.h"
 #include "pint-cached-config.h"
+#include "gen-locks.h"
 
 /* really old linux distributions (jazz's RHEL 3) don't have this(!?) */
 #ifndef HOST_NAME_MAX
@@ -79,6 +80,9 @@ struct config_fs_cache_s
 
 struct qhash_table *PINT_fsid_config_cache_table = NULL;
 
+/* serializes filling in the cached server arrays on first use */
+static gen_mutex_t server_array_mutex = GEN_MUTEX_INITIALIZER;
+
 /* these are based on code from src/server/request-scheduler.c */
 static int hash_fsid(const void *fsid, int table_size);
 static int hash_fsid_compare(const void *key, struct qlist_head *link);
@@ -445,6 +449,7 @@ int PINT_cached_config_get_next_meta(PVFS_fs_id fsid,
     struct host_handle_mapping_s *cur_mapping = NULL;
     struct qlist_head *hash_link = NULL;
     struct config_fs_cache_s *cur_config_cache = NULL;
+    PINT_llist *cursor = NULL;
 
     if (!ext_array)
     {
@@ -471,29 +476,29 @@ int PINT_cached_config_get_next_meta(PVFS_fs_id fsid,
 
     randsrv = (rand() % num_meta_servers);
 
-    /* set cursor at beginning of list */
-    cur_config_cache->meta_server_cursor =
-                    cur_config_cache->fs->meta_handle_ranges;
+    /* set cursor at beginning of list; walk a local copy so that
+     * concurrent callers never see it pass the end of the list
+     */
+    cursor = cur_config_cache->fs->meta_handle_ranges;
 
     while(randsrv--)
     {
-        cur_config_cache->meta_server_cursor =
-                        PINT_llist_next(cur_config_cache->meta_server_cursor);
-        if (!cur_config_cache->meta_server_cursor)
+        cursor = PINT_llist_next(cursor);
+        if (!cursor)
         {
             /* found end of list before we should have */
             gossip_err("Found end of list of metaservers "
                        "before expected in "
                        "PINT_cached_config_get_next_meta\n");
             /* return first metaserver */
-            cur_config_cache->meta_server_cursor =
-                            cur_config_cache->fs->meta_handle_ranges;
+            cursor = cur_config_cache->fs->meta_handle_ranges;
             break;
         }
 
     }
+    cur_config_cache->meta_server_cursor = cursor;
 
-    cur_mapping = PINT_llist_head(cur_config_cache->meta_server_cursor);
+    cur_mapping = PINT_llist_head(cursor);
 
     meta_server_bmi_str = cur_mapping->alias_mapping->bmi_address;
 
@@ -1590,6 +1595,7 @@ static int cache_server_array(PVFS_fs_id fsid)
     assert(cur_config_cache->fs);
 
     /* first check to see if we have the array information cached */
+    gen_mutex_lock(&server_array_mutex);
     if (cur_config_cache->server_count < 1)
     {
         /* we need to fill in this stuff in our config cache */
@@ -1663,6 +1669,7 @@ static int cache_server_array(PVFS_fs_id fsid)
                 ret = BMI_addr_lookup(&tmp_bmi_addr, server_bmi_str, NULL);
                 if (ret < 0)
                 {
+                    gen_mutex_unlock(&server_array_mutex);
                     return(ret);
                 }
 
@@ -1717,6 +1724,7 @@ static int cache_server_array(PVFS_fs_id fsid)
         cur_config_cache->meta_server_count = array_index;
         cur_config_cache->io_server_count = array_index2;
     }
+    gen_mutex_unlock(&server_array_mutex);
     return 0;
 
 cleanup_allocations:
@@ -1732,6 +1740,7 @@ cleanup_allocations:
     {
         free(cur_config_cache->server_array);
     }
+    gen_mutex_unlock(&server_array_mutex);
     return ret;
 }
 
@@ -100,6 +100,35 @@ struct PINT_perf_key server_keys[] =
     {"io requests called", PINT_PERF_IO, PINT_PERF_PRESERVE},
     {"small_io requests called", PINT_PERF_SMALL_IO, PINT_PERF_PRESERVE},
     {"readdir requests called", PINT_PERF_READDIR, PINT_PERF_PRESERVE},
+    {"alt-aio queue depth", PINT_PERF_ALTAIO_QUEUE_DEPTH, PINT_PERF_PRESERVE},
+    {"alt-aio requests", PINT_PERF_ALTAIO_REQUESTS, PINT_PERF_PRESERVE},
+    {"alt-aio syscalls", PINT_PERF_ALTAIO_SYSCALLS, PINT_PERF_PRESERVE},
+    {"flow buffer pool hits", PINT_PERF_FLOWBUF_HITS, PINT_PERF_PRESERVE},
+    {"flow buffer pool misses", PINT_PERF_FLOWBUF_MISSES, PINT_PERF_PRESERVE},
+    {"flow buffers in use", PINT_PERF_FLOWBUF_IN_USE, PINT_PERF_PRESERVE},
+    {"flow buffers cached", PINT_PERF_FLOWBUF_CACHED, PINT_PERF_PRESERVE},
+    {"bmi messages sent", PINT_PERF_BMI_MSGS_SENT, PINT_PERF_PRESERVE},
+    {"bmi send syscalls", PINT_PERF_BMI_SEND_CALLS, PINT_PERF_PRESERVE},
+    {"bmi messages received", PINT_PERF_BMI_MSGS_RECV, PINT_PERF_PRESERVE},
+    {"bmi recv syscalls", PINT_PERF_BMI_RECV_CALLS, PINT_PERF_PRESERVE},
+    {"attr cache hits", PINT_PERF_ATTRCACHE_HITS, PINT_PERF_PRESERVE},
+    {"attr cache misses", PINT_PERF_ATTRCACHE_MISSES, PINT_PERF_PRESERVE},
+    {"attr cache evictions", PINT_PERF_ATTRCACHE_EVICTIONS,
+     PINT_PERF_PRESERVE},
+    {"attr cache bytes", PINT_PERF_ATTRCACHE_BYTES, PINT_PERF_PRESERVE},
+    {"metadata requests < 1ms", PINT_PERF_QOS_META_1MS, PINT_PERF_PRESERVE},
+    {"metadata requests < 10ms", PINT_PERF_QOS_META_10MS,
+     PINT_PERF_PRESERVE},
+    {"metadata requests < 100ms", PINT_PERF_QOS_META_100MS,
+     PINT_PERF_PRESERVE},
+    {"metadata requests >= 100ms", PINT_PERF_QOS_META_SLOW,
+     PINT_PERF_PRESERVE},
+    {"io requests < 1ms", PINT_PERF_QOS_IO_1MS, PINT_PERF_PRESERVE},
+    {"io requests < 10ms", PINT_PERF_QOS_IO_10MS, PINT_PERF_PRESERVE},
+    {"io requests < 100ms", PINT_PERF_QOS_IO_100MS, PINT_PERF_PRESERVE},
+    {"io requests >= 100ms", PINT_PERF_QOS_IO_SLOW, PINT_PERF_PRESERVE},
+    {"request plan hits", PINT_PERF_REQPLAN_HITS, PINT_PERF_PRESERVE},
+    {"request plan misses", PINT_PERF_REQPLAN_MISSES, PINT_PERF_PRESERVE},
     {NULL, 0, 0},
 };
 
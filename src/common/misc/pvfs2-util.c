@@ -116,6 +116,8 @@ static int parse_encoding_string(const char *cp,
                                  enum PVFS_encoding_type *et);
 
 static int parse_num_dfiles_string(const char* cp, int* num_dfiles);
+static int parse_size_string(const char* cp, const char* name,
+                             PVFS_size* size);
 static int parse_bmi_opts_string(char *cp, char **bmi_opts);
 
 #ifndef ENABLE_SECURITY_MODE
@@ -1261,6 +1263,36 @@ static int PINT_util_parse_mnt_opts(const char *opts,
         mntent->default_num_dfiles = 0;
     }
 
+    /* find out if small writes may be buffered on this mount */
+    cp = strstr(opts, "wbcache");
+    if (cp)
+    {
+        ret = parse_size_string(cp, "wbcache", &(mntent->wbcache_size));
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    else
+    {
+        mntent->wbcache_size = 0;
+    }
+
+    /* find out how much may be read ahead on this mount */
+    cp = strstr(opts, "readahead");
+    if (cp)
+    {
+        ret = parse_size_string(cp, "readahead", &(mntent->readahead_size));
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    else
+    {
+        mntent->readahead_size = 0;
+    }
+
     /* find out if any bmi-specific options were specified */
     cp = strstr(opts, "bmi_opts");
     if (cp)
@@ -2171,6 +2203,8 @@ int PVFS_util_copy_mntent(
         dest_mntent->encoding = src_mntent->encoding;
         dest_mntent->fs_id = src_mntent->fs_id;
         dest_mntent->default_num_dfiles = src_mntent->default_num_dfiles;
+        dest_mntent->wbcache_size = src_mntent->wbcache_size;
+        dest_mntent->readahead_size = src_mntent->readahead_size;
     }
     return 0;
 
@@ -2528,6 +2562,63 @@ static int parse_num_dfiles_string(const char* cp, int* num_dfiles)
     return 0;
 }
 
+/*
+ * Pull out a size in bytes specified as the mount option name in the tab
+ * file.  The number may be followed by k, m or g.
+ *
+ * Input string is not modified; result goes into size.
+ *
+ * Returns 0 if all okay.
+ */
+static int parse_size_string(const char* cp, const char* name,
+                             PVFS_size* size)
+{
+    long long parsed_value = 0;
+    char* end_ptr = NULL;
+
+    gossip_debug(GOSSIP_CLIENT_DEBUG, "%s: input is %s\n",
+                 __func__, cp);
+
+    cp += strlen(name);
+
+    /* Skip optional spacing */
+    for (; isspace(*cp); cp++);
+
+    if (*cp != '=')
+    {
+        gossip_err("Error: %s: malformed %s option in tab file.\n",
+                   __func__, name);
+        return -PVFS_EINVAL;
+    }
+
+    /* Skip optional spacing */
+    for (++cp; isspace(*cp); cp++);
+
+    parsed_value = strtoll(cp, &end_ptr, 10);
+    if (end_ptr == cp || parsed_value < 0)
+    {
+        gossip_err("Error: %s: malformed %s option in tab file.\n",
+                   __func__, name);
+        return -PVFS_EINVAL;
+    }
+
+    switch (tolower(*end_ptr))
+    {
+        case 'g':
+            parsed_value *= 1024;
+            /* fall through */
+        case 'm':
+            parsed_value *= 1024;
+            /* fall through */
+        case 'k':
+            parsed_value *= 1024;
+            break;
+    }
+    *size = parsed_value;
+
+    return 0;
+}
+
 /* parse_bmi_opts_string()
  *
  * Gets the BMI options string specified as an option in the tab file.
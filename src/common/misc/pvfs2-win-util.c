@@ -125,6 +125,9 @@ static int parse_encoding_string(
 
 static int parse_num_dfiles_string(const char* cp, int* num_dfiles);
 
+static int parse_size_string(const char* cp, const char* name,
+                             PVFS_size* size);
+
 static int PINT_util_resolve_absolute(
     const char* local_path,
     PVFS_fs_id* out_fs_id,
@@ -853,6 +856,36 @@ const PVFS_util_tab *PVFS_util_parse_pvfstab(
                 }
             }
 
+            /* find out if small writes may be buffered on this mount */
+            current_tab->mntent_array[i].wbcache_size = 0;
+            cp = PINT_fstab_entry_hasopt(tmp_ent, "wbcache");
+            if (cp)
+            {
+                ret = parse_size_string(
+                    cp, "wbcache",
+                    &(current_tab->mntent_array[i].wbcache_size));
+
+                if (ret < 0)
+                {
+                    goto error_exit;
+                }
+            }
+
+            /* find out how much may be read ahead on this mount */
+            current_tab->mntent_array[i].readahead_size = 0;
+            cp = PINT_fstab_entry_hasopt(tmp_ent, "readahead");
+            if (cp)
+            {
+                ret = parse_size_string(
+                    cp, "readahead",
+                    &(current_tab->mntent_array[i].readahead_size));
+
+                if (ret < 0)
+                {
+                    goto error_exit;
+                }
+            }
+
             /* Loop counter increment */
             i++;
 
@@ -1800,6 +1833,8 @@ int PVFS_util_copy_mntent(
         dest_mntent->encoding = src_mntent->encoding;
         dest_mntent->fs_id = src_mntent->fs_id;
         dest_mntent->default_num_dfiles = src_mntent->default_num_dfiles;
+        dest_mntent->wbcache_size = src_mntent->wbcache_size;
+        dest_mntent->readahead_size = src_mntent->readahead_size;
     }
     return 0;
 
@@ -2156,6 +2191,63 @@ static int parse_num_dfiles_string(const char* cp, int* num_dfiles)
     return 0;
 }
 
+/*
+ * Pull out a size in bytes specified as the mount option name in the tab
+ * file.  The number may be followed by k, m or g.
+ *
+ * Input string is not modified; result goes into size.
+ *
+ * Returns 0 if all okay.
+ */
+static int parse_size_string(const char* cp, const char* name,
+                             PVFS_size* size)
+{
+    long long parsed_value = 0;
+    char* end_ptr = NULL;
+
+    gossip_debug(GOSSIP_CLIENT_DEBUG, "%s: input is %s\n",
+                 __func__, cp);
+
+    cp += strlen(name);
+
+    /* Skip optional spacing */
+    for (; isspace(*cp); cp++);
+
+    if (*cp != '=')
+    {
+        gossip_err("Error: %s: malformed %s option in tab file.\n",
+                   __func__, name);
+        return -PVFS_EINVAL;
+    }
+
+    /* Skip optional spacing */
+    for (++cp; isspace(*cp); cp++);
+
+    parsed_value = strtoll(cp, &end_ptr, 10);
+    if (end_ptr == cp || parsed_value < 0)
+    {
+        gossip_err("Error: %s: malformed %s option in tab file.\n",
+                   __func__, name);
+        return -PVFS_EINVAL;
+    }
+
+    switch (tolower(*end_ptr))
+    {
+        case 'g':
+            parsed_value *= 1024;
+            /* fall through */
+        case 'm':
+            parsed_value *= 1024;
+            /* fall through */
+        case 'k':
+            parsed_value *= 1024;
+            break;
+    }
+    *size = parsed_value;
+
+    return 0;
+}
+
 /* PVFS_util_resolve_absolute()
  *
  * given a local path of a file that may reside on a pvfs2 volume,
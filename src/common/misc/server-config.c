@@ -9,6 +9,7 @@
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <limits.h>
 #ifndef WIN32
 #include <unistd.h>
 #include <strings.h>
@@ -35,6 +36,7 @@
 #include "extent-utils.h"
 #include "mkspace.h"
 #include "pint-distribution.h"
+#include "dist-dir-utils.h"
 #include "pvfs2-server.h"
 
 #ifdef HAVE_OPENSSL
@@ -104,10 +106,21 @@ static DOTCONF_CB(get_flow_buffers_per_flow);
 static DOTCONF_CB(get_attr_cache_keywords_list);
 static DOTCONF_CB(get_attr_cache_size);
 static DOTCONF_CB(get_attr_cache_max_num_elems);
+static DOTCONF_CB(get_attr_cache_max_bytes);
 static DOTCONF_CB(get_trove_sync_meta);
 static DOTCONF_CB(get_trove_sync_data);
 static DOTCONF_CB(get_file_stuffing);
 static DOTCONF_CB(get_trove_max_concurrent_io);
+static DOTCONF_CB(get_trove_alt_aio_threads);
+static DOTCONF_CB(get_io_uring_queue_depth);
+static DOTCONF_CB(get_state_machine_threads);
+static DOTCONF_CB(get_qos_metadata_rate);
+static DOTCONF_CB(get_qos_metadata_burst);
+static DOTCONF_CB(get_qos_io_rate);
+static DOTCONF_CB(get_qos_io_burst);
+static DOTCONF_CB(get_qos_user_weights);
+static DOTCONF_CB(get_qos_client_weights);
+static DOTCONF_CB(get_attr_lease_max_msecs);
 /* Berkeley DB */
 static DOTCONF_CB(get_db_cache_size_bytes);
 static DOTCONF_CB(get_db_cache_type);
@@ -128,6 +141,8 @@ static DOTCONF_CB(get_client_retry_delay);
 static DOTCONF_CB(get_secret_key);
 static DOTCONF_CB(get_coalescing_high_watermark);
 static DOTCONF_CB(get_coalescing_low_watermark);
+static DOTCONF_CB(get_group_commit_max_ops);
+static DOTCONF_CB(get_group_commit_window);
 static DOTCONF_CB(get_trove_method);
 static DOTCONF_CB(get_small_file_size);
 static DOTCONF_CB(directio_thread_num);
@@ -164,6 +179,8 @@ static DOTCONF_CB(tree_threshold);
 static DOTCONF_CB(distr_dir_servers_initial);
 static DOTCONF_CB(distr_dir_servers_max);
 static DOTCONF_CB(distr_dir_split_size);
+static DOTCONF_CB(distr_dir_hash);
+static DOTCONF_CB(distr_dir_presplit_rate);
 
 static FUNC_ERRORHANDLER(errorhandler);
 const char *contextchecker(command_t *cmd, unsigned long mask);
@@ -681,6 +698,85 @@ static const configoption_t options[] =
     {"TroveMaxConcurrentIO", ARG_INT, get_trove_max_concurrent_io, NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"16"},
 
+    /* number of worker threads servicing list I/O when TroveMethod is
+     * alt-aio.  Adjacent requests on the same file are merged into a
+     * single vectored read or write before being handed to a worker.
+     */
+    {"TroveAltAIOThreads", ARG_INT, get_trove_alt_aio_threads, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"16"},
+
+    /* number of submission queue entries in the ring used when
+     * TroveMethod is io-uring.  There is one ring per server, shared by
+     * all of its file systems.
+     */
+    {"IOUringQueueDepth", ARG_INT, get_io_uring_queue_depth, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"256"},
+
+    /* number of threads that run server state machines.  With the default
+     * of 0 the main loop advances every state machine itself; otherwise
+     * it only waits for jobs to complete and hands the state machines to
+     * this many worker threads.  A state machine never runs on two
+     * threads at once, and the request scheduler still orders requests
+     * on the same handle.
+     */
+    {"StateMachineThreads", ARG_INT, get_state_machine_threads, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* the request scheduler sorts requests into two QoS classes,
+     * metadata and I/O (io and small_io requests), and can limit each to
+     * a number of requests per second with a token bucket.  While a
+     * class is at its limit, its requests are released round robin
+     * between users, weighted by QoSUserWeights and QoSClientWeights, so
+     * that no single user can take all of it.  A rate of 0, the default,
+     * means no limit.
+     */
+    {"QoSMetadataRate", ARG_INT, get_qos_metadata_rate, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* the number of metadata requests that may run back to back before
+     * QoSMetadataRate applies.  0 allows one second worth.
+     */
+    {"QoSMetadataBurst", ARG_INT, get_qos_metadata_burst, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* the I/O class equivalent of QoSMetadataRate */
+    {"QoSIORate", ARG_INT, get_qos_io_rate, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* the I/O class equivalent of QoSMetadataBurst */
+    {"QoSIOBurst", ARG_INT, get_qos_io_burst, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
+    /* relative shares of a throttled QoS class, by uid.  While a class
+     * is at its limit, each user may have as many requests released per
+     * round as its weight; users not listed have a weight of 1.
+     *
+     * <c>QoSUserWeights 0=8 1000=2 ...</c>
+     */
+    {"QoSUserWeights", ARG_LIST, get_qos_user_weights, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS, ""},
+
+    /* the equivalent of QoSUserWeights for requests that carry no
+     * credential and are accounted to the client that sent them.
+     * Clients are given as BMI addresses with an optional netmask or
+     * wildcard, as for RootSquash; the first match applies.
+     *
+     * <c>QoSClientWeights tcp://192.168.2.0@24=4 tcp://10.0.0.*=2 ...</c>
+     */
+    {"QoSClientWeights", ARG_LIST, get_qos_client_weights, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS, ""},
+
+    /* getattr responses carry a lease telling the client how long it may
+     * trust the returned attributes without asking again.  Leases grow
+     * with the time since the object last changed, up to this many
+     * milliseconds.  Leases cannot be recalled, so this is also the
+     * longest a client may see attributes that another client has since
+     * changed.  The default of 0 disables leases, leaving clients to
+     * their own cache timeouts.
+     */
+    {"AttrLeaseMaxMsecs", ARG_INT, get_attr_lease_max_msecs, NULL,
+        CTX_DEFAULTS|CTX_SERVER_OPTIONS,"0"},
+
     /* The gossip interface in OrangeFS allows users to specify different
      * levels of logging for the OrangeFS server.  The output of these
      * different log levels is written to a file, which is specified in
@@ -904,11 +1000,20 @@ static const configoption_t options[] =
 
     /* Specifies an options string to be passed to BMI upon initialization.
      * The format of the string is a comma-separated list of options.
-     * Currently, the only available option is:
+     * Currently, the available options are:
      *
      * <c>ib_port=N</c>, where <c>N</c> is the IB device port to use for
      * communication (default port is <c>1</c> if not specified).
      *
+     * <c>tcp_progress_threads=N</c>, where <c>N</c> is the number of
+     * threads bmi_tcp uses to move data.  Connections are spread over the
+     * threads, each of which polls its own set of sockets.  The default,
+     * <c>0</c>, does all socket work from the BMI test calls instead.
+     *
+     * <c>tcp_zerocopy</c> or <c>tcp_zerocopy=N</c> makes bmi_tcp send
+     * rendezvous payloads of at least <c>N</c> bytes (default 65536) with
+     * MSG_ZEROCOPY on platforms that support it.
+     *
      * For example:
      *
      * <c>BMIOpts ib_port=2</c>
@@ -1089,6 +1194,14 @@ static const configoption_t options[] =
      */
     {"AttrCacheMaxNumElems",ARG_INT,get_attr_cache_max_num_elems,NULL,
         CTX_STORAGEHINTS,"1024"},
+
+    /* This option bounds the memory, in bytes, that the attribute cache
+     * may hold for cached attributes and keyval data.  Whichever of this
+     * and AttrCacheMaxNumElems is reached first causes entries to be
+     * evicted.  A value of 0 disables the limit.
+     */
+    {"AttrCacheMaxBytes",ARG_INT,get_attr_cache_max_bytes,NULL,
+        CTX_STORAGEHINTS,"16777216"},
     
     /* The TroveSyncMeta option allows users to turn off metadata
      * synchronization with every metadata write.  This can greatly improve
@@ -1160,6 +1273,23 @@ static const configoption_t options[] =
     {"CoalescingLowWatermark", ARG_INT, get_coalescing_low_watermark, NULL,
         CTX_STORAGEHINTS, "1"},
 
+    /* This option specifies how many queued metadata updates (creates,
+     * removes, setattrs and keyval writes) may be applied to the
+     * database in one transaction and completed together after a single
+     * sync.  A value of 1 applies each update on its own.
+     */
+    {"GroupCommitMaxOps", ARG_INT, get_group_commit_max_ops, NULL,
+        CTX_STORAGEHINTS, "64"},
+
+    /* This option specifies the longest time, in microseconds, that a
+     * group of metadata updates is held open waiting for more.  The
+     * server only waits when updates have recently been arriving faster
+     * than this, and waits less the faster they arrive.  A value of 0
+     * only groups updates that are already queued.
+     */
+    {"GroupCommitWindow", ARG_INT, get_group_commit_window, NULL,
+        CTX_STORAGEHINTS, "500"},
+
     /* This option specifies the method used for trove.  The method specifies
      * how both metadata and data are stored and managed by the OrangeFS servers.
      * Currently the
@@ -1173,6 +1303,11 @@ static const configoption_t options[] =
      * for large I/O accesses.  For local storage, including RAID setups,
      * the alt-aio method is recommended.
      *
+     * <c>io-uring</c>  This uses the Linux io_uring interface to submit
+     * datafile I/O in batches from a single ring shared by the server,
+     * avoiding the per-request thread handoffs of alt-aio.  It requires a
+     * kernel with io_uring support (5.5 or later).
+     *
      * <c>null-aio</c>  This method is an implementation 
      * that does no disk I/O at all
      * and is only useful for development or debugging purposes.  It can
@@ -1239,6 +1374,19 @@ static const configoption_t options[] =
     {"DistrDirSplitSize", ARG_INT, distr_dir_split_size, NULL,
         CTX_FILESYSTEM, "10000"},
 
+    /* Specifies the function that maps entry names to servers in newly
+     * created directories: "md5" or "murmur3". A directory keeps the hash
+     * it was created with, so existing directories are not affected. */
+    {"DistrDirHash", ARG_STR, distr_dir_hash, NULL,
+        CTX_FILESYSTEM, "murmur3"},
+
+    /* Specifies the create rate, in entries per second, above which a
+     * server starts splitting a directory bucket once it holds a quarter
+     * of DistrDirSplitSize entries rather than all of them. 0 disables
+     * early splits. */
+    {"DistrDirPresplitRate", ARG_INT, distr_dir_presplit_rate, NULL,
+        CTX_FILESYSTEM, "1000"},
+
     LAST_OPTION
 };
 
@@ -1294,6 +1442,14 @@ int PINT_parse_config(struct server_configuration_s *config_obj,
     config_s->client_retry_limit = PVFS2_CLIENT_RETRY_LIMIT_DEFAULT;
     config_s->client_retry_delay_ms = PVFS2_CLIENT_RETRY_DELAY_MS_DEFAULT;
     config_s->trove_max_concurrent_io = 16;
+    config_s->trove_alt_aio_threads = 16;
+    config_s->trove_io_uring_queue_depth = 256;
+    config_s->state_machine_threads = 0;
+    config_s->qos_metadata_rate = 0;
+    config_s->qos_metadata_burst = 0;
+    config_s->qos_io_rate = 0;
+    config_s->qos_io_burst = 0;
+    config_s->attr_lease_max_msecs = 0;
     config_s->db_max_size = 536870912;
 
     if (cache_config_files(config_s, global_config_filename))
@@ -2811,6 +2967,24 @@ DOTCONF_CB(get_attr_cache_max_num_elems)
     return NULL;
 }
 
+DOTCONF_CB(get_attr_cache_max_bytes)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if (cmd->data.value < 0)
+    {
+        return "AttrCacheMaxBytes must not be negative.\n";
+    }
+    fs_conf->attr_cache_max_bytes = (int)cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_file_stuffing)
 {
     struct filesystem_configuration_s *fs_conf = NULL;
@@ -2914,6 +3088,299 @@ DOTCONF_CB(get_trove_max_concurrent_io)
     return NULL;
 }
 
+DOTCONF_CB(get_trove_alt_aio_threads)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 1)
+    {
+        return "TroveAltAIOThreads must be at least 1.\n";
+    }
+    config_s->trove_alt_aio_threads = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_io_uring_queue_depth)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 1)
+    {
+        return "IOUringQueueDepth must be at least 1.\n";
+    }
+    config_s->trove_io_uring_queue_depth = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_state_machine_threads)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "StateMachineThreads must not be negative.\n";
+    }
+    config_s->state_machine_threads = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_qos_metadata_rate)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "QoSMetadataRate must not be negative.\n";
+    }
+    config_s->qos_metadata_rate = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_qos_metadata_burst)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "QoSMetadataBurst must not be negative.\n";
+    }
+    config_s->qos_metadata_burst = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_qos_io_rate)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "QoSIORate must not be negative.\n";
+    }
+    config_s->qos_io_rate = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_qos_io_burst)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "QoSIOBurst must not be negative.\n";
+    }
+    config_s->qos_io_burst = cmd->data.value;
+    return NULL;
+}
+
+/* splits a name=weight pair in place, returning the weight or -1 */
+static int split_qos_weight(char *pair)
+{
+    char *sep = strrchr(pair, '=');
+    char *end = NULL;
+    long weight;
+
+    if (!sep || sep == pair)
+    {
+        return -1;
+    }
+    weight = strtol(sep + 1, &end, 10);
+    if (*end != '\0' || end == sep + 1 || weight < 1 || weight > INT_MAX)
+    {
+        return -1;
+    }
+    *sep = '\0';
+    return (int) weight;
+}
+
+static void free_qos_user_weights(struct server_configuration_s *config_s)
+{
+    free(config_s->qos_weight_uids);
+    config_s->qos_weight_uids = NULL;
+    free(config_s->qos_user_weights);
+    config_s->qos_user_weights = NULL;
+    config_s->qos_user_weight_count = 0;
+}
+
+static void free_qos_client_weights(struct server_configuration_s *config_s)
+{
+    if (config_s->qos_weight_hosts)
+    {
+        free_list_of_strings(config_s->qos_client_weight_count,
+                             &config_s->qos_weight_hosts);
+    }
+    free(config_s->qos_weight_netmasks);
+    config_s->qos_weight_netmasks = NULL;
+    free(config_s->qos_client_weights);
+    config_s->qos_client_weights = NULL;
+    config_s->qos_client_weight_count = 0;
+}
+
+DOTCONF_CB(get_qos_user_weights)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+    char *end = NULL;
+    char *pair;
+    long uid;
+    int i;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+
+    /* a later context replaces the list rather than adding to it */
+    free_qos_user_weights(config_s);
+    if (cmd->arg_count == 0)
+    {
+        return NULL;
+    }
+
+    config_s->qos_weight_uids =
+        (PVFS_uid *) calloc(cmd->arg_count, sizeof(PVFS_uid));
+    config_s->qos_user_weights = (int *) calloc(cmd->arg_count, sizeof(int));
+    if (!config_s->qos_weight_uids || !config_s->qos_user_weights)
+    {
+        free_qos_user_weights(config_s);
+        return "Could not allocate memory for QoSUserWeights\n";
+    }
+
+    for (i = 0; i < cmd->arg_count; i++)
+    {
+        pair = cmd->data.list[i];
+        config_s->qos_user_weights[i] = split_qos_weight(pair);
+        if (config_s->qos_user_weights[i] < 0)
+        {
+            free_qos_user_weights(config_s);
+            return "QoSUserWeights entries must be uid=weight, with a "
+                   "weight of at least 1.\n";
+        }
+        uid = strtol(pair, &end, 10);
+        if (*end != '\0' || uid < 0)
+        {
+            free_qos_user_weights(config_s);
+            return "QoSUserWeights entries must be uid=weight, with a "
+                   "weight of at least 1.\n";
+        }
+        config_s->qos_weight_uids[i] = (PVFS_uid) uid;
+    }
+    config_s->qos_user_weight_count = cmd->arg_count;
+    return NULL;
+}
+
+DOTCONF_CB(get_qos_client_weights)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+    int i;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+
+    free_qos_client_weights(config_s);
+    if (cmd->arg_count == 0)
+    {
+        return NULL;
+    }
+
+    config_s->qos_weight_netmasks =
+        (int *) calloc(cmd->arg_count, sizeof(int));
+    config_s->qos_client_weights =
+        (int *) calloc(cmd->arg_count, sizeof(int));
+    if (!config_s->qos_weight_netmasks || !config_s->qos_client_weights ||
+        get_list_of_strings(cmd->arg_count, cmd->data.list,
+                            &config_s->qos_weight_hosts) < 0)
+    {
+        free_qos_client_weights(config_s);
+        return "Could not allocate memory for QoSClientWeights\n";
+    }
+    config_s->qos_client_weight_count = cmd->arg_count;
+
+    for (i = 0; i < cmd->arg_count; i++)
+    {
+        config_s->qos_client_weights[i] =
+            split_qos_weight(config_s->qos_weight_hosts[i]);
+        if (config_s->qos_client_weights[i] < 0)
+        {
+            free_qos_client_weights(config_s);
+            return "QoSClientWeights entries must be address=weight, with "
+                   "a weight of at least 1.\n";
+        }
+    }
+    if (setup_netmasks(config_s->qos_client_weight_count,
+                       config_s->qos_weight_hosts,
+                       config_s->qos_weight_netmasks) < 0)
+    {
+        free_qos_client_weights(config_s);
+        return "Parse error in QoSClientWeights netmask specification\n";
+    }
+    return NULL;
+}
+
+DOTCONF_CB(get_attr_lease_max_msecs)
+{
+    struct server_configuration_s *config_s = 
+                    (struct server_configuration_s *)cmd->context;
+
+    if(config_s->configuration_context == CTX_SERVER_OPTIONS &&
+       config_s->my_server_options == 0)
+    {
+        return NULL;
+    }
+    if(cmd->data.value < 0)
+    {
+        return "AttrLeaseMaxMsecs must not be negative.\n";
+    }
+    config_s->attr_lease_max_msecs = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_db_cache_size_bytes)
 {
     struct server_configuration_s *config_s = 
@@ -3361,6 +3828,40 @@ DOTCONF_CB(get_coalescing_low_watermark)
     return NULL;
 }
 
+DOTCONF_CB(get_group_commit_max_ops)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf = NULL;
+
+    fs_conf = (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(cmd->data.value < 1)
+    {
+        return "GroupCommitMaxOps must be at least 1.\n";
+    }
+    fs_conf->group_commit_max_ops = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_group_commit_window)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf = NULL;
+
+    fs_conf = (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if(cmd->data.value < 0)
+    {
+        return "GroupCommitWindow must not be negative.\n";
+    }
+    fs_conf->group_commit_window = cmd->data.value;
+    return NULL;
+}
+
 DOTCONF_CB(get_trove_method)
 {
     int * method;
@@ -3394,6 +3895,10 @@ DOTCONF_CB(get_trove_method)
     {
         *method = TROVE_METHOD_DBPF_DIRECTIO;
     }
+    else if(!strcmp(cmd->data.str, "io-uring"))
+    {
+        *method = TROVE_METHOD_DBPF_IOURING;
+    }
     else
     {
         return "Error unknown TroveMethod option\n";
@@ -3962,6 +4467,36 @@ DOTCONF_CB(distr_dir_split_size)
     return NULL;
 }
 
+DOTCONF_CB(distr_dir_hash)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    int hash_type;
+
+    hash_type = PINT_dist_dir_hash_from_str(cmd->data.str);
+    if(hash_type < 0)
+    {
+        return("DistrDirHash value must be 'md5' or 'murmur3'.\n");
+    }
+    config_s->distr_dir_hash = hash_type;
+
+    return NULL;
+}
+
+DOTCONF_CB(distr_dir_presplit_rate)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    if(cmd->data.value < 0)
+    {
+        return("DistrDirPresplitRate cannot be negative.\n");
+    }
+    config_s->distr_dir_presplit_rate = cmd->data.value;
+
+    return NULL;
+}
+
 
 /*
  * Function: PINT_config_release
@@ -4044,6 +4579,9 @@ void PINT_config_release(struct server_configuration_s *config_s)
             config_s->bmi_modules = NULL;
         }
 
+        free_qos_user_weights(config_s);
+        free_qos_client_weights(config_s);
+
         if (config_s->flow_modules)
         {
             free(config_s->flow_modules);
@@ -4477,6 +5015,7 @@ static void copy_filesystem(struct filesystem_configuration_s *dest_fs,
         dest_fs->attr_cache_size = src_fs->attr_cache_size;
         dest_fs->attr_cache_max_num_elems =
             src_fs->attr_cache_max_num_elems;
+        dest_fs->attr_cache_max_bytes = src_fs->attr_cache_max_bytes;
         dest_fs->trove_sync_meta = src_fs->trove_sync_meta;
         dest_fs->trove_sync_data = src_fs->trove_sync_data;
  
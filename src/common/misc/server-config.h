@@ -86,11 +86,14 @@ typedef struct filesystem_configuration_s
     char *attr_cache_keywords;
     int attr_cache_size;
     int attr_cache_max_num_elems;
+    int attr_cache_max_bytes;
     int trove_sync_meta;
     int trove_sync_data;
     int immediate_completion;
     int coalescing_high_watermark;
     int coalescing_low_watermark;
+    int group_commit_max_ops;
+    int group_commit_window;
     int file_stuffing;
 
     char *secret_key;
@@ -218,6 +221,23 @@ typedef struct server_configuration_s
     int trove_max_concurrent_io;    /* allow the number of aio operations to
                                      * be configurable.
                                      */
+    int trove_alt_aio_threads;      /* size of the alt-aio worker pool */
+    int trove_io_uring_queue_depth; /* entries in the io-uring ring */
+    int state_machine_threads;      /* state machine worker threads; 0
+                                     * runs them on the main thread
+                                     */
+    int qos_metadata_rate;          /* request scheduler token buckets, */
+    int qos_metadata_burst;         /* in requests per second and      */
+    int qos_io_rate;                /* requests; a rate of 0 means no  */
+    int qos_io_burst;               /* limit                           */
+    int qos_user_weight_count;      /* QoSUserWeights uid=weight pairs */
+    PVFS_uid *qos_weight_uids;
+    int *qos_user_weights;
+    int qos_client_weight_count;    /* QoSClientWeights address=weight */
+    char **qos_weight_hosts;        /* pairs, matched like RootSquash  */
+    int *qos_weight_netmasks;
+    int *qos_client_weights;
+    int attr_lease_max_msecs;       /* longest attribute lease granted */
     int trove_method;
 	
     char *keystore_path;             /* location of trusted server public keys */
@@ -261,6 +281,8 @@ typedef struct server_configuration_s
     int32_t distr_dir_servers_initial;
     int32_t distr_dir_servers_max;
     int32_t distr_dir_split_size;
+    int32_t distr_dir_hash;          /* hash for new directories */
+    int32_t distr_dir_presplit_rate; /* creates/sec that split early */
 } server_configuration_s;
 
 int PINT_parse_config(
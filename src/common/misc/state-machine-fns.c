@@ -30,6 +30,10 @@ static void PINT_push_state(struct PINT_smcb *, struct PINT_state_s *);
 static struct PINT_state_s *PINT_sm_task_map(struct PINT_smcb *smcb, int task_id);
 static void PINT_sm_start_child_frames(struct PINT_smcb *smcb, int* children_started);
 
+/* optional callbacks run around PINT_state_machine_start() */
+static void (*sm_start_claim)(struct PINT_smcb *) = NULL;
+static void (*sm_start_release)(struct PINT_smcb *) = NULL;
+
 /* Function: PINT_state_machine_halt(void)
    Params: None
    Returns: True
@@ -87,7 +91,9 @@ int PINT_state_machine_terminate(struct PINT_smcb *smcb, job_status_s *r)
                      "[SM Terminating Child]: children_running:%d\n",
                      smcb->parent_smcb->children_running);
 
-        if (--smcb->parent_smcb->children_running <= 0)
+        /* children of one parent may terminate on different threads */
+        if (__sync_sub_and_fetch(&smcb->parent_smcb->children_running,
+                                 1) <= 0)
         {
             /* no more child state machines running, so we can
              * start up the parent state machine again
@@ -209,6 +215,11 @@ PINT_sm_action PINT_state_machine_start(struct PINT_smcb *smcb, job_status_s *r)
 {
     PINT_sm_action ret;
 
+    if (sm_start_claim)
+    {
+        sm_start_claim(smcb);
+    }
+
     /* set the state machine to being completed immediately.  We
      * unset this bit once the state machine is deferred.
      */
@@ -231,9 +242,34 @@ PINT_sm_action PINT_state_machine_start(struct PINT_smcb *smcb, job_status_s *r)
         smcb->immediate = 0;
     }
 
+    /* smcb may have been freed if the machine terminated; the release
+     * hook only uses it as a key
+     */
+    if (sm_start_release)
+    {
+        sm_start_release(smcb);
+    }
+
     return ret;
 }
 
+/* Function: PINT_state_machine_set_start_hooks()
+   Params: claim and release callbacks, or NULLs to remove them
+   Returns: nothing
+   Synopsis: Registers functions called on entry to and on exit from
+        PINT_state_machine_start().  A caller that continues state
+        machines from several threads uses them to hold back completions
+        of jobs posted by a machine's first actions until the thread
+        starting it is done with the smcb.
+ */
+void PINT_state_machine_set_start_hooks(
+    void (*claim)(struct PINT_smcb *),
+    void (*release)(struct PINT_smcb *))
+{
+    sm_start_claim = claim;
+    sm_start_release = release;
+}
+
 /* Function: PINT_state_machine_next()
    Params: smcb pointer and job status pointer
    Returns: return value of last state action
@@ -205,6 +205,9 @@ PINT_sm_action PINT_state_machine_invoke(struct PINT_smcb *, job_status_s *);
 PINT_sm_action PINT_state_machine_start(struct PINT_smcb *, job_status_s *);
 PINT_sm_action PINT_state_machine_continue(
     struct PINT_smcb *smcb, job_status_s *r);
+void PINT_state_machine_set_start_hooks(
+    void (*claim)(struct PINT_smcb *),
+    void (*release)(struct PINT_smcb *));
 #ifdef WIN32
 int PINT_state_machine_locate(struct PINT_smcb *);
 #else
@@ -174,6 +174,16 @@ struct bmi_method_ops
     int (*cancel)(bmi_op_id_t, bmi_context_id);
     const char* (*rev_lookup_unexpected)(bmi_method_addr_p);
     int (*query_addr_range)(bmi_method_addr_p, const char *, int);
+    /* optional; see BMI_post_send_file() */
+    int (*post_send_file) (bmi_op_id_t *,
+                           bmi_method_addr_p,
+                           int,
+                           bmi_size_t,
+                           bmi_size_t,
+                           bmi_msg_tag_t,
+                           void *,
+                           bmi_context_id,
+                           PVFS_hint hints);
 };
 
 
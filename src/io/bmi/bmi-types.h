@@ -94,6 +94,10 @@ enum
     BMI_OPTIMISTIC_BUFFER_REG = 14,
     BMI_TCP_CHECK_UNEXPECTED = 15,
     BMI_TRANSPORT_METHODS_STRING = 16,
+    BMI_GET_METH_OPS = 17,     /**< returns an opaque pointer identifying
+                                *   the module that services an address;
+                                *   memory from BMI_memalloc() may be
+                                *   reused between addresses that match */
 };
 
 enum BMI_io_type
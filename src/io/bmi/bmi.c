@@ -793,6 +793,61 @@ int BMI_post_send(bmi_op_id_t * id,
 }
 
 
+/** Submits a send operation whose payload is size bytes of the file
+ *  open on fd, starting at offset, so that methods able to do so can
+ *  hand the data to the network without copying it through user space.
+ *  The descriptor must remain open until the operation completes.
+ *
+ *  \return 0 on success, -PVFS_ENOSYS if the method of dest cannot send
+ *  from a file, -errno on other failures.
+ */
+int BMI_post_send_file(bmi_op_id_t * id,
+                       BMI_addr_t dest,
+                       int fd,
+                       bmi_size_t offset,
+                       bmi_size_t size,
+                       bmi_msg_tag_t tag,
+                       void *user_ptr,
+                       bmi_context_id context_id,
+                       bmi_hint hints)
+{
+    ref_st_p tmp_ref = NULL;
+    int ret = -1;
+
+    gossip_debug(GOSSIP_BMI_DEBUG_OFFSETS,
+                 "BMI_post_send_file: addr: %ld, fd: %d, offset: %lld, "
+                 "size: %ld, tag: %d\n",
+                 (long) dest, fd, lld(offset), (long) size, (int) tag);
+
+    *id = 0;
+
+    gen_mutex_lock(&ref_mutex);
+    tmp_ref = ref_list_search_addr(cur_ref_list, dest);
+    if (!tmp_ref)
+    {
+        gen_mutex_unlock(&ref_mutex);
+        return (bmi_errno_to_pvfs(-EPROTO));
+    }
+    gen_mutex_unlock(&ref_mutex);
+
+    if (!tmp_ref->interface->post_send_file)
+    {
+        return (bmi_errno_to_pvfs(-ENOSYS));
+    }
+
+    ret = tmp_ref->interface->post_send_file(id, 
+                                             tmp_ref->method_addr, 
+                                             fd, 
+                                             offset, 
+                                             size, 
+                                             tag,
+                                             user_ptr, 
+                                             context_id, 
+                                             (PVFS_hint) hints);
+    return (ret);
+}
+
+
 /** Submits unexpected send operations for subsequent service.
  *
  *  \return 0 on success, -errno on failure.
@@ -1651,6 +1706,18 @@ int BMI_get_info(BMI_addr_t addr,
             *((void**) inout_parameter) = tmp_ref->method_addr;
             break;
 
+        case BMI_GET_METH_OPS:
+            gen_mutex_lock(&ref_mutex);
+            tmp_ref = ref_list_search_addr(cur_ref_list, addr);
+            if  (!tmp_ref)
+            {
+                gen_mutex_unlock(&ref_mutex);
+                return (bmi_errno_to_pvfs(-EINVAL));
+            }
+            gen_mutex_unlock(&ref_mutex);
+            *((void**) inout_parameter) = tmp_ref->interface;
+            break;
+
         case BMI_GET_UNEXP_SIZE:
             gen_mutex_lock(&ref_mutex);
             tmp_ref = ref_list_search_addr(cur_ref_list, addr);
@@ -49,6 +49,9 @@ struct tcp_allowed_connection_s {
 
 /* this contains TCP/IP addressing information- it is filled in as
  * connections are made */
+/* size of encoded message header */
+#define TCP_ENC_HDR_SIZE 24
+
 struct tcp_addr
 {
     bmi_method_addr_p map;		/* points back to generic address */
@@ -77,6 +80,20 @@ struct tcp_addr
     int dont_reconnect;
     char* peer;
     int peer_type;
+    /* index of the bmi_tcp shard that services this address */
+    int shard;
+    /* set once the address has been dropped while its shard was being
+     * polled; it is released by the polling thread
+     */
+    int dead;
+    struct qlist_head dead_link;
+    /* the part of the next message header that has arrived so far */
+    char hdr_buf[TCP_ENC_HDR_SIZE];
+    int hdr_len;
+    /* set if the socket accepts MSG_ZEROCOPY sends */
+    int zc_enabled;
+    /* sequence number the kernel will give the next zero copy send */
+    uint32_t zc_next;
 };
 
 
@@ -12,6 +12,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/poll.h>
@@ -51,10 +52,14 @@
 #include "gen-locks.h"
 #include "pint-hint.h"
 #include "pint-event.h"
+#ifdef __PVFS2_SERVER__
+#include "pint-perf-counter.h"
+#endif
 
+/* protects the completion queues and context setup; see struct
+ * tcp_shard for everything else
+ */
 static gen_mutex_t interface_mutex = GEN_MUTEX_INITIALIZER;
-static gen_cond_t interface_cond = GEN_COND_INITIALIZER;
-static int sc_test_busy = 0;
 
 /* function prototypes */
 int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
@@ -89,6 +94,18 @@ int BMI_tcp_post_send(bmi_op_id_t *id,
 		      bmi_context_id context_id,
                       PVFS_hint hints);
 
+#ifdef __USE_SENDFILE__
+int BMI_tcp_post_send_file(bmi_op_id_t *id,
+                           bmi_method_addr_p dest,
+                           int fd,
+                           bmi_size_t offset,
+                           bmi_size_t size,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints);
+#endif
+
 int BMI_tcp_post_sendunexpected(bmi_op_id_t *id,
 				bmi_method_addr_p dest,
 				const void *buffer,
@@ -196,9 +213,6 @@ int BMI_tcp_cancel(bmi_op_id_t id,
 
 char BMI_tcp_method_name[] = "bmi_tcp";
 
-/* size of encoded message header */
-#define TCP_ENC_HDR_SIZE 24
-
 /* structure internal to tcp for use as a message header */
 struct tcp_msg_header
 {
@@ -243,7 +257,9 @@ enum bmi_tcp_state
 {
     BMI_TCP_INPROGRESS,
     BMI_TCP_BUFFERING,
-    BMI_TCP_COMPLETE
+    BMI_TCP_COMPLETE,
+    /* fully sent, but the kernel may still be reading the buffers */
+    BMI_TCP_ZC_WAIT
 };
 
 /* tcp private portion of operation structure */
@@ -258,13 +274,34 @@ struct tcp_op
      */
     void *buffer_list_stub;
     bmi_size_t size_list_stub;
+    /* sends posted with BMI_tcp_post_send_file() take their payload from
+     * file_fd starting at file_offset rather than from the buffer list
+     */
+    int send_file;
+    int file_fd;
+    bmi_size_t file_offset;
+    /* MSG_ZEROCOPY sends made for this operation carry the sequence
+     * numbers zc_first onwards; it may complete once all zc_count of
+     * them have been acknowledged
+     */
+    uint32_t zc_first;
+    uint32_t zc_count;
+    uint32_t zc_acked;
 };
 
-/* static io vector for use with readv and writev; we can only use
- * this because BMI serializes module calls
- */
+/* size of the io vector used with readv and writev */
 #define BMI_TCP_IOV_COUNT 10
-static struct iovec stat_io_vector[BMI_TCP_IOV_COUNT + 1];
+
+/* limits on how many queued small sends to one address are combined
+ * into a single writev
+ */
+#define TCP_BATCH_MAX_MSGS 32
+#define TCP_BATCH_IOV_COUNT 64
+
+/* rendezvous payloads of at least this many bytes are sent with
+ * MSG_ZEROCOPY when the tcp_zerocopy BMI option is given
+ */
+#define TCP_ZEROCOPY_MIN_DEFAULT (64*1024)
 
 /* internal utility functions */
 static int tcp_server_init(void);
@@ -295,7 +332,24 @@ static int tcp_cleanse_addr(bmi_method_addr_p map,
 
 static int tcp_shutdown_addr(bmi_method_addr_p map);
 
-static int tcp_do_work(int max_idle_time);
+struct tcp_shard;
+static int tcp_do_work(struct tcp_shard *shard,
+                       int max_idle_time);
+
+static int tcp_wait_for_work(int max_idle_time);
+
+static void tcp_op_complete(method_op_p op);
+
+static void tcp_op_complete_unexp(method_op_p op);
+
+static int tcp_parse_progress_threads(const char *options);
+static bmi_size_t tcp_parse_zerocopy(const char *options);
+
+#ifdef __GEN_POSIX_LOCKING__
+static void *tcp_progress_thread(void *arg);
+#endif
+
+static void tcp_stop_progress_threads(void);
 
 static int tcp_do_work_error(bmi_method_addr_p map);
 
@@ -308,6 +362,9 @@ static int tcp_do_work_send(bmi_method_addr_p map,
 static int work_on_recv_op(method_op_p my_method_op,
 			   int *stall_flag);
 
+static int work_on_send_batch(method_op_p first_op,
+			      int *blocked_flag,
+                              int *stall_flag);
 static int work_on_send_op(method_op_p my_method_op,
                            int *blocked_flag,
                            int *stall_flag);
@@ -330,7 +387,9 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                                  struct tcp_msg_header my_header,
                                  void *user_ptr,
                                  bmi_context_id context_id,
-                                 PVFS_hint hints);
+                                 PVFS_hint hints,
+                                 int file_fd,
+                                 bmi_size_t file_offset);
 
 static int tcp_post_recv_generic(bmi_op_id_t *id,
                                  bmi_method_addr_p src,
@@ -354,7 +413,17 @@ static int payload_progress(int s,
                             bmi_size_t *current_index_complete,
                             enum bmi_op_type send_recv,
                             char *enc_hdr,
-                            bmi_size_t *env_amt_complete);
+                            bmi_size_t *env_amt_complete,
+                            int *zc_flag);
+#ifdef __USE_SENDFILE__
+static int file_payload_progress(int s,
+                                 int fd,
+                                 bmi_size_t offset,
+                                 bmi_size_t total_size,
+                                 bmi_size_t amt_complete,
+                                 char *enc_hdr,
+                                 bmi_size_t *env_amt_complete);
+#endif
 
 #if defined(USE_TRUSTED) && defined(__PVFS2_CLIENT__)
 static int tcp_enable_trusted(struct tcp_addr *tcp_addr_data);
@@ -365,6 +434,16 @@ static int tcp_allow_trusted(struct sockaddr_in *peer_sockaddr);
 
 static void bmi_set_sock_buffers(int socket);
 
+static void tcp_attach_file(bmi_op_id_t id,
+                            int file_fd,
+                            bmi_size_t file_offset);
+static void tcp_enable_zerocopy(struct tcp_addr *tcp_addr_data);
+static void tcp_zc_sent(method_op_p op,
+                        uint32_t seq);
+#ifdef __USE_ZEROCOPY__
+static int tcp_zc_reap(bmi_method_addr_p map);
+#endif
+
 /* exported method interface */
 const struct bmi_method_ops bmi_tcp_ops = {
     .method_name = BMI_tcp_method_name,
@@ -391,6 +470,9 @@ const struct bmi_method_ops bmi_tcp_ops = {
     .cancel = BMI_tcp_cancel,
     .rev_lookup_unexpected = BMI_tcp_addr_rev_lookup_unexpected,
     .query_addr_range = BMI_tcp_query_addr_range,
+#ifdef __USE_SENDFILE__
+    .post_send_file = BMI_tcp_post_send_file,
+#endif
 };
 
 /* module parameters */
@@ -408,7 +490,7 @@ static struct tcp_allowed_connection_s *gtcp_allowed_connection = NULL;
 
 static int check_unexpected = 1;
 
-/* op_list_array indices */
+/* indices of the pending operation lists kept by each shard */
 enum
 {
     NUM_INDICES = 5,
@@ -416,17 +498,84 @@ enum
     IND_RECV = 1,
     IND_RECV_INFLIGHT = 2,
     IND_RECV_EAGER_DONE_BUFFERING = 3,
-    IND_COMPLETE_RECV_UNEXP = 4,	/* MAKE SURE THIS COMES LAST */
+    IND_SEND_ZC_WAIT = 4
+};
+
+/* message and system call counts kept by each shard; on the server they
+ * are added to the performance counters once per tcp_do_work() pass
+ */
+enum
+{
+    TCP_STAT_MSGS_SENT = 0,
+    TCP_STAT_SEND_CALLS = 1,
+    TCP_STAT_MSGS_RECV = 2,
+    TCP_STAT_RECV_CALLS = 3,
+    TCP_STAT_COUNT = 4
+};
+
+/* Addresses are spread over one or more shards.  A shard owns the socket
+ * collection its addresses are polled through and the lists of pending
+ * operations on them, all protected by the shard mutex.  When the
+ * tcp_progress_threads=N BMI option is given, N shards are each driven
+ * by a dedicated thread; otherwise there is a single shard which the
+ * test functions drive themselves, as before.
+ *
+ * Lock order is shard mutex first, then interface_mutex.
+ */
+struct tcp_shard
+{
+    gen_mutex_t mutex;
+    gen_cond_t cond;
+    /* set while a thread is polling the socket collection without
+     * holding the shard mutex
+     */
+    int sc_test_busy;
+    socket_collection_p sc;
+    op_list_p op_lists[NUM_INDICES];
+    /* addresses dropped while the collection was being polled; they are
+     * released once the poller is done with its results
+     */
+    struct qlist_head dead_addrs;
+    int64_t stats[TCP_STAT_COUNT];
+#ifdef __GEN_POSIX_LOCKING__
+    pthread_t thread;
+#endif
+    int running;
 };
 
-/* internal operation lists */
-static op_list_p op_list_array[6] = { NULL, NULL, NULL, NULL, NULL, NULL };
+/* upper bound on tcp_progress_threads */
+#define TCP_MAX_PROGRESS_THREADS 64
+
+/* how long a progress thread waits in the socket collection before
+ * checking whether it should exit, in milliseconds
+ */
+#define TCP_PROGRESS_IDLE_MS 100
+
+static struct tcp_shard tcp_shards[TCP_MAX_PROGRESS_THREADS];
+static int tcp_shard_count = 1;
+static int tcp_progress_threads = 0;
+static unsigned int tcp_shard_next = 0;
+
+#define tcp_addr_shard(map) \
+    (&tcp_shards[((struct tcp_addr *)(map)->method_data)->shard])
+
+#ifdef __PVFS2_SERVER__
+#define tcp_stat(shard, stat, n) ((shard)->stats[(stat)] += (n))
+#else
+#define tcp_stat(shard, stat, n) do { } while (0)
+#endif
+
+/* smallest payload sent with MSG_ZEROCOPY; 0 if disabled */
+static bmi_size_t tcp_zerocopy_min = 0;
 
-/* internal completion queues */
+/* internal completion queues, protected by interface_mutex */
 static op_list_p completion_array[BMI_MAX_CONTEXTS] = { NULL };
+static op_list_p unexp_completion_list = NULL;
 
-/* internal socket collection */
-static socket_collection_p tcp_socket_collection_p = NULL;
+/* signalled when an operation completes, so that test calls can sleep
+ * while progress threads do the work
+ */
+static gen_cond_t completion_cond = GEN_COND_INITIALIZER;
 
 /* tunable parameters */
 enum
@@ -501,7 +650,9 @@ int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
     int ret = -1;
     int tmp_errno = bmi_tcp_errno_to_pvfs(-ENOSYS);
     struct tcp_addr *tcp_addr_data = NULL;
+    struct tcp_shard *shard = NULL;
     int i = 0;
+    int j = 0;
 
     gossip_debug(GOSSIP_BMI_DEBUG_TCP, "Initializing TCP/IP module.\n");
 
@@ -520,6 +671,10 @@ int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
     tcp_method_params.connect_test = 1;
     tcp_method_params.method_flags = init_flags;
 
+    tcp_progress_threads = tcp_parse_progress_threads(options);
+    tcp_shard_count = tcp_progress_threads ? tcp_progress_threads : 1;
+    tcp_zerocopy_min = tcp_parse_zerocopy(options);
+
     if (init_flags & BMI_INIT_SERVER)
     {
         /* hang on to our local listening address if needed */
@@ -534,33 +689,48 @@ int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
         }
     }
 
-    /* set up the operation lists */
-    for (i = 0; i < NUM_INDICES; i++)
+    unexp_completion_list = op_list_new();
+    if (!unexp_completion_list)
     {
-        op_list_array[i] = op_list_new();
-        if (!op_list_array[i])
-        {
-            tmp_errno = bmi_tcp_errno_to_pvfs(-ENOMEM);
-            goto initialize_failure;
-        }
+        tmp_errno = bmi_tcp_errno_to_pvfs(-ENOMEM);
+        goto initialize_failure;
     }
 
-    /* set up the socket collection */
-    if (tcp_method_params.method_flags & BMI_INIT_SERVER)
+    /* set up the operation lists and socket collection of each shard */
+    for (i = 0; i < tcp_shard_count; i++)
     {
-        tcp_addr_data = tcp_method_params.listen_addr->method_data;
-        tcp_socket_collection_p = 
-                BMI_socket_collection_init(tcp_addr_data->socket);
-    }
-    else
-    {
-        tcp_socket_collection_p = BMI_socket_collection_init(-1);
-    }
+        shard = &tcp_shards[i];
+        memset(shard, 0, sizeof(*shard));
+        gen_mutex_init(&shard->mutex);
+        gen_cond_init(&shard->cond);
+        INIT_QLIST_HEAD(&shard->dead_addrs);
 
-    if (!tcp_socket_collection_p)
-    {
-        tmp_errno = bmi_tcp_errno_to_pvfs(-ENOMEM);
-        goto initialize_failure;
+        for (j = 0; j < NUM_INDICES; j++)
+        {
+            shard->op_lists[j] = op_list_new();
+            if (!shard->op_lists[j])
+            {
+                tmp_errno = bmi_tcp_errno_to_pvfs(-ENOMEM);
+                goto initialize_failure;
+            }
+        }
+
+        /* only the first shard listens for new connections */
+        if (i == 0 && (tcp_method_params.method_flags & BMI_INIT_SERVER))
+        {
+            tcp_addr_data = tcp_method_params.listen_addr->method_data;
+            shard->sc = BMI_socket_collection_init(tcp_addr_data->socket);
+        }
+        else
+        {
+            shard->sc = BMI_socket_collection_init(-1);
+        }
+
+        if (!shard->sc)
+        {
+            tmp_errno = bmi_tcp_errno_to_pvfs(-ENOMEM);
+            goto initialize_failure;
+        }
     }
 
     bmi_tcp_pid = getpid();
@@ -594,25 +764,59 @@ int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
                             "%d", 
                             &bmi_tcp_recv_event_id);
 
+#ifdef __GEN_POSIX_LOCKING__
+    for (i = 0; i < tcp_progress_threads; i++)
+    {
+        tcp_shards[i].running = 1;
+        ret = pthread_create(&tcp_shards[i].thread, NULL,
+                             tcp_progress_thread, &tcp_shards[i]);
+        if (ret != 0)
+        {
+            tcp_shards[i].running = 0;
+            gossip_err("Error: unable to start bmi_tcp progress thread: "
+                       "%s\n", strerror(ret));
+            tmp_errno = bmi_tcp_errno_to_pvfs(-ret);
+            goto initialize_failure;
+        }
+    }
+#endif
+
     gen_mutex_unlock(&interface_mutex);
     gossip_debug(GOSSIP_BMI_DEBUG_TCP, 
-                 "TCP/IP module successfully initialized.\n");
+                 "TCP/IP module successfully initialized "
+                 "(%d progress threads).\n", tcp_progress_threads);
     return (0);
 
   initialize_failure:
 
+    /* no operations exist yet, so the progress threads cannot be
+     * waiting on interface_mutex
+     */
+    tcp_stop_progress_threads();
+
     /* cleanup data structures and bail out */
-    for (i = 0; i < NUM_INDICES; i++)
+    for (i = 0; i < tcp_shard_count; i++)
     {
-        if (op_list_array[i])
+        for (j = 0; j < NUM_INDICES; j++)
+        {
+            if (tcp_shards[i].op_lists[j])
+            {
+                op_list_cleanup(tcp_shards[i].op_lists[j]);
+                tcp_shards[i].op_lists[j] = NULL;
+            }
+        }
+        if (tcp_shards[i].sc)
         {
-            op_list_cleanup(op_list_array[i]);
+            BMI_socket_collection_finalize(tcp_shards[i].sc);
+            tcp_shards[i].sc = NULL;
         }
     }
-    if (tcp_socket_collection_p)
+    if (unexp_completion_list)
     {
-        BMI_socket_collection_finalize(tcp_socket_collection_p);
+        op_list_cleanup(unexp_completion_list);
+        unexp_completion_list = NULL;
     }
+    tcp_progress_threads = 0;
     gen_mutex_unlock(&interface_mutex);
     return (tmp_errno);
 }
@@ -627,6 +831,12 @@ int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
 int BMI_tcp_finalize(void)
 {
     int i = 0;
+    int j = 0;
+
+    /* the progress threads may need interface_mutex to finish what they
+     * are working on, so stop them before taking it
+     */
+    tcp_stop_progress_threads();
 
     gen_mutex_lock(&interface_mutex);
 
@@ -637,22 +847,34 @@ int BMI_tcp_finalize(void)
         dealloc_tcp_method_addr(tcp_method_params.listen_addr);
     }
 
-    /* note that this forcefully shuts down operations */
-    for (i = 0; i < NUM_INDICES; i++)
+    /* note that this forcefully shuts down operations.  The shard
+     * mutexes are left alone; addresses still refer to them until the
+     * BMI layer drops them.
+     */
+    for (i = 0; i < tcp_shard_count; i++)
     {
-        if (op_list_array[i])
+        for (j = 0; j < NUM_INDICES; j++)
         {
-            op_list_cleanup(op_list_array[i]);
-            op_list_array[i] = NULL;
+            if (tcp_shards[i].op_lists[j])
+            {
+                op_list_cleanup(tcp_shards[i].op_lists[j]);
+                tcp_shards[i].op_lists[j] = NULL;
+            }
         }
-    }
 
-    /* get rid of socket collection */
-    if (tcp_socket_collection_p)
+        /* get rid of socket collection */
+        if (tcp_shards[i].sc)
+        {
+            BMI_socket_collection_finalize(tcp_shards[i].sc);
+            tcp_shards[i].sc = NULL;
+        }
+    }
+    if (unexp_completion_list)
     {
-        BMI_socket_collection_finalize(tcp_socket_collection_p);
-        tcp_socket_collection_p = NULL;
+        op_list_cleanup(unexp_completion_list);
+        unexp_completion_list = NULL;
     }
+    tcp_progress_threads = 0;
 
     /* NOTE: we are trusting the calling BMI layer to deallocate 
      * all of the method addresses (this will close any open sockets)
@@ -999,6 +1221,7 @@ int BMI_tcp_set_info(int option,
 {
     int ret = -1;
     bmi_method_addr_p tmp_addr = NULL;
+    struct tcp_shard *shard = NULL;
 
     gen_mutex_lock(&interface_mutex);
 
@@ -1042,8 +1265,15 @@ int BMI_tcp_set_info(int option,
 	else
 	{
 	    tmp_addr = (bmi_method_addr_p) inout_parameter;
-	    /* take it out of the socket collection */
+	    /* take it out of the socket collection; the shard lock comes
+	     * before interface_mutex
+	     */
+	    shard = tcp_addr_shard(tmp_addr);
+	    gen_mutex_unlock(&interface_mutex);
+	    gen_mutex_lock(&shard->mutex);
 	    tcp_forget_addr(tmp_addr, 1, 0);
+	    gen_mutex_unlock(&shard->mutex);
+	    gen_mutex_lock(&interface_mutex);
 	    ret = 0;
 	}
 	break;
@@ -1270,7 +1500,7 @@ int BMI_tcp_post_send(bmi_op_id_t *id,
     my_header.size = size;
     my_header.magic_nr = BMI_MAGIC_NR;
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(dest)->mutex);
 
     ret = tcp_post_send_generic(id, 
                                 dest, 
@@ -1281,11 +1511,78 @@ int BMI_tcp_post_send(bmi_op_id_t *id,
                                 my_header,
                                 user_ptr, 
                                 context_id, 
-                                hints);
+                                hints,
+                                -1,
+                                0);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(dest)->mutex);
+    return (ret);
+}
+
+
+#ifdef __USE_SENDFILE__
+/* BMI_tcp_post_send_file()
+ * 
+ * Submits a send whose payload is read by the kernel from an open file
+ * with sendfile() instead of being copied from a user buffer.  The
+ * descriptor must stay open until the operation completes.
+ *
+ * returns 0 on success that requires later poll, returns 1 on instant
+ * completion, -errno on failure
+ */
+int BMI_tcp_post_send_file(bmi_op_id_t *id,
+                           bmi_method_addr_p dest,
+                           int fd,
+                           bmi_size_t offset,
+                           bmi_size_t size,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints)
+{
+    struct tcp_msg_header my_header;
+    const void *buffer = NULL;
+    int ret = -1;
+
+    /* clear the id field for safety */
+    *id = 0;
+
+    if (size > TCP_MODE_REND_LIMIT)
+    {
+	return (bmi_tcp_errno_to_pvfs(-EMSGSIZE));
+    }
+
+    if (size <= TCP_MODE_EAGER_LIMIT)
+    {
+	my_header.mode = TCP_MODE_EAGER;
+    }
+    else
+    {
+	my_header.mode = TCP_MODE_REND;
+    }
+    my_header.tag = tag;
+    my_header.size = size;
+    my_header.magic_nr = BMI_MAGIC_NR;
+
+    gen_mutex_lock(&tcp_addr_shard(dest)->mutex);
+
+    ret = tcp_post_send_generic(id, 
+                                dest, 
+                                &buffer,
+                                &size, 
+                                1, 
+                                BMI_EXT_ALLOC, 
+                                my_header,
+                                user_ptr, 
+                                context_id, 
+                                hints,
+                                fd,
+                                offset);
+
+    gen_mutex_unlock(&tcp_addr_shard(dest)->mutex);
     return (ret);
 }
+#endif
 
 
 /* BMI_tcp_post_sendunexpected()
@@ -1321,7 +1618,7 @@ int BMI_tcp_post_sendunexpected(bmi_op_id_t *id,
     my_header.size = size;
     my_header.magic_nr = BMI_MAGIC_NR;
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(dest)->mutex);
 
     ret = tcp_post_send_generic(id, 
                                 dest, 
@@ -1332,9 +1629,11 @@ int BMI_tcp_post_sendunexpected(bmi_op_id_t *id,
                                 my_header,
                                 user_ptr, 
                                 context_id, 
-                                hints);
+                                hints,
+                                -1,
+                                0);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(dest)->mutex);
     return (ret);
 }
 
@@ -1375,7 +1674,7 @@ int BMI_tcp_post_recv(bmi_op_id_t *id,
 	return (bmi_tcp_errno_to_pvfs(-EINVAL));
     }
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(src)->mutex);
 
     ret = tcp_post_recv_generic(id, 
                                 src, 
@@ -1390,7 +1689,7 @@ int BMI_tcp_post_recv(bmi_op_id_t *id,
                                 context_id, 
                                 hints);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(src)->mutex);
     return (ret);
 }
 
@@ -1416,12 +1715,16 @@ int BMI_tcp_test(bmi_op_id_t id,
 
     gen_mutex_lock(&interface_mutex);
 
-    /* do some ``real work'' here */
-    ret = tcp_do_work(max_idle_time);
-    if (ret < 0)
+    if (((struct tcp_op*)(query_op->method_data))->tcp_op_state !=
+	    BMI_TCP_COMPLETE)
     {
-	gen_mutex_unlock(&interface_mutex);
-	return (ret);
+        /* do some ``real work'' here */
+        ret = tcp_wait_for_work(max_idle_time);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return (ret);
+        }
     }
 
     if (((struct tcp_op*)(query_op->method_data))->tcp_op_state ==
@@ -1475,7 +1778,7 @@ int BMI_tcp_testsome(int incount,
     gen_mutex_lock(&interface_mutex);
 
     /* do some ``real work'' here */
-    ret = tcp_do_work(max_idle_time);
+    ret = tcp_wait_for_work(max_idle_time);
     if (ret < 0)
     {
         gen_mutex_unlock(&interface_mutex);
@@ -1537,10 +1840,10 @@ int BMI_tcp_testunexpected(int incount,
 
     gen_mutex_lock(&interface_mutex);
 
-    if (op_list_empty(op_list_array[IND_COMPLETE_RECV_UNEXP]))
+    if (op_list_empty(unexp_completion_list))
     {
         /* do some ``real work'' here */
-        ret = tcp_do_work(max_idle_time);
+        ret = tcp_wait_for_work(max_idle_time);
         if (ret < 0)
         {
             gen_mutex_unlock(&interface_mutex);
@@ -1555,7 +1858,7 @@ int BMI_tcp_testunexpected(int incount,
      */
     while ((*outcount < incount) &&
            (query_op = 
-                op_list_shownext(op_list_array[IND_COMPLETE_RECV_UNEXP])))
+                op_list_shownext(unexp_completion_list)))
     {
 	info[*outcount].error_code = query_op->error_code;
 	info[*outcount].addr = query_op->addr;
@@ -1601,14 +1904,14 @@ int BMI_tcp_testcontext(int incount,
          * delay
          */
         if (check_unexpected &&
-                !op_list_empty(op_list_array[IND_COMPLETE_RECV_UNEXP]))
+                !op_list_empty(unexp_completion_list))
         {
             gen_mutex_unlock(&interface_mutex);
             return(0);
         }
 
         /* do some ``real work'' here */
-        ret = tcp_do_work(max_idle_time);
+        ret = tcp_wait_for_work(max_idle_time);
         if (ret < 0)
         {
             gen_mutex_unlock(&interface_mutex);
@@ -1695,7 +1998,7 @@ int BMI_tcp_post_send_list(bmi_op_id_t *id,
     my_header.size = total_size;
     my_header.magic_nr = BMI_MAGIC_NR;
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(dest)->mutex);
 
     ret = tcp_post_send_generic(id, 
                                 dest, 
@@ -1706,9 +2009,11 @@ int BMI_tcp_post_send_list(bmi_op_id_t *id,
                                 my_header, 
                                 user_ptr, 
                                 context_id, 
-                                hints);
+                                hints,
+                                -1,
+                                0);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(dest)->mutex);
     return (ret);
 }
 
@@ -1741,7 +2046,7 @@ int BMI_tcp_post_recv_list(bmi_op_id_t *id,
 	return (bmi_tcp_errno_to_pvfs(-EINVAL));
     }
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(src)->mutex);
 
     ret = tcp_post_recv_generic(id, 
                                 src, 
@@ -1756,7 +2061,7 @@ int BMI_tcp_post_recv_list(bmi_op_id_t *id,
                                 context_id, 
                                 hints);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(src)->mutex);
     return (ret);
 }
 
@@ -1797,7 +2102,7 @@ int BMI_tcp_post_sendunexpected_list(bmi_op_id_t *id,
     my_header.size = total_size;
     my_header.magic_nr = BMI_MAGIC_NR;
 
-    gen_mutex_lock(&interface_mutex);
+    gen_mutex_lock(&tcp_addr_shard(dest)->mutex);
 
     ret = tcp_post_send_generic(id, 
                                 dest, 
@@ -1808,9 +2113,11 @@ int BMI_tcp_post_sendunexpected_list(bmi_op_id_t *id,
                                 my_header, 
                                 user_ptr, 
                                 context_id, 
-                                hints);
+                                hints,
+                                -1,
+                                0);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&tcp_addr_shard(dest)->mutex);
     return (ret);
 }
 
@@ -1866,31 +2173,61 @@ int BMI_tcp_cancel(bmi_op_id_t id,
                    bmi_context_id context_id)
 {
     method_op_p query_op = NULL;
-    
+    bmi_method_addr_p map = NULL;
+    struct tcp_shard *shard = NULL;
+    int i, complete;
+
+    /* a completed operation may be reaped and freed by a test call at
+     * any time under interface_mutex alone, so the operation is only
+     * looked at with interface_mutex held.  Its shard is not known
+     * until then, so every shard is locked first; once the right one is
+     * held, an operation that was not complete stays in progress.
+     */
+    for (i = 0; i < tcp_shard_count; i++)
+    {
+        gen_mutex_lock(&tcp_shards[i].mutex);
+    }
     gen_mutex_lock(&interface_mutex);
 
     query_op = (method_op_p) id_gen_fast_lookup(id);
+    if (query_op)
+    {
+        map = query_op->addr;
+        shard = tcp_addr_shard(map);
+        complete = (((struct tcp_op *) (query_op->method_data))->tcp_op_state
+                    == BMI_TCP_COMPLETE);
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    for (i = 0; i < tcp_shard_count; i++)
+    {
+        if (&tcp_shards[i] != shard)
+        {
+            gen_mutex_unlock(&tcp_shards[i].mutex);
+        }
+    }
+
     if (!query_op)
     {
         /* if we can't find the operattion, then assume that it has already
          * completed naturally
          */
-        gen_mutex_unlock(&interface_mutex);
         return (0);
     }
 
     /* easy case: is the operation already completed? */
-    if (((struct tcp_op *) (query_op->method_data))->tcp_op_state ==
-	    BMI_TCP_COMPLETE)
+    if (complete)
     {
-        /* only close socket in forceful cancel mode */
+        /* only close socket in forceful cancel mode; the operation itself
+         * may already be gone
+         */
         if (forceful_cancel_mode)
         {
-            tcp_forget_addr(query_op->addr, 0, -BMI_ECANCEL);
+            tcp_forget_addr(map, 0, -BMI_ECANCEL);
         }
 
 	/* we are done! status will be collected during test */
-	gen_mutex_unlock(&interface_mutex);
+	gen_mutex_unlock(&shard->mutex);
 	return (0);
     }
 
@@ -1904,7 +2241,7 @@ int BMI_tcp_cancel(bmi_op_id_t id,
 	 */
 	tcp_forget_addr(query_op->addr, 0, -BMI_ECANCEL);
 
-	gen_mutex_unlock(&interface_mutex);
+	gen_mutex_unlock(&shard->mutex);
 	return (0);
     }
 
@@ -1916,11 +2253,9 @@ int BMI_tcp_cancel(bmi_op_id_t id,
     query_op->error_code = -BMI_ECANCEL;
     if (query_op->send_recv == BMI_SEND)
     {
-	BMI_socket_collection_remove_write_bit(tcp_socket_collection_p,
-					       query_op->addr);
+	BMI_socket_collection_remove_write_bit(shard->sc, query_op->addr);
     }
     op_list_remove(query_op);
-    ((struct tcp_op *)(query_op->method_data))->tcp_op_state = BMI_TCP_COMPLETE;
 
     /* only close socket in forceful cancel mode */
     if (forceful_cancel_mode)
@@ -1928,9 +2263,9 @@ int BMI_tcp_cancel(bmi_op_id_t id,
 	tcp_forget_addr(query_op->addr, 0, -BMI_ECANCEL);
     }
 
-    op_list_add(completion_array[query_op->context_id], query_op);
+    tcp_op_complete(query_op);
 
-    gen_mutex_unlock(&interface_mutex);
+    gen_mutex_unlock(&shard->mutex);
     return (0);
 }
 
@@ -2234,6 +2569,8 @@ const char *BMI_tcp_addr_rev_lookup_unexpected(bmi_method_addr_p map)
  * the check for a valid socket.  Other causes of invalid sockets might
  * be masked.
  *
+ * Must be called with the shard mutex of the address held.
+ *
  * no return value
  */
 void tcp_forget_addr(bmi_method_addr_p map,
@@ -2244,20 +2581,21 @@ void tcp_forget_addr(bmi_method_addr_p map,
      * guaranteed by the caller
      */
     struct tcp_addr *tcp_addr_data = map->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(map);
     BMI_addr_t bmi_addr = tcp_addr_data->bmi_addr;
     int tmp_outcount;
     bmi_method_addr_p tmp_addr;
     int tmp_status;
 
-    if (tcp_socket_collection_p && tcp_addr_data->socket >= 0)
+    if (shard->sc && tcp_addr_data->socket >= 0)
     {
-	BMI_socket_collection_remove(tcp_socket_collection_p, map);
+	BMI_socket_collection_remove(shard->sc, map);
 	/* perform a test to force the socket collection to act on the remove
 	 * request before continuing
 	 */
-        if (!sc_test_busy)
+        if (!shard->sc_test_busy)
         {
-            BMI_socket_collection_testglobal(tcp_socket_collection_p,
+            BMI_socket_collection_testglobal(shard->sc,
                                              0, 
                                              &tmp_outcount, 
                                              &tmp_addr, 
@@ -2272,7 +2610,18 @@ void tcp_forget_addr(bmi_method_addr_p map,
     
     if (dealloc_flag)
     {
-	dealloc_tcp_method_addr(map);
+        if (shard->sc_test_busy)
+        {
+            /* the thread polling this shard may already have the address
+             * in its results; it will release it when done with them
+             */
+            tcp_addr_data->dead = 1;
+            qlist_add_tail(&tcp_addr_data->dead_link, &shard->dead_addrs);
+        }
+        else
+        {
+            dealloc_tcp_method_addr(map);
+        }
     }
     else
     {
@@ -2362,6 +2711,9 @@ bmi_method_addr_p alloc_tcp_method_addr(void)
     tcp_addr_data->port = -1;
     tcp_addr_data->map = my_method_addr;
     tcp_addr_data->sc_index = -1;
+    /* spread connections over the shards round robin */
+    tcp_addr_data->shard =
+        __sync_fetch_and_add(&tcp_shard_next, 1) % tcp_shard_count;
 
     return (my_method_addr);
 }
@@ -2456,7 +2808,8 @@ static method_op_p find_recv_inflight(bmi_method_addr_p map)
     key.method_addr = map;
     key.method_addr_yes = 1;
 
-    query_op = op_list_search(op_list_array[IND_RECV_INFLIGHT], &key);
+    query_op = op_list_search(tcp_addr_shard(map)->op_lists[IND_RECV_INFLIGHT],
+                              &key);
 
     return (query_op);
 }
@@ -2573,6 +2926,7 @@ static int tcp_sock_init(bmi_method_addr_p my_method_addr)
     }
 
     bmi_set_sock_buffers(tcp_addr_data->socket);
+    tcp_enable_zerocopy(tcp_addr_data);
 
     if (tcp_addr_data->hostname)
     {
@@ -2729,8 +3083,7 @@ static int enqueue_operation(op_list_p target_list,
 		         "Warning: BMI communication attempted on an "
 		         "address in failure mode.\n");
 	    new_method_op->error_code = tcp_addr_data->addr_error;
-	    op_list_add(op_list_array[new_method_op->context_id],
-			new_method_op);
+	    op_list_add(target_list, new_method_op);
 	    return (tcp_addr_data->addr_error);
 	}
     }
@@ -2743,17 +3096,16 @@ static int enqueue_operation(op_list_p target_list,
                    "address in failure mode.\n");
 
         new_method_op->error_code = tcp_addr_data->addr_error;
-        op_list_add(op_list_array[new_method_op->context_id],
-                    new_method_op);
+        op_list_add(target_list, new_method_op);
         return(tcp_addr_data->addr_error);
     }
 #endif
 
     /* add the socket to poll on */
-    BMI_socket_collection_add(tcp_socket_collection_p, map);
-    if (send_recv == BMI_SEND)
+    BMI_socket_collection_add(tcp_addr_shard(map)->sc, map);
+    if (send_recv == BMI_SEND && tcp_op_state != BMI_TCP_ZC_WAIT)
     {
-        BMI_socket_collection_add_write_bit(tcp_socket_collection_p, map);
+        BMI_socket_collection_add_write_bit(tcp_addr_shard(map)->sc, map);
     }
 
     /* keep up with the operation */
@@ -2786,6 +3138,7 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
 {
     method_op_p query_op = NULL;
     int ret = -1;
+    struct tcp_shard *shard = tcp_addr_shard(src);
     struct tcp_addr *tcp_addr_data = NULL;
     struct tcp_op *tcp_op_data = NULL;
     struct tcp_msg_header bogus_header;
@@ -2828,7 +3181,7 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
     key.msg_tag = tag;
     key.msg_tag_yes = 1;
 
-    query_op = op_list_search(op_list_array[IND_RECV_EAGER_DONE_BUFFERING], 
+    query_op = op_list_search(shard->op_lists[IND_RECV_EAGER_DONE_BUFFERING],
                               &key);
     if (query_op)
     {
@@ -2876,7 +3229,7 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
     }
 
     /* look for a message that is already being received */
-    query_op = op_list_search(op_list_array[IND_RECV_INFLIGHT], &key);
+    query_op = op_list_search(shard->op_lists[IND_RECV_INFLIGHT], &key);
     if (query_op)
     {
         tcp_op_data = query_op->method_data;
@@ -2970,7 +3323,9 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
                                    &(query_op->cur_index_complete),
                                    BMI_RECV,
                                    NULL,
-                                   0);
+                                   0,
+                                   NULL);
+            tcp_stat(shard, TCP_STAT_RECV_CALLS, 1);
             if (ret < 0)
             {
                 PVFS_perror_gossip("Error: payload_progress", ret);
@@ -3024,7 +3379,7 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
         bogus_header.mode = TCP_MODE_REND;
     }
     bogus_header.tag = tag;
-    ret = enqueue_operation(op_list_array[IND_RECV],
+    ret = enqueue_operation(shard->op_lists[IND_RECV],
                             BMI_RECV, 
                             src, 
                             buffer_list, 
@@ -3056,7 +3411,7 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
          * function since we appear to be backlogged.  Make sure that
          * we do not wait in the poll, however.
          */
-        ret = tcp_do_work(0);
+        ret = tcp_do_work(shard, 0);
     }
 #endif
 
@@ -3078,6 +3433,7 @@ static int tcp_cleanse_addr(bmi_method_addr_p map,
                             int error_code)
 {
     int i = 0;
+    struct tcp_shard *shard = tcp_addr_shard(map);
     struct op_list_search_key key;
     method_op_p query_op = NULL;
 
@@ -3085,12 +3441,11 @@ static int tcp_cleanse_addr(bmi_method_addr_p map,
     key.method_addr = map;
     key.method_addr_yes = 1;
 
-    /* NOTE: we know the unexpected completed queue is the last index! */
-    for (i = 0; i < (NUM_INDICES - 1); i++)
+    for (i = 0; i < NUM_INDICES; i++)
     {
-	if (op_list_array[i])
+	if (shard->op_lists[i])
 	{
-	    while ((query_op = op_list_search(op_list_array[i], &key)))
+	    while ((query_op = op_list_search(shard->op_lists[i], &key)))
 	    {
 		op_list_remove(query_op);
 		query_op->error_code = error_code;
@@ -3098,15 +3453,11 @@ static int tcp_cleanse_addr(bmi_method_addr_p map,
 		if (query_op->mode == TCP_MODE_UNEXP 
                         && query_op->send_recv == BMI_RECV)
 		{
-		    op_list_add(op_list_array[IND_COMPLETE_RECV_UNEXP],
-				query_op);
+		    tcp_op_complete_unexp(query_op);
 		}
 		else
 		{
-		    ((struct tcp_op *)(query_op->method_data))->tcp_op_state = 
-			    BMI_TCP_COMPLETE;
-		    op_list_add(completion_array[query_op->context_id], 
-                                query_op);
+		    tcp_op_complete(query_op);
 		}
 	    }
 	}
@@ -3132,82 +3483,396 @@ static int tcp_shutdown_addr(bmi_method_addr_p map)
     }
     tcp_addr_data->socket = -1;
     tcp_addr_data->not_connected = 1;
+    tcp_addr_data->hdr_len = 0;
+    tcp_addr_data->zc_enabled = 0;
 
     return (0);
 }
 
 
-/* tcp_do_work()
+/* tcp_deadline()
  *
- * this is the function that actually does communication work during
- * BMI_tcp_testXXX and BMI_tcp_waitXXX functions.  The amount of work 
- * that it does is tunable.
+ * fills in the absolute time max_idle_time milliseconds from now, for
+ * use with gen_cond_timedwait()
  *
- * returns 0 on success, -errno on failure.
+ * no return value
  */
-static int tcp_do_work(int max_idle_time)
+static void tcp_deadline(struct timespec *wait_time,
+                         int max_idle_time)
 {
-    int ret = -1;
-    bmi_method_addr_p addr_array[TCP_WORK_METRIC];
-    int status_array[TCP_WORK_METRIC];
-    int socket_count = 0;
-    int i = 0;
-    int stall_flag = 0;
-    int busy_flag = 1;
-    struct timespec req;
-    struct tcp_addr *tcp_addr_data = NULL;
-    struct timespec wait_time;
     struct timeval start;
 
-    if (sc_test_busy)
+    gettimeofday(&start, NULL);
+    wait_time->tv_sec = start.tv_sec + max_idle_time / 1000;
+    wait_time->tv_nsec = (start.tv_usec + 
+                         ((max_idle_time % 1000) * 1000)) * 1000;
+    if (wait_time->tv_nsec >= 1000000000)
     {
-        /* another thread is already polling or working on sockets */
-        if (max_idle_time == 0)
-        {
-            /* we don't want to spend time waiting on it; return
-             * immediately.
-             */
-            return (0);
-        }
-
-        /* Sleep until working thread signals that it has finished
-         * its work and then return.  No need for this thread to poll;
-         * the other thread may have already finished what we wanted.
-         * This condition wait is used strictly as a best effort to
-         * prevent busy spin.  We'll sort out the results later.
-         */
-        gettimeofday(&start, NULL);
-        wait_time.tv_sec = start.tv_sec + max_idle_time / 1000;
-        wait_time.tv_nsec = (start.tv_usec + 
-                            ((max_idle_time % 1000) * 1000)) * 1000;
-        if (wait_time.tv_nsec > 1000000000)
-        {
-            wait_time.tv_nsec = wait_time.tv_nsec - 1000000000;
-            wait_time.tv_sec++;
-        }
-        gen_cond_timedwait(&interface_cond, &interface_mutex, &wait_time);
-        return (0);
+        wait_time->tv_nsec = wait_time->tv_nsec - 1000000000;
+        wait_time->tv_sec++;
     }
+}
 
-    /* this thread has gained control of the polling.  */
-    sc_test_busy = 1;
+
+/* tcp_op_complete()
+ *
+ * marks an operation that has already been taken off of its shard list
+ * as complete and hands it to the test functions
+ *
+ * no return value
+ */
+static void tcp_op_complete(method_op_p op)
+{
+    gen_mutex_lock(&interface_mutex);
+    ((struct tcp_op *)(op->method_data))->tcp_op_state = BMI_TCP_COMPLETE;
+    op_list_add(completion_array[op->context_id], op);
+    if (tcp_progress_threads)
+    {
+        gen_cond_broadcast(&completion_cond);
+    }
     gen_mutex_unlock(&interface_mutex);
+}
 
-    /* our turn to look at the socket collection */
-    ret = BMI_socket_collection_testglobal(tcp_socket_collection_p,
+
+/* tcp_op_complete_unexp()
+ *
+ * hands a fully received unexpected message to BMI_tcp_testunexpected()
+ *
+ * no return value
+ */
+static void tcp_op_complete_unexp(method_op_p op)
+{
+    gen_mutex_lock(&interface_mutex);
+    op_list_add(unexp_completion_list, op);
+    if (tcp_progress_threads)
+    {
+        gen_cond_broadcast(&completion_cond);
+    }
+    gen_mutex_unlock(&interface_mutex);
+}
+
+
+/* tcp_wait_for_work()
+ *
+ * called by the test functions, with interface_mutex held, when nothing
+ * they are looking for has completed yet.  Without progress threads this
+ * drives the sockets directly; otherwise it sleeps for up to
+ * max_idle_time milliseconds or until a progress thread completes an
+ * operation.  interface_mutex is held again on return.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int tcp_wait_for_work(int max_idle_time)
+{
+    struct timespec wait_time;
+    int ret = 0;
+
+    if (!tcp_progress_threads)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        gen_mutex_lock(&tcp_shards[0].mutex);
+        ret = tcp_do_work(&tcp_shards[0], max_idle_time);
+        gen_mutex_unlock(&tcp_shards[0].mutex);
+        gen_mutex_lock(&interface_mutex);
+        return (ret);
+    }
+
+    if (max_idle_time > 0)
+    {
+        tcp_deadline(&wait_time, max_idle_time);
+        gen_cond_timedwait(&completion_cond, &interface_mutex, &wait_time);
+    }
+    return (0);
+}
+
+
+/* tcp_release_dead_addrs()
+ *
+ * frees addresses that were dropped while the shard was being polled
+ *
+ * no return value
+ */
+static void tcp_release_dead_addrs(struct tcp_shard *shard)
+{
+    struct tcp_addr *tcp_addr_data = NULL;
+
+    while (!qlist_empty(&shard->dead_addrs))
+    {
+        tcp_addr_data = qlist_entry(shard->dead_addrs.next,
+                                    struct tcp_addr, dead_link);
+        qlist_del(&tcp_addr_data->dead_link);
+        dealloc_tcp_method_addr(tcp_addr_data->map);
+    }
+}
+
+
+#ifdef __GEN_POSIX_LOCKING__
+/* tcp_progress_thread()
+ *
+ * drives the sockets of one shard until the module is finalized
+ */
+static void *tcp_progress_thread(void *arg)
+{
+    struct tcp_shard *shard = arg;
+
+    gen_mutex_lock(&shard->mutex);
+    while (shard->running)
+    {
+        tcp_do_work(shard, TCP_PROGRESS_IDLE_MS);
+    }
+    gen_mutex_unlock(&shard->mutex);
+
+    return (NULL);
+}
+#endif
+
+
+/* tcp_stop_progress_threads()
+ *
+ * tells the progress threads to exit and waits for them.  Must not be
+ * called with interface_mutex held.
+ *
+ * no return value
+ */
+static void tcp_stop_progress_threads(void)
+{
+#ifdef __GEN_POSIX_LOCKING__
+    int i;
+
+    for (i = 0; i < tcp_progress_threads; i++)
+    {
+        if (tcp_shards[i].running)
+        {
+            gen_mutex_lock(&tcp_shards[i].mutex);
+            tcp_shards[i].running = 0;
+            gen_mutex_unlock(&tcp_shards[i].mutex);
+            pthread_join(tcp_shards[i].thread, NULL);
+        }
+    }
+#endif
+}
+
+
+/* tcp_parse_progress_threads()
+ *
+ * picks the tcp_progress_threads=N setting out of the BMI options
+ * string
+ *
+ * returns the number of progress threads to run, or 0 if the test
+ * functions should drive the sockets themselves
+ */
+static int tcp_parse_progress_threads(const char *options)
+{
+    const char *cp;
+    char *end_ptr;
+    long count;
+
+    if (!options)
+    {
+        return (0);
+    }
+
+    cp = strstr(options, "tcp_progress_threads");
+    if (!cp)
+    {
+        return (0);
+    }
+
+    cp += strlen("tcp_progress_threads");
+    for (; isspace(*cp); cp++);     /* skip whitespace */
+    if (*cp != '=')
+    {
+        gossip_err("Warning: malformed tcp_progress_threads option; "
+                   "not using progress threads.\n");
+        return (0);
+    }
+    for (++cp; isspace(*cp); cp++); /* skip '=' and whitespace */
+
+    count = strtol(cp, &end_ptr, 10);
+    if (end_ptr == cp || (*end_ptr != '\0' && *end_ptr != ',') ||
+        count < 0)
+    {
+        gossip_err("Warning: malformed tcp_progress_threads option; "
+                   "not using progress threads.\n");
+        return (0);
+    }
+
+    if (count > TCP_MAX_PROGRESS_THREADS)
+    {
+        gossip_err("Warning: limiting tcp_progress_threads to %d.\n",
+                   TCP_MAX_PROGRESS_THREADS);
+        count = TCP_MAX_PROGRESS_THREADS;
+    }
+
+#ifndef __GEN_POSIX_LOCKING__
+    if (count > 0)
+    {
+        gossip_err("Warning: tcp_progress_threads needs thread support; "
+                   "not using progress threads.\n");
+        count = 0;
+    }
+#endif
+
+    return ((int) count);
+}
+
+
+/* tcp_parse_zerocopy()
+ *
+ * picks the tcp_zerocopy setting out of the BMI options string.  It
+ * may be given alone or as tcp_zerocopy=N, where N is the smallest
+ * rendezvous payload in bytes that is worth sending with MSG_ZEROCOPY.
+ *
+ * returns the size threshold, or 0 if zero copy sends are disabled
+ */
+static bmi_size_t tcp_parse_zerocopy(const char *options)
+{
+    const char *cp;
+#ifdef __USE_ZEROCOPY__
+    char *end_ptr;
+    long long size;
+#endif
+
+    if (!options)
+    {
+        return (0);
+    }
+
+    cp = strstr(options, "tcp_zerocopy");
+    if (!cp)
+    {
+        return (0);
+    }
+
+#ifndef __USE_ZEROCOPY__
+    gossip_err("Warning: tcp_zerocopy is not supported on this "
+               "platform; not using zero copy sends.\n");
+    return (0);
+#else
+    cp += strlen("tcp_zerocopy");
+    for (; isspace(*cp); cp++);     /* skip whitespace */
+    if (*cp != '=')
+    {
+        return (TCP_ZEROCOPY_MIN_DEFAULT);
+    }
+    for (++cp; isspace(*cp); cp++); /* skip '=' and whitespace */
+
+    size = strtoll(cp, &end_ptr, 10);
+    if (end_ptr == cp || (*end_ptr != '\0' && *end_ptr != ',') ||
+        size < 0)
+    {
+        gossip_err("Warning: malformed tcp_zerocopy option; "
+                   "not using zero copy sends.\n");
+        return (0);
+    }
+
+    /* eager messages are always copied */
+    if (size > 0 && size <= TCP_MODE_EAGER_LIMIT)
+    {
+        size = TCP_MODE_EAGER_LIMIT + 1;
+    }
+    return ((bmi_size_t) size);
+#endif
+}
+
+
+/* tcp_flush_stats()
+ *
+ * adds the counts gathered by a shard to the server performance
+ * counters.  Must be called with the shard mutex held.
+ *
+ * no return value
+ */
+static void tcp_flush_stats(struct tcp_shard *shard)
+{
+#ifdef __PVFS2_SERVER__
+    static const int keys[TCP_STAT_COUNT] = {
+        PINT_PERF_BMI_MSGS_SENT,
+        PINT_PERF_BMI_SEND_CALLS,
+        PINT_PERF_BMI_MSGS_RECV,
+        PINT_PERF_BMI_RECV_CALLS
+    };
+    int i;
+
+    for (i = 0; i < TCP_STAT_COUNT; i++)
+    {
+        if (shard->stats[i])
+        {
+            PINT_perf_count(PINT_server_pc, keys[i], shard->stats[i],
+                            PINT_PERF_ADD);
+            shard->stats[i] = 0;
+        }
+    }
+#endif
+}
+
+
+/* tcp_do_work()
+ *
+ * this is the function that actually does communication work on the
+ * sockets of one shard, either on behalf of BMI_tcp_testXXX and
+ * BMI_tcp_waitXXX functions or from a progress thread.  The amount of
+ * work that it does is tunable.  Must be called with the shard mutex
+ * held.
+ *
+ * returns 0 on success, -errno on failure.
+ */
+static int tcp_do_work(struct tcp_shard *shard,
+                       int max_idle_time)
+{
+    int ret = -1;
+    bmi_method_addr_p addr_array[TCP_WORK_METRIC];
+    int status_array[TCP_WORK_METRIC];
+    int socket_count = 0;
+    int i = 0;
+    int stall_flag = 0;
+    int busy_flag = 1;
+    struct timespec req;
+    struct tcp_addr *tcp_addr_data = NULL;
+    struct timespec wait_time;
+
+    if (shard->sc_test_busy)
+    {
+        /* another thread is already polling or working on sockets */
+        if (max_idle_time == 0)
+        {
+            /* we don't want to spend time waiting on it; return
+             * immediately.
+             */
+            return (0);
+        }
+
+        /* Sleep until working thread signals that it has finished
+         * its work and then return.  No need for this thread to poll;
+         * the other thread may have already finished what we wanted.
+         * This condition wait is used strictly as a best effort to
+         * prevent busy spin.  We'll sort out the results later.
+         */
+        tcp_deadline(&wait_time, max_idle_time);
+        gen_cond_timedwait(&shard->cond, &shard->mutex, &wait_time);
+        return (0);
+    }
+
+    /* this thread has gained control of the polling.  */
+    shard->sc_test_busy = 1;
+    gen_mutex_unlock(&shard->mutex);
+
+    /* our turn to look at the socket collection */
+    ret = BMI_socket_collection_testglobal(shard->sc,
                                            TCP_WORK_METRIC,
                                            &socket_count,
                                            addr_array, 
                                            status_array,
                                            max_idle_time);
 
-    gen_mutex_lock(&interface_mutex);
-    sc_test_busy = 0;
+    gen_mutex_lock(&shard->mutex);
+    shard->sc_test_busy = 0;
 
     if (ret < 0)
     {
+        tcp_release_dead_addrs(shard);
         /* wake up anyone else who might have been waiting */
-        gen_cond_broadcast(&interface_cond);
+        gen_cond_broadcast(&shard->cond);
         PVFS_perror_gossip("Error: socket collection:", ret);
         /* BMI_socket_collection_testglobal() returns BMI error code */
 	return (ret);
@@ -3222,6 +3887,12 @@ static int tcp_do_work(int max_idle_time)
     for (i = 0; i < socket_count; i++)
     {
 	tcp_addr_data = addr_array[i]->method_data;
+	/* skip addresses that were dropped while we were polling */
+	if (tcp_addr_data->dead)
+	{
+	    continue;
+	}
+
 	/* skip working on addresses in failure mode */
 	if (tcp_addr_data->addr_error)
 	{
@@ -3230,6 +3901,26 @@ static int tcp_do_work(int max_idle_time)
 	    continue;
 	}
 
+#ifdef __USE_ZEROCOPY__
+	/* zero copy completions are reported through the socket error
+	 * queue.  If that is all that was waiting, carry on as normal; a
+	 * real error will still be flagged on the next pass.
+	 */
+	if ((status_array[i] & SC_ERROR_BIT) && tcp_addr_data->zc_enabled)
+	{
+	    ret = tcp_zc_reap(addr_array[i]);
+	    if (ret < 0)
+	    {
+		/* the address has already been failed */
+		continue;
+	    }
+	    if (ret > 0)
+	    {
+		status_array[i] &= ~SC_ERROR_BIT;
+	    }
+	}
+#endif
+
 	if (status_array[i] & SC_ERROR_BIT)
 	{
 	    ret = tcp_do_work_error(addr_array[i]);
@@ -3271,6 +3962,9 @@ static int tcp_do_work(int max_idle_time)
         }
     }
 
+    tcp_flush_stats(shard);
+    tcp_release_dead_addrs(shard);
+
     /* IMPORTANT NOTE: if we have set the following flag, then it indicates that
      * poll() is finding data on our sockets, yet we are not able to move
      * any of it right now.  This means that the sockets are backlogged, and
@@ -3283,13 +3977,13 @@ static int tcp_do_work(int max_idle_time)
     {
 	req.tv_sec = 0;
 	req.tv_nsec = 1000;
-        gen_mutex_unlock(&interface_mutex);
+        gen_mutex_unlock(&shard->mutex);
 	nanosleep(&req, NULL);
-        gen_mutex_lock(&interface_mutex);
+        gen_mutex_lock(&shard->mutex);
     }
 
     /* wake up anyone else who might have been waiting */
-    gen_cond_broadcast(&interface_cond);
+    gen_cond_broadcast(&shard->cond);
     return (0);
 }
 
@@ -3305,6 +3999,7 @@ static int tcp_do_work_send(bmi_method_addr_p map,
 {
     method_op_p active_method_op = NULL;
     struct op_list_search_key key;
+    struct tcp_addr *tcp_addr_data = map->method_data;
     int blocked_flag = 0;
     int ret = 0;
     int tmp_stall_flag;
@@ -3319,14 +4014,24 @@ static int tcp_do_work_send(bmi_method_addr_p map,
 	memset(&key, 0, sizeof(struct op_list_search_key));
 	key.method_addr = map;
 	key.method_addr_yes = 1;
-	active_method_op = op_list_search(op_list_array[IND_SEND], &key);
+	active_method_op = op_list_search(tcp_addr_shard(map)->op_lists[IND_SEND],
+	                                  &key);
 	if (!active_method_op)
 	{
 	    /* ran out of queued sends to work on */
 	    return (0);
 	}
 
-	ret = work_on_send_op(active_method_op, &blocked_flag, &tmp_stall_flag);
+	if (tcp_addr_data->not_connected)
+	{
+	    ret = work_on_send_op(active_method_op, &blocked_flag,
+	                          &tmp_stall_flag);
+	}
+	else
+	{
+	    ret = work_on_send_batch(active_method_op, &blocked_flag,
+	                             &tmp_stall_flag);
+	}
 	if (!tmp_stall_flag)
         {
 	    *stall_flag = 0;
@@ -3383,6 +4088,7 @@ static int handle_new_connection(bmi_method_addr_p map)
     tcp_addr_data->socket = accepted_socket;
     tcp_addr_data->peer = tmp_peer;
     tcp_addr_data->peer_type = BMI_TCP_PEER_IP;
+    tcp_enable_zerocopy(tcp_addr_data);
 
     /* set a flag to make sure that we never try to reconnect this address
      * in the future
@@ -3399,7 +4105,7 @@ static int handle_new_connection(bmi_method_addr_p map)
 	return (ret);
     }
 
-    BMI_socket_collection_add(tcp_socket_collection_p, new_addr);
+    BMI_socket_collection_add(tcp_addr_shard(new_addr)->sc, new_addr);
 
     dealloc_tcp_method_addr(map);
     return (0);
@@ -3421,6 +4127,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
     struct op_list_search_key key;
     struct tcp_msg_header new_header;
     struct tcp_addr *tcp_addr_data = map->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(map);
     struct tcp_op *tcp_op_data = NULL;
     int tmp_errno;
     int tmp;
@@ -3486,17 +4193,23 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	}
     }
 
-    /* let's see if the entire header is ready to be received.  If so
-     * we will go ahead and pull it.  Otherwise, we will try again later.
-     * It isn't worth the complication of reading only a partial message
-     * header - we really want it atomically
+    /* pull in whatever has arrived of the next message header.  A
+     * partial header is kept with the address until the rest shows up;
+     * reading it straight away rather than peeking first saves a system
+     * call per message.
      */
-    ret = BMI_sockio_nbpeek(tcp_addr_data->socket,
-                            new_header.enc_hdr, 
-                            TCP_ENC_HDR_SIZE);
+    tmp = TCP_ENC_HDR_SIZE - tcp_addr_data->hdr_len;
+    ret = BMI_sockio_nbrecv(tcp_addr_data->socket,
+                            &tcp_addr_data->hdr_buf[tcp_addr_data->hdr_len],
+                            tmp);
+    /* a short read means the next recv() found the socket empty */
+    tcp_stat(shard, TCP_STAT_RECV_CALLS, (ret > 0 && ret < tmp) ? 2 : 1);
     if (ret < 0)
     {
-	tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-errno));
+	tmp_errno = errno;
+	gossip_debug(GOSSIP_BMI_DEBUG_TCP, "Error: BMI_sockio_nbrecv: %s\n",
+	             strerror(tmp_errno));
+	tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-tmp_errno));
 	return (0);
     }
 
@@ -3519,7 +4232,8 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
         tcp_addr_data->zero_read_limit = 0;
     }
 
-    if (ret < TCP_ENC_HDR_SIZE)
+    tcp_addr_data->hdr_len += ret;
+    if (tcp_addr_data->hdr_len < TCP_ENC_HDR_SIZE)
     {
         current_time = time(NULL);
         if (!tcp_addr_data->short_header_timer)
@@ -3540,22 +4254,15 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	return (0);
     }
 
+    tcp_addr_data->hdr_len = 0;
     tcp_addr_data->short_header_timer = 0;
     *stall_flag = 0;
-    gossip_ldebug(GOSSIP_BMI_DEBUG_TCP, "Reading header for new op.\n");
-    ret = BMI_sockio_nbrecv(tcp_addr_data->socket,
-                            new_header.enc_hdr, 
-                            TCP_ENC_HDR_SIZE);
-    if (ret < TCP_ENC_HDR_SIZE)
-    {
-	tmp_errno = errno;
-	gossip_err("Error: BMI_sockio_nbrecv: %s\n", strerror(tmp_errno));
-	tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-tmp_errno));
-	return (0);
-    }
+    gossip_ldebug(GOSSIP_BMI_DEBUG_TCP, "Read header for new op.\n");
+    memcpy(new_header.enc_hdr, tcp_addr_data->hdr_buf, TCP_ENC_HDR_SIZE);
 
     /* decode the header */
     BMI_TCP_DEC_HDR(new_header);
+    tcp_stat(shard, TCP_STAT_MSGS_RECV, 1);
 
     /* so we have the header. now what?  These are the possible
      * scenarios:
@@ -3615,7 +4322,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	tcp_op_data->tcp_op_state = BMI_TCP_INPROGRESS;
 	tcp_op_data->env = new_header;
 
-	op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
+	op_list_add(shard->op_lists[IND_RECV_INFLIGHT], active_method_op);
 	
         /* grab some data if we can */
 	return (work_on_recv_op(active_method_op, &tmp));
@@ -3628,7 +4335,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
     key.msg_tag_yes = 1;
 
     /* look for a match within the posted operations */
-    active_method_op = op_list_search(op_list_array[IND_RECV], &key);
+    active_method_op = op_list_search(shard->op_lists[IND_RECV], &key);
 
     if (active_method_op)
     {
@@ -3648,7 +4355,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	op_list_remove(active_method_op);
 	active_method_op->env_amt_complete = TCP_ENC_HDR_SIZE;
 	active_method_op->actual_size = new_header.size;
-	op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
+	op_list_add(shard->op_lists[IND_RECV_INFLIGHT], active_method_op);
 	return (work_on_recv_op(active_method_op, &tmp));
     }
 
@@ -3694,7 +4401,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
     tcp_op_data->tcp_op_state = BMI_TCP_BUFFERING;
     tcp_op_data->env = new_header;
 
-    op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
+    op_list_add(shard->op_lists[IND_RECV_INFLIGHT], active_method_op);
 
     /* grab some data if we can */
     if (new_header.mode == TCP_MODE_EAGER)
@@ -3722,6 +4429,8 @@ static int work_on_send_op(method_op_p my_method_op,
     int ret = -1;
     struct tcp_addr *tcp_addr_data = my_method_op->addr->method_data;
     struct tcp_op *tcp_op_data = my_method_op->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(my_method_op->addr);
+    int zc_flag = 0;
 
     *blocked_flag = 1;
     *stall_flag = 0;
@@ -3746,6 +4455,19 @@ static int work_on_send_op(method_op_p my_method_op,
 	}
     }
 
+#ifdef __USE_SENDFILE__
+    if (tcp_op_data->send_file)
+    {
+        ret = file_payload_progress(tcp_addr_data->socket,
+                                    tcp_op_data->file_fd,
+                                    tcp_op_data->file_offset,
+                                    my_method_op->actual_size,
+                                    my_method_op->amt_complete,
+                                    tcp_op_data->env.enc_hdr,
+                                    &my_method_op->env_amt_complete);
+    }
+    else
+#endif
     ret = payload_progress(tcp_addr_data->socket,
 	                   my_method_op->buffer_list,
 	                   my_method_op->size_list,
@@ -3755,7 +4477,16 @@ static int work_on_send_op(method_op_p my_method_op,
 	                   &(my_method_op->cur_index_complete),
 	                   BMI_SEND,
 	                   tcp_op_data->env.enc_hdr,
-	                   &my_method_op->env_amt_complete);
+	                   &my_method_op->env_amt_complete,
+	                   (tcp_addr_data->zc_enabled &&
+	                    my_method_op->mode == TCP_MODE_REND &&
+	                    my_method_op->actual_size >= tcp_zerocopy_min) ?
+	                   &zc_flag : NULL);
+    tcp_stat(shard, TCP_STAT_SEND_CALLS, 1);
+    if (zc_flag)
+    {
+        tcp_zc_sent(my_method_op, tcp_addr_data->zc_next++);
+    }
     if (ret < 0)
     {
         PVFS_perror_gossip("Error: payload_progress", ret);
@@ -3778,12 +4509,19 @@ static int work_on_send_op(method_op_p my_method_op,
     {
 	/* we are done */
 	my_method_op->error_code = 0;
-	BMI_socket_collection_remove_write_bit(tcp_socket_collection_p,
-					       my_method_op->addr);
+	BMI_socket_collection_remove_write_bit(shard->sc, my_method_op->addr);
 	op_list_remove(my_method_op);
-	((struct tcp_op *) (my_method_op->method_data))->tcp_op_state = 
-	        BMI_TCP_COMPLETE;
-	op_list_add(completion_array[my_method_op->context_id], my_method_op);
+	tcp_stat(shard, TCP_STAT_MSGS_SENT, 1);
+	if (tcp_op_data->zc_acked != tcp_op_data->zc_count)
+	{
+	    /* the kernel still holds on to the buffers */
+	    tcp_op_data->tcp_op_state = BMI_TCP_ZC_WAIT;
+	    op_list_add(shard->op_lists[IND_SEND_ZC_WAIT], my_method_op);
+	}
+	else
+	{
+	    tcp_op_complete(my_method_op);
+	}
 	*blocked_flag = 0;
     }
     else
@@ -3796,6 +4534,194 @@ static int work_on_send_op(method_op_p my_method_op,
 }
 
 
+/* tcp_send_batchable()
+ *
+ * returns 1 if a queued send is small enough to share a writev with
+ * its neighbours, 0 otherwise
+ */
+static int tcp_send_batchable(method_op_p op)
+{
+    struct tcp_op *tcp_op_data = op->method_data;
+
+    return (!tcp_op_data->send_file &&
+            op->actual_size <= TCP_MODE_EAGER_LIMIT &&
+            (op->list_count - op->list_index) < TCP_BATCH_IOV_COUNT);
+}
+
+
+/* tcp_advance_payload()
+ *
+ * records that amt more bytes of an operation's payload have been
+ * transferred
+ *
+ * no return value
+ */
+static void tcp_advance_payload(method_op_p op,
+                                bmi_size_t amt)
+{
+    bmi_size_t left;
+
+    op->amt_complete += amt;
+    while (amt > 0)
+    {
+        left = op->size_list[op->list_index] - op->cur_index_complete;
+        if (amt >= left)
+        {
+            amt -= left;
+            op->cur_index_complete = 0;
+            op->list_index++;
+        }
+        else
+        {
+            op->cur_index_complete += amt;
+            amt = 0;
+        }
+    }
+}
+
+
+/* work_on_send_batch()
+ *
+ * used in place of work_on_send_op() on a connected address.  If the
+ * send at the head of the queue is small, it goes out in one writev
+ * together with the small sends queued behind it for the same address,
+ * so that a backlog of small messages costs one system call per poll
+ * cycle rather than one per message.
+ * 
+ * sets blocked_flag if no more work can be done on socket without
+ * blocking
+ * returns 0 on success, -errno on failure.
+ */
+static int work_on_send_batch(method_op_p first_op,
+			      int *blocked_flag,
+                              int *stall_flag)
+{
+    struct tcp_addr *tcp_addr_data = first_op->addr->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(first_op->addr);
+    struct tcp_op *tcp_op_data = NULL;
+    method_op_p batch[TCP_BATCH_MAX_MSGS];
+    struct iovec io_vector[TCP_BATCH_IOV_COUNT];
+    struct qlist_head *pos = NULL;
+    method_op_p op = NULL;
+    int batch_count = 0;
+    int count = 0;
+    int i;
+    int ret;
+    bmi_size_t done;
+    bmi_size_t tmp;
+
+    /* gather the small sends queued for this address, in order; other
+     * addresses' sends on the same list are skipped over
+     */
+    for (pos = &first_op->op_list_entry;
+         pos != shard->op_lists[IND_SEND] && batch_count < TCP_BATCH_MAX_MSGS;
+         pos = pos->next)
+    {
+        op = qlist_entry(pos, struct method_op, op_list_entry);
+        if (op->addr != first_op->addr)
+        {
+            continue;
+        }
+        if (!tcp_send_batchable(op) ||
+            (count + 1 + op->list_count - op->list_index) >
+                TCP_BATCH_IOV_COUNT)
+        {
+            break;
+        }
+
+        tcp_op_data = op->method_data;
+        if (op->env_amt_complete < TCP_ENC_HDR_SIZE)
+        {
+            io_vector[count].iov_base =
+                &tcp_op_data->env.enc_hdr[op->env_amt_complete];
+            io_vector[count].iov_len = TCP_ENC_HDR_SIZE -
+                                       op->env_amt_complete;
+            count++;
+        }
+        for (i = op->list_index; i < op->list_count; i++)
+        {
+            io_vector[count].iov_base = op->buffer_list[i];
+            io_vector[count].iov_len = op->size_list[i];
+            if (i == op->list_index)
+            {
+                io_vector[count].iov_base = (char *) op->buffer_list[i] +
+                                            op->cur_index_complete;
+                io_vector[count].iov_len -= op->cur_index_complete;
+            }
+            count++;
+        }
+        batch[batch_count++] = op;
+    }
+
+    if (batch_count < 2)
+    {
+        /* nothing to combine it with */
+        return (work_on_send_op(first_op, blocked_flag, stall_flag));
+    }
+
+    *blocked_flag = 1;
+    *stall_flag = 0;
+
+    ret = BMI_sockio_nbvector(tcp_addr_data->socket, io_vector, count, 0);
+    tcp_stat(shard, TCP_STAT_SEND_CALLS, 1);
+    if (ret < 0)
+    {
+        ret = bmi_tcp_errno_to_pvfs(-errno);
+        PVFS_perror_gossip("Error: BMI_sockio_nbvector", ret);
+	tcp_forget_addr(first_op->addr, 0, ret);
+	return (0);
+    }
+    if (ret == 0)
+    {
+	*stall_flag = 1;
+	return (0);
+    }
+
+    gossip_ldebug(GOSSIP_BMI_DEBUG_TCP, "Sent: %d bytes of data for %d "
+                  "messages.\n", ret, batch_count);
+
+    /* hand the bytes written out to the operations they came from */
+    done = ret;
+    for (i = 0; i < batch_count; i++)
+    {
+        op = batch[i];
+        tmp = TCP_ENC_HDR_SIZE - op->env_amt_complete;
+        if (tmp > done)
+        {
+            tmp = done;
+        }
+        op->env_amt_complete += tmp;
+        done -= tmp;
+
+        tmp = op->actual_size - op->amt_complete;
+        if (tmp > done)
+        {
+            tmp = done;
+        }
+        tcp_advance_payload(op, tmp);
+        done -= tmp;
+
+        if (op->amt_complete < op->actual_size ||
+            op->env_amt_complete < TCP_ENC_HDR_SIZE)
+        {
+            /* the socket filled up partway through this one */
+            ((struct tcp_op *) op->method_data)->tcp_op_state =
+                BMI_TCP_INPROGRESS;
+            return (0);
+        }
+
+	op->error_code = 0;
+	BMI_socket_collection_remove_write_bit(shard->sc, op->addr);
+	op_list_remove(op);
+	tcp_op_complete(op);
+	tcp_stat(shard, TCP_STAT_MSGS_SENT, 1);
+    }
+
+    *blocked_flag = 0;
+    return (0);
+}
+
+
 /* work_on_recv_op()
  *
  * used to perform work on a recv operation.  this is called by the poll
@@ -3825,7 +4751,9 @@ static int work_on_recv_op(method_op_p my_method_op,
 	                       &(my_method_op->cur_index_complete),
 	                       BMI_RECV,
 	                       NULL,
-	                       0);
+	                       0,
+	                       NULL);
+	tcp_stat(tcp_addr_shard(my_method_op->addr), TCP_STAT_RECV_CALLS, 1);
 	if (ret < 0)
 	{
             PVFS_perror_gossip("Error: payload_progress", ret);
@@ -3854,7 +4782,8 @@ static int work_on_recv_op(method_op_p my_method_op,
 	if (tcp_op_data->tcp_op_state == BMI_TCP_BUFFERING)
 	{
 	    /* queue up to wait on matching post recv */
-	    op_list_add(op_list_array[IND_RECV_EAGER_DONE_BUFFERING],
+	    op_list_add(tcp_addr_shard(my_method_op->addr)->op_lists[
+	                    IND_RECV_EAGER_DONE_BUFFERING],
 			my_method_op);
 	}
 	else
@@ -3862,15 +4791,11 @@ static int work_on_recv_op(method_op_p my_method_op,
 	    my_method_op->error_code = 0;
 	    if (my_method_op->mode == TCP_MODE_UNEXP)
 	    {
-		op_list_add(op_list_array[IND_COMPLETE_RECV_UNEXP],
-			    my_method_op);
+		tcp_op_complete_unexp(my_method_op);
 	    }
 	    else
 	    {
-		((struct tcp_op *)(my_method_op->method_data))->tcp_op_state = 
-		        BMI_TCP_COMPLETE;
-		op_list_add(completion_array[my_method_op->context_id], 
-                            my_method_op);
+		tcp_op_complete(my_method_op);
 	    }
 	}
     }
@@ -4234,9 +5159,12 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                                  struct tcp_msg_header my_header,
                                  void *user_ptr,
                                  bmi_context_id context_id,
-                                 PVFS_hint hints)
+                                 PVFS_hint hints,
+                                 int file_fd,
+                                 bmi_size_t file_offset)
 {
     struct tcp_addr *tcp_addr_data = dest->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(dest);
     method_op_p query_op = NULL;
     int ret = -1;
     bmi_size_t amt_complete = 0;
@@ -4245,6 +5173,9 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     int list_index = 0;
     bmi_size_t cur_index_complete = 0;
     PINT_event_id eid = 0;
+    int zc_flag = 0;
+    uint32_t zc_seq = 0;
+    method_op_p new_op = NULL;
 
 #if PINT_EVENT_ENABLED
     int i = 0;
@@ -4290,11 +5221,11 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     memset(&key, 0, sizeof(struct op_list_search_key));
     key.method_addr = dest;
     key.method_addr_yes = 1;
-    query_op = op_list_search(op_list_array[IND_SEND], &key);
+    query_op = op_list_search(shard->op_lists[IND_SEND], &key);
     if (query_op)
     {
         /* queue up operation */
-        ret = enqueue_operation(op_list_array[IND_SEND], 
+        ret = enqueue_operation(shard->op_lists[IND_SEND], 
                                 BMI_SEND,
                                 dest, 
                                 (void **) buffer_list,
@@ -4310,6 +5241,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                                 0,
                                 context_id,
                                 eid);
+        tcp_attach_file(*id, file_fd, file_offset);
 
         /* TODO: is this causing deadlocks?  See similar call in recv
          * path for another example.  This particular one seems to be an
@@ -4324,7 +5256,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
 	     * function since we appear to be backlogged.  Make sure that
 	     * we do not wait in the poll, however.
 	     */
-	    ret = tcp_do_work(0);
+	    ret = tcp_do_work(shard, 0);
 	}
 #endif
 	if (ret < 0)
@@ -4351,7 +5283,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
 #if 0
     /* TODO: this is a hack for testing! */
     /* disables immediate send completion... */
-    ret = enqueue_operation(op_list_array[IND_SEND], BMI_SEND,
+    ret = enqueue_operation(shard->op_lists[IND_SEND], BMI_SEND,
 			    dest, buffer_list, size_list, list_count, 0, 0,
 			    id, BMI_TCP_INPROGRESS, my_header, user_ptr,
 			    my_header.size, 0,
@@ -4362,7 +5294,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     if (tcp_addr_data->not_connected)
     {
 	/* if the connection is not completed, queue up for later work */
-	ret = enqueue_operation(op_list_array[IND_SEND], 
+	ret = enqueue_operation(shard->op_lists[IND_SEND], 
                                 BMI_SEND,
 				dest, 
                                 (void **) buffer_list, 
@@ -4378,6 +5310,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                                 0,
 				context_id,
                                 eid);
+	tcp_attach_file(*id, file_fd, file_offset);
 	if (ret < 0)
 	{
 	    gossip_err("Error: enqueue_operation() returned: %d\n", ret);
@@ -4387,6 +5320,19 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
 
     /* try to send some data */
     env_amt_complete = 0;
+#ifdef __USE_SENDFILE__
+    if (file_fd >= 0)
+    {
+        ret = file_payload_progress(tcp_addr_data->socket,
+                                    file_fd,
+                                    file_offset,
+                                    my_header.size,
+                                    0,
+                                    my_header.enc_hdr,
+                                    &env_amt_complete);
+    }
+    else
+#endif
     ret = payload_progress(tcp_addr_data->socket,
                            (void **) buffer_list,
                            size_list, 
@@ -4396,7 +5342,16 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                            &cur_index_complete, 
                            BMI_SEND, 
                            my_header.enc_hdr, 
-                           &env_amt_complete);
+                           &env_amt_complete,
+                           (tcp_addr_data->zc_enabled &&
+                            my_header.mode == TCP_MODE_REND &&
+                            my_header.size >= tcp_zerocopy_min) ?
+                           &zc_flag : NULL);
+    tcp_stat(shard, TCP_STAT_SEND_CALLS, 1);
+    if (zc_flag)
+    {
+        zc_seq = tcp_addr_data->zc_next++;
+    }
     if (ret < 0)
     {
         PVFS_perror_gossip("Error: payload_progress", ret);
@@ -4411,6 +5366,38 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     assert(amt_complete <= my_header.size);
     if (amt_complete == my_header.size && env_amt_complete == TCP_ENC_HDR_SIZE)
     {
+        tcp_stat(shard, TCP_STAT_MSGS_SENT, 1);
+        if (zc_flag)
+        {
+            /* the kernel still holds on to the buffers; keep the
+             * operation aside until it lets go of them
+             */
+            ret = enqueue_operation(shard->op_lists[IND_SEND_ZC_WAIT],
+                                    BMI_SEND,
+                                    dest,
+                                    (void **) buffer_list,
+                                    size_list,
+                                    list_count,
+                                    amt_complete,
+                                    env_amt_complete,
+                                    id,
+                                    BMI_TCP_ZC_WAIT,
+                                    my_header,
+                                    user_ptr,
+                                    my_header.size,
+                                    0,
+                                    context_id,
+                                    eid);
+            if (ret < 0)
+            {
+                gossip_err("Error: enqueue_operation() returned: %d\n", ret);
+                return (ret);
+            }
+            new_op = id_gen_fast_lookup(*id);
+            tcp_zc_sent(new_op, zc_seq);
+            return (0);
+        }
+
         /* we are already done */
         PINT_EVENT_END(bmi_tcp_send_event_id, 
                        bmi_tcp_pid,
@@ -4422,7 +5409,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     }
 
     /* queue up the remainder */
-    ret = enqueue_operation(op_list_array[IND_SEND], 
+    ret = enqueue_operation(shard->op_lists[IND_SEND], 
                             BMI_SEND,
                             dest, 
                             (void **) buffer_list,
@@ -4438,18 +5425,26 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
                             0, 
                             context_id, 
                             eid);
+    tcp_attach_file(*id, file_fd, file_offset);
 
     if (ret < 0)
     {
         gossip_err("Error: enqueue_operation() returned: %d\n", ret);
     }
+    else if (zc_flag)
+    {
+        new_op = id_gen_fast_lookup(*id);
+        tcp_zc_sent(new_op, zc_seq);
+    }
     return (ret);
 }
 
 
 /* payload_progress()
  *
- * makes progress on sending/recving data payload portion of a message
+ * makes progress on sending/recving data payload portion of a message.
+ * If zc_flag is not NULL a send is made with MSG_ZEROCOPY, and *zc_flag
+ * is set if it used up a zero copy sequence number.
  *
  * returns amount completed on success, -errno on failure
  */
@@ -4462,8 +5457,10 @@ static int payload_progress(int s,
                             bmi_size_t *current_index_complete, 
                             enum bmi_op_type send_recv, 
                             char *enc_hdr, 
-                            bmi_size_t *env_amt_complete)
+                            bmi_size_t *env_amt_complete,
+                            int *zc_flag)
 {
+    struct iovec io_vector[BMI_TCP_IOV_COUNT + 1];
     int i;
     int count = 0;
     int ret;
@@ -4502,40 +5499,40 @@ static int payload_progress(int s,
     /* do we need to send any of the header? */
     if (send_recv == BMI_SEND && *env_amt_complete < TCP_ENC_HDR_SIZE)
     {
-	stat_io_vector[vector_index].iov_base = &enc_hdr[*env_amt_complete];
-	stat_io_vector[vector_index].iov_len = TCP_ENC_HDR_SIZE - 
-                                               *env_amt_complete;
+	io_vector[vector_index].iov_base = &enc_hdr[*env_amt_complete];
+	io_vector[vector_index].iov_len = TCP_ENC_HDR_SIZE - 
+                                          *env_amt_complete;
 	count++;
 	vector_index++;
 	header_flag = 1;
     }
 
     /* setup vector */
-    stat_io_vector[vector_index].iov_base = (char *) buffer_list[*list_index] +
-                                            *current_index_complete;
+    io_vector[vector_index].iov_base = (char *) buffer_list[*list_index] +
+                                       *current_index_complete;
     count++;
     if (final_index == 0)
     {
-	stat_io_vector[vector_index].iov_len = final_size - 
-                                               *current_index_complete;
+	io_vector[vector_index].iov_len = final_size - 
+                                          *current_index_complete;
     }
     else
     {
-	stat_io_vector[vector_index].iov_len = size_list[*list_index] - 
-                                               *current_index_complete;
+	io_vector[vector_index].iov_len = size_list[*list_index] - 
+                                          *current_index_complete;
 	for (i = (*list_index + 1); i < list_count; i++)
 	{
 	    vector_index++;
 	    count++;
-	    stat_io_vector[vector_index].iov_base = buffer_list[i];
+	    io_vector[vector_index].iov_base = buffer_list[i];
 	    if (i == final_index)
 	    {
-		stat_io_vector[vector_index].iov_len = final_size;
+		io_vector[vector_index].iov_len = final_size;
 		break;
 	    }
 	    else
 	    {
-		stat_io_vector[vector_index].iov_len = size_list[i];
+		io_vector[vector_index].iov_len = size_list[i];
 	    }
 	}
     }
@@ -4544,11 +5541,17 @@ static int payload_progress(int s,
 
     if (send_recv == BMI_RECV)
     {
-	ret = BMI_sockio_nbvector(s, stat_io_vector, count, 1);
+	ret = BMI_sockio_nbvector(s, io_vector, count, 1);
+    }
+#ifdef __USE_ZEROCOPY__
+    else if (zc_flag)
+    {
+	ret = BMI_sockio_nbvector_zc(s, io_vector, count, zc_flag);
     }
+#endif
     else
     {
-	ret = BMI_sockio_nbvector(s, stat_io_vector, count, 0);
+	ret = BMI_sockio_nbvector(s, io_vector, count, 0);
     }
 
     /* if error or nothing done, return now */
@@ -4579,9 +5582,9 @@ static int payload_progress(int s,
     while (completed > 0)
     {
 	/* take care of completed data payload */
-	if (completed >= stat_io_vector[i].iov_len)
+	if (completed >= io_vector[i].iov_len)
 	{
-	    completed -= stat_io_vector[i].iov_len;
+	    completed -= io_vector[i].iov_len;
 	    *current_index_complete = 0;
 	    (*list_index)++;
 	    i++;
@@ -4597,6 +5600,248 @@ static int payload_progress(int s,
 }
 
 
+#ifdef __USE_SENDFILE__
+/* file_payload_progress()
+ *
+ * counterpart of payload_progress() for sends whose payload comes from
+ * a file.  Whatever part of the range lies beyond the end of the file
+ * goes out as zeroes, which is what a short read into a zeroed buffer
+ * would have sent.
+ *
+ * returns amount of payload completed on success, -errno on failure
+ */
+static int file_payload_progress(int s,
+                                 int fd,
+                                 bmi_size_t offset,
+                                 bmi_size_t total_size,
+                                 bmi_size_t amt_complete,
+                                 char *enc_hdr,
+                                 bmi_size_t *env_amt_complete)
+{
+    static char zero_pad[4096];
+    bmi_size_t remaining = total_size - amt_complete;
+    int ret;
+    int eof = 0;
+
+    /* do we need to send any of the header? */
+    if (*env_amt_complete < TCP_ENC_HDR_SIZE)
+    {
+        ret = BMI_sockio_nbsend(s, &enc_hdr[*env_amt_complete],
+                                TCP_ENC_HDR_SIZE - *env_amt_complete);
+        if (ret < 0)
+        {
+            return (bmi_tcp_errno_to_pvfs(-errno));
+        }
+        *env_amt_complete += ret;
+        if (*env_amt_complete < TCP_ENC_HDR_SIZE)
+        {
+            return (0);
+        }
+    }
+
+    if (remaining == 0)
+    {
+        return (0);
+    }
+
+    ret = BMI_sockio_nbsendfile(s, fd, offset + amt_complete,
+                                remaining, &eof);
+    if (ret < 0)
+    {
+        return (bmi_tcp_errno_to_pvfs(-errno));
+    }
+    if (!eof || ret == remaining)
+    {
+        return (ret);
+    }
+
+    /* ran off the end of the file */
+    remaining -= ret;
+    if (remaining > sizeof(zero_pad))
+    {
+        remaining = sizeof(zero_pad);
+    }
+    eof = BMI_sockio_nbsend(s, zero_pad, remaining);
+    if (eof < 0)
+    {
+        return (bmi_tcp_errno_to_pvfs(-errno));
+    }
+    return (ret + eof);
+}
+#endif
+
+
+/* tcp_attach_file()
+ *
+ * switches a send that was just queued by tcp_post_send_generic() over
+ * to taking its payload from a file; nothing to do for buffer sends
+ */
+static void tcp_attach_file(bmi_op_id_t id,
+                            int file_fd,
+                            bmi_size_t file_offset)
+{
+    method_op_p query_op;
+    struct tcp_op *tcp_op_data;
+
+    if (file_fd < 0 || id == 0)
+    {
+        return;
+    }
+
+    query_op = (method_op_p) id_gen_fast_lookup(id);
+    tcp_op_data = query_op->method_data;
+    tcp_op_data->send_file = 1;
+    tcp_op_data->file_fd = file_fd;
+    tcp_op_data->file_offset = file_offset;
+}
+
+
+/* tcp_enable_zerocopy()
+ *
+ * turns on MSG_ZEROCOPY support for a newly created or accepted socket
+ * if zero copy sends have been asked for
+ *
+ * no return value
+ */
+static void tcp_enable_zerocopy(struct tcp_addr *tcp_addr_data)
+{
+    tcp_addr_data->zc_enabled = 0;
+    tcp_addr_data->zc_next = 0;
+
+#ifdef __USE_ZEROCOPY__
+    if (tcp_zerocopy_min > 0)
+    {
+        if (BMI_sockio_set_sockopt(tcp_addr_data->socket, SO_ZEROCOPY, 1) < 0)
+        {
+            gossip_debug(GOSSIP_BMI_DEBUG_TCP, "SO_ZEROCOPY: %s; "
+                         "copying sends instead.\n", strerror(errno));
+            return;
+        }
+        tcp_addr_data->zc_enabled = 1;
+    }
+#endif
+}
+
+
+/* tcp_zc_sent()
+ *
+ * records that a MSG_ZEROCOPY send with sequence number seq was made on
+ * behalf of an operation
+ *
+ * no return value
+ */
+static void tcp_zc_sent(method_op_p op,
+                        uint32_t seq)
+{
+    struct tcp_op *tcp_op_data = op->method_data;
+
+    if (tcp_op_data->zc_count == 0)
+    {
+        tcp_op_data->zc_first = seq;
+    }
+    tcp_op_data->zc_count++;
+}
+
+
+#ifdef __USE_ZEROCOPY__
+/* tcp_zc_overlap()
+ *
+ * counts how many of the count sequence numbers starting at op_first
+ * fall within [first, last], allowing for wraparound
+ *
+ * returns the number of sequence numbers in common
+ */
+static uint32_t tcp_zc_overlap(uint32_t op_first,
+                               uint32_t count,
+                               uint32_t first,
+                               uint32_t last)
+{
+    uint32_t len = last - first + 1;
+    uint32_t start = first - op_first;
+    uint32_t lead = op_first - first;
+
+    if (start < count)
+    {
+        /* range begins within the operation */
+        return ((len < count - start) ? len : count - start);
+    }
+    if (lead < len)
+    {
+        /* range begins before the operation and reaches into it */
+        return ((len - lead < count) ? len - lead : count);
+    }
+    return (0);
+}
+
+
+/* tcp_zc_reap()
+ *
+ * collects zero copy completions from the error queue of an address's
+ * socket and completes the operations the kernel no longer needs the
+ * buffers of.  Must be called with the shard mutex held.
+ *
+ * returns the number of completions collected, -errno on failure
+ */
+static int tcp_zc_reap(bmi_method_addr_p map)
+{
+    struct tcp_addr *tcp_addr_data = map->method_data;
+    struct tcp_shard *shard = tcp_addr_shard(map);
+    struct tcp_op *tcp_op_data = NULL;
+    struct qlist_head *pos = NULL;
+    struct qlist_head *scratch = NULL;
+    method_op_p op = NULL;
+    uint32_t first;
+    uint32_t last;
+    int reaped = 0;
+    int ret;
+    int i;
+    const int lists[2] = {IND_SEND, IND_SEND_ZC_WAIT};
+
+    while ((ret = BMI_sockio_zc_notification(tcp_addr_data->socket,
+                                             &first, &last)) > 0)
+    {
+        reaped++;
+
+        /* the head of the send queue may have been partly sent with
+         * zero copy too, so look there as well as at the waiting ops
+         */
+        for (i = 0; i < 2; i++)
+        {
+            qlist_for_each_safe(pos, scratch, shard->op_lists[lists[i]])
+            {
+                op = qlist_entry(pos, struct method_op, op_list_entry);
+                tcp_op_data = op->method_data;
+                if (op->addr != map || tcp_op_data->zc_count == 0)
+                {
+                    continue;
+                }
+
+                tcp_op_data->zc_acked += tcp_zc_overlap(
+                    tcp_op_data->zc_first, tcp_op_data->zc_count,
+                    first, last);
+                if (tcp_op_data->tcp_op_state == BMI_TCP_ZC_WAIT &&
+                    tcp_op_data->zc_acked == tcp_op_data->zc_count)
+                {
+                    op_list_remove(op);
+                    op->error_code = 0;
+                    tcp_op_complete(op);
+                }
+            }
+        }
+    }
+
+    if (ret < 0)
+    {
+        ret = bmi_tcp_errno_to_pvfs(-errno);
+        tcp_forget_addr(map, 0, ret);
+        return (ret);
+    }
+
+    return (reaped);
+}
+#endif
+
+
 static void bmi_set_sock_buffers(int socket)
 {
     /* Set socket buffer sizes */
@@ -25,6 +25,12 @@
 #include <sys/poll.h>
 #include <sys/uio.h>
 #include <assert.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
 
 #include "sockio.h"
 #include "gossip.h"
@@ -322,25 +328,33 @@ int BMI_sockio_nbvector(int s,
  * We are going to set the non-block flag on the socket, but leave the
  * file as is.
  *
- * Boy, that type on the offset for sockfile() sure is lame, isn't it?
- * That's going to cause us some headaches when we want to do 64-bit
- * I/O...
+ * sendfile() does not take send flags, so the caller must ignore
+ * SIGPIPE itself.  *eof is set if the end of the file was reached
+ * before len bytes could be sent.
  *
  * Returns -1 on error, amount of data written to socket on success.
  */
 int BMI_sockio_nbsendfile(int s,
 	       int f,
-	       int off,
-	       int len)
+	       off_t off,
+	       int len,
+	       int *eof)
 {
-    int ret, comp = len, myoff;
+    int ret, comp = len;
+    off_t myoff;
 
+    *eof = 0;
     while (comp)
     {
       nbsendfile_restart:
 	myoff = off;
 	ret = sendfile(s, f, &myoff, comp);
-	if (ret == 0 || (ret == -1 && errno == EWOULDBLOCK))
+	if (ret == 0)
+	{
+	    *eof = 1;
+	    return (len - comp);
+	}
+	if (ret == -1 && errno == EWOULDBLOCK)
 	    return (len - comp);	/* return amount completed */
 	if (ret == -1 && errno == EINTR)
 	{
@@ -355,6 +369,109 @@ int BMI_sockio_nbsendfile(int s,
 }
 #endif
 
+#ifdef __USE_ZEROCOPY__
+/* BMI_sockio_nbvector_zc()
+ *
+ * nonblocking vector send that asks the kernel to transmit straight out
+ * of the caller's pages.  Each call that moves data consumes one
+ * notification sequence number on the socket, reported through
+ * BMI_sockio_zc_notification() once the pages are no longer needed;
+ * *zc_flag is set when that happened.  Falls back to a plain copy when
+ * the kernel is out of memory for pinning pages.  Gives up after one
+ * call, like BMI_sockio_nbvector().
+ *
+ * returns amount of data written on success, 0 if it would block, -1
+ * on failure
+ */
+int BMI_sockio_nbvector_zc(int s,
+	    struct iovec* vector,
+	    int count,
+	    int *zc_flag)
+{
+    struct msghdr msg;
+    int ret;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = vector;
+    msg.msg_iovlen = count;
+
+    *zc_flag = 1;
+    do
+    {
+	ret = sendmsg(s, &msg, (MSG_ZEROCOPY|DEFAULT_MSG_FLAGS));
+	if(ret == -1 && errno == ENOBUFS)
+	{
+	    *zc_flag = 0;
+	    ret = sendmsg(s, &msg, DEFAULT_MSG_FLAGS);
+	}
+    }while(ret == -1 && errno == EINTR);
+
+    if(ret <= 0)
+    {
+	*zc_flag = 0;
+    }
+    if(ret == -1 && errno == EWOULDBLOCK)
+	return(0);
+
+    return(ret);
+}
+
+/* BMI_sockio_zc_notification()
+ *
+ * pulls one message off the socket error queue.  Zero copy completions
+ * cover the inclusive range of send sequence numbers [*first, *last].
+ *
+ * returns 1 if a completion was found, 0 if the queue is empty, -1 with
+ * errno set if the queue held a real error
+ */
+int BMI_sockio_zc_notification(int s,
+	    uint32_t *first,
+	    uint32_t *last)
+{
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct sock_extended_err *serr;
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    int ret;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    do
+    {
+	ret = recvmsg(s, &msg, (MSG_ERRQUEUE|MSG_DONTWAIT));
+    }while(ret == -1 && errno == EINTR);
+
+    if(ret == -1)
+    {
+	if(errno == EAGAIN || errno == EWOULDBLOCK)
+	    return(0);
+	return(-1);
+    }
+
+    for(cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+    {
+	if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+	    continue;
+
+	serr = (struct sock_extended_err *) CMSG_DATA(cm);
+	if(serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+	{
+	    errno = serr->ee_errno ? serr->ee_errno : EPROTO;
+	    return(-1);
+	}
+	*first = serr->ee_info;
+	*last = serr->ee_data;
+	return(1);
+    }
+
+    errno = EPROTO;
+    return(-1);
+}
+#endif
+
 /* routines to get and set socket options */
 int BMI_sockio_get_sockopt(int s,
 		int optname)
@@ -17,11 +17,19 @@
  * makes the BMI_sockio_nbsendfile function available to the application.
  * Older glibc systems do not have this functionality so we leave it to
  * be turned on manually.
+ *
+ * __USE_ZEROCOPY__ is defined when the platform supports MSG_ZEROCOPY
+ * sends and makes BMI_sockio_nbvector_zc and BMI_sockio_zc_notification
+ * available.
  */
 
 #ifndef SOCKIO_H
 #define SOCKIO_H
 
+#if defined(HAVE_SYS_SENDFILE_H) && !defined(__USE_SENDFILE__)
+#define __USE_SENDFILE__
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -29,6 +37,11 @@
 
 #include "bmi-types.h"
 
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && \
+    defined(MSG_ZEROCOPY) && !defined(__USE_ZEROCOPY__)
+#define __USE_ZEROCOPY__
+#endif
+
 int BMI_sockio_new_sock(void);
 int BMI_sockio_bind_sock(int,
 			 int);
@@ -65,8 +78,18 @@ int BMI_sockio_nbpeek(int s,
 #ifdef __USE_SENDFILE__
 int BMI_sockio_nbsendfile(int s,
 			  int f,
-			  int off,
-			  int len);
+			  off_t off,
+			  int len,
+			  int *eof);
+#endif
+#ifdef __USE_ZEROCOPY__
+int BMI_sockio_nbvector_zc(int s,
+			   struct iovec* vector,
+			   int count,
+			   int *zc_flag);
+int BMI_sockio_zc_notification(int s,
+			       uint32_t *first,
+			       uint32_t *last);
 #endif
 
 #define GET_RECVBUFSIZE(s) BMI_sockio_get_sockopt(s, SO_RCVBUF)
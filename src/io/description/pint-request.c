@@ -13,6 +13,13 @@
 #include <pint-request.h>
 #include <pint-distribution.h>
 #include "pvfs2-internal.h"
+#include "gen-locks.h"
+#include "quickhash.h"
+#include "quicklist.h"
+#ifdef __PVFS2_SERVER__
+#include "pint-perf-counter.h"
+#include "pvfs2-mgmt.h"
+#endif
 
 #ifdef WIN32
 typedef uint32_t u_int32_t;
@@ -20,6 +27,109 @@ typedef uint32_t u_int32_t;
 
 static PVFS_offset PINT_request_disp(PINT_Request *request);
 
+/* deepest request the compiled path will handle */
+#define PINT_PLAN_MAX_LEVELS 8
+
+/* one level of the request stack of a compiled request */
+typedef struct PINT_plan_level {
+	PINT_Request *rq;         /* the (only) record at this level */
+	int64_t      maxel;       /* number of elements at this level */
+	PVFS_size    extent;      /* distance between elements */
+	PVFS_offset  offset;      /* offset of the record */
+	int32_t      num_blocks;  /* number of blocks */
+	PVFS_size    stride;      /* stride between blocks */
+} PINT_plan_level;
+
+/* A request whose every level is a single record (no sequence chain)
+ * walks as nested (count, stride) loops ending in contiguous chunks of
+ * one fixed size.  Compiling it down to those loops lets the chunks be
+ * computed instead of searched for, and lets runs of chunks that this
+ * server holds no data for be stepped over in one go.
+ */
+typedef struct PINT_request_plan {
+	int32_t      levels;      /* levels in use, leaf is levels - 1 */
+	int32_t      leaf_whole;  /* leaf covers all of its elements at once */
+	PVFS_size    leaf_size;   /* bytes in each contiguous chunk */
+	PVFS_offset  leaf_disp;   /* displacement of the leaf record */
+	PINT_plan_level lvl[PINT_PLAN_MAX_LEVELS];
+} PINT_request_plan;
+
+static int PINT_request_plan_compile(PINT_Request_state *req,
+		PINT_request_plan *plan);
+static int PINT_process_request_plan(PINT_Request_state *req,
+		PINT_Request_state *mem,
+		PINT_request_file_data *rfdata,
+		PINT_Request_result *result,
+		int mode,
+		PINT_request_plan *plan);
+
+/* internal mode: memreq processing that records every contiguous chunk
+ * as its own segment instead of combining adjacent ones
+ */
+#define PINT_FLATTEN               001000
+#define PINT_IS_FLATTEN(x)         ((x) & PINT_FLATTEN)
+
+/* limits of the cache of flattened requests */
+#define PINT_FLAT_MAX_RECORDS  128     /* request records in a key */
+#define PINT_FLAT_MAX_CHUNKS   4096    /* chunks in one tile */
+#define PINT_FLAT_MAX_ENTRIES  64      /* requests cached */
+#define PINT_FLAT_MAX_TOTAL    65536   /* chunks cached over all requests */
+#define PINT_FLAT_TABLE_SIZE   61
+
+/* words of key describing one request record */
+#define PINT_FLAT_KEY_WORDS    10
+
+/* Any request can be flattened into the list of contiguous chunks that
+ * the walk in PINT_process_request produces for one tile of it; the
+ * walk repeats that list, shifted by the extent, for every further
+ * tile.  Flattened requests are cached by content, so that the states
+ * of every later request with the same layout - the same file view
+ * reissued by an application, or the same request arriving at the
+ * server again - step through the list instead of walking the tree.
+ * Requests that are contiguous at the top, which the walk already
+ * does in one step, or that have more than PINT_FLAT_MAX_CHUNKS chunks
+ * are not looked up at all; any other request that turns out not to
+ * flatten is cached with a count of 0 so that it is not tried again.
+ */
+typedef struct PINT_request_flat {
+	struct qhash_head hash_link;
+	struct qlist_head lru_link;
+	uint64_t     hash;        /* hash of key */
+	int32_t      key_len;     /* words in key */
+	int64_t      *key;        /* the request records, in walk order */
+	int32_t      refcount;    /* states using this, plus 1 while cached */
+	int32_t      count;       /* chunks in a tile, 0 if not flattened */
+	PVFS_size    extent;      /* distance between tiles */
+	PVFS_size    tile_bytes;  /* bytes in a tile */
+	PVFS_offset  *offset;     /* chunk offsets within a tile */
+	PVFS_size    *size;       /* chunk sizes */
+} PINT_request_flat;
+
+struct PINT_flat_key
+{
+	uint64_t     hash;
+	int32_t      key_len;
+	int64_t      *key;
+};
+
+static gen_mutex_t flat_mutex = GEN_MUTEX_INITIALIZER;
+static struct qhash_table *flat_table = NULL;
+static QLIST_HEAD(flat_lru);
+static int flat_entries = 0;
+static int flat_chunks = 0;
+static int64_t flat_hits = 0;
+static int64_t flat_misses = 0;
+
+static struct PINT_Request_state *PINT_request_states_alloc(
+		PINT_Request *request, int n);
+static PINT_request_flat *PINT_request_flat_get(PINT_Request *request);
+static void PINT_request_flat_put(PINT_request_flat *flat);
+static int PINT_process_request_flat(PINT_Request_state *req,
+		PINT_Request_state *mem,
+		PINT_request_file_data *rfdata,
+		PINT_Request_result *result,
+		int mode);
+
 /* this macro is only used in this file to add a segment to the
  * result list.
  */
@@ -78,6 +188,8 @@ int PINT_process_request(PINT_Request_state *req,
 	PVFS_offset  contig_offset = 0; /* temp for offset of a contig region */
 	PVFS_size    contig_size;   /* temp for size of a contig region */
 	PVFS_size    retval;        /* return value from calls to distribute */
+	PINT_request_plan plan;     /* compiled form of a strided request */
+	int          ret;
 
 	if (!PINT_IS_MEMREQ(mode))
         gossip_debug(GOSSIP_REQUEST_DEBUG,
@@ -169,6 +281,33 @@ int PINT_process_request(PINT_Request_state *req,
 		/* do we allow external setting of LOGICAL_SKIP */
 		/* what about backwards skipping, as in seeking? */
         }
+
+	/* requests with a cached flattened form are not walked at all */
+	if (req->flat && !PINT_IS_NOPLAN(mode))
+	{
+		ret = PINT_process_request_flat(req, mem, rfdata, result, mode);
+		gossip_debug(GOSSIP_REQUEST_DEBUG,"\tdone (flat) sg %d by %lld "
+				"to %lld fo %lld eof %d\n", result->segs,
+				lld(result->bytes), lld(req->type_offset),
+				lld(req->final_offset), req->eof_flag);
+		free(temp_space);
+		return ret;
+	}
+
+	/* regular strided requests on the server have a compiled path */
+	if ((mode & ~PINT_LOGICAL_SKIP) == PINT_SERVER &&
+			PINT_request_plan_compile(req, &plan) == 0 &&
+			PINT_process_request_plan(req, mem, rfdata, result, mode,
+				&plan) == 0)
+	{
+		gossip_debug(GOSSIP_REQUEST_DEBUG,"\tdone (plan) sg %d by %lld "
+				"to %lld fo %lld eof %d\n", result->segs,
+				lld(result->bytes), lld(req->type_offset),
+				lld(req->final_offset), req->eof_flag);
+		gossip_debug(GOSSIP_REQUEST_DEBUG,
+				"=========================================================\n");
+		return 0;
+	}
 	
 	/* we should be ready to begin */
 	/* zero retval indicates everything flowing successfully */
@@ -315,7 +454,18 @@ int PINT_process_request(PINT_Request_state *req,
 				{
 					sz = result->bytemax - result->bytes;
 				}
-				PINT_ADD_SEGMENT(result, contig_offset, sz, mode);
+				if (PINT_IS_FLATTEN(mode))
+				{
+					/* record the chunk as the walk found it */
+					result->offset_array[result->segs] = contig_offset;
+					result->size_array[result->segs] = sz;
+					result->segs++;
+					result->bytes += sz;
+				}
+				else
+				{
+					PINT_ADD_SEGMENT(result, contig_offset, sz, mode);
+				}
 				retval = sz;
 			}
 			else
@@ -434,6 +584,834 @@ int PINT_process_request(PINT_Request_state *req,
 	return 0;
 }
 
+/* Function: PINT_request_plan_compile
+ * Objective: reduce the request being processed by req to nested
+ * (count, stride) loops, following exactly the decisions the walk in
+ * PINT_process_request makes at each level.
+ * Returns 0 if the request compiled, -1 if it has to be walked.
+ */
+static int PINT_request_plan_compile(PINT_Request_state *req,
+		PINT_request_plan *plan)
+{
+	PINT_Request *rq = req->cur[0].rqbase;
+	PINT_plan_level *lp;
+	int32_t l;
+
+	if (!rq || req->cur[0].rq == NULL)
+	{
+		return -1;
+	}
+	for (l = 0; l < PINT_PLAN_MAX_LEVELS && l < req->cur[0].rqbase->depth; l++)
+	{
+		if (rq->sreq || rq->num_blocks < 1)
+		{
+			return -1;
+		}
+		lp = &plan->lvl[l];
+		lp->rq = rq;
+		lp->maxel = l ? plan->lvl[l-1].rq->num_ereqs : req->cur[0].maxel;
+		lp->extent = rq->ub - rq->lb;
+		lp->offset = rq->offset;
+		lp->num_blocks = rq->num_blocks;
+		lp->stride = rq->stride;
+		if (lp->maxel < 1)
+		{
+			return -1;
+		}
+		plan->levels = l + 1;
+		plan->leaf_disp = PINT_request_disp(rq);
+		/* basic type or contiguous data */
+		if (rq->ereq == NULL || (rq->aggregate_size == lp->extent &&
+					rq->ereq->num_contig_chunks == 1))
+		{
+			/* at the top the walk already does this in one step */
+			plan->leaf_whole = 1;
+			plan->leaf_size = lp->maxel * rq->aggregate_size;
+			return (l == 0 || plan->leaf_size <= 0) ? -1 : 0;
+		}
+		/* subtype is contiguous */
+		if (rq->ereq->aggregate_size == (rq->ereq->ub - rq->ereq->lb) &&
+				rq->ereq->num_contig_chunks == 1)
+		{
+			plan->leaf_whole = 0;
+			plan->leaf_size = rq->ereq->aggregate_size * rq->num_ereqs;
+			return (plan->leaf_size <= 0) ? -1 : 0;
+		}
+		rq = rq->ereq;
+	}
+	return -1;
+}
+
+/* Function: PINT_process_request_plan
+ * Objective: PINT_process_request for a compiled request in server mode.
+ * Produces the same segments and leaves req in the same state as the
+ * tree walk would (descended to the leaf rather than parked on an upper
+ * level, which the walk treats the same).
+ * Returns 0 on success, -1 without touching anything if req is not in a
+ * state this path understands.
+ */
+static int PINT_process_request_plan(PINT_Request_state *req,
+		PINT_Request_state *mem,
+		PINT_request_file_data *rfdata,
+		PINT_Request_result *result,
+		int mode,
+		PINT_request_plan *plan)
+{
+	int64_t      el[PINT_PLAN_MAX_LEVELS];
+	int32_t      blk[PINT_PLAN_MAX_LEVELS];
+	PVFS_offset  co[PINT_PLAN_MAX_LEVELS];  /* chunk_offset per level */
+	int32_t      leaf = plan->levels - 1;
+	PINT_plan_level *lp;
+	PVFS_offset  contig_offset, loff;
+	PVFS_size    contig_size, sz, retval, before;
+	int64_t      n;
+	int          probe = 1;  /* last chunk gave this server nothing */
+	int          done = 0;
+	int32_t      l;
+
+	/* pick up the walk's position; anything unexpected goes back to it */
+	if (req->lvl > leaf || (req->lvl < leaf && req->bytes))
+	{
+		return -1;
+	}
+	co[0] = req->cur[0].chunk_offset;
+	for (l = 0; l <= leaf; l++)
+	{
+		lp = &plan->lvl[l];
+		if (l > req->lvl)
+		{
+			el[l] = 0;
+			blk[l] = 0;
+		}
+		else if (req->cur[l].rq != lp->rq || req->cur[l].rqbase != lp->rq ||
+				req->cur[l].el < 0 || req->cur[l].el >= lp->maxel ||
+				req->cur[l].blk < 0 || req->cur[l].blk >= lp->num_blocks ||
+				(l > 0 && (req->cur[l].maxel != lp->maxel ||
+					req->cur[l].chunk_offset != co[l])))
+		{
+			return -1;
+		}
+		else
+		{
+			el[l] = req->cur[l].el;
+			blk[l] = req->cur[l].blk;
+		}
+		if (l < leaf)
+		{
+			co[l+1] = co[l] + el[l] * lp->extent + lp->offset +
+				lp->stride * blk[l];
+		}
+	}
+	if (plan->leaf_whole && (el[leaf] || blk[leaf]))
+	{
+		return -1;
+	}
+
+	lp = &plan->lvl[leaf];
+	while (!done)
+	{
+		contig_offset = co[leaf] + lp->offset + req->bytes + plan->leaf_disp;
+		if (!plan->leaf_whole)
+		{
+			contig_offset += el[leaf] * lp->extent + lp->stride * blk[leaf];
+		}
+		contig_size = plan->leaf_size - req->bytes;
+
+		/* step over whole chunks at once where the outcome is known:
+		 * everything but the last of them is accounted for here and the
+		 * last one goes through the normal path, which sets eof_flag
+		 */
+		n = 0;
+		if (!plan->leaf_whole && req->bytes == 0)
+		{
+			if (PINT_IS_LOGICAL_SKIP(mode))
+			{
+				/* chunks ending before the target offset */
+				n = (req->target_offset - req->type_offset - 1) /
+					plan->leaf_size;
+			}
+			else if (probe && lp->stride > 0 && rfdata && rfdata->dist &&
+					rfdata->dist->methods && rfdata->dist->params)
+			{
+				/* chunks holding no data on this server */
+				loff = (*rfdata->dist->methods->next_mapped_offset)(
+						rfdata->dist->params, rfdata, contig_offset);
+				if (loff != -1 && loff >= contig_offset + contig_size)
+				{
+					n = (loff - contig_offset - contig_size) / lp->stride + 1;
+				}
+			}
+			/* stay within this run of blocks and short of final_offset */
+			if (n > lp->num_blocks - blk[leaf])
+			{
+				n = lp->num_blocks - blk[leaf];
+			}
+			if (n > (req->final_offset - req->type_offset) / plan->leaf_size)
+			{
+				n = (req->final_offset - req->type_offset) / plan->leaf_size;
+			}
+			if (n > 1)
+			{
+				req->type_offset += (n - 1) * plan->leaf_size;
+				blk[leaf] += n - 1;
+				contig_offset += (n - 1) * lp->stride;
+			}
+		}
+
+		if (PINT_IS_LOGICAL_SKIP(mode))
+		{
+			if (req->type_offset + contig_size >= req->target_offset)
+			{
+				retval = req->target_offset - req->type_offset;
+			}
+			else
+			{
+				retval = contig_size;
+			}
+			req->eof_flag = (rfdata->fsize <= req->type_offset) &&
+				!(rfdata->extend_flag);
+		}
+		else
+		{
+			sz = contig_size;
+			if (req->type_offset + sz > req->final_offset)
+			{
+				sz = req->final_offset - req->type_offset;
+			}
+			before = result->bytes;
+			retval = PINT_distribute(contig_offset, sz, rfdata, mem, result,
+					&req->eof_flag, mode);
+			if (-1 == retval)
+			{
+				gossip_debug(GOSSIP_REQUEST_DEBUG,
+						"\tDistribute returned -1\n");
+				req->type_offset = req->final_offset;
+				result->segs = 0;
+				result->bytes = 0;
+				break;
+			}
+			probe = (result->bytes == before);
+		}
+		req->type_offset += retval;
+		if (retval != contig_size)
+		{
+			req->bytes += retval;
+			if (PINT_IS_LOGICAL_SKIP(mode))
+			{
+				PINT_CLR_LOGICAL_SKIP(mode);
+				continue;
+			}
+			break;
+		}
+
+		/* chunk done, move to the next one */
+		req->bytes = 0;
+		for (l = plan->leaf_whole ? leaf - 1 : leaf; l >= 0; l--)
+		{
+			if (++blk[l] < plan->lvl[l].num_blocks)
+			{
+				break;
+			}
+			blk[l] = 0;
+			if (++el[l] < plan->lvl[l].maxel)
+			{
+				break;
+			}
+			el[l] = 0;
+		}
+		if (l < 0)
+		{
+			/* we have processed the entire request */
+			done = 1;
+			break;
+		}
+		for (l++; l <= leaf; l++)
+		{
+			el[l] = 0;
+			blk[l] = 0;
+			co[l] = co[l-1] + el[l-1] * plan->lvl[l-1].extent +
+				plan->lvl[l-1].offset + plan->lvl[l-1].stride * blk[l-1];
+		}
+		if (result->bytes == result->bytemax ||
+				(!PINT_IS_CKSIZE(mode) && (result->segs == result->segmax)))
+		{
+			break;
+		}
+		if (req->type_offset >= req->final_offset)
+		{
+			break;
+		}
+	}
+
+	/* hand the position back in the walk's terms */
+	if (done)
+	{
+		req->lvl = -1;
+		return 0;
+	}
+	req->lvl = leaf;
+	for (l = 0; l <= leaf; l++)
+	{
+		req->cur[l].el = el[l];
+		req->cur[l].blk = blk[l];
+		req->cur[l].rq = plan->lvl[l].rq;
+		req->cur[l].rqbase = plan->lvl[l].rq;
+		req->cur[l].chunk_offset = co[l];
+		if (l > 0)
+		{
+			req->cur[l].maxel = plan->lvl[l].maxel;
+		}
+	}
+	return 0;
+}
+
+/* Function: PINT_process_request_flat
+ * Objective: PINT_process_request for a request with a cached flattened
+ * form.  Steps through the chunk list of the current tile instead of
+ * walking the request, producing the same segments and leaving the same
+ * type_offset and eof_flag as the walk.  The position is kept as tile
+ * (cur[0].el), chunk (cur[0].blk) and bytes into the chunk, which
+ * PINT_REQUEST_STATE_RST clears like the walk's own.
+ * Returns 0 on success.
+ */
+static int PINT_process_request_flat(PINT_Request_state *req,
+		PINT_Request_state *mem,
+		PINT_request_file_data *rfdata,
+		PINT_Request_result *result,
+		int mode)
+{
+	PINT_request_flat *flat = req->flat;
+	int64_t      t = req->cur[0].el;
+	int32_t      i = req->cur[0].blk;
+	int32_t      j;
+	PVFS_offset  base, contig_offset, loff, o;
+	PVFS_size    contig_size, sz, retval, before, skip;
+	int64_t      n;
+	int          probe = 1;  /* last chunk gave this server nothing */
+	int          done = 0;
+
+	base = req->cur[0].chunk_offset + t * flat->extent;
+	while (1)
+	{
+		contig_offset = base + flat->offset[i] + req->bytes;
+		contig_size = flat->size[i] - req->bytes;
+
+		/* step over chunks whose outcome is known: all but the last of
+		 * them are accounted for here and the last one goes through
+		 * the normal path, which sets eof_flag
+		 */
+		if (req->bytes == 0 && PINT_IS_LOGICAL_SKIP(mode) && i == 0)
+		{
+			/* whole tiles ending before the target offset */
+			n = (req->target_offset - req->type_offset - 1) /
+				flat->tile_bytes;
+			if (n > req->cur[0].maxel - 1 - t)
+			{
+				n = req->cur[0].maxel - 1 - t;
+			}
+			if (n > (req->final_offset - req->type_offset - 1) /
+					flat->tile_bytes)
+			{
+				n = (req->final_offset - req->type_offset - 1) /
+					flat->tile_bytes;
+			}
+			if (n > 0)
+			{
+				t += n;
+				req->type_offset += n * flat->tile_bytes;
+				base += n * flat->extent;
+				contig_offset += n * flat->extent;
+			}
+		}
+		else if (req->bytes == 0 && probe && !PINT_IS_LOGICAL_SKIP(mode) &&
+				!PINT_IS_MEMREQ(mode) && rfdata && rfdata->dist &&
+				rfdata->dist->methods && rfdata->dist->params)
+		{
+			/* chunks lying where this server holds no data */
+			loff = (*rfdata->dist->methods->next_mapped_offset)(
+					rfdata->dist->params, rfdata, contig_offset);
+			skip = 0;
+			for (j = i; j < flat->count; j++)
+			{
+				o = base + flat->offset[j];
+				if (loff == -1 || o < contig_offset ||
+						o + flat->size[j] > loff ||
+						req->type_offset + skip + flat->size[j] >=
+						req->final_offset)
+				{
+					break;
+				}
+				skip += flat->size[j];
+			}
+			if (j - i > 1)
+			{
+				skip -= flat->size[j - 1];
+				req->type_offset += skip;
+				i = j - 1;
+				contig_offset = base + flat->offset[i];
+				contig_size = flat->size[i];
+			}
+		}
+
+		if (PINT_IS_CLIENT(mode))
+		{
+			result->offset_array[result->segs] =
+				req->type_offset - req->target_offset;
+		}
+		if (PINT_IS_LOGICAL_SKIP(mode))
+		{
+			if (req->type_offset + contig_size >= req->target_offset)
+			{
+				retval = req->target_offset - req->type_offset;
+			}
+			else
+			{
+				retval = contig_size;
+			}
+			req->eof_flag = (rfdata->fsize <= req->type_offset) &&
+				!(rfdata->extend_flag);
+		}
+		else
+		{
+			sz = contig_size;
+			if (req->type_offset + sz > req->final_offset)
+			{
+				sz = req->final_offset - req->type_offset;
+			}
+			if (PINT_IS_MEMREQ(mode))
+			{
+				if (result->bytes + sz >= result->bytemax )
+				{
+					sz = result->bytemax - result->bytes;
+				}
+				PINT_ADD_SEGMENT(result, contig_offset, sz, mode);
+				retval = sz;
+			}
+			else
+			{
+				before = result->bytes;
+				retval = PINT_distribute(contig_offset, sz, rfdata, mem,
+						result, &req->eof_flag, mode);
+				if (-1 == retval)
+				{
+					gossip_debug(GOSSIP_REQUEST_DEBUG,
+							"\tDistribute returned -1\n");
+					req->type_offset = req->final_offset;
+					result->segs = 0;
+					result->bytes = 0;
+					break;
+				}
+				probe = (result->bytes == before);
+			}
+		}
+		req->type_offset += retval;
+		if (retval != contig_size)
+		{
+			req->bytes += retval;
+			if (PINT_IS_LOGICAL_SKIP(mode))
+			{
+				PINT_CLR_LOGICAL_SKIP(mode);
+				continue;
+			}
+			break;
+		}
+
+		/* chunk done, move to the next one */
+		req->bytes = 0;
+		if (++i >= flat->count)
+		{
+			i = 0;
+			if (++t >= req->cur[0].maxel)
+			{
+				/* we have processed the entire request */
+				done = 1;
+				break;
+			}
+			base += flat->extent;
+		}
+		if (result->bytes == result->bytemax ||
+				(!PINT_IS_CKSIZE(mode) && (result->segs == result->segmax)))
+		{
+			break;
+		}
+		if (req->type_offset >= req->final_offset)
+		{
+			break;
+		}
+	}
+
+	if (done)
+	{
+		req->lvl = -1;
+		return 0;
+	}
+	req->lvl = 0;
+	req->cur[0].el = t;
+	req->cur[0].blk = i;
+	return 0;
+}
+
+/* hashes a request record by record in the order the walk visits
+ * them; returns the number of words used, or -1 if the request has
+ * more than PINT_FLAT_MAX_RECORDS records
+ */
+static int PINT_request_flat_key(PINT_Request *rq, int64_t *key, int len)
+{
+	for (; rq; rq = rq->sreq)
+	{
+		if (len + PINT_FLAT_KEY_WORDS >
+				PINT_FLAT_MAX_RECORDS * PINT_FLAT_KEY_WORDS)
+		{
+			return -1;
+		}
+		key[len++] = rq->offset;
+		key[len++] = rq->num_ereqs;
+		key[len++] = rq->num_blocks;
+		key[len++] = rq->stride;
+		key[len++] = rq->ub;
+		key[len++] = rq->lb;
+		key[len++] = rq->aggregate_size;
+		key[len++] = rq->num_contig_chunks;
+		key[len++] = rq->depth;
+		key[len++] = (rq->ereq ? 1 : 0) | (rq->sreq ? 2 : 0);
+		if (rq->ereq)
+		{
+			len = PINT_request_flat_key(rq->ereq, key, len);
+			if (len < 0)
+			{
+				return -1;
+			}
+		}
+	}
+	return len;
+}
+
+static int PINT_request_flat_hash(const void *key, int table_size)
+{
+	const struct PINT_flat_key *k = key;
+
+	return (int)(k->hash % table_size);
+}
+
+static int PINT_request_flat_compare(const void *key,
+		struct qhash_head *link)
+{
+	const struct PINT_flat_key *k = key;
+	PINT_request_flat *flat =
+		qhash_entry(link, PINT_request_flat, hash_link);
+
+	return (flat->hash == k->hash && flat->key_len == k->key_len &&
+			!memcmp(flat->key, k->key, k->key_len * sizeof(int64_t)));
+}
+
+/* Function: PINT_request_flatten
+ * Objective: run the walk over one tile of request in memreq mode,
+ * which records its chunks without distributing them, and keep them
+ * with a copy of the key.
+ * Returns the new entry, with a count of 0 if the request is not worth
+ * or not safe to flatten, or NULL if out of memory.
+ */
+static PINT_request_flat *PINT_request_flatten(PINT_Request *request,
+		struct PINT_flat_key *k)
+{
+	PINT_request_flat *flat;
+	PINT_Request_state *state;
+	PINT_Request_result result;
+	PVFS_offset *offsets;
+	PVFS_size *sizes;
+	int32_t count = 0;
+	int32_t i;
+	int ret;
+
+	offsets = malloc((PINT_FLAT_MAX_CHUNKS + 1) *
+			(sizeof(PVFS_offset) + sizeof(PVFS_size)));
+	if (!offsets)
+	{
+		return NULL;
+	}
+	sizes = (PVFS_size *)(offsets + PINT_FLAT_MAX_CHUNKS + 1);
+
+	/* at the top the walk handles contiguous requests in one step */
+	if (request->aggregate_size > 0 && request->ub > request->lb &&
+			!(request->ereq == NULL ||
+			(request->aggregate_size == request->ub - request->lb &&
+			request->ereq->num_contig_chunks == 1)))
+	{
+		state = PINT_request_states_alloc(request, 1);
+		if (state)
+		{
+			result.offset_array = offsets;
+			result.size_array = sizes;
+			result.segmax = PINT_FLAT_MAX_CHUNKS + 1;
+			result.segs = 0;
+			result.bytemax = request->aggregate_size + 1;
+			result.bytes = 0;
+			ret = PINT_process_request(state, NULL, NULL, &result,
+					PINT_MEMREQ | PINT_FLATTEN);
+			if (ret == 0 && state->lvl < 0 &&
+					result.segs <= PINT_FLAT_MAX_CHUNKS &&
+					result.bytes == request->aggregate_size)
+			{
+				count = result.segs;
+			}
+			free(state);
+		}
+	}
+	for (i = 0; i < count; i++)
+	{
+		if (sizes[i] <= 0)
+		{
+			count = 0;
+		}
+	}
+
+	flat = malloc(sizeof(*flat) + k->key_len * sizeof(int64_t) +
+			count * (sizeof(PVFS_offset) + sizeof(PVFS_size)));
+	if (!flat)
+	{
+		free(offsets);
+		return NULL;
+	}
+	flat->hash = k->hash;
+	flat->key_len = k->key_len;
+	flat->key = (int64_t *)(flat + 1);
+	memcpy(flat->key, k->key, k->key_len * sizeof(int64_t));
+	flat->refcount = 1;
+	flat->count = count;
+	flat->extent = request->ub - request->lb;
+	flat->tile_bytes = request->aggregate_size;
+	flat->offset = (PVFS_offset *)(flat->key + k->key_len);
+	flat->size = (PVFS_size *)(flat->offset + count);
+	memcpy(flat->offset, offsets, count * sizeof(PVFS_offset));
+	memcpy(flat->size, sizes, count * sizeof(PVFS_size));
+	free(offsets);
+	gossip_debug(GOSSIP_REQUEST_DEBUG, "%s: %d chunks of %lld bytes\n",
+			__func__, count, lld(flat->tile_bytes));
+	return flat;
+}
+
+/* drops the least recently used entries until there is room for
+ * chunks more; called with flat_mutex held
+ */
+static void PINT_request_flat_evict(int chunks)
+{
+	PINT_request_flat *flat;
+
+	while (!qlist_empty(&flat_lru) &&
+			(flat_entries >= PINT_FLAT_MAX_ENTRIES ||
+			 flat_chunks + chunks > PINT_FLAT_MAX_TOTAL))
+	{
+		flat = qlist_entry(flat_lru.prev, PINT_request_flat, lru_link);
+		qlist_del(&flat->lru_link);
+		qhash_del(&flat->hash_link);
+		flat_entries--;
+		flat_chunks -= flat->count;
+		if (--flat->refcount == 0)
+		{
+			free(flat);
+		}
+	}
+}
+
+/* Function: PINT_request_flat_get
+ * Objective: find or build the flattened form of request.
+ * Returns a referenced entry, or NULL if the request has to be walked.
+ */
+static PINT_request_flat *PINT_request_flat_get(PINT_Request *request)
+{
+	int64_t key[PINT_FLAT_MAX_RECORDS * PINT_FLAT_KEY_WORDS];
+	struct PINT_flat_key k;
+	struct qhash_head *link;
+	PINT_request_flat *flat = NULL;
+	PINT_request_flat *built = NULL;
+	uint64_t h[4];
+	int i;
+
+	/* contiguous at the top, or too many chunks to be worth keeping */
+	if (!request || request->ereq == NULL ||
+			(request->aggregate_size == request->ub - request->lb &&
+			 request->ereq->num_contig_chunks == 1) ||
+			request->num_contig_chunks > PINT_FLAT_MAX_CHUNKS)
+	{
+		return NULL;
+	}
+	k.key_len = PINT_request_flat_key(request, key, 0);
+	if (k.key_len <= 0)
+	{
+		return NULL;
+	}
+	/* FNV-1a over four interleaved lanes, so long keys hash quickly */
+	h[0] = h[1] = h[2] = h[3] = 14695981039346656037ULL;
+	for (i = 0; i < k.key_len; i++)
+	{
+		h[i & 3] = (h[i & 3] ^ (uint64_t)key[i]) * 1099511628211ULL;
+	}
+	k.hash = h[0] ^ (h[1] * 31) ^ (h[2] * 961) ^ (h[3] * 29791);
+	k.key = key;
+
+	gen_mutex_lock(&flat_mutex);
+	if (!flat_table)
+	{
+		flat_table = qhash_init(PINT_request_flat_compare,
+				PINT_request_flat_hash, PINT_FLAT_TABLE_SIZE);
+		if (!flat_table)
+		{
+			gen_mutex_unlock(&flat_mutex);
+			return NULL;
+		}
+	}
+	link = qhash_search(flat_table, &k);
+	if (link)
+	{
+		flat = qhash_entry(link, PINT_request_flat, hash_link);
+		qlist_del(&flat->lru_link);
+		qlist_add(&flat->lru_link, &flat_lru);
+		if (flat->count > 0)
+		{
+			flat->refcount++;
+			flat_hits++;
+			gen_mutex_unlock(&flat_mutex);
+#ifdef __PVFS2_SERVER__
+			PINT_perf_count(PINT_server_pc, PINT_PERF_REQPLAN_HITS, 1,
+					PINT_PERF_ADD);
+#endif
+			return flat;
+		}
+		flat = NULL;
+	}
+	gen_mutex_unlock(&flat_mutex);
+
+	if (!link)
+	{
+		built = PINT_request_flatten(request, &k);
+	}
+
+	gen_mutex_lock(&flat_mutex);
+	if (built && flat_table)
+	{
+		link = qhash_search(flat_table, &k);
+		if (link)
+		{
+			/* someone else got there first */
+			flat = qhash_entry(link, PINT_request_flat, hash_link);
+			free(built);
+		}
+		else
+		{
+			PINT_request_flat_evict(built->count);
+			flat = built;
+			qhash_add(flat_table, &k, &flat->hash_link);
+			qlist_add(&flat->lru_link, &flat_lru);
+			flat_entries++;
+			flat_chunks += flat->count;
+		}
+	}
+	else
+	{
+		free(built);
+	}
+	if (flat && flat->count > 0)
+	{
+		flat->refcount++;
+	}
+	else
+	{
+		flat = NULL;
+	}
+	flat_misses++;
+	gen_mutex_unlock(&flat_mutex);
+#ifdef __PVFS2_SERVER__
+	PINT_perf_count(PINT_server_pc, PINT_PERF_REQPLAN_MISSES, 1,
+			PINT_PERF_ADD);
+#endif
+	return flat;
+}
+
+static void PINT_request_flat_put(PINT_request_flat *flat)
+{
+	if (flat)
+	{
+		gen_mutex_lock(&flat_mutex);
+		if (--flat->refcount == 0)
+		{
+			free(flat);
+		}
+		gen_mutex_unlock(&flat_mutex);
+	}
+}
+
+/* reports the use of the cache of flattened requests since startup */
+void PINT_request_plan_cache_stats(int64_t *hits, int64_t *misses,
+		int *entries)
+{
+	gen_mutex_lock(&flat_mutex);
+	*hits = flat_hits;
+	*misses = flat_misses;
+	*entries = flat_entries;
+	gen_mutex_unlock(&flat_mutex);
+}
+
+/* empties the cache of flattened requests; entries still in use by a
+ * request state are freed along with the state
+ */
+void PINT_request_plan_cache_finalize(void)
+{
+	gen_mutex_lock(&flat_mutex);
+	PINT_request_flat_evict(PINT_FLAT_MAX_TOTAL + 1);
+	if (flat_table)
+	{
+		qhash_finalize(flat_table);
+		flat_table = NULL;
+	}
+	gen_mutex_unlock(&flat_mutex);
+}
+
+/* Function: PINT_request_file_extent
+ * Objective: find the logical file range [start, end) that bytes
+ * [target_offset, target_offset + size) of a file request can touch.
+ * The request is tiled every (ub - lb) bytes of file, so tile t lies
+ * within [t * (ub - lb) + lb, t * (ub - lb) + ub).  The result is exact
+ * for contiguous requests and a covering range otherwise.
+ * Returns 0 on success, -PVFS_EINVAL if the request has no usable bounds.
+ */
+int PINT_request_file_extent(PINT_Request *request,
+		PVFS_offset target_offset,
+		PVFS_size size,
+		PVFS_offset *start,
+		PVFS_offset *end)
+{
+	PVFS_size extent;
+	PVFS_offset first_tile, last_tile;
+
+	if (!request || request->aggregate_size <= 0 || target_offset < 0 ||
+			size < 0 || request->ub <= request->lb)
+	{
+		return -PVFS_EINVAL;
+	}
+	extent = request->ub - request->lb;
+
+	if (size == 0)
+	{
+		*start = *end = request->lb + target_offset;
+		return 0;
+	}
+
+	/* contiguous: request bytes map straight onto file bytes */
+	if (request->aggregate_size == extent &&
+			request->num_contig_chunks == 1)
+	{
+		*start = request->lb + target_offset;
+		*end = *start + size;
+		return 0;
+	}
+
+	first_tile = target_offset / request->aggregate_size;
+	last_tile = (target_offset + size - 1) / request->aggregate_size;
+	*start = first_tile * extent + request->lb;
+	*end = last_tile * extent + request->ub;
+	return 0;
+}
+
 /* this function runs down the ereq list and adds up the offsets */
 /* present in the request records */
 static PVFS_offset PINT_request_disp(PINT_Request *request)
@@ -455,13 +1433,33 @@ struct PINT_Request_state *PINT_new_request_state(PINT_Request *request)
     return PINT_new_request_states(request, 1);
 }
 
+/* the states of an array share one reference to the flattened request */
 struct PINT_Request_state *PINT_new_request_states(PINT_Request *request, int n)
 {
 	struct PINT_Request_state *reqs;
-	int rqdepth, i;
+	PINT_request_flat *flat;
+	int i;
 
 	gossip_debug(GOSSIP_REQUEST_DEBUG, "%s n=%d\n", __func__, n);
 
+	reqs = PINT_request_states_alloc(request, n);
+	if (reqs)
+	{
+		flat = PINT_request_flat_get(request);
+		for (i = 0; i < n; i++)
+		{
+			reqs[i].flat = flat;
+		}
+	}
+	return reqs;
+}
+
+static struct PINT_Request_state *PINT_request_states_alloc(
+		PINT_Request *request, int n)
+{
+	struct PINT_Request_state *reqs;
+	int rqdepth, i;
+
 	/* we assume null request is a contiguous byte range depth 1 */
     if (request)
     {
@@ -490,6 +1488,7 @@ struct PINT_Request_state *PINT_new_request_states(PINT_Request *request, int n)
         reqs[i].target_offset = 0;
         reqs[i].final_offset = request->aggregate_size;
         reqs[i].eof_flag = 0;
+        reqs[i].flat = NULL;
 
         reqs[i].cur[0].maxel = 1; /* transfer one instance of request */
         reqs[i].cur[0].el = 0;
@@ -505,11 +1504,19 @@ struct PINT_Request_state *PINT_new_request_states(PINT_Request *request, int n)
 /* This function frees request state structures */
 void PINT_free_request_state(PINT_Request_state *req)
 {
+	if (req)
+	{
+		PINT_request_flat_put(req->flat);
+	}
 	free(req);
 }
 
 void PINT_free_request_states(PINT_Request_state *reqs)
 {
+	if (reqs)
+	{
+		PINT_request_flat_put(reqs[0].flat);
+	}
 	free(reqs);
 }
 
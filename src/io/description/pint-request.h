@@ -12,6 +12,7 @@
 
 /* Forward declarations */
 struct PINT_dist_s;
+struct PINT_request_flat;
 
 /* modes for PINT_Process_request  and PINT_distribute */
 #define PINT_SERVER                000001
@@ -23,6 +24,7 @@ struct PINT_dist_s;
 #define PINT_CKSIZE_LOGICAL_SKIP   000024
 #define PINT_SEEKING               000040
 #define PINT_MEMREQ                000100
+#define PINT_NOPLAN                000200
 
 #define PINT_IS_SERVER(x)          ((x) & PINT_SERVER)
 #define PINT_EQ_SERVER(x)          ((x) == PINT_SERVER)
@@ -36,6 +38,7 @@ struct PINT_dist_s;
 #define PINT_EQ_SEEKING(x)         ((x) == PINT_SEEKING)
 #define PINT_IS_MEMREQ(x)          ((x) & PINT_MEMREQ)
 #define PINT_EQ_MEMREQ(x)          ((x) == PINT_MEMREQ)
+#define PINT_IS_NOPLAN(x)          ((x) & PINT_NOPLAN)
 #define PINT_SET_SEEKING(x)        ((x) |= PINT_SEEKING)
 #define PINT_CLR_SEEKING(x)        ((x) &= ~(PINT_SEEKING))
 #define PINT_SET_LOGICAL_SKIP(x)   ((x) |= PINT_LOGICAL_SKIP)
@@ -85,6 +88,7 @@ typedef struct PINT_Request_state {
 	PVFS_offset  target_offset;/* first type offset to process */
 	PVFS_offset  final_offset; /* last type offset to process */
 	PVFS_boolean eof_flag;     /* is file at end of flile */
+	struct PINT_request_flat *flat; /* cached flattened request or NULL */
 } PINT_Request_state;           
 /* NOTE - I think buf_offset is superceded by type_offset
  * and start_offset can be completely replced with last_offset
@@ -115,6 +119,11 @@ struct PINT_Request_state *PINT_new_request_states(PINT_Request *request,
                                                    int n);
 void PINT_free_request_states(PINT_Request_state *reqs);
 
+/* hit and miss counts of the cache of flattened requests */
+void PINT_request_plan_cache_stats(int64_t *hits, int64_t *misses,
+                                   int *entries);
+void PINT_request_plan_cache_finalize(void);
+
 /* generate offset length pairs from request and dist */
 int PINT_process_request(PINT_Request_state *req,
 		PINT_Request_state *mem,
@@ -122,6 +131,13 @@ int PINT_process_request(PINT_Request_state *req,
 		PINT_Request_result *result,
 		int mode);
 
+/* logical file range [start, end) touched by a span of request bytes */
+int PINT_request_file_extent(PINT_Request *request,
+		PVFS_offset target_offset,
+		PVFS_size size,
+		PVFS_offset *start,
+		PVFS_offset *end);
+
 /* internal function */
 PVFS_size PINT_distribute(PVFS_offset offset,
                           PVFS_size size,
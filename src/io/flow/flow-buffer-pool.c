@@ -0,0 +1,470 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Server-wide pool of BMI buffers for flow protocols.
+ *
+ * Buffers are grouped into classes by the BMI module that allocated them,
+ * their size and their send/recv type.  Each thread keeps a few idle
+ * buffers of every class in a private cache so that the common
+ * borrow/return cycle takes no locks and hands back memory that was last
+ * touched (and therefore first-touch placed) on the same node.  Anything
+ * beyond that goes to a per-class shared list, and beyond
+ * FLOW_BUFPOOL_MAX_BYTES back to BMI.
+ *
+ * An idle buffer stores its list linkage, and the module, size and type
+ * it was allocated with, in its own first bytes, so it can always be
+ * released through the module that allocated it.  When every class is
+ * taken, the least recently used one is emptied and reused for the new
+ * combination; idle buffers of the old combination still in thread
+ * caches are recognised by their header and released when found.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "gossip.h"
+#include "gen-locks.h"
+#include "pint-perf-counter.h"
+#include "bmi-method-support.h"
+#include "flow-buffer-pool.h"
+
+/* number of distinct (module, size, type) combinations we will pool */
+#define FLOW_BUFPOOL_CLASSES 32
+
+/* requests smaller than FLOW_BUFPOOL_ROUND_LIMIT are rounded up to a
+ * power of two (at least FLOW_BUFPOOL_MIN_SIZE) so that small flows share
+ * a handful of classes; larger requests are pooled at their exact size,
+ * which callers keep to a few values (see flowproto-multiqueue.c)
+ */
+#define FLOW_BUFPOOL_MIN_SIZE 4096
+#define FLOW_BUFPOOL_ROUND_LIMIT (64*1024)
+
+struct bufpool_free
+{
+    struct bufpool_free *next;
+    /* what the buffer was allocated with */
+    struct bmi_method_ops *method;
+    PVFS_size size;
+    enum bmi_op_type send_recv;
+};
+
+struct bufpool_class
+{
+    struct bmi_method_ops *method;
+    PVFS_size size;
+    enum bmi_op_type send_recv;
+    int max_free;
+    unsigned long last_use;
+    gen_mutex_t mutex;
+    struct bufpool_free *free_list;
+    int free_count;
+};
+
+struct bufpool_thread_cache
+{
+    struct bufpool_free *head[FLOW_BUFPOOL_CLASSES];
+    int count[FLOW_BUFPOOL_CLASSES];
+};
+
+static struct bufpool_class bufpool_classes[FLOW_BUFPOOL_CLASSES];
+static volatile int bufpool_class_count = 0;
+static gen_mutex_t bufpool_class_mutex = GEN_MUTEX_INITIALIZER;
+static pthread_key_t bufpool_key;
+static int bufpool_initialized = 0;
+static unsigned long bufpool_clock = 0;
+
+static void bufpool_thread_exit(void *arg);
+
+/* hands an idle buffer back to the module that allocated it */
+static void bufpool_memfree(struct bufpool_free *entry)
+{
+    struct bmi_method_ops *method = entry->method;
+    PVFS_size size = entry->size;
+    enum bmi_op_type send_recv = entry->send_recv;
+    int ret;
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_CACHED,
+                    1, PINT_PERF_SUB);
+    ret = method->memfree(entry, size, send_recv);
+    if(ret < 0)
+    {
+        gossip_debug(GOSSIP_FLOW_DEBUG, "flow buffer pool: unable to "
+                     "release %p: %d\n", entry, ret);
+    }
+}
+
+static PVFS_size bufpool_round(PVFS_size size)
+{
+    PVFS_size rounded = FLOW_BUFPOOL_MIN_SIZE;
+
+    if(size >= FLOW_BUFPOOL_ROUND_LIMIT)
+    {
+        return size;
+    }
+    while(rounded < size)
+    {
+        rounded <<= 1;
+    }
+    return rounded;
+}
+
+/* returns the index of the class matching the arguments, creating it if
+ * there is room, or -1
+ */
+static int bufpool_find_class(struct bmi_method_ops *method,
+                              PVFS_size size,
+                              enum bmi_op_type send_recv)
+{
+    int i, victim, count = bufpool_class_count;
+    struct bufpool_class *cls;
+    struct bufpool_free *stale, *entry;
+
+    for(i = 0; i < count; i++)
+    {
+        cls = &bufpool_classes[i];
+        if(cls->method == method && cls->size == size &&
+           cls->send_recv == send_recv)
+        {
+            cls->last_use = __sync_add_and_fetch(&bufpool_clock, 1);
+            return i;
+        }
+    }
+
+    gen_mutex_lock(&bufpool_class_mutex);
+    /* someone may have added it while we were looking */
+    for(; i < bufpool_class_count; i++)
+    {
+        cls = &bufpool_classes[i];
+        if(cls->method == method && cls->size == size &&
+           cls->send_recv == send_recv)
+        {
+            gen_mutex_unlock(&bufpool_class_mutex);
+            return i;
+        }
+    }
+
+    if(i < FLOW_BUFPOOL_CLASSES)
+    {
+        cls = &bufpool_classes[i];
+        cls->method = method;
+        cls->size = size;
+        cls->send_recv = send_recv;
+        cls->max_free = FLOW_BUFPOOL_MAX_BYTES / size;
+        if(cls->max_free < 1)
+        {
+            cls->max_free = 1;
+        }
+        cls->last_use = __sync_add_and_fetch(&bufpool_clock, 1);
+        gen_mutex_init(&cls->mutex);
+        cls->free_list = NULL;
+        cls->free_count = 0;
+
+        /* publish the entry only once it is fully set up */
+        __sync_synchronize();
+        bufpool_class_count = i + 1;
+        gen_mutex_unlock(&bufpool_class_mutex);
+
+        gossip_debug(GOSSIP_FLOW_DEBUG, "flow buffer pool: new class %d, "
+                     "size %lld, type %d, max idle %d\n", i, lld(size),
+                     (int)send_recv, cls->max_free);
+        return i;
+    }
+
+    /* every class is taken; reuse the least recently used one */
+    victim = 0;
+    for(i = 1; i < FLOW_BUFPOOL_CLASSES; i++)
+    {
+        if(bufpool_classes[i].last_use < bufpool_classes[victim].last_use)
+        {
+            victim = i;
+        }
+    }
+    cls = &bufpool_classes[victim];
+    gen_mutex_lock(&cls->mutex);
+    stale = cls->free_list;
+    cls->free_list = NULL;
+    cls->free_count = 0;
+    cls->method = method;
+    cls->size = size;
+    cls->send_recv = send_recv;
+    cls->max_free = FLOW_BUFPOOL_MAX_BYTES / size;
+    if(cls->max_free < 1)
+    {
+        cls->max_free = 1;
+    }
+    cls->last_use = __sync_add_and_fetch(&bufpool_clock, 1);
+    gen_mutex_unlock(&cls->mutex);
+    gen_mutex_unlock(&bufpool_class_mutex);
+
+    while((entry = stale))
+    {
+        stale = entry->next;
+        bufpool_memfree(entry);
+    }
+
+    gossip_debug(GOSSIP_FLOW_DEBUG, "flow buffer pool: reused class %d, "
+                 "size %lld, type %d, max idle %d\n", victim, lld(size),
+                 (int)send_recv, cls->max_free);
+    return victim;
+}
+
+static int bufpool_lookup(BMI_addr_t addr,
+                          PVFS_size size,
+                          enum bmi_op_type send_recv,
+                          struct bmi_method_ops **method)
+{
+    *method = NULL;
+    if(!bufpool_initialized ||
+       BMI_get_info(addr, BMI_GET_METH_OPS, method) < 0 || !*method)
+    {
+        return -1;
+    }
+    return bufpool_find_class(*method, size, send_recv);
+}
+
+static struct bufpool_thread_cache *bufpool_thread_cache(void)
+{
+    struct bufpool_thread_cache *tc;
+
+    tc = pthread_getspecific(bufpool_key);
+    if(!tc)
+    {
+        tc = calloc(1, sizeof(*tc));
+        if(tc && pthread_setspecific(bufpool_key, tc) != 0)
+        {
+            free(tc);
+            tc = NULL;
+        }
+    }
+    return tc;
+}
+
+/* returns an idle buffer to the shared list of its class, or to BMI if
+ * the class already holds enough
+ */
+static void bufpool_release(int idx, struct bufpool_free *entry)
+{
+    struct bufpool_class *cls = &bufpool_classes[idx];
+
+    gen_mutex_lock(&cls->mutex);
+    if(cls->method == entry->method && cls->size == entry->size &&
+       cls->send_recv == entry->send_recv &&
+       cls->free_count < cls->max_free)
+    {
+        entry->next = cls->free_list;
+        cls->free_list = entry;
+        cls->free_count++;
+        gen_mutex_unlock(&cls->mutex);
+        return;
+    }
+    gen_mutex_unlock(&cls->mutex);
+
+    bufpool_memfree(entry);
+}
+
+static void bufpool_thread_exit(void *arg)
+{
+    struct bufpool_thread_cache *tc = arg;
+    struct bufpool_free *entry;
+    int i;
+
+    for(i = 0; i < bufpool_class_count; i++)
+    {
+        while((entry = tc->head[i]))
+        {
+            tc->head[i] = entry->next;
+            bufpool_release(i, entry);
+        }
+    }
+    free(tc);
+}
+
+/* PINT_flow_bufpool_initialize()
+ *
+ * sets up the buffer pool; safe to call more than once
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int PINT_flow_bufpool_initialize(void)
+{
+    int ret;
+
+    gen_mutex_lock(&bufpool_class_mutex);
+    if(bufpool_initialized)
+    {
+        gen_mutex_unlock(&bufpool_class_mutex);
+        return 0;
+    }
+    ret = pthread_key_create(&bufpool_key, bufpool_thread_exit);
+    if(ret != 0)
+    {
+        gen_mutex_unlock(&bufpool_class_mutex);
+        return -PVFS_ENOMEM;
+    }
+    bufpool_class_count = 0;
+    bufpool_initialized = 1;
+    gen_mutex_unlock(&bufpool_class_mutex);
+    return 0;
+}
+
+/* PINT_flow_bufpool_finalize()
+ *
+ * releases every idle buffer back to BMI.  Buffers still cached by other
+ * live threads are dropped.
+ *
+ * no return value
+ */
+void PINT_flow_bufpool_finalize(void)
+{
+    struct bufpool_thread_cache *tc;
+    struct bufpool_free *entry;
+    struct bufpool_class *cls;
+    int i;
+
+    if(!bufpool_initialized)
+    {
+        return;
+    }
+
+    tc = pthread_getspecific(bufpool_key);
+    if(tc)
+    {
+        pthread_setspecific(bufpool_key, NULL);
+        bufpool_thread_exit(tc);
+    }
+
+    gen_mutex_lock(&bufpool_class_mutex);
+    bufpool_initialized = 0;
+    for(i = 0; i < bufpool_class_count; i++)
+    {
+        cls = &bufpool_classes[i];
+        while((entry = cls->free_list))
+        {
+            cls->free_list = entry->next;
+            bufpool_memfree(entry);
+        }
+        cls->free_count = 0;
+        gen_mutex_destroy(&cls->mutex);
+    }
+    bufpool_class_count = 0;
+    pthread_key_delete(bufpool_key);
+    gen_mutex_unlock(&bufpool_class_mutex);
+}
+
+void *PINT_flow_bufpool_get(BMI_addr_t addr,
+                            PVFS_size size,
+                            enum bmi_op_type send_recv)
+{
+    struct bufpool_thread_cache *tc;
+    struct bufpool_free *entry = NULL;
+    struct bufpool_class *cls;
+    struct bmi_method_ops *method;
+    void *buffer;
+    int idx;
+
+    size = bufpool_round(size);
+    idx = bufpool_lookup(addr, size, send_recv, &method);
+    if(idx >= 0)
+    {
+        tc = bufpool_thread_cache();
+        if(tc && tc->head[idx])
+        {
+            entry = tc->head[idx];
+            tc->head[idx] = entry->next;
+            tc->count[idx]--;
+        }
+        else
+        {
+            cls = &bufpool_classes[idx];
+            gen_mutex_lock(&cls->mutex);
+            entry = cls->free_list;
+            if(entry)
+            {
+                cls->free_list = entry->next;
+                cls->free_count--;
+            }
+            gen_mutex_unlock(&cls->mutex);
+        }
+        /* left over from a class whose slot has since been reused */
+        if(entry && (entry->method != method || entry->size != size ||
+                     entry->send_recv != send_recv))
+        {
+            bufpool_memfree(entry);
+            entry = NULL;
+        }
+    }
+
+    if(entry)
+    {
+        buffer = entry;
+        memset(buffer, 0, size);
+        PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_HITS,
+                        1, PINT_PERF_ADD);
+        PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_CACHED,
+                        1, PINT_PERF_SUB);
+    }
+    else
+    {
+        buffer = BMI_memalloc(addr, size, send_recv);
+        if(!buffer)
+        {
+            return NULL;
+        }
+        PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_MISSES,
+                        1, PINT_PERF_ADD);
+    }
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_IN_USE,
+                    1, PINT_PERF_ADD);
+    return buffer;
+}
+
+void PINT_flow_bufpool_put(BMI_addr_t addr,
+                           void *buffer,
+                           PVFS_size size,
+                           enum bmi_op_type send_recv)
+{
+    struct bufpool_thread_cache *tc;
+    struct bufpool_free *entry = buffer;
+    struct bmi_method_ops *method;
+    int idx;
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_IN_USE,
+                    1, PINT_PERF_SUB);
+
+    size = bufpool_round(size);
+    idx = bufpool_lookup(addr, size, send_recv, &method);
+    if(idx < 0)
+    {
+        BMI_memfree(addr, buffer, size, send_recv);
+        return;
+    }
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FLOWBUF_CACHED,
+                    1, PINT_PERF_ADD);
+    entry->method = method;
+    entry->size = size;
+    entry->send_recv = send_recv;
+    tc = bufpool_thread_cache();
+    if(tc && tc->count[idx] < FLOW_BUFPOOL_THREAD_CACHE)
+    {
+        entry->next = tc->head[idx];
+        tc->head[idx] = entry;
+        tc->count[idx]++;
+        return;
+    }
+    bufpool_release(idx, entry);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
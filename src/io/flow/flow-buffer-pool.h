@@ -0,0 +1,53 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* This header contains the interface for the server-wide pool of BMI
+ * buffers that flow protocols borrow from instead of calling
+ * BMI_memalloc()/BMI_memfree() for every flow.
+ */
+
+#ifndef __FLOW_BUFFER_POOL_H
+#define __FLOW_BUFFER_POOL_H
+
+#include "pvfs2-internal.h"
+#include "bmi.h"
+
+/* upper bound on the memory kept idle in the shared list of each buffer
+ * size
+ */
+#define FLOW_BUFPOOL_MAX_BYTES (64*1024*1024)
+
+/* buffers of each size each thread keeps without touching the shared
+ * lists
+ */
+#define FLOW_BUFPOOL_THREAD_CACHE 4
+
+int PINT_flow_bufpool_initialize(void);
+void PINT_flow_bufpool_finalize(void);
+
+/* buffers are zeroed on return, as with BMI_memalloc() */
+void *PINT_flow_bufpool_get(BMI_addr_t addr,
+                            PVFS_size size,
+                            enum bmi_op_type send_recv);
+
+/* size and send_recv must match the values given to the get call; addr
+ * may be any live address serviced by the same BMI module
+ */
+void PINT_flow_bufpool_put(BMI_addr_t addr,
+                           void *buffer,
+                           PVFS_size size,
+                           enum bmi_op_type send_recv);
+
+#endif /* __FLOW_BUFFER_POOL_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
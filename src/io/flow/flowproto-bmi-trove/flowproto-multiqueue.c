@@ -17,11 +17,13 @@
 #include "gossip.h"
 #include "quicklist.h"
 #include "src/io/flow/flowproto-support.h"
+#include "src/io/flow/flow-buffer-pool.h"
 #include "gen-locks.h"
 #include "bmi.h"
 #include "trove.h"
 #include "thread-mgr.h"
 #include "pint-perf-counter.h"
+#include "pint-util.h"
 #include "pvfs2-internal.h"
 
 /* the following buffer settings are used by default if none are specified in
@@ -30,6 +32,16 @@
 #define BUFFERS_PER_FLOW 8
 #define BUFFER_SIZE (256*1024)
 
+/* bounds for adapting the pipeline depth of trove flows at runtime.  The
+ * configured buffers_per_flow is the starting depth; a flow may grow to
+ * FLOW_MAX_DEPTH_SCALE times that (never more than it has buffers worth
+ * of data for) or shrink to FLOW_MIN_DEPTH, based on how trove latency
+ * compares to network latency.
+ */
+#define FLOW_MIN_DEPTH 2
+#define FLOW_MAX_DEPTH_SCALE 4
+#define FLOW_LAT_SAMPLES 4
+
 #define MAX_REGIONS 64
 
 #define FLOW_CLEANUP_CANCEL_PATH(__flow_data, __cancel_path)          \
@@ -72,6 +84,9 @@ struct fp_queue_item
     struct qlist_head list_link;
     flow_descriptor *parent;
     struct PINT_thread_mgr_bmi_callback bmi_callback;
+    PVFS_time trove_start;
+    PVFS_time bmi_start;
+    int zcopy;          /* send straight from the bstream, not buffer */
 };
 
 /* fp_private_data is information specific to this flow protocol, stored
@@ -96,6 +111,22 @@ struct fp_private_data
     struct qlist_head src_list;
     struct qlist_head dest_list;
     struct qlist_head empty_list;
+
+    /* adaptive pipeline state, only used for trove flows */
+    PVFS_size alloc_size;       /* bytes allocated for each buffer */
+    int target_depth;           /* buffers we want in circulation */
+    int active_depth;           /* buffers currently in circulation */
+    int next_unused;            /* first prealloc_array slot never used */
+    PVFS_time trove_lat;        /* moving average trove latency (usecs) */
+    PVFS_time bmi_lat;          /* moving average bmi latency (usecs) */
+    int trove_samples;
+    int bmi_samples;
+    struct qlist_head parked_list;  /* buffers retired by shrinking */
+
+    /* zero-copy state for trove to bmi flows */
+    int zcopy_state;            /* 0 untried, 1 usable, -1 unavailable */
+    int zcopy_fd;
+    void *zcopy_ref;
 };
 #define PRIVATE_FLOW(target_flow)\
     ((struct fp_private_data*)(target_flow->flow_protocol_data))
@@ -126,6 +157,14 @@ static gen_mutex_t id_sync_mode_mutex = GEN_MUTEX_INITIALIZER;
 static TROVE_context_id global_trove_context = -1;
 
 static int get_data_sync_mode(TROVE_coll_id coll_id);
+static void size_pipeline(struct fp_private_data *flow_data);
+static void record_latency(PVFS_time *avg,
+                           int *samples,
+                           PVFS_time *start);
+static void adjust_pipeline(struct fp_private_data *flow_data);
+static int zcopy_usable(struct fp_private_data *flow_data);
+static int post_send_zcopy(struct fp_queue_item *q_item,
+                           struct fp_private_data *flow_data);
 static void bmi_recv_callback_fn(void *user_ptr,
                                  PVFS_size actual_size,
                                  PVFS_error error_code);
@@ -152,6 +191,10 @@ static inline void bmi_send_callback_wrapper(void *user_ptr,
     gen_mutex_lock(&flow_data->parent->flow_mutex);
 
     bmi_send_callback_fn(user_ptr, actual_size, error_code, 0);
+    if(flow_data->parent->state != FLOW_COMPLETE)
+    {
+        adjust_pipeline(flow_data);
+    }
     if(flow_data->parent->state == FLOW_COMPLETE)
     {
         gen_mutex_unlock(&flow_data->parent->flow_mutex);
@@ -171,6 +214,10 @@ static inline void bmi_recv_callback_wrapper(void *user_ptr,
         PRIVATE_FLOW(((struct fp_queue_item*)user_ptr)->parent);
     gen_mutex_lock(&flow_data->parent->flow_mutex);
     bmi_recv_callback_fn(user_ptr, actual_size, error_code);
+    if(flow_data->parent->state != FLOW_COMPLETE)
+    {
+        adjust_pipeline(flow_data);
+    }
     if(flow_data->parent->state == FLOW_COMPLETE)
     {
         gen_mutex_unlock(&flow_data->parent->flow_mutex);
@@ -190,6 +237,10 @@ static inline void trove_read_callback_wrapper(void *user_ptr,
         result_chain_entry*)user_ptr)->q_item->parent);
     gen_mutex_lock(&flow_data->parent->flow_mutex);
     trove_read_callback_fn(user_ptr, error_code);
+    if(flow_data->parent->state != FLOW_COMPLETE)
+    {
+        adjust_pipeline(flow_data);
+    }
     if(flow_data->parent->state == FLOW_COMPLETE)
     {
         gen_mutex_unlock(&flow_data->parent->flow_mutex);
@@ -209,6 +260,10 @@ static inline void trove_write_callback_wrapper(void *user_ptr,
                        result_chain_entry*)user_ptr)->q_item->parent);
     gen_mutex_lock(&flow_data->parent->flow_mutex);
     trove_write_callback_fn(user_ptr, error_code);
+    if(flow_data->parent->state != FLOW_COMPLETE)
+    {
+        adjust_pipeline(flow_data);
+    }
     if(flow_data->parent->state == FLOW_COMPLETE)
     {
         gen_mutex_unlock(&flow_data->parent->flow_mutex);
@@ -326,6 +381,14 @@ int fp_multiqueue_initialize(int flowproto_id)
         return(ret);
     }
     PINT_thread_mgr_trove_getcontext(&global_trove_context);
+
+    ret = PINT_flow_bufpool_initialize();
+    if(ret < 0)
+    {
+        PINT_thread_mgr_trove_stop();
+        PINT_thread_mgr_bmi_stop();
+        return(ret);
+    }
 #endif
 
     return(0);
@@ -346,6 +409,7 @@ int fp_multiqueue_finalize(void)
         struct qlist_head *tmp_link = NULL, *scratch_link = NULL;
 
         PINT_thread_mgr_trove_stop();
+        PINT_flow_bufpool_finalize();
 
         gen_mutex_lock(&id_sync_mode_mutex);
         qlist_for_each_safe(tmp_link, scratch_link, &s_id_sync_mode_list)
@@ -534,6 +598,7 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
     INIT_QLIST_HEAD(&flow_data->src_list);
     INIT_QLIST_HEAD(&flow_data->dest_list);
     INIT_QLIST_HEAD(&flow_data->empty_list);
+    INIT_QLIST_HEAD(&flow_data->parked_list);
 
     /* if a file datatype offset was specified, go ahead and skip ahead 
      * before doing anything else
@@ -565,6 +630,17 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
     {
         flow_d->buffers_per_flow = BUFFERS_PER_FLOW;
     }
+    flow_data->alloc_size = flow_d->buffer_size;
+    flow_data->target_depth = flow_d->buffers_per_flow;
+
+#ifdef __PVFS2_TROVE_SUPPORT__
+    if(flow_d->src.endpoint_id == TROVE_ENDPOINT ||
+       flow_d->dest.endpoint_id == TROVE_ENDPOINT)
+    {
+        /* may change buffers_per_flow to the most we will ever use */
+        size_pipeline(flow_data);
+    }
+#endif
         
     flow_data->prealloc_array = (struct fp_queue_item*)
                 malloc(flow_d->buffers_per_flow*sizeof(struct fp_queue_item));
@@ -640,13 +716,15 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
     else if(flow_d->src.endpoint_id == TROVE_ENDPOINT &&
             flow_d->dest.endpoint_id == BMI_ENDPOINT)
     {
-        flow_data->initial_posts = flow_d->buffers_per_flow;
+        flow_data->initial_posts = flow_data->target_depth;
         gen_mutex_lock(&flow_data->parent->flow_mutex);
-        for(i = 0; i < flow_d->buffers_per_flow; i++)
+        for(i = 0; i < flow_data->target_depth; i++)
         {
             gossip_debug(GOSSIP_FLOW_PROTO_DEBUG,
                 "flowproto-multiqueue forcing bmi_send_callback_fn.\n");
 
+            flow_data->active_depth++;
+            flow_data->next_unused++;
             bmi_send_callback_fn(&(flow_data->prealloc_array[i]), 0, 0, 1);
             if(flow_data->dest_last_posted)
             {
@@ -669,12 +747,16 @@ int fp_multiqueue_post(flow_descriptor  *flow_d)
         /* only post one outstanding recv at a time; easier to manage */
         flow_data->initial_posts = 1;
 
-        /* place remaining buffers on "empty" queue */
-        for(i = 1; i < flow_d->buffers_per_flow; i++)
+        /* place remaining buffers on "empty" queue; any slots beyond the
+         * initial depth are only handed out if the pipeline grows
+         */
+        for(i = 1; i < flow_data->target_depth; i++)
         {
             qlist_add_tail(&flow_data->prealloc_array[i].list_link,
                            &flow_data->empty_list);
         }
+        flow_data->active_depth = flow_data->target_depth;
+        flow_data->next_unused = flow_data->target_depth;
 
         flow_data->prealloc_array[0].result_chain.q_item = 
                         &flow_data->prealloc_array[0];
@@ -738,10 +820,14 @@ static void bmi_recv_callback_fn(void *user_ptr,
         return;
     }
 
+    record_latency(&flow_data->bmi_lat, &flow_data->bmi_samples,
+                   &q_item->bmi_start);
+
     /* remove from current queue */
     qlist_del(&q_item->list_link);
     /* add to dest queue */
     qlist_add_tail(&q_item->list_link, &flow_data->dest_list);
+    q_item->trove_start = PINT_util_get_time_us();
     result_tmp = &q_item->result_chain;
     do{
         assert(result_tmp->result.bytes);
@@ -809,9 +895,9 @@ static void bmi_recv_callback_fn(void *user_ptr,
         if(!q_item->buffer)
         {
             /* if the q_item has not been used, allocate a buffer */
-            q_item->buffer = BMI_memalloc(
+            q_item->buffer = PINT_flow_bufpool_get(
                             q_item->parent->src.u.bmi.address,
-                            q_item->parent->buffer_size, BMI_RECV);
+                            flow_data->alloc_size, BMI_RECV);
             /* TODO: error handling */
             assert(q_item->buffer);
             q_item->bmi_callback.fn = bmi_recv_callback_wrapper;
@@ -882,10 +968,11 @@ static void bmi_recv_callback_fn(void *user_ptr,
                      q_item->buffer);
 
         /* TODO: what if we recv less than expected? */
+        q_item->bmi_start = PINT_util_get_time_us();
         ret = BMI_post_recv(&q_item->posted_id,
                             q_item->parent->src.u.bmi.address,
                             ((char *)q_item->buffer),
-                            flow_data->parent->buffer_size,
+                            flow_data->alloc_size,
                             &tmp_actual_size,
                             BMI_PRE_ALLOC,
                             q_item->parent->tag,
@@ -950,6 +1037,9 @@ static void trove_read_callback_fn(void *user_ptr,
         return;
     }
 
+    record_latency(&flow_data->trove_lat, &flow_data->trove_samples,
+                   &q_item->trove_start);
+
     /* remove from current queue */
     qlist_del(&q_item->list_link);
     /* add to dest queue */
@@ -984,15 +1074,23 @@ static void trove_read_callback_fn(void *user_ptr,
         {
             flow_data->dest_pending++;
             assert(q_item->buffer_used);
-            ret = BMI_post_send(&q_item->posted_id,
-                                q_item->parent->dest.u.bmi.address,
-                                q_item->buffer,
-                                q_item->buffer_used,
-                                BMI_PRE_ALLOC,
-                                q_item->parent->tag,
-                                &q_item->bmi_callback,
-                                global_bmi_context,
-                                (bmi_hint)q_item->parent->hints);
+            q_item->bmi_start = PINT_util_get_time_us();
+            if(q_item->zcopy)
+            {
+                ret = post_send_zcopy(q_item, flow_data);
+            }
+            else
+            {
+                ret = BMI_post_send(&q_item->posted_id,
+                                    q_item->parent->dest.u.bmi.address,
+                                    q_item->buffer,
+                                    q_item->buffer_used,
+                                    BMI_PRE_ALLOC,
+                                    q_item->parent->tag,
+                                    &q_item->bmi_callback,
+                                    global_bmi_context,
+                                    (bmi_hint)q_item->parent->hints);
+            }
             flow_data->next_seq_to_send++;
             if(q_item->last)
             {
@@ -1100,6 +1198,8 @@ static int bmi_send_callback_fn(void *user_ptr,
     else
     {
         flow_data->dest_pending--;
+        record_latency(&flow_data->bmi_lat, &flow_data->bmi_samples,
+                       &q_item->bmi_start);
     }
 
 #if 0
@@ -1141,6 +1241,16 @@ static int bmi_send_callback_fn(void *user_ptr,
         return(0);
     }
 
+    /* pipeline is shrinking; retire this buffer rather than refill it */
+    if(!initial_call_flag &&
+       flow_data->active_depth > flow_data->target_depth)
+    {
+        qlist_del(&q_item->list_link);
+        qlist_add_tail(&q_item->list_link, &flow_data->parked_list);
+        flow_data->active_depth--;
+        return(0);
+    }
+
     if(q_item->buffer)
     {
         /* if this q_item has been used before, remove it from its 
@@ -1150,9 +1260,9 @@ static int bmi_send_callback_fn(void *user_ptr,
     else
     {
         /* if the q_item has not been used, allocate a buffer */
-        q_item->buffer = BMI_memalloc(
+        q_item->buffer = PINT_flow_bufpool_get(
                         q_item->parent->dest.u.bmi.address,
-                        q_item->parent->buffer_size, BMI_SEND);
+                        flow_data->alloc_size, BMI_SEND);
 
         /* TODO: error handling */
         assert(q_item->buffer);
@@ -1286,6 +1396,23 @@ static int bmi_send_callback_fn(void *user_ptr,
 
     assert(q_item->buffer_used);
 
+    q_item->trove_start = PINT_util_get_time_us();
+
+    /* a single contiguous extent does not need to pass through the
+     * buffer at all; skip the trove read and let BMI send it straight
+     * from the bstream when its turn comes
+     */
+    q_item->zcopy = 0;
+    if(q_item->result_chain_count == 1 &&
+       q_item->result_chain.result.segs == 1 &&
+       zcopy_usable(flow_data))
+    {
+        q_item->zcopy = 1;
+        q_item->result_chain.q_item = q_item;
+        trove_read_callback_fn(&q_item->result_chain, 0);
+        return(q_item->parent->state == FLOW_COMPLETE);
+    }
+
     result_tmp = &q_item->result_chain;
     do{
         assert(q_item->buffer_used);
@@ -1379,6 +1506,9 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
         return;
     }
 
+    record_latency(&flow_data->trove_lat, &flow_data->trove_samples,
+                   &q_item->trove_start);
+
     result_tmp = &q_item->result_chain;
     do{
         q_item->parent->total_transferred += result_tmp->result.bytes;
@@ -1431,8 +1561,9 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
     else
     {
         /* if the q_item has not been used, allocate a buffer */
-        q_item->buffer = BMI_memalloc(q_item->parent->src.u.bmi.address,
-                                      q_item->parent->buffer_size,
+        q_item->buffer = PINT_flow_bufpool_get(
+                                      q_item->parent->src.u.bmi.address,
+                                      flow_data->alloc_size,
                                       BMI_RECV);
         /* TODO: error handling */
         assert(q_item->buffer);
@@ -1520,10 +1651,11 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
                      q_item->buffer);
 
         /* TODO: what if we recv less than expected? */
+        q_item->bmi_start = PINT_util_get_time_us();
         ret = BMI_post_recv(&q_item->posted_id,
                             q_item->parent->src.u.bmi.address,
                             ((char *)q_item->buffer),
-                            flow_data->parent->buffer_size,
+                            flow_data->alloc_size,
                             &tmp_actual_size,
                             BMI_PRE_ALLOC,
                             q_item->parent->tag,
@@ -1544,6 +1676,12 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
             bmi_recv_callback_fn(q_item, tmp_actual_size, 0);
         }
     }
+    else if(flow_data->active_depth > flow_data->target_depth)
+    {
+        /* pipeline is shrinking; retire this buffer */
+        qlist_add_tail(&q_item->list_link, &flow_data->parked_list);
+        flow_data->active_depth--;
+    }
     else
     {
         qlist_add_tail(&q_item->list_link, &(flow_data->empty_list));
@@ -1561,10 +1699,12 @@ static void trove_write_callback_fn(void *user_ptr, PVFS_error error_code)
  */
 static void cleanup_buffers(struct fp_private_data *flow_data)
 {
+#ifdef __PVFS2_TROVE_SUPPORT__
     int i;
     struct result_chain_entry *result_tmp;
     struct result_chain_entry *old_result_tmp;
 
+    /* trove flows borrow their buffers from the server-wide pool */
     if(flow_data->parent->src.endpoint_id == BMI_ENDPOINT &&
         flow_data->parent->dest.endpoint_id == TROVE_ENDPOINT)
     {
@@ -1572,9 +1712,9 @@ static void cleanup_buffers(struct fp_private_data *flow_data)
         {
             if(flow_data->prealloc_array[i].buffer)
             {
-                BMI_memfree(flow_data->parent->src.u.bmi.address,
+                PINT_flow_bufpool_put(flow_data->parent->src.u.bmi.address,
                             flow_data->prealloc_array[i].buffer,
-                            flow_data->parent->buffer_size,
+                            flow_data->alloc_size,
                             BMI_RECV);
             }
             result_tmp = &(flow_data->prealloc_array[i].result_chain);
@@ -1593,13 +1733,18 @@ static void cleanup_buffers(struct fp_private_data *flow_data)
     else if(flow_data->parent->src.endpoint_id == TROVE_ENDPOINT &&
             flow_data->parent->dest.endpoint_id == BMI_ENDPOINT)
     {
+        if(flow_data->zcopy_ref)
+        {
+            trove_bstream_put_fd(flow_data->parent->src.u.trove.coll_id,
+                                 flow_data->zcopy_ref);
+        }
         for(i = 0; i < flow_data->parent->buffers_per_flow; i++)
         {
             if(flow_data->prealloc_array[i].buffer)
             {
-                BMI_memfree(flow_data->parent->dest.u.bmi.address,
+                PINT_flow_bufpool_put(flow_data->parent->dest.u.bmi.address,
                             flow_data->prealloc_array[i].buffer,
-                            flow_data->parent->buffer_size,
+                            flow_data->alloc_size,
                             BMI_SEND);
             }
             result_tmp = &(flow_data->prealloc_array[i].result_chain);
@@ -1615,7 +1760,9 @@ static void cleanup_buffers(struct fp_private_data *flow_data)
             flow_data->prealloc_array[i].result_chain.next = NULL;
         }
     }
-    else if(flow_data->parent->src.endpoint_id == MEM_ENDPOINT &&
+    else
+#endif
+    if(flow_data->parent->src.endpoint_id == MEM_ENDPOINT &&
             flow_data->parent->dest.endpoint_id == BMI_ENDPOINT)
     {
         if(flow_data->intermediate)
@@ -2246,6 +2393,294 @@ static int get_data_sync_mode(TROVE_coll_id coll_id)
                  "returning %d\n", mode);
     return mode;
 }
+
+/* zcopy_usable()
+ *
+ * fetches a descriptor for the source bstream the first time a trove to
+ * bmi flow has an extent it could send without copying
+ *
+ * returns 1 if the flow may send from the bstream, 0 otherwise
+ */
+static int zcopy_usable(struct fp_private_data *flow_data)
+{
+    int ret;
+
+    if(flow_data->zcopy_state == 0)
+    {
+        ret = trove_bstream_get_fd(flow_data->parent->src.u.trove.coll_id,
+                                   flow_data->parent->src.u.trove.handle,
+                                   &flow_data->zcopy_fd,
+                                   &flow_data->zcopy_ref);
+        if(ret < 0)
+        {
+            gossip_debug(GOSSIP_FLOW_PROTO_DEBUG, "flowproto-multiqueue: "
+                         "no zero-copy for flow %p: %d\n",
+                         flow_data->parent, ret);
+            flow_data->zcopy_ref = NULL;
+            flow_data->zcopy_state = -1;
+        }
+        else
+        {
+            flow_data->zcopy_state = 1;
+        }
+    }
+    return(flow_data->zcopy_state == 1);
+}
+
+/* post_send_zcopy()
+ *
+ * posts the send for an item whose extent was left in the bstream.  If
+ * the BMI method cannot send from a file, the extent is read into the
+ * item's buffer instead and zero-copy is turned off for the rest of the
+ * flow.
+ *
+ * returns the BMI_post_send() result
+ */
+static int post_send_zcopy(struct fp_queue_item *q_item,
+                           struct fp_private_data *flow_data)
+{
+    PVFS_offset offset = q_item->result_chain.result.offset_array[0];
+    ssize_t nread;
+    int ret;
+
+    ret = BMI_post_send_file(&q_item->posted_id,
+                             q_item->parent->dest.u.bmi.address,
+                             flow_data->zcopy_fd,
+                             offset,
+                             q_item->buffer_used,
+                             q_item->parent->tag,
+                             &q_item->bmi_callback,
+                             global_bmi_context,
+                             (bmi_hint)q_item->parent->hints);
+    if(ret != -PVFS_ENOSYS)
+    {
+        return(ret);
+    }
+
+    flow_data->zcopy_state = -1;
+    q_item->zcopy = 0;
+    do
+    {
+        nread = pread(flow_data->zcopy_fd, q_item->buffer,
+                      q_item->buffer_used, offset);
+    } while(nread < 0 && errno == EINTR);
+    if(nread < 0)
+    {
+        return(-PVFS_errno_to_error(errno));
+    }
+    /* same as a short trove read: the rest of the extent reads as zero */
+    memset((char*)q_item->buffer + nread, 0, q_item->buffer_used - nread);
+
+    return(BMI_post_send(&q_item->posted_id,
+                         q_item->parent->dest.u.bmi.address,
+                         q_item->buffer,
+                         q_item->buffer_used,
+                         BMI_PRE_ALLOC,
+                         q_item->parent->tag,
+                         &q_item->bmi_callback,
+                         global_bmi_context,
+                         (bmi_hint)q_item->parent->hints));
+}
+
+/* size_pipeline()
+ *
+ * picks the buffer size and pipeline depth for a trove flow based on the
+ * total size of the request and the eager limit of the BMI method in use.
+ * buffers_per_flow is updated to the most buffers the flow can use.
+ *
+ * no return value
+ */
+static void size_pipeline(struct fp_private_data *flow_data)
+{
+    flow_descriptor *flow_d = flow_data->parent;
+    PVFS_size total = flow_d->aggregate_size;
+    PVFS_size nbufs, alloc_size;
+    BMI_addr_t addr;
+    int eager_limit = 0;
+    int capacity;
+
+    if(total < 0)
+    {
+        return;
+    }
+
+    /* a transfer no larger than one buffer is a single message no matter
+     * how big the buffer is, so only pin what is needed, rounded up to a
+     * power of two so that the buffer pool sees a few sizes rather than
+     * one per request.  Anything larger must keep the configured size
+     * since the peer splits the stream on buffer_size boundaries.
+     */
+    if(total > 0 && total < flow_d->buffer_size)
+    {
+        alloc_size = 1;
+        while(alloc_size < total)
+        {
+            alloc_size <<= 1;
+        }
+        if(alloc_size > flow_d->buffer_size)
+        {
+            alloc_size = flow_d->buffer_size;
+        }
+        flow_data->alloc_size = alloc_size;
+    }
+
+    nbufs = (total + flow_d->buffer_size - 1) / flow_d->buffer_size;
+
+    /* eager sized transfers have no rendezvous to overlap */
+    addr = (flow_d->src.endpoint_id == BMI_ENDPOINT) ?
+        flow_d->src.u.bmi.address : flow_d->dest.u.bmi.address;
+    if(BMI_get_info(addr, BMI_GET_UNEXP_SIZE, &eager_limit) == 0 &&
+       total <= eager_limit)
+    {
+        nbufs = 1;
+    }
+    if(nbufs < 1)
+    {
+        nbufs = 1;
+    }
+
+    capacity = flow_d->buffers_per_flow * FLOW_MAX_DEPTH_SCALE;
+    if(capacity > nbufs)
+    {
+        capacity = nbufs;
+    }
+    if(flow_data->target_depth > capacity)
+    {
+        flow_data->target_depth = capacity;
+    }
+    flow_d->buffers_per_flow = capacity;
+
+    gossip_debug(GOSSIP_FLOW_PROTO_DEBUG,
+                 "flow %p: %lld bytes, buffer size %lld, depth %d (max %d)\n",
+                 flow_d, lld(total), lld(flow_data->alloc_size),
+                 flow_data->target_depth, capacity);
+}
+
+/* record_latency()
+ *
+ * folds the time since *start into a moving average, then clears *start
+ *
+ * no return value
+ */
+static void record_latency(PVFS_time *avg,
+                           int *samples,
+                           PVFS_time *start)
+{
+    PVFS_time sample;
+
+    if(*start == 0)
+    {
+        return;
+    }
+    sample = PINT_util_get_time_us() - *start;
+    *start = 0;
+
+    *avg = (*avg == 0) ? sample : ((*avg * 3) + sample) / 4;
+    (*samples)++;
+}
+
+/* adjust_pipeline()
+ *
+ * grows or shrinks the number of buffers in circulation depending on
+ * whether trove or the network is the slower side of the flow.  Growing
+ * takes effect immediately; shrinking happens as buffers come back.
+ * Must be called with the flow mutex held.
+ *
+ * no return value
+ */
+static void adjust_pipeline(struct fp_private_data *flow_data)
+{
+    flow_descriptor *flow_d = flow_data->parent;
+    struct fp_queue_item *q_item;
+
+    if(flow_d->error_code != 0 ||
+       flow_data->trove_samples < FLOW_LAT_SAMPLES ||
+       flow_data->bmi_samples < FLOW_LAT_SAMPLES)
+    {
+        return;
+    }
+
+    if(flow_data->trove_lat > 2 * flow_data->bmi_lat &&
+       flow_data->target_depth < flow_d->buffers_per_flow)
+    {
+        /* storage bound: keep more trove operations in flight */
+        flow_data->target_depth++;
+    }
+    else if(2 * flow_data->trove_lat < flow_data->bmi_lat &&
+            flow_data->target_depth > FLOW_MIN_DEPTH)
+    {
+        /* network bound: extra buffers would only sit pinned */
+        flow_data->target_depth--;
+    }
+    else
+    {
+        return;
+    }
+
+    /* let the change take effect before judging it */
+    flow_data->trove_samples = 0;
+    flow_data->bmi_samples = 0;
+
+    gossip_debug(GOSSIP_FLOW_PROTO_DEBUG,
+                 "flow %p: trove %lld us, bmi %lld us, depth now %d\n",
+                 flow_d, lld(flow_data->trove_lat), lld(flow_data->bmi_lat),
+                 flow_data->target_depth);
+
+    while(flow_data->active_depth < flow_data->target_depth)
+    {
+        if(qlist_empty(&flow_data->parked_list) &&
+           flow_data->next_unused >= flow_d->buffers_per_flow)
+        {
+            break;
+        }
+
+        if(flow_d->src.endpoint_id == TROVE_ENDPOINT)
+        {
+            if(flow_data->req_proc_done || flow_data->dest_last_posted)
+            {
+                break;
+            }
+            /* a parked buffer is left on its list; the send callback
+             * takes it off
+             */
+            if(!qlist_empty(&flow_data->parked_list))
+            {
+                q_item = qlist_entry(flow_data->parked_list.next,
+                                     struct fp_queue_item, list_link);
+            }
+            else
+            {
+                q_item = &flow_data->prealloc_array[flow_data->next_unused++];
+            }
+            flow_data->active_depth++;
+            flow_data->initial_posts++;
+            if(bmi_send_callback_fn(q_item, 0, 0, 1) == 1)
+            {
+                return;
+            }
+        }
+        else
+        {
+            if(PINT_REQUEST_DONE(flow_d->file_req_state))
+            {
+                break;
+            }
+            if(!qlist_empty(&flow_data->parked_list))
+            {
+                q_item = qlist_entry(flow_data->parked_list.next,
+                                     struct fp_queue_item, list_link);
+                qlist_del(&q_item->list_link);
+            }
+            else
+            {
+                q_item = &flow_data->prealloc_array[flow_data->next_unused++];
+            }
+            /* picked up by the next recv completion */
+            qlist_add_tail(&q_item->list_link, &flow_data->empty_list);
+            flow_data->active_depth++;
+        }
+    }
+}
 #endif
 
 /*
@@ -17,12 +17,38 @@
 #include "gossip.h"
 #include "id-generator.h"
 #include "pint-util.h"
+#include "gen-locks.h"
 #include "pvfs2-internal.h"
 
 #ifdef WIN32
 typedef enum job_type job_type_t;
 #endif
 
+/* one ring slot; seq tells producers and the consumer whose turn it is
+ * (Vyukov's bounded queue)
+ */
+struct job_desc_ring_slot
+{
+    unsigned long seq;
+    struct job_desc *desc;
+};
+
+struct job_desc_ring
+{
+    struct job_desc_ring_slot *slots;
+    unsigned long mask;
+    /* producers and the consumer each get their own cache line */
+    char pad0[64];
+    unsigned long head;		/* next slot a producer claims */
+    char pad1[64];
+    unsigned long tail;		/* next slot the consumer reads */
+    char pad2[64];
+    int overflow_count;
+    gen_mutex_t overflow_mutex;
+    struct qlist_head overflow;
+    struct qlist_head spill;	/* overflow taken by the consumer */
+};
+
 /***************************************************************
  * Visible functions
  */
@@ -171,6 +197,164 @@ struct job_desc *job_desc_q_shownext(job_desc_q_p jdqp)
     return (qlist_entry(jdqp->next, struct job_desc, job_desc_q_link));
 }
 
+/* job_desc_ring_new()
+ *
+ * creates a completion ring with room for at least size entries
+ *
+ * returns pointer to ring on success, NULL on failure
+ */
+struct job_desc_ring *job_desc_ring_new(int size)
+{
+    struct job_desc_ring *ring = NULL;
+    unsigned long slots = 2;
+    unsigned long i;
+
+    while (slots < (unsigned long) size)
+    {
+        slots <<= 1;
+    }
+
+    ring = (struct job_desc_ring *) malloc(sizeof(struct job_desc_ring));
+    if (!ring)
+    {
+        return (NULL);
+    }
+    memset(ring, 0, sizeof(struct job_desc_ring));
+
+    ring->slots = (struct job_desc_ring_slot *)
+        malloc(slots * sizeof(struct job_desc_ring_slot));
+    if (!ring->slots)
+    {
+        free(ring);
+        return (NULL);
+    }
+    for (i = 0; i < slots; i++)
+    {
+        ring->slots[i].seq = i;
+        ring->slots[i].desc = NULL;
+    }
+    ring->mask = slots - 1;
+    gen_mutex_init(&ring->overflow_mutex);
+    INIT_QLIST_HEAD(&ring->overflow);
+    INIT_QLIST_HEAD(&ring->spill);
+
+    return (ring);
+}
+
+/* job_desc_ring_cleanup()
+ *
+ * destroys a completion ring, along with any job descs still in it
+ *
+ * no return value
+ */
+void job_desc_ring_cleanup(struct job_desc_ring *ring)
+{
+    struct job_desc *tmp_job_desc = NULL;
+
+    if (ring)
+    {
+        while ((tmp_job_desc = job_desc_ring_pop(ring)))
+        {
+            free(tmp_job_desc);
+        }
+        gen_mutex_destroy(&ring->overflow_mutex);
+        free(ring->slots);
+        free(ring);
+    }
+    return;
+}
+
+/* job_desc_ring_push()
+ *
+ * adds a job desc to a ring; safe to call from any number of threads
+ * at once.  The desc must not be touched by the caller afterwards.
+ *
+ * no return value
+ */
+void job_desc_ring_push(struct job_desc_ring *ring,
+                        struct job_desc *desc)
+{
+    struct job_desc_ring_slot *slot;
+    unsigned long pos;
+    unsigned long seq;
+    long diff;
+
+    assert(desc);
+
+    pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        slot = &ring->slots[pos & ring->mask];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (long) seq - (long) pos;
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /* full; the consumer has fallen behind */
+            gen_mutex_lock(&ring->overflow_mutex);
+            qlist_add_tail(&(desc->job_desc_q_link), &ring->overflow);
+            __atomic_add_fetch(&ring->overflow_count, 1, __ATOMIC_RELEASE);
+            gen_mutex_unlock(&ring->overflow_mutex);
+            return;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->desc = desc;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+/* job_desc_ring_pop()
+ *
+ * removes the next job desc from a ring.  Only one thread may pop from
+ * a given ring at a time.
+ *
+ * returns pointer to job desc, or NULL if none are ready
+ */
+struct job_desc *job_desc_ring_pop(struct job_desc_ring *ring)
+{
+    struct job_desc_ring_slot *slot;
+    struct job_desc *desc = NULL;
+    unsigned long pos = ring->tail;
+
+    slot = &ring->slots[pos & ring->mask];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == pos + 1)
+    {
+        desc = slot->desc;
+        __atomic_store_n(&slot->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+        ring->tail = pos + 1;
+        return (desc);
+    }
+
+    if (qlist_empty(&ring->spill) &&
+        __atomic_load_n(&ring->overflow_count, __ATOMIC_ACQUIRE) > 0)
+    {
+        /* take the whole overflow list in one go */
+        gen_mutex_lock(&ring->overflow_mutex);
+        qlist_splice(&ring->overflow, &ring->spill);
+        INIT_QLIST_HEAD(&ring->overflow);
+        __atomic_store_n(&ring->overflow_count, 0, __ATOMIC_RELAXED);
+        gen_mutex_unlock(&ring->overflow_mutex);
+    }
+    if (!qlist_empty(&ring->spill))
+    {
+        desc = qlist_entry(ring->spill.next, struct job_desc,
+                           job_desc_q_link);
+        qlist_del(&(desc->job_desc_q_link));
+    }
+    return (desc);
+}
 
 /* job_desc_q_dump()
  *
@@ -122,6 +122,8 @@ struct job_desc
     void *job_user_ptr;		/* user pointer */
     job_aint status_user_tag;   /* user supplied tag */
     int completed_flag;		/* has the job finished? */
+    int posting;		/* poster may still touch it; don't report */
+    int queued;			/* moved onto its context's completion queue */
     job_context_id context_id;  /* context */
     struct PINT_thread_mgr_bmi_callback bmi_callback;  /* callback information */
     struct PINT_thread_mgr_trove_callback trove_callback;  /* callback information */
@@ -148,6 +150,11 @@ struct job_desc
 
 typedef struct qlist_head *job_desc_q_p;
 
+/* bounded multi-producer, single-consumer ring of completed jobs; pushes
+ * that find it full spill onto a locked overflow list
+ */
+struct job_desc_ring;
+
 struct job_desc *alloc_job_desc(int type);
 void dealloc_job_desc(struct job_desc *jd);
 job_desc_q_p job_desc_q_new(void);
@@ -158,6 +165,11 @@ void job_desc_q_remove(struct job_desc *desc);
 int job_desc_q_empty(job_desc_q_p jdqp);
 struct job_desc *job_desc_q_shownext(job_desc_q_p jdqp);
 void job_desc_q_dump(job_desc_q_p jdqp);
+struct job_desc_ring *job_desc_ring_new(int size);
+void job_desc_ring_cleanup(struct job_desc_ring *ring);
+void job_desc_ring_push(struct job_desc_ring *ring,
+                        struct job_desc *desc);
+struct job_desc *job_desc_ring_pop(struct job_desc_ring *ring);
 
 #endif /* __JOB_DESC_QUEUE_H */
 
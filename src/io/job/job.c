@@ -10,6 +10,8 @@
 #ifndef WIN32
 #include <sys/time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #endif
 #include <stdio.h>
 #include <limits.h>
@@ -28,6 +30,10 @@
 #include "job-time-mgr.h"
 #include "pvfs2-internal.h"
 
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
 /* contexts for use within the job interface */
 static bmi_context_id global_bmi_context = -1;
 #ifdef __PVFS2_TROVE_SUPPORT__
@@ -36,6 +42,19 @@ static TROVE_context_id global_trove_context = -1;
 
 /* queues of pending jobs */
 static job_desc_q_p completion_queue_array[JOB_MAX_CONTEXTS] = {NULL};
+/* completed jobs are pushed here without locking and moved onto the
+ * completion queue by whichever thread tests the context
+ */
+static struct job_desc_ring *completion_ring_array[JOB_MAX_CONTEXTS] = {NULL};
+#ifdef __PVFS2_JOB_THREADED__
+/* testers sleeping on each context, whether a wakeup is already in
+ * flight, and the fd pair used to wake them (both ends are the same
+ * eventfd where available)
+ */
+static int completion_waiters[JOB_MAX_CONTEXTS] = {0};
+static int completion_wake_pending[JOB_MAX_CONTEXTS] = {0};
+static int completion_wake_fd[JOB_MAX_CONTEXTS][2];
+#endif
 static int completion_error = 0;
 static job_desc_q_p bmi_unexp_queue = NULL;
 static int bmi_unexp_pending_count = 0;
@@ -49,15 +68,16 @@ static int dev_unexp_pending_count = 0;
 /* locks for internal queues */
 static gen_mutex_t bmi_unexp_mutex = GEN_MUTEX_INITIALIZER;
 static gen_mutex_t dev_unexp_mutex = GEN_MUTEX_INITIALIZER;
+/* serializes testers: reaping the completion queues, cancel and timeout
+ * lookups.  Completions themselves go through completion_ring_array.
+ */
 static gen_mutex_t completion_mutex = GEN_MUTEX_INITIALIZER;
+/* the request scheduler has no locking of its own */
+static gen_mutex_t req_sched_mutex = GEN_MUTEX_INITIALIZER;
 
 static int initialized = 0;
 static gen_mutex_t initialized_mutex = GEN_MUTEX_INITIALIZER;
 
-#ifdef __PVFS2_JOB_THREADED__
-static pthread_cond_t completion_cond = PTHREAD_COND_INITIALIZER;
-#endif /* __PVFS2_JOB_THREADED__ */
-
 /* number of jobs to test for at once inside of do_one_work_cycle() */
 enum
 {
@@ -65,6 +85,11 @@ enum
     thread_wait_timeout = 10000        /* usecs */
 };
 
+/* completions a context can hold before producers fall back to the
+ * locked overflow list
+ */
+#define JOB_COMPLETION_RING_SIZE 16384
+
 /* cap how many keys we dump into trove at once when filling precreate pools
  * so that it doesn't clog up trove queues
  */
@@ -116,6 +141,19 @@ struct precreate_pool_get_trove
 static int setup_queues(void);
 static void teardown_queues(void);
 static int do_one_test_cycle_req_sched(void);
+static void job_desc_posted(struct job_desc *jd);
+static int completion_claim(struct job_desc *jd);
+static void completion_enqueue(struct job_desc *jd);
+static void completion_drain(job_context_id context_id);
+#ifdef __PVFS2_JOB_THREADED__
+static void completion_wake(job_context_id context_id);
+static int completion_wait(job_context_id context_id,
+                           int timeout_ms,
+                           struct timeval *deadline);
+static int req_sched_throttle_wait(job_context_id context_id,
+                                   int timeout_ms,
+                                   struct timeval *deadline);
+#endif
 static void fill_status(struct job_desc *jd,
                         void **returned_user_ptr_p,
                         job_status_s * status);
@@ -123,7 +161,8 @@ static int completion_query_some(job_id_t * id_array,
                                  int *inout_count_p,
                                  int *out_index_array,
                                  void **returned_user_ptr_array,
-                                 job_status_s * out_status_array_p);
+                                 job_status_s * out_status_array_p,
+                                 job_context_id context_id);
 static int completion_query_context(job_id_t * out_id_array_p,
                                   int *inout_count_p,
                                   void **returned_user_ptr_array,
@@ -281,9 +320,52 @@ int job_open_context(job_context_id* context_id)
     }
 
     /* create a new completion queue for the context */
+    completion_ring_array[context_index] =
+        job_desc_ring_new(JOB_COMPLETION_RING_SIZE);
+    if(!completion_ring_array[context_index])
+    {
+        gen_mutex_unlock(&completion_mutex);
+        return(-ENOMEM);
+    }
+
+#ifdef __PVFS2_JOB_THREADED__
+#ifdef HAVE_EVENTFD
+    completion_wake_fd[context_index][0] =
+        eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    completion_wake_fd[context_index][1] =
+        completion_wake_fd[context_index][0];
+    if(completion_wake_fd[context_index][0] < 0)
+#else
+    if(pipe(completion_wake_fd[context_index]) < 0 ||
+        fcntl(completion_wake_fd[context_index][0], F_SETFL,
+            O_NONBLOCK) < 0 ||
+        fcntl(completion_wake_fd[context_index][1], F_SETFL,
+            O_NONBLOCK) < 0)
+#endif
+    {
+        int ret = -errno;
+        gossip_err("Error: job_open_context() failed to create wakeup fd.\n");
+        job_desc_ring_cleanup(completion_ring_array[context_index]);
+        completion_ring_array[context_index] = NULL;
+        gen_mutex_unlock(&completion_mutex);
+        return(ret);
+    }
+    completion_wake_pending[context_index] = 0;
+#endif
+
     completion_queue_array[context_index] = job_desc_q_new();
     if(!completion_queue_array[context_index])
     {
+#ifdef __PVFS2_JOB_THREADED__
+        close(completion_wake_fd[context_index][0]);
+        if(completion_wake_fd[context_index][1] !=
+            completion_wake_fd[context_index][0])
+        {
+            close(completion_wake_fd[context_index][1]);
+        }
+#endif
+        job_desc_ring_cleanup(completion_ring_array[context_index]);
+        completion_ring_array[context_index] = NULL;
         gen_mutex_unlock(&completion_mutex);
         return(-ENOMEM);
     }
@@ -310,8 +392,18 @@ void job_close_context(job_context_id context_id)
     }
 
     job_desc_q_cleanup(completion_queue_array[context_id]);
+    job_desc_ring_cleanup(completion_ring_array[context_id]);
 
     completion_queue_array[context_id] = NULL;
+    completion_ring_array[context_id] = NULL;
+
+#ifdef __PVFS2_JOB_THREADED__
+    close(completion_wake_fd[context_id][0]);
+    if(completion_wake_fd[context_id][1] != completion_wake_fd[context_id][0])
+    {
+        close(completion_wake_fd[context_id][1]);
+    }
+#endif
 
     gen_mutex_unlock(&completion_mutex);
     return;
@@ -402,6 +494,7 @@ int job_bmi_send(PVFS_BMI_addr_t addr,
         out_status_p->error_code = -PVFS_ERROR_CODE(errno);
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.bmi.actual_size = size;
     jd->context_id = context_id;
@@ -454,7 +547,9 @@ int job_bmi_send(PVFS_BMI_addr_t addr,
     *id = jd->job_id;
     bmi_pending_count++;
 
-    return(job_time_mgr_add(jd, timeout_sec));
+    ret = job_time_mgr_add(jd, timeout_sec);
+    job_desc_posted(jd);
+    return(ret);
 }
 
 
@@ -499,6 +594,7 @@ int job_bmi_send_list(PVFS_BMI_addr_t addr,
         out_status_p->error_code = -PVFS_ERROR_CODE(errno);
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.bmi.actual_size = total_size;
     jd->context_id = context_id;
@@ -552,7 +648,9 @@ int job_bmi_send_list(PVFS_BMI_addr_t addr,
      */
     *id = jd->job_id;
     bmi_pending_count++;
-    return(job_time_mgr_add(jd, timeout_sec));
+    ret = job_time_mgr_add(jd, timeout_sec);
+    job_desc_posted(jd);
+    return(ret);
 }
 
 /* job_bmi_recv()
@@ -592,6 +690,7 @@ int job_bmi_recv(PVFS_BMI_addr_t addr,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -633,7 +732,9 @@ int job_bmi_recv(PVFS_BMI_addr_t addr,
     *id = jd->job_id;
     bmi_pending_count++;
 
-    return(job_time_mgr_add(jd, timeout_sec));
+    ret = job_time_mgr_add(jd, timeout_sec);
+    job_desc_posted(jd);
+    return(ret);
 }
 
 
@@ -678,6 +779,7 @@ int job_bmi_recv_list(PVFS_BMI_addr_t addr,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -718,7 +820,9 @@ int job_bmi_recv_list(PVFS_BMI_addr_t addr,
     *id = jd->job_id;
     bmi_pending_count++;
 
-    return(job_time_mgr_add(jd, timeout_sec));
+    ret = job_time_mgr_add(jd, timeout_sec);
+    job_desc_posted(jd);
+    return(ret);
 }
 
 /* job_bmi_unexp()
@@ -818,19 +922,7 @@ int job_bmi_unexp_cancel(job_id_t id)
     bmi_unexp_pending_count--;
     gen_mutex_unlock(&bmi_unexp_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    /* set completed flag while holding queue lock */
-    jd->completed_flag = 1;
-    if (completion_queue_array[jd->context_id])
-    {
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-    }
-
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    gen_mutex_unlock(&completion_mutex);
+    completion_enqueue(jd);
 
     return 0;
 }
@@ -1049,8 +1141,11 @@ int job_dev_write_list(void** buffer_list,
 int job_req_sched_post(enum PVFS_server_op op,
                        PVFS_fs_id fs_id,
                        PVFS_handle handle,
+                       PVFS_offset start,
+                       PVFS_offset end,
                        enum PINT_server_req_access_type access_type,
                        enum PINT_server_sched_policy sched_policy,
+                       const struct PINT_req_sched_flow *flow,
                        void *user_ptr,
                        job_aint status_user_tag,
                        job_status_s * out_status_p,
@@ -1076,13 +1171,16 @@ int job_req_sched_post(enum PVFS_server_op op,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.req_sched.post_flag = 1;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
 
-    ret = PINT_req_sched_post(
-        op, fs_id, handle, access_type, sched_policy, jd, &(jd->u.req_sched.id));
+    gen_mutex_lock(&req_sched_mutex);
+    ret = PINT_req_sched_post(op, fs_id, handle, start, end, access_type,
+        sched_policy, flow, jd, &(jd->u.req_sched.id));
+    gen_mutex_unlock(&req_sched_mutex);
 
     if (ret < 0)
     {
@@ -1109,6 +1207,7 @@ int job_req_sched_post(enum PVFS_server_op op,
      */
     *id = jd->job_id;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1128,12 +1227,15 @@ int job_req_sched_change_mode(enum PVFS_server_mode mode,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.req_sched.post_flag = 1;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
 
+    gen_mutex_lock(&req_sched_mutex);
     ret = PINT_req_sched_change_mode(mode, jd, &(jd->u.req_sched.id));
+    gen_mutex_unlock(&req_sched_mutex);
     if (ret < 0)
     {
         /* error posting */
@@ -1155,6 +1257,7 @@ int job_req_sched_change_mode(enum PVFS_server_mode mode,
     }
 
     *id = jd->job_id;
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1187,11 +1290,14 @@ int job_req_sched_post_timer(int msecs,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
 
+    gen_mutex_lock(&req_sched_mutex);
     ret = PINT_req_sched_post_timer(msecs, jd, &(jd->u.req_sched.id));
+    gen_mutex_unlock(&req_sched_mutex);
 
     if (ret < 0)
     {
@@ -1219,6 +1325,7 @@ int job_req_sched_post_timer(int msecs,
     if (id)
         *id = jd->job_id;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1251,6 +1358,7 @@ int job_req_sched_release(job_id_t in_completed_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -1267,8 +1375,10 @@ int job_req_sched_release(job_id_t in_completed_id,
         return 1;
     }
 
+    gen_mutex_lock(&req_sched_mutex);
     ret = PINT_req_sched_release(match_jd->u.req_sched.id, jd,
                                  &(jd->u.req_sched.id));
+    gen_mutex_unlock(&req_sched_mutex);
 
     /* delete the old req sched job desc; it is no longer needed */
     dealloc_job_desc(match_jd);
@@ -1298,6 +1408,7 @@ int job_req_sched_release(job_id_t in_completed_id,
      */
     *out_id = jd->job_id;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1330,6 +1441,7 @@ int job_flow(flow_descriptor * flow_d,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     flow_d->hints = hints;
     jd->job_user_ptr = user_ptr;
@@ -1366,7 +1478,9 @@ int job_flow(flow_descriptor * flow_d,
     gossip_debug(GOSSIP_FLOW_DEBUG, "Job flows in progress (post time): %d\n",
             flow_pending_count);
 
-    return(job_time_mgr_add(jd, timeout_sec));
+    ret = job_time_mgr_add(jd, timeout_sec);
+    job_desc_posted(jd);
+    return(ret);
 }
 
 /* job_flow_cancel()
@@ -1440,6 +1554,7 @@ int job_trove_bstream_write_list(TROVE_coll_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->hints = hints;
     jd->u.trove.vtag = vtag;
@@ -1495,6 +1610,7 @@ int job_trove_bstream_write_list(TROVE_coll_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 } 
 
@@ -1533,6 +1649,7 @@ int job_trove_bstream_read_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -1586,6 +1703,7 @@ int job_trove_bstream_read_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1620,6 +1738,7 @@ int job_trove_bstream_flush(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -1659,6 +1778,7 @@ int job_trove_bstream_flush(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1699,6 +1819,7 @@ int job_trove_keyval_read(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -1744,6 +1865,7 @@ int job_trove_keyval_read(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1786,6 +1908,7 @@ int job_trove_keyval_read_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -1832,6 +1955,7 @@ int job_trove_keyval_read_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1872,6 +1996,7 @@ int job_trove_keyval_write(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -1918,6 +2043,7 @@ int job_trove_keyval_write(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -1959,6 +2085,7 @@ int job_trove_keyval_write_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -2013,6 +2140,7 @@ int job_trove_keyval_write_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2044,6 +2172,7 @@ int job_trove_keyval_remove_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
     jd->context_id = context_id;
@@ -2092,6 +2221,7 @@ int job_trove_keyval_remove_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2126,6 +2256,7 @@ int job_trove_keyval_flush(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -2167,6 +2298,7 @@ int job_trove_keyval_flush(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2200,6 +2332,7 @@ int job_trove_keyval_get_handle_info(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -2249,6 +2382,91 @@ int job_trove_keyval_get_handle_info(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
+    return (0);
+}
+
+int job_trove_keyval_set_handle_info(PVFS_fs_id coll_id,
+                                     PVFS_handle handle,
+                                     PVFS_ds_flags flags,
+                                     PVFS_ds_keyval_handle_info *info,
+                                     void *user_ptr,
+                                     job_aint status_user_tag,
+                                     job_status_s * out_status_p,
+                                     job_id_t * id,
+                                     job_context_id context_id,
+                                     PVFS_hint hints)
+{
+    /* post a trove operation keyval set handle info.  If it completes (or
+     * fails) immediately, then return and fill in the status
+     * structure.  If it needs to be tested for completion later,
+     * then queue up a job desc structure.
+     */
+
+    int ret = -1;
+    struct job_desc *jd = NULL;
+    void* user_ptr_internal GCC_UNUSED;
+
+    /* create the job desc first, even though we may not use it.  This
+     * gives us somewhere to store the BMI id and user ptr
+     */
+    jd = alloc_job_desc(JOB_TROVE);
+    if (!jd)
+    {
+        out_status_p->error_code = -PVFS_ENOMEM;
+        return 1;
+    }
+    jd->posting = 1;
+    jd->hints = hints;
+    jd->job_user_ptr = user_ptr;
+    jd->context_id = context_id;
+    jd->status_user_tag = status_user_tag;
+    jd->trove_callback.fn = trove_thread_mgr_callback;
+    jd->trove_callback.data = (void*)jd;
+    user_ptr_internal = &jd->trove_callback;
+
+
+
+#ifdef __PVFS2_TROVE_SUPPORT__
+    ret = trove_keyval_set_handle_info(
+        coll_id,
+        handle,
+        flags,
+        info,
+        user_ptr_internal,
+        global_trove_context, &(jd->u.trove.id), hints);
+#else
+    gossip_err("Error: Trove support not enabled.\n");
+    ret = -ENOSYS;
+#endif
+
+    if (ret < 0)
+    {
+        /* error posting trove operation */
+        dealloc_job_desc(jd);
+        jd = NULL;
+        out_status_p->error_code = ret;
+        out_status_p->status_user_tag = status_user_tag;
+        return (1);
+    }
+
+    if (ret == 1)
+    {
+        /* immediate completion */
+        out_status_p->error_code = 0;
+        out_status_p->status_user_tag = status_user_tag;
+        dealloc_job_desc(jd);
+        jd = NULL;
+        return (ret);
+    }
+
+    /* if we fall to this point, the job did not immediately complete and
+     * we must queue up to test it later
+     */
+    *id = jd->job_id;
+    trove_pending_count++;
+
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2289,6 +2507,7 @@ int job_trove_dspace_getattr(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -2334,6 +2553,7 @@ int job_trove_dspace_getattr(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2375,6 +2595,7 @@ int job_trove_dspace_getattr_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -2424,6 +2645,7 @@ int job_trove_dspace_getattr_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2464,6 +2686,7 @@ int job_trove_dspace_setattr(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -2507,6 +2730,7 @@ int job_trove_dspace_setattr(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2548,6 +2772,7 @@ int job_trove_bstream_resize(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -2591,6 +2816,7 @@ int job_trove_bstream_resize(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2653,6 +2879,7 @@ int job_trove_keyval_remove(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -2698,6 +2925,7 @@ int job_trove_keyval_remove(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2762,6 +2990,7 @@ int job_trove_keyval_iterate(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -2813,6 +3042,7 @@ int job_trove_keyval_iterate(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2854,6 +3084,7 @@ int job_trove_keyval_iterate_keys(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
@@ -2905,6 +3136,7 @@ int job_trove_keyval_iterate_keys(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -2943,6 +3175,7 @@ int job_trove_dspace_iterate_handles(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.vtag = vtag;
     jd->u.trove.position = position;
@@ -2993,6 +3226,7 @@ int job_trove_dspace_iterate_handles(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3033,6 +3267,7 @@ int job_trove_dspace_create(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.handle = PVFS_HANDLE_NULL;
@@ -3084,6 +3319,7 @@ int job_trove_dspace_create(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3125,6 +3361,7 @@ int job_trove_dspace_create_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->u.trove.handle = PVFS_HANDLE_NULL;
     jd->context_id = context_id;
@@ -3174,6 +3411,7 @@ int job_trove_dspace_create_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3213,6 +3451,7 @@ int job_trove_dspace_remove_list(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -3260,6 +3499,7 @@ int job_trove_dspace_remove_list(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3299,6 +3539,7 @@ int job_trove_dspace_remove(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -3344,6 +3585,7 @@ int job_trove_dspace_remove(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3381,6 +3623,7 @@ int job_trove_dspace_verify(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -3428,6 +3671,7 @@ int job_trove_dspace_verify(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3498,6 +3742,7 @@ int job_trove_fs_create(char *collname,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -3539,6 +3784,7 @@ int job_trove_fs_create(char *collname,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3672,6 +3918,7 @@ int job_trove_fs_seteattr(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -3715,6 +3962,7 @@ int job_trove_fs_seteattr(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3753,6 +4001,7 @@ int job_trove_fs_geteattr(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -3795,6 +4044,7 @@ int job_trove_fs_geteattr(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3833,6 +4083,7 @@ int job_trove_fs_deleattr(PVFS_fs_id coll_id,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->hints = hints;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
@@ -3876,6 +4127,7 @@ int job_trove_fs_deleattr(PVFS_fs_id coll_id,
     *id = jd->job_id;
     trove_pending_count++;
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -3908,16 +4160,7 @@ int job_null(
     jd->status_user_tag = status_user_tag;
     jd->u.null_info.error_code = error_code;
 
-    gen_mutex_lock(&completion_mutex);
-    job_desc_q_add(completion_queue_array[jd->context_id],
-        jd);
-    /* set completed flag while holding queue lock */
-    jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    gen_mutex_unlock(&completion_mutex);
+    completion_enqueue(jd);
 
     return(0);
 }
@@ -3967,10 +4210,9 @@ int job_testsome(job_id_t * id_array,
                  job_context_id context_id)
 {
     int ret = -1;
-    struct timespec pthread_timeout;
-    struct timeval start;
+    struct timeval deadline;
     int original_count = *inout_count_p;
-    int pthread_ret = -1;
+    int wait_ret = -1;
 
     /* use this as a chance to do a cheap test on the request
      * scheduler
@@ -3983,63 +4225,66 @@ int job_testsome(job_id_t * id_array,
     /* figure out how long to wait if we need to */
     if(timeout_ms > 0)
     {
-        ret = gettimeofday(&start, NULL);
+        ret = gettimeofday(&deadline, NULL);
         if (ret < 0)
         {
             return (ret);
         }
-        pthread_timeout.tv_sec = start.tv_sec + timeout_ms / 1000;
-        pthread_timeout.tv_nsec = (start.tv_usec + ((timeout_ms % 1000)*1000))*1000;
-        if (pthread_timeout.tv_nsec > 1000000000)
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_usec += (timeout_ms % 1000) * 1000;
+        if (deadline.tv_usec >= 1000000)
         {
-            pthread_timeout.tv_nsec = pthread_timeout.tv_nsec - 1000000000;
-            pthread_timeout.tv_sec++;
+            deadline.tv_usec -= 1000000;
+            deadline.tv_sec++;
         }
     }
 
     /* check for completed jobs */
     gen_mutex_lock(&completion_mutex);
-    pthread_ret = 0;
+    wait_ret = 0;
     while(((ret = completion_query_some(id_array,
         inout_count_p,
         out_index_array,
         returned_user_ptr_array,
-        out_status_array_p)) == 0) &&
-        ((pthread_ret == EINTR) || (pthread_ret == 0)))
+        out_status_array_p,
+        context_id)) == 0) &&
+        ((wait_ret == EINTR) || (wait_ret == 0)))
     {
         *inout_count_p = original_count;
 
-        if(timeout_ms > 0)
-        {
-            pthread_ret = pthread_cond_timedwait(&completion_cond,
-                &completion_mutex,
-                &pthread_timeout);
-        }
-        else if(timeout_ms == 0)
+        if(timeout_ms == 0)
         {
-            pthread_ret = ETIMEDOUT;
+            wait_ret = ETIMEDOUT;
+            continue;
         }
-        else
+
+        /* register as a sleeper, then look once more: any job enqueued
+         * after this look will see us and wake us
+         */
+        __atomic_add_fetch(&completion_waiters[context_id], 1,
+            __ATOMIC_SEQ_CST);
+        ret = completion_query_some(id_array, inout_count_p,
+            out_index_array, returned_user_ptr_array, out_status_array_p,
+            context_id);
+        if(ret != 0)
         {
-            /* block indefinitely */
-            pthread_ret = pthread_cond_wait(&completion_cond,
-                &completion_mutex);
+            __atomic_sub_fetch(&completion_waiters[context_id], 1,
+                __ATOMIC_SEQ_CST);
+            break;
         }
+        *inout_count_p = original_count;
+
+        gen_mutex_unlock(&completion_mutex);
+        wait_ret = completion_wait(context_id, timeout_ms, &deadline);
+        __atomic_sub_fetch(&completion_waiters[context_id], 1,
+            __ATOMIC_SEQ_CST);
+        gen_mutex_lock(&completion_mutex);
     }
     gen_mutex_unlock(&completion_mutex);
 
     if(ret == 0)
     {
         *inout_count_p = 0;
-
-        if ((pthread_ret != 0) && (pthread_ret != EINTR) && (pthread_ret !=
-            EINVAL) && pthread_ret != ETIMEDOUT)
-        {
-            /* pthread_cond_wait() gave a weird return code; pass along to
-             * caller
-             */
-            ret = pthread_ret;
-        }
     }
 
     return(ret);
@@ -4084,7 +4329,8 @@ int job_testsome(job_id_t * id_array,
                                  inout_count_p,
                                  out_index_array,
                                  returned_user_ptr_array,
-                                 out_status_array_p);
+                                 out_status_array_p,
+                                 context_id);
     gen_mutex_unlock(&completion_mutex);
     /* return here on error or completion */
     if (ret < 0)
@@ -4137,7 +4383,8 @@ int job_testsome(job_id_t * id_array,
                                      inout_count_p,
                                      out_index_array,
                                      returned_user_ptr_array,
-                                     out_status_array_p);
+                                     out_status_array_p,
+                                     context_id);
         gen_mutex_unlock(&completion_mutex);
         /* return here on error or completion */
         if (ret < 0)
@@ -4207,10 +4454,9 @@ int job_testcontext(job_id_t * out_id_array_p,
                     job_context_id context_id)
 {
     int ret = -1;
-    struct timespec pthread_timeout;
-    struct timeval start;
+    struct timeval deadline;
     int original_count = *inout_count_p;
-    int pthread_ret = -1;
+    int wait_ret = -1;
 
     /* use this as a chance to do a cheap test on the request
      * scheduler
@@ -4223,62 +4469,65 @@ int job_testcontext(job_id_t * out_id_array_p,
     /* figure out how long to wait if we need to */
     if(timeout_ms > 0)
     {
-        ret = gettimeofday(&start, NULL);
+        ret = gettimeofday(&deadline, NULL);
         if (ret < 0)
         {
             return (ret);
         }
-        pthread_timeout.tv_sec = start.tv_sec + timeout_ms / 1000;
-        pthread_timeout.tv_nsec = (start.tv_usec + ((timeout_ms % 1000)*1000))*1000;
-        if (pthread_timeout.tv_nsec > 1000000000)
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_usec += (timeout_ms % 1000) * 1000;
+        if (deadline.tv_usec >= 1000000)
         {
-            pthread_timeout.tv_nsec = pthread_timeout.tv_nsec - 1000000000;
-            pthread_timeout.tv_sec++;
+            deadline.tv_usec -= 1000000;
+            deadline.tv_sec++;
         }
     }
 
     /* check for completed jobs */
     gen_mutex_lock(&completion_mutex);
-    pthread_ret = 0;
+    wait_ret = 0;
     while(((ret = completion_query_context(out_id_array_p,
                              inout_count_p,
                              returned_user_ptr_array,
                              out_status_array_p, context_id)) == 0) &&
-                             ((pthread_ret == EINTR) || (pthread_ret == 0)))
+                             ((wait_ret == EINTR) || (wait_ret == 0)))
     {
         *inout_count_p = original_count;
 
-        if(timeout_ms > 0)
-        {
-            pthread_ret = pthread_cond_timedwait(&completion_cond,
-                &completion_mutex,
-                &pthread_timeout);
-        }
-        else if(timeout_ms == 0)
+        if(timeout_ms == 0)
         {
-            pthread_ret = ETIMEDOUT;
+            wait_ret = ETIMEDOUT;
+            continue;
         }
-        else
+
+        /* register as a sleeper, then look once more: any job enqueued
+         * after this look will see us and wake us
+         */
+        __atomic_add_fetch(&completion_waiters[context_id], 1,
+            __ATOMIC_SEQ_CST);
+        ret = completion_query_context(out_id_array_p,
+            inout_count_p, returned_user_ptr_array, out_status_array_p,
+            context_id);
+        if(ret != 0)
         {
-            /* block indefinitely */
-            pthread_ret = pthread_cond_wait(&completion_cond,
-                &completion_mutex);
+            __atomic_sub_fetch(&completion_waiters[context_id], 1,
+                __ATOMIC_SEQ_CST);
+            break;
         }
+        *inout_count_p = original_count;
+
+        gen_mutex_unlock(&completion_mutex);
+        wait_ret = req_sched_throttle_wait(context_id, timeout_ms,
+            &deadline);
+        __atomic_sub_fetch(&completion_waiters[context_id], 1,
+            __ATOMIC_SEQ_CST);
+        gen_mutex_lock(&completion_mutex);
     }
     gen_mutex_unlock(&completion_mutex);
 
     if(ret == 0)
     {
         *inout_count_p = 0;
-
-        if ((pthread_ret != 0) && (pthread_ret != EINTR) && (pthread_ret !=
-            EINVAL) && pthread_ret != ETIMEDOUT)
-        {
-            /* pthread_cond_wait() gave a weird return code; pass along to
-             * caller
-             */
-            ret = pthread_ret;
-        }
     }
 
     return(ret);
@@ -4529,21 +4778,14 @@ static void precreate_pool_get_thread_mgr_callback_unlocked(
     /* is this job done? */
     if(tmp_trove->jd->u.precreate_pool.trove_pending == 0)
     {
-        gen_mutex_lock(&completion_mutex);
-
-        /* set job descriptor fields and put into completion queue */
-        tmp_trove->jd->u.precreate_pool.error_code = 0;
-        job_desc_q_add(completion_queue_array[tmp_trove->jd->context_id], 
-                       tmp_trove->jd);
-        /* set completed flag while holding queue lock */
-        tmp_trove->jd->completed_flag = 1;
+        struct job_desc *jd = tmp_trove->jd;
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        free(tmp_trove->jd->u.precreate_pool.data);
-        gen_mutex_unlock(&completion_mutex);
+        /* set job descriptor fields and put into completion queue;
+         * tmp_trove lives in the data array, so let go of it first
+         */
+        jd->u.precreate_pool.error_code = 0;
+        free(jd->u.precreate_pool.data);
+        completion_enqueue(jd);
         return;
     }
 
@@ -4573,25 +4815,16 @@ static void precreate_pool_iterate_callback(
     }
     gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (completion_claim(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.precreate_pool.error_code = error_code;
         free(tmp_desc->u.precreate_pool.key_array);
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id], 
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
         trove_pending_count--;
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        completion_enqueue(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 
     return;
 }
@@ -4653,18 +4886,10 @@ static void precreate_pool_fill_thread_mgr_callback(
         gossip_err("Error: unable to write all precreated handles to pool.\n");
         gossip_err("Warning: fsck may be needed to recover stranded handles.\n");
         free(jd->u.precreate_pool.key_array);
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = error_code;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(jd);
         return;
     }
 
@@ -4743,20 +4968,10 @@ static void precreate_pool_fill_thread_mgr_callback(
         jd->u.precreate_pool.precreate_handle_count)
     {
         free(jd->u.precreate_pool.key_array);
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = 0;
-        job_desc_q_add(completion_queue_array[jd->context_id], 
-                       jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(jd);
         return;
     }
 
@@ -4805,18 +5020,10 @@ static void precreate_pool_fill_thread_mgr_callback(
     {
         gossip_err("Error: unable to write all precreated handles to pool.\n");
         gossip_err("Warning: fsck may be needed to recover stranded handles.\n");
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd->u.precreate_pool.error_code = ret;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        /* set completed flag while holding queue lock */
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(jd);
         return;
     }
     else if(ret == 1)
@@ -4857,15 +5064,10 @@ static void trove_thread_mgr_callback(
     }
     gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (completion_claim(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.trove.state = error_code;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
 /* the value of trove_pending_count is only used in the non-threaded
  * situation. so, to prevent reported data races from helgrind, we
@@ -4875,12 +5077,8 @@ static void trove_thread_mgr_callback(
         trove_pending_count--;
 #endif
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        completion_enqueue(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 }
 
 /* bmi_thread_mgr_callback()
@@ -4907,25 +5105,16 @@ static void bmi_thread_mgr_callback(
     }
     gen_mutex_unlock(&initialized_mutex);
 
-    gen_mutex_lock(&completion_mutex);
-    if (tmp_desc->completed_flag == 0)
+    if (completion_claim(tmp_desc))
     {
         /* set job descriptor fields and put into completion queue */
         tmp_desc->u.bmi.error_code = error_code;
         tmp_desc->u.bmi.actual_size = actual_size;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                       tmp_desc);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
 
         bmi_pending_count--;
 
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
+        completion_enqueue(tmp_desc);
     }
-    gen_mutex_unlock(&completion_mutex);
 }
 
 /* bmi_thread_mgr_unexp_handler()
@@ -4961,20 +5150,7 @@ static void bmi_thread_mgr_unexp_handler(
         gen_mutex_unlock(&bmi_unexp_mutex);
         /* set appropriate fields and store in completed queue */
         *(tmp_desc->u.bmi_unexp.info) = *unexp;
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        if (completion_queue_array[tmp_desc->context_id])
-        {
-            job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                           tmp_desc);
-        }
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(tmp_desc);
     }
     else
     {
@@ -5008,20 +5184,7 @@ static void dev_thread_mgr_unexp_handler(struct PINT_dev_unexp_info* unexp)
         gen_mutex_unlock(&dev_unexp_mutex);
         /* set appropriate fields and store in completed queue */
         *(tmp_desc->u.dev_unexp.info) = *unexp;
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        if (completion_queue_array[tmp_desc->context_id])
-        {
-            job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                           tmp_desc);
-        }
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(tmp_desc);
     }
     else
     {
@@ -5124,8 +5287,10 @@ static int do_one_test_cycle_req_sched(void)
     struct job_desc *tmp_desc = NULL;
 
 
+    gen_mutex_lock(&req_sched_mutex);
     ret = PINT_req_sched_testworld(&count, id_array,
                                    user_ptr_array, error_code_array);
+    gen_mutex_unlock(&req_sched_mutex);
 
     if (ret < 0)
     {
@@ -5141,12 +5306,7 @@ static int do_one_test_cycle_req_sched(void)
         tmp_desc = (struct job_desc *) user_ptr_array[i];
         /* set appropriate fields and place in completed queue */
         tmp_desc->u.req_sched.error_code = error_code_array[i];
-        gen_mutex_lock(&completion_mutex);
-        /* set completed flag while holding queue lock */
-        tmp_desc->completed_flag = 1;
-        job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-            tmp_desc);
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(tmp_desc);
     }
 
     return (0);
@@ -5160,7 +5320,8 @@ static int completion_query_some(job_id_t * id_array,
                                  int *inout_count_p,
                                  int *out_index_array,
                                  void **returned_user_ptr_array,
-                                 job_status_s * out_status_array_p)
+                                 job_status_s * out_status_array_p,
+                                 job_context_id context_id)
 {
     int i;
     struct job_desc *tmp_desc;
@@ -5190,11 +5351,15 @@ static int completion_query_some(job_id_t * id_array,
         return (-EINVAL);
     }
 
-    /* don't do anything unless all of the target ops are done */
+    completion_drain(context_id);
+
+    /* don't do anything unless all of the target ops are done; a job
+     * that completed but is still in the ring isn't on the queue yet
+     */
     for(i=0; i<incount; i++)
     {
         tmp_desc = id_gen_safe_lookup(id_array[i]);
-        if(tmp_desc && tmp_desc->completed_flag)
+        if(tmp_desc && tmp_desc->queued)
         {
             done_count++;
         }
@@ -5209,7 +5374,7 @@ static int completion_query_some(job_id_t * id_array,
     for(i=0; i<incount; i++)
     {
         tmp_desc = id_gen_safe_lookup(id_array[i]);
-        if(tmp_desc && tmp_desc->completed_flag)
+        if(tmp_desc && tmp_desc->queued)
         {
             if(returned_user_ptr_array)
             {
@@ -5249,6 +5414,219 @@ static int completion_query_some(job_id_t * id_array,
     return(1);
 }
 
+/* job_desc_posted()
+ *
+ * called by a post function once it no longer touches a job desc that it
+ * handed to a lower level interface.  Until then completion_query_context()
+ * leaves the job on its completion queue, since a state machine thread may
+ * post jobs while the main thread tests for them.
+ *
+ * no return value
+ */
+static void job_desc_posted(struct job_desc *jd)
+{
+#ifdef __PVFS2_JOB_THREADED__
+    job_context_id context_id = jd->context_id;
+#endif
+
+    /* jd may be reaped and freed as soon as this is visible, so we can't
+     * look at completed_flag afterwards; wake any sleeping tester instead
+     */
+    __atomic_store_n(&jd->posting, 0, __ATOMIC_SEQ_CST);
+#ifdef __PVFS2_JOB_THREADED__
+    completion_wake(context_id);
+#endif
+}
+
+/* completion_claim()
+ *
+ * marks a job completed on behalf of a callback that may race with
+ * another completion path for the same job
+ *
+ * returns 1 if the caller should enqueue the job, 0 if it already was
+ */
+static int completion_claim(struct job_desc *jd)
+{
+    return(__sync_bool_compare_and_swap(&jd->completed_flag, 0, 1));
+}
+
+/* completion_enqueue()
+ *
+ * hands a completed job to the test functions for its context.  Lock
+ * free, so any BMI, trove, flow or dev thread can call it; the job must
+ * not be touched afterwards.
+ *
+ * no return value
+ */
+static void completion_enqueue(struct job_desc *jd)
+{
+    job_context_id context_id = jd->context_id;
+
+    jd->completed_flag = 1;
+    if(!completion_ring_array[context_id])
+    {
+        /* context has been closed */
+        return;
+    }
+    job_desc_ring_push(completion_ring_array[context_id], jd);
+#ifdef __PVFS2_JOB_THREADED__
+    completion_wake(context_id);
+#endif
+}
+
+/* completion_drain()
+ *
+ * moves everything producers have pushed for a context onto its
+ * completion queue.  Caller must hold completion_mutex.
+ *
+ * no return value
+ */
+static void completion_drain(job_context_id context_id)
+{
+    struct job_desc *jd;
+
+    if(!completion_ring_array[context_id])
+    {
+        return;
+    }
+    while((jd = job_desc_ring_pop(completion_ring_array[context_id])))
+    {
+        jd->queued = 1;
+        job_desc_q_add(completion_queue_array[context_id], jd);
+    }
+}
+
+#ifdef __PVFS2_JOB_THREADED__
+/* completion_wake()
+ *
+ * wakes testers sleeping on a context, if there are any.  Producers
+ * publish their job before checking, and testers register before their
+ * last look at the queue, so one side always sees the other.
+ *
+ * no return value
+ */
+static void completion_wake(job_context_id context_id)
+{
+    uint64_t one = 1;
+    ssize_t ret;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&completion_waiters[context_id], __ATOMIC_RELAXED) > 0
+        && !__atomic_exchange_n(&completion_wake_pending[context_id], 1,
+            __ATOMIC_SEQ_CST))
+    {
+        /* only the first producer since the tester last woke pays for
+         * the syscall; EAGAIN just means the fd is already readable
+         */
+        ret = write(completion_wake_fd[context_id][1], &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+/* completion_wait()
+ *
+ * sleeps until completion_wake() is called for the context or the
+ * deadline passes; a negative timeout_ms sleeps indefinitely.  The
+ * caller must already be counted in completion_waiters and must not
+ * hold completion_mutex.
+ *
+ * returns 0 when woken, ETIMEDOUT or EINTR otherwise
+ */
+static int completion_wait(job_context_id context_id,
+                           int timeout_ms,
+                           struct timeval *deadline)
+{
+    struct pollfd pfd;
+    struct timeval now;
+    uint64_t count[8];
+    int ret;
+
+    if(timeout_ms > 0)
+    {
+        gettimeofday(&now, NULL);
+        timeout_ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+            (deadline->tv_usec - now.tv_usec) / 1000;
+        if(timeout_ms <= 0)
+        {
+            return(ETIMEDOUT);
+        }
+    }
+
+    pfd.fd = completion_wake_fd[context_id][0];
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, timeout_ms);
+    if(ret == 0)
+    {
+        return(ETIMEDOUT);
+    }
+    if(ret < 0)
+    {
+        return(EINTR);
+    }
+
+    /* reset the fd so that the next sleep blocks again; anything
+     * enqueued before the flag clears is picked up by our next look
+     */
+    while(read(pfd.fd, count, sizeof(count)) > 0)
+    {
+        ;
+    }
+    __atomic_store_n(&completion_wake_pending[context_id], 0,
+        __ATOMIC_SEQ_CST);
+    return(0);
+}
+
+/* req_sched_throttle_wait()
+ *
+ * completion_wait(), except that it wakes up in time to release any
+ * requests the request scheduler is holding back for QoS; nothing
+ * else would test the scheduler for them while the server is idle.
+ *
+ * returns 0 when woken or the scheduler was tested, ETIMEDOUT or
+ * EINTR otherwise
+ */
+static int req_sched_throttle_wait(job_context_id context_id,
+                                   int timeout_ms,
+                                   struct timeval *deadline)
+{
+    struct timeval release;
+    int delay_ms;
+    int ret;
+
+    gen_mutex_lock(&req_sched_mutex);
+    delay_ms = PINT_req_sched_throttle_delay();
+    gen_mutex_unlock(&req_sched_mutex);
+
+    if(delay_ms < 0)
+    {
+        return(completion_wait(context_id, timeout_ms, deadline));
+    }
+
+    gettimeofday(&release, NULL);
+    delay_ms = (delay_ms > 0) ? delay_ms : 1;
+    release.tv_sec += delay_ms / 1000;
+    release.tv_usec += (delay_ms % 1000) * 1000;
+    if(release.tv_usec >= 1000000)
+    {
+        release.tv_usec -= 1000000;
+        release.tv_sec++;
+    }
+    if(timeout_ms > 0 && timercmp(deadline, &release, <))
+    {
+        return(completion_wait(context_id, timeout_ms, deadline));
+    }
+
+    ret = completion_wait(context_id, delay_ms, &release);
+    if(ret == ETIMEDOUT)
+    {
+        ret = do_one_test_cycle_req_sched();
+        ret = (ret < 0) ? EINTR : 0;
+    }
+    return(ret);
+}
+#endif /* __PVFS2_JOB_THREADED__ */
+
 /* completion_query_context()
  *
  * retrieves completed jobs from specified context
@@ -5262,7 +5640,7 @@ static int completion_query_context(job_id_t * out_id_array_p,
                                   out_status_array_p,
                                   job_context_id context_id)
 {
-    struct job_desc *query;
+    struct job_desc *query, *tmp;
     int incount = *inout_count_p;
     *inout_count_p = 0;
 
@@ -5270,11 +5648,24 @@ static int completion_query_context(job_id_t * out_id_array_p,
     {
         return (completion_error);
     }
-    while (*inout_count_p < incount && (query =
-                                        job_desc_q_shownext(
-                                        completion_queue_array[context_id])))
+
+    completion_drain(context_id);
+
+    qlist_for_each_entry_safe(query, tmp,
+                              completion_queue_array[context_id],
+                              job_desc_q_link)
     {
-        assert(query);
+        if (*inout_count_p >= incount)
+        {
+            break;
+        }
+        if (__atomic_load_n(&query->posting, __ATOMIC_SEQ_CST))
+        {
+            /* completed before its post function returned; that thread
+             * may still be writing to it.  job_desc_posted() wakes us.
+             */
+            continue;
+        }
 
         if (returned_user_ptr_array)
         {
@@ -5383,28 +5774,15 @@ static void flow_callback(flow_descriptor* flow_d, int cancel_path)
     }
     gen_mutex_unlock(&initialized_mutex);
 
-    /* set job descriptor fields and put into completion queue */
-
-    /* if this is being triggered directly from PINT_flow_cancel(), then the
-     * completion mutex is already held by the caller; skip the mutex.
+    /* set job descriptor fields and put into completion queue.  This may
+     * be triggered directly from PINT_flow_cancel() with completion_mutex
+     * held (cancel_path); enqueueing doesn't need it either way.
      */
-    if(!cancel_path)
-        gen_mutex_lock(&completion_mutex);
-    job_desc_q_add(completion_queue_array[tmp_desc->context_id],
-                   tmp_desc);
-    /* set completed flag while holding queue lock */
-    tmp_desc->completed_flag = 1;
-
     flow_pending_count--;
     gossip_debug(GOSSIP_FLOW_DEBUG, "Job flows in progress (callback time): %d\n",
             flow_pending_count);
 
-#ifdef __PVFS2_JOB_THREADED__
-    /* wake up anyone waiting for completion */
-    pthread_cond_signal(&completion_cond);
-#endif
-    if(!cancel_path)
-        gen_mutex_unlock(&completion_mutex);
+    completion_enqueue(tmp_desc);
 
     return;
 }
@@ -5448,20 +5826,10 @@ int job_precreate_pool_fill_signal_error(
         qlist_del(&jd_checker->job_desc_q_link);
 
         gossip_debug(GOSSIP_FLOW_DEBUG, "job_precreate_pool_fill_signal_error() waking up a get_handles() caller.\n");
-        gen_mutex_lock(&completion_mutex);
 
         /* set job descriptor fields and put into completion queue */
         jd_checker->u.precreate_pool.error_code = error_code;
-        job_desc_q_add(completion_queue_array[jd_checker->context_id], 
-                       jd_checker);
-        /* set completed flag while holding queue lock */
-        jd_checker->completed_flag = 1;
-
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);
+        completion_enqueue(jd_checker);
     }
     gen_mutex_unlock(&precreate_pool_mutex);
 
@@ -5500,6 +5868,7 @@ int job_precreate_pool_fill(
     {
         return (-errno);
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->status_user_tag = status_user_tag;
@@ -5527,6 +5896,7 @@ int job_precreate_pool_fill(
     /* for the moment, this type of job cannot immediately complete */
 
     *id = jd->job_id;
+    job_desc_posted(jd);
     return (0);
 }
   
@@ -5821,6 +6191,7 @@ int job_precreate_pool_get_handles(
         out_status_p->error_code = -PVFS_ENOMEM;
         return(1);
     }
+    jd->posting = 1;
     jd->job_user_ptr = user_ptr;
     jd->context_id = context_id;
     jd->hints = hints;
@@ -5858,6 +6229,7 @@ int job_precreate_pool_get_handles(
 
     /* for the moment, this type of job cannot immediately complete */
     *id = jd->job_id;
+    job_desc_posted(jd);
     return(0);
 }
 
@@ -5917,15 +6289,8 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
     if(!tmp_trove_array)
     {
         gen_mutex_unlock(&precreate_pool_mutex);
-        gen_mutex_lock(&completion_mutex);        
         jd->u.precreate_pool.error_code = -PVFS_ENOMEM;
-        job_desc_q_add(completion_queue_array[jd->context_id], jd);
-        jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-        /* wake up anyone waiting for completion */
-        pthread_cond_signal(&completion_cond);
-#endif
-        gen_mutex_unlock(&completion_mutex);        
+        completion_enqueue(jd);
         return;
 
     }
@@ -5964,15 +6329,8 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
                 free(tmp_trove_array);
                 gen_mutex_unlock(&precreate_pool_mutex);
 
-                gen_mutex_lock(&completion_mutex);        
                 jd->u.precreate_pool.error_code = -PVFS_EINVAL;
-                job_desc_q_add(completion_queue_array[jd->context_id], jd);
-                jd->completed_flag = 1;
-        #ifdef __PVFS2_JOB_THREADED__
-                /* wake up anyone waiting for completion */
-                pthread_cond_signal(&completion_cond);
-        #endif
-                gen_mutex_unlock(&completion_mutex);        
+                completion_enqueue(jd);
                 return;
             }
         }
@@ -6033,15 +6391,8 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
                 free(tmp_trove_array);
                 gen_mutex_unlock(&precreate_pool_mutex);
 
-                gen_mutex_lock(&completion_mutex);        
                 jd->u.precreate_pool.error_code = -PVFS_EINVAL;
-                job_desc_q_add(completion_queue_array[jd->context_id], jd);
-                jd->completed_flag = 1;
-        #ifdef __PVFS2_JOB_THREADED__
-                /* wake up anyone waiting for completion */
-                pthread_cond_signal(&completion_cond);
-        #endif
-                gen_mutex_unlock(&completion_mutex);        
+                completion_enqueue(jd);
                 return;
             }
         }
@@ -6093,15 +6444,7 @@ static void precreate_pool_get_handles_try_post(struct job_desc* jd)
                     qlist_del(&jd_checker->job_desc_q_link);
 
                     /* move waiting job to completion queue */
-                    gen_mutex_lock(&completion_mutex);        
-                    job_desc_q_add(completion_queue_array[jd->context_id],
-                                   jd_checker);
-                    jd->completed_flag = 1;
-#ifdef __PVFS2_JOB_THREADED__
-                    /* wake up anyone waiting for completion */
-                    pthread_cond_signal(&completion_cond);
-#endif
-                    gen_mutex_unlock(&completion_mutex);        
+                    completion_enqueue(jd_checker);
                 }
             }
         }
@@ -6256,6 +6599,7 @@ int job_precreate_pool_iterate_handles(PVFS_fs_id fsid,
         out_status_p->error_code = -PVFS_ENOMEM;
         return 1;
     }
+    jd->posting = 1;
     jd->u.precreate_pool.key_array = 
                  malloc(count * sizeof(*jd->u.precreate_pool.key_array));
 
@@ -6336,6 +6680,7 @@ int job_precreate_pool_iterate_handles(PVFS_fs_id fsid,
     trove_pending_count++;
     gen_mutex_unlock(&precreate_pool_mutex);
 
+    job_desc_posted(jd);
     return (0);
 }
 
@@ -187,8 +187,11 @@ int job_dev_write_list(void** buffer_list,
 int job_req_sched_post(enum PVFS_server_op op,
                        PVFS_fs_id fs_id,
                        PVFS_handle handle,
+                       PVFS_offset start,
+                       PVFS_offset end,
                        enum PINT_server_req_access_type access_type,
                        enum PINT_server_sched_policy sched_policy,
+                       const struct PINT_req_sched_flow *flow,
 		       void *user_ptr,
 		       job_aint status_user_tag,
 		       job_status_s * out_status_p,
@@ -364,6 +367,18 @@ int job_trove_keyval_get_handle_info(PVFS_fs_id coll_id,
                                      job_context_id context_id,
                                      PVFS_hint hints);
 
+/* overwrite the keyval count of a handle */
+int job_trove_keyval_set_handle_info(PVFS_fs_id coll_id,
+                                     PVFS_handle handle,
+                                     PVFS_ds_flags flags,
+                                     PVFS_ds_keyval_handle_info *info,
+                                     void *user_ptr,
+                                     job_aint status_user_tag,
+                                     job_status_s * out_status_p,
+                                     job_id_t * id,
+                                     job_context_id context_id,
+                                     PVFS_hint hints);
+
 /* read generic dspace attributes */
 int job_trove_dspace_getattr(PVFS_fs_id coll_id,
                              PVFS_handle handle,
@@ -1,10 +1,19 @@
-
 #include "pvfs2-internal.h"
 #include "quicklist.h"
 #include "dbpf-alt-aio.h"
 #include "pthread.h"
 #include "dbpf.h"
+#include "pint-perf-counter.h"
 #include <string.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+/* alt-aio services list I/O with a persistent pool of worker threads.
+ * Each lio_listio() call is split into work items, one per syscall:
+ * aiocbs that target adjacent regions of the same fd with the same
+ * opcode are merged into a single preadv/pwritev.  Workers are started
+ * lazily on first use and live for the lifetime of the process.
+ */
 
 static int alt_lio_listio(int mode, struct aiocb * const list[],
                           int nent, struct sigevent *sig);
@@ -19,131 +28,226 @@ static int alt_aio_fsync(int operation, struct aiocb * aiocbp);
 
 static struct dbpf_aio_ops alt_aio_ops;
 
+extern int TROVE_alt_aio_thread_count;
+
+/* cap on the number of aiocbs merged into one vectored call */
+#ifdef IOV_MAX
+#define ALT_AIO_MAX_MERGE (IOV_MAX < 64 ? IOV_MAX : 64)
+#else
+#define ALT_AIO_MAX_MERGE 16
+#endif
+
+struct alt_aio_batch;
+
+/* one preadv/pwritev worth of aiocbs, sorted by offset */
 struct alt_aio_item
 {
-    struct aiocb *cb_p;
-    struct sigevent *sig;
     struct qlist_head list_link;
-    int master;
-    pthread_t *tids;
-    int nent;
+    struct alt_aio_batch *batch;
+    struct aiocb **cbs;
+    int count;
 };
+
+/* state shared by all the items of a single lio_listio() call */
+struct alt_aio_batch
+{
+    struct sigevent *sig;
+    int mode;
+    int remaining;
+    int done;
+    gen_mutex_t mutex;
+    pthread_cond_t cond;
+    struct alt_aio_item *items;
+    struct aiocb **sorted;
+};
+
+static QLIST_HEAD(alt_aio_queue);
+static gen_mutex_t alt_aio_queue_mutex = GEN_MUTEX_INITIALIZER;
+static pthread_cond_t alt_aio_queue_cond = PTHREAD_COND_INITIALIZER;
+static int alt_aio_threads_started = 0;
+
 static void* alt_lio_thread(void*);
 
-int alt_lio_listio(int mode, struct aiocb * const list[], 
-                   int nent, struct sigevent *sig) 
+static int alt_aio_start_threads(void)
 {
-    struct alt_aio_item* tmp_item;
-    int ret, i;
-    pthread_t *tids;
     pthread_attr_t attr;
-    pthread_t master_tid;
+    pthread_t tid;
+    int i, ret = 0, count;
 
-    tids = (pthread_t *)malloc(sizeof(pthread_t) * nent);
-    if(!tids)
+    gen_mutex_lock(&alt_aio_queue_mutex);
+    if(alt_aio_threads_started)
     {
-        return (-1);
+        gen_mutex_unlock(&alt_aio_queue_mutex);
+        return 0;
     }
-    memset(tids,0,sizeof(pthread_t) * nent);
 
-    for(i = 0; i < nent; ++i)
+    count = (TROVE_alt_aio_thread_count > 0) ?
+        TROVE_alt_aio_thread_count : 1;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for(i = 0; i < count; ++i)
     {
-	int spawnmode= PTHREAD_CREATE_JOINABLE;
-        tmp_item = (struct alt_aio_item*)malloc(sizeof(struct alt_aio_item));
-        if(!tmp_item)
+        ret = pthread_create(&tid, &attr, alt_lio_thread, NULL);
+        if(ret != 0)
         {
-            return (-1);
+            break;
         }
-        memset(tmp_item, 0, sizeof(struct alt_aio_item));
+        alt_aio_threads_started++;
+    }
+    pthread_attr_destroy(&attr);
 
-        if(mode == LIO_NOWAIT && i == (nent - 1))
-        {
-            /* This is the master thread and needs to wait for the others.
-             * We make the master the last thread to get created, so that
-             * we don't end up in a race with the thread ids getting set
-             * properly 
-             */
-            tmp_item->master = 1;
-            tmp_item->tids = tids;
-            tmp_item->nent = nent;
-	    spawnmode= PTHREAD_CREATE_DETACHED;
-        }
+    gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                 "[alt-aio]: started %d of %d worker threads\n",
+                 alt_aio_threads_started, count);
+    gen_mutex_unlock(&alt_aio_queue_mutex);
+
+    if(alt_aio_threads_started == 0)
+    {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+/* orders aiocbs so that mergeable ones end up next to each other */
+static int alt_aio_cb_compare(const void *a, const void *b)
+{
+    const struct aiocb *x = *(struct aiocb * const *)a;
+    const struct aiocb *y = *(struct aiocb * const *)b;
+
+    if(x->aio_fildes != y->aio_fildes)
+    {
+        return (x->aio_fildes < y->aio_fildes) ? -1 : 1;
+    }
+    if(x->aio_lio_opcode != y->aio_lio_opcode)
+    {
+        return (x->aio_lio_opcode < y->aio_lio_opcode) ? -1 : 1;
+    }
+    if(x->aio_offset != y->aio_offset)
+    {
+        return (x->aio_offset < y->aio_offset) ? -1 : 1;
+    }
+    return 0;
+}
+
+static void alt_aio_batch_free(struct alt_aio_batch *batch)
+{
+    gen_mutex_destroy(&batch->mutex);
+    pthread_cond_destroy(&batch->cond);
+    free(batch);
+}
+
+int alt_lio_listio(int mode, struct aiocb * const list[], 
+                   int nent, struct sigevent *sig) 
+{
+    struct alt_aio_batch *batch;
+    struct alt_aio_item *item = NULL;
+    struct aiocb *prev, *cur;
+    int i, item_count = 0, ret = 0;
+
+    if(nent <= 0)
+    {
+        return 0;
+    }
+
+    if(!alt_aio_threads_started && alt_aio_start_threads() != 0)
+    {
+        return (-1);
+    }
 
-        tmp_item->cb_p = list[i];
-        tmp_item->sig = sig;
+    /* batch, item array and sorted aiocb pointers in one allocation */
+    batch = (struct alt_aio_batch *)malloc(
+        sizeof(struct alt_aio_batch) +
+        nent * sizeof(struct alt_aio_item) +
+        nent * sizeof(struct aiocb *));
+    if(!batch)
+    {
+        errno = ENOMEM;
+        return (-1);
+    }
+    memset(batch, 0, sizeof(struct alt_aio_batch));
+    batch->items = (struct alt_aio_item *)(batch + 1);
+    batch->sorted = (struct aiocb **)(batch->items + nent);
+    batch->sig = sig;
+    batch->mode = mode;
+    gen_mutex_init(&batch->mutex);
+    pthread_cond_init(&batch->cond, NULL);
 
+    for(i = 0; i < nent; ++i)
+    {
+        batch->sorted[i] = list[i];
         /* setup state */
 #ifdef HAVE_AIOCB_ERROR_CODE
-        tmp_item->cb_p->__error_code = EINPROGRESS;
+        list[i]->__error_code = EINPROGRESS;
 #endif
+    }
+    qsort(batch->sorted, nent, sizeof(struct aiocb *), alt_aio_cb_compare);
 
-        /* set detached state */
-        ret = pthread_attr_init(&attr);
-        if(ret != 0)
-        {
-            free(tmp_item);
-            errno = ret;
-
-            return(-1);
-        }
-        ret = pthread_attr_setdetachstate(
-            &attr,
-	    spawnmode
-        );
-        if(ret != 0)
-        {
-            free(tmp_item);
-            errno = ret;
-            return(-1);
-        }
-
-        /* create thread to perform I/O and trigger callback */
-        if(mode == LIO_NOWAIT && i == (nent - 1))
+    prev = NULL;
+    for(i = 0; i < nent; ++i)
+    {
+        cur = batch->sorted[i];
+        if(prev && item->count < ALT_AIO_MAX_MERGE &&
+           cur->aio_fildes == prev->aio_fildes &&
+           cur->aio_lio_opcode == prev->aio_lio_opcode &&
+           cur->aio_offset == (prev->aio_offset + prev->aio_nbytes))
         {
-            /* note: in this case don't store the master's tid in the array;
-             * some thread implementations may allow the the
-             * alt_lio_thread() to complete (and try to free the array)
-             * before pthread_create() finishes execution here.
-             */
-            ret = pthread_create(&master_tid, &attr, alt_lio_thread, tmp_item);
+            item->count++;
         }
         else
         {
-            ret = pthread_create(&tids[i], &attr, alt_lio_thread, tmp_item);
-        }
-        if(ret != 0)
-        {
-            int j = 0;
-
-            if(mode == LIO_WAIT)
-            {
-                for(; j < i; ++j)
-                {
-                    pthread_join(tids[j], NULL);
-                }
-            }
-
-            free(tmp_item);
-            free(tids);
-            errno = ret;
-            return(-1);
-        }
-        if (tids)
-        {
-           gossip_debug(GOSSIP_BSTREAM_DEBUG, 
-                        "[alt-aio]: pthread_create completed:"
-                        " id: %d, thread_id: %p\n",
-                        i, (void *)tids[i]);
+            item = &batch->items[item_count++];
+            item->batch = batch;
+            item->cbs = &batch->sorted[i];
+            item->count = 1;
         }
+        prev = cur;
+    }
+    batch->remaining = item_count;
+
+    gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                 "[alt-aio]: listio of %d aiocbs merged into %d calls\n",
+                 nent, item_count);
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_ALTAIO_REQUESTS,
+                    nent, PINT_PERF_ADD);
+    PINT_perf_count(PINT_server_pc, PINT_PERF_ALTAIO_SYSCALLS,
+                    item_count, PINT_PERF_ADD);
+    PINT_perf_count(PINT_server_pc, PINT_PERF_ALTAIO_QUEUE_DEPTH,
+                    item_count, PINT_PERF_ADD);
+
+    /* the batch may complete (and be freed) as soon as the items are
+     * visible to the workers, so nothing below may touch it in the
+     * LIO_NOWAIT case
+     */
+    gen_mutex_lock(&alt_aio_queue_mutex);
+    for(i = 0; i < item_count; ++i)
+    {
+        qlist_add_tail(&batch->items[i].list_link, &alt_aio_queue);
+    }
+    if(item_count == 1)
+    {
+        pthread_cond_signal(&alt_aio_queue_cond);
+    }
+    else
+    {
+        pthread_cond_broadcast(&alt_aio_queue_cond);
     }
+    gen_mutex_unlock(&alt_aio_queue_mutex);
 
-    ret = 0;
     if(mode == LIO_WAIT)
     {
+        gen_mutex_lock(&batch->mutex);
+        while(!batch->done)
+        {
+            pthread_cond_wait(&batch->cond, &batch->mutex);
+        }
+        gen_mutex_unlock(&batch->mutex);
+
         for(i = 0; i < nent; ++i)
         {
-            pthread_join(tids[i], NULL);
-            if(ret != 0 && alt_aio_error(list[i]) != 0)
+            if(alt_aio_error(list[i]) != 0)
             {
                 /* for now we're just overwriting previous errors
                  * since we have no way to store and return them
@@ -154,8 +258,7 @@ int alt_lio_listio(int mode, struct aiocb * const list[],
                 ret = alt_aio_error(list[i]);
             }
         }
-
-        free(tids);
+        alt_aio_batch_free(batch);
     }
     return(ret);
 }
@@ -209,80 +312,145 @@ static int alt_aio_fsync(int operation, struct aiocb * aiocbp)
     return -1;
 }
 
-static void* alt_lio_thread(void* foo)
+/* performs one (possibly merged) item and hands the results back to
+ * the individual aiocbs, in offset order
+ */
+static void alt_aio_item_run(struct alt_aio_item *item)
 {
-    struct alt_aio_item* tmp_item = (struct alt_aio_item*)foo;
-    int ret = 0;
+    struct iovec iov[ALT_AIO_MAX_MERGE];
+    struct aiocb *first = item->cbs[0];
+    ssize_t ret, left, chunk;
+    int i, err = 0;
 
-    if(tmp_item->cb_p->aio_lio_opcode == LIO_READ)
+    if(item->count == 1)
     {
-        ret = pread(tmp_item->cb_p->aio_fildes,
-                    (void*)tmp_item->cb_p->aio_buf,
-                    tmp_item->cb_p->aio_nbytes,
-                    tmp_item->cb_p->aio_offset);
+        if(first->aio_lio_opcode == LIO_READ)
+        {
+            ret = pread(first->aio_fildes, (void*)first->aio_buf,
+                        first->aio_nbytes, first->aio_offset);
+        }
+        else if(first->aio_lio_opcode == LIO_WRITE)
+        {
+            gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                         "[alt-aio]: pwrite: cb_p: %p, "
+                         "fd: %d, bufp: %p, size: %zd off:%llu\n",
+                         first, first->aio_fildes,
+                         first->aio_buf, first->aio_nbytes,
+                         llu(first->aio_offset));
+
+            ret = pwrite(first->aio_fildes, (const void*)first->aio_buf,
+                         first->aio_nbytes, first->aio_offset);
+        }
+        else
+        {
+            /* this should have been caught already */
+            assert(0);
+        }
     }
-    else if(tmp_item->cb_p->aio_lio_opcode == LIO_WRITE)
+    else
     {
-        gossip_debug(GOSSIP_BSTREAM_DEBUG,
-                     "[alt-aio]: pwrite: cb_p: %p, "
-                     "fd: %d, bufp: %p, size: %zd off:%llu\n",
-                     tmp_item->cb_p, tmp_item->cb_p->aio_fildes, 
-                     tmp_item->cb_p->aio_buf, tmp_item->cb_p->aio_nbytes,
-		     llu(tmp_item->cb_p->aio_offset));
-
-        ret = pwrite(tmp_item->cb_p->aio_fildes,
-                     (const void*)tmp_item->cb_p->aio_buf,
-                     tmp_item->cb_p->aio_nbytes,
-                     tmp_item->cb_p->aio_offset);
+        for(i = 0; i < item->count; ++i)
+        {
+            iov[i].iov_base = (void *)item->cbs[i]->aio_buf;
+            iov[i].iov_len = item->cbs[i]->aio_nbytes;
+        }
+
+        if(first->aio_lio_opcode == LIO_READ)
+        {
+            ret = preadv(first->aio_fildes, iov, item->count,
+                         first->aio_offset);
+        }
+        else if(first->aio_lio_opcode == LIO_WRITE)
+        {
+            gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                         "[alt-aio]: pwritev: %d segments, "
+                         "fd: %d, off:%llu\n", item->count,
+                         first->aio_fildes, llu(first->aio_offset));
+
+            ret = pwritev(first->aio_fildes, iov, item->count,
+                          first->aio_offset);
+        }
+        else
+        {
+            /* this should have been caught already */
+            assert(0);
+        }
     }
-    else
+    if(ret < 0)
     {
-        /* this should have been caught already */
-        assert(0);
+        err = errno;
     }
 
-    /* store error and return codes */
-    if(ret < 0)
+    /* store error and return codes; a short transfer is charged to the
+     * segments in order
+     */
+    left = ret;
+    for(i = 0; i < item->count; ++i)
     {
+        if(err)
+        {
 #ifdef HAVE_AIOCB_ERROR_CODE
-        tmp_item->cb_p->__error_code = errno;
+            item->cbs[i]->__error_code = err;
 #endif
-    }
-    else
-    {
+            continue;
+        }
+        chunk = (left > (ssize_t)item->cbs[i]->aio_nbytes) ?
+            (ssize_t)item->cbs[i]->aio_nbytes : left;
+        left -= chunk;
 #ifdef HAVE_AIOCB_ERROR_CODE
-        tmp_item->cb_p->__error_code = 0;
+        item->cbs[i]->__error_code = 0;
 #endif
-
 #ifdef HAVE_AIOCB_RETURN_VALUE
-        tmp_item->cb_p->__return_value = ret;
+        item->cbs[i]->__return_value = chunk;
 #endif
     }
+}
 
-    if(tmp_item->master)
+static void* alt_lio_thread(void* foo)
+{
+    struct alt_aio_item *item;
+    struct alt_aio_batch *batch;
+
+    while(1)
     {
-        int i;
-        /* I'm the master, gotta wait for the others to call notify */
+        gen_mutex_lock(&alt_aio_queue_mutex);
+        while(qlist_empty(&alt_aio_queue))
+        {
+            pthread_cond_wait(&alt_aio_queue_cond, &alt_aio_queue_mutex);
+        }
+        item = qlist_entry(alt_aio_queue.next, struct alt_aio_item,
+                           list_link);
+        qlist_del(&item->list_link);
+        gen_mutex_unlock(&alt_aio_queue_mutex);
+
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ALTAIO_QUEUE_DEPTH,
+                        1, PINT_PERF_SUB);
 
-        /* we skip the last one because that's us */
-        for(i = 0; i < (tmp_item->nent - 1); ++i)
+        alt_aio_item_run(item);
+
+        batch = item->batch;
+        if(__sync_sub_and_fetch(&batch->remaining, 1) != 0)
         {
-            ret = pthread_join(tmp_item->tids[i], NULL);
-            if(ret != 0)
-            {
-                gossip_err("pthread_join failed: %d (%s), i: %d, tid: %p\n",
-                           ret, strerror(ret), i, (void *)tmp_item->tids[i]);
-            }
+            continue;
+        }
+
+        if(batch->mode == LIO_WAIT)
+        {
+            /* the caller is blocked in alt_lio_listio and frees the batch */
+            gen_mutex_lock(&batch->mutex);
+            batch->done = 1;
+            pthread_cond_signal(&batch->cond);
+            gen_mutex_unlock(&batch->mutex);
+            continue;
         }
 
-        free(tmp_item->tids);
         /* run callback fn */
-        tmp_item->sig->sigev_notify_function(tmp_item->sig->sigev_value);
+        if(batch->sig && batch->sig->sigev_notify == SIGEV_THREAD)
+        {
+            batch->sig->sigev_notify_function(batch->sig->sigev_value);
+        }
+        alt_aio_batch_free(batch);
     }
-
-    free(tmp_item);
-
-    pthread_exit(NULL);
     return NULL;
 }
 
@@ -377,7 +545,9 @@ struct TROVE_bstream_ops alt_aio_bstream_ops =
     alt_aio_bstream_read_list,
     alt_aio_bstream_write_list,
     dbpf_bstream_flush,
-    NULL
+    NULL,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
 };
 
 /*
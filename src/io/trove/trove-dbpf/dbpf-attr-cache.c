@@ -10,25 +10,236 @@
 #include "dbpf-attr-cache.h"
 #include "gen-locks.h"
 #include "str-utils.h"
+#include "pint-perf-counter.h"
 #include "pvfs2-internal.h"
 
-/* public mutex lock */
+/*
+  serializes configuration, initialization and finalization of the
+  cache; lookups and updates only take the lock of the shard that
+  holds the key
+*/
 gen_mutex_t dbpf_attr_cache_mutex = GEN_MUTEX_INITIALIZER;
 
+/*
+  hit, miss and eviction counts (and the change in cached bytes) are
+  gathered per shard and only passed on to the server performance
+  counters after this many lookups, so that the shards do not all
+  serialize on the counter lock
+*/
+#define DBPF_ATTR_CACHE_PERF_BATCH 64
+
+/*
+  each shard holds its elements in a hash table for lookup and in a
+  ring that the clock hand sweeps for eviction.  An element that was
+  used since the hand last passed it is spared for one more pass.
+*/
+struct dbpf_attr_cache_shard
+{
+    gen_mutex_t mutex;
+    struct qhash_table *table;
+    struct qlist_head clock_list;
+    struct qlist_head *hand;
+    int num_elems;
+    int bytes;
+
+    int pending_hits;
+    int pending_misses;
+    int pending_evictions;
+    int pending_bytes;
+};
+
 /* these are based on code from src/server/request-scheduler.c */
 static int hash_key(const void *key, int table_size);
 static int hash_key_compare(const void *key, struct qlist_head *link);
 
 static int s_cache_size = DBPF_ATTR_CACHE_DEFAULT_SIZE;
-static int s_max_num_cache_elems = 
+static int s_max_num_cache_elems =
 DBPF_ATTR_CACHE_DEFAULT_MAX_NUM_CACHE_ELEMS;
-static struct qhash_table *s_key_to_attr_table = NULL;
+static int s_max_bytes = DBPF_ATTR_CACHE_DEFAULT_MAX_BYTES;
 static char **s_cacheable_keyword_array = NULL;
 static int s_cacheable_keyword_array_size = 0;
-static int s_current_num_cache_elems = 0;
+
+static struct dbpf_attr_cache_shard s_shards[DBPF_ATTR_CACHE_SHARDS];
+static int s_shard_max_num_elems = 0;
+static int s_shard_max_bytes = 0;
+static int s_shard_mutexes_initialized = 0;
+static volatile int s_initialized = 0;
 
 #define DBPF_ATTR_CACHE_INITIALIZED() \
-(s_key_to_attr_table)
+(s_initialized)
+
+/* mixes the key so that shards and buckets are chosen independently */
+static unsigned long key_mix(const TROVE_object_ref *ref)
+{
+    unsigned long tmp = 0;
+
+    tmp = (ref->fs_id << 12);
+    tmp += ref->handle;
+    return tmp;
+}
+
+static struct dbpf_attr_cache_shard *key_to_shard(TROVE_object_ref key)
+{
+    return &s_shards[key_mix(&key) % DBPF_ATTR_CACHE_SHARDS];
+}
+
+void dbpf_attr_cache_lock(TROVE_object_ref key)
+{
+    if (DBPF_ATTR_CACHE_INITIALIZED())
+    {
+        gen_mutex_lock(&key_to_shard(key)->mutex);
+    }
+}
+
+void dbpf_attr_cache_unlock(TROVE_object_ref key)
+{
+    if (DBPF_ATTR_CACHE_INITIALIZED())
+    {
+        gen_mutex_unlock(&key_to_shard(key)->mutex);
+    }
+}
+
+/* hands the counts gathered by a shard to the performance counters */
+static void shard_perf_flush(struct dbpf_attr_cache_shard *shard)
+{
+    if (shard->pending_hits)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTRCACHE_HITS,
+                        shard->pending_hits, PINT_PERF_ADD);
+    }
+    if (shard->pending_misses)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTRCACHE_MISSES,
+                        shard->pending_misses, PINT_PERF_ADD);
+    }
+    if (shard->pending_evictions)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTRCACHE_EVICTIONS,
+                        shard->pending_evictions, PINT_PERF_ADD);
+    }
+    if (shard->pending_bytes > 0)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTRCACHE_BYTES,
+                        shard->pending_bytes, PINT_PERF_ADD);
+    }
+    else if (shard->pending_bytes < 0)
+    {
+        PINT_perf_count(PINT_server_pc, PINT_PERF_ATTRCACHE_BYTES,
+                        -shard->pending_bytes, PINT_PERF_SUB);
+    }
+    shard->pending_hits = 0;
+    shard->pending_misses = 0;
+    shard->pending_evictions = 0;
+    shard->pending_bytes = 0;
+}
+
+static void shard_count_lookup(struct dbpf_attr_cache_shard *shard, int hit)
+{
+    if (hit)
+    {
+        shard->pending_hits++;
+    }
+    else
+    {
+        shard->pending_misses++;
+    }
+    if ((shard->pending_hits + shard->pending_misses) >=
+        DBPF_ATTR_CACHE_PERF_BATCH)
+    {
+        shard_perf_flush(shard);
+    }
+}
+
+static void shard_charge(struct dbpf_attr_cache_shard *shard,
+                         dbpf_attr_cache_elem_t *cache_elem, int bytes)
+{
+    cache_elem->bytes += bytes;
+    shard->bytes += bytes;
+    shard->pending_bytes += bytes;
+}
+
+/* unlinks an element from its shard and frees it with its keyval data */
+static void shard_remove_elem(struct dbpf_attr_cache_shard *shard,
+                              dbpf_attr_cache_elem_t *cache_elem)
+{
+    int i = 0;
+
+    if (shard->hand == &cache_elem->clock_link)
+    {
+        shard->hand = cache_elem->clock_link.next;
+    }
+    qlist_del(&cache_elem->clock_link);
+    qhash_del(&cache_elem->hash_link);
+
+    for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+    {
+        cache_elem->keyval_pairs[i].key = NULL;
+        if (cache_elem->keyval_pairs[i].data)
+        {
+            free(cache_elem->keyval_pairs[i].data);
+            cache_elem->keyval_pairs[i].data = NULL;
+        }
+    }
+    shard->num_elems--;
+    shard->bytes -= cache_elem->bytes;
+    shard->pending_bytes -= cache_elem->bytes;
+    free(cache_elem);
+}
+
+static int shard_over_limit(struct dbpf_attr_cache_shard *shard, int extra)
+{
+    return (((shard->num_elems + extra) > s_shard_max_num_elems) ||
+            (s_shard_max_bytes &&
+             (shard->bytes > s_shard_max_bytes)));
+}
+
+/*
+  advances the clock hand of a shard, evicting unreferenced elements
+  until there is room for extra more; never evicts keep
+*/
+static void shard_evict(struct dbpf_attr_cache_shard *shard,
+                        dbpf_attr_cache_elem_t *keep, int extra)
+{
+    dbpf_attr_cache_elem_t *cache_elem = NULL;
+
+    while(shard_over_limit(shard, extra) &&
+          (shard->num_elems > (keep ? 1 : 0)))
+    {
+        if (shard->hand == &shard->clock_list)
+        {
+            shard->hand = shard->hand->next;
+            continue;
+        }
+        cache_elem = qlist_entry(
+            shard->hand, dbpf_attr_cache_elem_t, clock_link);
+        shard->hand = shard->hand->next;
+
+        if ((cache_elem == keep) || cache_elem->referenced)
+        {
+            cache_elem->referenced = 0;
+            continue;
+        }
+
+        gossip_debug(
+            GOSSIP_DBPF_ATTRCACHE_DEBUG, "*** Cache is full -- "
+            "evicting key %llu\n", llu(cache_elem->key.handle));
+        shard_remove_elem(shard, cache_elem);
+        shard->pending_evictions++;
+    }
+}
+
+static dbpf_attr_cache_elem_t *shard_lookup(
+    struct dbpf_attr_cache_shard *shard, TROVE_object_ref key)
+{
+    struct qlist_head *hash_link = NULL;
+
+    hash_link = qhash_search(shard->table, &(key));
+    if (hash_link)
+    {
+        return qhash_entry(hash_link, dbpf_attr_cache_elem_t, hash_link);
+    }
+    return NULL;
+}
 
 int dbpf_attr_cache_set_keywords(char *keywords)
 {
@@ -41,7 +252,7 @@ int dbpf_attr_cache_set_keywords(char *keywords)
     return (s_cacheable_keyword_array ? 0 : -1);
 }
 
-       
+
 int dbpf_attr_cache_set_size(int cache_size)
 {
     s_cache_size = cache_size;
@@ -54,6 +265,12 @@ int dbpf_attr_cache_set_max_num_elems(int max_num_elems)
     return 0;
 }
 
+int dbpf_attr_cache_set_max_bytes(int max_bytes)
+{
+    s_max_bytes = max_bytes;
+    return 0;
+}
+
 /*
   the idea is that the other parameters are filled in
   by setinfo calls so that by the time this is called,
@@ -79,8 +296,9 @@ int dbpf_attr_cache_initialize(
     int num_cacheable_keywords)
 {
     int ret = -1, i = 0;
+    struct dbpf_attr_cache_shard *shard = NULL;
 
-    if (s_key_to_attr_table == NULL)
+    if (!DBPF_ATTR_CACHE_INITIALIZED())
     {
         if (cacheable_keywords)
         {
@@ -112,19 +330,60 @@ int dbpf_attr_cache_initialize(
             }
         }
 
-        s_current_num_cache_elems = 0;
         s_max_num_cache_elems = cache_max_num_elems;
-        s_key_to_attr_table = qhash_init(
-            hash_key_compare, hash_key, table_size);
-        if (!s_key_to_attr_table)
+        s_shard_max_num_elems = ((cache_max_num_elems +
+                                  DBPF_ATTR_CACHE_SHARDS - 1) /
+                                 DBPF_ATTR_CACHE_SHARDS);
+        if (s_shard_max_num_elems < 1)
         {
-            goto return_error;
+            s_shard_max_num_elems = 1;
+        }
+        s_shard_max_bytes = 0;
+        if (s_max_bytes > 0)
+        {
+            s_shard_max_bytes = s_max_bytes / DBPF_ATTR_CACHE_SHARDS;
+            if (s_shard_max_bytes < (int)sizeof(dbpf_attr_cache_elem_t))
+            {
+                s_shard_max_bytes = sizeof(dbpf_attr_cache_elem_t);
+            }
         }
 
-        srand((unsigned int)time(NULL));
+        for(i = 0; i < DBPF_ATTR_CACHE_SHARDS; i++)
+        {
+            shard = &s_shards[i];
+            if (!s_shard_mutexes_initialized)
+            {
+                gen_mutex_init(&shard->mutex);
+            }
+            shard->table = qhash_init(
+                hash_key_compare, hash_key,
+                (table_size / DBPF_ATTR_CACHE_SHARDS) + 1);
+            if (!shard->table)
+            {
+                while(--i >= 0)
+                {
+                    qhash_finalize(s_shards[i].table);
+                    s_shards[i].table = NULL;
+                }
+                goto return_error;
+            }
+            INIT_QLIST_HEAD(&shard->clock_list);
+            shard->hand = &shard->clock_list;
+            shard->num_elems = 0;
+            shard->bytes = 0;
+            shard->pending_hits = 0;
+            shard->pending_misses = 0;
+            shard->pending_evictions = 0;
+            shard->pending_bytes = 0;
+        }
+        s_shard_mutexes_initialized = 1;
+        s_initialized = 1;
 
         gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                     "dbpf_attr_cache_initialize: initialized\n");
+                     "dbpf_attr_cache_initialize: initialized "
+                     "(%d shards of at most %d elems, %d bytes)\n",
+                     DBPF_ATTR_CACHE_SHARDS, s_shard_max_num_elems,
+                     s_shard_max_bytes);
         ret = 0;
     }
     else
@@ -140,39 +399,30 @@ int dbpf_attr_cache_initialize(
 
 int dbpf_attr_cache_finalize(void)
 {
-    int ret = -1, i = 0, j = 0;
-    struct qlist_head *hash_link = NULL;
+    int i = 0;
+    struct dbpf_attr_cache_shard *shard = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
     if (DBPF_ATTR_CACHE_INITIALIZED())
     {
-        for(i = 0; i < s_key_to_attr_table->table_size; i++)
+        for(i = 0; i < DBPF_ATTR_CACHE_SHARDS; i++)
         {
-            do
+            shard = &s_shards[i];
+            gen_mutex_lock(&shard->mutex);
+            while(!qlist_empty(&shard->clock_list))
             {
-                hash_link = qhash_search_and_remove_at_index(
-                    s_key_to_attr_table,i);
-                if (hash_link)
-                {
-                    cache_elem = qhash_entry(
-                        hash_link, dbpf_attr_cache_elem_t, hash_link);
-                    for( j = 0; j < cache_elem->num_keyval_pairs; j++ )
-                    {
-                        /* any elements still existing need their keyval pairs
-                         * data pointer free'd before the element is free'd */
-                        if( cache_elem->keyval_pairs[j].data )
-                            free(cache_elem->keyval_pairs[j].data);
-                    }
-                    free(cache_elem);
-                    s_current_num_cache_elems--;
-                }
-            } while(hash_link);
+                cache_elem = qlist_entry(shard->clock_list.next,
+                                         dbpf_attr_cache_elem_t,
+                                         clock_link);
+                shard_remove_elem(shard, cache_elem);
+            }
+            assert(shard->num_elems == 0);
+            shard_perf_flush(shard);
+            qhash_finalize(shard->table);
+            shard->table = NULL;
+            gen_mutex_unlock(&shard->mutex);
         }
-
-        assert(s_current_num_cache_elems == 0);
-        ret = ((i == s_key_to_attr_table->table_size) ? 0 : -1);
-        qhash_finalize(s_key_to_attr_table);
-        s_key_to_attr_table = NULL;
+        s_initialized = 0;
 
         gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG,
                      "dbpf_attr_cache_finalized\n");
@@ -185,27 +435,22 @@ int dbpf_attr_cache_finalize(void)
         s_cacheable_keyword_array = NULL;
         s_cacheable_keyword_array_size = 0;
     }
-    return ret;
+    return 0;
 }
 
 dbpf_attr_cache_elem_t *dbpf_attr_cache_elem_lookup(TROVE_object_ref key)
 {
-    struct qlist_head *hash_link = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
     if (DBPF_ATTR_CACHE_INITIALIZED())
     {
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (hash_link)
+        cache_elem = shard_lookup(key_to_shard(key), key);
+        if (cache_elem)
         {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
             gossip_debug(
                 GOSSIP_DBPF_ATTRCACHE_DEBUG,
                 "dbpf_cache_elem_lookup: cache "
-                "elem matching %llu returned (num_elems=%d)\n",
-                llu(key.handle), s_current_num_cache_elems);
+                "elem matching %llu returned\n", llu(key.handle));
         }
     }
     return cache_elem;
@@ -220,15 +465,12 @@ int dbpf_attr_cache_ds_attr_update_cached_data(
     cache_elem = dbpf_attr_cache_elem_lookup(key);
     if (cache_elem && src_ds_attr)
     {
-        if (cache_elem && src_ds_attr)
-        {
-            memcpy(&cache_elem->attr, src_ds_attr,
-                   sizeof(TROVE_ds_attributes));
-            gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
-                         "cached attributes for key %llu\n",
-                         llu(key.handle));
-            ret = 0;
-        }
+        memcpy(&cache_elem->attr, src_ds_attr,
+               sizeof(TROVE_ds_attributes));
+        gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
+                     "cached attributes for key %llu\n",
+                     llu(key.handle));
+        ret = 0;
     }
     return ret;
 }
@@ -242,14 +484,11 @@ int dbpf_attr_cache_ds_attr_update_cached_data_bsize(
     cache_elem = dbpf_attr_cache_elem_lookup(key);
     if (cache_elem)
     {
-        if (cache_elem)
-        {
-            cache_elem->attr.u.datafile.b_size = b_size;
-            gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
-                         "cached b_size for key %llu\n",
-                         llu(key.handle));
-            ret = 0;
-        }
+        cache_elem->attr.u.datafile.b_size = b_size;
+        gossip_debug(GOSSIP_DBPF_ATTRCACHE_DEBUG, "Updating "
+                     "cached b_size for key %llu\n",
+                     llu(key.handle));
+        ret = 0;
     }
     return ret;
 }
@@ -258,33 +497,38 @@ int dbpf_attr_cache_ds_attr_fetch_cached_data(
     TROVE_object_ref key, TROVE_ds_attributes *target_ds_attr)
 {
     int ret = -1;
-    struct qlist_head *hash_link = NULL;
+    struct dbpf_attr_cache_shard *shard = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
     if (DBPF_ATTR_CACHE_INITIALIZED() && target_ds_attr)
     {
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (hash_link)
+        shard = key_to_shard(key);
+        cache_elem = shard_lookup(shard, key);
+        if (cache_elem)
         {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
             memcpy(target_ds_attr, &cache_elem->attr,
                    sizeof(TROVE_ds_attributes));
+            cache_elem->referenced = 1;
             ret = 0;
         }
+        shard_count_lookup(shard, (ret == 0));
     }
     return ret;
 }
 
+/*
+  cache_elem may be NULL, in which case the lookup that failed to find
+  it is counted as a miss
+*/
 dbpf_keyval_pair_cache_elem_t *dbpf_attr_cache_elem_get_data_based_on_key(
     dbpf_attr_cache_elem_t *cache_elem, char *key)
 {
     int i = 0;
+    struct dbpf_attr_cache_shard *shard = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED() &&
-        (cache_elem && key && cache_elem->num_keyval_pairs))
+    if (DBPF_ATTR_CACHE_INITIALIZED() && cache_elem && key)
     {
+        shard = key_to_shard(cache_elem->key);
         for(i = 0; i < cache_elem->num_keyval_pairs; i++)
         {
             if ((strcmp(cache_elem->keyval_pairs[i].key, key) == 0) &&
@@ -296,9 +540,12 @@ dbpf_keyval_pair_cache_elem_t *dbpf_attr_cache_elem_get_data_based_on_key(
                     cache_elem->keyval_pairs[i].data,
                     llu(cache_elem->key.handle), key,
                     cache_elem->keyval_pairs[i].data_sz);
+                cache_elem->referenced = 1;
+                shard_count_lookup(shard, 1);
                 return &cache_elem->keyval_pairs[i];
             }
         }
+        shard_count_lookup(shard, 0);
     }
     return NULL;
 }
@@ -307,36 +554,47 @@ int dbpf_attr_cache_elem_set_data_based_on_key(
     TROVE_object_ref key, char *key_str, void *data, int data_sz)
 {
     int ret = - 1, i = 0;
+    struct dbpf_attr_cache_shard *shard = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
+    void *new_data = NULL;
 
     cache_elem = dbpf_attr_cache_elem_lookup(key);
-    if (cache_elem && key_str && cache_elem->num_keyval_pairs)
+    if (!cache_elem || !key_str || !cache_elem->num_keyval_pairs)
     {
-        if (!cache_elem || !cache_elem->num_keyval_pairs)
-        {
-            return ret;
-        }
-        for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+        return ret;
+    }
+
+    shard = key_to_shard(key);
+    for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+    {
+        if (strcmp(cache_elem->keyval_pairs[i].key, key_str) == 0)
         {
-            if (strcmp(cache_elem->keyval_pairs[i].key, key_str) == 0)
-            {
-                gossip_debug(
-                    GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                    "Setting data %p based on key "
-                    "%llu and key_str %s (data_sz=%d)\n", data,
-                    llu(key.handle), key_str, data_sz);
+            gossip_debug(
+                GOSSIP_DBPF_ATTRCACHE_DEBUG,
+                "Setting data %p based on key "
+                "%llu and key_str %s (data_sz=%d)\n", data,
+                llu(key.handle), key_str, data_sz);
 
-                if (cache_elem->keyval_pairs[i].data)
-                {
-                    free(cache_elem->keyval_pairs[i].data);
-                }
-                cache_elem->keyval_pairs[i].data = malloc(data_sz);
-                assert(cache_elem->keyval_pairs[i].data);
-                memcpy(cache_elem->keyval_pairs[i].data, data, data_sz);
-                cache_elem->keyval_pairs[i].data_sz = data_sz;
-                ret = 0;
+            new_data = malloc(data_sz);
+            if (!new_data)
+            {
                 break;
             }
+            memcpy(new_data, data, data_sz);
+            if (cache_elem->keyval_pairs[i].data)
+            {
+                free(cache_elem->keyval_pairs[i].data);
+                shard_charge(shard, cache_elem,
+                             -cache_elem->keyval_pairs[i].data_sz);
+            }
+            cache_elem->keyval_pairs[i].data = new_data;
+            cache_elem->keyval_pairs[i].data_sz = data_sz;
+            shard_charge(shard, cache_elem, data_sz);
+
+            /* make room for the new data elsewhere in the shard */
+            shard_evict(shard, cache_elem, 0);
+            ret = 0;
+            break;
         }
     }
     return ret;
@@ -371,148 +629,94 @@ int dbpf_attr_cache_insert(
     TROVE_object_ref key,
     TROVE_ds_attributes *attr)
 {
-    int ret = -1, i = 0, already_exists = 0;
+    int ret = -1, i = 0;
+    struct dbpf_attr_cache_shard *shard = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
-    struct qlist_head *hash_link = NULL;
 
-    if (DBPF_ATTR_CACHE_INITIALIZED())
+    if (!DBPF_ATTR_CACHE_INITIALIZED())
     {
-        if ((s_current_num_cache_elems + 1) > s_max_num_cache_elems)
-        {
-            TROVE_object_ref sacrificial_lamb_key =
-                {TROVE_HANDLE_NULL, TROVE_COLL_ID_NULL};
-            /*
-              we have the lock, so we can safely remove
-              any element in this cache at this point;
-              since our hashtable isn't sorted, and a hit/age
-              count would be too costly in a linear search
-              here, just remove the first element at an arbitrary
-              hashed index that we can find in the hash table
-            */
-            i = (rand() % s_key_to_attr_table->table_size);
-          hashtable_linear_scan:
-            for(; i < s_key_to_attr_table->table_size; i++)
-            {
-                hash_link =
-                    qhash_search_at_index(s_key_to_attr_table,i);
-                if (hash_link)
-                {
-                    cache_elem = qhash_entry(
-                        hash_link, dbpf_attr_cache_elem_t, hash_link);
-                    sacrificial_lamb_key = cache_elem->key;
-                    break;
-                }
-            }
+        return ret;
+    }
 
-            /*
-              handle a special case where the random index
-              yields a completely empty linked list; start again
-              at 0, as *something* must be in the hash table
-            */
-            if ((i == s_key_to_attr_table->table_size) &&
-                (sacrificial_lamb_key.handle == TROVE_HANDLE_NULL))
+    shard = key_to_shard(key);
+    cache_elem = shard_lookup(shard, key);
+    if (cache_elem)
+    {
+        /*
+          the attributes are replaced, and keyval data cached for the
+          object is dropped along with them
+        */
+        for(i = 0; i < cache_elem->num_keyval_pairs; i++)
+        {
+            if (cache_elem->keyval_pairs[i].data)
             {
-                i = 0;
-                goto hashtable_linear_scan;
+                free(cache_elem->keyval_pairs[i].data);
+                cache_elem->keyval_pairs[i].data = NULL;
+                shard_charge(shard, cache_elem,
+                             -cache_elem->keyval_pairs[i].data_sz);
             }
-            assert(sacrificial_lamb_key.handle != TROVE_HANDLE_NULL);
-            gossip_debug(
-                GOSSIP_DBPF_ATTRCACHE_DEBUG, "*** Cache is full -- "
-                "removing key %llu to insert key %llu\n",
-                llu(sacrificial_lamb_key.handle), llu(key.handle));
-            dbpf_attr_cache_remove(sacrificial_lamb_key);
-        }
-
-        hash_link = qhash_search(s_key_to_attr_table,&(key));
-        if (!hash_link)
-        {
-            cache_elem = (dbpf_attr_cache_elem_t *)
-                malloc(sizeof(dbpf_attr_cache_elem_t));
-        }
-        else
-        {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            already_exists = 1;
         }
+        memcpy(&(cache_elem->attr), attr, sizeof(TROVE_ds_attributes));
+        return 0;
+    }
 
-        if (cache_elem)
-        {
-            if (!already_exists)
-            {
-                memset(cache_elem, 0, sizeof(dbpf_attr_cache_elem_t));
-            }
+    shard_evict(shard, NULL, 1);
 
-            if (s_cacheable_keyword_array)
-            {
-                /* initialize all of the keyvals we're able to cache */
-                for(i = 0; i < s_cacheable_keyword_array_size; i++)
-                {
-                    cache_elem->keyval_pairs[i].key =
-                        s_cacheable_keyword_array[i];
-                    cache_elem->keyval_pairs[i].data = NULL;
-                }
-                cache_elem->num_keyval_pairs =
-                    s_cacheable_keyword_array_size;
-            }
+    cache_elem = (dbpf_attr_cache_elem_t *)
+        malloc(sizeof(dbpf_attr_cache_elem_t));
+    if (cache_elem)
+    {
+        memset(cache_elem, 0, sizeof(dbpf_attr_cache_elem_t));
 
-            cache_elem->key = key;
-            memcpy(&(cache_elem->attr), attr,
-                   sizeof(TROVE_ds_attributes));
-            if (!already_exists)
+        if (s_cacheable_keyword_array)
+        {
+            /* initialize all of the keyvals we're able to cache */
+            for(i = 0; i < s_cacheable_keyword_array_size; i++)
             {
-                qhash_add(
-                    s_key_to_attr_table,&(key),&(cache_elem->hash_link));
-                s_current_num_cache_elems++;
-                gossip_debug(
-                    GOSSIP_DBPF_ATTRCACHE_DEBUG,
-                    "dbpf_attr_cache_insert: inserting %llu "
-                    "(b_size is %llu)\n", llu(key.handle),
-                    llu(cache_elem->attr.u.datafile.b_size));
+                cache_elem->keyval_pairs[i].key =
+                    s_cacheable_keyword_array[i];
+                cache_elem->keyval_pairs[i].data = NULL;
             }
-            ret = 0;
+            cache_elem->num_keyval_pairs =
+                s_cacheable_keyword_array_size;
         }
+
+        cache_elem->key = key;
+        memcpy(&(cache_elem->attr), attr,
+               sizeof(TROVE_ds_attributes));
+
+        qhash_add(shard->table, &(key), &(cache_elem->hash_link));
+        /* new elements go just behind the hand, to be visited last */
+        qlist_add_tail(&cache_elem->clock_link, shard->hand);
+        shard->num_elems++;
+        shard_charge(shard, cache_elem, sizeof(dbpf_attr_cache_elem_t));
+        gossip_debug(
+            GOSSIP_DBPF_ATTRCACHE_DEBUG,
+            "dbpf_attr_cache_insert: inserting %llu "
+            "(b_size is %llu)\n", llu(key.handle),
+            llu(cache_elem->attr.u.datafile.b_size));
+        ret = 0;
     }
     return ret;
 }
 
 int dbpf_attr_cache_remove(TROVE_object_ref key)
 {
-    int ret = -1, i = 0;
-    struct qlist_head *hash_link = NULL;
+    int ret = -1;
+    struct dbpf_attr_cache_shard *shard = NULL;
     dbpf_attr_cache_elem_t *cache_elem = NULL;
 
     if (DBPF_ATTR_CACHE_INITIALIZED())
     {
-        hash_link = qhash_search_and_remove(s_key_to_attr_table,&(key));
-        if (hash_link)
+        shard = key_to_shard(key);
+        cache_elem = shard_lookup(shard, key);
+        if (cache_elem)
         {
-            cache_elem = qhash_entry(
-                hash_link, dbpf_attr_cache_elem_t, hash_link);
-            assert(cache_elem);
-
             gossip_debug(
                 GOSSIP_DBPF_ATTRCACHE_DEBUG, "dbpf_attr_cache_remove: "
                 "removing %llu\n", llu(key.handle));
 
-            /* free any keyval data cached as well */
-            if (s_cacheable_keyword_array)
-            {
-                /* free all of the keyvals we've cached */
-                assert(s_cacheable_keyword_array_size ==
-                       cache_elem->num_keyval_pairs);
-                for(i = 0; i < cache_elem->num_keyval_pairs; i++)
-                {
-                    cache_elem->keyval_pairs[i].key = NULL;
-                    if (cache_elem->keyval_pairs[i].data)
-                    {
-                        free(cache_elem->keyval_pairs[i].data);
-                        cache_elem->keyval_pairs[i].data = NULL;
-                    }
-                }
-            }
-            free(cache_elem);
-            s_current_num_cache_elems--;
+            shard_remove_elem(shard, cache_elem);
             ret = 0;
         }
     }
@@ -521,7 +725,7 @@ int dbpf_attr_cache_remove(TROVE_object_ref key)
 
 /* hash_key()
  *
- * hash function for fsids added to table
+ * hash function for object refs added to a shard's table
  *
  * returns integer offset into table
  */
@@ -530,8 +734,8 @@ static int hash_key(const void *key, int table_size)
     unsigned long tmp = 0;
     const TROVE_object_ref *ref = (const TROVE_object_ref *)key;
 
-    tmp = (ref->fs_id << 12);
-    tmp += ref->handle;
+    /* the low bits were already used to pick the shard */
+    tmp = key_mix(ref) / DBPF_ATTR_CACHE_SHARDS;
     tmp = (tmp % table_size);
 
     return ((int)tmp);
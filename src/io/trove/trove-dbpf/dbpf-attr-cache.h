@@ -20,6 +20,13 @@
 
 #define DBPF_ATTR_CACHE_DEFAULT_SIZE                  511
 #define DBPF_ATTR_CACHE_DEFAULT_MAX_NUM_CACHE_ELEMS  1024
+#define DBPF_ATTR_CACHE_DEFAULT_MAX_BYTES        (16*1024*1024)
+
+/*
+  the cache is split by key into this many independently locked
+  shards; the table size and limits are divided evenly among them
+*/
+#define DBPF_ATTR_CACHE_SHARDS                         16
 
 typedef struct
 {
@@ -35,6 +42,9 @@ typedef struct
 typedef struct
 {
     struct qlist_head hash_link;
+    struct qlist_head clock_link;
+    int referenced;             /* used since the clock hand last passed */
+    int bytes;                  /* memory charged to the cache */
 
     TROVE_object_ref key;
     TROVE_ds_attributes attr;
@@ -50,8 +60,15 @@ typedef struct
  * all methods return 0 on success; -1 on failure
  * (unless noted)
  *
+ * except for initialize and finalize, all methods that are passed a
+ * key, or an element looked up by one, must be called with that key's
+ * shard locked by dbpf_attr_cache_lock()
+ *
  ***********************************************/
 
+void dbpf_attr_cache_lock(TROVE_object_ref key);
+void dbpf_attr_cache_unlock(TROVE_object_ref key);
+
 /*
   - table size is the hash table size
   - cache_max_num_elems bounds the number of elems stored
@@ -133,6 +150,7 @@ int dbpf_attr_cache_keyval_pair_fetch_cached_data(
 int dbpf_attr_cache_set_keywords(char *keywords);
 int dbpf_attr_cache_set_size(int cache_size);
 int dbpf_attr_cache_set_max_num_elems(int max_num_elems);
+int dbpf_attr_cache_set_max_bytes(int max_bytes);
 int dbpf_attr_cache_do_initialize(void);
 
 #endif /* __DBPF_ATTR_CACHE_H */
@@ -1326,7 +1326,8 @@ static int dbpf_bstream_direct_resize(TROVE_coll_id coll_id,
     /* initialize the op-specific members */
     q_op_p->op.u.b_resize.size = *inout_size_p;
     q_op_p->op.u.b_resize.queued_op_ptr = q_op_p;
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
 
     return 0;
 }
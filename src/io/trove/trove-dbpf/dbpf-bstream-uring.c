@@ -0,0 +1,915 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* io_uring implementation of the dbpf aio operations.
+ *
+ * Each lio_listio() call is turned into a batch of READV/WRITEV
+ * submission queue entries that are handed to the kernel with a single
+ * io_uring_enter().  One reaper thread drains the completion queue for
+ * every outstanding listio and runs the sigevent callback once all the
+ * entries of a listio have completed, so the existing
+ * aio_progress_notification() machinery in dbpf-bstream.c is reused
+ * unchanged.  File descriptors handed out by the open cache are
+ * registered with the ring (indexed by fd number) the first time they
+ * are used so that the kernel can skip the per-request fd lookup.
+ *
+ * The completion queue is sized to hold every entry that can be in
+ * flight (TROVE_max_concurrent_io listios of at most AIOCB_ARRAY_SZ
+ * entries each), so the kernel never has to refuse a submission because
+ * completions have not been reaped yet.  The callbacks run on the reaper
+ * thread and may post more I/O, so the reaper consumes a whole batch of
+ * completions before running any of them.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <aio.h>
+#include <sched.h>
+
+#include "pvfs2-internal.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "trove.h"
+#include "trove-internal.h"
+#include "dbpf.h"
+#include "dbpf-bstream-uring.h"
+#include "gen-locks.h"
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+static int uring_lio_listio(int mode, struct aiocb * const list[],
+                            int nent, struct sigevent *sig);
+static int uring_aio_error(const struct aiocb *aiocbp);
+static ssize_t uring_aio_return(struct aiocb *aiocbp);
+static int uring_aio_cancel(int filedesc, struct aiocb * aiocbp);
+static int uring_aio_suspend(const struct aiocb * const list[], int nent,
+                             const struct timespec * timeout);
+static int uring_aio_read(struct aiocb * aiocbp);
+static int uring_aio_write(struct aiocb * aiocbp);
+static int uring_aio_fsync(int operation, struct aiocb * aiocbp);
+
+static struct dbpf_aio_ops uring_aio_ops;
+
+/* set from IOUringQueueDepth before trove is initialized */
+extern int TROVE_io_uring_queue_depth;
+extern int TROVE_max_concurrent_io;
+
+#ifdef HAVE_IO_URING
+
+/* upper bound on the number of registered file slots; fds beyond this
+ * are submitted unregistered
+ */
+#define URING_MAX_REGISTERED_FDS 1024
+
+struct uring_listio;
+
+struct uring_item
+{
+    struct aiocb *cb_p;
+    struct uring_listio *lio;
+    struct iovec iov;
+    int res;
+    struct uring_item *next;
+};
+
+struct uring_listio
+{
+    int mode;
+    int remaining;
+    int done;
+    struct sigevent *sig;
+    gen_mutex_t mutex;
+    pthread_cond_t cond;
+    int nent;
+    struct uring_item items[];
+};
+
+struct uring_state
+{
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring_ptr;
+    size_t sq_ring_sz;
+    void *cq_ring_ptr;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    int *registered;
+    int registered_count;
+    pthread_t reaper_tid;
+};
+
+static struct uring_state uring;
+static int uring_started = 0;
+/* serializes access to the submission queue and the registered fd table */
+static gen_mutex_t uring_submit_mutex = GEN_MUTEX_INITIALIZER;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_item_finish(struct uring_item *item, int res)
+{
+    struct uring_listio *lio = item->lio;
+
+    if(res < 0)
+    {
+#ifdef HAVE_AIOCB_ERROR_CODE
+        item->cb_p->__error_code = -res;
+#endif
+    }
+    else
+    {
+#ifdef HAVE_AIOCB_RETURN_VALUE
+        item->cb_p->__return_value = res;
+#endif
+#ifdef HAVE_AIOCB_ERROR_CODE
+        item->cb_p->__error_code = 0;
+#endif
+    }
+
+    if(__sync_sub_and_fetch(&lio->remaining, 1) != 0)
+    {
+        return;
+    }
+
+    if(lio->mode == LIO_WAIT)
+    {
+        /* the submitter owns the listio and frees it once woken */
+        gen_mutex_lock(&lio->mutex);
+        lio->done = 1;
+        pthread_cond_signal(&lio->cond);
+        gen_mutex_unlock(&lio->mutex);
+        return;
+    }
+
+    if(lio->sig && lio->sig->sigev_notify == SIGEV_THREAD)
+    {
+        lio->sig->sigev_notify_function(lio->sig->sigev_value);
+    }
+    gen_mutex_destroy(&lio->mutex);
+    pthread_cond_destroy(&lio->cond);
+    free(lio);
+}
+
+static void *uring_reaper_thread(void *arg)
+{
+    unsigned head, tail;
+    struct io_uring_cqe *cqe;
+    struct uring_item *item, *batch, **batch_tail;
+    int ret, stopping = 0;
+
+    while(!stopping)
+    {
+        head = *uring.cq_head;
+        tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+        if(head == tail)
+        {
+            ret = sys_io_uring_enter(uring.ring_fd, 0, 1,
+                                     IORING_ENTER_GETEVENTS);
+            if(ret < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                gossip_err("%s: io_uring_enter failed: %s\n",
+                           __func__, strerror(errno));
+            }
+            continue;
+        }
+
+        /* hand the cq slots back to the kernel before running any
+         * callback, since a callback may submit more I/O
+         */
+        batch = NULL;
+        batch_tail = &batch;
+        while(head != tail)
+        {
+            cqe = &uring.cqes[head & *uring.cq_mask];
+            item = (struct uring_item *)(uintptr_t)cqe->user_data;
+            head++;
+            if(!item)
+            {
+                /* NOP posted by dbpf_uring_stop() */
+                stopping = 1;
+                continue;
+            }
+            item->res = cqe->res;
+            item->next = NULL;
+            *batch_tail = item;
+            batch_tail = &item->next;
+        }
+        __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+
+        while(batch)
+        {
+            item = batch;
+            batch = item->next;
+            uring_item_finish(item, item->res);
+        }
+    }
+
+    gossip_debug(GOSSIP_BSTREAM_DEBUG, "[io-uring]: reaper exiting\n");
+    return NULL;
+}
+
+/* returns the index to use for fd, setting *fixed if it refers to a
+ * registered file slot; caller holds uring_submit_mutex
+ */
+static int uring_file_index(int fd, int *fixed)
+{
+    int ret;
+
+    *fixed = 0;
+    if(fd < 0 || fd >= uring.registered_count)
+    {
+        return fd;
+    }
+
+    if(uring.registered[fd] != fd)
+    {
+        struct io_uring_files_update up;
+
+        memset(&up, 0, sizeof(up));
+        up.offset = fd;
+        up.fds = (uint64_t)(uintptr_t)&fd;
+        ret = sys_io_uring_register(uring.ring_fd,
+                                    IORING_REGISTER_FILES_UPDATE, &up, 1);
+        if(ret < 0)
+        {
+            return fd;
+        }
+        uring.registered[fd] = fd;
+    }
+
+    *fixed = 1;
+    return fd;
+}
+
+void dbpf_uring_forget_fd(int fd)
+{
+    struct io_uring_files_update up;
+    int unused = -1;
+
+    gen_mutex_lock(&uring_submit_mutex);
+    if(uring_started && fd >= 0 && fd < uring.registered_count &&
+       uring.registered[fd] == fd)
+    {
+        memset(&up, 0, sizeof(up));
+        up.offset = fd;
+        up.fds = (uint64_t)(uintptr_t)&unused;
+        sys_io_uring_register(uring.ring_fd,
+                              IORING_REGISTER_FILES_UPDATE, &up, 1);
+        uring.registered[fd] = -1;
+    }
+    gen_mutex_unlock(&uring_submit_mutex);
+}
+
+static void uring_register_files(void)
+{
+    int i, ret;
+
+    uring.registered = malloc(URING_MAX_REGISTERED_FDS * sizeof(int));
+    if(!uring.registered)
+    {
+        return;
+    }
+    for(i = 0; i < URING_MAX_REGISTERED_FDS; i++)
+    {
+        uring.registered[i] = -1;
+    }
+
+    /* a sparse table of -1 entries; slots are filled in on first use */
+    ret = sys_io_uring_register(uring.ring_fd, IORING_REGISTER_FILES,
+                                uring.registered, URING_MAX_REGISTERED_FDS);
+    if(ret < 0)
+    {
+        gossip_debug(GOSSIP_BSTREAM_DEBUG, "[io-uring]: file registration "
+                     "unavailable (%s); using plain fds\n", strerror(errno));
+        free(uring.registered);
+        uring.registered = NULL;
+        return;
+    }
+    uring.registered_count = URING_MAX_REGISTERED_FDS;
+}
+
+int dbpf_uring_start(void)
+{
+    struct io_uring_params p;
+    unsigned cq_entries;
+    int ret;
+
+    gen_mutex_lock(&uring_submit_mutex);
+    if(uring_started)
+    {
+        gen_mutex_unlock(&uring_submit_mutex);
+        return 0;
+    }
+
+    memset(&uring, 0, sizeof(uring));
+    memset(&p, 0, sizeof(p));
+
+    /* room for every entry of every listio the bstream code allows in
+     * flight, plus the NOP that stops the reaper
+     */
+    cq_entries = TROVE_max_concurrent_io * AIOCB_ARRAY_SZ + 1;
+    if(cq_entries < 2 * (unsigned)TROVE_io_uring_queue_depth)
+    {
+        cq_entries = 2 * TROVE_io_uring_queue_depth;
+    }
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+    uring.ring_fd = sys_io_uring_setup(TROVE_io_uring_queue_depth, &p);
+    if(uring.ring_fd < 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("io_uring_setup(%d) failed: %s\n",
+                   TROVE_io_uring_queue_depth, strerror(errno));
+        gen_mutex_unlock(&uring_submit_mutex);
+        return ret;
+    }
+
+    uring.sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    uring.cq_ring_sz = p.cq_off.cqes +
+        p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(uring.cq_ring_sz > uring.sq_ring_sz)
+        {
+            uring.sq_ring_sz = uring.cq_ring_sz;
+        }
+        uring.cq_ring_sz = uring.sq_ring_sz;
+    }
+
+    uring.sq_ring_ptr = mmap(NULL, uring.sq_ring_sz,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE,
+                             uring.ring_fd, IORING_OFF_SQ_RING);
+    if(uring.sq_ring_ptr == MAP_FAILED)
+    {
+        goto mmap_failed;
+    }
+
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        uring.cq_ring_ptr = uring.sq_ring_ptr;
+    }
+    else
+    {
+        uring.cq_ring_ptr = mmap(NULL, uring.cq_ring_sz,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE,
+                                 uring.ring_fd, IORING_OFF_CQ_RING);
+        if(uring.cq_ring_ptr == MAP_FAILED)
+        {
+            munmap(uring.sq_ring_ptr, uring.sq_ring_sz);
+            goto mmap_failed;
+        }
+    }
+
+    uring.sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    uring.sqes = mmap(NULL, uring.sqes_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE,
+                      uring.ring_fd, IORING_OFF_SQES);
+    if(uring.sqes == MAP_FAILED)
+    {
+        if(uring.cq_ring_ptr != uring.sq_ring_ptr)
+        {
+            munmap(uring.cq_ring_ptr, uring.cq_ring_sz);
+        }
+        munmap(uring.sq_ring_ptr, uring.sq_ring_sz);
+        goto mmap_failed;
+    }
+
+    uring.sq_entries = p.sq_entries;
+    uring.sq_head = (unsigned *)((char *)uring.sq_ring_ptr + p.sq_off.head);
+    uring.sq_tail = (unsigned *)((char *)uring.sq_ring_ptr + p.sq_off.tail);
+    uring.sq_mask = (unsigned *)((char *)uring.sq_ring_ptr +
+                                 p.sq_off.ring_mask);
+    uring.sq_array = (unsigned *)((char *)uring.sq_ring_ptr +
+                                  p.sq_off.array);
+    uring.cq_head = (unsigned *)((char *)uring.cq_ring_ptr + p.cq_off.head);
+    uring.cq_tail = (unsigned *)((char *)uring.cq_ring_ptr + p.cq_off.tail);
+    uring.cq_mask = (unsigned *)((char *)uring.cq_ring_ptr +
+                                 p.cq_off.ring_mask);
+    uring.cqes = (struct io_uring_cqe *)((char *)uring.cq_ring_ptr +
+                                         p.cq_off.cqes);
+
+    uring_register_files();
+
+    ret = pthread_create(&uring.reaper_tid, NULL, uring_reaper_thread, NULL);
+    if(ret != 0)
+    {
+        gossip_err("%s: pthread_create failed: %s\n",
+                   __func__, strerror(ret));
+        munmap(uring.sqes, uring.sqes_sz);
+        if(uring.cq_ring_ptr != uring.sq_ring_ptr)
+        {
+            munmap(uring.cq_ring_ptr, uring.cq_ring_sz);
+        }
+        munmap(uring.sq_ring_ptr, uring.sq_ring_sz);
+        free(uring.registered);
+        close(uring.ring_fd);
+        gen_mutex_unlock(&uring_submit_mutex);
+        return -trove_errno_to_trove_error(ret);
+    }
+
+    gossip_debug(GOSSIP_BSTREAM_DEBUG, "[io-uring]: started with %u sq "
+                 "entries, %u cq entries, %d registered file slots\n",
+                 uring.sq_entries, p.cq_entries, uring.registered_count);
+
+    uring_started = 1;
+    gen_mutex_unlock(&uring_submit_mutex);
+    return 0;
+
+  mmap_failed:
+    ret = -trove_errno_to_trove_error(errno);
+    gossip_err("%s: mmap of io_uring failed: %s\n", __func__,
+               strerror(errno));
+    close(uring.ring_fd);
+    gen_mutex_unlock(&uring_submit_mutex);
+    return ret;
+}
+
+/* whether a failed io_uring_enter() submission is worth retrying.
+ * EBUSY means completions are backed up; only the reaper can clear
+ * them, so it must not wait for itself when a callback submits more I/O
+ */
+static int uring_submit_retry(int err)
+{
+    if(err == EINTR || err == EAGAIN)
+    {
+        return 1;
+    }
+    return (err == EBUSY && !pthread_equal(pthread_self(), uring.reaper_tid));
+}
+
+/* grabs the next free sqe, flushing the queue to the kernel if it is
+ * full; caller holds uring_submit_mutex
+ */
+static struct io_uring_sqe *uring_get_sqe(unsigned *pending)
+{
+    unsigned tail, head;
+    int ret;
+
+    while(1)
+    {
+        tail = *uring.sq_tail;
+        head = __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+        if(tail - head < uring.sq_entries)
+        {
+            struct io_uring_sqe *sqe = &uring.sqes[tail & *uring.sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            uring.sq_array[tail & *uring.sq_mask] = tail & *uring.sq_mask;
+            return sqe;
+        }
+
+        ret = sys_io_uring_enter(uring.ring_fd, *pending, 0, 0);
+        if(ret > 0)
+        {
+            *pending -= ret;
+        }
+        else if(ret < 0 && !uring_submit_retry(errno))
+        {
+            return NULL;
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+}
+
+static void uring_sqe_commit(unsigned *pending)
+{
+    __atomic_store_n(uring.sq_tail, *uring.sq_tail + 1, __ATOMIC_RELEASE);
+    (*pending)++;
+}
+
+/* pushes every published sqe to the kernel; caller holds
+ * uring_submit_mutex.  Returns 0 or an errno value.
+ */
+static int uring_flush(unsigned *pending)
+{
+    int ret;
+
+    while(*pending > 0)
+    {
+        ret = sys_io_uring_enter(uring.ring_fd, *pending, 0, 0);
+        if(ret > 0)
+        {
+            *pending -= ret;
+        }
+        else if(ret < 0 && uring_submit_retry(errno))
+        {
+            sched_yield();
+        }
+        else
+        {
+            return (ret < 0) ? errno : EIO;
+        }
+    }
+    return 0;
+}
+
+int dbpf_uring_stop(void)
+{
+    struct io_uring_sqe *sqe;
+    unsigned pending = 0;
+
+    gen_mutex_lock(&uring_submit_mutex);
+    if(!uring_started)
+    {
+        gen_mutex_unlock(&uring_submit_mutex);
+        return 0;
+    }
+
+    /* a NOP with no item attached tells the reaper to exit */
+    sqe = uring_get_sqe(&pending);
+    if(sqe)
+    {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        uring_sqe_commit(&pending);
+        uring_flush(&pending);
+    }
+    uring_started = 0;
+    gen_mutex_unlock(&uring_submit_mutex);
+
+    pthread_join(uring.reaper_tid, NULL);
+
+    munmap(uring.sqes, uring.sqes_sz);
+    if(uring.cq_ring_ptr != uring.sq_ring_ptr)
+    {
+        munmap(uring.cq_ring_ptr, uring.cq_ring_sz);
+    }
+    munmap(uring.sq_ring_ptr, uring.sq_ring_sz);
+    free(uring.registered);
+    close(uring.ring_fd);
+    memset(&uring, 0, sizeof(uring));
+    return 0;
+}
+
+static int uring_lio_listio(int mode, struct aiocb * const list[],
+                            int nent, struct sigevent *sig)
+{
+    struct uring_listio *lio;
+    struct uring_item *item;
+    struct io_uring_sqe *sqe;
+    unsigned pending = 0;
+    int i, index, fixed, ret = 0, submitted = 0;
+
+    if(!uring_started)
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    lio = malloc(sizeof(struct uring_listio) +
+                 nent * sizeof(struct uring_item));
+    if(!lio)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    lio->mode = mode;
+    lio->remaining = nent;
+    lio->done = 0;
+    lio->sig = sig;
+    lio->nent = nent;
+    gen_mutex_init(&lio->mutex);
+    pthread_cond_init(&lio->cond, NULL);
+
+    gen_mutex_lock(&uring_submit_mutex);
+    for(i = 0; i < nent; i++)
+    {
+        item = &lio->items[i];
+        item->cb_p = list[i];
+        item->lio = lio;
+        item->iov.iov_base = (void *)list[i]->aio_buf;
+        item->iov.iov_len = list[i]->aio_nbytes;
+#ifdef HAVE_AIOCB_ERROR_CODE
+        list[i]->__error_code = EINPROGRESS;
+#endif
+
+        sqe = uring_get_sqe(&pending);
+        if(!sqe)
+        {
+            ret = errno;
+            break;
+        }
+
+        index = uring_file_index(list[i]->aio_fildes, &fixed);
+        if(list[i]->aio_lio_opcode == LIO_READ)
+        {
+            sqe->opcode = IORING_OP_READV;
+        }
+        else if(list[i]->aio_lio_opcode == LIO_WRITE)
+        {
+            gossip_debug(GOSSIP_BSTREAM_DEBUG,
+                         "[io-uring]: writev: cb_p: %p, fd: %d, bufp: %p, "
+                         "size: %zd off:%llu\n", list[i], list[i]->aio_fildes,
+                         list[i]->aio_buf, list[i]->aio_nbytes,
+                         llu(list[i]->aio_offset));
+            sqe->opcode = IORING_OP_WRITEV;
+        }
+        else
+        {
+            /* this should have been caught already */
+            assert(0);
+        }
+        sqe->fd = index;
+        sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+        sqe->off = list[i]->aio_offset;
+        sqe->addr = (uint64_t)(uintptr_t)&item->iov;
+        sqe->len = 1;
+        sqe->user_data = (uint64_t)(uintptr_t)item;
+        uring_sqe_commit(&pending);
+        submitted++;
+    }
+
+    if(!ret)
+    {
+        ret = uring_flush(&pending);
+    }
+    if(ret)
+    {
+        /* the trailing entries the kernel did not take will never
+         * complete; pull them back off the queue
+         */
+        *uring.sq_tail -= pending;
+        submitted -= pending;
+    }
+    gen_mutex_unlock(&uring_submit_mutex);
+
+    if(ret)
+    {
+        gossip_err("%s: io_uring submission failed: %s\n",
+                   __func__, strerror(ret));
+        for(i = submitted; i < nent; i++)
+        {
+#ifdef HAVE_AIOCB_ERROR_CODE
+            list[i]->__error_code = ret;
+#endif
+        }
+
+        /* the callback never runs in the caller's context, which may
+         * hold locks the callback takes.  If every submitted entry has
+         * already been reaped, nothing else references the listio and
+         * the caller sees the failure; otherwise the reaper retires it
+         * and reports the rejected entries through their aiocbs.
+         */
+        if(__sync_sub_and_fetch(&lio->remaining, nent - submitted) == 0)
+        {
+            gen_mutex_destroy(&lio->mutex);
+            pthread_cond_destroy(&lio->cond);
+            free(lio);
+            errno = ret;
+            return -1;
+        }
+    }
+
+    if(mode == LIO_WAIT)
+    {
+        gen_mutex_lock(&lio->mutex);
+        while(!lio->done)
+        {
+            pthread_cond_wait(&lio->cond, &lio->mutex);
+        }
+        gen_mutex_unlock(&lio->mutex);
+
+        ret = 0;
+        for(i = 0; i < nent; i++)
+        {
+            if(uring_aio_error(list[i]) != 0)
+            {
+                ret = -1;
+                errno = uring_aio_error(list[i]);
+            }
+        }
+        gen_mutex_destroy(&lio->mutex);
+        pthread_cond_destroy(&lio->cond);
+        free(lio);
+        return ret;
+    }
+
+    return 0;
+}
+
+#else /* HAVE_IO_URING */
+
+int dbpf_uring_start(void)
+{
+    gossip_err("TroveMethod io-uring requested, but this server was "
+               "built without io_uring support\n");
+    return -TROVE_ENOSYS;
+}
+
+int dbpf_uring_stop(void)
+{
+    return 0;
+}
+
+void dbpf_uring_forget_fd(int fd)
+{
+}
+
+static int uring_lio_listio(int mode, struct aiocb * const list[],
+                            int nent, struct sigevent *sig)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif /* HAVE_IO_URING */
+
+static int uring_aio_error(const struct aiocb *aiocbp)
+{
+#ifdef HAVE_AIOCB_ERROR_CODE
+    return aiocbp->__error_code;
+#else
+    return 0;
+#endif
+}
+
+static ssize_t uring_aio_return(struct aiocb *aiocbp)
+{
+#ifdef HAVE_AIOCB_RETURN_VALUE
+    return aiocbp->__return_value;
+#else
+    return 0;
+#endif
+}
+
+static int uring_aio_cancel(int filedesc, struct aiocb *aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_aio_suspend(const struct aiocb * const list[], int nent,
+                             const struct timespec * timeout)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_aio_read(struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_aio_write(struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_aio_fsync(int operation, struct aiocb * aiocbp)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+static int uring_aio_bstream_read_list(TROVE_coll_id coll_id,
+                                       TROVE_handle handle,
+                                       char **mem_offset_array,
+                                       TROVE_size *mem_size_array,
+                                       int mem_count,
+                                       TROVE_offset *stream_offset_array,
+                                       TROVE_size *stream_size_array,
+                                       int stream_count,
+                                       TROVE_size *out_size_p,
+                                       TROVE_ds_flags flags,
+                                       TROVE_vtag_s *vtag,
+                                       void *user_ptr,
+                                       TROVE_context_id context_id,
+                                       TROVE_op_id *out_op_id_p,
+                                       PVFS_hint  hints)
+{
+    return dbpf_bstream_rw_list(coll_id,
+                                handle,
+                                mem_offset_array,
+                                mem_size_array,
+                                mem_count,
+                                stream_offset_array,
+                                stream_size_array,
+                                stream_count,
+                                out_size_p,
+                                flags,
+                                vtag,
+                                user_ptr,
+                                context_id,
+                                out_op_id_p,
+                                LIO_READ,
+                                &uring_aio_ops,
+                                hints);
+}
+
+static int uring_aio_bstream_write_list(TROVE_coll_id coll_id,
+                                        TROVE_handle handle,
+                                        char **mem_offset_array,
+                                        TROVE_size *mem_size_array,
+                                        int mem_count,
+                                        TROVE_offset *stream_offset_array,
+                                        TROVE_size *stream_size_array,
+                                        int stream_count,
+                                        TROVE_size *out_size_p,
+                                        TROVE_ds_flags flags,
+                                        TROVE_vtag_s *vtag,
+                                        void *user_ptr,
+                                        TROVE_context_id context_id,
+                                        TROVE_op_id *out_op_id_p,
+                                        PVFS_hint  hints)
+{
+    return dbpf_bstream_rw_list(coll_id,
+                                handle,
+                                mem_offset_array,
+                                mem_size_array,
+                                mem_count,
+                                stream_offset_array,
+                                stream_size_array,
+                                stream_count,
+                                out_size_p,
+                                flags,
+                                vtag,
+                                user_ptr,
+                                context_id,
+                                out_op_id_p,
+                                LIO_WRITE,
+                                &uring_aio_ops,
+                                hints);
+}
+
+static struct dbpf_aio_ops uring_aio_ops =
+{
+    uring_aio_read,
+    uring_aio_write,
+    uring_lio_listio,
+    uring_aio_error,
+    uring_aio_return,
+    uring_aio_cancel,
+    uring_aio_suspend,
+    uring_aio_fsync
+};
+
+struct TROVE_bstream_ops uring_aio_bstream_ops =
+{
+    dbpf_bstream_read_at,
+    dbpf_bstream_write_at,
+    dbpf_bstream_resize,
+    dbpf_bstream_validate,
+    uring_aio_bstream_read_list,
+    uring_aio_bstream_write_list,
+    dbpf_bstream_flush,
+    NULL,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
+};
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
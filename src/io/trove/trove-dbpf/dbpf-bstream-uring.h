@@ -0,0 +1,30 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __DBPF_BSTREAM_URING_H__
+#define __DBPF_BSTREAM_URING_H__
+
+#include "pvfs2-internal.h"
+#include "trove-types.h"
+
+int dbpf_uring_start(void);
+int dbpf_uring_stop(void);
+
+/* must be called before an fd handed out by the open cache is closed so
+ * that a stale registered file slot is never used for a reused fd number
+ */
+void dbpf_uring_forget_fd(int fd);
+
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
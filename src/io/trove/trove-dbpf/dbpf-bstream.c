@@ -30,10 +30,6 @@
 
 #include "dbpf-alt-aio.h"
 
-extern gen_mutex_t dbpf_attr_cache_mutex;
-
-#define AIOCB_ARRAY_SZ 64
-
 extern int TROVE_max_concurrent_io;
 static int s_dbpf_ios_in_progress = 0;
 static dbpf_op_queue_p s_dbpf_io_ready_queue = NULL;
@@ -582,7 +578,8 @@ int dbpf_bstream_flush(TROVE_coll_id coll_id,
                         flags,
                         context_id);
     q_op_p->op.hints = hints;
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
     return 0;
 }
 
@@ -618,6 +615,44 @@ return_error:
     return ret;
 }
 
+/* dbpf_bstream_get_fd()
+ *
+ * pins the buffered read descriptor of a bstream in the open cache and
+ * hands it out for direct use (sendfile() on the flow path).  Fails with
+ * -TROVE_ENOENT if the bstream has never been written.
+ */
+int dbpf_bstream_get_fd(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        int *out_fd,
+                        void **out_ref)
+{
+    struct open_cache_ref *ref;
+    int ret;
+
+    ref = malloc(sizeof(*ref));
+    if (!ref)
+    {
+        return -TROVE_ENOMEM;
+    }
+
+    ret = dbpf_open_cache_get(coll_id, handle, DBPF_FD_BUFFERED_READ, ref);
+    if (ret < 0)
+    {
+        free(ref);
+        return ret;
+    }
+
+    *out_fd = ref->fd;
+    *out_ref = ref;
+    return 0;
+}
+
+void dbpf_bstream_put_fd(void *ref)
+{
+    dbpf_open_cache_put((struct open_cache_ref *)ref);
+    free(ref);
+}
+
 int dbpf_bstream_validate(TROVE_coll_id coll_id,
                           TROVE_handle handle,
                           TROVE_ds_flags flags,
@@ -881,14 +916,15 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
     if (opcode == LIO_WRITE)
     {
         TROVE_object_ref ref = {handle, coll_id};
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_lock(ref);
         dbpf_attr_cache_remove(ref);
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
 #ifndef __PVFS2_TROVE_AIO_THREADED__
 
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
 
 #else
     op_p = &q_op_p->op;
@@ -1450,7 +1486,8 @@ int dbpf_bstream_resize(TROVE_coll_id coll_id,
     /* initialize the op-specific members */
     q_op_p->op.u.b_resize.size = *inout_size_p;
     q_op_p->op.u.b_resize.queued_op_ptr = q_op_p;
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
 
     return 0;
 }
@@ -1464,7 +1501,9 @@ struct TROVE_bstream_ops dbpf_bstream_ops =
     dbpf_bstream_read_list,
     dbpf_bstream_write_list,
     dbpf_bstream_flush,
-    dbpf_bstream_cancel
+    dbpf_bstream_cancel,
+    dbpf_bstream_get_fd,
+    dbpf_bstream_put_fd
 };
 
 /*
@@ -217,6 +217,13 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     return 0;
 }
 
+int dbpf_db_concurrent_reads(void)
+{
+    /* The databases are opened without a locking environment, so a
+     * read must not overlap a write; keep them on the op queue. */
+    return 0;
+}
+
 int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
@@ -253,6 +260,18 @@ int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
     return db_error(db->db->del(db->db, NULL, &db_key, 0));
 }
 
+/* Without a transaction environment every write is applied as it is
+ * made, so a batch only serves to share the sync that follows it. */
+int dbpf_db_batch_begin(struct dbpf_db *db)
+{
+    return 0;
+}
+
+int dbpf_db_batch_end(struct dbpf_db *db)
+{
+    return 0;
+}
+
 int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
 {
     int r;
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #include <gossip.h>
@@ -15,19 +16,150 @@
 #include "dbpf.h"
 
 #include "server-config.h"
+#include "gen-locks.h"
 
 extern filesystem_configuration_s *cfg_fs;
 
+/* LMDB lets any number of threads read while one writes, so plain gets
+ * are served by a read-only transaction kept by each thread for each
+ * database. Between uses it is reset, which releases its snapshot but
+ * keeps the reader slot, so a get costs a renew instead of a begin and
+ * commit. */
+struct lmdb_rtxn {
+    struct dbpf_db *db;          /* NULL once the database is closed */
+    MDB_txn *txn;
+    struct lmdb_rtxn *db_next;   /* other threads reading this database */
+    struct lmdb_rtxn *thr_next;  /* other databases read by this thread */
+};
+
 struct dbpf_db {
     MDB_env *env;
     MDB_dbi dbi;
+    struct lmdb_rtxn *rtxns;
+    /* write transaction opened by dbpf_db_batch_begin */
+    MDB_txn *batch;
+    pthread_t batch_thread;
 };
 
 struct dbpf_cursor {
     MDB_cursor *cursor;
     MDB_txn *txn;
+    int batched;    /* txn belongs to a batch and outlives the cursor */
 };
 
+/* protects the rtxns lists of every database */
+static gen_mutex_t rtxn_mutex = GEN_MUTEX_INITIALIZER;
+static pthread_key_t rtxn_key;
+static pthread_once_t rtxn_key_once = PTHREAD_ONCE_INIT;
+
+static void rtxn_thread_exit(void *arg)
+{
+    struct lmdb_rtxn *rtxn = arg, *next, **pp;
+
+    gen_mutex_lock(&rtxn_mutex);
+    for (; rtxn; rtxn = next)
+    {
+        next = rtxn->thr_next;
+        if (rtxn->db)
+        {
+            for (pp = &rtxn->db->rtxns; *pp != rtxn; pp = &(*pp)->db_next)
+                ;
+            *pp = rtxn->db_next;
+            mdb_txn_abort(rtxn->txn);
+        }
+        free(rtxn);
+    }
+    gen_mutex_unlock(&rtxn_mutex);
+}
+
+static void rtxn_key_create(void)
+{
+    pthread_key_create(&rtxn_key, rtxn_thread_exit);
+}
+
+/* Returns an active read-only transaction on *db* for the calling
+ * thread; release it with mdb_txn_reset. */
+static int rtxn_get(struct dbpf_db *db, MDB_txn **txn)
+{
+    struct lmdb_rtxn *head, *rtxn;
+    int r;
+
+    pthread_once(&rtxn_key_once, rtxn_key_create);
+    head = pthread_getspecific(rtxn_key);
+    for (rtxn = head; rtxn; rtxn = rtxn->thr_next)
+    {
+        if (rtxn->db == db)
+        {
+            *txn = rtxn->txn;
+            return mdb_txn_renew(rtxn->txn);
+        }
+    }
+
+    rtxn = malloc(sizeof *rtxn);
+    if (!rtxn)
+    {
+        return ENOMEM;
+    }
+    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &rtxn->txn);
+    if (r)
+    {
+        free(rtxn);
+        return r;
+    }
+    rtxn->db = db;
+    rtxn->thr_next = head;
+    if (pthread_setspecific(rtxn_key, rtxn))
+    {
+        mdb_txn_abort(rtxn->txn);
+        free(rtxn);
+        return ENOMEM;
+    }
+    gen_mutex_lock(&rtxn_mutex);
+    rtxn->db_next = db->rtxns;
+    db->rtxns = rtxn;
+    gen_mutex_unlock(&rtxn_mutex);
+    *txn = rtxn->txn;
+    return 0;
+}
+
+/* Returns the batch transaction if the calling thread has one open on
+ * *db*, or NULL. */
+static MDB_txn *batch_txn(struct dbpf_db *db)
+{
+    if (db->batch && pthread_equal(db->batch_thread, pthread_self()))
+    {
+        return db->batch;
+    }
+    return NULL;
+}
+
+/* Starts a write transaction for a single put or delete, unless one is
+ * already open for a batch. */
+static int wtxn_begin(struct dbpf_db *db, MDB_txn **txn)
+{
+    *txn = batch_txn(db);
+    if (*txn)
+    {
+        return 0;
+    }
+    return mdb_txn_begin(db->env, NULL, 0, txn);
+}
+
+/* Finishes a transaction from wtxn_begin whose write returned *r*. */
+static int wtxn_end(struct dbpf_db *db, MDB_txn *txn, int r)
+{
+    if (txn == db->batch)
+    {
+        return r;
+    }
+    if (r)
+    {
+        mdb_txn_abort(txn);
+        return r;
+    }
+    return mdb_txn_commit(txn);
+}
+
 static int db_error(int e)
 {
     /* values greater than zero are errno values */
@@ -124,6 +256,8 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
         gossip_err("%s:Error allocating space\n",__func__);
         return db_error(errno);
     }
+    (*db)->rtxns = NULL;
+    (*db)->batch = NULL;
 
     r = mdb_env_create(&(*db)->env);
     if (r)
@@ -227,6 +361,20 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
 
 int dbpf_db_close(struct dbpf_db *db)
 {
+    struct lmdb_rtxn *rtxn;
+
+    /* Read transactions of other threads are dropped here; the entries
+     * themselves are freed when their threads exit. */
+    gen_mutex_lock(&rtxn_mutex);
+    for (rtxn = db->rtxns; rtxn; rtxn = rtxn->db_next)
+    {
+        mdb_txn_abort(rtxn->txn);
+        rtxn->txn = NULL;
+        rtxn->db = NULL;
+    }
+    db->rtxns = NULL;
+    gen_mutex_unlock(&rtxn_mutex);
+
     mdb_env_close(db->env);
     free(db);
     return 0;
@@ -237,6 +385,24 @@ int dbpf_db_sync(struct dbpf_db *db)
     return db_error(mdb_env_sync(db->env, 0));
 }
 
+/* copies a stored value into the caller's buffer.  val->len is set to
+ * the stored size; a value that does not fit is truncated and reported
+ * as TROVE_ERANGE so the caller can retry with a larger buffer.
+ */
+static int get_copy_out(struct dbpf_data *val, MDB_val *db_data)
+{
+    size_t buf_len = val->len;
+
+    val->len = db_data->mv_size;
+    if (db_data->mv_size > buf_len)
+    {
+        memcpy(val->data, db_data->mv_data, buf_len);
+        return TROVE_ERANGE;
+    }
+    memcpy(val->data, db_data->mv_data, db_data->mv_size);
+    return 0;
+}
+
 int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
@@ -247,26 +413,39 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     db_key.mv_size = key->len;
     db_key.mv_data = key->data;
 
-    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &txn);
-    if (r)
+    /* a batch must see its own writes */
+    txn = batch_txn(db);
+    if (txn)
     {
-        return db_error(r);
+        r = mdb_get(txn, db->dbi, &db_key, &db_data);
+        if (r)
+        {
+            return db_error(r);
+        }
+        return get_copy_out(val, &db_data);
     }
-    r = mdb_get(txn, db->dbi, &db_key, &db_data);
+
+    r = rtxn_get(db, &txn);
     if (r)
     {
-        mdb_txn_abort(txn);
         return db_error(r);
     }
-    r = mdb_txn_commit(txn);
+    r = mdb_get(txn, db->dbi, &db_key, &db_data);
     if (r)
     {
+        mdb_txn_reset(txn);
         return db_error(r);
     }
 
-    memcpy(val->data, db_data.mv_data, val->len);
-    val->len = db_data.mv_size;
-    return 0;
+    /* the value points into the map and is only valid until reset */
+    r = get_copy_out(val, &db_data);
+    mdb_txn_reset(txn);
+    return r;
+}
+
+int dbpf_db_concurrent_reads(void)
+{
+    return 1;
 }
 
 int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
@@ -281,23 +460,13 @@ int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_put(txn, db->dbi, &db_key, &db_data, 0);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
-    if (r)
-    {
-        return db_error(r);
-    }
-    return 0;
+    return db_error(wtxn_end(db, txn, r));
 }
 
 int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
@@ -312,23 +481,13 @@ int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_put(txn, db->dbi, &db_key, &db_data, MDB_NOOVERWRITE);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
-    if (r)
-    {
-        return db_error(r);
-    }
-    return 0;
+    return db_error(wtxn_end(db, txn, r));
 }
 
 int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
@@ -340,25 +499,38 @@ int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
     db_key.mv_size = key->len;
     db_key.mv_data = key->data;
 
-    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    r = wtxn_begin(db, &txn);
     if (r)
     {
         return db_error(r);
     }
     r = mdb_del(txn, db->dbi, &db_key, NULL);
-    if (r)
-    {
-        mdb_txn_abort(txn);
-        return db_error(r);
-    }
-    r = mdb_txn_commit(txn);
+    return db_error(wtxn_end(db, txn, r));
+}
+
+int dbpf_db_batch_begin(struct dbpf_db *db)
+{
+    MDB_txn *txn;
+    int r;
+
+    r = mdb_txn_begin(db->env, NULL, 0, &txn);
     if (r)
     {
         return db_error(r);
     }
+    db->batch_thread = pthread_self();
+    db->batch = txn;
     return 0;
 }
 
+int dbpf_db_batch_end(struct dbpf_db *db)
+{
+    MDB_txn *txn = db->batch;
+
+    db->batch = NULL;
+    return db_error(mdb_txn_commit(txn));
+}
+
 int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
 {
     int r;
@@ -368,16 +540,25 @@ int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
         return db_error(errno);
     }
 
-    r = mdb_txn_begin(db->env, NULL, rdonly ? MDB_RDONLY : 0, &(*dbc)->txn);
-    if (r)
+    (*dbc)->txn = batch_txn(db);
+    (*dbc)->batched = (*dbc)->txn != NULL;
+    if (!(*dbc)->batched)
     {
-        free(*dbc);
-        return db_error(r);
+        r = mdb_txn_begin(db->env, NULL, rdonly ? MDB_RDONLY : 0,
+            &(*dbc)->txn);
+        if (r)
+        {
+            free(*dbc);
+            return db_error(r);
+        }
     }
     r = mdb_cursor_open((*dbc)->txn, db->dbi, &(*dbc)->cursor);
     if (r)
     {
-        mdb_txn_abort((*dbc)->txn);
+        if (!(*dbc)->batched)
+        {
+            mdb_txn_abort((*dbc)->txn);
+        }
         free(*dbc);
         return db_error(r);
     }
@@ -388,6 +569,11 @@ int dbpf_db_cursor_close(struct dbpf_cursor *dbc)
 {
     int r;
     mdb_cursor_close(dbc->cursor);
+    if (dbc->batched)
+    {
+        free(dbc);
+        return 0;
+    }
     r = mdb_txn_commit(dbc->txn);
     if (r)
     {
@@ -53,6 +53,10 @@ int dbpf_db_sync(dbpf_db *);
  * *val*. */
 int dbpf_db_get(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
 
+/* dbpf_db_concurrent_reads(): True if dbpf_db_get may be called from
+ * any thread while another thread is modifying the database. */
+int dbpf_db_concurrent_reads(void);
+
 /* dbpf_db_put(db, key, val): Put value for *key* in *db* into
  * *val*, overwriting if necessary. */
 int dbpf_db_put(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
@@ -64,6 +68,18 @@ int dbpf_db_putonce(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
 /* dbpf_db_del(db, key): Remove value for *key* in *db*. */
 int dbpf_db_del(dbpf_db *, struct dbpf_data *);
 
+/* dbpf_db_batch_begin(db): Make the puts, deletes, gets and cursors
+ * of the calling thread on *db* part of one write transaction until
+ * dbpf_db_batch_end is called. Other threads do not see these writes
+ * before then. */
+int dbpf_db_batch_begin(dbpf_db *);
+
+/* dbpf_db_batch_end(db): Commit the writes made since
+ * dbpf_db_batch_begin. If this fails, none of them are applied. A
+ * backend without transactions may instead apply each write as it is
+ * made. */
+int dbpf_db_batch_end(dbpf_db *);
+
 /* dbpf_db_cursor(db, dbc, rdonly): Open the cursor *dbc* on database
  * *db* which is read-only if *rdonly*. */
 int dbpf_db_cursor(dbpf_db *, dbpf_cursor **, int);
@@ -49,7 +49,6 @@ extern gen_mutex_t dbpf_completion_queue_array_mutex[TROVE_MAX_CONTEXTS];
 extern struct qlist_head dbpf_op_queue;
 extern gen_mutex_t dbpf_op_queue_mutex;
 #endif
-extern gen_mutex_t dbpf_attr_cache_mutex;
 
 int64_t s_dbpf_metadata_writes = 0, s_dbpf_metadata_reads = 0;
 
@@ -454,7 +453,8 @@ static int dbpf_dspace_remove_list(TROVE_coll_id coll_id,
     q_op_p->op.u.d_remove_list.handle_array = handle_array;
     q_op_p->op.u.d_remove_list.error_p = error_array;
 
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
 
     return 0;
 }
@@ -530,9 +530,9 @@ static int remove_one_handle(TROVE_object_ref ref,
     }
 
     /* if this attr is in the dbpf attr cache, remove it */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_remove(ref);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     /* remove bstream if it exists.  Not a fatal
      * error if this fails (may not have ever been created)
@@ -958,7 +958,7 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
     PINT_event_type event_type;
 
     /* fast path cache hit; skips queueing */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     if (dbpf_attr_cache_ds_attr_fetch_cached_data(ref, ds_attr_p) == 0)
     {
 #if 0
@@ -993,10 +993,10 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
         }
 
         UPDATE_PERF_METADATA_READ();
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
         return 1;
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     coll_p = dbpf_collection_find_registered(coll_id);
     if (coll_p == NULL)
@@ -1004,17 +1004,16 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
         return -TROVE_EINVAL;
     }
 
-    ret = dbpf_op_init_queued_or_immediate(&op,
-                                           &q_op_p,
-                                           DSPACE_GETATTR,
-                                           coll_p,
-                                           handle,
-                                           dbpf_dspace_getattr_op_svc,
-                                           flags,
-                                           NULL,
-                                           user_ptr,
-                                           context_id,
-                                           &op_p);
+    ret = dbpf_op_init_read_or_queued(&op,
+                                      &q_op_p,
+                                      DSPACE_GETATTR,
+                                      coll_p,
+                                      handle,
+                                      dbpf_dspace_getattr_op_svc,
+                                      flags,
+                                      user_ptr,
+                                      context_id,
+                                      &op_p);
     if(ret < 0)
     {
         return ret;
@@ -1032,12 +1031,12 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
     op_p->u.d_getattr.attr_p = ds_attr_p;
     op_p->hints = hints;
 
-    return dbpf_queue_or_service(op_p,
-                                 q_op_p,
-                                 coll_p,
-                                 out_op_id_p,
-                                 event_type,
-                                 event_id);
+    return dbpf_read_or_queue(op_p,
+                              q_op_p,
+                              coll_p,
+                              out_op_id_p,
+                              event_type,
+                              event_id);
 }
 
 static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
@@ -1057,13 +1056,13 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
     int i;
     int cache_hits = 0; 
 
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
     /* go ahead and try to hit attr cache for all handles up front */ 
     for (i = 0; i < nhandles; i++) 
     {
         ref.handle = handle_array[i];
         ref.fs_id = coll_id;
 
+        dbpf_attr_cache_lock(ref);
         if (dbpf_attr_cache_ds_attr_fetch_cached_data(ref, &ds_attr_p[i]) == 0)
         {
 #if 0
@@ -1111,8 +1110,8 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
              */
             ds_attr_p[i].type = PVFS_TYPE_NONE;
         }
+        dbpf_attr_cache_unlock(ref);
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
 
     /* All handles hit in the cache, return */
     if (cache_hits == nhandles) 
@@ -1148,7 +1147,8 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
     q_op_p->op.u.d_getattr_list.attr_p = ds_attr_p;
     q_op_p->op.u.d_getattr_list.error_p = error_array;
 
-    *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+    *out_op_id_p = q_op_p->op.id;
+    dbpf_queued_op_queue(q_op_p);
 
     return 0;
 }
@@ -1233,9 +1233,9 @@ int dbpf_dspace_attr_set(struct dbpf_collection *coll_p,
     }
 
     /* now that the disk is updated, update the cache if necessary */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_ds_attr_update_cached_data(ref, attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     return 0;
 }
@@ -1262,6 +1262,7 @@ int dbpf_dspace_attr_get(struct dbpf_collection *coll_p,
                          TROVE_ds_attributes *attr)
 {
     struct dbpf_data key, data;
+    uint64_t read_token;
     int ret;
 
     key.data = &ref.handle;
@@ -1270,6 +1271,7 @@ int dbpf_dspace_attr_get(struct dbpf_collection *coll_p,
     data.data = attr;
     data.len = sizeof(*attr);
 
+    read_token = dbpf_meta_read_begin();
     ret = dbpf_db_get(coll_p->ds_db, &key, &data);
     if (ret)
     {
@@ -1304,10 +1306,15 @@ int dbpf_dspace_attr_get(struct dbpf_collection *coll_p,
                      llu(attr->u.dirdata.count));
     }
 
-    /* add retrieved ds_attr to dbpf_attr cache here */
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
-    dbpf_attr_cache_insert(ref, attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    /* add retrieved ds_attr to dbpf_attr cache here, unless a
+     * modification may have made it stale already
+     */
+    dbpf_attr_cache_lock(ref);
+    if(dbpf_meta_read_cacheable(read_token))
+    {
+        dbpf_attr_cache_insert(ref, attr);
+    }
+    dbpf_attr_cache_unlock(ref);
 
     return 0;
 }
@@ -1587,7 +1594,7 @@ static int dbpf_dspace_test(
             break;
     }
     
-    ret = cur_op->op.svc_fn(&(cur_op->op));
+    ret = dbpf_op_service(&(cur_op->op));
 
     if (ret != 0)
     {
@@ -1976,9 +1983,9 @@ static int dbpf_dspace_create_store_handle(
 
     /* add retrieved ds_attr to dbpf_attr cache here */
     ref.handle = new_handle;
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     dbpf_attr_cache_insert(ref, &attr);
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     return(0);
 }
@@ -44,8 +44,6 @@ static uint16_t readdir_session = 0;
 
 extern int synccount;
 
-extern gen_mutex_t dbpf_attr_cache_mutex;
-
 static int dbpf_keyval_do_remove(
     dbpf_db *db_p, TROVE_handle handle, char type,
     TROVE_keyval_s *key, TROVE_keyval_s *val);
@@ -60,6 +58,7 @@ static int dbpf_keyval_iterate_op_svc(struct dbpf_op *op_p);
 static int dbpf_keyval_iterate_keys_op_svc(struct dbpf_op *op_p);
 static int dbpf_keyval_flush_op_svc(struct dbpf_op *op_p);
 static int dbpf_keyval_get_handle_info_op_svc(struct dbpf_op *op_p);
+static int dbpf_keyval_set_handle_info_op_svc(struct dbpf_op *op_p);
 
 #define DBPF_ITERATE_CURRENT_POSITION 1
 
@@ -122,9 +121,9 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
     gossip_debug(GOSSIP_DBPF_KEYVAL_DEBUG, "*** Trove KeyVal Read "
                  "of %s\n", (char *)key_p->buffer);
 
-    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_lock(ref);
     cache_elem = dbpf_attr_cache_elem_lookup(ref);
-    if (cache_elem && (!(flags & TROVE_BINARY_KEY)))
+    if (!(flags & TROVE_BINARY_KEY))
     {
         dbpf_keyval_pair_cache_elem_t *keyval_pair =
             dbpf_attr_cache_elem_get_data_based_on_key(
@@ -138,7 +137,7 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
             ret = dbpf_attr_cache_keyval_pair_fetch_cached_data(
                 cache_elem, keyval_pair, val_p->buffer,
                 &val_p->read_sz);
-            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_unlock(ref);
             if(ret < 0)
             {
                 return ret;
@@ -146,7 +145,7 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
             return 1;
         }
     }
-    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    dbpf_attr_cache_unlock(ref);
 
     coll_p = dbpf_collection_find_registered(coll_id);
     if (coll_p == NULL)
@@ -154,14 +153,13 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
         return -TROVE_EINVAL;
     }
 
-    ret = dbpf_op_init_queued_or_immediate(
+    ret = dbpf_op_init_read_or_queued(
         &op, &q_op_p,
         KEYVAL_READ,
         coll_p,
         handle,
         dbpf_keyval_read_op_svc,
         flags,
-        NULL,
         user_ptr,
         context_id,
         &op_p);
@@ -183,8 +181,8 @@ static int dbpf_keyval_read(TROVE_coll_id coll_id,
     op_p->u.k_read.val = val_p;
     op_p->hints = hints;
 
-    return dbpf_queue_or_service(op_p, q_op_p, coll_p, out_op_id_p,
-                                 event_type, event_id);
+    return dbpf_read_or_queue(op_p, q_op_p, coll_p, out_op_id_p,
+                              event_type, event_id);
 }
 
 static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
@@ -192,6 +190,7 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
     TROVE_object_ref ref = {op_p->handle, op_p->coll_p->coll_id};
     struct dbpf_keyval_db_entry key_entry;
     struct dbpf_data key, data;
+    uint64_t read_token;
     int ret;
 
     key_entry.handle = op_p->handle;
@@ -212,6 +211,7 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
     data.data = op_p->u.k_read.val->buffer;
     data.len = op_p->u.k_read.val->buffer_sz;
 
+    read_token = dbpf_meta_read_begin();
     ret = dbpf_db_get(op_p->coll_p->keyval_db, &key, &data);
     if (ret != 0)
     {
@@ -241,8 +241,14 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
     /* cache this data in the attr cache if we can */
     if(!(op_p->flags & TROVE_BINARY_KEY))
     {
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
-        if (dbpf_attr_cache_elem_set_data_based_on_key(
+        dbpf_attr_cache_lock(ref);
+        if (!dbpf_meta_read_cacheable(read_token))
+        {
+            gossip_debug(
+                GOSSIP_DBPF_ATTRCACHE_DEBUG,"** NOT caching data read "
+                "during a modification (key is %s)\n", (char *)key_entry.key);
+        }
+        else if (dbpf_attr_cache_elem_set_data_based_on_key(
                 ref, key_entry.key,
                 op_p->u.k_read.val->buffer, data.len))
         {
@@ -261,7 +267,7 @@ static int dbpf_keyval_read_op_svc(struct dbpf_op *op_p)
                 "retrieved (key is %s)\n",
                 (char *)key_entry.key);
         }
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
     return 1;
@@ -457,7 +463,7 @@ static int dbpf_keyval_write_op_svc(struct dbpf_op *op_p)
     if(!(op_p->flags & TROVE_BINARY_KEY))
     {
         dbpf_attr_cache_elem_t *cache_elem;
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_lock(ref);
         cache_elem = dbpf_attr_cache_elem_lookup(ref);
         if (cache_elem)
         {
@@ -481,7 +487,7 @@ static int dbpf_keyval_write_op_svc(struct dbpf_op *op_p)
                     (char *)key_entry.key);
             }
         }
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_unlock(ref);
     }
 
     ret = DBPF_OP_COMPLETE;
@@ -1090,14 +1096,13 @@ static int dbpf_keyval_read_list(TROVE_coll_id coll_id,
         return -TROVE_EINVAL;
     }
 
-    ret = dbpf_op_init_queued_or_immediate(
+    ret = dbpf_op_init_read_or_queued(
         &op, &q_op_p,
         KEYVAL_READ_LIST,
         coll_p,
         handle,
         dbpf_keyval_read_list_op_svc,
         flags,
-        NULL,
         user_ptr,
         context_id,
         &op_p);
@@ -1113,7 +1118,7 @@ static int dbpf_keyval_read_list(TROVE_coll_id coll_id,
     op_p->u.k_read_list.count = count;
     op_p->hints = hints;
 
-    return dbpf_queue_or_service(op_p, q_op_p, coll_p, out_op_id_p, 0, 0);
+    return dbpf_read_or_queue(op_p, q_op_p, coll_p, out_op_id_p, 0, 0);
 }
 
 static int dbpf_keyval_read_list_op_svc(struct dbpf_op *op_p)
@@ -1364,7 +1369,7 @@ static int dbpf_keyval_write_list_op_svc(struct dbpf_op *op_p)
            */
         if(!(op_p->flags & TROVE_BINARY_KEY))
         {
-            gen_mutex_lock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_lock(ref);
             cache_elem = dbpf_attr_cache_elem_lookup(ref);
             if (cache_elem)
             {
@@ -1389,7 +1394,7 @@ static int dbpf_keyval_write_list_op_svc(struct dbpf_op *op_p)
                         (char *)key_entry.key);
                 }
             }
-            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            dbpf_attr_cache_unlock(ref);
         }
     }
 
@@ -1964,6 +1969,102 @@ static int dbpf_keyval_get_handle_info_op_svc(struct dbpf_op * op_p)
     return 1;
 }    
 
+/* dbpf_keyval_set_handle_info()
+ *
+ * overwrites the keyval count of a handle; used when entries were
+ * written without TROVE_KEYVAL_HANDLE_COUNT and are counted all at once
+ */
+static int dbpf_keyval_set_handle_info(
+    TROVE_coll_id coll_id,
+    TROVE_handle handle,
+    TROVE_ds_flags flags,
+    TROVE_keyval_handle_info *info,
+    void * user_ptr,
+    TROVE_context_id context_id,
+    TROVE_op_id *out_op_id_p,
+    PVFS_hint  hints)
+{
+    dbpf_queued_op_t *q_op_p = NULL;
+    struct dbpf_op op;
+    struct dbpf_op *op_p;
+    struct dbpf_collection *coll_p = NULL;
+    int ret;
+
+    coll_p = dbpf_collection_find_registered(coll_id);
+    if(coll_p == NULL)
+    {
+        return -TROVE_EINVAL;
+    }
+
+    ret = dbpf_op_init_queued_or_immediate(
+        &op, &q_op_p,
+        KEYVAL_SET_HANDLE_INFO,
+        coll_p,
+        handle,
+        dbpf_keyval_set_handle_info_op_svc,
+        flags,
+        NULL,
+        user_ptr,
+        context_id,
+        &op_p);
+    if(ret < 0)
+    {
+        return ret;
+    }
+
+    op_p->u.k_set_handle_info.info = info;
+    op_p->hints = hints;
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_METADATA_KEYVAL_OPS,
+                    1, PINT_PERF_ADD);
+    return dbpf_queue_or_service(op_p, q_op_p, coll_p, out_op_id_p, 0, 0);
+}
+
+static int dbpf_keyval_set_handle_info_op_svc(struct dbpf_op * op_p)
+{
+    struct dbpf_keyval_db_entry key_entry;
+    struct dbpf_data key, data;
+    int ret;
+
+    memset(&key_entry, 0, sizeof(key_entry));
+    key_entry.handle = op_p->handle;
+    key_entry.type = DBPF_COUNT_TYPE;
+
+    key.data = &key_entry;
+    key.len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(0);
+
+    gossip_debug(GOSSIP_DBPF_KEYVAL_DEBUG,
+                 "[DBPF KEYVAL]: handle_info set: handle: %llu, count: %d\n",
+                 llu(op_p->handle), op_p->u.k_set_handle_info.info->count);
+
+    /* a count of zero is kept as no record at all, as a decrement to
+     * zero leaves it
+     */
+    if(op_p->u.k_set_handle_info.info->count == 0)
+    {
+        ret = dbpf_db_del(op_p->coll_p->keyval_db, &key);
+        if(ret == TROVE_ENOENT)
+        {
+            ret = 0;
+        }
+    }
+    else
+    {
+        data.data = op_p->u.k_set_handle_info.info;
+        data.len = sizeof(TROVE_keyval_handle_info);
+        ret = dbpf_db_put(op_p->coll_p->keyval_db, &key, &data);
+    }
+    if(ret != 0)
+    {
+        gossip_err("TROVE:DBPF: keyval dbpf_db_put (handle info)");
+        return -ret;
+    }
+
+    PINT_perf_count(PINT_server_pc, PINT_PERF_METADATA_KEYVAL_OPS,
+                    1, PINT_PERF_SUB);
+    return DBPF_OP_COMPLETE;
+}
+
 /**
  * keyval attrs are special parameters that can exist as metadata for
  * a keyval or set of keyvals (such as all the keyvals for directory
@@ -2066,7 +2167,8 @@ struct TROVE_keyval_ops dbpf_keyval_ops =
     dbpf_keyval_read_list,
     dbpf_keyval_write_list,
     dbpf_keyval_flush,
-    dbpf_keyval_get_handle_info
+    dbpf_keyval_get_handle_info,
+    dbpf_keyval_set_handle_info
 };
 
 /*
@@ -41,6 +41,7 @@
 #include "dbpf-open-cache.h"
 #include "pint-util.h"
 #include "dbpf-sync.h"
+#include "dbpf-bstream-uring.h"
 
 #include "server-config.h"
 
@@ -206,6 +207,15 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             ret = dbpf_attr_cache_set_max_num_elems(*((int *)parameter));
             gen_mutex_unlock(&dbpf_attr_cache_mutex);
             break;
+        case TROVE_COLLECTION_ATTR_CACHE_MAX_BYTES:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting maximum memory of "
+                         "attribute cache to %d bytes\n",
+                         (int) coll_id, *(int *)parameter);
+            gen_mutex_lock(&dbpf_attr_cache_mutex);
+            ret = dbpf_attr_cache_set_max_bytes(*((int *)parameter));
+            gen_mutex_unlock(&dbpf_attr_cache_mutex);
+            break;
         case TROVE_COLLECTION_ATTR_CACHE_INITIALIZE:
             gossip_debug(GOSSIP_TROVE_DEBUG, 
                          "dbpf collection %d - Initialize collection attr. "
@@ -230,6 +240,22 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             dbpf_queued_op_set_sync_low_watermark(*(int *)parameter, coll);
             ret = 0;
             break;
+        case TROVE_COLLECTION_GROUP_COMMIT_MAX_OPS:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting GROUP_COMMIT_MAX_OPS "
+                         "to %d\n", (int) coll_id, *(int *)parameter);
+            assert(coll);
+            dbpf_queued_op_set_group_max_ops(*(int *)parameter, coll);
+            ret = 0;
+            break;
+        case TROVE_COLLECTION_GROUP_COMMIT_WINDOW:
+            gossip_debug(GOSSIP_TROVE_DEBUG, 
+                         "dbpf collection %d - Setting GROUP_COMMIT_WINDOW "
+                         "to %d\n", (int) coll_id, *(int *)parameter);
+            assert(coll);
+            dbpf_queued_op_set_group_window(*(int *)parameter, coll);
+            ret = 0;
+            break;
         case TROVE_COLLECTION_META_SYNC_MODE:
             gossip_debug(GOSSIP_TROVE_DEBUG, 
                          "dbpf collection %d - %s sync mode\n",
@@ -654,11 +680,45 @@ static int dbpf_direct_finalize(void)
     return 0;
 }
 
+static int dbpf_uring_initialize(char *data_path,
+                                 char *meta_path,
+                                 TROVE_ds_flags flags)
+{
+    int ret;
+
+    ret = dbpf_initialize(data_path, meta_path, flags);
+    if(ret < 0)
+    {
+        return(ret);
+    }
+
+    /* set up the shared submission ring and its reaper thread */
+    ret = dbpf_uring_start();
+    if(ret < 0)
+    {
+        dbpf_finalize();
+        return(ret);
+    }
+
+    return(0);
+}
+
+static int dbpf_uring_finalize(void)
+{
+    /* dbpf_finalize() stops the ring */
+    dbpf_finalize();
+    return 0;
+}
+
 int dbpf_finalize(void)
 {
     int ret = -TROVE_EINVAL;
 
     dbpf_thread_finalize();
+    /* the ring is also started by collections that use io-uring while
+     * the server default is another method; this is a no-op otherwise
+     */
+    dbpf_uring_stop();
     dbpf_open_cache_finalize();
     gen_mutex_lock(&dbpf_attr_cache_mutex);
     dbpf_attr_cache_finalize();
@@ -1440,6 +1500,32 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
     return 0;
 }
 
+static int dbpf_uring_collection_lookup(char *collname,
+                                        TROVE_coll_id *out_coll_id_p,
+                                        void *user_ptr,
+                                        TROVE_op_id *out_op_id_p)
+{
+    int ret;
+
+    ret = dbpf_collection_lookup(collname, out_coll_id_p,
+        user_ptr, out_op_id_p);
+    if(ret < 0)
+    {
+        return(ret);
+    }
+
+    /* the ring may not be running if the server was initialized with a
+     * different default method
+     */
+    ret = dbpf_uring_start();
+    if(ret < 0)
+    {
+        return(ret);
+    }
+
+    return(0);
+}
+
 static int dbpf_direct_collection_lookup(char *collname,
                                          TROVE_coll_id *out_coll_id_p,
                                          void *user_ptr,
@@ -1689,6 +1775,8 @@ int dbpf_collection_lookup(char *collname,
     coll_p->c_high_watermark = 10;
     coll_p->c_low_watermark = 1;
     coll_p->meta_sync_enabled = 1; /* MUST be 1 !*/
+    coll_p->c_group_max_ops = 1;
+    coll_p->c_group_window = 0;
 
     dbpf_collection_register(coll_p);
     *out_coll_id_p = coll_p->coll_id;
@@ -1933,6 +2021,31 @@ struct TROVE_mgmt_ops dbpf_mgmt_direct_ops =
     dbpf_collection_set_fs_config
 };
 
+/* dbpf_mgmt_uring_ops
+ *
+ * Management operations for the io-uring method.  The ring is shared by
+ * all collections, so it is only torn down by dbpf_finalize(), whichever
+ * method the server was initialized with.
+ */
+struct TROVE_mgmt_ops dbpf_mgmt_uring_ops =
+{
+    dbpf_uring_initialize,
+    dbpf_uring_finalize,
+    dbpf_storage_create,
+    dbpf_storage_remove,
+    dbpf_collection_create,
+    dbpf_collection_remove,
+    dbpf_uring_collection_lookup,
+    dbpf_collection_clear,
+    dbpf_collection_iterate,
+    dbpf_collection_setinfo,
+    dbpf_collection_getinfo,
+    dbpf_collection_seteattr,
+    dbpf_collection_geteattr,
+    dbpf_collection_deleattr,
+    dbpf_collection_set_fs_config
+};
+
 /* dbpf_mgmt_ops
  *
  * Structure holding pointers to all the management operations
@@ -1982,6 +2095,7 @@ static __dbpf_op_type_str_map_t s_dbpf_op_type_str_map[] =
     { KEYVAL_WRITE_LIST, "KEYVAL_WRITE_LIST" },
     { KEYVAL_FLUSH, "KEYVAL_FLUSH" },
     { KEYVAL_GET_HANDLE_INFO, "KEYVAL_GET_HANDLE_INFO" },
+    { KEYVAL_SET_HANDLE_INFO, "KEYVAL_SET_HANDLE_INFO" },
     { DSPACE_CREATE, "DSPACE_CREATE" },
     { DSPACE_REMOVE, "DSPACE_REMOVE" },
     { DSPACE_ITERATE_HANDLES, "DSPACE_ITERATE_HANDLES" },
@@ -263,7 +263,81 @@ void dbpf_queued_op_dequeue_nolock(dbpf_queued_op_t *q_op_p)
     dbpf_sync_coalesce_dequeue(q_op_p);
 }
 
-int dbpf_op_init_queued_or_immediate(
+/* keyval and dspace ops in the middle of modifying the databases, and
+ * the number that have finished doing so
+ */
+static volatile int dbpf_meta_writers = 0;
+static volatile uint64_t dbpf_meta_write_seq = 1;
+
+/* dbpf_meta_write_begin(), dbpf_meta_write_end()
+ *
+ * bracket a modification of the keyval or dspace databases, up to the
+ * point where it is visible to other threads
+ */
+void dbpf_meta_write_begin(void)
+{
+    __sync_add_and_fetch(&dbpf_meta_writers, 1);
+}
+
+void dbpf_meta_write_end(void)
+{
+    __sync_add_and_fetch(&dbpf_meta_write_seq, 1);
+    __sync_sub_and_fetch(&dbpf_meta_writers, 1);
+}
+
+/* dbpf_op_service()
+ *
+ * runs the service routine of an op.  Ops that may modify the keyval
+ * or dspace databases are counted so that reads running outside the
+ * dbpf thread can tell whether they raced with one.
+ */
+int dbpf_op_service(struct dbpf_op *op_p)
+{
+    int ret;
+
+    if(!(DBPF_OP_IS_KEYVAL(op_p->type) || DBPF_OP_IS_DSPACE(op_p->type)) ||
+       DBPF_OP_IS_META_READ(op_p->type))
+    {
+        return op_p->svc_fn(op_p);
+    }
+
+    dbpf_meta_write_begin();
+    ret = op_p->svc_fn(op_p);
+    dbpf_meta_write_end();
+    return ret;
+}
+
+/* dbpf_meta_read_begin()
+ *
+ * called before reading a value that may be put in the attribute
+ * cache.  Returns a token for dbpf_meta_read_cacheable(), which must be
+ * called with the object's attribute cache shard locked.
+ */
+uint64_t dbpf_meta_read_begin(void)
+{
+    uint64_t seq;
+
+    __sync_synchronize();
+    seq = dbpf_meta_write_seq;
+    if(dbpf_meta_writers)
+    {
+        return 0;
+    }
+    return seq;
+}
+
+/* returns true if no modification overlapped the read that returned
+ * token, so that what it read is still current
+ */
+int dbpf_meta_read_cacheable(uint64_t token)
+{
+    __sync_synchronize();
+    return (token != 0 && dbpf_meta_writers == 0 &&
+            dbpf_meta_write_seq == token);
+}
+
+static int dbpf_op_init_common(
+    int immediate,
     struct dbpf_op * op_p,
     dbpf_queued_op_t ** q_op_pp,
     enum dbpf_op_type op_type,
@@ -271,12 +345,11 @@ int dbpf_op_init_queued_or_immediate(
     TROVE_handle handle,
     int (* dbpf_op_svc_fn) (struct dbpf_op *),
     TROVE_ds_flags flags,
-    TROVE_vtag_s *vtag,
     void *user_ptr,
     TROVE_context_id context_id,
     struct dbpf_op **op_pp)
 {
-    if(coll_p->immediate_completion)
+    if(immediate)
     {
         DBPF_OP_INIT(*op_p,
                      op_type,
@@ -313,22 +386,65 @@ int dbpf_op_init_queued_or_immediate(
     return 0;
 }
 
-int dbpf_queue_or_service(
+int dbpf_op_init_queued_or_immediate(
+    struct dbpf_op * op_p,
+    dbpf_queued_op_t ** q_op_pp,
+    enum dbpf_op_type op_type,
+    struct dbpf_collection *coll_p,
+    TROVE_handle handle,
+    int (* dbpf_op_svc_fn) (struct dbpf_op *),
+    TROVE_ds_flags flags,
+    TROVE_vtag_s *vtag,
+    void *user_ptr,
+    TROVE_context_id context_id,
+    struct dbpf_op **op_pp)
+{
+    return dbpf_op_init_common(coll_p->immediate_completion,
+                               op_p, q_op_pp, op_type, coll_p, handle,
+                               dbpf_op_svc_fn, flags, user_ptr,
+                               context_id, op_pp);
+}
+
+/* dbpf_op_init_read_or_queued()
+ *
+ * like dbpf_op_init_queued_or_immediate(), for keyval and dspace reads.
+ * If the database allows it these are serviced in the calling thread
+ * even when the collection queues everything else.
+ */
+int dbpf_op_init_read_or_queued(
+    struct dbpf_op * op_p,
+    dbpf_queued_op_t ** q_op_pp,
+    enum dbpf_op_type op_type,
+    struct dbpf_collection *coll_p,
+    TROVE_handle handle,
+    int (* dbpf_op_svc_fn) (struct dbpf_op *),
+    TROVE_ds_flags flags,
+    void *user_ptr,
+    TROVE_context_id context_id,
+    struct dbpf_op **op_pp)
+{
+    return dbpf_op_init_common(DBPF_READ_INLINE(coll_p),
+                               op_p, q_op_pp, op_type, coll_p, handle,
+                               dbpf_op_svc_fn, flags, user_ptr,
+                               context_id, op_pp);
+}
+
+static int dbpf_service_common(
+    int immediate,
     struct dbpf_op *op_p,
     dbpf_queued_op_t *q_op_p,
-    struct dbpf_collection *coll_p,
     TROVE_op_id *out_op_id_p,
     PINT_event_type event_type,
     PINT_event_id event_id)
 {
     int ret;
 
-    if( coll_p->immediate_completion &&
+    if(immediate &&
        (DBPF_OP_IS_KEYVAL(op_p->type) || DBPF_OP_IS_DSPACE(op_p->type)))
     {
         dbpf_db * dbp;
         *out_op_id_p = 0;
-        ret = op_p->svc_fn(op_p);
+        ret = dbpf_op_service(op_p);
         if(ret < 0)
         {
             goto exit;
@@ -362,7 +478,9 @@ int dbpf_queue_or_service(
     }
     else
     {
-        *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+        /* the op may complete as soon as it is queued */
+        *out_op_id_p = q_op_p->op.id;
+        dbpf_queued_op_queue(q_op_p);
         ret = 0;
     }
 
@@ -371,6 +489,35 @@ exit:
     return ret;
 }
 
+int dbpf_queue_or_service(
+    struct dbpf_op *op_p,
+    dbpf_queued_op_t *q_op_p,
+    struct dbpf_collection *coll_p,
+    TROVE_op_id *out_op_id_p,
+    PINT_event_type event_type,
+    PINT_event_id event_id)
+{
+    return dbpf_service_common(coll_p->immediate_completion, op_p, q_op_p,
+                               out_op_id_p, event_type, event_id);
+}
+
+/* dbpf_read_or_queue()
+ *
+ * counterpart of dbpf_queue_or_service() for ops set up with
+ * dbpf_op_init_read_or_queued()
+ */
+int dbpf_read_or_queue(
+    struct dbpf_op *op_p,
+    dbpf_queued_op_t *q_op_p,
+    struct dbpf_collection *coll_p,
+    TROVE_op_id *out_op_id_p,
+    PINT_event_type event_type,
+    PINT_event_id event_id)
+{
+    return dbpf_service_common(DBPF_READ_INLINE(coll_p), op_p, q_op_p,
+                               out_op_id_p, event_type, event_id);
+}
+
 int dbpf_queued_op_complete(dbpf_queued_op_t * qop_p,
                             enum dbpf_op_state state)
 {
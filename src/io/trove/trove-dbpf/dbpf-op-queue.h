@@ -87,6 +87,34 @@ int dbpf_queue_or_service(
     PINT_event_type event_type,
     PINT_event_id event_id);
 
+int dbpf_op_init_read_or_queued(
+    struct dbpf_op *op_p,
+    dbpf_queued_op_t **q_op_pp,
+    enum dbpf_op_type op_type,
+    struct dbpf_collection *coll_p,
+    TROVE_handle handle,
+    int (* dbpf_op_svc_fn)(struct dbpf_op *),
+    TROVE_ds_flags flags,
+    void *user_ptr,
+    TROVE_context_id context_id,
+    struct dbpf_op **op_pp);
+
+int dbpf_read_or_queue(
+    struct dbpf_op *op_p,
+    dbpf_queued_op_t *q_op_p,
+    struct dbpf_collection *coll_p,
+    TROVE_op_id *out_op_id_p,
+    PINT_event_type event_type,
+    PINT_event_id event_id);
+
+int dbpf_op_service(struct dbpf_op *op_p);
+
+void dbpf_meta_write_begin(void);
+void dbpf_meta_write_end(void);
+
+uint64_t dbpf_meta_read_begin(void);
+int dbpf_meta_read_cacheable(uint64_t token);
+
 int dbpf_queued_op_complete(dbpf_queued_op_t * op,
                             enum dbpf_op_state state);
 
@@ -30,6 +30,7 @@
 #include "gossip.h"
 #include "quicklist.h"
 #include "dbpf-open-cache.h"
+#include "dbpf-bstream-uring.h"
 #include "pvfs2-internal.h"
 
 #define OPEN_CACHE_SIZE 64
@@ -714,6 +715,7 @@ static void close_fd(
 {
     gossip_debug(GOSSIP_DBPF_OPEN_CACHE_DEBUG,
         "dbpf_open_cache closing fd %d of type %d\n", fd, type);
+    dbpf_uring_forget_fd(fd);
     close(fd);
 }
 
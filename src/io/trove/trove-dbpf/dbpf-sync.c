@@ -4,6 +4,8 @@
  * See COPYING in top-level directory.
  */
 
+#include <sys/time.h>
+
 #include "dbpf-op-queue.h"
 #include "pvfs2-internal.h"
 #include "gossip.h"
@@ -25,6 +27,27 @@ extern dbpf_op_queue_p dbpf_completion_queue_array[TROVE_MAX_CONTEXTS];
 extern gen_mutex_t dbpf_completion_queue_array_mutex[TROVE_MAX_CONTEXTS];
 extern pthread_cond_t dbpf_op_completed_cond;
 
+/* group commit: a moving average of the time between metadata writes
+ * being queued, used to decide whether holding a group open is likely
+ * to gather more writes.  After a wait that gathers nothing, that many
+ * groups (doubling up to DBPF_GROUP_MAX_BACKOFF) close without waiting.
+ */
+#define DBPF_GROUP_MAX_BACKOFF 64
+
+static gen_mutex_t group_mutex = GEN_MUTEX_INITIALIZER;
+static uint64_t group_last_arrival = 0;
+static uint64_t group_gap_usecs = 0;
+static int group_backoff = 0;
+static int group_skip = 0;
+
+static uint64_t dbpf_sync_now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 static int dbpf_sync_db(
     dbpf_db * dbp, 
     enum s_sync_context_e sync_context_type, 
@@ -105,7 +128,13 @@ void dbpf_sync_context_destroy(int context_index)
     }
 }
 
-int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
+/* if defer is set, a synced op is always left on the sync queue for a
+ * later op to sync and complete
+ */
+static int dbpf_sync_coalesce_common(dbpf_queued_op_t *qop_p,
+                                     int retcode,
+                                     int * outcount,
+                                     int defer)
 {
 
     int ret = 0;
@@ -181,9 +210,10 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
          */
         gen_mutex_lock(&sync_context->mutex);
         sync_context->coalesce_counter++;
-        if( (coll->c_high_watermark > 0 && 
+        if( !defer &&
+            ((coll->c_high_watermark > 0 && 
              sync_context->coalesce_counter >= coll->c_high_watermark) 
-            || sync_context->sync_counter < coll->c_low_watermark )
+            || sync_context->sync_counter < coll->c_low_watermark) )
         {
             gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                          "[SYNC_COALESCE]:\thigh or low watermark reached:\n"
@@ -210,9 +240,10 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
      * coalesce. 
      */
     gen_mutex_lock(&sync_context->mutex);
-    if( (sync_context->sync_counter < coll->c_low_watermark) ||
-        ( coll->c_high_watermark > 0 && 
-          sync_context->coalesce_counter >= coll->c_high_watermark ) )
+    if( !defer &&
+        ((sync_context->sync_counter < coll->c_low_watermark) ||
+         ( coll->c_high_watermark > 0 && 
+           sync_context->coalesce_counter >= coll->c_high_watermark )) )
     {
         gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                      "[SYNC_COALESCE]:\thigh or low watermark reached:\n"
@@ -294,6 +325,117 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
     return ret;
 }
 
+int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
+{
+    return dbpf_sync_coalesce_common(qop_p, retcode, outcount, 0);
+}
+
+/* true if both ops wait on the same sync */
+static int dbpf_sync_same_context(dbpf_queued_op_t *a, dbpf_queued_op_t *b)
+{
+    return ((a->op.flags & TROVE_SYNC) && (b->op.flags & TROVE_SYNC) &&
+            a->op.context_id == b->op.context_id &&
+            dbpf_sync_get_object_sync_context(a->op.type) ==
+            dbpf_sync_get_object_sync_context(b->op.type));
+}
+
+/* dbpf_sync_coalesce_group()
+ *
+ * completes a group of modifying ops that were committed together.
+ * Only the last op of the group waiting on each sync context may sync
+ * it, so the group costs at most one sync per database.
+ *
+ * returns 0 on success, -TROVE_errno on failure
+ */
+int dbpf_sync_coalesce_group(dbpf_queued_op_t **ops,
+                             int *retcodes,
+                             int count,
+                             int *outcount)
+{
+    int i, j, last, ret;
+
+    for(i = 0; i < count; i++)
+    {
+        last = 1;
+        for(j = i + 1; j < count && last; j++)
+        {
+            if(DBPF_OP_DOES_SYNC(ops[i]->op.type) &&
+               DBPF_OP_DOES_SYNC(ops[j]->op.type) &&
+               dbpf_sync_same_context(ops[i], ops[j]))
+            {
+                last = 0;
+            }
+        }
+
+        ret = dbpf_sync_coalesce_common(ops[i], retcodes[i], outcount, !last);
+        if(ret < 0)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/* dbpf_sync_group_window()
+ *
+ * returns how many microseconds the dbpf thread should keep a group of
+ * writes to coll open waiting for more, 0 to commit it now
+ */
+int dbpf_sync_group_window(struct dbpf_collection *coll)
+{
+    int window = 0;
+    uint64_t now = dbpf_sync_now();
+
+    if(coll->c_group_window <= 0)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&group_mutex);
+    if(group_skip > 0)
+    {
+        group_skip--;
+    }
+    else if(now - group_last_arrival < (uint64_t)coll->c_group_window &&
+            group_gap_usecs * 2 <= (uint64_t)coll->c_group_window)
+    {
+        /* writes are arriving faster than the window; expect another
+         * within twice the average gap
+         */
+        window = group_gap_usecs * 2;
+        if(window < 1)
+        {
+            window = 1;
+        }
+    }
+    gen_mutex_unlock(&group_mutex);
+
+    return window;
+}
+
+/* dbpf_sync_group_waited()
+ *
+ * reports whether holding a group open gathered more writes
+ */
+void dbpf_sync_group_waited(int useful)
+{
+    gen_mutex_lock(&group_mutex);
+    if(useful)
+    {
+        group_backoff = 0;
+    }
+    else
+    {
+        group_backoff = group_backoff ? group_backoff * 2 : 1;
+        if(group_backoff > DBPF_GROUP_MAX_BACKOFF)
+        {
+            group_backoff = DBPF_GROUP_MAX_BACKOFF;
+        }
+        group_skip = group_backoff;
+    }
+    gen_mutex_unlock(&group_mutex);
+}
+
 int dbpf_sync_coalesce_enqueue(dbpf_queued_op_t *qop_p)
 {
     dbpf_sync_context_t * sync_context;
@@ -307,6 +449,23 @@ int dbpf_sync_coalesce_enqueue(dbpf_queued_op_t *qop_p)
     gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG,
                  "[SYNC_COALESCE]: enqueue called\n");
 
+    if(qop_p->op.coll_p->c_group_window > 0)
+    {
+        uint64_t now = dbpf_sync_now();
+        uint64_t gap;
+
+        gen_mutex_lock(&group_mutex);
+        gap = now - group_last_arrival;
+        /* a long idle period says nothing about the current rate */
+        if(gap > (uint64_t)qop_p->op.coll_p->c_group_window * 16)
+        {
+            gap = (uint64_t)qop_p->op.coll_p->c_group_window * 16;
+        }
+        group_gap_usecs = (group_gap_usecs * 7 + gap) / 8;
+        group_last_arrival = now;
+        gen_mutex_unlock(&group_mutex);
+    }
+
     sync_context_type = dbpf_sync_get_object_sync_context(qop_p->op.type);
 
     sync_context = & sync_array[sync_context_type][qop_p->op.context_id];
@@ -389,6 +548,22 @@ void dbpf_queued_op_set_sync_mode(int enabled, struct dbpf_collection* coll)
     coll->meta_sync_enabled = enabled;
 }
 
+void dbpf_queued_op_set_group_max_ops(
+    int max_ops, struct dbpf_collection* coll)
+{
+    if(max_ops > DBPF_GROUP_MAX_OPS)
+    {
+        max_ops = DBPF_GROUP_MAX_OPS;
+    }
+    coll->c_group_max_ops = max_ops;
+}
+
+void dbpf_queued_op_set_group_window(
+    int usecs, struct dbpf_collection* coll)
+{
+    coll->c_group_window = usecs;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -28,6 +28,10 @@ int dbpf_sync_context_init(int context_index);
 void dbpf_sync_context_destroy(int context_index);
 
 int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount);
+int dbpf_sync_coalesce_group(dbpf_queued_op_t **ops, int *retcodes,
+                             int count, int *outcount);
+int dbpf_sync_group_window(struct dbpf_collection *coll);
+void dbpf_sync_group_waited(int useful);
 int dbpf_sync_coalesce_dequeue(dbpf_queued_op_t *qop_p);
 int dbpf_sync_coalesce_enqueue(dbpf_queued_op_t *qop_p);
 
@@ -37,6 +41,9 @@ void dbpf_queued_op_set_sync_low_watermark(int low, struct dbpf_collection* coll
 
 void dbpf_queued_op_set_sync_mode(int enabled, struct dbpf_collection* coll);
 
+void dbpf_queued_op_set_group_max_ops(int max_ops, struct dbpf_collection* coll);
+void dbpf_queued_op_set_group_window(int usecs, struct dbpf_collection* coll);
+
 /*
  * Local variables:
  *  c-indent-level: 4
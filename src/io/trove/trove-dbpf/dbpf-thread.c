@@ -79,6 +79,126 @@ int dbpf_thread_finalize(void)
 
 int synccount = 0;
 
+#ifdef __PVFS2_TROVE_THREADED__
+/* Metadata writes serviced by the dbpf thread inside one database
+ * transaction.  They complete together once it commits; until then the
+ * group counts as a single write in progress for the readers that run
+ * outside the dbpf thread.
+ */
+static struct
+{
+    struct dbpf_collection *coll_p;     /* NULL if no group is open */
+    int count;
+    int waited;
+    int count_at_wait;
+    dbpf_queued_op_t *ops[DBPF_GROUP_MAX_OPS];
+    int retcodes[DBPF_GROUP_MAX_OPS];
+} dbpf_group;
+
+static int dbpf_group_can_add(dbpf_queued_op_t *q_op_p)
+{
+    struct dbpf_collection *coll_p = q_op_p->op.coll_p;
+
+    return (DBPF_OP_DOES_SYNC(q_op_p->op.type) &&
+            coll_p->c_group_max_ops > 1 &&
+            !coll_p->immediate_completion);
+}
+
+static void dbpf_group_begin(struct dbpf_collection *coll_p)
+{
+    int ret;
+
+    ret = dbpf_db_batch_begin(coll_p->ds_db);
+    if(ret != 0)
+    {
+        gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG, "[DBPF THREAD]: unable to "
+                     "begin group: %d\n", ret);
+        return;
+    }
+    ret = dbpf_db_batch_begin(coll_p->keyval_db);
+    if(ret != 0)
+    {
+        gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG, "[DBPF THREAD]: unable to "
+                     "begin group: %d\n", ret);
+        dbpf_db_batch_end(coll_p->ds_db);
+        return;
+    }
+
+    dbpf_meta_write_begin();
+    dbpf_group.coll_p = coll_p;
+    dbpf_group.count = 0;
+    dbpf_group.waited = 0;
+}
+
+static int dbpf_group_end(int *out_count)
+{
+    struct dbpf_collection *coll_p = dbpf_group.coll_p;
+    int ret, i;
+
+    ret = dbpf_db_batch_end(coll_p->ds_db);
+    i = dbpf_db_batch_end(coll_p->keyval_db);
+    if(ret == 0)
+    {
+        ret = i;
+    }
+    dbpf_meta_write_end();
+    dbpf_group.coll_p = NULL;
+
+    if(ret != 0)
+    {
+        gossip_err("Error committing %d metadata updates: %s\n",
+                   dbpf_group.count, strerror(ret));
+        for(i = 0; i < dbpf_group.count; i++)
+        {
+            if(dbpf_group.retcodes[i] == 0)
+            {
+                dbpf_group.retcodes[i] = -ret;
+            }
+        }
+    }
+
+    if(dbpf_group.waited)
+    {
+        dbpf_sync_group_waited(dbpf_group.count > dbpf_group.count_at_wait);
+    }
+
+    gossip_debug(GOSSIP_DBPF_COALESCE_DEBUG, "[DBPF THREAD]: committed "
+                 "group of %d\n", dbpf_group.count);
+    return dbpf_sync_coalesce_group(dbpf_group.ops, dbpf_group.retcodes,
+                                    dbpf_group.count, out_count);
+}
+
+/* waits up to usecs for another op to be queued; returns true if the
+ * queue is no longer empty
+ */
+static int dbpf_group_wait(int usecs)
+{
+    struct timeval base;
+    struct timespec wait_time;
+    int empty;
+
+    gettimeofday(&base, NULL);
+    wait_time.tv_sec = base.tv_sec + usecs / 1000000;
+    wait_time.tv_nsec = (base.tv_usec + usecs % 1000000) * 1000;
+    if (wait_time.tv_nsec >= 1000000000)
+    {
+        wait_time.tv_nsec -= 1000000000;
+        wait_time.tv_sec++;
+    }
+
+    gen_mutex_lock(&dbpf_op_queue_mutex);
+    if (qlist_empty(&dbpf_op_queue))
+    {
+        pthread_cond_timedwait(&dbpf_op_incoming_cond,
+                               &dbpf_op_queue_mutex, &wait_time);
+    }
+    empty = qlist_empty(&dbpf_op_queue);
+    gen_mutex_unlock(&dbpf_op_queue_mutex);
+
+    return !empty;
+}
+#endif
+
 void *dbpf_thread_function(void *ptr)
 {
 #ifdef __PVFS2_TROVE_THREADED__
@@ -193,24 +313,85 @@ int dbpf_do_one_work_cycle(int *out_count)
         }
         gen_mutex_unlock(&dbpf_op_queue_mutex);
 
-        /* if there's no work to be done, return immediately */
         if (cur_op == NULL)
         {
+            if (dbpf_group.coll_p)
+            {
+                /* hold the group open a little if more writes are
+                 * likely to arrive, unless the last wait gathered none
+                 */
+                int window = 0;
+
+                if (!dbpf_group.waited ||
+                    dbpf_group.count > dbpf_group.count_at_wait)
+                {
+                    window = dbpf_sync_group_window(dbpf_group.coll_p);
+                }
+                if (window > 0)
+                {
+                    dbpf_group.waited = 1;
+                    dbpf_group.count_at_wait = dbpf_group.count;
+                    dbpf_group_wait(window);
+                    continue;
+                }
+
+                ret = dbpf_group_end(out_count);
+                if (ret < 0)
+                {
+                    return ret;
+                }
+            }
+
+            /* if there's no work to be done, return immediately */
             return ret;
         }
 
+        /* a group only holds consecutive writes to one collection */
+        if (dbpf_group.coll_p &&
+            (!dbpf_group_can_add(cur_op) ||
+             cur_op->op.coll_p != dbpf_group.coll_p))
+        {
+            ret = dbpf_group_end(out_count);
+            if (ret < 0)
+            {
+                return ret;
+            }
+        }
+        if (!dbpf_group.coll_p && dbpf_group_can_add(cur_op))
+        {
+            dbpf_group_begin(cur_op->op.coll_p);
+        }
+
         /* otherwise, service the current operation now */
         gossip_debug(GOSSIP_TROVE_OP_DEBUG,"[DBPF THREAD]: STARTING TROVE "
                      "SERVICE ROUTINE (%s)\n",
                      dbpf_op_type_to_str(cur_op->op.type));
 
-        ret = cur_op->op.svc_fn(&(cur_op->op));
+        ret = dbpf_op_service(&(cur_op->op));
 
         gossip_debug(GOSSIP_TROVE_OP_DEBUG,"[DBPF THREAD]: FINISHED TROVE "
                      "SERVICE ROUTINE (%s) (ret: %d)\n",
                      dbpf_op_type_to_str(cur_op->op.type),
                      ret);
-        if (ret == DBPF_OP_COMPLETE || ret < 0)
+        if (dbpf_group.coll_p && (ret == DBPF_OP_COMPLETE || ret < 0))
+        {
+            /* completed along with the rest of the group once it is
+             * committed
+             */
+            dbpf_group.ops[dbpf_group.count] = cur_op;
+            dbpf_group.retcodes[dbpf_group.count] =
+                (ret == DBPF_OP_COMPLETE ? 0 : ret);
+            dbpf_group.count++;
+            if (dbpf_group.count >= dbpf_group.coll_p->c_group_max_ops)
+            {
+                ret = dbpf_group_end(out_count);
+                if (ret < 0)
+                {
+                    return ret;
+                }
+            }
+        }
+        else if (ret == DBPF_OP_COMPLETE || ret < 0)
         {
             /* Some dbpf calls may return non-fatal errors
              * (for example, a crdirent for an entry that already exists).
@@ -252,7 +433,7 @@ int dbpf_do_one_work_cycle(int *out_count)
             dbpf_queued_op_queue(cur_op);
         }
 
-    } while(--max_num_ops_to_service);
+    } while(--max_num_ops_to_service > 0 || dbpf_group.coll_p);
 #endif
 
     return 0;
@@ -18,6 +18,9 @@ extern "C" {
 
 #define DBPF_OPS_PER_WORK_CYCLE 5
 
+/* upper bound on the metadata writes committed as one group */
+#define DBPF_GROUP_MAX_OPS 256
+
 int dbpf_thread_initialize(void);
 
 int dbpf_thread_finalize(void);
@@ -52,6 +52,9 @@ extern "C" {
 */
 #define DBPF_BSTREAM_MAX_NUM_BUCKETS  64
 
+/* most aiocbs handed to a single lio_listio() call by the bstream code */
+#define AIOCB_ARRAY_SZ 64
+
 #define DBPF_BSTREAM_GET_BUCKET(__handle)                                \
 ((__handle) % DBPF_BSTREAM_MAX_NUM_BUCKETS)
 
@@ -286,6 +289,13 @@ struct dbpf_collection
     int c_low_watermark;
     int c_high_watermark;
     int meta_sync_enabled;
+    /*
+     * Queued metadata writes are committed in groups of up to
+     * c_group_max_ops; a group may be held open for up to
+     * c_group_window microseconds waiting for more.
+     */
+    int c_group_max_ops;
+    int c_group_window;
     /*
      * If this option is on we don't queue ops or use threads.
      */
@@ -547,6 +557,7 @@ enum dbpf_op_type
     KEYVAL_WRITE_LIST,
     KEYVAL_FLUSH,
     KEYVAL_GET_HANDLE_INFO,
+    KEYVAL_SET_HANDLE_INFO,
     DSPACE_CREATE = DSPACE_OP_TYPE,
     DSPACE_REMOVE,
     DSPACE_ITERATE_HANDLES,
@@ -561,10 +572,29 @@ enum dbpf_op_type
      */
 };
 
+/* ops that only read the keyval and dspace databases */
+#define DBPF_OP_IS_META_READ(__op)     \
+    (__op == KEYVAL_READ            || \
+     __op == KEYVAL_READ_LIST       || \
+     __op == KEYVAL_ITERATE         || \
+     __op == KEYVAL_ITERATE_KEYS    || \
+     __op == KEYVAL_GET_HANDLE_INFO || \
+     __op == DSPACE_ITERATE_HANDLES || \
+     __op == DSPACE_GETATTR         || \
+     __op == DSPACE_GETATTR_LIST)
+
+/* reads set up with dbpf_op_init_read_or_queued() run in the calling
+ * thread when the collection is in immediate completion mode or the
+ * database tolerates concurrent reads
+ */
+#define DBPF_READ_INLINE(__coll_p) \
+    ((__coll_p)->immediate_completion || dbpf_db_concurrent_reads())
+
 #define DBPF_OP_DOES_SYNC(__op)    \
     (__op == KEYVAL_WRITE       || \
      __op == KEYVAL_REMOVE_KEY  || \
      __op == KEYVAL_WRITE_LIST  || \
+     __op == KEYVAL_SET_HANDLE_INFO || \
      __op == DSPACE_CREATE      || \
      __op == DSPACE_CREATE_LIST || \
      __op == DSPACE_REMOVE      || \
@@ -628,6 +658,7 @@ struct dbpf_op
         struct dbpf_dspace_getattr_list_op d_getattr_list;
         struct dbpf_dspace_remove_list_op d_remove_list;
         struct dbpf_keyval_get_handle_info_op k_get_handle_info;
+        struct dbpf_keyval_get_handle_info_op k_set_handle_info;
     } u;
 };
 
@@ -701,7 +732,7 @@ do {                                                          \
 } while(0)
 
 #define DBPF_EVENT_START(__coll_p, __q_op_p, __event_type, __event_id, args...) \
-    if(__coll_p->immediate_completion)                                          \
+    if(!(__q_op_p))                                                             \
     {                                                                           \
         PINT_EVENT_START(__event_type, dbpf_pid, NULL, (__event_id),            \
                          ## args);                                              \
@@ -858,6 +889,13 @@ int dbpf_bstream_validate(TROVE_coll_id coll_id,
                           TROVE_op_id *out_op_id_p,
                           PVFS_hint  hints);
 
+int dbpf_bstream_get_fd(TROVE_coll_id coll_id,
+                        TROVE_handle handle,
+                        int *out_fd,
+                        void **out_ref);
+
+void dbpf_bstream_put_fd(void *ref);
+
 #if defined(__cplusplus)
 }
 #endif
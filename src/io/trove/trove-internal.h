@@ -115,6 +115,20 @@ struct TROVE_bstream_ops
          TROVE_coll_id coll_id,
          TROVE_op_id cancel_id,
          TROVE_context_id context_id);
+
+     /* optional; hands out a descriptor open on the bstream so that
+      * callers can move its data with the kernel (e.g. sendfile())
+      * instead of reading it into memory.  Methods whose descriptors do
+      * not go through the page cache leave these NULL.
+      */
+     int (*bstream_get_fd)(
+         TROVE_coll_id coll_id,
+         TROVE_handle handle,
+         int *out_fd,
+         void **out_ref);
+
+     void (*bstream_put_fd)(
+         void *ref);
 };
 
 struct TROVE_keyval_ops
@@ -249,6 +263,15 @@ struct TROVE_keyval_ops
         TROVE_context_id context_id,
         TROVE_op_id *out_op_id_p,
         PVFS_hint hints);
+    int (*keyval_set_handle_info)(
+        TROVE_coll_id coll_id,
+        TROVE_handle handle,
+        TROVE_ds_flags flags,
+        TROVE_keyval_handle_info *info,
+        void *user_ptr,
+        TROVE_context_id context_id,
+        TROVE_op_id *out_op_id_p,
+        PVFS_hint hints);
 };
 
 struct TROVE_dspace_ops
@@ -53,7 +53,8 @@ typedef enum
     TROVE_METHOD_DBPF = 0,
     TROVE_METHOD_DBPF_ALTAIO,
     TROVE_METHOD_DBPF_NULLAIO,
-    TROVE_METHOD_DBPF_DIRECTIO
+    TROVE_METHOD_DBPF_DIRECTIO,
+    TROVE_METHOD_DBPF_IOURING
 } TROVE_method_id;
 
 typedef TROVE_method_id (*TROVE_method_callback)(TROVE_coll_id);
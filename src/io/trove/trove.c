@@ -34,6 +34,8 @@ struct PINT_perf_counter* PINT_server_tpc = NULL;
 
 int TROVE_shm_key_hint = 0;
 int TROVE_max_concurrent_io = 16;
+int TROVE_alt_aio_thread_count = 16;
+int TROVE_io_uring_queue_depth = 256;
 
 extern TROVE_method_callback global_trove_method_callback;
 
@@ -259,6 +261,42 @@ int trove_bstream_flush(
            hints);
 }
 
+/** Obtain a file descriptor that reads the contents of a bstream.  This
+ *  is synchronous; the reference returned in out_ref must be released
+ *  with trove_bstream_put_fd().
+ *
+ *  returns -TROVE_ENOSYS if the collection's method cannot provide one.
+ */
+int trove_bstream_get_fd(
+    TROVE_coll_id coll_id,
+    TROVE_handle handle,
+    int *out_fd,
+    void **out_ref)
+{
+    TROVE_method_id method_id;
+    method_id = global_trove_method_callback(coll_id);
+    if (!bstream_method_table[method_id]->bstream_get_fd)
+    {
+        return -TROVE_ENOSYS;
+    }
+    return bstream_method_table[method_id]->bstream_get_fd(
+           coll_id,
+           handle,
+           out_fd,
+           out_ref);
+}
+
+/** Release a reference obtained from trove_bstream_get_fd().
+ */
+void trove_bstream_put_fd(
+    TROVE_coll_id coll_id,
+    void *ref)
+{
+    TROVE_method_id method_id;
+    method_id = global_trove_method_callback(coll_id);
+    bstream_method_table[method_id]->bstream_put_fd(ref);
+}
+
 /** Initiate read of a single keyword/value pair.
  */
 int trove_keyval_read(
@@ -637,6 +675,28 @@ int trove_keyval_get_handle_info(TROVE_coll_id coll_id,
     hints);
 }
 
+int trove_keyval_set_handle_info(TROVE_coll_id coll_id,
+                                 TROVE_handle handle,
+                                 TROVE_ds_flags flags,
+                                 TROVE_keyval_handle_info *info,
+                                 void * user_ptr,
+                                 TROVE_context_id context_id,
+                                 TROVE_op_id *out_op_id_p,
+                                 PVFS_hint  hints)
+{
+    TROVE_method_id method_id;
+    method_id = global_trove_method_callback(coll_id);
+    return keyval_method_table[method_id]->keyval_set_handle_info(
+        coll_id,
+        handle,
+        flags,
+        info,
+        user_ptr,
+        context_id,
+        out_op_id_p,
+        hints);
+}
+
 /** Initiate creation of multiple new data spaces.
  */
 int trove_dspace_create_list(
@@ -1050,6 +1110,16 @@ int trove_collection_setinfo(
         TROVE_max_concurrent_io = *((int*)parameter);
         return(0);
     }
+    if(option == TROVE_ALT_AIO_THREADS)
+    {
+        TROVE_alt_aio_thread_count = *((int*)parameter);
+        return(0);
+    }
+    if(option == TROVE_IO_URING_QUEUE_DEPTH)
+    {
+        TROVE_io_uring_queue_depth = *((int*)parameter);
+        return(0);
+    }
     method_id = global_trove_method_callback(coll_id);
     return mgmt_method_table[method_id]->collection_setinfo(
            method_id,
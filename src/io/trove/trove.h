@@ -88,7 +88,12 @@ enum
     TROVE_COLLECTION_IMMEDIATE_COMPLETION,
     TROVE_DIRECTIO_THREADS_NUM,
     TROVE_DIRECTIO_OPS_PER_QUEUE,
-    TROVE_DIRECTIO_TIMEOUT
+    TROVE_DIRECTIO_TIMEOUT,
+    TROVE_IO_URING_QUEUE_DEPTH,
+    TROVE_ALT_AIO_THREADS,
+    TROVE_COLLECTION_GROUP_COMMIT_MAX_OPS,
+    TROVE_COLLECTION_GROUP_COMMIT_WINDOW,
+    TROVE_COLLECTION_ATTR_CACHE_MAX_BYTES
 };
 
 /** Initializes the Trove layer.  Must be called before any other Trove
@@ -250,6 +255,14 @@ int trove_bstream_flush(TROVE_coll_id coll_id,
 			TROVE_op_id *out_op_id_p,
             PVFS_hint hints);
 
+int trove_bstream_get_fd(TROVE_coll_id coll_id,
+                         TROVE_handle handle,
+                         int *out_fd,
+                         void **out_ref);
+
+void trove_bstream_put_fd(TROVE_coll_id coll_id,
+                          void *ref);
+
 int trove_keyval_read(
 		      TROVE_coll_id coll_id,
 		      TROVE_handle handle,
@@ -379,6 +392,15 @@ int trove_keyval_get_handle_info(TROVE_coll_id coll_id,
                                  TROVE_op_id *out_op_id_p,
                                  PVFS_hint hints);
 
+int trove_keyval_set_handle_info(TROVE_coll_id coll_id,
+                                 TROVE_handle handle,
+                                 TROVE_ds_flags flags,
+                                 TROVE_keyval_handle_info *info,
+                                 void * user_ptr,
+                                 TROVE_context_id context_id,
+                                 TROVE_op_id *out_op_id_p,
+                                 PVFS_hint hints);
+
 int trove_dspace_create(TROVE_coll_id coll_id,
 			TROVE_handle_extent_array *handle_extent_array,
                         TROVE_handle *out_handle,
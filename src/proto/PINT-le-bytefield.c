@@ -38,6 +38,9 @@ static void zero_credential(PVFS_credential*);
 
 static int initializing_sizes = 0;
 
+/* arena decode_malloc() carves from on this thread, if any */
+PINT_DECODE_TLS struct PINT_decode_arena *PINT_decode_arena_current = NULL;
+
 /* an array of structs for storing precalculated maximum encoding sizes
  * for each type of server operation 
  */
@@ -107,6 +110,7 @@ static void lebf_initialize(void)
             case PVFS_SERV_INVALID:
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
+            case PVFS_SERV_DIRENT_SPLITTER:
             case PVFS_SERV_JOB_TIMER:
                 /* never used, skip initialization */
                 continue;
@@ -552,6 +556,7 @@ static int lebf_encode_req(
         case PVFS_SERV_WRITE_COMPLETION:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRENT_SPLITTER:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, req->op);
@@ -668,6 +673,7 @@ static int lebf_encode_resp(
         case PVFS_SERV_INVALID:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRENT_SPLITTER:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, resp->op);
@@ -694,6 +700,46 @@ static int lebf_encode_resp(
     return ret;
 }
 
+/* lebf_decode_arena_op()
+ *
+ * requests whose decoded pieces may live in a decode arena.  Only ops
+ * whose state machines never hand decoded memory to free() or keep it
+ * past PINT_decode_release() belong here; everything else is decoded
+ * onto the heap as before.
+ */
+static int lebf_decode_arena_op(enum PVFS_server_op op)
+{
+    switch (op)
+    {
+        case PVFS_SERV_LOOKUP_PATH:
+        case PVFS_SERV_CREATE:
+        case PVFS_SERV_REMOVE:
+        case PVFS_SERV_BATCH_CREATE:
+        case PVFS_SERV_BATCH_REMOVE:
+        case PVFS_SERV_IO:
+        case PVFS_SERV_SMALL_IO:
+        case PVFS_SERV_GETATTR:
+        case PVFS_SERV_SETATTR:
+        case PVFS_SERV_LISTATTR:
+        case PVFS_SERV_CRDIRENT:
+        case PVFS_SERV_RMDIRENT:
+        case PVFS_SERV_CHDIRENT:
+        case PVFS_SERV_TRUNCATE:
+        case PVFS_SERV_READDIR:
+        case PVFS_SERV_FLUSH:
+        case PVFS_SERV_STATFS:
+        case PVFS_SERV_GETEATTR:
+        case PVFS_SERV_SETEATTR:
+        case PVFS_SERV_DELEATTR:
+        case PVFS_SERV_LISTEATTR:
+        case PVFS_SERV_GETCONFIG:
+        case PVFS_SERV_MGMT_NOOP:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 /* lebf_decode_req()
  *
  * decodes a request message
@@ -716,6 +762,12 @@ static int lebf_decode_req(
 
     target_msg->buffer = req;
 
+    if (target_msg->arena && input_size >= (int) sizeof(int32_t) &&
+        lebf_decode_arena_op((int32_t) bmitoh32(*(int32_t *) input_buffer)))
+    {
+        PINT_decode_arena_current = target_msg->arena;
+    }
+
     /* decode generic part of request (enough to get op number) */
     decode_PVFS_server_req(p, req);
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"lebf_decode_req\n");
@@ -779,6 +831,7 @@ static int lebf_decode_req(
         case PVFS_SERV_WRITE_COMPLETION:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRENT_SPLITTER:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_PROTO_ERROR:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
@@ -797,6 +850,7 @@ static int lebf_decode_req(
     }
 
   out:
+    PINT_decode_arena_current = NULL;
     return(ret);
 }
 
@@ -886,6 +940,7 @@ static int lebf_decode_resp(
         case PVFS_SERV_INVALID:
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
+        case PVFS_SERV_DIRENT_SPLITTER:
         case PVFS_SERV_JOB_TIMER:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_lerr("%s: invalid operation %d.\n", __func__, resp->op);
@@ -939,6 +994,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                             enum PINT_encode_msg_type input_type)
 {
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"lebf_decode_rel\n");
+    PINT_decode_arena_current = msg->arena;
     if (input_type == PINT_DECODE_REQ) {
         struct PVFS_server_req *req = &msg->stub_dec.req;
         decode_free(req->capability.handle_array);
@@ -1160,6 +1216,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_WRITE_COMPLETION:
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
+            case PVFS_SERV_DIRENT_SPLITTER:
             case PVFS_SERV_JOB_TIMER:
             case PVFS_SERV_PROTO_ERROR:            
             case PVFS_SERV_NUM_OPS:  /* sentinel */
@@ -1396,6 +1453,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 case PVFS_SERV_INVALID:
                 case PVFS_SERV_PERF_UPDATE:
                 case PVFS_SERV_PRECREATE_POOL_REFILLER:
+                case PVFS_SERV_DIRENT_SPLITTER:
                 case PVFS_SERV_JOB_TIMER:
                 case PVFS_SERV_NUM_OPS:  /* sentinel */
                     gossip_lerr("%s: invalid response operation %d.\n",
@@ -1404,6 +1462,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             }
         }
     }
+    PINT_decode_arena_current = NULL;
 }
 
 static int check_req_size(struct PVFS_server_req *req)
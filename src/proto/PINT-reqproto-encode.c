@@ -156,6 +156,27 @@ int PINT_decode(void* input_buffer,
 		struct PINT_decoded_msg* target_msg,
 		PVFS_BMI_addr_t target_addr,
 		PVFS_size size)
+{
+    return(PINT_decode_with_arena(input_buffer, input_type, target_msg,
+                                  target_addr, size, NULL));
+}
+
+/* PINT_decode_with_arena()
+ *
+ * same as PINT_decode(), but the decoder may place the dynamically sized
+ * parts of a request (handle arrays, attributes and the like) in the
+ * caller supplied arena instead of the heap.  The arena must stay valid,
+ * and must not be reused, until PINT_decode_release() has been called on
+ * target_msg.  Anything that does not fit falls back to malloc().
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int PINT_decode_with_arena(void* input_buffer,
+                           enum PINT_encode_msg_type input_type,
+                           struct PINT_decoded_msg* target_msg,
+                           PVFS_BMI_addr_t target_addr,
+                           PVFS_size size,
+                           struct PINT_decode_arena* arena)
 {
     int i=0;
     char* buffer_index = (char*)input_buffer + PINT_ENC_GENERIC_HEADER_SIZE;
@@ -167,6 +188,11 @@ int PINT_decode(void* input_buffer,
 
     gossip_debug(GOSSIP_ENDECODE_DEBUG,"PINT_decode\n");
     target_msg->enc_type = -1;  /* invalid */
+    target_msg->arena = arena;
+    if(arena)
+    {
+        arena->used = 0;
+    }
 
     /* sanity check size */
     if(size < PINT_ENC_GENERIC_HEADER_SIZE)
@@ -41,6 +41,7 @@ struct PINT_decoded_msg
 
     /* fields below this comment are meant for internal use */
     char *ptr_current;                /* current encoding pointer */
+    struct PINT_decode_arena *arena;  /* optional backing for decode_malloc */
 
     /* used for storing decoded info */
     union
@@ -83,6 +84,14 @@ int PINT_decode(
     PVFS_BMI_addr_t target_addr,
     PVFS_size size);
 
+int PINT_decode_with_arena(
+    void* input_buffer,
+    enum PINT_encode_msg_type input_type,
+    struct PINT_decoded_msg* target_msg,
+    PVFS_BMI_addr_t target_addr,
+    PVFS_size size,
+    struct PINT_decode_arena* arena);
+
 void PINT_encode_release(
     struct PINT_encoded_msg* msg,
     enum PINT_encode_msg_type input_type);
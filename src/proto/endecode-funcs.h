@@ -13,7 +13,9 @@
 #define __SRC_PROTO_ENDECODE_FUNCS_H
 
 #include "src/io/bmi/bmi-byteswap.h"
+#include "pvfs2-encode-stubs.h"  /* struct PINT_decode_arena */
 #include <stdint.h>
+#include <stdlib.h>
 #ifdef WIN32
 typedef uint32_t u_int32_t;
 typedef uint64_t u_int64_t;
@@ -183,13 +185,53 @@ typedef uint64_t u_int64_t;
 #define encode_enum(pptr,pbuf) encode_int32_t(pptr,pbuf)
 #define decode_enum(pptr,pbuf) decode_int32_t(pptr,pbuf)
 
+/*
+ * While a thread has a decode arena installed, decode_malloc() hands out
+ * space from it rather than calling malloc(), and decode_free() leaves
+ * pointers into it alone.  Whatever does not fit comes from malloc() as
+ * usual.
+ */
+#ifdef WIN32
+#define PINT_DECODE_TLS __declspec(thread)
+#else
+#define PINT_DECODE_TLS __thread
+#endif
+extern PINT_DECODE_TLS struct PINT_decode_arena *PINT_decode_arena_current;
+
+static inline void *decode_arena_malloc(int n)
+{
+    struct PINT_decode_arena *arena = PINT_decode_arena_current;
+    int len = (n + 7) & ~7;
+    void *p;
+
+    if (arena && arena->size - arena->used >= len)
+    {
+        p = arena->base + arena->used;
+        arena->used += len;
+        return p;
+    }
+    return malloc(n);
+}
+
+static inline void decode_arena_free(void *p)
+{
+    struct PINT_decode_arena *arena = PINT_decode_arena_current;
+
+    if (arena && (char *) p >= arena->base &&
+        (char *) p < arena->base + arena->size)
+    {
+        return;
+    }
+    free(p);
+}
+
 /* memory alloc and free, just for decoding */
 #if 0
 /* this is for debugging, if you want to see what is malloc'd */
 static inline void *decode_malloc (int n) {
 	void *p;
 	if (n>0)
-		p = malloc(n);
+		p = decode_arena_malloc(n);
 	else
 		p = (void *)0;
 	printf("decode malloc %d bytes: %p\n",n,p);
@@ -198,11 +240,11 @@ static inline void *decode_malloc (int n) {
 /* this is for debugging, if you want to see what is free'd */
 static inline void decode_free (void *p) {
 	printf("decode free: %p\n",p);
-	free(p);
+	decode_arena_free(p);
 }
 #else
-#define decode_malloc(n) ((n) != 0 ? malloc(n) : 0)
-#define decode_free(n) free(n)
+#define decode_malloc(n) ((n) != 0 ? decode_arena_malloc(n) : 0)
+#define decode_free(n) decode_arena_free(n)
 #endif
 
 /*
@@ -26,7 +26,7 @@
  * compatibility (such as changing the semantics or protocol fields for an
  * existing request type)
  */
-#define PVFS2_PROTO_MAJOR 7
+#define PVFS2_PROTO_MAJOR 10
 /* update PVFS2_PROTO_MINOR on wire protocol changes that preserve backwards
  * compatibility (such as adding a new request type)
  * NOTE: Incrementing this will make clients unable to talk to older servers.
@@ -98,6 +98,7 @@ enum PVFS_server_op
     PVFS_SERV_TREE_GETATTR = 49,
     PVFS_SERV_MGMT_GET_USER_CERT = 50,
     PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ = 51,
+    PVFS_SERV_DIRENT_SPLITTER = 52, /* not a real protocol request */
 
     /* leave this entry last */
     PVFS_SERV_NUM_OPS
@@ -615,13 +616,15 @@ do {                                                              \
 struct PVFS_servresp_tree_get_file_size
 {
     uint32_t caller_handle_index;
+    uint32_t lease_msecs;    /* shortest lease on any of the sizes */
     uint32_t handle_count;
     PVFS_size  *size;
     PVFS_error *error;
 };
-endecode_fields_1aa_struct(
+endecode_fields_2aa_struct(
     PVFS_servresp_tree_get_file_size,
     uint32_t, caller_handle_index,
+    uint32_t, lease_msecs,
     uint32_t, handle_count,
     PVFS_size, size,
     PVFS_error, error);
@@ -801,10 +804,12 @@ do {                                            \
 struct PVFS_servresp_getattr
 {
     PVFS_object_attr attr;
+    uint32_t lease_msecs; /* how long attr may be trusted, 0 if no lease */
 };
-endecode_fields_1_struct(
+endecode_fields_2_struct(
     PVFS_servresp_getattr,
-    PVFS_object_attr, attr);
+    PVFS_object_attr, attr,
+    uint32_t, lease_msecs);
 #define extra_size_PVFS_servresp_getattr \
     extra_size_PVFS_object_attr
 
@@ -2390,12 +2395,28 @@ do {                                                        \
 
 /* mgmt_split_dirent ************************************************/
 /* - used to send directory entries to another server for storing */
+
+/* what the receiving dirdata server does with the entries.  Staged
+ * entries are not counted, so neither readdir nor rmdir sees them until
+ * a COMMIT sets the count of the dirdata handle to dirent_count.
+ */
+enum PVFS_split_dirent_mode
+{
+    PVFS_SPLIT_DIRENT_WRITE = 0,    /* write entries */
+    PVFS_SPLIT_DIRENT_UNDO = 1,     /* remove written entries */
+    PVFS_SPLIT_DIRENT_STAGE = 2,    /* write entries, uncounted */
+    PVFS_SPLIT_DIRENT_UNSTAGE = 3,  /* remove staged entries */
+    PVFS_SPLIT_DIRENT_RESET = 4,    /* remove every entry, uncounted */
+    PVFS_SPLIT_DIRENT_COMMIT = 5    /* count staged entries */
+};
+
 struct PVFS_servreq_mgmt_split_dirent
 {
     PVFS_fs_id fs_id;
     PVFS_handle dest_dirent_handle;
     PINT_dist   *dist;
-    int32_t     undo;
+    int32_t     dirent_count;  /* COMMIT: entries held after the split */
+    int32_t     mode;          /* enum PVFS_split_dirent_mode */
     int32_t     nentries;
     PVFS_handle *entry_handles;
     char **entry_names;
@@ -2405,8 +2426,8 @@ endecode_fields_5aa_struct(
     PVFS_fs_id, fs_id,
     PVFS_handle, dest_dirent_handle,
     PINT_dist, dist,
-    skip4,,
-    int32_t, undo,
+    int32_t, dirent_count,
+    int32_t, mode,
     int32_t, nentries,
     PVFS_handle, entry_handles,
     string, entry_names);
@@ -2420,7 +2441,8 @@ endecode_fields_5aa_struct(
                                        __fsid,                               \
                                        __dest_dirent_handle,                 \
                                        __dist,                               \
-                                       __undo,                               \
+                                       __mode,                               \
+                                       __dirent_count,                       \
                                        __nentries,                           \
                                        __entry_handles,                      \
                                        __entry_names,                        \
@@ -2433,7 +2455,8 @@ do {                                                                         \
     (__req).u.mgmt_split_dirent.fs_id = (__fsid);                            \
     (__req).u.mgmt_split_dirent.dest_dirent_handle = (__dest_dirent_handle); \
     (__req).u.mgmt_split_dirent.dist          = (__dist);                    \
-    (__req).u.mgmt_split_dirent.undo          = (__undo);                    \
+    (__req).u.mgmt_split_dirent.mode          = (__mode);                    \
+    (__req).u.mgmt_split_dirent.dirent_count  = (__dirent_count);            \
     (__req).u.mgmt_split_dirent.nentries      = (__nentries);                \
     (__req).u.mgmt_split_dirent.entry_handles = (__entry_handles);           \
     (__req).u.mgmt_split_dirent.entry_names   = (__entry_names);             \
@@ -0,0 +1,256 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* This file decides how long a client may trust the attributes returned by
+ * a getattr or tree_get_file_size response.  There is no channel for a
+ * server to call a client back, so a lease that has been handed out cannot
+ * be recalled; instead each lease is sized by how long the object has gone
+ * without changing.  An object that has been stable for t milliseconds is
+ * granted t/2, up to AttrLeaseMaxMsecs, and an object that changed in the
+ * last two seconds is granted nothing, which leaves the client to its own
+ * cache timeouts as before.  Operations that change attributes or sizes
+ * call PINT_attr_lease_changed() so that later grants for the object
+ * shrink until it settles again.
+ *
+ * Only recent changes are remembered.  Anything changed longer ago than
+ * twice the maximum lease gets the maximum anyway and is dropped from the
+ * table; when the table is full the oldest change is dropped early and
+ * becomes the floor below which no change time is assumed, so forgetting
+ * an object never lengthens its lease.  The floor starts at server start
+ * time.
+ */
+
+#include <stdlib.h>
+
+#include "pvfs2-internal.h"
+#include "pint-util.h"
+#include "gen-locks.h"
+#include "quickhash.h"
+#include "quicklist.h"
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "attr-lease.h"
+
+#define LEASE_TABLE_SIZE   1021
+#define LEASE_MAX_TRACKED  65536
+#define LEASE_MIN_MSECS    1000
+
+struct lease_key
+{
+    PVFS_fs_id fs_id;
+    PVFS_handle handle;
+};
+
+struct lease_change
+{
+    struct lease_key key;
+    PVFS_time changed_ms;
+    struct qhash_head hash_link;
+    struct qlist_head list_link;    /* on change_list, oldest first */
+};
+
+static struct qhash_table *change_table = NULL;
+static QLIST_HEAD(change_list);
+static int change_count = 0;
+static PVFS_time floor_ms = 0;
+static PVFS_time max_lease_ms = 0;
+static gen_mutex_t lease_mutex = GEN_MUTEX_INITIALIZER;
+
+static int lease_compare(const void *key, struct qhash_head *link)
+{
+    const struct lease_key *k = key;
+    struct lease_change *c = qhash_entry(link, struct lease_change,
+                                         hash_link);
+
+    return (c->key.handle == k->handle && c->key.fs_id == k->fs_id);
+}
+
+static int lease_hash(const void *key, int table_size)
+{
+    const struct lease_key *k = key;
+
+    return (int)((k->handle ^ (PVFS_handle)k->fs_id) % table_size);
+}
+
+static void lease_drop(struct lease_change *c)
+{
+    qhash_del(&c->hash_link);
+    qlist_del(&c->list_link);
+    change_count--;
+    free(c);
+}
+
+/* forget changes that no longer shorten a lease, and the oldest ones
+ * beyond LEASE_MAX_TRACKED; lease_mutex must be held
+ */
+static void lease_prune(PVFS_time now)
+{
+    struct lease_change *c;
+
+    while (!qlist_empty(&change_list))
+    {
+        c = qlist_entry(change_list.next, struct lease_change, list_link);
+        if (c->changed_ms + 2 * max_lease_ms > now)
+        {
+            if (change_count <= LEASE_MAX_TRACKED)
+            {
+                break;
+            }
+            if (c->changed_ms > floor_ms)
+            {
+                floor_ms = c->changed_ms;
+            }
+        }
+        lease_drop(c);
+    }
+}
+
+/**
+ * Sets up lease tracking.  A max_msecs of 0 disables leases; every grant
+ * is then 0.
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_attr_lease_initialize(int max_msecs)
+{
+    gen_mutex_lock(&lease_mutex);
+    max_lease_ms = max_msecs;
+    floor_ms = PINT_util_get_time_ms();
+    if (max_lease_ms > 0)
+    {
+        change_table = qhash_init(lease_compare, lease_hash,
+                                  LEASE_TABLE_SIZE);
+        if (!change_table)
+        {
+            max_lease_ms = 0;
+            gen_mutex_unlock(&lease_mutex);
+            return -PVFS_ENOMEM;
+        }
+    }
+    gen_mutex_unlock(&lease_mutex);
+
+    gossip_debug(GOSSIP_SERVER_DEBUG, "attribute leases of up to %d ms\n",
+                 max_msecs);
+    return 0;
+}
+
+void PINT_attr_lease_finalize(void)
+{
+    struct lease_change *c, *tmp;
+
+    gen_mutex_lock(&lease_mutex);
+    qlist_for_each_entry_safe(c, tmp, &change_list, list_link)
+    {
+        lease_drop(c);
+    }
+    if (change_table)
+    {
+        qhash_finalize(change_table);
+        change_table = NULL;
+    }
+    max_lease_ms = 0;
+    gen_mutex_unlock(&lease_mutex);
+}
+
+/**
+ * Returns the number of milliseconds for which a client may trust the
+ * attributes of the given object that it is about to be sent.
+ */
+uint32_t PINT_attr_lease_grant(PVFS_fs_id fs_id, PVFS_handle handle)
+{
+    struct lease_key key;
+    struct qhash_head *link;
+    struct lease_change *c;
+    PVFS_time now, last, lease;
+
+    gen_mutex_lock(&lease_mutex);
+    if (max_lease_ms == 0)
+    {
+        gen_mutex_unlock(&lease_mutex);
+        return 0;
+    }
+
+    now = PINT_util_get_time_ms();
+    last = floor_ms;
+    key.fs_id = fs_id;
+    key.handle = handle;
+    link = qhash_search(change_table, &key);
+    if (link)
+    {
+        c = qhash_entry(link, struct lease_change, hash_link);
+        if (c->changed_ms > last)
+        {
+            last = c->changed_ms;
+        }
+    }
+    gen_mutex_unlock(&lease_mutex);
+
+    lease = (now > last) ? (now - last) / 2 : 0;
+    if (lease > max_lease_ms)
+    {
+        lease = max_lease_ms;
+    }
+    if (lease < LEASE_MIN_MSECS)
+    {
+        lease = 0;
+    }
+    return (uint32_t)lease;
+}
+
+/**
+ * Records that the attributes or size of an object have just changed.
+ */
+void PINT_attr_lease_changed(PVFS_fs_id fs_id, PVFS_handle handle)
+{
+    struct lease_key key;
+    struct qhash_head *link;
+    struct lease_change *c;
+    PVFS_time now;
+
+    gen_mutex_lock(&lease_mutex);
+    if (max_lease_ms == 0)
+    {
+        gen_mutex_unlock(&lease_mutex);
+        return;
+    }
+
+    now = PINT_util_get_time_ms();
+    key.fs_id = fs_id;
+    key.handle = handle;
+    link = qhash_search(change_table, &key);
+    if (link)
+    {
+        c = qhash_entry(link, struct lease_change, hash_link);
+        qlist_del(&c->list_link);
+    }
+    else
+    {
+        c = malloc(sizeof(*c));
+        if (!c)
+        {
+            /* can't remember this one; shorten everyone's instead */
+            floor_ms = now;
+            gen_mutex_unlock(&lease_mutex);
+            return;
+        }
+        c->key = key;
+        qhash_add(change_table, &c->key, &c->hash_link);
+        change_count++;
+    }
+    c->changed_ms = now;
+    qlist_add_tail(&c->list_link, &change_list);
+
+    lease_prune(now);
+    gen_mutex_unlock(&lease_mutex);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,28 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+#ifndef __ATTR_LEASE_H
+#define __ATTR_LEASE_H
+
+#include "pvfs2-types.h"
+
+int PINT_attr_lease_initialize(int max_msecs);
+
+void PINT_attr_lease_finalize(void);
+
+uint32_t PINT_attr_lease_grant(PVFS_fs_id fs_id, PVFS_handle handle);
+
+void PINT_attr_lease_changed(PVFS_fs_id fs_id, PVFS_handle handle);
+
+#endif /* __ATTR_LEASE_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
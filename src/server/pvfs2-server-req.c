@@ -51,6 +51,7 @@ extern struct PINT_server_req_params pvfs2_batch_remove_params;
 extern struct PINT_server_req_params pvfs2_unstuff_params;
 extern struct PINT_server_req_params pvfs2_stuffed_create_params;
 extern struct PINT_server_req_params pvfs2_precreate_pool_refiller_params;
+extern struct PINT_server_req_params pvfs2_dirent_splitter_params;
 extern struct PINT_server_req_params pvfs2_mirror_params;
 extern struct PINT_server_req_params pvfs2_create_immutable_copies_params;
 extern struct PINT_server_req_params pvfs2_tree_remove_params;
@@ -121,11 +122,12 @@ struct PINT_server_req_entry PINT_server_req_table[] =
     /* 49 */ {PVFS_SERV_TREE_GETATTR, &pvfs2_tree_getattr_params},
 #ifdef ENABLE_SECURITY_CERT    
     /* 50 */ {PVFS_SERV_MGMT_GET_USER_CERT, &pvfs2_get_user_cert_params},
-    /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, &pvfs2_get_user_cert_keyreq_params}
+    /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, &pvfs2_get_user_cert_keyreq_params},
 #else
     /* 50 */ {PVFS_SERV_MGMT_GET_USER_CERT, NULL},
     /* 51 */ {PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, NULL},
 #endif
+    /* 52 */ {PVFS_SERV_DIRENT_SPLITTER, &pvfs2_dirent_splitter_params},
 };
 
 #define CHECK_OP(_op_) assert(_op_ == PINT_server_req_table[_op_].op_type)
@@ -186,6 +188,20 @@ int PINT_server_req_get_object_ref(
     }
 }
 
+void PINT_server_req_get_extent(
+    struct PVFS_server_req *req, PVFS_offset *start, PVFS_offset *end)
+{
+    CHECK_OP(req->op);
+
+    if(!PINT_server_req_table[req->op].params->get_extent ||
+       PINT_server_req_table[req->op].params->get_extent(req, start, end) < 0)
+    {
+        /* whole object */
+        *start = 0;
+        *end = -1;
+    }
+}
+
 int PINT_server_req_get_credential(
     struct PVFS_server_req *req, PVFS_credential **cred)
 {
@@ -0,0 +1,425 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* This file contains the optional pool of threads that run server state
+ * machines.  When StateMachineThreads is nonzero the main loop only waits
+ * on the job layer, handing each completed job to
+ * server_sm_workers_dispatch() rather than advancing its state machine.
+ *
+ * A state machine is never run by two threads at once.  Each machine
+ * that is queued or running has an entry in busy_table holding the job
+ * completions that have arrived for it, oldest first; whichever thread
+ * owns the entry drains them in order.  PINT_state_machine_start() also
+ * claims the machine it starts, because the first job posted may
+ * complete before the starting thread is done with the smcb.  Entries
+ * are keyed on the smcb address alone and never dereference it, so an
+ * entry that outlives its state machine is harmless.
+ *
+ * Ordering between requests on the same handle is left to the request
+ * scheduler, as it is when the main loop runs everything itself.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "pvfs2-server.h"
+#include "pvfs2-internal.h"
+#include "quickhash.h"
+#include "gen-locks.h"
+
+#define SM_WORKERS_TABLE_SIZE 1021
+
+/* one job completion waiting for its state machine */
+struct sm_completion
+{
+    struct qlist_head link;
+    job_status_s status;
+};
+
+/* a state machine that is queued to run or is running */
+struct sm_busy_entry
+{
+    struct qlist_head hash_link;
+    struct qlist_head run_link;
+    struct PINT_smcb *smcb;
+    struct qlist_head completions;
+    gen_thread_t owner;
+    int owned;      /* nonzero while a thread holds the machine */
+    int depth;      /* nested claims by the owner */
+};
+
+static gen_mutex_t workers_mutex = GEN_MUTEX_INITIALIZER;
+/* signalled when work is queued, on resume and on shutdown */
+static gen_cond_t work_cond;
+/* signalled when an entry is released and when the pool goes idle */
+static gen_cond_t release_cond;
+
+static struct qhash_table *busy_table = NULL;
+static QLIST_HEAD(run_queue);
+
+static pthread_t *worker_threads = NULL;
+static int worker_count = 0;
+static int workers_running = 0;
+static int workers_paused = 0;
+static int workers_shutdown = 0;
+
+static void *sm_worker(void *arg);
+static void sm_start_claim(struct PINT_smcb *smcb);
+static void sm_start_release(struct PINT_smcb *smcb);
+static int busy_compare(const void *key, struct qlist_head *link);
+static int busy_hash(const void *key, int table_size);
+
+/* server_sm_workers_initialize()
+ *
+ * starts thread_count state machine threads
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int server_sm_workers_initialize(int thread_count)
+{
+    int i, ret;
+
+    busy_table = qhash_init(busy_compare, busy_hash, SM_WORKERS_TABLE_SIZE);
+    if (!busy_table)
+    {
+        return -PVFS_ENOMEM;
+    }
+    worker_threads = calloc(thread_count, sizeof(pthread_t));
+    if (!worker_threads)
+    {
+        qhash_finalize(busy_table);
+        busy_table = NULL;
+        return -PVFS_ENOMEM;
+    }
+    gen_cond_init(&work_cond);
+    gen_cond_init(&release_cond);
+    workers_shutdown = 0;
+    workers_paused = 0;
+
+    PINT_state_machine_set_start_hooks(sm_start_claim, sm_start_release);
+
+    for (i = 0; i < thread_count; i++)
+    {
+        ret = pthread_create(&worker_threads[i], NULL, sm_worker, NULL);
+        if (ret != 0)
+        {
+            gossip_err("Error: failed to start state machine thread.\n");
+            server_sm_workers_finalize();
+            return -PVFS_errno_to_error(ret);
+        }
+        worker_count++;
+    }
+
+    gossip_debug(GOSSIP_SERVER_DEBUG,
+                 "Started %d state machine threads.\n", worker_count);
+    return 0;
+}
+
+/* server_sm_workers_finalize()
+ *
+ * stops the state machine threads.  Completions that have not been run
+ * are discarded, as they are when the main loop exits.
+ */
+void server_sm_workers_finalize(void)
+{
+    int i;
+    struct sm_busy_entry *entry;
+    struct sm_completion *comp, *tmp;
+
+    gen_mutex_lock(&workers_mutex);
+    workers_shutdown = 1;
+    gen_cond_broadcast(&work_cond);
+    gen_mutex_unlock(&workers_mutex);
+
+    for (i = 0; i < worker_count; i++)
+    {
+        pthread_join(worker_threads[i], NULL);
+    }
+    worker_count = 0;
+    free(worker_threads);
+    worker_threads = NULL;
+
+    PINT_state_machine_set_start_hooks(NULL, NULL);
+
+    /* nothing can reach the table now */
+    for (i = 0; busy_table && i < busy_table->table_size; i++)
+    {
+        struct qlist_head *link;
+
+        while ((link = qhash_search_and_remove_at_index(busy_table, i)))
+        {
+            entry = qlist_entry(link, struct sm_busy_entry, hash_link);
+            qlist_for_each_entry_safe(comp, tmp, &entry->completions, link)
+            {
+                free(comp);
+            }
+            free(entry);
+        }
+    }
+    INIT_QLIST_HEAD(&run_queue);
+    if (busy_table)
+    {
+        qhash_finalize(busy_table);
+        busy_table = NULL;
+    }
+    gen_cond_destroy(&work_cond);
+    gen_cond_destroy(&release_cond);
+}
+
+/* server_sm_workers_dispatch()
+ *
+ * queues a job completion for its state machine; the status is copied
+ */
+void server_sm_workers_dispatch(struct PINT_smcb *smcb, job_status_s *js_p)
+{
+    struct qlist_head *link;
+    struct sm_busy_entry *entry = NULL;
+    struct sm_completion *comp;
+    int ret;
+
+    comp = malloc(sizeof(*comp));
+    if (comp)
+    {
+        entry = malloc(sizeof(*entry));
+    }
+    if (!comp || !entry)
+    {
+        /* no memory to queue it; run it here once nothing else runs */
+        gossip_lerr("Error: out of memory queueing state machine; "
+                    "running it on the main thread.\n");
+        free(comp);
+        server_sm_workers_quiesce();
+        ret = PINT_state_machine_continue(smcb, js_p);
+        if (SM_ACTION_ISERR(ret))
+        {
+            PVFS_perror_gossip("Error: state machine processing error", ret);
+        }
+        server_sm_workers_resume();
+        return;
+    }
+    comp->status = *js_p;
+
+    gen_mutex_lock(&workers_mutex);
+    link = qhash_search(busy_table, &smcb);
+    if (link)
+    {
+        /* its owner, or the worker that picks it up, will run this */
+        qlist_add_tail(&comp->link,
+                       &qlist_entry(link, struct sm_busy_entry,
+                                    hash_link)->completions);
+        gen_mutex_unlock(&workers_mutex);
+        free(entry);
+        return;
+    }
+    memset(entry, 0, sizeof(*entry));
+    entry->smcb = smcb;
+    INIT_QLIST_HEAD(&entry->completions);
+    qlist_add_tail(&comp->link, &entry->completions);
+    qhash_add(busy_table, &entry->smcb, &entry->hash_link);
+    qlist_add_tail(&entry->run_link, &run_queue);
+    gen_cond_signal(&work_cond);
+    gen_mutex_unlock(&workers_mutex);
+}
+
+/* server_sm_workers_quiesce()
+ *
+ * waits until no state machine is running and keeps the workers from
+ * starting more until server_sm_workers_resume() is called.  Used by
+ * the main loop around a configuration reload.
+ */
+void server_sm_workers_quiesce(void)
+{
+    gen_mutex_lock(&workers_mutex);
+    workers_paused = 1;
+    while (workers_running > 0)
+    {
+        gen_cond_wait(&release_cond, &workers_mutex);
+    }
+    gen_mutex_unlock(&workers_mutex);
+}
+
+void server_sm_workers_resume(void)
+{
+    gen_mutex_lock(&workers_mutex);
+    workers_paused = 0;
+    gen_cond_broadcast(&work_cond);
+    gen_mutex_unlock(&workers_mutex);
+}
+
+static void *sm_worker(void *arg)
+{
+    struct sm_busy_entry *entry;
+    struct sm_completion *comp;
+    int ret;
+
+    gen_mutex_lock(&workers_mutex);
+    for (;;)
+    {
+        while (!workers_shutdown &&
+               (workers_paused || qlist_empty(&run_queue)))
+        {
+            gen_cond_wait(&work_cond, &workers_mutex);
+        }
+        if (workers_shutdown)
+        {
+            break;
+        }
+
+        entry = qlist_entry(run_queue.next, struct sm_busy_entry, run_link);
+        qlist_del(&entry->run_link);
+        entry->owner = gen_thread_self();
+        entry->owned = 1;
+        entry->depth = 1;
+        workers_running++;
+
+        /* completions that arrive while the machine runs are appended to
+         * the entry and picked up here
+         */
+        while (!qlist_empty(&entry->completions) && !workers_paused)
+        {
+            comp = qlist_entry(entry->completions.next,
+                               struct sm_completion, link);
+            qlist_del(&comp->link);
+            gen_mutex_unlock(&workers_mutex);
+
+            ret = PINT_state_machine_continue(entry->smcb, &comp->status);
+            if (SM_ACTION_ISERR(ret))
+            {
+                PVFS_perror_gossip("Error: state machine processing error",
+                                   ret);
+            }
+            free(comp);
+
+            gen_mutex_lock(&workers_mutex);
+        }
+
+        entry->owned = 0;
+        entry->depth = 0;
+        if (qlist_empty(&entry->completions))
+        {
+            qhash_del(&entry->hash_link);
+            free(entry);
+        }
+        else
+        {
+            /* paused for a reload; run the rest afterwards */
+            qlist_add(&entry->run_link, &run_queue);
+        }
+        workers_running--;
+        gen_cond_broadcast(&release_cond);
+    }
+    gen_mutex_unlock(&workers_mutex);
+    return NULL;
+}
+
+/* sm_start_claim()
+ *
+ * PINT_state_machine_start() hook: marks smcb as held by this thread.
+ * If another thread still holds an entry at the same address (a freed
+ * machine whose worker has not yet let go) wait for it.
+ */
+static void sm_start_claim(struct PINT_smcb *smcb)
+{
+    struct qlist_head *link;
+    struct sm_busy_entry *entry;
+    gen_thread_t self = gen_thread_self();
+
+    gen_mutex_lock(&workers_mutex);
+    while ((link = qhash_search(busy_table, &smcb)))
+    {
+        entry = qlist_entry(link, struct sm_busy_entry, hash_link);
+        if (entry->owned && pthread_equal(entry->owner, self))
+        {
+            entry->depth++;
+            gen_mutex_unlock(&workers_mutex);
+            return;
+        }
+        gen_cond_wait(&release_cond, &workers_mutex);
+    }
+
+    entry = malloc(sizeof(*entry));
+    if (!entry)
+    {
+        gen_mutex_unlock(&workers_mutex);
+        gossip_lerr("Error: out of memory claiming state machine.\n");
+        return;
+    }
+    memset(entry, 0, sizeof(*entry));
+    entry->smcb = smcb;
+    INIT_QLIST_HEAD(&entry->completions);
+    entry->owner = self;
+    entry->owned = 1;
+    entry->depth = 1;
+    qhash_add(busy_table, &entry->smcb, &entry->hash_link);
+    gen_mutex_unlock(&workers_mutex);
+}
+
+/* sm_start_release()
+ *
+ * PINT_state_machine_start() hook: drops the claim taken by
+ * sm_start_claim(), queueing any completions that arrived meanwhile
+ */
+static void sm_start_release(struct PINT_smcb *smcb)
+{
+    struct qlist_head *link;
+    struct sm_busy_entry *entry;
+
+    gen_mutex_lock(&workers_mutex);
+    link = qhash_search(busy_table, &smcb);
+    if (!link)
+    {
+        gen_mutex_unlock(&workers_mutex);
+        return;
+    }
+    entry = qlist_entry(link, struct sm_busy_entry, hash_link);
+    if (!entry->owned || !pthread_equal(entry->owner, gen_thread_self()) ||
+        --entry->depth > 0)
+    {
+        gen_mutex_unlock(&workers_mutex);
+        return;
+    }
+
+    entry->owned = 0;
+    if (qlist_empty(&entry->completions))
+    {
+        qhash_del(&entry->hash_link);
+        free(entry);
+    }
+    else
+    {
+        qlist_add_tail(&entry->run_link, &run_queue);
+        gen_cond_signal(&work_cond);
+    }
+    gen_cond_broadcast(&release_cond);
+    gen_mutex_unlock(&workers_mutex);
+}
+
+static int busy_compare(const void *key, struct qlist_head *link)
+{
+    const struct PINT_smcb *smcb = *(struct PINT_smcb * const *)key;
+    struct sm_busy_entry *entry =
+        qlist_entry(link, struct sm_busy_entry, hash_link);
+
+    return (entry->smcb == smcb);
+}
+
+static int busy_hash(const void *key, int table_size)
+{
+    uintptr_t addr = (uintptr_t)*(struct PINT_smcb * const *)key;
+
+    /* smcbs are heap allocated; drop the alignment bits */
+    return (int)((addr >> 4) % table_size);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
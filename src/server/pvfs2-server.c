@@ -50,6 +50,7 @@
 #include "client-state-machine.h"
 /* #include "pint-malloc.h" */
 #include "pint-uid-mgmt.h"
+#include "attr-lease.h"
 #include "pint-security.h"
 #include "security-util.h"
 #ifdef ENABLE_CAPCACHE
@@ -107,6 +108,8 @@ QLIST_HEAD(posted_sop_list);
 QLIST_HEAD(inprogress_sop_list);
 /* A list of all serv_op's that are started automatically without requests */
 static QLIST_HEAD(noreq_sop_list);
+/* protects the three lists above once state machine threads are running */
+gen_mutex_t server_sop_list_mutex = GEN_MUTEX_INITIALIZER;
 
 /* this is used externally by some server state machines */
 job_context_id server_job_context = -1;
@@ -397,6 +400,19 @@ int main(int argc, char **argv)
         goto server_shutdown;
     }
 
+    if (server_config.state_machine_threads > 0)
+    {
+        ret = server_sm_workers_initialize(
+            server_config.state_machine_threads);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: failed to start state machine "
+                               "threads", ret);
+            goto server_shutdown;
+        }
+        server_status_flag |= SERVER_SM_WORKERS_INIT;
+    }
+
     gossip_debug_fp(stderr, 'S', GOSSIP_LOGSTAMP_DATETIME,
                     "PVFS2 Server ready.\n");
 
@@ -410,7 +426,15 @@ int main(int argc, char **argv)
             /* If the signal is a SIGHUP, catch and reload configuration */
             if (signal_recvd_flag == SIGHUP)
             {
+                if (server_status_flag & SERVER_SM_WORKERS_INIT)
+                {
+                    server_sm_workers_quiesce();
+                }
                 reload_config();
+                if (server_status_flag & SERVER_SM_WORKERS_INIT)
+                {
+                    server_sm_workers_resume();
+                }
 
                 /* re-open log file to allow normal rotation */
                 gossip_reopen_file(server_config.logfile, "a");
@@ -430,7 +454,10 @@ int main(int argc, char **argv)
                  * all s_ops (for expected messages) have either finished or
                  * timed out,
                  */
-                if (qlist_empty(&inprogress_sop_list))
+                gen_mutex_lock(&server_sop_list_mutex);
+                ret = qlist_empty(&inprogress_sop_list);
+                gen_mutex_unlock(&server_sop_list_mutex);
+                if (ret)
                 {
                     ret = 0;
                     siglevel = signal_recvd_flag;
@@ -460,6 +487,14 @@ int main(int argc, char **argv)
             /* int unexpected_msg = 0; */
             struct PINT_smcb *smcb = server_completed_job_p_array[i];
 
+            if (server_status_flag & SERVER_SM_WORKERS_INIT)
+            {
+                /* a state machine thread will advance it */
+                server_sm_workers_dispatch(smcb,
+                                           &server_job_status_array[i]);
+                continue;
+            }
+
                /* NOTE: PINT_state_machine_next() is a function that
                 * is shared with the client-side state machine
                 * processing, so it is defined in the src/common
@@ -890,6 +925,12 @@ static int server_initialize_subsystems(
                                    &server_config.trove_max_concurrent_io);
     /* this should never fail */
     assert(ret == 0);
+    ret = trove_collection_setinfo(0, 0, TROVE_ALT_AIO_THREADS,
+                                   &server_config.trove_alt_aio_threads);
+    assert(ret == 0);
+    ret = trove_collection_setinfo(0, 0, TROVE_IO_URING_QUEUE_DEPTH,
+                                   &server_config.trove_io_uring_queue_depth);
+    assert(ret == 0);
 
     generate_shm_key_hint(&server_index);
 
@@ -1095,6 +1136,16 @@ static int server_initialize_subsystems(
                     gossip_err("Error setting attr cache max num elems\n");
                 }
 
+                ret = trove_collection_setinfo(
+                                     cur_fs->coll_id,
+                                     trove_context, 
+                                     TROVE_COLLECTION_ATTR_CACHE_MAX_BYTES,
+                                     (void *)&cur_fs->attr_cache_max_bytes);
+                if (ret < 0)
+                {
+                    gossip_err("Error setting attr cache max bytes\n");
+                }
+
                 ret = trove_collection_setinfo(
                                        cur_fs->coll_id,
                                        trove_context, 
@@ -1147,6 +1198,28 @@ static int server_initialize_subsystems(
                 gossip_err("Error setting coalescing low watermark\n");
                 return ret;
             }
+
+            ret = trove_collection_setinfo(
+                                  cur_fs->coll_id,
+                                  trove_context,
+                                  TROVE_COLLECTION_GROUP_COMMIT_MAX_OPS,
+                                  (void *)&cur_fs->group_commit_max_ops);
+            if(ret < 0)
+            {
+                gossip_err("Error setting group commit size\n");
+                return ret;
+            }
+
+            ret = trove_collection_setinfo(
+                                  cur_fs->coll_id,
+                                  trove_context,
+                                  TROVE_COLLECTION_GROUP_COMMIT_WINDOW,
+                                  (void *)&cur_fs->group_commit_window);
+            if(ret < 0)
+            {
+                gossip_err("Error setting group commit window\n");
+                return ret;
+            }
             
             ret = trove_collection_setinfo(
                                   cur_fs->coll_id,
@@ -1253,6 +1326,21 @@ static int server_initialize_subsystems(
     }
     *server_status_flag |= SERVER_REQ_SCHED_INIT;
 
+    ret = PINT_req_sched_set_class_limit(PINT_REQ_SCHED_CLASS_METADATA,
+                                         server_config.qos_metadata_rate,
+                                         server_config.qos_metadata_burst);
+    if (ret == 0)
+    {
+        ret = PINT_req_sched_set_class_limit(PINT_REQ_SCHED_CLASS_IO,
+                                             server_config.qos_io_rate,
+                                             server_config.qos_io_burst);
+    }
+    if (ret < 0)
+    {
+        PVFS_perror_gossip("Error: PINT_req_sched_set_class_limit", ret);
+        return ret;
+    }
+
 #ifndef __PVFS2_DISABLE_PERF_COUNTERS__
     /* history size should be in server config too */
     PINT_server_pc = PINT_perf_initialize(PINT_PERF_COUNTER,
@@ -1347,6 +1435,15 @@ static int server_initialize_subsystems(
 
     *server_status_flag |= SERVER_PRECREATE_INIT;
 
+    ret = PINT_attr_lease_initialize(server_config.attr_lease_max_msecs);
+    if (ret < 0)
+    {
+        gossip_err("Error initializing attribute leases.\n");
+        return (ret);
+    }
+
+    *server_status_flag |= SERVER_ATTR_LEASE_INIT;
+
     return ret;
 }
 
@@ -1802,6 +1899,20 @@ static int server_shutdown(PINT_server_status_flag status,
 
     free(s_server_options.server_alias);
 
+    if (status & SERVER_SM_WORKERS_INIT)
+    {
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting state machine "
+                     "threads     [   ...   ]\n");
+        server_sm_workers_finalize();
+        gossip_debug(GOSSIP_SERVER_DEBUG, "[-]         state machine "
+                     "threads     [ stopped ]\n");
+    }
+
+    if (status & SERVER_ATTR_LEASE_INIT)
+    {
+        PINT_attr_lease_finalize();
+    }
+
     if (status & SERVER_PRECREATE_INIT)
     {
         gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting precreate pool "
@@ -1969,6 +2080,7 @@ static int server_shutdown(PINT_server_status_flag status,
         gossip_debug(GOSSIP_SERVER_DEBUG, "[+] halting dist "
                      "interface            [   ...   ]\n");
         PINT_dist_finalize();
+        PINT_request_plan_cache_finalize();
         gossip_debug(GOSSIP_SERVER_DEBUG, "[-]         dist "
                      "interface            [ stopped ]\n");
     }
@@ -2293,7 +2405,9 @@ int server_post_unexpected_recv(void)
     s_op->target_fs_id = PVFS_FS_ID_NULL;
 
     /* Add an unexpected s_ops to the list */
+    gen_mutex_lock(&server_sop_list_mutex);
     qlist_add_tail(&s_op->next, &posted_sop_list);
+    gen_mutex_unlock(&server_sop_list_mutex);
 
     ret = PINT_state_machine_start(smcb, &js);
     if(ret == SM_ACTION_TERMINATE)
@@ -2357,11 +2471,14 @@ int server_state_machine_start(
     gossip_debug(GOSSIP_SERVER_DEBUG,
             "server_state_machine_start %p\n",smcb);
 
-    ret = PINT_decode(s_op->unexp_bmi_buff.buffer,
-                      PINT_DECODE_REQ,
-                      &s_op->decoded,
-                      s_op->unexp_bmi_buff.addr,
-                      s_op->unexp_bmi_buff.size);
+    s_op->decode_arena.base = (char *) s_op->decode_space;
+    s_op->decode_arena.size = sizeof(s_op->decode_space);
+    ret = PINT_decode_with_arena(s_op->unexp_bmi_buff.buffer,
+                                 PINT_DECODE_REQ,
+                                 &s_op->decoded,
+                                 s_op->unexp_bmi_buff.addr,
+                                 s_op->unexp_bmi_buff.size,
+                                 &s_op->decode_arena);
 
     /* acknowledge that the unexpected buffer has been used up.
      * If *someone* decides to do in-place decoding, then we will have to move
@@ -2400,8 +2517,10 @@ int server_state_machine_start(
         return ret;
     }
     /* Remove s_op from posted_sop_list and move it to the inprogress_sop_list */
+    gen_mutex_lock(&server_sop_list_mutex);
     qlist_del(&s_op->next);
     qlist_add_tail(&s_op->next, &inprogress_sop_list);
+    gen_mutex_unlock(&server_sop_list_mutex);
 
     /* set timestamp on the beginning of this state machine */
     id_gen_fast_register(&tmp_id, s_op);
@@ -2520,7 +2639,9 @@ int server_state_machine_start_noreq(struct PINT_smcb *smcb)
     {
 
         /* add to list of state machines started without a request */
+        gen_mutex_lock(&server_sop_list_mutex);
         qlist_add_tail(&new_op->next, &noreq_sop_list);
+        gen_mutex_unlock(&server_sop_list_mutex);
 
         /* execute first state */
         ret = PINT_state_machine_start(smcb, &tmp_status);
@@ -2549,7 +2670,9 @@ int server_state_machine_complete_noreq(PINT_smcb *smcb)
     gossip_debug(GOSSIP_SERVER_DEBUG, "%s: %p\n", __func__, smcb);
     id_gen_fast_register(&tmp_id, s_op);
                 
+    gen_mutex_lock(&server_sop_list_mutex);
     qlist_del(&s_op->next);
+    gen_mutex_unlock(&server_sop_list_mutex);
                 
     return SM_ACTION_TERMINATE;
 }
@@ -2612,7 +2735,9 @@ int server_state_machine_complete(PINT_smcb *smcb)
 
 
    /* Remove s_op from the inprogress_sop_list */
+    gen_mutex_lock(&server_sop_list_mutex);
     qlist_del(&s_op->next);
+    gen_mutex_unlock(&server_sop_list_mutex);
 
     return SM_ACTION_TERMINATE;
 }
@@ -2677,7 +2802,7 @@ void PINT_server_access_debug(PINT_server_op *s_op,
                               const char *format,
                               ...)
 {
-    static char pint_access_buffer[GOSSIP_BUF_SIZE];
+    char pint_access_buffer[GOSSIP_BUF_SIZE];
     char sig_buf[10], mask_buf[10];
     va_list ap;
 
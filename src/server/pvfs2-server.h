@@ -68,6 +68,12 @@ extern job_context_id server_job_context;
 /* precreate pools will be topped off if they fall below this value */
 #define PVFS2_PRECREATE_LOW_THRESHOLD_DEFAULT 256
 
+/* space each incoming request may decode into before falling back to
+ * malloc(); covers a capability signature plus the usual handle arrays,
+ * distribution and file request of the common operations
+ */
+#define PVFS2_SERVER_DECODE_ARENA_SIZE 1024
+
 /* types of permission checking that a server may need to perform for
  * incoming requests
  */
@@ -159,12 +165,15 @@ typedef enum
     SERVER_SECURITY_INIT       = (1 << 20),
     SERVER_CAPCACHE_INIT       = (1 << 21),
     SERVER_CREDCACHE_INIT      = (1 << 22),
-    SERVER_CERTCACHE_INIT      = (1 << 23)
+    SERVER_CERTCACHE_INIT      = (1 << 23),
+    SERVER_SM_WORKERS_INIT     = (1 << 24),
+    SERVER_ATTR_LEASE_INIT     = (1 << 25)
 } PINT_server_status_flag;
 
 typedef enum
 {
     PRELUDE_PERM_CHECK_DONE    = (1<<0),
+    PRELUDE_GETATTR_DONE       = (1<<1), /* ds_attr filled in by caller */
 } PINT_prelude_flag;
 
 struct PINT_server_create_op
@@ -371,6 +380,7 @@ typedef struct
 {
     int start_entry;
     int nentries;
+    int mode;       /* enum PVFS_split_dirent_mode */
 } split_msg_boundary;
 
 struct PINT_server_crdirent_op
@@ -399,7 +409,6 @@ struct PINT_server_crdirent_op
 
     /* variables used for sending mgmt_split_dirent request */
     PVFS_BMI_addr_t svr_addr; /*destination server address*/
-    PVFS_error *split_status; /*status from PVFS_SERV_MGMT_SPLIT_DIRENT*/
     PINT_dist *dist; /*distribution structure for basic_dist*/
     int read_all_directory_entries;
     int nentries;
@@ -410,6 +419,7 @@ struct PINT_server_crdirent_op
     PVFS_ds_keyval *entries_key_a;
     PVFS_ds_keyval *entries_val_a;
     PVFS_handle *remote_dirdata_handles;
+    struct PINT_dirent_split *split;  /* staged split being committed */
 };
 
 struct PINT_server_setattr_op
@@ -486,6 +496,22 @@ struct PINT_server_precreate_pool_refiller_op
     PVFS_capability capability;
 };
 
+struct PINT_server_dirent_splitter_op
+{
+    struct PINT_dirent_split *split;
+    PVFS_capability capability;
+    PVFS_ds_position position;
+    PVFS_ds_keyval *key_a;
+    PVFS_ds_keyval *val_a;
+    PVFS_dirent *dirent_array;
+    char **entry_names;
+    PVFS_handle *entry_handles;
+    split_msg_boundary *msg_boundaries;
+    int num_msgs;
+    PINT_dist *dist;
+    int done;
+};
+
 struct PINT_server_batch_create_op
 {
     int saved_error_code;
@@ -610,6 +636,12 @@ struct PINT_server_mgmt_get_dirent_op
     PVFS_handle handle;
 };
 
+struct PINT_server_mgmt_split_dirent_op
+{
+    PVFS_ds_keyval_handle_info keyval_handle_info;
+    PVFS_dirent *dirent_array;   /* entries read back by a RESET */
+};
+
 struct PINT_server_mgmt_create_root_dir_op
 {
     PVFS_handle lost_and_found_handle;
@@ -684,6 +716,9 @@ typedef struct PINT_server_op
     /* encoded request and response structures */
     struct PINT_encoded_msg encoded;
     struct PINT_decoded_msg decoded;
+    /* backs the decoded request; lives as long as unexp_bmi_buff */
+    struct PINT_decode_arena decode_arena;
+    uint64_t decode_space[PVFS2_SERVER_DECODE_ARENA_SIZE / sizeof(uint64_t)];
 
     PINT_sm_msgarray_op msgarray_op;
 
@@ -695,6 +730,11 @@ typedef struct PINT_server_op
 
     enum PINT_server_req_access_type access_type;
     enum PINT_server_sched_policy sched_policy;
+    /* byte range of the target the request touches; end -1 = whole object */
+    PVFS_offset target_start;
+    PVFS_offset target_end;
+    /* user (or client) the request is accounted to for QoS */
+    struct PINT_req_sched_flow sched_flow;
 
     int num_pjmp_frames;
 
@@ -723,6 +763,7 @@ typedef struct PINT_server_op
         struct PINT_server_precreate_pool_refiller_op
                                                precreate_pool_refiller;
         struct PINT_server_batch_create_op batch_create;
+        struct PINT_server_dirent_splitter_op dirent_splitter;
         struct PINT_server_batch_remove_op batch_remove;
         struct PINT_server_unstuff_op unstuff;
         struct PINT_server_create_copies_op create_copies;
@@ -730,6 +771,7 @@ typedef struct PINT_server_op
         struct PINT_server_tree_communicate_op tree_communicate;
         struct PINT_server_mgmt_get_dirent_op mgmt_get_dirent;
         struct PINT_server_mgmt_create_root_dir_op mgmt_create_root_dir;
+        struct PINT_server_mgmt_split_dirent_op mgmt_split_dirent;
         struct PINT_server_perf_update_op perf_update;
     } u;
 
@@ -775,6 +817,17 @@ static inline int PINT_get_object_ref_##req_name(                        \
     return 0;                                                            \
 }
 
+/* byte range extent of an I/O style request (one with a file_req) */
+#define PINT_GET_EXTENT_DEFINE(req_name)                                    \
+static inline int PINT_get_extent_##req_name(                               \
+    struct PVFS_server_req *req, PVFS_offset *start, PVFS_offset *end)      \
+{                                                                           \
+    return PINT_request_file_extent(req->u.req_name.file_req,              \
+                                    req->u.req_name.file_req_offset,       \
+                                    req->u.req_name.aggregate_size,        \
+                                    start, end);                           \
+}
+
 #define PINT_GET_CREDENTIAL_DEFINE(req_name)             \
 static inline int PINT_get_credential_##req_name(        \
     struct PVFS_server_req *req, PVFS_credential **cred) \
@@ -821,6 +874,14 @@ struct PINT_server_req_params
     int (*get_object_ref)(
         struct PVFS_server_req *req, PVFS_fs_id *fs_id, PVFS_handle *handle);
 
+    /* A callback implemented by requests that touch only part of their
+     * target object (I/O) to return the byte range [start, end) involved.
+     * The request scheduler lets requests with disjoint ranges run
+     * concurrently.  NULL means the request covers the whole object.
+     */
+    int (*get_extent)(
+        struct PVFS_server_req *req, PVFS_offset *start, PVFS_offset *end);
+
     /* A callback implemented by the request to return the credential from
      * the server request structure. If the server request does not contain
      * a credential this field should be set to NULL.
@@ -844,6 +905,8 @@ int PINT_server_req_get_object_ref(
     struct PVFS_server_req *req, PVFS_fs_id *fs_id, PVFS_handle *handle);
 int PINT_server_req_get_credential(
     struct PVFS_server_req *req, PVFS_credential **cred);
+void PINT_server_req_get_extent(
+    struct PVFS_server_req *req, PVFS_offset *start, PVFS_offset *end);
 
 PINT_server_req_perm_fun
 PINT_server_req_get_perm_fun(struct PVFS_server_req *req);
@@ -950,6 +1013,7 @@ int server_state_machine_terminate(PINT_smcb *smcb, job_status_s *js_p);
 /* lists of server ops */
 extern struct qlist_head posted_sop_list;
 extern struct qlist_head inprogress_sop_list;
+extern gen_mutex_t server_sop_list_mutex;
 
 /* starts state machines not associated with an incoming request */
 int server_state_machine_alloc_noreq(
@@ -958,6 +1022,63 @@ int server_state_machine_start_noreq(
     struct PINT_smcb *new_op);
 int server_state_machine_complete_noreq(PINT_smcb *smcb);
 
+/* distributed directory splits staged in the background, see
+ * dirent-splitter.sm
+ */
+enum PINT_dirent_split_state
+{
+    PINT_DIRENT_SPLIT_STAGING = 0,
+    PINT_DIRENT_SPLIT_READY = 1,   /* every entry staged, ready to commit */
+    PINT_DIRENT_SPLIT_FAILED = 2,
+    PINT_DIRENT_SPLIT_COMMITTING = 3  /* claimed by a crdirent */
+};
+
+struct PINT_dirent_split_entry
+{
+    struct qlist_head hash_link;
+    struct qlist_head list_link;
+    PVFS_handle handle;
+    int seen;                   /* used while committing */
+    char *name;
+};
+
+struct PINT_dirent_split
+{
+    struct qlist_head link;
+    PVFS_fs_id fs_id;
+    PVFS_handle dirent_handle;  /* dirdata handle being split */
+    PVFS_handle split_handle;   /* dirdata handle receiving entries */
+    int split_node;
+    /* the attributes of dirent_handle once the split is done */
+    PVFS_dist_dir_attr dist_dir_attr;
+    PVFS_dist_dir_bitmap dist_dir_bitmap;
+    enum PINT_dirent_split_state state;
+    /* entries staged on split_handle, by name and in staging order */
+    struct qhash_table *staged;
+    struct qlist_head staged_list;
+    int staged_count;
+};
+
+struct PINT_dirent_split *PINT_dirent_split_claim(
+    PVFS_fs_id fs_id, PVFS_handle dirent_handle,
+    enum PINT_dirent_split_state *state);
+int PINT_dirent_split_start(
+    PVFS_fs_id fs_id, PVFS_handle dirent_handle, PVFS_object_attr *attr);
+void PINT_dirent_split_finish(struct PINT_dirent_split *split);
+struct PINT_dirent_split_entry *PINT_dirent_split_lookup(
+    struct PINT_dirent_split *split, const char *name);
+int PINT_dirent_split_note_create(PVFS_fs_id fs_id, PVFS_handle dirent_handle);
+int PINT_dirent_split_pack(
+    char **entry_names, int start_entry, int nentries, int mode,
+    split_msg_boundary **msg_boundaries, int *num_msgs);
+
+/* optional pool of threads that run state machines (StateMachineThreads) */
+int server_sm_workers_initialize(int thread_count);
+void server_sm_workers_finalize(void);
+void server_sm_workers_dispatch(struct PINT_smcb *smcb, job_status_s *js_p);
+void server_sm_workers_quiesce(void);
+void server_sm_workers_resume(void);
+
 /* INCLUDE STATE-MACHINE.H DOWN HERE */
 #if 0
 #define PINT_OP_STATE       PINT_server_op
@@ -15,7 +15,19 @@
  *
  *  \note this is a prototype.  It simply hashes on the handle
  *  value in the request and builds a linked list for each handle.
- *  Only the request at the head of each list is allowed to proceed.
+ *  A request may proceed once nothing ahead of it in its list
+ *  conflicts with it: readers share, and requests that only touch a
+ *  byte range of the object (I/O) share with those whose ranges are
+ *  disjoint from theirs.
+ *
+ *  Requests that could run are further subject to the token bucket of
+ *  their QoS class (metadata or I/O), if one is configured.  While a
+ *  class is out of tokens its requests are held in one queue per flow
+ *  (user, or client if the request has no credential) and released
+ *  by weighted round robin across flows as tokens come back: on its
+ *  turn a flow may release as many requests as its weight, so that
+ *  flows share the class in proportion to their weights and a single
+ *  busy user cannot take the whole class.
  */
 
 /* LONG TERM
@@ -25,6 +37,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #ifndef WIN32
 #include <sys/time.h>
 #endif
@@ -48,6 +61,7 @@
  * schedule, print the operation name, etc.
  */
 #include "src/server/pvfs2-server.h"
+#include "pint-perf-counter.h"
 
 /** request states */
 enum req_sched_states
@@ -62,6 +76,8 @@ enum req_sched_states
     REQ_READY_TO_SCHEDULE,
     /** for timer events */
     REQ_TIMING,
+    /** request could be processed, but its QoS class is out of tokens */
+    REQ_THROTTLED,
 };
 
 /** linked lists to be stored at each hash table element */
@@ -88,8 +104,53 @@ struct req_sched_element
     enum PINT_server_req_access_type access_type;
     int mode_change; /* specifies that the element is a mode change */
     enum PVFS_server_mode mode; /* the mode to change to */
+    /* byte range [start, end) of the object touched; end of -1 means
+     * the request covers the whole object
+     */
+    PVFS_offset start;
+    PVFS_offset end;
+    struct PINT_req_sched_flow sched_flow;	/* user or client */
+    int sched_class;		/* QoS class */
+    struct req_sched_flow *flow;	/* set while REQ_THROTTLED */
+    struct timeval post_tv;	/* when the request was posted */
+};
+
+/** a flow with requests held back by its class's token bucket; the
+ *  held requests are linked through their ready_link
+ */
+struct req_sched_flow
+{
+    struct qlist_head hash_link;	/* ties to the class flow table */
+    struct qlist_head rr_link;	/* ties to the class round robin */
+    struct qlist_head req_list;	/* held requests, oldest first */
+    enum PINT_req_sched_flow_type type;
+    uint64_t id;
+    int weight;			/* requests released per turn */
+    int deficit;		/* releases left in the current turn */
 };
 
+/** QoS state for one class of requests */
+struct req_sched_class
+{
+    int rate;			/* tokens per second, 0 for no limit */
+    int burst;			/* most tokens that may accumulate */
+    double tokens;
+    struct timeval last_fill;
+    struct qhash_table *flow_table;
+    struct qlist_head rr_list;	/* flows with held requests */
+    int held_count;
+};
+
+/* released elements and lists are kept for reuse rather than freed, up
+ * to this many of each.  The job layer serializes all calls into the
+ * scheduler, so the pools need no locking of their own.
+ */
+#define REQ_SCHED_POOL_MAX 1024
+static QLIST_HEAD(element_pool);
+static int element_pool_count = 0;
+static QLIST_HEAD(list_pool);
+static int list_pool_count = 0;
+
 
 /* hash table */
 static struct qhash_table *req_sched_table;
@@ -108,12 +169,54 @@ static QLIST_HEAD(
 static QLIST_HEAD(
     mode_queue);
 
+static struct req_sched_class req_sched_classes[PINT_REQ_SCHED_CLASS_COUNT];
+
+#ifdef __PVFS2_SERVER__
+/* histogram buckets for the time between post and release, per class */
+static const int req_sched_latency_keys[PINT_REQ_SCHED_CLASS_COUNT][4] =
+{
+    {PINT_PERF_QOS_META_1MS, PINT_PERF_QOS_META_10MS,
+     PINT_PERF_QOS_META_100MS, PINT_PERF_QOS_META_SLOW},
+    {PINT_PERF_QOS_IO_1MS, PINT_PERF_QOS_IO_10MS,
+     PINT_PERF_QOS_IO_100MS, PINT_PERF_QOS_IO_SLOW}
+};
+#endif
+
 static int hash_handle(
     const void *handle,
     int table_size);
 static int hash_handle_compare(
     const void *key,
     struct qlist_head *link);
+static struct req_sched_element *req_sched_element_alloc(void);
+static void req_sched_element_free(
+    struct req_sched_element *element);
+static struct req_sched_list *req_sched_list_alloc(void);
+static void req_sched_list_free(
+    struct req_sched_list *list);
+static int req_sched_conflict(
+    struct req_sched_element *element,
+    struct req_sched_element *ahead);
+static void req_sched_wake_behind(
+    struct req_sched_list *list,
+    struct qlist_head *from,
+    struct req_sched_element *released);
+static int req_sched_admit(
+    struct req_sched_element *element);
+static void req_sched_unhold(
+    struct req_sched_element *element);
+static void req_sched_class_fill(
+    struct req_sched_class *sched_class,
+    struct timeval *now);
+static void req_sched_dispatch(void);
+static void req_sched_record_latency(
+    struct req_sched_element *element);
+static int hash_flow(
+    const void *flow,
+    int table_size);
+static int hash_flow_compare(
+    const void *key,
+    struct qlist_head *link);
 
 /* count of how many items are known to the scheduler */
 static int sched_count = 0;
@@ -137,6 +240,8 @@ enum PVFS_server_mode PINT_req_sched_get_mode(void)
 int PINT_req_sched_initialize(
     void)
 {
+    int i;
+
     /* build hash table */
     req_sched_table = qhash_init(hash_handle_compare, hash_handle, 1021);
     if (!req_sched_table)
@@ -144,6 +249,53 @@ int PINT_req_sched_initialize(
 	return (-ENOMEM);
     }
 
+    /* every class starts out unlimited */
+    memset(req_sched_classes, 0, sizeof(req_sched_classes));
+    for (i = 0; i < PINT_REQ_SCHED_CLASS_COUNT; i++)
+    {
+	INIT_QLIST_HEAD(&req_sched_classes[i].rr_list);
+	req_sched_classes[i].flow_table =
+	    qhash_init(hash_flow_compare, hash_flow, 127);
+	if (!req_sched_classes[i].flow_table)
+	{
+	    while (--i >= 0)
+	    {
+		qhash_finalize(req_sched_classes[i].flow_table);
+	    }
+	    qhash_finalize(req_sched_table);
+	    return (-ENOMEM);
+	}
+    }
+
+    return (0);
+}
+
+/** Sets the token bucket of a QoS class.  A rate of 0 removes the
+ *  limit; a burst of 0 allows one second worth of requests.
+ *
+ *  \return 0 on success, -errno on failure
+ */
+int PINT_req_sched_set_class_limit(
+    enum PINT_req_sched_class sched_class,
+    int rate,
+    int burst)
+{
+    struct req_sched_class *cls;
+
+    if (sched_class < 0 || sched_class >= PINT_REQ_SCHED_CLASS_COUNT ||
+	rate < 0 || burst < 0)
+    {
+	return (-EINVAL);
+    }
+
+    cls = &req_sched_classes[sched_class];
+    cls->rate = rate;
+    cls->burst = burst ? burst : rate;
+    cls->tokens = cls->burst;
+    gettimeofday(&cls->last_fill, NULL);
+
+    /* lifting a limit lets everything that was held go */
+    req_sched_dispatch();
     return (0);
 }
 
@@ -213,6 +365,34 @@ int PINT_req_sched_finalize(
 
     sched_count = 0;
 
+    /* empty the free pools */
+    qlist_for_each_safe(iterator, scratch, &element_pool)
+    {
+	free(qlist_entry(iterator, struct req_sched_element, list_link));
+    }
+    INIT_QLIST_HEAD(&element_pool);
+    element_pool_count = 0;
+    qlist_for_each_safe(iterator, scratch, &list_pool)
+    {
+	free(qlist_entry(iterator, struct req_sched_list, hash_link));
+    }
+    INIT_QLIST_HEAD(&list_pool);
+    list_pool_count = 0;
+
+    /* the held requests themselves went with the handle queues */
+    for (i = 0; i < PINT_REQ_SCHED_CLASS_COUNT; i++)
+    {
+	qlist_for_each_safe(iterator, scratch,
+			    &req_sched_classes[i].rr_list)
+	{
+	    free(qlist_entry(iterator, struct req_sched_flow, rr_link));
+	}
+	INIT_QLIST_HEAD(&req_sched_classes[i].rr_list);
+	req_sched_classes[i].held_count = 0;
+	qhash_finalize(req_sched_classes[i].flow_table);
+	req_sched_classes[i].flow_table = NULL;
+    }
+
     /* tear down hash table */
     qhash_finalize(req_sched_table);
     return (0);
@@ -227,13 +407,11 @@ int PINT_req_sched_change_mode(enum PVFS_server_mode mode,
     struct req_sched_element *mode_element;
 
     /* create a structure to store in the request queues */
-    mode_element = (struct req_sched_element *) malloc(
-        sizeof(struct req_sched_element));
+    mode_element = req_sched_element_alloc();
     if (!mode_element)
     {
-        return (-errno);
+        return (-ENOMEM);
     }
-    memset(mode_element, 0, sizeof(*mode_element));
 
     mode_element->user_ptr = user_ptr;
     id_gen_fast_register(id, mode_element);
@@ -335,8 +513,11 @@ static void PINT_req_sched_do_change_mode(
 int PINT_req_sched_post(enum PVFS_server_op op,
                         PVFS_fs_id fs_id,
                         PVFS_handle handle,
+                        PVFS_offset start,
+                        PVFS_offset end,
                         enum PINT_server_req_access_type access_type,
                         enum PINT_server_sched_policy sched_policy,
+                        const struct PINT_req_sched_flow *flow,
 			void *in_user_ptr,
 			req_sched_id * out_id)
 {
@@ -345,10 +526,9 @@ int PINT_req_sched_post(enum PVFS_server_op op,
     struct req_sched_element *tmp_element;
     struct req_sched_element *tmp_element2;
     struct req_sched_list *tmp_list;
-    struct req_sched_element *next_element;
-    struct req_sched_element *last_element;
     struct qlist_head *iterator;
-    int tmp_flag;
+    int conflict_flag = 0;
+    int waiting_flag = 0;
 
     if(sched_policy == PINT_SERVER_REQ_BYPASS)
     {
@@ -373,33 +553,42 @@ int PINT_req_sched_post(enum PVFS_server_op op,
      * on handle == 0 for the moment...
      */
 
+    if(access_type == PINT_SERVER_REQ_MODIFY && !PVFS_SERV_IS_MGMT_OP(op))
+    {
+        if(PINT_req_sched_in_admin_mode())
+        {
+            return(-PVFS_EAGAIN);
+        }
+    }
+
     /* create a structure to store in the request queues */
-    tmp_element = (struct req_sched_element *) malloc(sizeof(struct
-							     req_sched_element));
+    tmp_element = req_sched_element_alloc();
     if (!tmp_element)
     {
-	return (-errno);
+	return (-ENOMEM);
     }
-    memset(tmp_element, 0, sizeof(*tmp_element));
 
     tmp_element->op = op;
     tmp_element->user_ptr = in_user_ptr;
-    id_gen_fast_register(out_id, tmp_element);
-    tmp_element->id = *out_id;
     tmp_element->state = REQ_QUEUED;
     tmp_element->handle = handle;
     tmp_element->list_head = NULL;
     tmp_element->access_type = access_type;
     tmp_element->mode_change = 0;
-
-    if(access_type == PINT_SERVER_REQ_MODIFY && !PVFS_SERV_IS_MGMT_OP(op))
+    tmp_element->start = start;
+    tmp_element->end = end;
+    if (flow)
     {
-        if(PINT_req_sched_in_admin_mode())
-        {
-            free(tmp_element);
-            return(-PVFS_EAGAIN);
-        }
+	tmp_element->sched_flow = *flow;
+    }
+    else
+    {
+	memset(&tmp_element->sched_flow, 0, sizeof(tmp_element->sched_flow));
     }
+    tmp_element->sched_class = (op == PVFS_SERV_IO ||
+				op == PVFS_SERV_SMALL_IO) ?
+	PINT_REQ_SCHED_CLASS_IO : PINT_REQ_SCHED_CLASS_METADATA;
+    gettimeofday(&tmp_element->post_tv, NULL);
 
     /* see if we have a request queue up for this handle */
     hash_link = qhash_search(req_sched_table, &(handle));
@@ -413,11 +602,10 @@ int PINT_req_sched_post(enum PVFS_server_op op,
     {
 	/* no queue yet for this handle */
 	/* create one and add it in */
-	tmp_list = (struct req_sched_list *)malloc(
-            sizeof(struct req_sched_list));
+	tmp_list = req_sched_list_alloc();
 	if (!tmp_list)
 	{
-	    free(tmp_element);
+	    req_sched_element_free(tmp_element);
 	    return (-ENOMEM);
 	}
 
@@ -429,113 +617,59 @@ int PINT_req_sched_post(enum PVFS_server_op op,
     }
 
     /* at either rate, we now have a pointer to the list head */
+    id_gen_fast_register(out_id, tmp_element);
+    tmp_element->id = *out_id;
 
-    /* return 1 if the list is empty before we add this entry */
-    ret = qlist_empty(&(tmp_list->req_list));
-    if (ret == 1)
-    {
-	tmp_element->state = REQ_SCHEDULED;
-    }
-    else
+    /* see whether anything already in the queue keeps this request from
+     * running, and whether anything in it is still waiting itself
+     */
+    qlist_for_each(iterator, &tmp_list->req_list)
     {
-        /* check queue to see if we can apply any optimizations */
-        /* first check: are all current queued operations already scheduled
-         * (ie, is the first and last scheduled?).  We can never bypass a
-         * queued operation 
-         */
-	next_element = qlist_entry((tmp_list->req_list.next),
-				   struct req_sched_element,
-				   list_link);
-	last_element = qlist_entry((tmp_list->req_list.prev),
-				   struct req_sched_element,
-				   list_link);
-	if (op == PVFS_SERV_IO &&
-	    next_element->state == REQ_SCHEDULED &&
-	    last_element->state == REQ_SCHEDULED)
-	{
-            /* possible I/O optimization: see if all scheduled ops for this
-             * handle are for I/O.  If so, we can allow another concurrent
-             * I/O request to proceed 
-             */
-            tmp_flag = 0;
-            qlist_for_each(iterator, &tmp_list->req_list)
-            {
-                tmp_element2 = qlist_entry(iterator, struct req_sched_element,
-                    list_link);
-                if(tmp_element2->op != PVFS_SERV_IO)
-                {
-                    tmp_flag = 1;
-                    break;
-                }
-            }
-
-            if(!tmp_flag)
-            {
-                tmp_element->state = REQ_SCHEDULED;
-                ret = 1;
-                gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                             "concurrent I/O, handle: %llu\n", llu(handle));
-            }
-            else
-            {
-                tmp_element->state = REQ_QUEUED;
-                ret = 0;
-            }
-	}
-	else if (access_type == PINT_SERVER_REQ_READONLY &&
-	    next_element->state == REQ_SCHEDULED &&
-	    last_element->state == REQ_SCHEDULED)
+        tmp_element2 = qlist_entry(iterator, struct req_sched_element,
+            list_link);
+        if(tmp_element2->state != REQ_SCHEDULED)
         {
-            /* possible read only optimization: see if all scheduled ops 
-             * for this handle are read only.  If so, we can allow another 
-             * concurrent read only request to proceed 
-             */
-            tmp_flag = 0;
-            qlist_for_each(iterator, &tmp_list->req_list)
-            {
-                tmp_element2 = qlist_entry(iterator, struct req_sched_element,
-                    list_link);
-                if(tmp_element2->access_type == PINT_SERVER_REQ_MODIFY)
-                {
-                    tmp_flag = 1;
-                    break;
-                }
-            }
-
-            if(!tmp_flag)
-            {
-                tmp_element->state = REQ_SCHEDULED;
-                ret = 1;
-                gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                             "concurrent read only, handle: %llu\n", llu(handle));
-            }
-            else
-            {
-                tmp_element->state = REQ_QUEUED;
-                ret = 0;
-            }
+            waiting_flag = 1;
         }
-        else if((op == PVFS_SERV_CRDIRENT || op == PVFS_SERV_RMDIRENT) &&
-                next_element->state == REQ_SCHEDULED &&
-                last_element->state == REQ_SCHEDULED)
+        if(!conflict_flag && req_sched_conflict(tmp_element, tmp_element2))
+        {
+            conflict_flag = 1;
+        }
+        if(conflict_flag && waiting_flag)
+        {
+            break;
+        }
+    }
+
+    if (!conflict_flag)
+    {
+	tmp_element->state = REQ_SCHEDULED;
+	ret = req_sched_admit(tmp_element);
+        if(!qlist_empty(&tmp_list->req_list))
         {
-            /* possible dirent optimization: see if all scheduled ops for this
-             * handle are for crdirent or rmdirent.  
-             * If so, we can allow another concurrent
-             * dirent request to proceed.
-             */
-            tmp_element->state = REQ_SCHEDULED;
-            tmp_element->access_type = PINT_SERVER_REQ_READONLY;
             gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
-                         "concurrent dirent op, handle: %llu\n", 
-                         llu(handle));
-            ret = 1;
+                         "concurrent %s, handle: %llu\n",
+                         (access_type == PINT_SERVER_REQ_READONLY) ?
+                         "read only" : "I/O", llu(handle));
         }
-	else
-	{
-	    tmp_element->state = REQ_QUEUED;
-	    ret = 0;
-	}
+    }
+    else if((op == PVFS_SERV_CRDIRENT || op == PVFS_SERV_RMDIRENT) &&
+            !waiting_flag)
+    {
+        /* possible dirent optimization: if nothing is waiting on this
+         * handle, allow another concurrent dirent request to proceed.
+         */
+        tmp_element->state = REQ_SCHEDULED;
+        tmp_element->access_type = PINT_SERVER_REQ_READONLY;
+        gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
+                     "concurrent dirent op, handle: %llu\n", 
+                     llu(handle));
+        ret = req_sched_admit(tmp_element);
+    }
+    else
+    {
+	tmp_element->state = REQ_QUEUED;
+	ret = 0;
     }
 
     /* add this element to the list */
@@ -578,13 +712,11 @@ int PINT_req_sched_post_timer(
 	return(1);
 
     /* create a structure to store in the request queues */
-    tmp_element = (struct req_sched_element *)malloc(
-        sizeof(struct req_sched_element));
+    tmp_element = req_sched_element_alloc();
     if (!tmp_element)
     {
-	return (-errno);
+	return (-ENOMEM);
     }
-    memset(tmp_element, 0, sizeof(*tmp_element));
 
     tmp_element->user_ptr = in_user_ptr;
     id_gen_fast_register(out_id, tmp_element);
@@ -648,12 +780,7 @@ int PINT_req_sched_unpost(
     void **returned_user_ptr)
 {
     struct req_sched_element *tmp_element = NULL;
-    struct req_sched_element *next_element = NULL;
-    int next_ready_flag = 0;
-
-    /* NOTE: we set the next_ready_flag to 1 if the next element in
-     * the queue should be put in the ready list 
-     */
+    struct qlist_head *next_link = NULL;
 
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_id);
@@ -667,15 +794,19 @@ int PINT_req_sched_unpost(
     if (tmp_element->state == REQ_READY_TO_SCHEDULE)
     {
 	qlist_del(&(tmp_element->ready_link));
-	next_ready_flag = 1;
 	/* fall through on purpose */
     }
+    else if (tmp_element->state == REQ_THROTTLED)
+    {
+	req_sched_unhold(tmp_element);
+    }
 
     if (returned_user_ptr)
     {
 	returned_user_ptr[0] = tmp_element->user_ptr;
     }
 
+    next_link = tmp_element->list_link.next;
     qlist_del(&(tmp_element->list_link));
 
     /* special operations, like mode changes, may not be associated with a list */
@@ -686,58 +817,21 @@ int PINT_req_sched_unpost(
 	{
 	    /* queue now empty, remove from hash table and destroy */
 	    qlist_del(&(tmp_element->list_head->hash_link));
-	    free(tmp_element->list_head);
+	    req_sched_list_free(tmp_element->list_head);
 	}
 	else
 	{
-	    /* queue not empty, prepare next request in line for
-	     * processing if necessary
+	    /* queue not empty, prepare requests that were waiting on this
+	     * one for processing if necessary
 	     */
-	    if (next_ready_flag)
-	    {
-		next_element =
-		    qlist_entry((tmp_element->list_head->req_list.next),
-				struct req_sched_element,
-				list_link);
-		/* skip looking at the next request if it is already
-		 * ready to go 
-		 */
-		if (next_element->state != REQ_READY_TO_SCHEDULE &&
-		    next_element->state != REQ_SCHEDULED)
-		{
-		    next_element->state = REQ_READY_TO_SCHEDULE;
-		    qlist_add_tail(&(next_element->ready_link), &ready_queue);
-		    /* keep going as long as the operations are I/O requests;
-		     * we let these all go concurrently
-		     */
-		    while (next_element && next_element->op == PVFS_SERV_IO
-			   && next_element->list_link.next !=
-			   &(tmp_element->list_head->req_list))
-		    {
-			next_element =
-			    qlist_entry(next_element->list_link.next,
-					struct req_sched_element,
-					list_link);
-			if (next_element
-			    && next_element->op == PVFS_SERV_IO)
-			{
-			    gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED "
-                                "allowing concurrent I/O, handle: %llu\n",
-                                llu(next_element->handle));
-			    next_element->state = REQ_READY_TO_SCHEDULE;
-			    qlist_add_tail(&(next_element->ready_link),
-					   &ready_queue);
-			}
-		    }
-		}
-	    }
+	    req_sched_wake_behind(tmp_element->list_head, next_link,
+				  tmp_element);
 	}
 	sched_count--;
     }
 
     /* destroy the unposted element */
-    free(tmp_element);
+    req_sched_element_free(tmp_element);
 
     PINT_req_sched_schedule_mode_change();
     return (0);
@@ -756,7 +850,7 @@ int PINT_req_sched_release(
 {
     struct req_sched_element *tmp_element = NULL;
     struct req_sched_list *tmp_list = NULL;
-    struct req_sched_element *next_element = NULL;
+    struct qlist_head *next_link = NULL;
 
     /* NOTE: for now, this function always returns immediately- no
      * need to fill in the out_id
@@ -774,7 +868,13 @@ int PINT_req_sched_release(
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_completed_id);
 
+    if (tmp_element->list_head)
+    {
+	req_sched_record_latency(tmp_element);
+    }
+
     /* remove it from its handle queue */
+    next_link = tmp_element->list_link.next;
     qlist_del(&(tmp_element->list_link));
 
     /* find the top of the queue */
@@ -792,81 +892,15 @@ int PINT_req_sched_release(
 	     * and deallocate 
 	     */
 	    qlist_del(&(tmp_list->hash_link));
-	    free(tmp_list);
+	    req_sched_list_free(tmp_list);
 	}
 	else
 	{
-	    /* something is queued behind this request */
-	    /* find the next request, change its state, and add it to
-	     * the queue of requests that are ready to be scheduled
-	     */
-	    next_element = qlist_entry((tmp_list->req_list.next),
-				       struct req_sched_element,
-				       list_link);
-	    /* skip it if the top queue item is already ready for
-	     * scheduling 
+	    /* something is queued behind this request; move whatever it
+	     * was holding up to the queue of requests that are ready to
+	     * be scheduled
 	     */
-	    if (next_element->state != REQ_READY_TO_SCHEDULE &&
-		next_element->state != REQ_SCHEDULED)
-	    {
-		next_element->state = REQ_READY_TO_SCHEDULE;
-		qlist_add_tail(&(next_element->ready_link), &ready_queue);
-
-                if(next_element->op == PVFS_SERV_IO)
-                {
-                    /* keep going as long as the operations are I/O requests;
-                     * we let these all go concurrently
-                     */
-                    while (next_element &&
-                           (next_element->op == PVFS_SERV_IO) &&
-                           (next_element->list_link.next != &(tmp_list->req_list)))
-                    {
-                        next_element =
-                            qlist_entry(next_element->list_link.next,
-                                        struct req_sched_element,
-                                        list_link);
-                        if (next_element &&
-                            (next_element->op == PVFS_SERV_IO))
-                        {
-                            gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG,
-                                "REQ SCHED allowing concurrent I/O (release time), "
-                                "handle: %llu\n", llu(next_element->handle));
-                            assert(next_element->state == REQ_QUEUED);
-                            next_element->state = REQ_READY_TO_SCHEDULE;
-                            qlist_add_tail(
-                                &(next_element->ready_link), &ready_queue);
-                        }
-                    }
-                }
-                else if(next_element->access_type == PINT_SERVER_REQ_READONLY)
-                {
-                    /* keep going as long as the operations are read only;
-                     * we let these all go concurrently
-                     */
-                    while (next_element &&
-                           (next_element->access_type == PINT_SERVER_REQ_READONLY) &&
-                           (next_element->list_link.next != &(tmp_list->req_list)))
-                    {
-                        next_element =
-                            qlist_entry(next_element->list_link.next,
-                                        struct req_sched_element,
-                                        list_link);
-                        if (next_element &&
-                            (next_element->access_type == PINT_SERVER_REQ_READONLY))
-                        {
-                            gossip_debug(
-                                GOSSIP_REQ_SCHED_DEBUG,
-                                "REQ SCHED allowing concurrent read only (release time), "
-                                "handle: %llu\n", llu(next_element->handle));
-                            assert(next_element->state == REQ_QUEUED);
-                            next_element->state = REQ_READY_TO_SCHEDULE;
-                            qlist_add_tail(
-                                &(next_element->ready_link), &ready_queue);
-                        }
-                    }
-                }
-	    }
+	    req_sched_wake_behind(tmp_list, next_link, tmp_element);
 	}
 	sched_count--;
     }
@@ -876,7 +910,7 @@ int PINT_req_sched_release(
 		 llu(tmp_element->handle), tmp_element);
 
     /* destroy the released request element */
-    free(tmp_element);
+    req_sched_element_free(tmp_element);
 
     PINT_req_sched_schedule_mode_change();
     return (1);
@@ -899,6 +933,9 @@ int PINT_req_sched_test(
 
     *out_count_p = 0;
 
+    /* release anything the token buckets now have room for */
+    req_sched_dispatch();
+
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_id);
 
@@ -908,7 +945,8 @@ int PINT_req_sched_test(
 	/* it's already scheduled! */
 	return (-EINVAL);
     }
-    else if (tmp_element->state == REQ_QUEUED)
+    else if (tmp_element->state == REQ_QUEUED ||
+	     tmp_element->state == REQ_THROTTLED)
     {
 	/* it still isn't ready to schedule */
 	return (0);
@@ -951,7 +989,7 @@ int PINT_req_sched_test(
 	    gossip_debug(GOSSIP_REQ_SCHED_DEBUG,
 			 "REQ SCHED TIMER SCHEDULING, queue_element: %p\n",
 			 tmp_element);
-	    free(tmp_element);
+	    req_sched_element_free(tmp_element);
 	    return (1);
 	}
 	else
@@ -982,6 +1020,9 @@ int PINT_req_sched_testsome(
 
     *inout_count_p = 0;
 
+    /* release anything the token buckets now have room for */
+    req_sched_dispatch();
+
     /* if there are any pending timer events, go ahead and get the 
      * current time so that we are ready if we run across one
      */
@@ -1001,7 +1042,8 @@ int PINT_req_sched_testsome(
 	    /* it's already scheduled! */
 	    return (-EINVAL);
 	}
-	else if (tmp_element->state == REQ_QUEUED)
+	else if (tmp_element->state == REQ_QUEUED ||
+		 tmp_element->state == REQ_THROTTLED)
 	{
 	    /* it still isn't ready to schedule */
 	    /* do nothing */
@@ -1046,7 +1088,7 @@ int PINT_req_sched_testsome(
 		gossip_debug(GOSSIP_REQ_SCHED_DEBUG,
 			     "REQ SCHED TIMER SCHEDULING, queue_element: %p\n",
 			     tmp_element);
-		free(tmp_element);
+		req_sched_element_free(tmp_element);
 	    }
 	}
 	else
@@ -1105,13 +1147,16 @@ int PINT_req_sched_testworld(
 			     "REQ SCHED SCHEDULING, queue_element: %p\n",
 			     tmp_element);
 #endif
-		free(tmp_element);
+		req_sched_element_free(tmp_element);
 		if(*inout_count_p == incount)
 		    break;
 	    }
 	}
     }
 
+    /* release anything the token buckets now have room for */
+    req_sched_dispatch();
+
     while (!qlist_empty(&ready_queue) && (*inout_count_p < incount))
     {
 	tmp_element = qlist_entry((ready_queue.next), struct req_sched_element,
@@ -1138,6 +1183,454 @@ int PINT_req_sched_testworld(
 	return (0);
 }
 
+/** Reports how soon the scheduler needs to be tested again to release
+ *  requests held back by a token bucket.
+ *
+ *  \return milliseconds until the next release, or -1 if nothing is
+ *  held
+ */
+int PINT_req_sched_throttle_delay(
+    void)
+{
+    struct req_sched_class *cls;
+    struct timeval now;
+    int delay = -1;
+    int ms;
+    int i;
+
+    for (i = 0; i < PINT_REQ_SCHED_CLASS_COUNT; i++)
+    {
+	cls = &req_sched_classes[i];
+	if (cls->held_count == 0)
+	{
+	    continue;
+	}
+	if (delay < 0)
+	{
+	    gettimeofday(&now, NULL);
+	}
+	req_sched_class_fill(cls, &now);
+	ms = 0;
+	if (cls->rate > 0 && cls->tokens < 1.0)
+	{
+	    ms = (int) ((1.0 - cls->tokens) * 1000.0 / cls->rate) + 1;
+	}
+	if (delay < 0 || ms < delay)
+	{
+	    delay = ms;
+	}
+    }
+
+    return (delay);
+}
+
+/* req_sched_element_alloc()
+ *
+ * takes a zeroed element from the pool, or allocates a new one
+ *
+ * returns pointer to element on success, NULL on failure
+ */
+static struct req_sched_element *req_sched_element_alloc(void)
+{
+    struct req_sched_element *element;
+
+    if (!qlist_empty(&element_pool))
+    {
+	element = qlist_entry(element_pool.next, struct req_sched_element,
+			      list_link);
+	qlist_del(&element->list_link);
+	element_pool_count--;
+    }
+    else
+    {
+	element = (struct req_sched_element *)
+	    malloc(sizeof(struct req_sched_element));
+	if (!element)
+	{
+	    return (NULL);
+	}
+    }
+    memset(element, 0, sizeof(*element));
+    return (element);
+}
+
+/* req_sched_element_free()
+ *
+ * returns an element to the pool
+ *
+ * no return value
+ */
+static void req_sched_element_free(
+    struct req_sched_element *element)
+{
+    if (element_pool_count < REQ_SCHED_POOL_MAX)
+    {
+	qlist_add(&element->list_link, &element_pool);
+	element_pool_count++;
+    }
+    else
+    {
+	free(element);
+    }
+}
+
+/* req_sched_list_alloc()
+ *
+ * takes a per-handle list from the pool, or allocates a new one
+ *
+ * returns pointer to list on success, NULL on failure
+ */
+static struct req_sched_list *req_sched_list_alloc(void)
+{
+    struct req_sched_list *list;
+
+    if (!qlist_empty(&list_pool))
+    {
+	list = qlist_entry(list_pool.next, struct req_sched_list, hash_link);
+	qlist_del(&list->hash_link);
+	list_pool_count--;
+	return (list);
+    }
+    return ((struct req_sched_list *) malloc(sizeof(struct req_sched_list)));
+}
+
+/* req_sched_list_free()
+ *
+ * returns a per-handle list to the pool
+ *
+ * no return value
+ */
+static void req_sched_list_free(
+    struct req_sched_list *list)
+{
+    if (list_pool_count < REQ_SCHED_POOL_MAX)
+    {
+	qlist_add(&list->hash_link, &list_pool);
+	list_pool_count++;
+    }
+    else
+    {
+	free(list);
+    }
+}
+
+/* req_sched_conflict()
+ *
+ * decides whether a request has to wait for one ahead of it in the
+ * same handle queue
+ *
+ * returns 1 if they must be serialized, 0 if they may run concurrently
+ */
+static int req_sched_conflict(
+    struct req_sched_element *element,
+    struct req_sched_element *ahead)
+{
+    /* any number of readers */
+    if (element->access_type == PINT_SERVER_REQ_READONLY &&
+	ahead->access_type == PINT_SERVER_REQ_READONLY)
+    {
+	return (0);
+    }
+
+    /* I/O requests have always been allowed to run alongside each other;
+     * interleaved strided writers have overlapping extents even though
+     * the bytes they write do not
+     */
+    if (element->op == PVFS_SERV_IO && ahead->op == PVFS_SERV_IO)
+    {
+	return (0);
+    }
+
+    /* otherwise only disjoint byte ranges may proceed together */
+    if ((element->end != -1 && element->end <= ahead->start) ||
+	(ahead->end != -1 && ahead->end <= element->start))
+    {
+	return (0);
+    }
+
+    return (1);
+}
+
+/* req_sched_wake_behind()
+ *
+ * called after an element leaves a handle queue; any queued request
+ * from "from" onwards that it was holding up is moved to the ready
+ * queue, as long as nothing else ahead of it still conflicts
+ *
+ * no return value
+ */
+static void req_sched_wake_behind(
+    struct req_sched_list *list,
+    struct qlist_head *from,
+    struct req_sched_element *released)
+{
+    struct qlist_head *iterator;
+    struct qlist_head *ahead_link;
+    struct req_sched_element *element;
+    struct req_sched_element *ahead;
+    int blocked;
+
+    for (iterator = from; iterator != &list->req_list;
+	 iterator = iterator->next)
+    {
+	element = qlist_entry(iterator, struct req_sched_element, list_link);
+	if (element->state != REQ_QUEUED ||
+	    !req_sched_conflict(element, released))
+	{
+	    continue;
+	}
+
+	blocked = 0;
+	for (ahead_link = list->req_list.next; ahead_link != iterator;
+	     ahead_link = ahead_link->next)
+	{
+	    ahead = qlist_entry(ahead_link, struct req_sched_element,
+				list_link);
+	    if (req_sched_conflict(element, ahead))
+	    {
+		blocked = 1;
+		break;
+	    }
+	}
+	if (blocked)
+	{
+	    continue;
+	}
+
+	gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED allowing "
+		     "queued request (release time), handle: %llu\n",
+		     llu(element->handle));
+	if (req_sched_admit(element))
+	{
+	    element->state = REQ_READY_TO_SCHEDULE;
+	    qlist_add_tail(&(element->ready_link), &ready_queue);
+	}
+    }
+}
+
+/* req_sched_admit()
+ *
+ * takes a token for a request that is otherwise free to run.  If its
+ * class has none to give, or is already holding requests back, the
+ * request is held in its flow's queue until req_sched_dispatch()
+ * releases it.
+ *
+ * returns 1 if the request may run now, 0 if it was held
+ */
+static int req_sched_admit(
+    struct req_sched_element *element)
+{
+    struct req_sched_class *cls = &req_sched_classes[element->sched_class];
+    struct req_sched_flow *flow;
+    struct qlist_head *hash_link;
+    struct timeval now;
+
+    /* management requests are never held, so that an administrator can
+     * always get through to a busy server
+     */
+    if (cls->rate == 0 || PVFS_SERV_IS_MGMT_OP(element->op))
+    {
+	return (1);
+    }
+
+    if (cls->held_count == 0)
+    {
+	gettimeofday(&now, NULL);
+	req_sched_class_fill(cls, &now);
+	if (cls->tokens >= 1.0)
+	{
+	    cls->tokens -= 1.0;
+	    return (1);
+	}
+    }
+
+    hash_link = qhash_search(cls->flow_table, &element->sched_flow);
+    if (hash_link)
+    {
+	flow = qlist_entry(hash_link, struct req_sched_flow, hash_link);
+    }
+    else
+    {
+	flow = (struct req_sched_flow *) malloc(sizeof(*flow));
+	if (!flow)
+	{
+	    /* better to run over the limit than to fail the request */
+	    return (1);
+	}
+	flow->type = element->sched_flow.type;
+	flow->id = element->sched_flow.id;
+	flow->weight = (element->sched_flow.weight > 1) ?
+	    element->sched_flow.weight : 1;
+	flow->deficit = 0;
+	INIT_QLIST_HEAD(&flow->req_list);
+	qhash_add(cls->flow_table, &element->sched_flow, &flow->hash_link);
+	qlist_add_tail(&flow->rr_link, &cls->rr_list);
+    }
+
+    element->state = REQ_THROTTLED;
+    element->flow = flow;
+    qlist_add_tail(&element->ready_link, &flow->req_list);
+    cls->held_count++;
+
+    gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED throttling, "
+		 "handle: %llu, flow: %s %llu (weight %d)\n",
+		 llu(element->handle),
+		 (flow->type == PINT_REQ_SCHED_FLOW_CLIENT) ? "client" : "user",
+		 llu(flow->id), flow->weight);
+    return (0);
+}
+
+/* req_sched_unhold()
+ *
+ * takes a held request out of its flow's queue
+ *
+ * no return value
+ */
+static void req_sched_unhold(
+    struct req_sched_element *element)
+{
+    struct req_sched_class *cls = &req_sched_classes[element->sched_class];
+    struct req_sched_flow *flow = element->flow;
+
+    qlist_del(&element->ready_link);
+    element->flow = NULL;
+    cls->held_count--;
+
+    if (qlist_empty(&flow->req_list))
+    {
+	qlist_del(&flow->hash_link);
+	qlist_del(&flow->rr_link);
+	free(flow);
+    }
+}
+
+/* req_sched_class_fill()
+ *
+ * adds the tokens a class has earned since it was last filled
+ *
+ * no return value
+ */
+static void req_sched_class_fill(
+    struct req_sched_class *sched_class,
+    struct timeval *now)
+{
+    double elapsed;
+
+    elapsed = (double) (now->tv_sec - sched_class->last_fill.tv_sec) +
+	(double) (now->tv_usec - sched_class->last_fill.tv_usec) / 1000000.0;
+    if (elapsed <= 0)
+    {
+	return;
+    }
+
+    sched_class->tokens += elapsed * sched_class->rate;
+    if (sched_class->tokens > sched_class->burst)
+    {
+	sched_class->tokens = sched_class->burst;
+    }
+    sched_class->last_fill = *now;
+}
+
+/* req_sched_dispatch()
+ *
+ * moves held requests to the ready queue for as many tokens as each
+ * class has.  Flows take turns; a flow releases up to its weight in
+ * requests on its turn (deficit round robin with a quantum of weight
+ * and a cost of one per request).  A turn cut short by running out of
+ * tokens resumes at the next dispatch.
+ *
+ * no return value
+ */
+static void req_sched_dispatch(
+    void)
+{
+    struct req_sched_class *cls;
+    struct req_sched_flow *flow;
+    struct req_sched_element *element;
+    struct timeval now;
+    int i;
+
+    for (i = 0; i < PINT_REQ_SCHED_CLASS_COUNT; i++)
+    {
+	cls = &req_sched_classes[i];
+	if (cls->held_count == 0)
+	{
+	    continue;
+	}
+
+	gettimeofday(&now, NULL);
+	req_sched_class_fill(cls, &now);
+	while (cls->held_count > 0 && (cls->rate == 0 || cls->tokens >= 1.0))
+	{
+	    flow = qlist_entry(cls->rr_list.next, struct req_sched_flow,
+			       rr_link);
+	    element = qlist_entry(flow->req_list.next,
+				  struct req_sched_element, ready_link);
+
+	    if (flow->deficit == 0)
+	    {
+		flow->deficit = flow->weight;
+	    }
+	    flow->deficit--;
+	    if (flow->deficit == 0)
+	    {
+		/* turn over; the flow goes to the back of the line */
+		qlist_del(&flow->rr_link);
+		qlist_add_tail(&flow->rr_link, &cls->rr_list);
+	    }
+	    /* frees the flow, and its remaining turn, once it is empty */
+	    req_sched_unhold(element);
+	    if (cls->rate > 0)
+	    {
+		cls->tokens -= 1.0;
+	    }
+
+	    element->state = REQ_READY_TO_SCHEDULE;
+	    qlist_add_tail(&element->ready_link, &ready_queue);
+	}
+    }
+}
+
+/* req_sched_record_latency()
+ *
+ * counts a released request in its class's latency histogram
+ *
+ * no return value
+ */
+static void req_sched_record_latency(
+    struct req_sched_element *element)
+{
+#ifdef __PVFS2_SERVER__
+    struct timeval now;
+    long usecs;
+    int bucket;
+
+    gettimeofday(&now, NULL);
+    usecs = (now.tv_sec - element->post_tv.tv_sec) * 1000000L +
+	(now.tv_usec - element->post_tv.tv_usec);
+    if (usecs < 1000)
+    {
+	bucket = 0;
+    }
+    else if (usecs < 10000)
+    {
+	bucket = 1;
+    }
+    else if (usecs < 100000)
+    {
+	bucket = 2;
+    }
+    else
+    {
+	bucket = 3;
+    }
+
+    PINT_perf_count(PINT_server_pc,
+		    req_sched_latency_keys[element->sched_class][bucket],
+		    1, PINT_PERF_ADD);
+#endif
+}
+
 /* hash_handle()
  *
  * hash function for handles added to table
@@ -1185,6 +1678,40 @@ static int hash_handle_compare(
     return (0);
 }
 
+/* hash_flow()
+ *
+ * hash function for the per-class flow tables
+ *
+ * returns hash index
+ */
+static int hash_flow(
+    const void *flow,
+    int table_size)
+{
+    const struct PINT_req_sched_flow *real_flow = flow;
+    uint64_t key = real_flow->id ^ (real_flow->id >> 32) ^ real_flow->type;
+
+    return ((int) (key % table_size));
+}
+
+/* hash_flow_compare()
+ *
+ * performs a comparison of a hash table entry to a given key (used
+ * for searching)
+ *
+ * returns 1 if match found, 0 otherwise
+ */
+static int hash_flow_compare(
+    const void *key,
+    struct qlist_head *link)
+{
+    const struct PINT_req_sched_flow *real_flow = key;
+    struct req_sched_flow *flow;
+
+    flow = qlist_entry(link, struct req_sched_flow, hash_link);
+    return (flow->type == real_flow->type && flow->id == real_flow->id);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -34,6 +34,28 @@ enum PINT_server_sched_policy
     PINT_SERVER_REQ_BYPASS = 0,
     PINT_SERVER_REQ_SCHEDULE
 };
+/** QoS classes; each has its own token bucket and latency histogram */
+enum PINT_req_sched_class
+{
+    PINT_REQ_SCHED_CLASS_METADATA = 0,
+    PINT_REQ_SCHED_CLASS_IO = 1,
+    PINT_REQ_SCHED_CLASS_COUNT = 2
+};
+/** what a QoS flow is keyed on */
+enum PINT_req_sched_flow_type
+{
+    PINT_REQ_SCHED_FLOW_USER = 0,	/* id is a uid */
+    PINT_REQ_SCHED_FLOW_CLIENT = 1	/* id is the client's BMI address */
+};
+/** the flow a request is accounted to while its class is throttled,
+ *  and that flow's share of the class relative to other flows
+ */
+struct PINT_req_sched_flow
+{
+    enum PINT_req_sched_flow_type type;
+    uint64_t id;
+    int weight;			/* values below 1 count as 1 */
+};
 
 /* setup and teardown */
 int PINT_req_sched_initialize(
@@ -44,14 +66,21 @@ int PINT_req_sched_finalize(
 
 int PINT_timer_queue_finalize(void);
 
+int PINT_req_sched_set_class_limit(enum PINT_req_sched_class sched_class,
+                                   int rate,
+                                   int burst);
+
 
 /* retrieving information about incoming requests */
 /* scheduler submission */
 int PINT_req_sched_post(enum PVFS_server_op op,
                         PVFS_fs_id fs_id,
                         PVFS_handle handle,
+                        PVFS_offset start,
+                        PVFS_offset end,
                         enum PINT_server_req_access_type access_type,
                         enum PINT_server_sched_policy sched_policy,
+                        const struct PINT_req_sched_flow *flow,
 			void *in_user_ptr,
 			req_sched_id * out_id);
 
@@ -89,6 +118,8 @@ int PINT_req_sched_testworld(int *inout_count_p,
 			     void **returned_user_ptr_array,
 			     req_sched_error_code * out_status_array);
 
+int PINT_req_sched_throttle_delay(void);
+
 #endif /* __REQUEST_SCHEDULER_H */
 
 /* @} */
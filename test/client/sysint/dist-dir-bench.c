@@ -0,0 +1,247 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* measures how fast names are mapped to distributed directory buckets
+ * with each DistrDirHash function, then creates, looks up and removes
+ * <count> files in a new directory <dirname> to give create and lookup
+ * rates for a large directory; the directory hashes with whatever
+ * DistrDirHash the servers are configured with
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "client.h"
+#include "pvfs2-util.h"
+#include "str-utils.h"
+#include "pint-sysint-utils.h"
+#include "dist-dir-utils.h"
+
+#define HASH_SERVERS 16
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+/* hash count names and map them onto HASH_SERVERS buckets */
+static void hash_names(int hash_type, int count)
+{
+    PVFS_dist_dir_attr dist_dir_attr;
+    PVFS_dist_dir_bitmap bitmap;
+    PVFS_dist_dir_hash_type hash;
+    int buckets[HASH_SERVERS];
+    char name[64];
+    double start_time, end_time;
+    int min, max;
+    int i;
+
+    PINT_init_dist_dir_state(&dist_dir_attr, &bitmap, HASH_SERVERS, -1,
+                             HASH_SERVERS, 10000);
+    dist_dir_attr.hash_type = hash_type;
+    memset(buckets, 0, sizeof(buckets));
+
+    start_time = Wtime();
+    for(i=0; i<count; i++)
+    {
+        sprintf(name, "file.%08d", i);
+        hash = PINT_dist_dir_hash(&dist_dir_attr, name);
+        buckets[PINT_find_dist_dir_bucket(hash, &dist_dir_attr, bitmap)]++;
+    }
+    end_time = Wtime();
+
+    min = max = buckets[0];
+    for(i=1; i<HASH_SERVERS; i++)
+    {
+        if(buckets[i] < min)
+            min = buckets[i];
+        if(buckets[i] > max)
+            max = buckets[i];
+    }
+    printf("%s\t\t%f\t%d\t%d\n", PINT_dist_dir_hash_to_str(hash_type),
+           (end_time - start_time) * 1e9 / count, min, max);
+    free(bitmap);
+}
+
+static void report(const char *op, int count, double start_time)
+{
+    double elapsed = Wtime() - start_time;
+
+    printf("%s\t\t%d\t%f\t%f\n", op, count, elapsed, count / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    char str_buf[256] = {0};
+    char *dirname = NULL;
+    char entry_name[64];
+    PVFS_fs_id cur_fs;
+    PVFS_object_ref parent_refn;
+    PVFS_object_ref dir_refn;
+    PVFS_sysresp_mkdir resp_mkdir;
+    PVFS_sysresp_create resp_create;
+    PVFS_sysresp_lookup resp_lookup;
+    PVFS_sys_attr attr;
+    PVFS_credential credentials;
+    double start_time;
+    int count = 0;
+    int i;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <dirname> <count>\n", argv[0]);
+        return ret;
+    }
+    dirname = argv[1];
+    ret = sscanf(argv[2], "%d", &count);
+    if(ret != 1 || count <= 0)
+    {
+        fprintf(stderr, "Error: could not parse args.\n");
+        return(-1);
+    }
+
+    printf("# hash\t\tns/name\t\tmin bucket\tmax bucket\n");
+    hash_names(PVFS_DIST_DIR_HASH_MD5, count < 1000000 ? 1000000 : count);
+    hash_names(PVFS_DIST_DIR_HASH_MURMUR3, count < 1000000 ? 1000000 : count);
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return (-1);
+    }
+    ret = PVFS_util_get_default_fsid(&cur_fs);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_get_default_fsid", ret);
+        return (-1);
+    }
+
+    /* every lookup should reach the servers, not the name cache */
+    ret = PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_set_info", ret);
+        return (-1);
+    }
+
+    if (PINT_remove_base_dir(dirname, str_buf, 256))
+    {
+        if (dirname[0] != '/')
+        {
+            printf("You forgot the leading '/'\n");
+        }
+        printf("Cannot retrieve entry name for creation on %s\n",
+               dirname);
+        return(-1);
+    }
+
+    PVFS_util_gen_credential_defaults(&credentials);
+
+    ret = PINT_lookup_parent(dirname, cur_fs, &credentials,
+                             &parent_refn.handle);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_lookup_parent", ret);
+        return(-1);
+    }
+    parent_refn.fs_id = cur_fs;
+
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+    attr.owner = credentials.userid;
+    attr.group = credentials.group_array[0];
+    attr.perms = 0777;
+    attr.atime = attr.ctime = attr.mtime = time(NULL);
+
+    memset(&resp_mkdir, 0, sizeof(resp_mkdir));
+    ret = PVFS_sys_mkdir(str_buf, parent_refn, attr, &credentials,
+                         &resp_mkdir, NULL);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_sys_mkdir", ret);
+        return(-1);
+    }
+    dir_refn = resp_mkdir.ref;
+
+    attr.perms = 0644;
+    attr.dfile_count = 1;
+    attr.mask |= PVFS_ATTR_SYS_DFILE_COUNT;
+
+    printf("# op\t\tcount\tseconds\t\tops/sec\n");
+
+    start_time = Wtime();
+    for(i=0; i<count; i++)
+    {
+        sprintf(entry_name, "file.%08d", i);
+        ret = PVFS_sys_create(entry_name, dir_refn, attr, &credentials,
+                              NULL, &resp_create, NULL, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_create", ret);
+            return(-1);
+        }
+    }
+    report("create", count, start_time);
+
+    start_time = Wtime();
+    for(i=0; i<count; i++)
+    {
+        sprintf(entry_name, "file.%08d", i);
+        ret = PVFS_sys_ref_lookup(cur_fs, entry_name, dir_refn,
+                                  &credentials, &resp_lookup,
+                                  PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_ref_lookup", ret);
+            return(-1);
+        }
+    }
+    report("lookup", count, start_time);
+
+    start_time = Wtime();
+    for(i=0; i<count; i++)
+    {
+        sprintf(entry_name, "file.%08d", i);
+        ret = PVFS_sys_remove(entry_name, dir_refn, &credentials, NULL);
+        if(ret < 0)
+        {
+            PVFS_perror("PVFS_sys_remove", ret);
+            return(-1);
+        }
+    }
+    report("remove", count, start_time);
+
+    ret = PVFS_sys_remove(str_buf, parent_refn, &credentials, NULL);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_sys_remove", ret);
+        return(-1);
+    }
+
+    ret = PVFS_sys_finalize();
+    if (ret < 0)
+    {
+        printf("finalizing sysint failed with errcode = %d\n", ret);
+        return (-1);
+    }
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
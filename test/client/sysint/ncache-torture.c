@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "pvfs2.h"
@@ -28,6 +29,8 @@ int main(int argc, char **argv)
     PVFS_object_ref entry_ref;
     char entry_handle[1024];
     char entry_name[PVFS_NAME_MAX] = "";
+    PVFS_object_ref dir_ref;
+    PVFS_dirent dirents[4];
 
     gossip_enable_stderr();
     gossip_set_debug_mask(1, GOSSIP_NCACHE_DEBUG);
@@ -81,6 +84,73 @@ int main(int argc, char **argv)
     gossip_debug(GOSSIP_NCACHE_DEBUG, "Properly resolved two objects "
                  "with the\n  same name based on resolution type\n");
 
+    /* negative entries only hold while the parent's mtime is unchanged */
+    ret = PINT_ncache_update_negative("missing", &root_ref, 1000);
+    if (ret != 0 || !PINT_ncache_is_absent("missing", &root_ref, 1000) ||
+        PINT_ncache_is_absent("missing", &root_ref, 1001) ||
+        PINT_ncache_is_absent("missing", &root_ref, 1000))
+    {
+        gossip_err("Negative entry not handled properly!\n");
+        return -1;
+    }
+    PINT_ncache_update_negative("missing", &root_ref, 1000);
+    test_ref.handle = 1002;
+    PINT_ncache_update("missing", &test_ref, &root_ref);
+    if (PINT_ncache_is_absent("missing", &root_ref, 1000) ||
+        PINT_ncache_get_cached_entry("missing", &test_ref, &root_ref) != 0)
+    {
+        gossip_err("Negative entry not replaced by a new entry!\n");
+        return -1;
+    }
+
+    /* a directory read in two pieces is known in full */
+    memset(dirents, 0, sizeof(dirents));
+    for(i = 0; i < 4; i++)
+    {
+        snprintf(dirents[i].d_name, PVFS_NAME_MAX, "dirent%d", i);
+        dirents[i].handle = 3000 + i;
+    }
+    dir_ref.handle = 300;
+    dir_ref.fs_id = 200;
+    PINT_ncache_update_dir(&dir_ref, 1000, PVFS_READDIR_START, 77,
+                           dirents, 2);
+    if (PINT_ncache_is_absent("other", &dir_ref, 1000))
+    {
+        gossip_err("Partly read directory reported complete!\n");
+        return -1;
+    }
+    PINT_ncache_update_dir(&dir_ref, 1000, 77, PVFS_READDIR_END,
+                           &dirents[2], 2);
+    if (!PINT_ncache_is_absent("other", &dir_ref, 1000) ||
+        PINT_ncache_is_absent("dirent3", &dir_ref, 1000))
+    {
+        gossip_err("Complete directory not handled properly!\n");
+        return -1;
+    }
+    test_ref.handle = 3005;
+    PINT_ncache_update("other", &test_ref, &dir_ref);
+    PINT_ncache_invalidate("other", &dir_ref);
+    PINT_ncache_invalidate("dirent3", &dir_ref);
+    if (!PINT_ncache_is_absent("dirent3", &dir_ref, 1000) ||
+        PINT_ncache_is_absent("dirent2", &dir_ref, 1000) ||
+        PINT_ncache_is_absent("other", &dir_ref, 1001) ||
+        PINT_ncache_is_absent("other", &dir_ref, 1000))
+    {
+        gossip_err("Complete directory not kept up to date!\n");
+        return -1;
+    }
+
+    /* a readdir that does not carry on from the last one is ignored */
+    PINT_ncache_update_dir(&dir_ref, 1000, PVFS_READDIR_START, 77,
+                           dirents, 2);
+    PINT_ncache_update_dir(&dir_ref, 1000, 78, PVFS_READDIR_END,
+                           &dirents[2], 2);
+    if (PINT_ncache_is_absent("other", &dir_ref, 1000))
+    {
+        gossip_err("Interrupted readdir reported complete!\n");
+        return -1;
+    }
+
     sleep(2);
 
     /* Insert a bunch of entries into the cache */
@@ -0,0 +1,323 @@
+/*
+ * (C) 2002 Clemson University.
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Times PINT_process_request() over the file requests of the debug*.c
+ * cases plus a few large MPI-IO style strided ones, once through the
+ * cached flattened requests and compiled strided path and once with
+ * PINT_NOPLAN forcing the tree walk; in server mode, and in client mode
+ * against a strided memory request.  Every run is also checked: both
+ * paths must produce the same segments in the same order and leave the
+ * same final state, across small segment and byte limits, target
+ * offsets and short files.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pvfs2-types.h>
+#include <gossip.h>
+#include <pvfs2-debug.h>
+
+#include <pint-distribution.h>
+#include <pint-dist-utils.h>
+#include <pvfs2-request.h>
+#include <pint-request.h>
+#include "pvfs2-internal.h"
+
+#define SEGMAX 64
+#define SERVERS 4
+
+struct run_sum
+{
+    int64_t calls;
+    int64_t segs;
+    int64_t bytes;
+    uint64_t hash;
+    PVFS_offset type_offset;
+    int eof;
+};
+
+struct bench_case
+{
+    const char *name;
+    PINT_Request *req;
+    PINT_Request *mem;
+    int reps;
+};
+
+static PVFS_offset seg_off[SEGMAX];
+static PVFS_size seg_size[SEGMAX];
+
+static double wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)t.tv_usec / 1000000);
+}
+
+/* pack, encode and decode a request, as it arrives at a server */
+static PINT_Request *pack(PINT_Request *r)
+{
+    PINT_Request *r_enc, *r_dec;
+    int pack_size;
+
+    pack_size = PINT_REQUEST_PACK_SIZE(r);
+    r_enc = (PINT_Request *)malloc(pack_size);
+    PINT_request_commit(r_enc, r);
+    PINT_request_encode(r_enc);
+    r_dec = (PINT_Request *)malloc(pack_size);
+    memcpy(r_dec, r_enc, pack_size);
+    free(r_enc);
+    PINT_request_decode(r_dec);
+    return r_dec;
+}
+
+/* process the whole of one server's share the way a flow does; in client
+ * mode the memory request m is processed alongside
+ */
+static int run(PINT_Request *r, PINT_Request *m, int server_nr,
+               PVFS_offset target, PVFS_size fsize, int segmax,
+               PVFS_size bytemax, int mode, struct run_sum *sum)
+{
+    PINT_Request_state *rs;
+    PINT_Request_state *ms = NULL;
+    PINT_request_file_data rf;
+    PINT_Request_result seg;
+    int i;
+    int ret;
+
+    rs = PINT_new_request_state(r);
+    PINT_REQUEST_STATE_SET_TARGET(rs, target);
+    PINT_REQUEST_STATE_SET_FINAL(rs, target + PINT_REQUEST_TOTAL_BYTES(r));
+    if (PINT_IS_CLIENT(mode))
+    {
+        ms = PINT_new_request_state(m);
+    }
+
+    rf.server_nr = server_nr;
+    rf.server_ct = SERVERS;
+    rf.fsize = fsize;
+    rf.dist = PINT_dist_create("simple_stripe");
+    rf.extend_flag = (fsize < 0);
+    if (rf.extend_flag)
+    {
+        rf.fsize = 0;
+    }
+
+    seg.offset_array = seg_off;
+    seg.size_array = seg_size;
+    seg.segmax = segmax;
+    seg.bytemax = bytemax;
+
+    memset(sum, 0, sizeof(*sum));
+    sum->hash = 14695981039346656037ULL;
+    do
+    {
+        seg.segs = 0;
+        seg.bytes = 0;
+        ret = PINT_process_request(rs, ms, &rf, &seg, mode);
+        if (ret < 0)
+        {
+            break;
+        }
+        for (i = 0; i < seg.segs; i++)
+        {
+            sum->hash = (sum->hash ^ (uint64_t)seg_off[i]) * 1099511628211ULL;
+            sum->hash = (sum->hash ^ (uint64_t)seg_size[i]) * 1099511628211ULL;
+        }
+        sum->calls++;
+        sum->segs += seg.segs;
+        sum->bytes += seg.bytes;
+    } while (!PINT_REQUEST_DONE(rs) && sum->calls < 10000000);
+    sum->type_offset = rs->type_offset;
+    sum->eof = rs->eof_flag;
+
+    PINT_dist_free(rf.dist);
+    PINT_free_request_state(rs);
+    if (ms)
+    {
+        PINT_free_request_state(ms);
+    }
+    return ret;
+}
+
+static int verify(struct bench_case *c, int mode)
+{
+    static const int segmaxes[] = {1, 3, SEGMAX};
+    static const PVFS_size bytemaxes[] = {777, 65536, 16*1024*1024};
+    PVFS_offset targets[3];
+    PVFS_size fsizes[3];
+    struct run_sum a, b;
+    int s, i, j, k, l;
+    int bad = 0;
+
+    targets[0] = 0;
+    targets[1] = 1000;
+    targets[2] = PINT_REQUEST_TOTAL_BYTES(c->req) / 3 + 1;
+    fsizes[0] = -1;          /* write, extending the file */
+    fsizes[1] = 1 << 30;     /* read, file large enough */
+    fsizes[2] = 100000;      /* read, file ends part way */
+
+    for (s = 0; s < SERVERS; s++)
+    for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+    for (k = 0; k < 3; k++)
+    for (l = 0; l < 3; l++)
+    {
+        run(c->req, c->mem, s, targets[l], fsizes[k], segmaxes[i],
+            bytemaxes[j], mode, &a);
+        run(c->req, c->mem, s, targets[l], fsizes[k], segmaxes[i],
+            bytemaxes[j], mode | PINT_NOPLAN, &b);
+        if (memcmp(&a, &b, sizeof(a)) != 0)
+        {
+            printf("%s: MISMATCH %s server %d segmax %d bytemax %lld "
+                   "fsize %lld target %lld\n", c->name,
+                   PINT_IS_CLIENT(mode) ? "client" : "server", s, segmaxes[i],
+                   lld(bytemaxes[j]), lld(fsizes[k]), lld(targets[l]));
+            bad++;
+        }
+    }
+    return bad;
+}
+
+static double timed(struct bench_case *c, int mode, int64_t *segs)
+{
+    struct run_sum sum;
+    double time1, time2;
+    int rep, s;
+
+    *segs = 0;
+    time1 = wtime();
+    for (rep = 0; rep < c->reps; rep++)
+    {
+        for (s = 0; s < SERVERS; s++)
+        {
+            run(c->req, c->mem, s, 0, -1, SEGMAX, 16*1024*1024, mode, &sum);
+            *segs += sum.segs;
+        }
+    }
+    time2 = wtime();
+    return (time2 - time1);
+}
+
+/* a memory request that scatters the bytes of r into 512 byte pieces */
+static PINT_Request *mem_for(PINT_Request *r)
+{
+    PINT_Request *m;
+
+    PVFS_Request_vector(PINT_REQUEST_TOTAL_BYTES(r) / 512 + 1, 512, 1024,
+                        PVFS_BYTE, &m);
+    return m;
+}
+
+static int compare(struct bench_case *c, int mode, const char *label)
+{
+    int64_t segs_plan, segs_walk;
+    double t_plan, t_walk;
+
+    t_walk = timed(c, mode | PINT_NOPLAN, &segs_walk);
+    t_plan = timed(c, mode, &segs_plan);
+    printf("%-14s\t%s\t%lld\t\t%f\t%f\t%.2f\n", c->name, label,
+           lld(segs_plan), t_walk, t_plan, t_walk / t_plan);
+    return (segs_plan != segs_walk);
+}
+
+int main(int argc, char **argv)
+{
+    struct bench_case cases[8];
+    PINT_Request *r, *ra, *rb;
+    int32_t blocklens[100];
+    PVFS_size displs[100];
+    int64_t hits, misses;
+    int entries;
+    int ncases = 0;
+    int bad = 0;
+    int i;
+
+    PINT_dist_initialize(NULL);
+
+    /* debug2.c: 4M contiguous */
+    PVFS_Request_contiguous(4*1024*1024, PVFS_BYTE, &r);
+    cases[ncases].name = "debug2 contig";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 2000;
+
+    /* debug13.c: vector of vectors of doubles */
+    PVFS_Request_vector(4, 4, 16, PVFS_DOUBLE, &ra);
+    PVFS_Request_vector(3, 3, 9, ra, &r);
+    cases[ncases].name = "debug13 vec2";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 2000;
+
+    /* debug22.c: 64 blocks of 3K every 4K */
+    PVFS_Request_vector(64, 3*1024, 4*1024, PVFS_BYTE, &r);
+    cases[ncases].name = "debug22 vector";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 2000;
+
+    /* a column of a 1024 x 1024 matrix of doubles */
+    PVFS_Request_vector(1024, 1, 1024, PVFS_DOUBLE, &r);
+    cases[ncases].name = "column";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 200;
+
+    /* 1M blocks of 8 bytes, 32 apart */
+    PVFS_Request_hvector(1024*1024, 8, 32, PVFS_BYTE, &r);
+    cases[ncases].name = "1M x 8B";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 1;
+
+    /* 256 x 256 subarray of a 4096 x 4096 array of floats */
+    PVFS_Request_vector(256, 256, 4096, PVFS_FLOAT, &ra);
+    PVFS_Request_resized(ra, 0, 4096 * 4096 * 4, &rb);
+    cases[ncases].name = "subarray";
+    cases[ncases].req = pack(rb);
+    cases[ncases++].reps = 20;
+
+    /* 100 irregular runs of doubles, as an unstructured mesh reads them */
+    for (i = 0; i < 100; i++)
+    {
+        blocklens[i] = i % 7 + 1;
+        displs[i] = i * 16 + i % 3;
+    }
+    PVFS_Request_indexed(100, blocklens, displs, PVFS_DOUBLE, &r);
+    cases[ncases].name = "indexed";
+    cases[ncases].req = pack(r);
+    cases[ncases++].reps = 2000;
+
+    for (i = 0; i < ncases; i++)
+    {
+        cases[i].mem = mem_for(cases[i].req);
+        bad += verify(&cases[i], PINT_SERVER);
+        bad += verify(&cases[i], PINT_CLIENT);
+    }
+    printf("verify: %s\n", bad ? "FAILED" : "ok");
+
+    printf("# case\t\tmode\tsegments\twalk (s)\tplan (s)\tspeedup\n");
+    for (i = 0; i < ncases; i++)
+    {
+        bad += compare(&cases[i], PINT_SERVER, "server");
+        bad += compare(&cases[i], PINT_CLIENT, "client");
+    }
+
+    PINT_request_plan_cache_stats(&hits, &misses, &entries);
+    printf("plan cache: %lld hits %lld misses %d entries\n",
+           lld(hits), lld(misses), entries);
+    PINT_request_plan_cache_finalize();
+
+    return bad ? 1 : 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
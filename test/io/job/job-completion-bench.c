@@ -0,0 +1,141 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* measures how many job completions per second a single tester can reap
+ * from one context while 1-16 producer threads post null jobs into it
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include "pvfs2-internal.h"
+#include "job.h"
+#include "bmi.h"
+#include "gossip.h"
+
+#define ITERATIONS 200000
+#define MAX_PRODUCERS 16
+#define TEST_COUNT 64
+
+static job_context_id context;
+static int per_thread;
+
+static double wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)t.tv_usec / 1000000);
+}
+
+static void* producer_fn(void* foo)
+{
+    job_status_s status;
+    job_id_t tmp_id;
+    int ret;
+    int i;
+
+    for(i=0; i<per_thread; i++)
+    {
+        ret = job_null(0, NULL, 0, &status, &tmp_id, context);
+        assert(ret == 0);
+    }
+    return(NULL);
+}
+
+static double run(int producers)
+{
+    pthread_t threads[MAX_PRODUCERS];
+    job_id_t id_array[TEST_COUNT];
+    job_status_s status_array[TEST_COUNT];
+    int total;
+    int reaped = 0;
+    int count;
+    int ret;
+    int i;
+    double time1, time2;
+
+    per_thread = ITERATIONS / producers;
+    total = per_thread * producers;
+
+    time1 = wtime();
+    for(i=0; i<producers; i++)
+    {
+        ret = pthread_create(&threads[i], NULL, producer_fn, NULL);
+        assert(ret == 0);
+    }
+
+    while(reaped < total)
+    {
+        count = TEST_COUNT;
+        ret = job_testcontext(id_array, &count, NULL, status_array,
+            100, context);
+        assert(ret >= 0);
+        reaped += count;
+    }
+    time2 = wtime();
+
+    for(i=0; i<producers; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    return((double)total / (time2 - time1));
+}
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    int producers;
+
+    gossip_enable_stderr();
+    gossip_set_debug_mask(0, 0);
+
+    ret = BMI_initialize(NULL, NULL, 0, NULL);
+    if(ret < 0)
+    {
+        fprintf(stderr, "BMI_initialize failure.\n");
+        return(-1);
+    }
+
+    ret = job_initialize(0);
+    if(ret < 0)
+    {
+        fprintf(stderr, "job_initialize failure.\n");
+        return(-1);
+    }
+
+    ret = job_open_context(&context);
+    if(ret < 0)
+    {
+        fprintf(stderr, "job_open_context() failure.\n");
+        return(-1);
+    }
+
+    printf("# producers\tcompletions/sec\n");
+    for(producers=1; producers<=MAX_PRODUCERS; producers*=2)
+    {
+        printf("%d\t\t%f\n", producers, run(producers));
+    }
+
+    job_close_context(context);
+    job_finalize();
+    BMI_finalize();
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,298 @@
+/*
+ * (C) 2017 Clemson University and Omnibond Systems, LLC
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* ucache-bench.c
+ *
+ * Forks a number of processes that read and write a file concurrently, the
+ * way several ranks on one node would, and reports the aggregate rate.  It
+ * uses plain POSIX calls, so to measure the user cache run it with the
+ * PVFS user interface preloaded, e.g.
+ *
+ *     LD_PRELOAD=libofs.so ucache-bench -n 8 -f /pvfs/bench
+ *
+ * with ucached running.  By default every process works on its own part
+ * of one shared file; -p gives each process a file of its own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+/* DEFAULT VALUES FOR OPTIONS */
+static int opt_procs = 4;
+static int opt_iters = 4;
+static size_t opt_xfer = 65536;
+static size_t opt_region = 16 * 1024 * 1024;
+static int opt_write_pct = 20;
+static int opt_private = 0;
+static int opt_random = 0;
+static char opt_file[256] = "/tmp/ucache-bench.out";
+
+struct result
+{
+    double secs;
+    uint64_t bytes;
+    uint64_t ops;
+    int errors;
+};
+
+static void usage(char *argv0)
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv0);
+    fprintf(stderr, "  -n <procs>    number of processes (default %d)\n",
+            opt_procs);
+    fprintf(stderr, "  -i <iters>    passes over each region (default %d)\n",
+            opt_iters);
+    fprintf(stderr, "  -b <bytes>    transfer size (default %lu)\n",
+            (unsigned long)opt_xfer);
+    fprintf(stderr, "  -r <bytes>    region per process (default %lu)\n",
+            (unsigned long)opt_region);
+    fprintf(stderr, "  -w <pct>      percent of transfers that write "
+            "(default %d)\n", opt_write_pct);
+    fprintf(stderr, "  -p            one file per process\n");
+    fprintf(stderr, "  -R            random offsets within the region\n");
+    fprintf(stderr, "  -f <file>     file name (default %s)\n", opt_file);
+}
+
+static double wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (double)t.tv_sec + (double)t.tv_usec / 1000000.0;
+}
+
+/* fill buf with a pattern that identifies the offset it belongs at */
+static void pattern(char *buf, size_t len, off_t off)
+{
+    size_t i;
+    for(i = 0; i < len; i++)
+    {
+        buf[i] = (char)((off + i) * 7 + 3);
+    }
+}
+
+static int check(const char *buf, size_t len, off_t off)
+{
+    size_t i;
+    for(i = 0; i < len; i++)
+    {
+        if(buf[i] != (char)((off + i) * 7 + 3))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void worker(int rank, struct result *res)
+{
+    char fname[300];
+    char *buf;
+    int fd, iter;
+    size_t i;
+    size_t nxfers = opt_region / opt_xfer;
+    off_t base;
+    double start;
+
+    if(opt_private)
+    {
+        snprintf(fname, sizeof(fname), "%s.%d", opt_file, rank);
+        base = 0;
+    }
+    else
+    {
+        snprintf(fname, sizeof(fname), "%s", opt_file);
+        base = (off_t)rank * opt_region;
+    }
+
+    buf = malloc(opt_xfer);
+    if(!buf)
+    {
+        res->errors++;
+        return;
+    }
+
+    fd = open(fname, O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+    {
+        perror("open");
+        res->errors++;
+        free(buf);
+        return;
+    }
+
+    /* lay down the region first so every read has data to check */
+    for(i = 0; i < nxfers; i++)
+    {
+        off_t off = base + (off_t)i * opt_xfer;
+        pattern(buf, opt_xfer, off);
+        if(pwrite(fd, buf, opt_xfer, off) != (ssize_t)opt_xfer)
+        {
+            perror("pwrite");
+            res->errors++;
+            goto out;
+        }
+    }
+
+    srand(rank + 1);
+    start = wtime();
+    for(iter = 0; iter < opt_iters; iter++)
+    {
+        for(i = 0; i < nxfers; i++)
+        {
+            size_t n = opt_random ? (size_t)rand() % nxfers : i;
+            off_t off = base + (off_t)n * opt_xfer;
+            ssize_t ret;
+
+            if(rand() % 100 < opt_write_pct)
+            {
+                pattern(buf, opt_xfer, off);
+                ret = pwrite(fd, buf, opt_xfer, off);
+            }
+            else
+            {
+                ret = pread(fd, buf, opt_xfer, off);
+                if(ret == (ssize_t)opt_xfer && check(buf, opt_xfer, off))
+                {
+                    fprintf(stderr, "rank %d: bad data at %lld\n",
+                            rank, (long long)off);
+                    res->errors++;
+                }
+            }
+            if(ret != (ssize_t)opt_xfer)
+            {
+                fprintf(stderr, "rank %d: transfer at %lld returned %ld\n",
+                        rank, (long long)off, (long)ret);
+                res->errors++;
+                goto out;
+            }
+            res->bytes += opt_xfer;
+            res->ops++;
+        }
+    }
+    res->secs = wtime() - start;
+
+out:
+    close(fd);
+    free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    struct result *res;
+    int c, i, errors = 0;
+    uint64_t bytes = 0, ops = 0;
+    double secs = 0.0;
+
+    while((c = getopt(argc, argv, "n:i:b:r:w:pRf:h")) != -1)
+    {
+        switch(c)
+        {
+            case 'n':
+                opt_procs = atoi(optarg);
+                break;
+            case 'i':
+                opt_iters = atoi(optarg);
+                break;
+            case 'b':
+                opt_xfer = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                opt_region = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                opt_write_pct = atoi(optarg);
+                break;
+            case 'p':
+                opt_private = 1;
+                break;
+            case 'R':
+                opt_random = 1;
+                break;
+            case 'f':
+                strncpy(opt_file, optarg, sizeof(opt_file) - 1);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if(opt_procs < 1 || opt_xfer == 0 || opt_region < opt_xfer)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* results come back through a shared anonymous mapping */
+    res = mmap(NULL, sizeof(*res) * opt_procs, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(res == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+    memset(res, 0, sizeof(*res) * opt_procs);
+
+    for(i = 0; i < opt_procs; i++)
+    {
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if(pid == 0)
+        {
+            worker(i, &res[i]);
+            _exit(res[i].errors ? 1 : 0);
+        }
+    }
+    while(wait(NULL) > 0)
+        ;
+
+    for(i = 0; i < opt_procs; i++)
+    {
+        errors += res[i].errors;
+        bytes += res[i].bytes;
+        ops += res[i].ops;
+        if(res[i].secs > secs)
+        {
+            secs = res[i].secs;
+        }
+    }
+
+    printf("procs: %d  xfer: %lu  region: %lu  writes: %d%%  %s  %s\n",
+           opt_procs, (unsigned long)opt_xfer, (unsigned long)opt_region,
+           opt_write_pct, opt_private ? "private files" : "shared file",
+           opt_random ? "random" : "sequential");
+    if(secs > 0.0)
+    {
+        printf("%llu ops in %.3f s: %.1f ops/s  %.2f MB/s\n",
+               (unsigned long long)ops, secs, ops / secs,
+               bytes / secs / (1024.0 * 1024.0));
+    }
+    if(errors)
+    {
+        printf("%d errors\n", errors);
+    }
+    return errors ? 1 : 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,187 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* measures how many requests per second PINT_decode() can decode and
+ * release, once with every variable sized field malloc()ed and once
+ * with the request decoded into an arena the way the server does it
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#define __PINT_REQPROTO_ENCODE_FUNCS_C
+#include "pvfs2-internal.h"
+#include "pvfs2-types.h"
+#include "pvfs2-request.h"
+#include "pint-distribution.h"
+#include "pint-dist-utils.h"
+#include "pint-request.h"
+#include "PINT-reqproto-encode.h"
+#include "PINT-reqproto-module.h"
+#include "pvfs2-req-proto.h"
+#include "gossip.h"
+
+#define ITERATIONS 500000
+#define ARENA_SIZE 1024
+#define SIG_SIZE 128
+#define HANDLE_COUNT 4
+
+static char msg_buf[65536];
+static uint64_t arena_space[ARENA_SIZE / sizeof(uint64_t)];
+static PVFS_handle cap_handles[HANDLE_COUNT];
+static unsigned char cap_sig[SIG_SIZE];
+
+static double wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)t.tv_usec / 1000000);
+}
+
+/* encodes req the way lebf_encode_req() lays it out on the wire */
+static int encode(struct PVFS_server_req *req)
+{
+    char *ptr = msg_buf;
+    char **p = &ptr;
+
+    *((int32_t *)ptr) = htobmi32(PVFS2_PROTO_VERSION);
+    *((int32_t *)(ptr + 4)) = htobmi32(ENCODING_LE_BFIELD);
+    ptr += PINT_ENC_GENERIC_HEADER_SIZE;
+
+    encode_PVFS_server_req(p, req);
+    switch(req->op)
+    {
+        case PVFS_SERV_GETATTR:
+            encode_PVFS_servreq_getattr(p, &req->u.getattr);
+            break;
+        case PVFS_SERV_IO:
+            encode_PVFS_servreq_io(p, &req->u.io);
+            break;
+        default:
+            assert(0);
+    }
+    return(ptr - msg_buf);
+}
+
+static double run(int size, struct PINT_decode_arena *arena)
+{
+    struct PINT_decoded_msg decoded;
+    int ret;
+    int i;
+    double time1, time2;
+
+    time1 = wtime();
+    for(i=0; i<ITERATIONS; i++)
+    {
+        ret = PINT_decode_with_arena(msg_buf, PINT_DECODE_REQ, &decoded,
+                                     0, size, arena);
+        assert(ret == 0);
+        PINT_decode_release(&decoded, PINT_DECODE_REQ);
+    }
+    time2 = wtime();
+
+    return((double)ITERATIONS / (time2 - time1));
+}
+
+static void compare(const char *name, struct PVFS_server_req *req)
+{
+    struct PINT_decode_arena arena;
+    int size;
+    double with_malloc, with_arena;
+
+    arena.base = (char *) arena_space;
+    arena.size = sizeof(arena_space);
+    arena.used = 0;
+
+    size = encode(req);
+    with_malloc = run(size, NULL);
+    with_arena = run(size, &arena);
+    printf("%s\t%d\t\t%f\t%f\t%d\n", name, size, with_malloc, with_arena,
+           arena.used);
+}
+
+int main(int argc, char **argv)
+{
+    struct PVFS_server_req req;
+    PVFS_capability cap;
+    PVFS_credential cred;
+    PINT_dist *dist;
+    PVFS_Request file_req;
+    int ret;
+
+    gossip_enable_stderr();
+    gossip_set_debug_mask(0, 0);
+
+    ret = PINT_dist_initialize(NULL);
+    if(ret < 0)
+    {
+        fprintf(stderr, "PINT_dist_initialize failure.\n");
+        return(-1);
+    }
+    ret = PINT_encode_initialize();
+    if(ret < 0)
+    {
+        fprintf(stderr, "PINT_encode_initialize failure.\n");
+        return(-1);
+    }
+
+    memset(&cap, 0, sizeof(cap));
+    cap.issuer = "S:bench-server";
+    cap.fsid = 1;
+    cap.sig_size = SIG_SIZE;
+    cap.signature = cap_sig;
+    cap.num_handles = HANDLE_COUNT;
+    cap.handle_array = cap_handles;
+
+    memset(&cred, 0, sizeof(cred));
+    cred.issuer = "C:bench-client";
+
+    printf("# op\t\tbytes\t\tmalloc ops/sec\tarena ops/sec\tarena bytes\n");
+
+    memset(&req, 0, sizeof(req));
+    req.op = PVFS_SERV_GETATTR;
+    req.capability = cap;
+    req.u.getattr.credential = cred;
+    req.u.getattr.fs_id = 1;
+    req.u.getattr.attrmask = PVFS_ATTR_COMMON_ALL;
+    compare("getattr", &req);
+
+    dist = PINT_dist_create("simple_stripe");
+    assert(dist);
+    ret = PVFS_Request_vector(16, 4096, 65536, PVFS_BYTE, &file_req);
+    assert(ret == 0);
+
+    memset(&req, 0, sizeof(req));
+    req.op = PVFS_SERV_IO;
+    req.capability = cap;
+    req.u.io.fs_id = 1;
+    req.u.io.io_type = PVFS_IO_READ;
+    req.u.io.flow_type = FLOWPROTO_DEFAULT;
+    req.u.io.server_ct = 4;
+    req.u.io.io_dist = dist;
+    req.u.io.file_req = file_req;
+    req.u.io.aggregate_size = 16 * 4096;
+    compare("io\t", &req);
+
+    PVFS_Request_free(&file_req);
+    PINT_dist_free(dist);
+    PINT_encode_finalize();
+
+    return(0);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */